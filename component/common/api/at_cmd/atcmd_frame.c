@@ -0,0 +1,232 @@
+/******************************************************************************
+ *
+ * Binary framed AT transport codec, see atcmd_frame.h for the frame layout.
+ *
+ * The receiver is driven by atframe_rx_want()/atframe_rx_put(): it tells the
+ * caller where the next bytes go and how many it needs, so a DMA transport
+ * receives a header, then exactly one payload, without an intermediate copy.
+ * Byte streams (interrupt RX, host simulator) use atframe_rx_feed().
+ *
+ ******************************************************************************/
+#include <string.h>
+#include "atcmd_frame.h"
+
+enum {
+	ATFRAME_RX_HDR = 0,
+	ATFRAME_RX_BODY,
+	ATFRAME_RX_DISCARD
+};
+
+/* CRC-16/CCITT-FALSE, nibble table */
+static const u16 atframe_crc_tbl[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+u16 atframe_crc16(u16 crc, const u8 *data, u32 len)
+{
+	while(len--){
+		crc = (u16)((crc << 4) ^ atframe_crc_tbl[(crc >> 12) ^ (*data >> 4)]);
+		crc = (u16)((crc << 4) ^ atframe_crc_tbl[(crc >> 12) ^ (*data & 0x0F)]);
+		data++;
+	}
+	return crc;
+}
+
+static u8 atframe_hcs(const u8 *hdr)
+{
+	return (u8)~(hdr[1] ^ hdr[2] ^ hdr[3] ^ hdr[4]);
+}
+
+/**
+ * Write header and CRC around a payload already placed at
+ * frame + ATFRAME_HDR_LEN. frame must hold len + ATFRAME_OVERHEAD bytes.
+ *
+ * @return total frame length
+ */
+u16 atframe_seal(u8 *frame, u8 type, u8 seq, u16 len)
+{
+	u16 crc;
+
+	frame[0] = ATFRAME_SOF;
+	frame[1] = type;
+	frame[2] = seq;
+	frame[3] = (u8)len;
+	frame[4] = (u8)(len >> 8);
+	frame[5] = atframe_hcs(frame);
+	crc = atframe_crc16(0xFFFF, frame + 1, ATFRAME_HDR_LEN - 1 + len);
+	frame[ATFRAME_HDR_LEN + len] = (u8)crc;
+	frame[ATFRAME_HDR_LEN + len + 1] = (u8)(crc >> 8);
+
+	return (u16)(len + ATFRAME_OVERHEAD);
+}
+
+/**
+ * Build a complete frame into out.
+ *
+ * @return total frame length, 0 if out is too small
+ */
+u16 atframe_encode(u8 *out, u16 out_size, u8 type, u8 seq, const u8 *payload, u16 len)
+{
+	if((u32)len + ATFRAME_OVERHEAD > out_size)
+		return 0;
+	if(len)
+		memmove(out + ATFRAME_HDR_LEN, payload, len);
+	return atframe_seal(out, type, seq, len);
+}
+
+void atframe_rx_reset(struct atframe_rx *rx)
+{
+	rx->state = ATFRAME_RX_HDR;
+	rx->have = 0;
+	rx->len = 0;
+}
+
+/* 1 if no frame is partially received */
+int atframe_rx_idle(struct atframe_rx *rx)
+{
+	return (rx->state == ATFRAME_RX_HDR) && (rx->have == 0);
+}
+
+/**
+ * Hand the receiver the buffer for the next payload. It must hold the
+ * payload plus ATFRAME_CRC_LEN. The buffer is consumed by the next
+ * ATFRAME_RX_FRAME result; with no buffer set, frames are discarded and
+ * reported as ATFRAME_NAK_BUSY.
+ */
+void atframe_rx_set_buf(struct atframe_rx *rx, u8 *buf, u16 buf_size)
+{
+	rx->buf = buf;
+	rx->buf_size = buf ? buf_size : 0;
+}
+
+/**
+ * @param len returns the number of bytes the receiver needs next
+ * @return where those bytes must be stored
+ */
+u8 *atframe_rx_want(struct atframe_rx *rx, u16 *len)
+{
+	u16 left;
+
+	switch(rx->state){
+		case ATFRAME_RX_BODY:
+			*len = (u16)(rx->len + ATFRAME_CRC_LEN - rx->have);
+			return rx->buf + rx->have;
+		case ATFRAME_RX_DISCARD:
+			left = (u16)(rx->len + ATFRAME_CRC_LEN - rx->have);
+			*len = (left < sizeof(rx->scratch)) ? left : sizeof(rx->scratch);
+			return rx->scratch;
+		default:
+			*len = (u16)(ATFRAME_HDR_LEN - rx->have);
+			return rx->hdr + rx->have;
+	}
+}
+
+static void atframe_rx_resync(struct atframe_rx *rx)
+{
+	u16 i;
+
+	/* keep everything from the next SOF candidate on */
+	for(i = 1; i < rx->have; i++)
+		if(rx->hdr[i] == ATFRAME_SOF)
+			break;
+	memmove(rx->hdr, rx->hdr + i, rx->have - i);
+	rx->have = (u16)(rx->have - i);
+}
+
+/**
+ * Report that len bytes were stored where atframe_rx_want() pointed.
+ *
+ * @return ATFRAME_RX_MORE, ATFRAME_RX_FRAME (type/seq/len valid, payload in
+ *         the buffer given to atframe_rx_set_buf()) or ATFRAME_RX_ERROR
+ *         (type/seq/nak valid)
+ */
+int atframe_rx_put(struct atframe_rx *rx, u16 len)
+{
+	u16 crc;
+
+	rx->have = (u16)(rx->have + len);
+
+	switch(rx->state){
+		case ATFRAME_RX_HDR:
+			while(rx->have && (rx->hdr[0] != ATFRAME_SOF))
+				atframe_rx_resync(rx);
+			if(rx->have < ATFRAME_HDR_LEN)
+				return ATFRAME_RX_MORE;
+			if(rx->hdr[5] != atframe_hcs(rx->hdr)){
+				rx->errors++;
+				atframe_rx_resync(rx);
+				while(rx->have && (rx->hdr[0] != ATFRAME_SOF))
+					atframe_rx_resync(rx);
+				return ATFRAME_RX_MORE;
+			}
+			rx->type = rx->hdr[1];
+			rx->seq = rx->hdr[2];
+			rx->len = (u16)(rx->hdr[3] | (rx->hdr[4] << 8));
+			rx->have = 0;
+			if(rx->buf == NULL){
+				rx->nak = ATFRAME_NAK_BUSY;
+				rx->state = ATFRAME_RX_DISCARD;
+			}
+			else if((u32)rx->len + ATFRAME_CRC_LEN > rx->buf_size){
+				rx->nak = ATFRAME_NAK_LEN;
+				rx->state = ATFRAME_RX_DISCARD;
+			}
+			else
+				rx->state = ATFRAME_RX_BODY;
+			return ATFRAME_RX_MORE;
+
+		case ATFRAME_RX_BODY:
+			if(rx->have < rx->len + ATFRAME_CRC_LEN)
+				return ATFRAME_RX_MORE;
+			rx->state = ATFRAME_RX_HDR;
+			rx->have = 0;
+			crc = atframe_crc16(0xFFFF, rx->hdr + 1, ATFRAME_HDR_LEN - 1);
+			crc = atframe_crc16(crc, rx->buf, rx->len);
+			if(crc != (u16)(rx->buf[rx->len] | (rx->buf[rx->len + 1] << 8))){
+				rx->nak = ATFRAME_NAK_CRC;
+				rx->errors++;
+				return ATFRAME_RX_ERROR;
+			}
+			rx->frames++;
+			rx->buf = NULL;
+			rx->buf_size = 0;
+			return ATFRAME_RX_FRAME;
+
+		case ATFRAME_RX_DISCARD:
+			if(rx->have < rx->len + ATFRAME_CRC_LEN)
+				return ATFRAME_RX_MORE;
+			rx->state = ATFRAME_RX_HDR;
+			rx->have = 0;
+			rx->errors++;
+			return ATFRAME_RX_ERROR;
+	}
+	return ATFRAME_RX_MORE;
+}
+
+/**
+ * Push a byte stream through the receiver. Stops at the first frame or
+ * error so the caller can consume it before feeding the rest.
+ *
+ * @param used returns the number of bytes consumed
+ */
+int atframe_rx_feed(struct atframe_rx *rx, const u8 *data, u32 len, u32 *used)
+{
+	u32 pos = 0;
+	int ret = ATFRAME_RX_MORE;
+
+	while(pos < len){
+		u16 want;
+		u8 *dst = atframe_rx_want(rx, &want);
+		if(want > len - pos)
+			want = (u16)(len - pos);
+		memcpy(dst, data + pos, want);
+		pos += want;
+		ret = atframe_rx_put(rx, want);
+		if(ret != ATFRAME_RX_MORE)
+			break;
+	}
+	if(used)
+		*used = pos;
+	return ret;
+}
@@ -0,0 +1,81 @@
+#ifndef __ATCMD_FRAME_H__
+#define __ATCMD_FRAME_H__
+
+/******************************************************************************
+ *
+ * Binary framed AT transport codec.
+ *
+ * Every frame is length prefixed and CRC protected so a receiver knows the
+ * exact size of the next transfer (a DMA can be armed for it) and a host can
+ * keep several commands in flight, matching responses by sequence number:
+ *
+ *   +-----+------+-----+---------+-----+-----------------+---------+
+ *   | SOF | type | seq | len(LE) | hcs | payload[len]    | crc(LE) |
+ *   +-----+------+-----+---------+-----+-----------------+---------+
+ *      1     1      1       2       1         len             2
+ *
+ *   hcs: ~(type ^ seq ^ len_lo ^ len_hi), lets a receiver trust len before
+ *        committing to the payload transfer
+ *   crc: CRC-16/CCITT-FALSE over type .. payload
+ *
+ * The codec has no OS dependency and is shared by the device transport and
+ * the host side simulator in tools/atcmd_frame_sim.
+ *
+ ******************************************************************************/
+#include "basic_types.h"
+
+#define ATFRAME_SOF				0xA5
+#define ATFRAME_HDR_LEN			6
+#define ATFRAME_CRC_LEN			2
+#define ATFRAME_OVERHEAD		(ATFRAME_HDR_LEN + ATFRAME_CRC_LEN)
+
+/* frame types, low nibble of the type byte */
+#define ATFRAME_TYPE_MASK		0x0F
+#define ATFRAME_TYPE_CMD		0x01	// host -> device, AT command line (+ raw data for ATPT)
+#define ATFRAME_TYPE_RSP		0x02	// device -> host, output of command <seq>
+#define ATFRAME_TYPE_EVT		0x03	// device -> host, unsolicited output
+#define ATFRAME_TYPE_NAK		0x04	// device -> host, frame <seq> rejected, payload: reason
+#define ATFRAME_TYPE_DATA		0x05	// both ways, socket payload: con_id + raw bytes (SPI transport)
+/* type flags */
+#define ATFRAME_FLAG_MORE		0x80	// more RSP frames follow for the same seq
+
+/* NAK reasons */
+#define ATFRAME_NAK_CRC			1
+#define ATFRAME_NAK_LEN			2
+#define ATFRAME_NAK_BUSY		3	// no receive buffer free, host exceeded the window
+#define ATFRAME_NAK_TYPE		4
+
+/* atframe_rx_put()/atframe_rx_feed() results */
+#define ATFRAME_RX_MORE			0
+#define ATFRAME_RX_FRAME		1
+#define ATFRAME_RX_ERROR		(-1)
+
+struct atframe_rx {
+	u8 state;
+	u8 hdr[ATFRAME_HDR_LEN];
+	u16 have;		// bytes collected for the current state
+	u16 len;		// payload length of the current frame
+	u8 *buf;		// payload + crc destination, NULL if none free
+	u16 buf_size;
+	u8 scratch[16];	// sink for frames that are discarded
+	/* result of the last ATFRAME_RX_FRAME / ATFRAME_RX_ERROR */
+	u8 type;
+	u8 seq;
+	u8 nak;
+	/* statistics */
+	u32 frames;
+	u32 errors;
+};
+
+u16 atframe_crc16(u16 crc, const u8 *data, u32 len);
+u16 atframe_seal(u8 *frame, u8 type, u8 seq, u16 len);
+u16 atframe_encode(u8 *out, u16 out_size, u8 type, u8 seq, const u8 *payload, u16 len);
+
+void atframe_rx_reset(struct atframe_rx *rx);
+int atframe_rx_idle(struct atframe_rx *rx);
+void atframe_rx_set_buf(struct atframe_rx *rx, u8 *buf, u16 buf_size);
+u8 *atframe_rx_want(struct atframe_rx *rx, u16 *len);
+int atframe_rx_put(struct atframe_rx *rx, u16 len);
+int atframe_rx_feed(struct atframe_rx *rx, const u8 *data, u32 len, u32 *used);
+
+#endif //#ifndef __ATCMD_FRAME_H__
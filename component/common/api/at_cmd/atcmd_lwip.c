@@ -2948,6 +2948,7 @@ log_module_init(at_transport_init);
 #error ("some define missing, please check config_rsa.h")
 #endif
 #endif
+#include "atcmd_tt_ring.h"
 
 //#define MAX_BUFFER 	256
 #define MAX_BUFFER 	(LOG_SERVICE_BUFLEN)
@@ -2986,6 +2987,15 @@ _sema atcmd_lwip_tt_sema = NULL;
 volatile int atcmd_lwip_tt_datasize = 0;
 volatile int atcmd_lwip_tt_lasttickcnt = 0;
 
+/* one I/O task serves every connection, woken by lwIP socket events */
+#if NUM_NS > 32
+#error "atcmd_lwip_io_pending holds one bit per con_id"
+#endif
+static xTaskHandle atcmd_lwip_io_task = NULL;
+static _sema atcmd_lwip_io_sema = NULL;
+static volatile u32 atcmd_lwip_io_pending = 0; //con_id bitmap of connections to look at
+static s8 atcmd_lwip_sock_con[NUM_NS]; //socket -> con_id
+
 #ifdef ERRNO
 _WEAK int errno = 0; //LWIP errno
 #endif
@@ -3054,7 +3064,8 @@ static char *atcmd_ssl_client_key[NUM_NS] = {NULL}; //TODO:should be input by us
 static mbedtls_pk_context* atcmd_ssl_clikey_rsa[NUM_NS] = {NULL};
 #endif
 
-static void atcmd_lwip_receive_task(void *param);
+static void atcmd_lwip_io_watch(node *n);
+static void atcmd_lwip_io_unwatch(node *n);
 int atcmd_lwip_start_autorecv_task(void);
 int atcmd_lwip_is_autorecv_mode(void);
 void atcmd_lwip_set_autorecv_mode(int enable);
@@ -3112,6 +3123,8 @@ void socket_close(void)
 }
 #endif //#if ATCMD_VER == ATVER_2 
 
+#if (ATCMD_VER == ATVER_1) || ATCMD_SUPPORT_SSL
+//TCP/UDP connections of ATVER_2 are served by the I/O task, see atcmd_lwip_server_open()
 static void server_start(void *param)
 {
 	/* To avoid gcc warnings */
@@ -3938,6 +3951,159 @@ static void server_start_task(void *param)
 #endif
 	vTaskDelete(NULL);
 }
+#endif //#if (ATCMD_VER == ATVER_1) || ATCMD_SUPPORT_SSL
+
+#if ATCMD_VER == ATVER_2
+/*
+ * TCP/UDP server without a task of its own: the socket is set up here and
+ * the I/O task accepts the clients of a TCP server.
+ */
+static int atcmd_lwip_server_open(node *n)
+{
+	struct sockaddr_in s_serv_addr;
+	uint8_t *ip;
+	int s_opt = 1;
+
+	if(n->protocol == NODE_MODE_UDP)
+		n->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	else
+		n->sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if(n->sockfd == INVALID_SOCKET_ID){
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"ERROR opening socket");
+		return 5;
+	}
+
+	if((setsockopt(n->sockfd, SOL_SOCKET, SO_REUSEADDR, (const char *)&s_opt, sizeof(s_opt))) < 0){
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"ERROR on setting socket option");
+		return 6;
+	}
+
+	rtw_memset((char *)&s_serv_addr, 0, sizeof(s_serv_addr));
+	s_serv_addr.sin_family = AF_INET;
+	s_serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	s_serv_addr.sin_port = htons(n->port);
+	if(bind(n->sockfd, (struct sockaddr *)&s_serv_addr, sizeof(s_serv_addr)) < 0){
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"ERROR on binding");
+		return 7;
+	}
+
+	ip = (uint8_t *)LwIP_GetIP(&xnetif[0]);
+	n->addr = ntohl(*((u32_t *)ip));
+
+	if(n->protocol == NODE_MODE_TCP){
+		/* accept() must not block the I/O task */
+		if((listen(n->sockfd, 5) < 0) || (fcntl(n->sockfd, F_SETFL, O_NONBLOCK) < 0)){
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"ERROR on listening");
+			return 8;
+		}
+		if(hang_node(n) < 0)
+			return 9;
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,"The TCP SERVER START OK!");
+	}
+	else{
+#if IP_SOF_BROADCAST && IP_SOF_BROADCAST_RECV
+		int so_broadcast = 1;
+		if(setsockopt(n->sockfd, SOL_SOCKET, SO_BROADCAST, &so_broadcast, sizeof(so_broadcast)) < 0)
+			return 14;
+#endif
+		if(hang_node(n) < 0)
+			return 12;
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,"The UDP SERVER START OK!");
+	}
+
+	at_printf("\r\n[ATPS] OK"
+		"\r\n[ATPS] con_id=%d",
+		n->con_id);
+	return 0;
+}
+
+/*
+ * TCP/UDP client without a task of its own: an UDP client is ready at once,
+ * a TCP client starts a non-blocking connect that the I/O task completes
+ * and reports with [ATPC] OK or [ATPC] ERROR.
+ */
+static int atcmd_lwip_client_open(node *n)
+{
+	struct sockaddr_in c_serv_addr;
+
+	if(n->protocol == NODE_MODE_UDP)
+		n->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+	else
+		n->sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if(n->sockfd == INVALID_SOCKET_ID){
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"Failed to create sock_fd!");
+		return 7;
+	}
+	rtw_memset(&c_serv_addr, 0, sizeof(c_serv_addr));
+	c_serv_addr.sin_family = AF_INET;
+	c_serv_addr.sin_addr.s_addr = htonl(n->addr);
+	c_serv_addr.sin_port = htons(n->port);
+
+	if(n->protocol == NODE_MODE_TCP){
+		if(fcntl(n->sockfd, F_SETFL, O_NONBLOCK) < 0)
+			return 9;
+		if((connect(n->sockfd, (struct sockaddr *)&c_serv_addr, sizeof(c_serv_addr)) < 0)
+			&& (lwip_getsocklasterr(n->sockfd) != EINPROGRESS)){
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"[ATPC] ERROR:Connect to Server failed!");
+			return 9;
+		}
+		n->connecting = 1;
+		atcmd_lwip_io_watch(n);
+		return 0;
+	}
+
+#if IP_SOF_BROADCAST && IP_SOF_BROADCAST_RECV
+	/* all ones (broadcast) or all zeroes (old skool broadcast) */
+	if((c_serv_addr.sin_addr.s_addr == htonl(INADDR_BROADCAST))||
+		(c_serv_addr.sin_addr.s_addr == htonl(INADDR_ANY))){
+		int so_broadcast = 1;
+		if(setsockopt(n->sockfd, SOL_SOCKET, SO_BROADCAST, &so_broadcast,
+			sizeof(so_broadcast)) < 0){
+			return 14;
+		}
+	}
+#endif
+#if LWIP_IGMP
+	ip_addr_t dst_addr;
+	dst_addr.addr = c_serv_addr.sin_addr.s_addr;
+	if(ip_addr_ismulticast(&dst_addr)){
+		struct ip_mreq imr;
+		struct in_addr intfAddr;
+		// Set NETIF_FLAG_IGMP flag for netif which should process IGMP messages
+		xnetif[0].flags |= NETIF_FLAG_IGMP;
+		imr.imr_multiaddr.s_addr = c_serv_addr.sin_addr.s_addr;
+		imr.imr_interface.s_addr = INADDR_ANY;
+		if(setsockopt(n->sockfd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+			&imr, sizeof(imr)) < 0){
+			xnetif[0].flags &= ~NETIF_FLAG_IGMP;
+			return 15;
+		}
+		intfAddr.s_addr = INADDR_ANY;
+		if(setsockopt(n->sockfd, IPPROTO_IP, IP_MULTICAST_IF,
+			&intfAddr, sizeof(struct in_addr)) < 0){
+			xnetif[0].flags &= ~NETIF_FLAG_IGMP;
+			return 16;
+		}
+	}
+#endif
+	if(n->local_port){
+		struct sockaddr_in addr;
+		rtw_memset(&addr, 0, sizeof(addr));
+		addr.sin_family=AF_INET;
+		addr.sin_port=htons(n->local_port);
+		addr.sin_addr.s_addr=htonl(INADDR_ANY) ;
+		if (bind(n->sockfd, (struct sockaddr *)&addr, sizeof(addr))<0) {
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"bind sock error!");
+			return 12;
+		}
+	}
+	if(hang_node(n) < 0)
+		return 10;
+	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,"UDP client starts successful!");
+	at_printf("\r\n[ATPC] OK\r\n[ATPC] con_id=%d", n->con_id);
+	return 0;
+}
+#endif
 
 //AT Command function
 #if ATCMD_VER == ATVER_1
@@ -4237,7 +4403,6 @@ void fATPC(void *arg){
 	//char remote_addr[DNS_MAX_NAME_LENGTH];
 	struct in_addr addr;
 	int error_no = 0;
-	u32 client_task_stksz = ATCP_STACK_SIZE;
 #if LWIP_DNS  
 	struct hostent *server_host;
 #endif
@@ -4319,16 +4484,21 @@ void fATPC(void *arg){
 	clientnode->addr = ntohl(addr.s_addr);
 	clientnode->local_port = local_port;
 #if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
-	if(mode == NODE_MODE_SSL)
-		client_task_stksz = ATCP_SSL_STACK_SIZE;
+	if(mode == NODE_MODE_SSL){
+		//the ssl handshake blocks, so ssl clients keep a task
+		if(xTaskCreate(client_start_task, ((const char*)"client_start_task"), ATCP_SSL_STACK_SIZE, clientnode, ATCMD_LWIP_TASK_PRIORITY, NULL) != pdPASS)
+		{	
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+				"[ATPC] ERROR: Create ssl client task failed.");
+			error_no = 5;
+			goto err_exit;
+		}
+		goto exit;
+	}
 #endif
-	if(xTaskCreate(client_start_task, ((const char*)"client_start_task"), client_task_stksz, clientnode, ATCMD_LWIP_TASK_PRIORITY, NULL) != pdPASS)
-	{	
-		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
-			"[ATPC] ERROR: Create tcp/udp/ssl client task failed.");
-		error_no = 5;
+	error_no = atcmd_lwip_client_open(clientnode);
+	if(error_no)
 		goto err_exit;
-	}
 
 	goto exit;
 err_exit:
@@ -4347,7 +4517,6 @@ void fATPS(void *arg){
 	int mode;
 	int local_port;
 	int error_no = 0;
-	u32 server_task_stksz = ATCP_STACK_SIZE;
 
 	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS, 
 		"[ATPS]: _AT_TRANSPORT_START_SERVER");
@@ -4395,17 +4564,21 @@ void fATPS(void *arg){
 	servernode->port = local_port;
 
 #if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
-	if(mode == NODE_MODE_SSL)
-		server_task_stksz = ATCP_SSL_STACK_SIZE;
+	if(mode == NODE_MODE_SSL){
+		//the ssl handshake blocks, so ssl servers keep a task
+		if(xTaskCreate(server_start_task, ((const char*)"server_start_task"), ATCP_SSL_STACK_SIZE, servernode, ATCMD_LWIP_TASK_PRIORITY, &servernode->handletask) != pdPASS)
+		{	
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+				"[ATPS] ERROR: Create ssl server task failed.");
+			error_no = 4;
+			goto err_exit;
+		}
+		goto exit;
+	}
 #endif //#if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
-
-	if(xTaskCreate(server_start_task, ((const char*)"server_start_task"), server_task_stksz, servernode, ATCMD_LWIP_TASK_PRIORITY, &servernode->handletask) != pdPASS)
-	{	
-		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
-			"[ATPS] ERROR: Create tcp/udp/ssl server task failed.");
-		error_no = 4;
+	error_no = atcmd_lwip_server_open(servernode);
+	if(error_no)
 		goto err_exit;
-	}
 
 	goto exit;
 err_exit:
@@ -4525,6 +4698,20 @@ exit:
 	return error_no;
 }
 
+//send on a connection by id, for transports carrying raw payloads (SPI DATA frames)
+int atcmd_lwip_send_con(int con_id, u8 *data, u16 data_sz){
+	struct sockaddr_in cli_addr;
+	node *curnode = seek_node(con_id);
+
+	if(curnode == NULL)
+		return 3;
+	//a UDP server needs the destination of ATPT
+	if((curnode->protocol == NODE_MODE_UDP) && (curnode->role == NODE_ROLE_SERVER))
+		return 4;
+	rtw_memset(&cli_addr, 0, sizeof(cli_addr));
+	return atcmd_lwip_send_data(curnode, data, data_sz, cli_addr);
+}
+
 void fATPT(void *arg){
 
 	int argc;
@@ -4983,6 +5170,7 @@ void init_node_pool(void){
 	rtw_memset(node_pool, 0, sizeof(node_pool));
 	for(i=0;i<NUM_NS;i++){
 		node_pool[i].con_id = INVALID_CON_ID;
+		atcmd_lwip_sock_con[i] = INVALID_CON_ID;
 	}
 }
 
@@ -5003,6 +5191,8 @@ node* create_node(int mode, s8_t role){
 			node_pool[i].handletask = NULL;
 			node_pool[i].next = NULL;
 			node_pool[i].nextseed = NULL;
+			node_pool[i].linked = 0;
+			node_pool[i].connecting = 0;
 #if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
 			node_pool[i].context = NULL;
 #endif
@@ -5042,12 +5232,16 @@ void delete_node(node *n)
 			currSeed = currSeed->nextseed;
 		}
 	}
+	n->linked = 0;
 	SYS_ARCH_UNPROTECT(lev);
+	atcmd_lwip_io_unwatch(n);
 	
 	if(n->role == NODE_ROLE_SERVER){
 		//node may have seed if it's under server mode
 		while(n->nextseed != NULL){
 			currSeed = n->nextseed;
+			currSeed->linked = 0;
+			atcmd_lwip_io_unwatch(currSeed);
 			// only tcp/ssl seed has its own socket, udp seed uses its server's
 			// so delete udp seed can't close socket which is used by server
 			if(currSeed->protocol == NODE_MODE_TCP && currSeed->sockfd != INVALID_SOCKET_ID){
@@ -5167,6 +5361,7 @@ void delete_node(node *n)
 		n->context = NULL;
 	}
 #endif
+	n->connecting = 0;
 	n->con_id = INVALID_CON_ID;
 	return;
 }
@@ -5194,7 +5389,9 @@ int hang_node(node* insert_node)
 	}
 
 	n->next = insert_node;
+	insert_node->linked = 1;
 	SYS_ARCH_UNPROTECT(lev);
+	atcmd_lwip_io_watch(insert_node);
 	return 0;
 }
 
@@ -5219,30 +5416,23 @@ int hang_seednode(node* main_node ,node* insert_node)
 	}
 
 	n->nextseed = insert_node;
+	insert_node->linked = 1;
 	SYS_ARCH_UNPROTECT(lev);
+	atcmd_lwip_io_watch(insert_node);
 	return 0;
 }
 
 node *seek_node(int con_id)
 {
-	node* n = mainlist;
-	while (n->next != NULL)
-	{
-		n = n->next;
-		if(n->con_id == con_id)
-			return n;
+	node* n;
 
-		if(n->nextseed != NULL)
-		{
-			node* seed = n;
-			do{
-				seed = seed->nextseed;
-				if(seed->con_id == con_id)
-					return seed;
-			}while (seed->nextseed != NULL);
-		}
-	}
-	return NULL;
+	//con_id is the index in node_pool, 0 belongs to mainlist
+	if((con_id <= 0) || (con_id >= NUM_NS))
+		return NULL;
+	n = &node_pool[con_id];
+	if((n->con_id != con_id) || !n->linked)
+		return NULL;
+	return n;
 }
 
 node *tryget_node(int n)
@@ -5260,6 +5450,26 @@ node *tryget_node(int n)
 	return &node_pool[n];
 }
 
+//close the socket of a failed connection, the node is kept until ATPD
+static void atcmd_lwip_drop_socket(node *curnode)
+{
+	atcmd_lwip_io_unwatch(curnode);
+#if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
+	if(curnode->protocol == NODE_MODE_SSL){
+		mbedtls_ssl_close_notify((mbedtls_ssl_context *)curnode->context);
+		mbedtls_net_context server_fd;
+		server_fd.fd = curnode->sockfd;
+		mbedtls_net_free(&server_fd);
+		mbedtls_ssl_free((mbedtls_ssl_context *)curnode->context);
+	}
+	else
+#endif //#if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
+	{
+		close(curnode->sockfd);
+	}
+	curnode->sockfd = INVALID_SOCKET_ID;
+}
+
 int atcmd_lwip_receive_data(node *curnode, u8 *buffer, u16 buffer_size, int *recv_size, 
 	u8_t *udp_clientaddr, u16_t *udp_clientport){
 
@@ -5363,118 +5573,362 @@ int atcmd_lwip_receive_data(node *curnode, u8 *buffer, u16 buffer_size, int *rec
 exit:
 	if(error_no == 0)
 		*recv_size = size;
-	else{
-#if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
-		if(curnode->protocol == NODE_MODE_SSL){
-			mbedtls_ssl_close_notify((mbedtls_ssl_context *)curnode->context);
-			mbedtls_net_context server_fd;
-			server_fd.fd = curnode->sockfd;
-			mbedtls_net_free(&server_fd);
-			mbedtls_ssl_free((mbedtls_ssl_context *)curnode->context);
+	else
+		atcmd_lwip_drop_socket(curnode);
+	return error_no;
+}
+
+static void atcmd_lwip_io_post(int con_id)
+{
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	SYS_ARCH_PROTECT(lev);
+	atcmd_lwip_io_pending |= BIT(con_id);
+	SYS_ARCH_UNPROTECT(lev);
+	rtw_up_sema(&atcmd_lwip_io_sema);
+}
+
+/*
+ * lwIP event hook, runs in the context raising the event (mostly tcpip_thread),
+ * so it only marks the connection and wakes the I/O task.
+ */
+static void atcmd_lwip_sock_event(int s, int evt)
+{
+	node *n;
+	int con_id;
+
+	s -= LWIP_SOCKET_OFFSET;
+	if((s < 0) || (s >= NUM_NS))
+		return;
+	if((evt == NETCONN_EVT_RCVMINUS) || (evt == NETCONN_EVT_SENDMINUS))
+		return;
+	con_id = atcmd_lwip_sock_con[s];
+	if(con_id == INVALID_CON_ID)
+		return;
+
+	n = &node_pool[con_id];
+	if(!n->connecting){
+		//writable only matters while connecting, received data only in auto receive mode
+		if(evt == NETCONN_EVT_SENDPLUS)
+			return;
+		if(!((n->protocol == NODE_MODE_TCP) && (n->role == NODE_ROLE_SERVER)) && !atcmd_lwip_is_autorecv_mode())
+			return;
+	}
+	atcmd_lwip_io_post(con_id);
+}
+
+static void atcmd_lwip_io_handler(void *param);
+
+static int atcmd_lwip_io_start(void)
+{
+	if(atcmd_lwip_io_task != NULL)
+		return 0;
+
+	rtw_init_sema(&atcmd_lwip_io_sema, 0);
+	if(xTaskCreate(atcmd_lwip_io_handler, ((const char*)"atcmd_lwip_io"), ATCP_STACK_SIZE, NULL, ATCMD_LWIP_TASK_PRIORITY, &atcmd_lwip_io_task) != pdPASS)
+	{
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+			"ERROR: Create I/O task failed.");
+		rtw_free_sema(&atcmd_lwip_io_sema);
+		atcmd_lwip_io_task = NULL;
+		return -1;
+	}
+	lwip_set_event_hook(atcmd_lwip_sock_event);
+	return 0;
+}
+
+static void atcmd_lwip_io_watch(node *n)
+{
+	int s = n->sockfd - LWIP_SOCKET_OFFSET;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	if((s < 0) || (s >= NUM_NS))
+		return;
+	//udp seeds share the socket of their server, ssl servers accept in their own task
+	if((n->protocol == NODE_MODE_UDP) && (n->role == NODE_ROLE_SEED))
+		return;
+	if((n->protocol == NODE_MODE_SSL) && (n->role == NODE_ROLE_SERVER))
+		return;
+	if(atcmd_lwip_io_start() < 0)
+		return;
+
+	SYS_ARCH_PROTECT(lev);
+	atcmd_lwip_sock_con[s] = n->con_id;
+	SYS_ARCH_UNPROTECT(lev);
+	//events raised before the socket was mapped are lost, look at it once
+	atcmd_lwip_io_post(n->con_id);
+}
+
+static void atcmd_lwip_io_unwatch(node *n)
+{
+	int s = n->sockfd - LWIP_SOCKET_OFFSET;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	SYS_ARCH_PROTECT(lev);
+	if((s >= 0) && (s < NUM_NS) && (atcmd_lwip_sock_con[s] == n->con_id))
+		atcmd_lwip_sock_con[s] = INVALID_CON_ID;
+	if((n->con_id > 0) && (n->con_id < NUM_NS))
+		atcmd_lwip_io_pending &= ~BIT(n->con_id);
+	SYS_ARCH_UNPROTECT(lev);
+}
+
+//TCP server: take every pending client from the non-blocking listening socket
+static void atcmd_lwip_io_accept(node *servernode)
+{
+	struct sockaddr_in cli_addr;
+	socklen_t cli_len = sizeof(cli_addr);
+	node *seednode;
+	int s;
+
+	while((s = accept(servernode->sockfd, (struct sockaddr *)&cli_addr, &cli_len)) >= 0){
+		cli_len = sizeof(cli_addr);
+		seednode = create_node(servernode->protocol, NODE_ROLE_SEED);
+		if(seednode == NULL){
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+				"[ATPS]create node failed!");
+			close(s);
+			continue;
 		}
-		else
-#endif //#if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
-		{
-			close(curnode->sockfd);
+		seednode->sockfd = s;
+		seednode->port = ntohs(cli_addr.sin_port);
+		seednode->addr = ntohl(cli_addr.sin_addr.s_addr);
+		if(hang_seednode(servernode, seednode) < 0){
+			delete_node(seednode);
+			continue;
 		}
-		curnode->sockfd = INVALID_SOCKET_ID;
+		#if CONFIG_LOG_SERVICE_LOCK
+		log_service_lock();
+		#endif
+		at_printf("\r\n[ATPS] A client connected to server[%d]\r\n"
+			"con_id:%d,"
+			"seed,"
+			"tcp,"
+			"address:%s,"
+			"port:%d,"
+			"socket:%d", 
+			servernode->con_id,
+			seednode->con_id,
+			inet_ntoa(cli_addr.sin_addr),
+			seednode->port,
+			seednode->sockfd
+			);
+		at_printf(STR_END_OF_ATCMD_RET);
+		#if CONFIG_LOG_SERVICE_LOCK
+		log_service_unlock();
+		#endif
 	}
-	return error_no;
 }
 
-static void atcmd_lwip_receive_task(void *param)
+//TCP client: finish the non-blocking connect started by atcmd_lwip_client_open()
+static void atcmd_lwip_io_connect(node *clientnode)
 {
+	struct timeval tv = {0, 0};
+	fd_set writefds, errfds;
+	int error_no = 0;
 
-	int i;
-	int packet_size = ETH_MAX_MTU;
+	//zero timeout, only reads the state left by the socket event
+	FD_ZERO(&writefds);
+	FD_ZERO(&errfds);
+	FD_SET(clientnode->sockfd, &writefds);
+	FD_SET(clientnode->sockfd, &errfds);
+	if(select(clientnode->sockfd + 1, NULL, &writefds, &errfds, &tv) <= 0)
+		return;
 
-	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS, 
-			"Enter auto receive mode");
-	
-	while(atcmd_lwip_is_autorecv_mode())
-	{
-		for (i = 0; i < NUM_NS; ++i) {
-			node* curnode = NULL;
-			int error_no = 0;
-			int recv_size = 0;	
-			u8_t udp_clientaddr[16] = {0};
-			u16_t udp_clientport = 0;			
-			curnode = tryget_node(i);
-			if(curnode == NULL)
-				continue;
-			if((curnode->protocol == NODE_MODE_TCP 
+	clientnode->connecting = 0;
+	if(FD_ISSET(clientnode->sockfd, &errfds)){
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,"[ATPC] ERROR:Connect to Server failed!");
+		error_no = 9;
+	}
+	//blocking again, ATPT writes wait for the send buffer
+	else if(fcntl(clientnode->sockfd, F_SETFL, 0) < 0)
+		error_no = 9;
+	else if(hang_node(clientnode) < 0)
+		error_no = 8;
+
+	if(error_no)
+		delete_node(clientnode);
+	else
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,"Connect to Server successful!");
+
+	#if CONFIG_LOG_SERVICE_LOCK
+	log_service_lock();
+	#endif
+	if(error_no)
+		at_printf("\r\n[ATPC] ERROR:%d", error_no);
+	else
+		at_printf("\r\n[ATPC] OK\r\n[ATPC] con_id=%d", clientnode->con_id);
+	at_printf(STR_END_OF_ATCMD_RET);
+	#if CONFIG_LOG_SERVICE_LOCK
+	log_service_unlock();
+	#endif
+}
+
+//error of the non-blocking read that just failed: errno if lwIP sets it, else the socket error
+static int atcmd_lwip_would_block(int sockfd)
+{
+#if defined(ERRNO) && LWIP_SOCKET_SET_ERRNO
+	int err = errno;
+	(void) sockfd;
+#else
+	int err = lwip_getsocklasterr(sockfd);
+#endif
+
+	return (err == EWOULDBLOCK) || (err == EAGAIN);
+}
+
+//auto receive mode: print what is queued on one connection, all of them share rx_buffer
+static void atcmd_lwip_io_recv(node *curnode)
+{
+	u8_t udp_clientaddr[16] = {0};
+	u16_t udp_clientport = 0;
+	int con_id = curnode->con_id;
+	int error_no = 0;
+	int size;
+
+	if((curnode->protocol == NODE_MODE_UDP) && (curnode->role == NODE_ROLE_SERVER)){
+		struct sockaddr_in client_addr;
+		socklen_t addr_len = sizeof(client_addr);
+		size = recvfrom(curnode->sockfd, rx_buffer, ETH_MAX_MTU, MSG_DONTWAIT, (struct sockaddr *)&client_addr, &addr_len);
+		if(size > 0){
+			inet_ntoa_r(client_addr.sin_addr, (char *)udp_clientaddr, sizeof(udp_clientaddr));
+			udp_clientport = ntohs(client_addr.sin_port);
+		}
+	}
 #if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
-				||curnode->protocol == NODE_MODE_SSL
+	else if(curnode->protocol == NODE_MODE_SSL){
+		mbedtls_ssl_context *ssl = (mbedtls_ssl_context *)curnode->context;
+		u8 peek;
+		//mbedtls_ssl_read() blocks, only call it when a record is buffered or arriving
+		if((mbedtls_ssl_get_bytes_avail(ssl) == 0)
+			&& (recv(curnode->sockfd, &peek, 1, MSG_PEEK | MSG_DONTWAIT) < 0)
+			&& atcmd_lwip_would_block(curnode->sockfd))
+			return;
+		size = mbedtls_ssl_read(ssl, rx_buffer, ETH_MAX_MTU);
+	}
 #endif
-				)
-				&& curnode->role == NODE_ROLE_SERVER){
-				//TCP Server must receive data from the seed
-				continue;
-			}
-			error_no = atcmd_lwip_receive_data(curnode, rx_buffer, packet_size, &recv_size, udp_clientaddr, &udp_clientport);
+	else
+		size = recv(curnode->sockfd, rx_buffer, ETH_MAX_MTU, MSG_DONTWAIT);
 
-			if(atcmd_lwip_is_tt_mode()){
-				if((error_no == 0) && recv_size){
-					rx_buffer[recv_size] = '\0';
-					AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,"Recv[%d]:%s", recv_size, rx_buffer);
-					at_print_data(rx_buffer, recv_size);
-					rtw_msleep_os(20);
-				}
-				continue;
-			}
-			
-			if(error_no == 0){
-				if(recv_size){
-					rx_buffer[recv_size] = '\0';
-					#if CONFIG_LOG_SERVICE_LOCK
-					log_service_lock();
-					#endif
-					if(curnode->protocol == NODE_MODE_UDP && curnode->role == NODE_ROLE_SERVER){
-						AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,
-								"\r\n[ATPR] OK,%d,%d,%s,%d:%s", recv_size, curnode->con_id, udp_clientaddr, udp_clientport, rx_buffer);
-						at_printf("\r\n[ATPR] OK,%d,%d,%s,%d:", recv_size, curnode->con_id, udp_clientaddr, udp_clientport);
-					}
-					else{
-						AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,
-								"\r\n[ATPR] OK,%d,%d:%s", 
-								recv_size, 
-								curnode->con_id, rx_buffer);
-						at_printf("\r\n[ATPR] OK,%d,%d:", recv_size, curnode->con_id);
-					}
-					at_print_data(rx_buffer, recv_size);
-					at_printf(STR_END_OF_ATCMD_RET);
-					#if CONFIG_LOG_SERVICE_LOCK
-					log_service_unlock();
-					#endif
-				}
-			}
-			else{
-				#if CONFIG_LOG_SERVICE_LOCK
-				log_service_lock();
-				#endif
-				at_printf("\r\n[ATPR] ERROR:%d,%d", error_no, curnode->con_id);				
-				at_printf(STR_END_OF_ATCMD_RET);
-				#if CONFIG_LOG_SERVICE_LOCK
-				log_service_unlock();
-				#endif
-			}
+	if(size > 0){
+		//more may be queued, come back after the other connections had their turn
+		atcmd_lwip_io_post(con_id);
+	}
+	else if((size < 0) && (curnode->protocol != NODE_MODE_SSL)
+		&& atcmd_lwip_would_block(curnode->sockfd)){
+		return;
+	}
+	else if((size == 0) && (curnode->protocol == NODE_MODE_UDP)){
+		return;
+	}
+	else{
+		if(curnode->protocol == NODE_MODE_UDP){
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+				"[ATPR] ERROR:Failed to receive data");
+			error_no = (curnode->role == NODE_ROLE_SERVER) ? 4 : 5;
+		}
+		else if(size == 0){
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+				"[ATPR] ERROR:Connection is closed!");
+			error_no = 7;
+		}
+		else{
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+				"[ATPR] ERROR:Failed to receive data.ret=-0x%x!",-size);
+			error_no = 8;
 		}
+		atcmd_lwip_drop_socket(curnode);
 	}
 
-	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS, 
-			"Leave auto receive mode");
+	if(atcmd_lwip_is_tt_mode()){
+		if(error_no == 0){
+			rx_buffer[size] = '\0';
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,"Recv[%d]:%s", size, rx_buffer);
+			at_print_data(rx_buffer, size);
+			rtw_msleep_os(20);
+		}
+		return;
+	}
+
+#if (defined(CONFIG_EXAMPLE_SPI_ATCMD) && CONFIG_EXAMPLE_SPI_ATCMD)
+	//SPI: the payload goes to the host as it is, in DATA frames
+	if((error_no == 0) && !(curnode->protocol == NODE_MODE_UDP && curnode->role == NODE_ROLE_SERVER)
+		&& (spi_at_data_send(con_id, rx_buffer, size) == 0))
+		return;
+#endif
+
+	#if CONFIG_LOG_SERVICE_LOCK
+	log_service_lock();
+	#endif
+	if(error_no == 0){
+		rx_buffer[size] = '\0';
+		if(curnode->protocol == NODE_MODE_UDP && curnode->role == NODE_ROLE_SERVER){
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,
+					"\r\n[ATPR] OK,%d,%d,%s,%d:%s", size, con_id, udp_clientaddr, udp_clientport, rx_buffer);
+			at_printf("\r\n[ATPR] OK,%d,%d,%s,%d:", size, con_id, udp_clientaddr, udp_clientport);
+		}
+		else{
+			AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,
+					"\r\n[ATPR] OK,%d,%d:%s", size, con_id, rx_buffer);
+			at_printf("\r\n[ATPR] OK,%d,%d:", size, con_id);
+		}
+		at_print_data(rx_buffer, size);
+	}
+	else
+		at_printf("\r\n[ATPR] ERROR:%d,%d", error_no, con_id);
+	at_printf(STR_END_OF_ATCMD_RET);
+	#if CONFIG_LOG_SERVICE_LOCK
+	log_service_unlock();
+	#endif
+}
+
+static void atcmd_lwip_io_handler(void *param)
+{
+	/* To avoid gcc warnings */
+	( void ) param;
+
+	while(rtw_down_sema(&atcmd_lwip_io_sema) == _SUCCESS){
+		u32 pending;
+		int con_id;
+		SYS_ARCH_DECL_PROTECT(lev);
+
+		SYS_ARCH_PROTECT(lev);
+		pending = atcmd_lwip_io_pending;
+		atcmd_lwip_io_pending = 0;
+		SYS_ARCH_UNPROTECT(lev);
+
+		for(con_id = 1; pending != 0; con_id++){
+			node *curnode = &node_pool[con_id];
+
+			if(!(pending & BIT(con_id)))
+				continue;
+			pending &= ~BIT(con_id);
+			if((curnode->con_id != con_id) || (curnode->sockfd == INVALID_SOCKET_ID))
+				continue;
+
+			if(curnode->connecting)
+				atcmd_lwip_io_connect(curnode);
+			else if((curnode->protocol == NODE_MODE_TCP) && (curnode->role == NODE_ROLE_SERVER))
+				atcmd_lwip_io_accept(curnode);
+			else if(atcmd_lwip_is_autorecv_mode())
+				atcmd_lwip_io_recv(curnode);
+		}
+	}
 
 	vTaskDelete(NULL);
 }
 
 int atcmd_lwip_start_autorecv_task(void){
-	atcmd_lwip_set_autorecv_mode(TRUE);
-	if(xTaskCreate(atcmd_lwip_receive_task, ((const char*)"atcmd_lwip_receive_task"), ATCP_STACK_SIZE, NULL, ATCMD_LWIP_TASK_PRIORITY, NULL) != pdPASS)
-	{
-		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
-			"ERROR: Create receive task failed.");
-		atcmd_lwip_set_autorecv_mode(FALSE);
+	int i;
+
+	if(atcmd_lwip_io_start() < 0)
 		return -1;
+	atcmd_lwip_set_autorecv_mode(TRUE);
+	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS, 
+			"Enter auto receive mode");
+	//data queued in manual mode raised its event already, look at every connection once
+	for(i = 1; i < NUM_NS; i++){
+		if(node_pool[i].linked)
+			atcmd_lwip_io_post(i);
 	}
 	return 0;
 }
@@ -5493,45 +5947,44 @@ void atcmd_lwip_set_autorecv_mode(int enable){
 	atcmd_lwip_auto_recv = enable;
 }
 
-static void _tt_wait_rx_complete(){
-	s32 tick_current = rtw_get_current_time();
-
-	while(rtw_systime_to_ms(tick_current -atcmd_lwip_tt_lasttickcnt) < ATCMD_LWIP_TT_MAX_DELAY_TIME_MS ){
-		rtw_msleep_os(5);
-		tick_current = rtw_get_current_time();
-	}
-}
-
+#if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
+/*
+ * The UART receives into the buffers of the TT ring by DMA, this task sends
+ * them in order, so the UART keeps receiving while send() blocks. A buffer
+ * is committed as soon as DMA filled it, a partial one is flushed once no
+ * buffer completed for ATCMD_LWIP_TT_MAX_DELAY_TIME_MS. "----" alone between
+ * two flushes (the host paused before and after it) leaves TT mode.
+ */
 static void atcmd_lwip_tt_handler(void* param)
 {
+	struct atcmd_tt_ring *ring = (struct atcmd_tt_ring *)param;
 	struct sockaddr_in cli_addr;
+	u8 *data;
+	u16 len;
+	u8 flags;
+
 	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS, 
 			"Enter TT data mode");
 
-	while(rtw_down_sema(&atcmd_lwip_tt_sema) == _SUCCESS) {
-		_lock lock;
-		_irqL irqL;
-		int tt_size = 0;
-		_tt_wait_rx_complete();
-
-		rtw_enter_critical(&lock, &irqL);
-		if((atcmd_lwip_tt_datasize >= 4) && (rtw_memcmp(log_buf, "----", 4) == _TRUE)){
+	while(1) {
+		data = atcmd_tt_ring_peek(ring, &len, &flags);
+		if(data == NULL){
+			if(rtw_down_timeout_sema(&atcmd_lwip_tt_sema, ATCMD_LWIP_TT_MAX_DELAY_TIME_MS) == RTW_FALSE)
+				uart_at_tt_flush();
+			continue;
+		}
+		if((flags & ATCMD_TT_F_IDLE) && (len >= 4) && (len < ring->size) && (rtw_memcmp(data, "----", 4) == _TRUE)){
 			atcmd_lwip_set_tt_mode(FALSE);
-			atcmd_lwip_tt_datasize = 0;
-			rtw_exit_critical(&lock, &irqL);
 			break;
 		}
-		rtw_memcpy(tx_buffer, log_buf, atcmd_lwip_tt_datasize);
-		tt_size = atcmd_lwip_tt_datasize;
-		atcmd_lwip_tt_datasize = 0;
-		rtw_exit_critical(&lock, &irqL);
-		tx_buffer[tt_size] = '\0';
-		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS,"Send[%d]:%s", tt_size, tx_buffer);
-		atcmd_lwip_send_data(mainlist->next, tx_buffer, tt_size, cli_addr);
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_INFO, "Send[%d]", len);
+		atcmd_lwip_send_data(mainlist->next, data, len, cli_addr);
+		uart_at_tt_release();
 	}
-exit:
+
 	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS, 
 			"Leave TT data mode");
+	uart_at_tt_stop();
 	rtw_free_sema(&atcmd_lwip_tt_sema);
 	atcmd_lwip_set_autorecv_mode(FALSE);
 	at_printf(STR_END_OF_ATCMD_RET); //mark return to command mode
@@ -5543,6 +5996,7 @@ int atcmd_lwip_start_tt_task(void){
 	int enable = 1;
 	int send_timeout = 20; //20 milliseconds
 	node *n = mainlist->next;
+	struct atcmd_tt_ring *ring;
 	ret = setsockopt(n->sockfd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
 	if (ret < 0) {
 		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR, "set TCP_NODELAY error! ");
@@ -5561,27 +6015,46 @@ int atcmd_lwip_start_tt_task(void){
 	}
 #endif
 
+	//the UART DMA callbacks up the sema as soon as reception starts
 	rtw_init_sema(&atcmd_lwip_tt_sema, 0);
+	ring = uart_at_tt_start();
+	if(ring == NULL){
+		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+			"ERROR: TT receive buffers unavailable.");
+		rtw_free_sema(&atcmd_lwip_tt_sema);
+		goto err_exit;
+	}
 	atcmd_lwip_set_tt_mode(TRUE);
-	if(xTaskCreate(atcmd_lwip_tt_handler, ((const char*)"tt_hdl"), ATCP_STACK_SIZE, NULL, ATCMD_LWIP_TASK_PRIORITY, &atcmd_lwip_tt_task) != pdPASS){
+	if(xTaskCreate(atcmd_lwip_tt_handler, ((const char*)"tt_hdl"), ATCP_STACK_SIZE, ring, ATCMD_LWIP_TASK_PRIORITY, &atcmd_lwip_tt_task) != pdPASS){
 		AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
 			"ERROR: Create tt task failed.");
-		goto err_exit;
+		goto err_tt;
 	}
 	rtw_msleep_os(20);
 	if(atcmd_lwip_is_autorecv_mode() != 1){
 		if(atcmd_lwip_start_autorecv_task()){
 			vTaskDelete(atcmd_lwip_tt_task);
-			goto err_exit;
+			goto err_tt;
 		}
 	}
 
 	return 0;
-	
+
+err_tt:
+	uart_at_tt_stop();
+	rtw_free_sema(&atcmd_lwip_tt_sema);
 err_exit:
 	atcmd_lwip_set_tt_mode(FALSE);
 	return -1;
 }
+#else
+//TT mode receives through the UART ring, over SPI the host sends DATA frames instead
+int atcmd_lwip_start_tt_task(void){
+	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ERROR,
+		"ERROR: TT mode needs the UART transport.");
+	return -1;
+}
+#endif
 
 void atcmd_lwip_erase_info(void){
 	atcmd_update_partition_info(AT_PARTITION_LWIP, AT_PARTITION_ERASE, NULL, 0);
@@ -76,6 +76,8 @@ typedef struct ns
 	xTaskHandle handletask;
 	struct ns* next;
 	struct ns* nextseed;
+	u8_t linked;		//hung on mainlist, seek_node() only returns linked nodes
+	u8_t connecting;	//non-blocking connect in progress, completed by the I/O task
 #if (ATCMD_VER == ATVER_2) && ATCMD_SUPPORT_SSL
 	void *context;
 #endif
@@ -90,6 +92,7 @@ extern volatile int atcmd_lwip_tt_lasttickcnt;
 extern int atcmd_lwip_is_tt_mode(void);
 extern void atcmd_lwip_set_tt_mode(int enable);
 int atcmd_lwip_send_data(node *curnode, u8 *data, u16 data_sz, struct sockaddr_in cli_addr);
+int atcmd_lwip_send_con(int con_id, u8 *data, u16 data_sz);
 int atcmd_lwip_receive_data(node *curnode, u8 *buffer, u16 buffer_size, int *recv_size, 
 	u8_t *udp_clientaddr, u16_t *udp_clientport);
 node* create_node(int mode, s8_t role);
@@ -0,0 +1,332 @@
+/******************************************************************************
+ *
+ * Record store of the AT command settings, see atcmd_record.h for the
+ * layout.
+ *
+ * Headers are stored little endian byte by byte. A record header is
+ * programmed before its data: a header that is neither erased nor valid, or
+ * a crc that does not match, marks where a write was cut and nothing after
+ * it is trusted.
+ *
+ ******************************************************************************/
+#include <string.h>
+#include "atcmd_record.h"
+
+#define ATCMD_RECORD_SECTOR_MAGIC	0x53525441	// "ATRS"
+#define ATCMD_RECORD_MAGIC			0x5AA5
+#define ATCMD_RECORD_CHUNK			32			// bytes read at once
+#define ATCMD_RECORD_SIZE(len)		(ATCMD_RECORD_HDR_LEN + (((u32)(len) + 3) & ~3UL))
+
+/* CRC-16/CCITT-FALSE */
+static u16 atcmd_record_crc16(u16 crc, const u8 *data, u32 len)
+{
+	int i;
+
+	while(len--){
+		crc ^= (u16)(*data++ << 8);
+		for(i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (u16)((crc << 1) ^ 0x1021) : (u16)(crc << 1);
+	}
+	return crc;
+}
+
+static u16 atcmd_record_crc_start(u8 id, u16 len)
+{
+	u8 b[3];
+
+	b[0] = id;
+	b[1] = (u8)len;
+	b[2] = (u8)(len >> 8);
+	return atcmd_record_crc16(0xFFFF, b, 3);
+}
+
+/* crc of a record whose data is already in flash */
+static u16 atcmd_record_crc_flash(struct atcmd_record_store *store, u8 id, u32 addr, u16 len)
+{
+	u8 buf[ATCMD_RECORD_CHUNK];
+	u16 crc = atcmd_record_crc_start(id, len);
+	u32 n;
+
+	while(len){
+		n = (len > sizeof(buf)) ? sizeof(buf) : len;
+		store->flash->read(addr, n, buf);
+		crc = atcmd_record_crc16(crc, buf, n);
+		addr += n;
+		len -= n;
+	}
+	return crc;
+}
+
+static int atcmd_record_put_hdr(struct atcmd_record_store *store, u32 addr, u8 id, u16 len, u16 crc)
+{
+	u8 hdr[ATCMD_RECORD_HDR_LEN];
+
+	hdr[0] = (u8)ATCMD_RECORD_MAGIC;
+	hdr[1] = (u8)(ATCMD_RECORD_MAGIC >> 8);
+	hdr[2] = id;
+	hdr[3] = 0xFF;
+	hdr[4] = (u8)len;
+	hdr[5] = (u8)(len >> 8);
+	hdr[6] = (u8)crc;
+	hdr[7] = (u8)(crc >> 8);
+	return store->flash->write(addr, sizeof(hdr), hdr);
+}
+
+static int atcmd_record_is_erased(const u8 *data, u32 len)
+{
+	while(len--){
+		if(*data++ != 0xFF)
+			return 0;
+	}
+	return 1;
+}
+
+/* builds the index from the records of the active sector */
+static void atcmd_record_scan(struct atcmd_record_store *store)
+{
+	u32 base = store->sector[store->active];
+	u32 off = ATCMD_RECORD_HDR_LEN;
+	u8 hdr[ATCMD_RECORD_HDR_LEN];
+	u16 len, crc;
+	u8 id;
+
+	while(off + ATCMD_RECORD_HDR_LEN <= ATCMD_RECORD_SECTOR_SIZE){
+		store->flash->read(base + off, sizeof(hdr), hdr);
+		if(atcmd_record_is_erased(hdr, sizeof(hdr)))
+			break;
+
+		id = hdr[2];
+		len = (u16)(hdr[4] | (hdr[5] << 8));
+		crc = (u16)(hdr[6] | (hdr[7] << 8));
+		if(((u16)(hdr[0] | (hdr[1] << 8)) != ATCMD_RECORD_MAGIC) || (id >= ATCMD_RECORD_ID_MAX) ||
+			(ATCMD_RECORD_SIZE(len) > ATCMD_RECORD_SECTOR_SIZE - off) ||
+			(atcmd_record_crc_flash(store, id, base + off + ATCMD_RECORD_HDR_LEN, len) != crc)){
+			/* cut by a power loss, the next write compacts */
+			store->torn++;
+			off = ATCMD_RECORD_SECTOR_SIZE;
+			break;
+		}
+		store->addr[id] = len ? (base + off + ATCMD_RECORD_HDR_LEN) : 0;
+		store->len[id] = len;
+		off += ATCMD_RECORD_SIZE(len);
+	}
+	store->tail = (off > ATCMD_RECORD_SECTOR_SIZE) ? ATCMD_RECORD_SECTOR_SIZE : off;
+}
+
+/**
+ * Find the active sector and build the index. Without a formatted sector,
+ * the non-erased records of legacy are used in place until the first write.
+ *
+ * @param sector0, sector1 flash addresses of the two sectors, sector0 holds
+ *                         the legacy layout
+ * @return 0, -1 if the arguments are invalid
+ */
+int atcmd_record_mount(struct atcmd_record_store *store, const struct atcmd_record_flash *flash,
+	u32 sector0, u32 sector1, const struct atcmd_record_legacy *legacy, int legacy_num)
+{
+	u8 hdr[ATCMD_RECORD_HDR_LEN], buf[ATCMD_RECORD_CHUNK];
+	u32 seq[2], addr, n, left;
+	int valid[2], i;
+
+	if((flash == NULL) || (sector0 == sector1) || (legacy_num && (legacy == NULL)))
+		return -1;
+
+	memset(store, 0, sizeof(struct atcmd_record_store));
+	store->flash = flash;
+	store->sector[0] = sector0;
+	store->sector[1] = sector1;
+
+	for(i = 0; i < 2; i++){
+		flash->read(store->sector[i], sizeof(hdr), hdr);
+		seq[i] = (u32)hdr[0] | ((u32)hdr[1] << 8) | ((u32)hdr[2] << 16) | ((u32)hdr[3] << 24);
+		valid[i] = ((hdr[4] | (hdr[5] << 8) | (hdr[6] << 16) | ((u32)hdr[7] << 24)) == ATCMD_RECORD_SECTOR_MAGIC);
+	}
+
+	if(valid[0] || valid[1]){
+		if(valid[0] && valid[1])
+			store->active = ((s32)(seq[1] - seq[0]) > 0) ? 1 : 0;
+		else
+			store->active = valid[1] ? 1 : 0;
+		store->seq = seq[store->active];
+		atcmd_record_scan(store);
+		return 0;
+	}
+
+	/* not formatted, the first write compacts into sector1 */
+	store->tail = ATCMD_RECORD_SECTOR_SIZE;
+	for(i = 0; i < legacy_num; i++){
+		if((legacy[i].id >= ATCMD_RECORD_ID_MAX) || (legacy[i].len == 0) || (legacy[i].len > ATCMD_RECORD_LEN_MAX) ||
+			((u32)legacy[i].offset + legacy[i].len > ATCMD_RECORD_SECTOR_SIZE))
+			continue;
+		addr = sector0 + legacy[i].offset;
+		for(left = legacy[i].len; left; left -= n, addr += n){
+			n = (left > sizeof(buf)) ? sizeof(buf) : left;
+			flash->read(addr, n, buf);
+			if(!atcmd_record_is_erased(buf, n))
+				break;
+		}
+		if(left){
+			store->addr[legacy[i].id] = sector0 + legacy[i].offset;
+			store->len[legacy[i].id] = legacy[i].len;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Copy the record of id to data, the bytes beyond the record read as erased
+ * flash (0xFF) like the legacy layout did.
+ *
+ * @return length of the record, 0 if there is none, -1 if id is invalid
+ */
+int atcmd_record_read(struct atcmd_record_store *store, u8 id, u8 *data, u16 len)
+{
+	u16 n;
+
+	if(id >= ATCMD_RECORD_ID_MAX)
+		return -1;
+
+	n = store->addr[id] ? store->len[id] : 0;
+	if(n > len)
+		n = len;
+	if(n)
+		store->flash->read(store->addr[id], n, data);
+	memset(data + n, 0xFF, len - n);
+	return store->addr[id] ? store->len[id] : 0;
+}
+
+static int atcmd_record_same(struct atcmd_record_store *store, u8 id, const u8 *data, u16 len)
+{
+	u8 buf[ATCMD_RECORD_CHUNK];
+	u32 addr = store->addr[id], n;
+
+	if(addr == 0)
+		return (len == 0);
+	if(store->len[id] != len)
+		return 0;
+	while(len){
+		n = (len > sizeof(buf)) ? sizeof(buf) : len;
+		store->flash->read(addr, n, buf);
+		if(memcmp(buf, data, n))
+			return 0;
+		addr += n;
+		data += n;
+		len -= n;
+	}
+	return 1;
+}
+
+/*
+ * Move the live records, except id, to the other sector followed by the new
+ * record of id (none if len is 0), then hand the active role over.
+ */
+static int atcmd_record_compact(struct atcmd_record_store *store, u8 id, const u8 *data, u16 len)
+{
+	u8 to = store->active ? 0 : 1, buf[ATCMD_RECORD_CHUNK], hdr[ATCMD_RECORD_HDR_LEN];
+	u32 base = store->sector[to], off = ATCMD_RECORD_HDR_LEN, addr[ATCMD_RECORD_ID_MAX];
+	u32 seq = store->seq + 1, src, n, left;
+	int i;
+
+	for(i = 0; i < ATCMD_RECORD_ID_MAX; i++){
+		if(store->addr[i] && (i != id))
+			off += ATCMD_RECORD_SIZE(store->len[i]);
+	}
+	if(len)
+		off += ATCMD_RECORD_SIZE(len);
+	if(off > ATCMD_RECORD_SECTOR_SIZE)
+		return -1;
+
+	if(store->flash->erase(base) < 0)
+		return -1;
+	store->compactions++;
+
+	off = ATCMD_RECORD_HDR_LEN;
+	for(i = 0; i < ATCMD_RECORD_ID_MAX; i++){
+		addr[i] = 0;
+		if((store->addr[i] == 0) || (i == id))
+			continue;
+		src = store->addr[i];
+		atcmd_record_put_hdr(store, base + off, (u8)i, store->len[i],
+			atcmd_record_crc_flash(store, (u8)i, src, store->len[i]));
+		addr[i] = base + off + ATCMD_RECORD_HDR_LEN;
+		for(left = store->len[i]; left; left -= n, src += n){
+			n = (left > sizeof(buf)) ? sizeof(buf) : left;
+			store->flash->read(src, n, buf);
+			store->flash->write(addr[i] + (store->len[i] - left), n, buf);
+		}
+		off += ATCMD_RECORD_SIZE(store->len[i]);
+	}
+	if(len){
+		atcmd_record_put_hdr(store, base + off, id, len, atcmd_record_crc16(atcmd_record_crc_start(id, len), data, len));
+		addr[id] = base + off + ATCMD_RECORD_HDR_LEN;
+		store->flash->write(addr[id], len, data);
+		off += ATCMD_RECORD_SIZE(len);
+	}
+
+	/* complete, the sector header makes it the active one */
+	if(seq == 0)
+		seq = 1;
+	hdr[0] = (u8)seq;
+	hdr[1] = (u8)(seq >> 8);
+	hdr[2] = (u8)(seq >> 16);
+	hdr[3] = (u8)(seq >> 24);
+	hdr[4] = (u8)ATCMD_RECORD_SECTOR_MAGIC;
+	hdr[5] = (u8)(ATCMD_RECORD_SECTOR_MAGIC >> 8);
+	hdr[6] = (u8)(ATCMD_RECORD_SECTOR_MAGIC >> 16);
+	hdr[7] = (u8)(ATCMD_RECORD_SECTOR_MAGIC >> 24);
+	store->flash->write(base, 4, hdr);
+	store->flash->write(base + 4, 4, hdr + 4);
+
+	store->active = to;
+	store->seq = seq;
+	store->tail = off;
+	for(i = 0; i < ATCMD_RECORD_ID_MAX; i++){
+		store->addr[i] = addr[i];
+		if(addr[i] == 0)
+			store->len[i] = 0;
+	}
+	if(len)
+		store->len[id] = len;
+	return 0;
+}
+
+/**
+ * Store a new version of the record of id, nothing is written if it did not
+ * change.
+ *
+ * @param len 0 deletes the record
+ * @return 0, -1 if the arguments are invalid, the live records do not fit
+ *         in a sector or the flash failed
+ */
+int atcmd_record_write(struct atcmd_record_store *store, u8 id, const u8 *data, u16 len)
+{
+	u32 off = store->tail;
+	u16 crc;
+
+	if((id >= ATCMD_RECORD_ID_MAX) || (len > ATCMD_RECORD_LEN_MAX) || (len && (data == NULL)))
+		return -1;
+	if(atcmd_record_same(store, id, data, len))
+		return 0;
+
+	if((store->seq == 0) || (off + ATCMD_RECORD_SIZE(len) > ATCMD_RECORD_SECTOR_SIZE))
+		return atcmd_record_compact(store, id, data, len);
+
+	crc = atcmd_record_crc16(atcmd_record_crc_start(id, len), data, len);
+	if(atcmd_record_put_hdr(store, store->sector[store->active] + off, id, len, crc) < 0)
+		return -1;
+	if(len && (store->flash->write(store->sector[store->active] + off + ATCMD_RECORD_HDR_LEN, len, data) < 0))
+		return -1;
+	store->addr[id] = len ? (store->sector[store->active] + off + ATCMD_RECORD_HDR_LEN) : 0;
+	store->len[id] = len;
+	store->tail = off + ATCMD_RECORD_SIZE(len);
+	store->appends++;
+	return 0;
+}
+
+/* delete every record, one sector erase */
+int atcmd_record_clear(struct atcmd_record_store *store)
+{
+	memset(store->addr, 0, sizeof(store->addr));
+	memset(store->len, 0, sizeof(store->len));
+	return atcmd_record_compact(store, ATCMD_RECORD_ID_MAX, NULL, 0);
+}
@@ -0,0 +1,76 @@
+#ifndef __ATCMD_RECORD_H__
+#define __ATCMD_RECORD_H__
+
+/******************************************************************************
+ *
+ * Append-only record store of the AT command settings (UART, Wi-Fi and
+ * auto-connect records of AT_PARTITION).
+ *
+ * Two flash sectors take turns. The active one starts with a header holding
+ * a sequence number and is followed by records appended one after another:
+ *
+ *   +-----+-----+--------+--------+--------+-------
+ *   | seq | ATRS| record | record | record | 0xFF...
+ *   +-----+-----+--------+--------+--------+-------
+ *
+ *   record: | magic | id | - | len | crc | data[len] | pad to 4 |
+ *              2      1   1    2     2
+ *
+ * A change appends the new version of the record, the last valid record of
+ * an id wins and len 0 deletes the id. The index of the newest record of
+ * each id is kept in RAM, built by one scan when mounted. When the active
+ * sector is full, the live records are compacted into the other sector,
+ * whose header is written last so it only takes over once complete. A
+ * change costs one append, a sector is erased once per compaction.
+ * A record torn by a power loss fails its crc and is dropped with the
+ * records after it by the next compaction.
+ *
+ * Until the first write, a store found without any valid header reads the
+ * records of the legacy layout (fixed offsets in the first sector) in place.
+ *
+ * The store has no OS dependency, the flash is reached through
+ * struct atcmd_record_flash, and it is shared by the UART AT example and
+ * the host side test in tools/atcmd_record_sim.
+ *
+ ******************************************************************************/
+#include "basic_types.h"
+
+#define ATCMD_RECORD_SECTOR_SIZE	0x1000
+#define ATCMD_RECORD_ID_MAX			8
+#define ATCMD_RECORD_HDR_LEN		8		// sector and record header
+#define ATCMD_RECORD_LEN_MAX		(ATCMD_RECORD_SECTOR_SIZE - 2 * ATCMD_RECORD_HDR_LEN)
+
+struct atcmd_record_flash {
+	int (*read)(u32 addr, u32 len, u8 *data);
+	int (*write)(u32 addr, u32 len, const u8 *data);	// programs 1 bits to 0 only
+	int (*erase)(u32 addr);								// one sector
+};
+
+/* a record of the legacy layout, at sector[0] + offset */
+struct atcmd_record_legacy {
+	u8 id;
+	u16 offset;
+	u16 len;
+};
+
+struct atcmd_record_store {
+	const struct atcmd_record_flash *flash;
+	u32 sector[2];
+	u8 active;					// index into sector[]
+	u32 seq;					// of the active sector, 0 if not formatted yet
+	u32 tail;					// offset of the first free byte in the active sector
+	u32 addr[ATCMD_RECORD_ID_MAX];	// data of the newest record, 0 if none
+	u16 len[ATCMD_RECORD_ID_MAX];
+	/* statistics */
+	u32 appends;
+	u32 compactions;			// = sector erases
+	u32 torn;					// invalid records found when mounted
+};
+
+int atcmd_record_mount(struct atcmd_record_store *store, const struct atcmd_record_flash *flash,
+	u32 sector0, u32 sector1, const struct atcmd_record_legacy *legacy, int legacy_num);
+int atcmd_record_read(struct atcmd_record_store *store, u8 id, u8 *data, u16 len);
+int atcmd_record_write(struct atcmd_record_store *store, u8 id, const u8 *data, u16 len);
+int atcmd_record_clear(struct atcmd_record_store *store);
+
+#endif //#ifndef __ATCMD_RECORD_H__
@@ -0,0 +1,121 @@
+/******************************************************************************
+ *
+ * SPI AT transport link layer, see atcmd_spi.h for the transaction layout.
+ *
+ * Headers are built and checked here, frames are packed into a batch in
+ * place: the caller writes a payload where atspi_batch_room() points and
+ * atspi_batch_add() seals it with atframe_seal(), so a batch is transmitted
+ * by DMA straight from the buffer it was built in.
+ *
+ ******************************************************************************/
+#include <string.h>
+#include "atcmd_spi.h"
+
+static u8 atspi_hcs(const u8 *hdr)
+{
+	u8 hcs = 0;
+	int i;
+
+	for(i = 1; i < ATSPI_HDR_LEN - 1; i++)
+		hcs ^= hdr[i];
+	return (u8)~hcs;
+}
+
+void atspi_hdr_encode(u8 *out, const struct atspi_hdr *hdr)
+{
+	out[0] = ATSPI_MAGIC;
+	out[1] = hdr->flags;
+	out[2] = hdr->seq;
+	out[3] = hdr->credit;
+	out[4] = (u8)hdr->len;
+	out[5] = (u8)(hdr->len >> 8);
+	out[6] = 0;
+	out[7] = atspi_hcs(out);
+}
+
+/**
+ * @return 0, -1 if the header fails its check or announces too much
+ */
+int atspi_hdr_decode(const u8 *in, struct atspi_hdr *hdr)
+{
+	if((in[0] != ATSPI_MAGIC) || (in[7] != atspi_hcs(in)))
+		return -1;
+	hdr->flags = in[1];
+	hdr->seq = in[2];
+	hdr->credit = in[3];
+	hdr->len = (u16)(in[4] | (in[5] << 8));
+	if(hdr->len > ATSPI_XFER_MAX)
+		return -1;
+	return 0;
+}
+
+/**
+ * Length of phase 2, computed the same way on both sides from the two
+ * headers of phase 1.
+ */
+u16 atspi_xfer_len(const struct atspi_hdr *master, const struct atspi_hdr *slave)
+{
+	u16 len = master->len;
+
+	if(master->credit && (slave->len > len))
+		len = slave->len;
+	return (u16)((len + ATSPI_ALIGN - 1) & ~(ATSPI_ALIGN - 1));
+}
+
+void atspi_batch_reset(struct atspi_batch *batch, u8 *buf, u16 size)
+{
+	batch->buf = buf;
+	batch->size = size;
+	batch->len = 0;
+	batch->frames = 0;
+}
+
+/**
+ * Where the payload of the next frame goes.
+ *
+ * @param len: the largest payload that still fits
+ * @return NULL if not even an empty frame fits
+ */
+u8 *atspi_batch_room(struct atspi_batch *batch, u16 *len)
+{
+	u16 left = batch->size - batch->len;
+
+	if(left < ATFRAME_OVERHEAD){
+		*len = 0;
+		return NULL;
+	}
+	*len = left - ATFRAME_OVERHEAD;
+	return batch->buf + batch->len + ATFRAME_HDR_LEN;
+}
+
+/**
+ * Seal the frame whose payload was written at atspi_batch_room().
+ *
+ * @return frame length, 0 if it does not fit
+ */
+u16 atspi_batch_add(struct atspi_batch *batch, u8 type, u8 seq, u16 len)
+{
+	u16 room;
+
+	if((atspi_batch_room(batch, &room) == NULL) || (len > room))
+		return 0;
+	len = atframe_seal(batch->buf + batch->len, type, seq, len);
+	batch->len += len;
+	batch->frames++;
+	return len;
+}
+
+/**
+ * Zero the buffer from the end of the frames up to xfer_len, the bytes
+ * phase 2 clocks out beyond the batch.
+ *
+ * @return xfer_len, clipped to the buffer size
+ */
+u16 atspi_batch_pad(struct atspi_batch *batch, u16 xfer_len)
+{
+	if(xfer_len > batch->size)
+		xfer_len = batch->size;
+	if(xfer_len > batch->len)
+		memset(batch->buf + batch->len, 0, xfer_len - batch->len);
+	return xfer_len;
+}
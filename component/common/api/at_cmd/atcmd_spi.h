@@ -0,0 +1,93 @@
+#ifndef __ATCMD_SPI_H__
+#define __ATCMD_SPI_H__
+
+/******************************************************************************
+ *
+ * SPI AT transport link layer. The device is the SPI slave, the host MCU the
+ * master, and every exchange is a transaction of two full duplex phases:
+ *
+ *   phase 1: ATSPI_HDR_LEN bytes, both sides send their header
+ *   phase 2: atspi_xfer_len() bytes, both sides send their batch, skipped
+ *            when it is 0
+ *
+ *   header: | magic | flags | seq | credit | len(LE) | - | hcs |
+ *               1       1      1      1        2      1    1
+ *
+ *   magic:  ATSPI_MAGIC
+ *   seq:    transaction counter of the sender, a gap shows a lost one
+ *   credit: slave -> master, receive buffers free: the master sends no more
+ *           frames than the credit of the previous transaction's header
+ *           minus the frames it sent in that transaction, frames beyond it
+ *           are rejected with NAK BUSY
+ *           master -> slave, 0 when it cannot take the slave batch now,
+ *           the slave then keeps it for a later transaction
+ *   len:    bytes of the sender's batch, at most ATSPI_XFER_MAX
+ *   hcs:    ~(XOR of bytes 1..6)
+ *
+ * A batch is a sequence of complete frames of atcmd_frame.h (CMD/RSP/EVT/
+ * NAK, and DATA carrying socket payloads without any escaping). Phase 2 is
+ * padded with zeros up to the longer batch, a receiver parses the first len
+ * bytes only.
+ *
+ * Two GPIOs from the slave complete the SPI lines:
+ *
+ *   RDY: rises when the slave armed the DMA of the next phase, falls when
+ *        the phase was clocked. The master clocks a phase only after a
+ *        rising edge seen since it clocked the previous one.
+ *   INT: high while the slave has output queued or its credit went up from
+ *        0, the master then runs transactions until it drops. A header armed
+ *        before the output was queued announces nothing, INT stays high.
+ *
+ * A header failing its check drops the transaction, both sides keep their
+ * batch and announce it again:
+ *
+ *   - the slave does not arm phase 2. It keeps RDY low for ATSPI_RESYNC_MS,
+ *     resets the SPI and arms phase 1 again.
+ *   - the master does not clock phase 2 when the slave header is bad or RDY
+ *     did not rise within ATSPI_ARM_MS. It waits ATSPI_ARM_MS more, then for
+ *     RDY low and rising again: a slave left in phase 2 gives up after its
+ *     timeout and resynchronizes the same way.
+ *
+ * A frame damaged in phase 2 fails its CRC, a CMD or DATA frame is NAKed.
+ *
+ * The layer has no OS dependency and is shared by the SPI AT example and the
+ * host side master simulator in tools/atcmd_spi_sim.
+ *
+ ******************************************************************************/
+#include "basic_types.h"
+#include "atcmd_frame.h"
+
+#define ATSPI_MAGIC				0xA6
+#define ATSPI_HDR_LEN			8
+#define ATSPI_ALIGN				4		// phase 2 length granularity, for the DMA
+#define ATSPI_XFER_MAX			4096	// batch size, both sides
+#define ATSPI_ARM_MS			2		// the slave arms the next phase within this time
+#define ATSPI_RESYNC_MS			10		// RDY low after a bad header, > ATSPI_ARM_MS
+
+/* header flags */
+#define ATSPI_F_MORE			0x01	// more output queued behind this batch
+
+struct atspi_hdr {
+	u8 flags;
+	u8 seq;
+	u8 credit;
+	u16 len;
+};
+
+struct atspi_batch {
+	u8 *buf;
+	u16 size;
+	u16 len;		// bytes of the frames added
+	u16 frames;
+};
+
+void atspi_hdr_encode(u8 *out, const struct atspi_hdr *hdr);
+int atspi_hdr_decode(const u8 *in, struct atspi_hdr *hdr);
+u16 atspi_xfer_len(const struct atspi_hdr *master, const struct atspi_hdr *slave);
+
+void atspi_batch_reset(struct atspi_batch *batch, u8 *buf, u16 size);
+u8 *atspi_batch_room(struct atspi_batch *batch, u16 *len);
+u16 atspi_batch_add(struct atspi_batch *batch, u8 type, u8 seq, u16 len);
+u16 atspi_batch_pad(struct atspi_batch *batch, u16 xfer_len);
+
+#endif //#ifndef __ATCMD_SPI_H__
@@ -1368,6 +1368,7 @@ void fATSh(void *arg){
 
 void fATSR(void *arg){
 	at_printf("\r\n[ATSR] OK");
+	at_print_flush();
 	sys_reset();
 }
 
@@ -1502,6 +1503,7 @@ void fATSY(void *arg){
 	
 	at_printf("\r\n[ATSY] OK");
 	// reboot
+	at_print_flush();
 	sys_reset();
 }
 
@@ -1565,6 +1567,7 @@ void fATSC(void *arg){
 		cmd_ota_image(0);
 	}
 	// reboot
+	at_print_flush();
 	sys_reset();
 }
 #endif
@@ -1649,6 +1652,41 @@ void fATSU(void *arg){
 	
 	at_printf("\r\n[ATSU] OK");
 }
+
+extern int atcmd_lwip_is_tt_mode(void);
+void fATSF(void *arg){
+	int argc = 0;
+	char *argv[MAX_ARGC] = {0};
+	int enable;
+
+	if(!arg || ((argc = parse_param(arg, argv)) != 2)){
+		AT_DBG_MSG(AT_FLAG_COMMON, AT_DBG_ERROR, 
+		"[ATSF] Usage: ATSF=<0:text mode|1:binary framed mode>");
+		at_printf("\r\n[ATSF] ERROR:1");
+		return;
+	}
+
+	enable = atoi(argv[1]);
+	if((enable != 0 && enable != 1) || atcmd_lwip_is_tt_mode()){
+		at_printf("\r\n[ATSF] ERROR:2");
+		return;
+	}
+
+	if(enable){
+		if(uart_at_frame_init() < 0){
+			at_printf("\r\n[ATSF] ERROR:3");
+			return;
+		}
+		/* reply in text, the host switches to frames after it */
+		at_printf("\r\n[ATSF] OK");
+		uart_at_frame_start();
+	}
+	else{
+		/* leave once this response frame has been sent */
+		uart_at_frame_stop_request();
+		at_printf("\r\n[ATSF] OK");
+	}
+}
 #endif //#if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
 #endif //#if CONFIG_WLAN
 
@@ -1854,6 +1892,7 @@ log_item_t at_sys_items[] = {
 #endif
 #if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
 	{"ATSU", fATSU,},	// AT uart configuration
+	{"ATSF", fATSF,},	// binary framed AT mode
 #endif
 #endif
 	{"ATSG", fATSG,},	// GPIO control
@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ * Transparent transmission buffer ring, see atcmd_tt_ring.h.
+ *
+ * head and tail count buffers and wrap around 2^32 on their own, the slot of
+ * a count is count % num. head - tail is the number of committed buffers,
+ * the buffer the producer fills next is always the slot of head.
+ *
+ ******************************************************************************/
+#include <string.h>
+#include "atcmd_tt_ring.h"
+
+/**
+ * @param mem num * size bytes, owned by the caller
+ * @return 0, -1 if num or size is out of range
+ */
+int atcmd_tt_ring_init(struct atcmd_tt_ring *ring, u8 *mem, u16 num, u16 size)
+{
+	/* one buffer receives while another is sent, at least */
+	if((mem == NULL) || (num < 2) || (num > ATCMD_TT_RING_MAX) || (size == 0))
+		return -1;
+
+	memset(ring, 0, sizeof(struct atcmd_tt_ring));
+	ring->mem = mem;
+	ring->num = num;
+	ring->size = size;
+	return 0;
+}
+
+static u8 *atcmd_tt_ring_slot(struct atcmd_tt_ring *ring, u32 count)
+{
+	return ring->mem + (u32)(count % ring->num) * ring->size;
+}
+
+/**
+ * Producer: the buffer to receive into next, ring->size bytes.
+ *
+ * @return NULL if every buffer is committed and not yet released
+ */
+u8 *atcmd_tt_ring_fill(struct atcmd_tt_ring *ring)
+{
+	if((u32)(ring->head - ring->tail) >= ring->num){
+		ring->stalls++;
+		return NULL;
+	}
+	return atcmd_tt_ring_slot(ring, ring->head);
+}
+
+/**
+ * Producer: hand the buffer returned by atcmd_tt_ring_fill() to the
+ * consumer with len valid bytes.
+ */
+void atcmd_tt_ring_commit(struct atcmd_tt_ring *ring, u16 len, u8 flags)
+{
+	u32 slot = ring->head % ring->num;
+
+	ring->len[slot] = len;
+	ring->flags[slot] = flags;
+	ring->bytes += len;
+	if(len < ring->size)
+		ring->flushes++;
+	ring->head++;
+}
+
+/**
+ * Consumer: the oldest committed buffer, it stays valid until
+ * atcmd_tt_ring_release().
+ *
+ * @return NULL if nothing is committed
+ */
+u8 *atcmd_tt_ring_peek(struct atcmd_tt_ring *ring, u16 *len, u8 *flags)
+{
+	u32 slot;
+
+	if(ring->head == ring->tail)
+		return NULL;
+	slot = ring->tail % ring->num;
+	*len = ring->len[slot];
+	if(flags)
+		*flags = ring->flags[slot];
+	return atcmd_tt_ring_slot(ring, ring->tail);
+}
+
+/**
+ * Consumer: give the buffer returned by atcmd_tt_ring_peek() back.
+ */
+void atcmd_tt_ring_release(struct atcmd_tt_ring *ring)
+{
+	if(ring->head != ring->tail)
+		ring->tail++;
+}
+
+/* committed buffers */
+u16 atcmd_tt_ring_count(struct atcmd_tt_ring *ring)
+{
+	return (u16)(ring->head - ring->tail);
+}
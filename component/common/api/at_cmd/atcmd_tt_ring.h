@@ -0,0 +1,53 @@
+#ifndef __ATCMD_TT_RING_H__
+#define __ATCMD_TT_RING_H__
+
+/******************************************************************************
+ *
+ * Buffer ring of the transparent transmission (TT) mode.
+ *
+ * The UART receives by DMA straight into the buffer at head while the TT
+ * task sends the buffers between tail and head to the socket:
+ *
+ *   tail                head
+ *    |                   |
+ *   [sending][committed][DMA filling][free]...
+ *
+ * Only the producer moves head and only the consumer moves tail, so no lock
+ * is needed between the DMA completion interrupt and the TT task. A buffer
+ * is committed either full (DMA done) or partial (flushed when the line went
+ * quiet). When every buffer is committed the producer has nowhere to receive
+ * and must hold the sender off (RTS) until the consumer releases one.
+ *
+ * The ring has no OS dependency and is shared by the device transport and
+ * the host side simulator in tools/atcmd_tt_sim.
+ *
+ ******************************************************************************/
+#include "basic_types.h"
+
+#define ATCMD_TT_RING_MAX		8
+
+/* commit flags */
+#define ATCMD_TT_F_IDLE			0x01	// the buffer before was flushed, the line had paused
+
+struct atcmd_tt_ring {
+	u8 *mem;				// num * size bytes
+	u16 num;
+	u16 size;
+	volatile u32 head;		// buffers committed, producer only
+	volatile u32 tail;		// buffers released, consumer only
+	u16 len[ATCMD_TT_RING_MAX];
+	u8 flags[ATCMD_TT_RING_MAX];
+	/* statistics */
+	u32 bytes;				// committed
+	u32 flushes;			// partial buffers
+	u32 stalls;				// times the producer found the ring full
+};
+
+int atcmd_tt_ring_init(struct atcmd_tt_ring *ring, u8 *mem, u16 num, u16 size);
+u8 *atcmd_tt_ring_fill(struct atcmd_tt_ring *ring);
+void atcmd_tt_ring_commit(struct atcmd_tt_ring *ring, u16 len, u8 flags);
+u8 *atcmd_tt_ring_peek(struct atcmd_tt_ring *ring, u16 *len, u8 *flags);
+void atcmd_tt_ring_release(struct atcmd_tt_ring *ring);
+u16 atcmd_tt_ring_count(struct atcmd_tt_ring *ring);
+
+#endif //#ifndef __ATCMD_TT_RING_H__
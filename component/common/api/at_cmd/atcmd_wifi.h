@@ -142,6 +142,18 @@ extern unsigned char gAT_Echo; // default echo on
 //extern void uart_at_unlock(void);
 extern void uart_at_send_string(char *str);
 extern void uart_at_send_buf(u8 *buf, u32 len);
+extern int uart_at_frame_init(void);
+extern void uart_at_frame_start(void);
+extern void uart_at_frame_stop_request(void);
+extern int uart_at_frame_is_active(void);
+struct atcmd_tt_ring;
+extern struct atcmd_tt_ring *uart_at_tt_start(void);
+extern void uart_at_tt_flush(void);
+extern void uart_at_tt_release(void);
+extern void uart_at_tt_stop(void);
+extern void uart_at_tx_drain(void);
+extern void uart_at_resp_begin(void);
+extern void uart_at_resp_end(void);
 
 #define at_printf(fmt, args...)  do{\
 			/*uart_at_lock();*/\
@@ -154,6 +166,8 @@ extern void uart_at_send_buf(u8 *buf, u32 len);
 			uart_at_send_buf(data, size);\
 			/*uart_at_unlock();*/\
 	}while(0)
+//wait until queued output has left the UART, before a reset or UART reconfiguration
+#define at_print_flush()	uart_at_tx_drain()
 
 #elif (defined(CONFIG_EXAMPLE_SPI_ATCMD) && (CONFIG_EXAMPLE_SPI_ATCMD))
 
@@ -206,8 +220,10 @@ typedef enum {
 	AT_PARTITION_ERASE = 2
 } AT_PARTITION_OP;
 
-//first segment for uart
+//first segment for spi
+#if !defined(SPI_SETTING_BACKUP_SECTOR)
 #define SPI_SETTING_BACKUP_SECTOR		(0x8000)
+#endif
 #define SPI_CONF_DATA_OFFSET			(0)
 #define SPI_CONF_DATA_SIZE				((((sizeof(SPI_LOG_CONF)-1)>>2) + 1)<<2)
 
@@ -226,6 +242,7 @@ extern char at_string[ATSTRING_LEN];
 
 extern void spi_at_send_string(char *str);
 extern void spi_at_send_buf(u8 *buf, u32 len);
+extern int spi_at_data_send(int con_id, u8 *data, u32 len);
 
 #define at_printf(fmt, args...)  do{\
 			/*spi_at_lock();*/\
@@ -238,11 +255,13 @@ extern void spi_at_send_buf(u8 *buf, u32 len);
 			spi_at_send_buf(data, size);\
 			/*spi_at_unlock();*/\
 	}while(0)
+#define at_print_flush()	do{}while(0)
 
 #else // #elif CONFIG_EXAMPLE_SPI_ATCMD
           
 #define at_printf(fmt, args...) do{printf(fmt, ##args);}while(0)
 #define at_print_data(data, size) do{__rtl_memDump(data, size, NULL);}while(0)
+#define at_print_flush()	do{}while(0)
 #endif//#if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
 
 #endif
@@ -0,0 +1,170 @@
+/******************************************************************************
+ *
+ * Command line helpers of the log service, see log_line.h.
+ *
+ ******************************************************************************/
+#include <string.h>
+#include "log_line.h"
+
+static int log_line_is_sep(char c)
+{
+	return (c == ',') || (c == '[') || (c == ']');
+}
+
+/**
+ * Split the parameters of an AT command in place, as parse_param() always
+ * did: argv[0] is left to the caller, argv[1..] point into buf.
+ *
+ * @param argv_size: entries of argv, parsing stops when it is full
+ * @return argc, 1 when there is no parameter
+ */
+int log_line_tokenize(char *buf, char **argv, int argv_size)
+{
+	char *rd = buf, *wr;
+	int argc = 1;
+	int end;
+
+	if(buf == NULL)
+		return argc;
+
+	while((argc < argv_size) && (*rd != '\0')){
+		while(log_line_is_sep(*rd)){
+			if((*rd == ',') && (rd[1] == ',') && (argc < argv_size))
+				argv[argc++] = NULL;
+			*rd++ = '\0';
+		}
+		if((*rd == '\0') || (argc >= argv_size))
+			break;
+
+		if(*rd == '"'){
+			*rd++ = '\0';
+			if(*rd == '\0')
+				break;
+			/* unescape towards the front, wr never passes rd */
+			argv[argc++] = wr = rd;
+			while((*rd != '"') && (*rd != '\0')){
+				if((*rd == '\\') && (rd[1] != '\0'))
+					rd++;
+				*wr++ = *rd++;
+			}
+			end = (*rd == '\0');
+			*wr = '\0';
+			if(end)
+				break;
+			rd++;
+		}
+		else
+			argv[argc++] = rd++;
+
+		/* the rest up to the separator belongs to this parameter, or is dropped after a quote */
+		while((*rd != '\0') && !log_line_is_sep(*rd))
+			rd++;
+	}
+	if(log_line_is_sep(*rd))
+		*rd = '\0';
+	return argc;
+}
+
+static u16 log_history_next(struct log_history *h, u16 pos)
+{
+	return (u16)((pos + 1 == h->size) ? 0 : pos + 1);
+}
+
+static u16 log_history_prev(struct log_history *h, u16 pos)
+{
+	return (u16)(pos ? pos - 1 : h->size - 1);
+}
+
+void log_history_init(struct log_history *h, char *buf, u16 size)
+{
+	h->buf = buf;
+	h->size = size;
+	h->head = 0;
+	h->used = 0;
+	h->count = 0;
+}
+
+static void log_history_drop_oldest(struct log_history *h)
+{
+	u16 pos = (u16)((h->head + h->size - h->used) % h->size);
+	char c;
+
+	do{
+		c = h->buf[pos];
+		pos = log_history_next(h, pos);
+		h->used--;
+	}while(c != '\0');
+	h->count--;
+}
+
+/* ring position where line n starts, 0 the latest */
+static int log_history_find(struct log_history *h, u16 n)
+{
+	u16 pos = h->head, walked = 0;
+
+	if(n >= h->count)
+		return -1;
+	while(1){
+		/* pos is just past the '\0' of the line, walk back over it and the text */
+		pos = log_history_prev(h, pos);
+		walked++;
+		while((walked < h->used) && (h->buf[log_history_prev(h, pos)] != '\0')){
+			pos = log_history_prev(h, pos);
+			walked++;
+		}
+		if(n-- == 0)
+			return pos;
+	}
+}
+
+/**
+ * Keep a command line, dropping the oldest ones to make room. A line equal
+ * to the latest one is not kept twice.
+ *
+ * @return 0, -1 if the line is empty or larger than the ring
+ */
+int log_history_add(struct log_history *h, const char *line)
+{
+	u32 len = strlen(line), i;
+	int pos;
+
+	if((len == 0) || (len + 1 > h->size))
+		return -1;
+
+	if((pos = log_history_find(h, 0)) >= 0){
+		for(i = 0; (i <= len) && (h->buf[pos] == line[i]); i++)
+			pos = log_history_next(h, (u16)pos);
+		if(i > len)
+			return 0;
+	}
+
+	while(h->used + len + 1 > h->size)
+		log_history_drop_oldest(h);
+	for(i = 0; i <= len; i++){
+		h->buf[h->head] = line[i];
+		h->head = log_history_next(h, h->head);
+	}
+	h->used = (u16)(h->used + len + 1);
+	h->count++;
+	return 0;
+}
+
+/**
+ * Copy line n out of the ring, 0 the latest, truncated to out_size - 1.
+ *
+ * @return length copied, -1 if there are not that many lines
+ */
+int log_history_get(struct log_history *h, u16 n, char *out, u16 out_size)
+{
+	int pos = log_history_find(h, n);
+	int len = 0;
+
+	if((pos < 0) || (out_size == 0))
+		return -1;
+	while((h->buf[pos] != '\0') && (len < out_size - 1)){
+		out[len++] = h->buf[pos];
+		pos = log_history_next(h, (u16)pos);
+	}
+	out[len] = '\0';
+	return len;
+}
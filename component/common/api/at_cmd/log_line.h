@@ -0,0 +1,39 @@
+#ifndef __LOG_LINE_H__
+#define __LOG_LINE_H__
+
+/******************************************************************************
+ *
+ * Command line helpers of the log service, working in the caller's buffers
+ * without copies or allocation:
+ *
+ *   - log_line_tokenize(): splits AT parameters in place. Parameters are
+ *     separated by ',', '[' or ']', ",," gives a NULL parameter. A parameter
+ *     starting with '"' runs to the next '"', a '\' in it takes the next
+ *     character as is (\" \, \\), the text is unescaped where it stands.
+ *   - struct log_history: the latest command lines packed into one byte
+ *     ring, each ending with '\0'. Adding a line drops the oldest ones it
+ *     overwrites, so short commands keep more history than a fixed number
+ *     of LOG_SERVICE_BUFLEN slots.
+ *
+ * There is no OS dependency and no locking, every ring has one user (the
+ * log service task, the console RX interrupt). Checked on the host by
+ * tools/log_line_fuzz.
+ *
+ ******************************************************************************/
+#include "basic_types.h"
+
+int log_line_tokenize(char *buf, char **argv, int argv_size);
+
+struct log_history {
+	char *buf;
+	u16 size;
+	u16 head;		// where the next line goes
+	u16 used;		// bytes of the lines held, '\0' included
+	u16 count;		// lines held
+};
+
+void log_history_init(struct log_history *h, char *buf, u16 size);
+int log_history_add(struct log_history *h, const char *line);
+int log_history_get(struct log_history *h, u16 n, char *out, u16 out_size);
+
+#endif //#ifndef __LOG_LINE_H__
@@ -6,6 +6,7 @@
 #include "freertos_pmu.h"
 #endif
 #include "log_service.h"
+#include "log_line.h"
 #include "task.h"
 #include "semphr.h"
 #include "main.h"
@@ -19,6 +20,9 @@
 #if SUPPORT_LOG_SERVICE
 //======================================================
 struct list_head log_hash[ATC_INDEX_NUM];
+#if CONFIG_LOG_SERVICE_PHASH
+static int log_hash_count = 0;	// commands not covered by the generated table
+#endif
 
 extern void at_wifi_init(void);
 extern void at_fs_init(void);
@@ -39,8 +43,8 @@ void at_log_init(void);
 
 char log_buf[LOG_SERVICE_BUFLEN];
 #if CONFIG_LOG_HISTORY
-char log_history[LOG_HISTORY_LEN][LOG_SERVICE_BUFLEN];
-static unsigned int log_history_count = 0;
+static char log_history_buf[LOG_HISTORY_SIZE];
+static struct log_history log_history;
 #endif
 xSemaphoreHandle log_rx_interrupt_sema = NULL;
 #if CONFIG_LOG_SERVICE_LOCK
@@ -110,21 +114,6 @@ extern unsigned int __log_init_begin__;
 extern unsigned int __log_init_end__;
 #endif
 
-#if defined(__GNUC__) || defined(CONFIG_PLATFORM_8710C)
-#define USE_STRSEP
-
-#if defined(CONFIG_PLATFORM_8710C)
-#if defined(CONFIG_BUILD_NONSECURE)
-#if !defined(__GNUC__)
-#include "strproc.h"
-#endif
-#define _strsep strsep
-#else
-#undef USE_STRSEP
-#endif
-#endif
-#endif
-
 //======================================================
 int hash_index(char *str)
 {
@@ -144,6 +133,9 @@ void log_add_new_command(log_item_t *new)
 	int index = hash_index(new->log_cmd)%ATC_INDEX_NUM;
 	
 	list_add(&new->node, &log_hash[index]);
+#if CONFIG_LOG_SERVICE_PHASH
+	log_hash_count++;
+#endif
 }
 void start_log_service(void);
 void log_service_init(void)
@@ -166,6 +158,9 @@ void log_service_init(void)
 	
 	for(i=0;i<ATC_INDEX_NUM;i++)
 		INIT_LIST_HEAD(&log_hash[i]);
+#if CONFIG_LOG_HISTORY
+	log_history_init(&log_history, log_history_buf, sizeof(log_history_buf));
+#endif
 	
 	for(i=0;i<(unsigned int)(__log_init_end__-__log_init_begin__); i++)
 		log_init_table[i]();
@@ -183,19 +178,32 @@ void log_service_init(void)
 void log_service_add_table(log_item_t *tbl, int len)
 {
 	int i;
-	for(i=0;i<len;i++)
+	for(i=0;i<len;i++){
+#if CONFIG_LOG_SERVICE_PHASH
+		// already resolved by the const table, nothing to register
+		if(log_service_phash_find(tbl[i].log_cmd) == tbl[i].at_act)
+			continue;
+#endif
 		log_add_new_command(&tbl[i]);	
+	}
 }
 
 void* log_action(char *cmd)
 {
 	int search_cnt=0;
-	int index = hash_index(cmd)%ATC_INDEX_NUM;
-	struct list_head *head = &log_hash[index];
+	int index;
+	struct list_head *head;
 	struct list_head *iterator;
 	log_item_t *item;
 	void *act = NULL;
-	
+
+#if CONFIG_LOG_SERVICE_PHASH
+	// tables registered at runtime take precedence, as with the lists alone
+	if(log_hash_count == 0)
+		return (void*)log_service_phash_find(cmd);
+#endif
+	index = hash_index(cmd)%ATC_INDEX_NUM;
+	head = &log_hash[index];
 	list_for_each(iterator, head) {
 		item = list_entry(iterator, log_item_t, node);
 		search_cnt++;
@@ -205,109 +213,50 @@ void* log_action(char *cmd)
 			break;
 		}
 	}
+#if CONFIG_LOG_SERVICE_PHASH
+	if(act == NULL)
+		act = (void*)log_service_phash_find(cmd);
+#endif
 	
 	return act;
 }
 
+/* cmd is split in place, the '=' is put back when it is no AT command */
 void* log_handler(char *cmd)
 {
 	log_act_t action=NULL;
-	char buf[LOG_SERVICE_BUFLEN];
-	memset(buf, 0, LOG_SERVICE_BUFLEN);
-	char *copy=buf;
-	char *token = NULL;
 	char *param = NULL;
-	char tok[5] = {0};//'\0'
+	char *eq;
 #if CONFIG_LOG_HISTORY
-	strcpy(log_history[((log_history_count++)%LOG_HISTORY_LEN)], log_buf);
+	// AT?? itself is not kept, a replay would run it again
+	if(strncmp(cmd, "AT??", C_NUM_AT_CMD) != 0)
+		log_history_add(&log_history, cmd);
 #endif
-	strncpy(copy, cmd,LOG_SERVICE_BUFLEN-1);
 
-#if defined(USE_STRSEP)
-	token = _strsep(&copy, "=");
-	param = copy;
-#else
-	token = strtok(copy, "=");
-	param = strtok(NULL, "\0");
-#endif
-	if(token && (strlen(token) <= 4))
-		strcpy(tok, token);
-	else{
-		//printf("\n\rAT Cmd format error!\n");
-		return NULL;
-	};
-	//printf(" Command %s \n\r ", tok);
+	eq = strchr(cmd, '=');
+	if(eq){
+		*eq = '\0';
+		param = eq + 1;
+	}
+	if(strlen(cmd) <= C_NUM_AT_CMD)
+		action = (log_act_t)log_action(cmd);
+	//printf(" Command %s \n\r ", cmd);
 	//printf(" Param %s \n\r", param);
-	action = (log_act_t)log_action(tok);
-        
+
 	if(action){	
 		action(param);
-	} 
+	}
+	else if(eq){
+		*eq = '=';
+	}
 	return (void*)action;
 
 }
 
+/* split in place, argv[1..] point into buf */
 int parse_param(char *buf, char **argv)
 {
-
-	int argc = 1;
-	char str_buf[LOG_SERVICE_BUFLEN];
-	memset(str_buf, 0, LOG_SERVICE_BUFLEN);
-	int str_count = 0;
-	int buf_cnt = 0;
-    static char temp_buf[LOG_SERVICE_BUFLEN];
-    char *buf_pos = temp_buf;
-    memset(temp_buf, 0, sizeof(temp_buf));
-
-	if(buf == NULL)
-		goto exit;
-	strcpy(temp_buf, buf);
-	
-	while((argc < MAX_ARGC) && (*buf_pos != '\0')) {
-		while((*buf_pos == ',') || (*buf_pos == '[') || (*buf_pos == ']')){
-			if((*buf_pos == ',') && (*(buf_pos+1) == ',')){
-				argv[argc] = NULL;
-				argc++;
-			}
-			*buf_pos = '\0';
-			buf_pos++;
-		}
-
-		if(*buf_pos == '\0')
-			break;
-		else if(*buf_pos == '"'){
-			memset(str_buf,'\0',LOG_SERVICE_BUFLEN);
-			str_count = 0;
-			buf_cnt = 0;
-			*buf_pos = '\0';
-			buf_pos ++;         
-			if(*buf_pos == '\0')
-			break;
-		    argv[argc] = buf_pos;
-			while((*buf_pos != '"')&&(*buf_pos != '\0')){
-				if(*buf_pos == '\\'){
-		        buf_pos ++;
-					buf_cnt++;
-				}
-				str_buf[str_count] = *buf_pos;
-				str_count++;
-				buf_cnt++;
-			    buf_pos ++;
-			}
-			*buf_pos = '\0';
-			memcpy(buf_pos-buf_cnt,str_buf,buf_cnt);
-		}
-		else{
-			argv[argc] = buf_pos;
-		}
-		argc++;
-		buf_pos++;
-
-		while( (*buf_pos != ',')&&(*buf_pos != '\0')&&(*buf_pos != '[')&&(*buf_pos != ']') )
-			buf_pos++;
-	}
-exit:
-	return argc;
+	return log_line_tokenize(buf, argv, MAX_ARGC);
 }
 
 unsigned char  gDbgLevel = AT_DBG_ERROR;
@@ -409,6 +358,26 @@ void log_service_lock_init(void){
 }
 #endif
 
+/* Run one command line through the AT tables, the iwpriv passthrough and help */
+void log_service_exec(char *cmd)
+{
+	if(log_handler(cmd) == NULL){
+#if CONFIG_WLAN
+		if(mp_commnad_handler(cmd) < 0)
+#endif
+		{
+		#if SUPPORT_INTERACTIVE_MODE
+			print_help_handler(cmd);
+			legency_interactive_handler(NULL, NULL);
+		#else
+			if(print_help_handler(cmd) < 0){
+				at_printf("\r\nunknown command '%s'", cmd);
+			}
+		#endif
+		}
+	}
+}
+
 void log_service(void *param)
 {
 	/* To avoid gcc warnings */
@@ -424,21 +393,10 @@ void log_service(void *param)
 #if CONFIG_LOG_SERVICE_LOCK
 		log_service_lock();
 #endif
-		if(log_handler((char *)log_buf) == NULL){
-#if CONFIG_WLAN
-			if(mp_commnad_handler((char *)log_buf) < 0)
-#endif                        
-			{
-			#if SUPPORT_INTERACTIVE_MODE
-				print_help_handler((char *)log_buf);
-				legency_interactive_handler(NULL, NULL);
-			#else
-				if(print_help_handler((char *)log_buf) < 0){
-					at_printf("\r\nunknown command '%s'", log_buf);
-				}
-			#endif
-			}
-		}
+#if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
+		uart_at_resp_begin();
+#endif
+		log_service_exec((char *)log_buf);
 		log_buf[0] = '\0';
 #if CONFIG_INIC_EN
 		inic_cmd_ioctl = 0;
@@ -446,10 +404,13 @@ void log_service(void *param)
 		_AT_DBG_MSG(AT_FLAG_COMMON, AT_DBG_ALWAYS, "\n\r[MEM] After do cmd, available heap %d\n\r", xPortGetFreeHeapSize());
 		_AT_DBG_MSG(AT_FLAG_COMMON, AT_DBG_ALWAYS, "\r\n\n#\r\n"); //"#" is needed for mp tool
 #if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
-		if(atcmd_lwip_is_tt_mode())
+		if(uart_at_frame_is_active())
+			;	// framed mode, responses are delimited by the frames
+		else if(atcmd_lwip_is_tt_mode())
 			at_printf(STR_END_OF_ATDATA_RET);
 		else
 			at_printf(STR_END_OF_ATCMD_RET);
+		uart_at_resp_end();	// the response and the prompt leave together
 #endif
 #if CONFIG_LOG_SERVICE_LOCK
 		log_service_unlock();
@@ -460,7 +421,11 @@ void log_service(void *param)
 	}
 }
 
-#define STACKSIZE               1280
+// parameters are split in place, no LOG_SERVICE_BUFLEN copy of the line on the stack anymore
+#ifndef LOG_SERVICE_STACKSIZE
+#define LOG_SERVICE_STACKSIZE	(1280 - LOG_SERVICE_BUFLEN / sizeof(portSTACK_TYPE))
+#endif
+#define STACKSIZE               LOG_SERVICE_STACKSIZE
 void start_log_service(void)
 {
 	xTaskHandle CreatedTask;
@@ -509,17 +474,29 @@ void fAT_exit(void *arg){
 	vTaskDelete(NULL);
 }
 #if CONFIG_LOG_HISTORY
+/* AT?? lists the history, 1 the latest, AT??=<n> runs entry n again */
 void fAT_log(void *arg){
-        int i = 0;
-        printf("[AT]log history:\n\n\r");
-        if(log_history_count > LOG_HISTORY_LEN){
-          for(i=0; i<4; i++)
-            printf("  %s\n\r", log_history[((log_history_count+i)%LOG_HISTORY_LEN)]);
-        }
-        else{
-          for(i=0; i<(log_history_count-1); i++)
-            printf("  %s\n\r", log_history[i]);
-        }
+	int argc, n, i;
+	char *argv[MAX_ARGC] = {0};
+
+	if(arg){
+		argc = parse_param(arg, argv);
+		n = (argc == 2 && argv[1]) ? atoi(argv[1]) : 0;
+		/* arg lives in log_buf, it is not used past this point */
+		if((n < 1) || (log_history_get(&log_history, n - 1, log_buf, LOG_SERVICE_BUFLEN) < 0)){
+			printf("[AT??] Usage: AT?\?=<n>, n of the history list\n\r");
+			return;
+		}
+		printf("[AT??] %s\n\r", log_buf);
+		log_service_exec(log_buf);
+		return;
+	}
+
+	printf("[AT]log history:\n\n\r");
+	for(i = log_history.count; i > 0; i--){
+		if(log_history_get(&log_history, i - 1, log_buf, LOG_SERVICE_BUFLEN) >= 0)
+			printf("  %d: %s\n\r", i, log_buf);
+	}
 }
 #endif
 log_item_t at_log_items[ ] = {
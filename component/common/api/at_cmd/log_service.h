@@ -44,11 +44,13 @@
 
 #ifndef CONFIG_LOG_HISTORY
 #define CONFIG_LOG_HISTORY	0
-#if CONFIG_LOG_HISTORY
-#define LOG_HISTORY_LEN    5
-#endif
 #endif //#ifndef CONFIG_LOG_HISTORY
 
+//LOG_HISTORY_SIZE: bytes of the ring keeping the latest commands for AT??, as many as fit
+#if CONFIG_LOG_HISTORY && !defined(LOG_HISTORY_SIZE)
+#define LOG_HISTORY_SIZE    512
+#endif
+
 #ifndef MAX_ARGC
 #define MAX_ARGC 12
 #endif
@@ -57,6 +59,20 @@
 #define CONFIG_LOG_SERVICE_LOCK 0 // //to protect log_buf[], only one command processed per time
 #endif
 
+//CONFIG_LOG_SERVICE_PHASH: commands are resolved through a const perfect hash table
+//                          generated at build time by log_service_phash.py instead of
+//                          the lists filled by log_service_add_table() at boot
+#ifndef CONFIG_LOG_SERVICE_PHASH
+#define CONFIG_LOG_SERVICE_PHASH 0
+#endif
+
+//CONFIG_LOG_SERVICE_QUIET: AT_DBG_MSG()/_AT_DBG_MSG() compile to nothing, the data path
+//                          and every command skip their console output, including the
+//                          heap report and the "#" marker after each command (mp tool)
+#ifndef CONFIG_LOG_SERVICE_QUIET
+#define CONFIG_LOG_SERVICE_QUIET 0
+#endif
+
 #define AT_BIT(n)           (1<<n)
 #define AT_FLAG_DUMP        AT_BIT(0)
 #define AT_FLAG_EDIT        AT_BIT(1)
@@ -87,6 +103,10 @@ extern unsigned int   gDbgFlag;
 			printf("\r\n");			\
 		}while(0)
 #define _AT_PRINTK(...)	printf(__VA_ARGS__)
+#if CONFIG_LOG_SERVICE_QUIET
+#define AT_DBG_MSG(flag, level, ...)	do{}while(0)
+#define _AT_DBG_MSG(flag, level, ...)	do{}while(0)
+#else
 #define AT_DBG_MSG(flag, level, ...)					\
 		do{														\
 			if(((flag) & gDbgFlag) && (level <= gDbgLevel)){	\
@@ -99,6 +119,7 @@ extern unsigned int   gDbgFlag;
 				_AT_PRINTK(__VA_ARGS__);						\
 			}													\
 		}while(0)
+#endif //#if CONFIG_LOG_SERVICE_QUIET
 
 #ifndef SUPPORT_INTERACTIVE_MODE
 #define SUPPORT_INTERACTIVE_MODE	0
@@ -114,6 +135,10 @@ typedef struct _at_command_item_{
 
 void log_service_add_table(log_item_t *tbl, int len);
 int parse_param(char *buf, char **argv);
+void log_service_exec(char *cmd);
+#if CONFIG_LOG_SERVICE_PHASH
+log_act_t log_service_phash_find(const char *cmd);
+#endif
 #if CONFIG_LOG_SERVICE_LOCK
 void log_service_lock_init(void);
 void log_service_lock(void);
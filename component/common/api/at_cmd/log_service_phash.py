@@ -0,0 +1,308 @@
+"""
+Build step for CONFIG_LOG_SERVICE_PHASH.
+
+Collects every log_item_t table of the build and emits a C file holding a
+const minimal perfect hash of the commands (hash and displace), so that
+log_action() resolves a command with one probe and one strcmp instead of
+walking the lists registered at boot by log_service_add_table().
+
+Inputs are the preprocessed sources (.i, the GCC build keeps them with
+--save-temps) so the table matches the configuration that was compiled.
+Plain .c files are accepted too: preprocessor lines are ignored and every
+command of every branch is taken, which is what the host check uses to
+cover the whole tree.
+
+  python log_service_phash.py -o log_service_phash.c <file.i|file.c> ...
+  python log_service_phash.py -o log_service_phash_check.c --check at_cmd/*.c
+
+--check compiles the generated file with the host compiler ($HOSTCC, cc)
+and verifies that every collected command resolves to its handler and
+that unknown commands miss. "make atcmd_phash_check" runs it on the tree.
+"""
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+FNV_BASIS = 0x811C9DC5
+FNV_PRIME = 0x01000193
+MASK32 = 0xFFFFFFFF
+
+TABLE_RE = re.compile(r'\blog_item_t\s+(\w+)\s*\[\s*\w*\s*\]\s*=\s*\{')
+ITEM_RE = re.compile(r'\{\s*"((?:[^"\\]|\\.)*)"\s*,\s*(\w+)')
+
+
+def phash(seed, cmd):
+    h = (seed ^ FNV_BASIS) & MASK32
+    for c in bytearray(cmd.encode('latin-1')):
+        h = ((h ^ c) * FNV_PRIME) & MASK32
+    # the low bits of FNV-1a are weak, fold the high half in
+    return h ^ (h >> 15)
+
+
+def strip_source(text, preprocessed):
+    """Drop comments and preprocessor lines, keep string literals intact."""
+    if preprocessed:
+        # only line markers and pragmas are left
+        return re.sub(r'^[ \t]*#.*$', '', text, flags=re.M)
+    out = []
+    i = 0
+    n = len(text)
+    line_start = True
+    while i < n:
+        c = text[i]
+        if line_start and c in ' \t':
+            out.append(c)
+            i += 1
+            continue
+        if line_start and c == '#':
+            # directive or line marker, including continuation lines
+            while i < n and text[i] != '\n':
+                if text[i] == '\\' and i + 1 < n and text[i + 1] == '\n':
+                    i += 1
+                i += 1
+            continue
+        line_start = False
+        if c == '"' or c == '\'':
+            j = i + 1
+            while j < n and text[j] != c:
+                if text[j] == '\\':
+                    j += 1
+                j += 1
+            out.append(text[i:j + 1])
+            i = j + 1
+            continue
+        if text.startswith('//', i):
+            while i < n and text[i] != '\n':
+                i += 1
+            continue
+        if text.startswith('/*', i):
+            j = text.find('*/', i + 2)
+            i = n if j < 0 else j + 2
+            out.append(' ')
+            continue
+        if c == '\n':
+            line_start = True
+        out.append(c)
+        i += 1
+    return ''.join(out)
+
+
+def collect(path):
+    """Return [(table, cmd, handler)] of one source, skipping tables whose
+    handlers are static (they cannot be referenced from another file)."""
+    with open(path, 'r') as f:
+        text = strip_source(f.read(), path.endswith('.i'))
+    items = []
+    for m in TABLE_RE.finditer(text):
+        depth = 1
+        pos = m.end()
+        while pos < len(text) and depth:
+            if text[pos] == '"':
+                pos = text.index('"', pos + 1)
+                while text[pos - 1] == '\\':
+                    pos = text.index('"', pos + 1)
+            elif text[pos] == '{':
+                depth += 1
+            elif text[pos] == '}':
+                depth -= 1
+            pos += 1
+        body = text[m.end():pos - 1]
+        table = [(m.group(1), c, h) for c, h in ITEM_RE.findall(body)]
+        static = [h for _, _, h in table
+                  if re.search(r'\bstatic\s+void\s+' + h + r'\s*\(', text)]
+        if static:
+            sys.stderr.write('%s: %s uses static handler %s, left to runtime registration\n'
+                             % (os.path.basename(path), m.group(1), static[0]))
+            continue
+        items += table
+    return items
+
+
+def build(items):
+    """Minimal perfect hash: cmd -> slot = phash(disp[phash(0, cmd) % G], cmd) % N"""
+    cmds = {}
+    dropped = set()
+    for table, cmd, handler in items:
+        if cmd in dropped:
+            continue
+        if cmd in cmds and cmds[cmd] != handler:
+            # same command, different handlers: keep the registration order
+            # semantics of the lists by leaving it to the runtime tables
+            sys.stderr.write('%s: registered with %s and %s, left to runtime registration\n'
+                             % (cmd, cmds[cmd], handler))
+            del cmds[cmd]
+            dropped.add(cmd)
+            continue
+        cmds[cmd] = handler
+
+    keys = sorted(cmds)
+    n = len(keys)
+    if n == 0:
+        return [], [], dropped
+    g = max(1, (n + 3) // 4)
+    buckets = [[] for _ in range(g)]
+    for k in keys:
+        buckets[phash(0, k) % g].append(k)
+
+    disp = [0] * g
+    slots = [None] * n
+    for b in sorted(range(g), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            continue
+        for d in range(1, 0x10000):
+            pos = [phash(d, k) % n for k in buckets[b]]
+            if len(set(pos)) == len(pos) and all(slots[p] is None for p in pos):
+                break
+        else:
+            raise SystemExit('no displacement found for bucket %d' % b)
+        disp[b] = d
+        for k, p in zip(buckets[b], pos):
+            slots[p] = (k, cmds[k])
+    return disp, slots, dropped
+
+
+def c_string(s):
+    return '"' + s.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def emit(out, sources, disp, slots, dropped):
+    handlers = sorted(set(h for _, h in slots))
+    lines = []
+    lines.append('/* Generated by log_service_phash.py from')
+    for s in sources:
+        lines.append(' *   %s' % os.path.basename(s))
+    lines.append(' * Do not edit, it is rebuilt with the AT command tables. */')
+    lines.append('#include <string.h>')
+    lines.append('')
+    lines.append('typedef void (*log_phash_act_t)(void *);')
+    lines.append('struct log_phash_item {')
+    lines.append('\tconst char *cmd;')
+    lines.append('\tlog_phash_act_t act;')
+    lines.append('};')
+    lines.append('')
+    for h in handlers:
+        lines.append('extern void %s(void *arg);' % h)
+    lines.append('')
+    lines.append('#define LOG_PHASH_SIZE\t\t%d' % len(slots))
+    lines.append('#define LOG_PHASH_BUCKETS\t%d' % max(1, len(disp)))
+    lines.append('')
+    if slots:
+        lines.append('static const unsigned short log_phash_disp[LOG_PHASH_BUCKETS] = {')
+        for i in range(0, len(disp), 8):
+            lines.append('\t' + ' '.join('%d,' % d for d in disp[i:i + 8]))
+        lines.append('};')
+        lines.append('')
+        lines.append('static const struct log_phash_item log_phash_items[LOG_PHASH_SIZE] = {')
+        for cmd, h in slots:
+            lines.append('\t{%s, %s},' % (c_string(cmd), h))
+        lines.append('};')
+        lines.append('')
+    lines.append('static unsigned int log_phash_hash(unsigned int seed, const char *cmd)')
+    lines.append('{')
+    lines.append('\tunsigned int h = seed ^ 0x%08XU;' % FNV_BASIS)
+    lines.append('')
+    lines.append('\twhile(*cmd)')
+    lines.append('\t\th = (h ^ (unsigned char)*cmd++) * 0x%08XU;' % FNV_PRIME)
+    lines.append('\treturn h ^ (h >> 15);')
+    lines.append('}')
+    lines.append('')
+    lines.append('log_phash_act_t log_service_phash_find(const char *cmd)')
+    lines.append('{')
+    if slots:
+        lines.append('\tunsigned int d = log_phash_disp[log_phash_hash(0, cmd) % LOG_PHASH_BUCKETS];')
+        lines.append('\tconst struct log_phash_item *item = &log_phash_items[log_phash_hash(d, cmd) % LOG_PHASH_SIZE];')
+        lines.append('')
+        lines.append('\treturn (strcmp(item->cmd, cmd) == 0) ? item->act : 0;')
+    else:
+        lines.append('\t(void)log_phash_hash;')
+        lines.append('\t(void)cmd;')
+        lines.append('\treturn 0;')
+    lines.append('}')
+
+    # host check, built by --check only
+    lines.append('')
+    lines.append('#ifdef LOG_SERVICE_PHASH_CHECK')
+    lines.append('#include <stdio.h>')
+    for h in handlers:
+        lines.append('void %s(void *arg){ (void)arg; }' % h)
+    lines.append('')
+    lines.append('static const struct log_phash_item log_phash_expect[] = {')
+    for cmd, h in sorted(slots):
+        lines.append('\t{%s, %s},' % (c_string(cmd), h))
+    lines.append('\t{0, 0}')
+    lines.append('};')
+    lines.append('')
+    lines.append('static const char *log_phash_miss[] = {')
+    misses = ['', 'A', 'AT+', 'ATZZ', 'atsv', 'ATS', 'ATSVX'] + sorted(dropped)
+    lines.append('\t' + ' '.join(c_string(m) + ',' for m in misses) + ' 0')
+    lines.append('};')
+    lines.append('')
+    lines.append('int main(void)')
+    lines.append('{')
+    lines.append('\tconst struct log_phash_item *e;')
+    lines.append('\tconst char **m;')
+    lines.append('\tint fail = 0, hit = 0;')
+    lines.append('')
+    lines.append('\tfor(e = log_phash_expect; e->cmd; e++, hit++){')
+    lines.append('\t\tif(log_service_phash_find(e->cmd) != e->act){')
+    lines.append('\t\t\tprintf("%s does not resolve\\n", e->cmd);')
+    lines.append('\t\t\tfail++;')
+    lines.append('\t\t}')
+    lines.append('\t}')
+    lines.append('\tfor(m = log_phash_miss; *m; m++){')
+    lines.append('\t\tint known = 0;')
+    lines.append('\t\tfor(e = log_phash_expect; e->cmd; e++)')
+    lines.append('\t\t\tknown |= (strcmp(e->cmd, *m) == 0);')
+    lines.append('\t\tif(!known && log_service_phash_find(*m)){')
+    lines.append('\t\t\tprintf("%s should not resolve\\n", *m);')
+    lines.append('\t\t\tfail++;')
+    lines.append('\t\t}')
+    lines.append('\t}')
+    lines.append('\tprintf("%d commands, %d slots, %d buckets: %s\\n", hit, LOG_PHASH_SIZE, LOG_PHASH_BUCKETS, fail ? "FAIL" : "OK");')
+    lines.append('\treturn fail ? 1 : 0;')
+    lines.append('}')
+    lines.append('#endif')
+
+    with open(out, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+def check(path):
+    cc = os.environ.get('HOSTCC', 'cc')
+    exe = os.path.join(tempfile.mkdtemp(), 'log_service_phash_check')
+    subprocess.check_call([cc, '-Wall', '-DLOG_SERVICE_PHASH_CHECK', '-o', exe, path])
+    return subprocess.call([exe])
+
+
+def main(argv):
+    out = None
+    do_check = False
+    sources = []
+    i = 0
+    while i < len(argv):
+        if argv[i] == '-o':
+            out = argv[i + 1]
+            i += 1
+        elif argv[i] == '--check':
+            do_check = True
+        else:
+            sources.append(argv[i])
+        i += 1
+    if out is None or not sources:
+        sys.stderr.write(__doc__)
+        return 2
+
+    items = []
+    for s in sources:
+        items += collect(s)
+    disp, slots, dropped = build(items)
+    emit(out, sources, disp, slots, dropped)
+    if do_check:
+        return check(out)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -19,6 +19,10 @@
 #include "wlan_fast_connect/example_wlan_fast_connect.h"
 #endif
 
+#if defined(CONFIG_SNMP_AGENT) && CONFIG_SNMP_AGENT
+#include "snmp/snmp_ameba.h"
+#endif
+
 /*Static IP ADDRESS*/
 #ifndef IP_ADDR0
 #define IP_ADDR0   192
@@ -201,6 +205,10 @@ void LwIP_Init(void)
 	/*  Registers the default network interface. */
 	netif_set_default(&xnetif[0]);
 
+#if defined(CONFIG_SNMP_AGENT) && CONFIG_SNMP_AGENT
+	snmp_ameba_init();
+#endif
+
 	/*move these operations to wifi_on/wifi_off*/
 	#if 0
 	/*  When the netif is fully configured this function must be called.*/
@@ -267,6 +267,19 @@ extern unsigned int sys_now(void);
 #define LWIP_STATS 0
 #define LWIP_PROVIDE_ERRNO 1
 
+/* ---------- SNMP options ---------- */
+#if defined(CONFIG_SNMP_AGENT) && CONFIG_SNMP_AGENT
+#define LWIP_SNMP                       1
+/* Run the agent in the tcpip thread so MIB2 handlers need no per-varbind threadsync */
+#define SNMP_USE_RAW                    1
+#define SNMP_USE_NETCONN                0
+#define LWIP_MIB2_CALLBACKS             1
+#undef  LWIP_STATS
+#define LWIP_STATS                      1
+#define MIB2_STATS                      1
+#define LWIP_STATS_DISPLAY              0
+#endif
+
 
 /*
    --------------------------------------
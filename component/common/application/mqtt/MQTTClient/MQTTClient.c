@@ -41,14 +41,115 @@ const char * const mqtt_status_str[]=
 	"MQTT_RUNNING"
 };
 
-static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage* aMessage) {
+static void NewMessageData(MessageData* md, MQTTString* aTopicName, MQTTMessage* aMessage, size_t offset, size_t total) {
     md->topicName = aTopicName;
     md->message = aMessage;
+    md->offset = offset;
+    md->total = total;
+}
+
+
+/* the handler subscribed with this very topicFilter string */
+static MessageHandlers* findHandler(MQTTClient* c, const char* topicFilter)
+{
+    MessageHandlers* h = NULL;
+
+    while ((h = (MessageHandlers*)MQTTTopicTrie_next(&c->messageHandlers, topicFilter, h)) != NULL)
+        if (h->topicFilter == topicFilter)
+            break;
+    return h;
+}
+
+
+static int addHandler(MQTTClient* c, const char* topicFilter, messageHandler fp)
+{
+    MessageHandlers* h;
+
+    if (findHandler(c, topicFilter) != NULL)
+        return SUCCESS;     // already subscribed
+    if ((h = (MessageHandlers*)malloc(sizeof(MessageHandlers))) == NULL)
+        return FAILURE;
+    h->topicFilter = topicFilter;
+    h->fp = fp;
+    if (MQTTTopicTrie_add(&c->messageHandlers, topicFilter, h) != 0)
+    {
+        free(h);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+
+static void removeHandler(MQTTClient* c, const char* topicFilter)
+{
+    MessageHandlers* h = findHandler(c, topicFilter);
+
+    if (h != NULL)
+    {
+        MQTTTopicTrie_remove(&c->messageHandlers, topicFilter, h);
+        free(h);
+    }
+}
+
+
+static int freeHandler(void* value, void* arg)
+{
+    free(value);
+    return 0;
+}
+
+
+static MQTTInflight* findInflight(MQTTClient* c, unsigned short id)
+{
+    int i;
+
+    for (i = 0; i < c->inflight_count; i++)
+        if (c->inflight[i].id == id)
+            return &c->inflight[i];
+    return NULL;
+}
+
+
+static void completeInflight(MQTTClient* c, MQTTInflight* f, int rc)
+{
+    MQTTInflight done = *f;
+    int i = f - c->inflight;
+
+    free(done.packet);
+    // keep the window in the order sent, for the retransmission
+    memmove(&c->inflight[i], &c->inflight[i + 1], (c->inflight_count - i - 1) * sizeof(MQTTInflight));
+    c->inflight_count--;
+    if (done.fp != NULL)
+        done.fp(done.id, rc, done.context);
+}
+
+
+/* PUBREC moves a QoS 2 message on to PUBCOMP, PUBACK and PUBCOMP complete it */
+static void ackInflight(MQTTClient* c, unsigned char packet_type, unsigned short id)
+{
+    MQTTInflight* f = findInflight(c, id);
+
+    if (f == NULL || f->state != packet_type)
+        return;     // a publish of MQTTPublish or a duplicate ack
+    if (packet_type == PUBREC)
+    {
+        free(f->packet);    // the broker has it, PUBREL is all that is left to send
+        f->packet = NULL;
+        f->state = PUBCOMP;
+    }
+    else
+    {
+        completeInflight(c, f, SUCCESS);
+        MQTTFlushQueue(c);      // the window has room for what waits in the queue
+    }
 }
 
 
 static int getNextPacketId(MQTTClient *c) {
-    return c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
+    do
+        c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
+    while (findInflight(c, c->next_packetid) != NULL);
+    return c->next_packetid;
 }
 
 
@@ -82,14 +183,41 @@ static int sendPacket(MQTTClient* c, int length, Timer* timer)
 }
 
 
+/* on a new connection, what is still in the window goes again, as MQTT 3.1.1 section 4.4 asks */
+static int resendInflight(MQTTClient* c, Timer* timer)
+{
+    int i, len, rc = SUCCESS;
+
+    if (c->inflight_count > 0)
+        mqtt_printf(MQTT_DEBUG, "Resend %d in-flight messages", c->inflight_count);
+    for (i = 0; i < c->inflight_count && rc == SUCCESS; i++)
+    {
+        MQTTInflight* f = &c->inflight[i];
+
+        if (f->state == PUBCOMP)
+            len = MQTTSerialize_ack(c->buf, c->buf_size, PUBREL, 0, f->id);
+        else
+        {
+            MQTTHeader header = {0};
+
+            header.byte = f->packet[0];
+            header.bits.dup = 1;
+            f->packet[0] = header.byte;
+            memcpy(c->buf, f->packet, f->len);
+            len = f->len;
+        }
+        rc = (len > 0) ? sendPacket(c, len, timer) : FAILURE;
+    }
+    return rc;
+}
+
+
 void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeout_ms,
 		unsigned char* sendbuf, size_t sendbuf_size, unsigned char* readbuf, size_t readbuf_size)
 {
-    int i;
     c->ipstack = network;
     
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-        c->messageHandlers[i].topicFilter = 0;
+    MQTTTopicTrie_init(&c->messageHandlers);
     c->command_timeout_ms = command_timeout_ms;
     c->buf = sendbuf;
     c->buf_size = sendbuf_size;
@@ -99,6 +227,9 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
     c->ping_outstanding = 0;
     c->defaultMessageHandler = NULL;
 	c->next_packetid = 1;
+    c->inflight_count = 0;
+    c->inflight_window = MQTT_MAX_INFLIGHT;
+    c->queue = NULL;
     c->ipstack->m2m_rxevent = 0;
     c->mqttstatus = MQTT_START;
     TimerInit(&c->cmd_timer);
@@ -106,6 +237,24 @@ void MQTTClientInit(MQTTClient* c, Network* network, unsigned int command_timeou
 }
 
 
+void MQTTClientDeinit(MQTTClient* c)
+{
+    MQTTTopicTrie_clear(&c->messageHandlers, freeHandler, NULL);
+    while (c->inflight_count > 0)
+        completeInflight(c, &c->inflight[0], FAILURE);
+}
+
+
+void MQTTSetInflightWindow(MQTTClient* c, int window)
+{
+    if (window < 1)
+        window = 1;
+    else if (window > MQTT_MAX_INFLIGHT)
+        window = MQTT_MAX_INFLIGHT;
+    c->inflight_window = window;
+}
+
+
 static int decodePacket(MQTTClient* c, int* value, int timeout)
 {
     unsigned char i;
@@ -151,6 +300,26 @@ static int readPacket(MQTTClient* c, Timer* timer)
     decodePacket(c, &rem_len, TimerLeftMS(timer));
     len += MQTTPacket_encode(c->readbuf + 1, rem_len); /* put the original remaining length back into the buffer */
 
+    header.byte = c->readbuf[0];
+    if(len + rem_len > c->readbuf_size && header.bits.type == PUBLISH){
+        /* only the topic and packet id, deliverPublish() reads the payload into what is left */
+        int var_len;
+
+        if (c->ipstack->mqttread(c->ipstack, c->readbuf + len, 2, TimerLeftMS(timer)) != 2)
+            goto exit;
+        var_len = 2 + ((c->readbuf[len] << 8) | c->readbuf[len + 1]) + ((header.bits.qos > 0) ? 2 : 0);
+        if(var_len > rem_len || len + var_len >= c->readbuf_size){
+            mqtt_printf(MQTT_WARNING, "topic of %d bytes, read buffer will overflow", var_len);
+            rc = BUFFER_OVERFLOW;
+            goto exit;
+        }
+        if (var_len > 2 && c->ipstack->mqttread(c->ipstack, c->readbuf + len + 2, var_len - 2, TimerLeftMS(timer)) != var_len - 2){
+            mqtt_printf(MQTT_MSGDUMP, "read the publish topic failed");
+            goto exit;
+        }
+        rc = PUBLISH;
+        goto exit;
+    }
     if(len + rem_len > c->readbuf_size){
         mqtt_printf(MQTT_WARNING, "rem_len = %d, read buffer will overflow", rem_len);
         rc = BUFFER_OVERFLOW;
@@ -161,7 +330,6 @@ static int readPacket(MQTTClient* c, Timer* timer)
         mqtt_printf(MQTT_MSGDUMP, "read the rest of the data failed");
         goto exit;
     }
-    header.byte = c->readbuf[0];
     rc = header.bits.type;
 exit:
     if (c->ipstack->my_socket < 0) {
@@ -171,62 +339,46 @@ exit:
 }
 
 
-// assume topic filter and name is in correct format
-// # can only be at end
-// + and # can only be next to separator
-static char isTopicMatched(char* topicFilter, MQTTString* topicName)
+typedef struct Delivery
 {
-    char* curf = topicFilter;
-    char* curn = topicName->lenstring.data;
-    char* curn_end = curn + topicName->lenstring.len;
-    
-    while (*curf && curn < curn_end)
+    MessageData md;
+    int delivered;
+} Delivery;
+
+
+static int deliverHandler(void* value, void* arg)
+{
+    MessageHandlers* h = (MessageHandlers*)value;
+    Delivery* d = (Delivery*)arg;
+
+    if (h->fp != NULL)
     {
-        if (*curn == '/' && *curf != '/')
-            break;
-        if (*curf != '+' && *curf != '#' && *curf != *curn)
-            break;
-        if (*curf == '+')
-        {   // skip until we meet the next separator, or end of string
-            char* nextpos = curn + 1;
-            while (nextpos < curn_end && *nextpos != '/')
-                nextpos = ++curn + 1;
-        }
-        else if (*curf == '#')
-            curn = curn_end - 1;    // skip until end of string
-        curf++;
-        curn++;
-    };
-    
-    return (curn == curn_end) && (*curf == '\0');
+        h->fp(&d->md);
+        d->delivered = 1;
+    }
+    return 0;
 }
 
 
-int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+static int deliverChunk(MQTTClient* c, MQTTString* topicName, MQTTMessage* message, size_t offset, size_t total)
 {
-    int i;
     int rc = FAILURE;
+    Delivery d;
 
-    // we have to find the right message handler - indexed by topic
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-    {
-        if (c->messageHandlers[i].topicFilter != 0 && (MQTTPacket_equals(topicName, (char*)c->messageHandlers[i].topicFilter) ||
-                isTopicMatched((char*)c->messageHandlers[i].topicFilter, topicName)))
-        {
-            if (c->messageHandlers[i].fp != NULL)
-            {
-                MessageData md;
-                NewMessageData(&md, topicName, message);
-                c->messageHandlers[i].fp(&md);
-                rc = SUCCESS;
-            }
-        }
-    }
+    // we have to find the right message handlers - indexed by topic, one step per topic level
+    NewMessageData(&d.md, topicName, message, offset, total);
+    d.delivered = 0;
+    if (topicName->cstring)
+        MQTTTopicTrie_match(&c->messageHandlers, topicName->cstring, strlen(topicName->cstring), deliverHandler, &d);
+    else
+        MQTTTopicTrie_match(&c->messageHandlers, topicName->lenstring.data, topicName->lenstring.len, deliverHandler, &d);
+    if (d.delivered)
+        rc = SUCCESS;
     
     if (rc == FAILURE && c->defaultMessageHandler != NULL) 
     {
         MessageData md;
-        NewMessageData(&md, topicName, message);
+        NewMessageData(&md, topicName, message, offset, total);
         c->defaultMessageHandler(&md);
         rc = SUCCESS;
     }   
@@ -235,6 +387,47 @@ int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
 }
 
 
+int deliverMessage(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+{
+    return deliverChunk(c, topicName, message, 0, message->payloadlen);
+}
+
+
+/* FAILURE only when the socket failed, with the payload half read */
+static int deliverPublish(MQTTClient* c, MQTTString* topicName, MQTTMessage* message)
+{
+    unsigned char* chunk = (unsigned char*)message->payload;
+    size_t room = c->readbuf + c->readbuf_size - chunk;
+    size_t total = message->payloadlen,
+      offset = 0;
+    Timer timer;
+
+    if (total <= room)
+    {
+        deliverMessage(c, topicName, message);     // all in readbuf
+        return SUCCESS;
+    }
+
+    // readPacket() left the payload in the socket, stream it through the rest of readbuf
+    while (offset < total)
+    {
+        int n = (total - offset < room) ? total - offset : room;
+
+        TimerInit(&timer);
+        TimerCountdownMS(&timer, c->command_timeout_ms);
+        if (c->ipstack->mqttread(c->ipstack, chunk, n, TimerLeftMS(&timer)) != n)
+        {
+            mqtt_printf(MQTT_DEBUG, "Read payload failed at %d of %d", (int)offset, (int)total);
+            return FAILURE;
+        }
+        message->payloadlen = n;
+        deliverChunk(c, topicName, message, offset, total);
+        offset += n;
+    }
+    return SUCCESS;
+}
+
+
 int keepalive(MQTTClient* c)
 {
     int rc = FAILURE;
@@ -278,9 +471,17 @@ int cycle(MQTTClient* c, Timer* timer)
     switch (packet_type)
     {
         case CONNACK:
-        case PUBACK:
         case SUBACK:
             break;
+        case PUBACK:
+        case PUBCOMP:
+        {
+            unsigned short mypacketid;
+            unsigned char dup, type;
+            if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) == 1)
+                ackInflight(c, packet_type, mypacketid);
+            break;
+        }
         case PUBLISH:
         {
             MQTTString topicName;
@@ -290,7 +491,11 @@ int cycle(MQTTClient* c, Timer* timer)
                (unsigned char**)&msg.payload, (int*)&msg.payloadlen, c->readbuf, c->readbuf_size) != 1)
                 goto exit;
             msg.qos = (enum QoS)intQoS;
-            deliverMessage(c, &topicName, &msg);
+            if (deliverPublish(c, &topicName, &msg) != SUCCESS)
+            {
+                rc = FAILURE;
+                goto exit;
+            }
             if (msg.qos != QOS0)
             {
                 if (msg.qos == QOS1)
@@ -322,6 +527,8 @@ int cycle(MQTTClient* c, Timer* timer)
                 rc = FAILURE;
             else if ((rc = sendPacket(c, len, timer)) != SUCCESS) // send the PUBREL packet
                 rc = FAILURE; // there was a problem
+            else
+                ackInflight(c, PUBREC, mypacketid);
             if (rc == FAILURE)
                 goto exit; // there was a problem
             break;
@@ -340,8 +547,6 @@ int cycle(MQTTClient* c, Timer* timer)
                 goto exit; // there was a problem
             break;
         }
-        case PUBCOMP:
-            break;
         case PINGRESP:
             c->ping_outstanding = 0;
             break;
@@ -419,7 +624,11 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
         unsigned char connack_rc = 255;
         unsigned char sessionPresent = 0;
         if (MQTTDeserialize_connack(&sessionPresent, &connack_rc, c->readbuf, c->readbuf_size) == 1)
+        {
             rc = connack_rc;
+            if (rc == SUCCESS)
+                resendInflight(c, &connect_timer);
+        }
         else
             rc = FAILURE;
     }
@@ -430,7 +639,12 @@ int MQTTConnect(MQTTClient* c, MQTTPacket_connectData* options)
 #endif 
 exit:
     if (rc == SUCCESS)
+    {
         c->isconnected = 1;
+#if defined(WAIT_FOR_ACK)
+        MQTTFlushQueue(c);  // after the window, in the order queued
+#endif
+    }
 
     return rc;
 }
@@ -464,27 +678,7 @@ int MQTTSubscribe(MQTTClient* c, const char* topicFilter, enum QoS qos, messageH
         if (MQTTDeserialize_suback(&mypacketid, 1, &count, &grantedQoS, c->readbuf, c->readbuf_size) == 1)
             rc = grantedQoS; // 0, 1, 2 or 0x80 
         if (rc != 0x80)
-        {
-            int i;
-            for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-            {
-                if (c->messageHandlers[i].topicFilter == topicFilter)
-                {
-                    rc = 0;
-                    goto exit;  //already subscribed
-                }
-            }
-            for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-            {
-                if (c->messageHandlers[i].topicFilter == 0)
-                {
-                    c->messageHandlers[i].topicFilter = topicFilter;
-                    c->messageHandlers[i].fp = messageHandler;
-                    rc = 0;
-                    break;
-                }
-            }
-        }
+            rc = addHandler(c, topicFilter, messageHandler);
     }
     else 
         rc = FAILURE;
@@ -519,15 +713,7 @@ int MQTTUnsubscribe(MQTTClient* c, const char* topicFilter)
         unsigned short mypacketid;  // should be the same as the packetid above
         if (MQTTDeserialize_unsuback(&mypacketid, c->readbuf, c->readbuf_size) == 1)
             rc = 0;
-            int i;
-            for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-            {
-                if (c->messageHandlers[i].topicFilter == topicFilter)
-                {
-                    c->messageHandlers[i].topicFilter = 0;
-                    c->messageHandlers[i].fp = NULL;
-                }
-            }
+            removeHandler(c, topicFilter);
     }
     else
         rc = FAILURE;
@@ -596,6 +782,132 @@ exit:
 }
 
 
+/* a QoS 1 or 2 message into the window, id 0 for a new packet id, else sent again as a duplicate */
+static int publishInflight(MQTTClient* c, const char* topicName, MQTTMessage* message, unsigned short id,
+    publishHandler fp, void* context)
+{
+    int rc = FAILURE;
+    Timer timer;
+    MQTTString topic = MQTTString_initializer;
+    MQTTInflight* f;
+    int len = 0;
+
+    if (!c->isconnected)
+        goto exit;
+    if (c->inflight_count >= c->inflight_window)
+    {
+        rc = INFLIGHT_FULL;
+        goto exit;
+    }
+
+    topic.cstring = (char *)topicName;
+    message->id = (id != 0) ? id : getNextPacketId(c);
+    len = MQTTSerialize_publish(c->buf, c->buf_size, (id != 0), message->qos, message->retained, message->id,
+              topic, (unsigned char*)message->payload, message->payloadlen);
+    if (len <= 0)
+        goto exit;
+
+    f = &c->inflight[c->inflight_count];
+    if ((f->packet = (unsigned char*)malloc(len)) == NULL)
+        goto exit;
+    memcpy(f->packet, c->buf, len);
+    f->len = len;
+    f->id = message->id;
+    f->state = (message->qos == QOS1) ? PUBACK : PUBREC;
+    f->fp = fp;
+    f->context = context;
+    c->inflight_count++;
+
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms);
+    if (sendPacket(c, len, &timer) != SUCCESS)
+        mqtt_printf(MQTT_DEBUG, "Publish %d kept for the next connection", message->id);
+    rc = SUCCESS;   // in the window, sent again on the next connection if need be
+exit:
+    return rc;
+}
+
+
+int MQTTPublishAsync(MQTTClient* c, const char* topicName, MQTTMessage* message, publishHandler fp, void* context)
+{
+    int rc;
+
+    if (message->qos == QOS0)
+    {
+        if ((rc = MQTTPublish(c, topicName, message)) == SUCCESS && fp != NULL)
+            fp(0, SUCCESS, context);
+        return rc;
+    }
+    return publishInflight(c, topicName, message, 0, fp, context);
+}
+
+
+/* a queued message acked leaves the queue, dropped by MQTTClientDeinit it goes again */
+static void queueDone(unsigned short packetid, int rc, void* context)
+{
+    if (rc == SUCCESS)
+        MQTTQueue_done((MQTTQueue*)context, packetid);
+    else
+        MQTTQueue_rewind((MQTTQueue*)context);
+}
+
+
+void MQTTSetQueue(MQTTClient* c, MQTTQueue* queue)
+{
+    c->queue = queue;
+}
+
+
+int MQTTFlushQueue(MQTTClient* c)
+{
+    MQTTQueue* q = c->queue;
+    MQTTQueueEntry e;
+    MQTTMessage message;
+    char* topic;
+    int rc = SUCCESS;
+
+    while (q != NULL && c->isconnected && c->inflight_count < c->inflight_window && MQTTQueue_next(q, &e) == 0)
+    {
+        if (e.id != 0 && findInflight(c, e.id) != NULL)
+            break;  // its id, kept from the last boot, is taken until that publish is acked
+
+        if ((topic = (char*)malloc(e.topiclen + 1 + e.payloadlen)) == NULL)
+        {
+            rc = FAILURE;
+            break;
+        }
+        memset(&message, 0, sizeof(MQTTMessage));
+        message.qos = (enum QoS)e.qos;
+        message.retained = e.retained;
+        message.payload = topic + e.topiclen + 1;
+        message.payloadlen = e.payloadlen;
+        if (MQTTQueue_read(q, &e, topic, (unsigned char*)message.payload) != 0)
+            rc = FAILURE;
+        else if (e.qos == QOS0)
+            rc = MQTTPublish(c, topic, &message);
+        else
+            rc = publishInflight(c, topic, &message, e.id, queueDone, q);
+        free(topic);
+        if (rc != SUCCESS)
+            break;
+        MQTTQueue_sent(q, &e, message.id);
+    }
+    return rc;
+}
+
+
+int MQTTPublishQueued(MQTTClient* c, const char* topicName, MQTTMessage* message)
+{
+    if (c->queue == NULL)
+        return MQTTPublishAsync(c, topicName, message, NULL, NULL);
+    if (MQTTQueue_push(c->queue, topicName, message->qos, message->retained, message->payload,
+            (int)message->payloadlen) != 0)
+        return FAILURE;
+    MQTTFlushQueue(c);
+    return SUCCESS;
+}
+
+
 int MQTTDisconnect(MQTTClient* c)
 {  
     int rc = FAILURE;
@@ -702,34 +1014,23 @@ int MQTTDataHandle(MQTTClient* c, fd_set *readfd, MQTTPacket_connectData *connec
 			if(packet_type == SUBACK){
 				int count = 0, grantedQoS = -1;
 				unsigned short mypacketid;
-				int isSubscribed = 0;
 				if (MQTTDeserialize_suback(&mypacketid, 1, &count, &grantedQoS, c->readbuf, c->readbuf_size) == 1){
 					rc = grantedQoS; // 0, 1, 2 or 0x80 
 					mqtt_printf(MQTT_DEBUG, "grantedQoS: %d", grantedQoS);
 				}
 				if (rc != 0x80)
 				{
-					int i;
-					for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-					{
-						if (c->messageHandlers[i].topicFilter == topic)
-						{   
-							isSubscribed = 1;
-							break;
-						}
-					}
-					if(!isSubscribed)
-						for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i)
-						{
-							if (c->messageHandlers[i].topicFilter == 0)
-							{
-								c->messageHandlers[i].topicFilter = topic;
-								c->messageHandlers[i].fp = messageHandler;
-								break;
-							}
-						}
+					if(addHandler(c, topic, messageHandler) != SUCCESS)
+						mqtt_printf(MQTT_WARNING, "No memory for the handler of %s", topic);
 					rc = 0;
 					MQTTSetStatus(c, MQTT_RUNNING);
+					// acks are only taken in the running state, resend from there
+					TimerInit(&c->cmd_timer);
+					TimerCountdownMS(&c->cmd_timer, c->command_timeout_ms);
+					if(resendInflight(c, &c->cmd_timer) != SUCCESS)
+						rc = FAILURE;
+					else
+						MQTTFlushQueue(c);
 				}
 			}else if(TimerIsExpired(&c->cmd_timer)){
 				mqtt_printf(MQTT_DEBUG, "Not received SUBACK");
@@ -754,6 +1055,8 @@ int MQTTDataHandle(MQTTClient* c, fd_set *readfd, MQTTPacket_connectData *connec
 						unsigned char dup, type;
 						if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
 							rc = FAILURE;
+						else
+							ackInflight(c, PUBACK, mypacketid);
 						break;
 					}
 					case SUBACK:
@@ -774,7 +1077,10 @@ int MQTTDataHandle(MQTTClient* c, fd_set *readfd, MQTTPacket_connectData *connec
 						}
 							
 						msg.qos = (enum QoS)intQoS;
-						deliverMessage(c, &topicName, &msg);
+						if((rc = deliverPublish(c, &topicName, &msg)) != SUCCESS){
+							MQTTSetStatus(c, MQTT_START);
+							goto exit;
+						}
 						if (msg.qos != QOS0)
 						{
 							if (msg.qos == QOS1){
@@ -812,7 +1118,8 @@ int MQTTDataHandle(MQTTClient* c, fd_set *readfd, MQTTPacket_connectData *connec
 						}else if ((rc = sendPacket(c, len, &timer)) != SUCCESS){ // send the PUBREL packet
 							rc = FAILURE; // there was a problem
 							MQTTSetStatus(c, MQTT_START);
-						}
+						}else
+							ackInflight(c, PUBREC, mypacketid);
 						break;
 					}
 					case PUBREL:
@@ -832,7 +1139,15 @@ int MQTTDataHandle(MQTTClient* c, fd_set *readfd, MQTTPacket_connectData *connec
 						break;
 					}
 					case PUBCOMP:
+					{
+						unsigned short mypacketid;
+						unsigned char dup, type;
+						if (MQTTDeserialize_ack(&type, &dup, &mypacketid, c->readbuf, c->readbuf_size) != 1)
+							rc = FAILURE;
+						else
+							ackInflight(c, PUBCOMP, mypacketid);
 						break;
+					}
 					case PINGRESP:
 						c->ping_outstanding = 0;
 						break;
@@ -36,6 +36,8 @@
 #include "../MQTTPacket/MQTTPacket.h"
 #include "stdio.h"
 #include "MQTTFreertos.h"
+#include "MQTTTopicTrie.h"
+#include "MQTTQueue.h"
 
 #define MQTT_TASK
 #if !defined(MQTT_TASK)
@@ -45,6 +47,10 @@
 #define MQTT_SENDBUF_LEN  1024
 #define MQTT_READBUF_LEN  1024
 
+#if !defined(MQTT_MAX_INFLIGHT)
+#define MQTT_MAX_INFLIGHT 8 /* QoS 1 and 2 publishes of MQTTPublishAsync waiting for their acks */
+#endif
+
 enum mqtt_status{
 	MQTT_START       = 0,
 	MQTT_CONNECT  = 1,
@@ -63,14 +69,10 @@ enum mqtt_status{
 
 #define MAX_PACKET_ID 65535 /* according to the MQTT specification - do not change! */
 
-#if !defined(MAX_MESSAGE_HANDLERS)
-#define MAX_MESSAGE_HANDLERS 5 /* redefinable - how many subscriptions do you want? */
-#endif
-
 enum QoS { QOS0, QOS1, QOS2 };
 
 /* all failure return codes must be negative */
-enum returnCode { BUFFER_OVERFLOW = -2, FAILURE = -1 };//, SUCCESS = 0
+enum returnCode { INFLIGHT_FULL = -3, BUFFER_OVERFLOW = -2, FAILURE = -1 };//, SUCCESS = 0
 
 /* The Platform specific header must define the Network and Timer structures and functions
  * which operate on them.
@@ -99,14 +101,37 @@ typedef struct MQTTMessage
     size_t payloadlen;
 } MQTTMessage;
 
+/* A PUBLISH larger than the read buffer comes to the handlers in pieces straight from the
+ * socket: message->payload holds payloadlen bytes at offset of a total length payload. */
 typedef struct MessageData
 {
     MQTTMessage* message;
     MQTTString* topicName;
+    size_t offset;
+    size_t total;
 } MessageData;
 
 typedef void (*messageHandler)(MessageData*);
 
+typedef struct MessageHandlers
+{
+    const char* topicFilter;
+    void (*fp) (MessageData*);
+} MessageHandlers;
+
+/* end of an MQTTPublishAsync: SUCCESS once acked, FAILURE when MQTTClientDeinit drops it */
+typedef void (*publishHandler)(unsigned short packetid, int rc, void* context);
+
+typedef struct MQTTInflight
+{
+    unsigned short id;
+    unsigned char state;        /* the ack waited for: PUBACK, PUBREC or PUBCOMP */
+    unsigned char* packet;      /* the PUBLISH as sent, until the broker has it */
+    int len;
+    publishHandler fp;
+    void* context;
+} MQTTInflight;
+
 typedef struct MQTTClient
 {
     unsigned int next_packetid,
@@ -119,11 +144,12 @@ typedef struct MQTTClient
     char ping_outstanding;
     int isconnected;
 
-    struct MessageHandlers
-    {
-        const char* topicFilter;
-        void (*fp) (MessageData*);
-    } messageHandlers[MAX_MESSAGE_HANDLERS];      /* Message handlers are indexed by subscription topic */
+    MQTTTopicTrie messageHandlers;      /* MessageHandlers, indexed by subscription topic, as many as subscribed */
+
+    MQTTInflight inflight[MQTT_MAX_INFLIGHT];  /* in the order sent */
+    int inflight_count,
+      inflight_window;
+    MQTTQueue* queue;                   /* of MQTTPublishQueued, NULL for none */
 
     void (*defaultMessageHandler) (MessageData*);
 
@@ -147,6 +173,13 @@ typedef struct MQTTClient
 DLLExport void MQTTClientInit(MQTTClient* client, Network* network, unsigned int command_timeout_ms,
 		unsigned char* sendbuf, size_t sendbuf_size, unsigned char* readbuf, size_t readbuf_size);
 
+/**
+ * Free the message handlers and the in-flight messages of an MQTT client object, before it is
+ * dropped or initialized again
+ * @param client
+ */
+DLLExport void MQTTClientDeinit(MQTTClient* client);
+
 /** MQTT Connect - send an MQTT connect packet down the network and wait for a Connack
  *  The nework object must be connected to the network endpoint before calling this
  *  @param options - connect options
@@ -162,6 +195,48 @@ DLLExport int MQTTConnect(MQTTClient* client, MQTTPacket_connectData* options);
  */
 DLLExport int MQTTPublish(MQTTClient* client, const char*, MQTTMessage*);
 
+/** MQTT Publish Async - send an MQTT publish packet without waiting for its acks
+ *  A QoS 1 or 2 message stays in the in-flight window until PUBACK or PUBCOMP comes in cycle()
+ *  or MQTTDataHandle(), then fp is called. What is still in the window when the client connects
+ *  again is sent again with the DUP flag, a failed send included. A QoS 0 message completes at once.
+ *  @param client - the client object to use
+ *  @param topic - the topic to publish to
+ *  @param message - the message to send, message->id is set to its packet id
+ *  @param fp - called when the message is done with, may be NULL
+ *  @param context - passed to fp
+ *  @return success code, INFLIGHT_FULL when the window is full
+ */
+DLLExport int MQTTPublishAsync(MQTTClient* client, const char*, MQTTMessage*, publishHandler fp, void* context);
+
+/** MQTT Set Inflight Window - how many QoS 1 and 2 messages MQTTPublishAsync keeps unacked
+ *  @param client - the client object to use
+ *  @param window - 1 to MQTT_MAX_INFLIGHT, the default
+ */
+DLLExport void MQTTSetInflightWindow(MQTTClient* client, int window);
+
+/** MQTT Set Queue - give the client an outbound queue, for MQTTPublishQueued
+ *  The queue is flushed through the in-flight window when the client connects and as acks come.
+ *  @param client - the client object to use
+ *  @param queue - initialized by MQTTQueue_init, NULL for none
+ */
+DLLExport void MQTTSetQueue(MQTTClient* client, MQTTQueue* queue);
+
+/** MQTT Publish Queued - put a message in the queue, then send what the window takes of it
+ *  Queued messages go in order, offline included, and leave the queue once acked. Without a
+ *  queue this is MQTTPublishAsync.
+ *  @param client - the client object to use
+ *  @param topic - the topic to publish to
+ *  @param message - the message to queue
+ *  @return success code, FAILURE when the queue refuses the message
+ */
+DLLExport int MQTTPublishQueued(MQTTClient* client, const char*, MQTTMessage*);
+
+/** MQTT Flush Queue - send queued messages while connected and the window has room
+ *  @param client - the client object to use
+ *  @return success code
+ */
+DLLExport int MQTTFlushQueue(MQTTClient* client);
+
 /** MQTT Subscribe - send an MQTT subscribe packet and wait for suback before returning.
  *  @param client - the client object to use
  *  @param topicFilter - the topic filter to subscribe to
@@ -16,7 +16,10 @@
  *******************************************************************************/
 
 #include "MQTTFreertos.h"
+#include "MQTTQueue.h"
 #include "netdb.h"
+#include "flash_api.h"
+#include "device_lock.h"
 
 #ifdef LWIP_IPV6
 #undef LWIP_IPV6
@@ -107,6 +110,51 @@ void TimerInit(Timer* timer)
 	memset(&timer->xTimeOut, '\0', sizeof(timer->xTimeOut));
 }
 
+
+/* the outbound queue of MQTTClient in flash, ctx is the address of its region */
+static flash_t queue_flash;
+
+static int FlashQueue_read(void* ctx, unsigned int offset, unsigned char* buf, unsigned int len)
+{
+	int ret;
+
+	device_mutex_lock(RT_DEV_LOCK_FLASH);
+	ret = flash_stream_read(&queue_flash, (unsigned int)ctx + offset, len, buf);
+	device_mutex_unlock(RT_DEV_LOCK_FLASH);
+	return (ret == 1) ? 0 : -1;
+}
+
+
+static int FlashQueue_write(void* ctx, unsigned int offset, const unsigned char* buf, unsigned int len)
+{
+	int ret;
+
+	device_mutex_lock(RT_DEV_LOCK_FLASH);
+	ret = flash_stream_write(&queue_flash, (unsigned int)ctx + offset, len, (unsigned char*)buf);
+	device_mutex_unlock(RT_DEV_LOCK_FLASH);
+	return (ret == 1) ? 0 : -1;
+}
+
+
+static int FlashQueue_erase(void* ctx, unsigned int offset)
+{
+	device_mutex_lock(RT_DEV_LOCK_FLASH);
+	flash_erase_sector(&queue_flash, (unsigned int)ctx + offset);
+	device_mutex_unlock(RT_DEV_LOCK_FLASH);
+	return 0;
+}
+
+
+void FlashQueueInit(MQTTQueueFlash* flash, unsigned int address, unsigned int size)
+{
+	flash->read = FlashQueue_read;
+	flash->write = FlashQueue_write;
+	flash->erase = FlashQueue_erase;
+	flash->ctx = (void*)address;
+	flash->size = size;
+	flash->sector = FLASH_QUEUE_SECTOR;
+}
+
 #if CONFIG_USE_POLARSSL
 
 int FreeRTOS_read(Network* n, unsigned char* buffer, int len, int timeout_ms)
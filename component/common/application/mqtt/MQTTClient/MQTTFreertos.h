@@ -117,6 +117,12 @@ void FreeRTOS_disconnect(Network*);
 
 void NetworkInit(Network*);
 int NetworkConnect(Network*, char*, int);
+
+#define FLASH_QUEUE_SECTOR		0x1000
+
+struct MQTTQueueFlash;
+/* the flash region of an MQTTQueue, address and size multiples of FLASH_QUEUE_SECTOR, away from the images */
+void FlashQueueInit(struct MQTTQueueFlash*, unsigned int address, unsigned int size);
 /*int NetworkConnectTLS(Network*, char*, int, SlSockSecureFiles_t*, unsigned char, unsigned int, char);*/
 
 #endif
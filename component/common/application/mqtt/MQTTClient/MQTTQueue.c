@@ -0,0 +1,520 @@
+/*******************************************************************************
+ *
+ * Outbound message queue of MQTTClient, see MQTTQueue.h.
+ *
+ * A record, little endian:
+ *   0   magic, MQTT_QUEUE_MAGIC once the whole record is written
+ *   1   0xff while kept, 0 once done
+ *   2   length of the record, header included
+ *   4   sequence number
+ *   8   packet id, 0xffff until sent
+ *   10  QoS in bits 0-1, retained in bit 2
+ *   11  0xff
+ *   12  topic length, then the topic and the payload
+ *
+ * Records do not cross sectors. A record that does not fit in the rest of
+ * a sector goes at the start of the next one, a sector is erased before its
+ * first record is written. The tail stays put after a failed write, or one
+ * cut short by a reset, and the next record skips to the next sector. The
+ * tail never comes round to the head while records are kept.
+ *
+ *******************************************************************************/
+
+#include <string.h>
+#include "MQTTQueue.h"
+
+#define MQTT_QUEUE_MAGIC    0xa5
+#define MQTT_QUEUE_KEPT     0xff
+#define MQTT_QUEUE_UNSENT   0xffff
+
+#define GET16(p)            ((unsigned int)(p)[0] | ((unsigned int)(p)[1] << 8))
+#define GET32(p)            (GET16(p) | (GET16((p) + 2) << 16))
+
+
+static void put16(unsigned char* p, unsigned int v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+
+static void put32(unsigned char* p, unsigned int v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+
+/* the RAM tier, on the same interface as the flash, ctx is the queue */
+static int ramRead(void* ctx, unsigned int offset, unsigned char* buf, unsigned int len)
+{
+    memcpy(buf, ((MQTTQueue*)ctx)->ram + offset, len);
+    return 0;
+}
+
+
+static int ramWrite(void* ctx, unsigned int offset, const unsigned char* buf, unsigned int len)
+{
+    memcpy(((MQTTQueue*)ctx)->ram + offset, buf, len);
+    return 0;
+}
+
+
+static int ramErase(void* ctx, unsigned int offset)
+{
+    memset(((MQTTQueue*)ctx)->ram + offset, 0xff, ((MQTTQueue*)ctx)->tier[0].medium.sector);
+    return 0;
+}
+
+
+static unsigned int sectorOf(MQTTQueueLog* l, unsigned int offset)
+{
+    return offset - offset % l->medium.sector;
+}
+
+
+static unsigned int nextSector(MQTTQueueLog* l, unsigned int offset)
+{
+    return (sectorOf(l, offset) + l->medium.sector) % l->medium.size;
+}
+
+
+/* the record length at offset, 0 for erased space or what cannot be a record */
+static unsigned int readHeader(MQTTQueueLog* l, unsigned int offset, unsigned char* h)
+{
+    unsigned int len;
+
+    if (sectorOf(l, offset) + l->medium.sector - offset < MQTT_QUEUE_HEADER_LEN)
+        return 0;
+    if (l->medium.read(l->medium.ctx, offset, h, MQTT_QUEUE_HEADER_LEN) != 0)
+        return 0;
+    len = GET16(h + 2);
+    if (len < MQTT_QUEUE_HEADER_LEN || sectorOf(l, offset) + l->medium.sector - offset < len)
+        return 0;
+    return len;
+}
+
+
+static int isKept(const unsigned char* h)
+{
+    return h[0] == MQTT_QUEUE_MAGIC && h[1] == MQTT_QUEUE_KEPT;
+}
+
+
+static int isErased(MQTTQueueLog* l, unsigned int offset)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    int i;
+
+    if (sectorOf(l, offset) + l->medium.sector - offset < MQTT_QUEUE_HEADER_LEN)
+        return 1;   // the rest of the sector is never written
+    if (l->medium.read(l->medium.ctx, offset, h, MQTT_QUEUE_HEADER_LEN) != 0)
+        return 0;
+    for (i = 0; i < MQTT_QUEUE_HEADER_LEN; i++)
+        if (h[i] != 0xff)
+            return 0;
+    return 1;
+}
+
+
+/* the record after the one at offset, tail last */
+static unsigned int step(MQTTQueueLog* l, unsigned int offset)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    unsigned int len = readHeader(l, offset, h),
+      next = offset + len;
+
+    if (len != 0 && next % l->medium.size == l->tail)
+        return l->tail;
+    if (len != 0 && next - sectorOf(l, offset) < l->medium.sector && readHeader(l, next, h) != 0)
+        return next;
+    if (sectorOf(l, l->tail) == sectorOf(l, offset) && l->tail > offset)
+        return l->tail;
+    return nextSector(l, offset);   // the rest of the sector is unused
+}
+
+
+/* head past the records done, send with it */
+static void skipDone(MQTTQueueLog* l)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    int send_passed = 0;
+
+    while (l->head != l->tail && !(readHeader(l, l->head, h) && isKept(h)))
+    {
+        if (l->send == l->head)
+            send_passed = 1;
+        l->head = step(l, l->head);
+    }
+    if (send_passed)
+        l->send = l->head;
+}
+
+
+/* where a record of len bytes goes, its sector erased if it starts one */
+static int reserve(MQTTQueueLog* l, unsigned int len, unsigned int* where)
+{
+    unsigned int at = l->tail;
+
+    if (len > l->medium.sector)
+        return -1;
+    if (at != sectorOf(l, at) && (sectorOf(l, at) + l->medium.sector - at < len || !isErased(l, at)))
+        at = nextSector(l, at);     // no room, or the rest of a failed write
+    if (at == sectorOf(l, at))
+    {
+        if (l->count > 0 && sectorOf(l, l->head) == at)
+            return -1;  // full
+        if (l->medium.erase(l->medium.ctx, at) != 0)
+            return -1;
+    }
+
+    if (l->count > 0 && (at + len) % l->medium.size == l->head)
+        return -1;      // full, tail would be taken for head
+    *where = at;
+    return 0;
+}
+
+
+/* the record written at at is the tail one */
+static void appended(MQTTQueueLog* l, unsigned int at, unsigned int len)
+{
+    if (l->count == 0)
+        l->head = l->send = at;
+    else if (l->send == l->tail)
+        l->send = at;
+    l->tail = (at + len) % l->medium.size;
+    l->count++;
+}
+
+
+static int append(MQTTQueueLog* l, const unsigned char* h, const char* topic, int topiclen,
+    const void* payload, int payloadlen)
+{
+    unsigned int len = MQTT_QUEUE_HEADER_LEN + topiclen + payloadlen;
+    unsigned int at;
+    unsigned char magic = MQTT_QUEUE_MAGIC;
+
+    if (reserve(l, len, &at) != 0)
+        return -1;
+    if (l->medium.write(l->medium.ctx, at, h, MQTT_QUEUE_HEADER_LEN) != 0 ||
+        l->medium.write(l->medium.ctx, at + MQTT_QUEUE_HEADER_LEN, (const unsigned char*)topic, topiclen) != 0 ||
+        (payloadlen > 0 &&
+         l->medium.write(l->medium.ctx, at + MQTT_QUEUE_HEADER_LEN + topiclen, (const unsigned char*)payload, payloadlen) != 0) ||
+        l->medium.write(l->medium.ctx, at, &magic, 1) != 0)     // commit
+        return -1;
+    appended(l, at, len);
+    return 0;
+}
+
+
+/* MQTT_QUEUE_DROP_OLDEST: the records of the head sector go, the sector is erased */
+static int dropOldest(MQTTQueue* q, MQTTQueueLog* l)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    unsigned int sector = sectorOf(l, l->head),
+      at = l->head;
+    int send_passed = 0;
+
+    while (at != l->tail && sectorOf(l, at) == sector)
+    {
+        if (readHeader(l, at, h) && isKept(h))
+        {
+            l->count--;
+            q->dropped++;
+        }
+        if (at == l->send)
+            send_passed = 1;
+        at = step(l, at);
+    }
+    if (l->medium.erase(l->medium.ctx, sector) != 0)
+        return -1;
+    if (l->count == 0)
+        at = l->tail = sector;  // the next record starts it again
+    l->head = at;
+    if (send_passed || l->count == 0)
+        l->send = at;
+    skipDone(l);
+    return 0;
+}
+
+
+/*
+ * The oldest records of the flash tier go to the RAM ring, after those of
+ * the ring, until the ring is full or the flash head sector is left with
+ * none. They are read straight into the ring and marked done in flash.
+ */
+static void moveToRing(MQTTQueue* q)
+{
+    MQTTQueueLog* ring = &q->tier[0];
+    MQTTQueueLog* l = &q->tier[1];
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    unsigned char zero = 0;
+    unsigned int sector = sectorOf(l, l->head),
+      len, at;
+    int sent;
+
+    while (l->count > 0 && sectorOf(l, l->head) == sector)
+    {
+        len = readHeader(l, l->head, h);
+        sent = (l->send != l->head);    // all of the ring was then sent too
+        if (reserve(ring, len, &at) != 0 ||
+            l->medium.read(l->medium.ctx, l->head, q->ram + at, len) != 0)
+            return;
+        appended(ring, at, len);
+        if (sent)
+            ring->send = ring->tail;
+        if (l->medium.write(l->medium.ctx, l->head + 1, &zero, 1) != 0)
+            return;     // kept in both, the flash one goes again after a reboot only
+        l->count--;
+        skipDone(l);
+    }
+}
+
+
+/*
+ * MQTT_QUEUE_DROP_OLDEST with a full queue: the oldest records are at the
+ * head of the RAM ring when it holds any, the flash tier gets room when its
+ * oldest records move into the room left in the ring.
+ */
+static int makeRoom(MQTTQueue* q)
+{
+    MQTTQueueLog* l = &q->tier[q->tiers - 1];
+
+    if (q->tiers > 1 && q->tier[0].count > 0)
+    {
+        if (dropOldest(q, &q->tier[0]) != 0)
+            return -1;
+        moveToRing(q);
+        return 0;
+    }
+    if (l->count == 0)
+        return -1;
+    return dropOldest(q, l);
+}
+
+
+/* the records of a flash log left by the last boot */
+static void recover(MQTTQueue* q, MQTTQueueLog* l)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    unsigned int sector, at, len, seq,
+      first_seq = 0, last_seq = 0;
+    int found = 0, kept = 0;
+
+    l->head = l->send = l->tail = 0;
+    l->count = 0;
+    for (sector = 0; sector < l->medium.size; sector += l->medium.sector)
+    {
+        for (at = sector; at < sector + l->medium.sector && (len = readHeader(l, at, h)) != 0; at += len)
+        {
+            if (h[0] != MQTT_QUEUE_MAGIC)
+                continue;   // never committed
+            seq = GET32(h + 4);
+            if (!found || (int)(seq - last_seq) > 0)
+            {
+                last_seq = seq;
+                l->tail = (at + len) % l->medium.size;
+            }
+            if (isKept(h))
+            {
+                if (!kept || (int)(seq - first_seq) < 0)
+                {
+                    first_seq = seq;
+                    l->head = at;
+                }
+                kept = 1;
+                l->count++;
+            }
+            found = 1;
+        }
+    }
+    if (found && (int)(last_seq + 1 - q->seq) > 0)
+        q->seq = last_seq + 1;
+    if (!kept)
+        l->head = l->tail;
+    l->send = l->head;
+}
+
+
+int MQTTQueue_init(MQTTQueue* q, unsigned char* ram, unsigned int ram_size, const MQTTQueueFlash* flash, int policy)
+{
+    MQTTQueueLog* l;
+
+    memset(q, 0, sizeof(MQTTQueue));
+    q->policy = policy;
+    q->ram = ram;
+    if (ram != NULL && ram_size >= MQTT_QUEUE_RAM_SECTORS * MQTT_QUEUE_HEADER_LEN)
+    {
+        l = &q->tier[q->tiers++];
+        l->medium.read = ramRead;
+        l->medium.write = ramWrite;
+        l->medium.erase = ramErase;
+        l->medium.ctx = q;
+        l->medium.sector = ram_size / MQTT_QUEUE_RAM_SECTORS;
+        l->medium.size = l->medium.sector * MQTT_QUEUE_RAM_SECTORS;
+    }
+    if (flash != NULL)
+    {
+        if (flash->sector < MQTT_QUEUE_HEADER_LEN || flash->size < flash->sector || flash->size % flash->sector)
+            return -1;
+        l = &q->tier[q->tiers++];
+        l->medium = *flash;
+        recover(q, l);
+    }
+    return (q->tiers > 0) ? 0 : -1;
+}
+
+
+int MQTTQueue_push(MQTTQueue* q, const char* topic, int qos, unsigned char retained, const void* payload, int payloadlen)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    int topiclen = (int)strlen(topic);
+    int i = q->tiers - 1;
+
+    // after the tiers holding records, to keep the order
+    while (i > 0 && q->tier[i].count == 0 && q->tier[i].head == q->tier[i].tail)
+        i--;
+    memset(h, 0xff, sizeof(h));
+    put16(h + 2, MQTT_QUEUE_HEADER_LEN + topiclen + payloadlen);
+    put32(h + 4, q->seq);
+    h[10] = (unsigned char)((qos & 3) | (retained ? 4 : 0));
+    put16(h + 12, topiclen);
+
+    for (; i < q->tiers; i++)
+        if (append(&q->tier[i], h, topic, topiclen, payload, payloadlen) == 0)
+            break;
+    if (i == q->tiers)
+    {
+        MQTTQueueLog* l = &q->tier[q->tiers - 1];
+
+        // a message no sector can hold would have every record dropped for nothing
+        if (q->policy != MQTT_QUEUE_DROP_OLDEST ||
+            (unsigned int)(MQTT_QUEUE_HEADER_LEN + topiclen + payloadlen) > l->medium.sector)
+            return -1;
+        do
+            if (makeRoom(q) != 0)
+                return -1;
+        while (append(l, h, topic, topiclen, payload, payloadlen) != 0);
+    }
+    q->seq++;
+    return 0;
+}
+
+
+int MQTTQueue_count(MQTTQueue* q)
+{
+    int i, n = 0;
+
+    for (i = 0; i < q->tiers; i++)
+        n += q->tier[i].count;
+    return n;
+}
+
+
+int MQTTQueue_next(MQTTQueue* q, MQTTQueueEntry* e)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    int i;
+
+    for (i = 0; i < q->tiers; i++)
+    {
+        MQTTQueueLog* l = &q->tier[i];
+
+        while (l->send != l->tail)
+        {
+            if (readHeader(l, l->send, h) && isKept(h))
+            {
+                e->tier = i;
+                e->offset = l->send;
+                e->seq = GET32(h + 4);
+                e->id = (unsigned short)GET16(h + 8);
+                if (e->id == MQTT_QUEUE_UNSENT)
+                    e->id = 0;
+                e->qos = h[10] & 3;
+                e->retained = (h[10] & 4) ? 1 : 0;
+                e->topiclen = GET16(h + 12);
+                e->payloadlen = GET16(h + 2) - MQTT_QUEUE_HEADER_LEN - e->topiclen;
+                return 0;
+            }
+            l->send = step(l, l->send);
+        }
+    }
+    return -1;
+}
+
+
+/* topic gets topiclen + 1 bytes, terminated */
+int MQTTQueue_read(MQTTQueue* q, MQTTQueueEntry* e, char* topic, unsigned char* payload)
+{
+    MQTTQueueLog* l = &q->tier[e->tier];
+    unsigned int at = e->offset + MQTT_QUEUE_HEADER_LEN;
+
+    if (l->medium.read(l->medium.ctx, at, (unsigned char*)topic, e->topiclen) != 0 ||
+        (e->payloadlen > 0 && l->medium.read(l->medium.ctx, at + e->topiclen, payload, e->payloadlen) != 0))
+        return -1;
+    topic[e->topiclen] = '\0';
+    return 0;
+}
+
+
+/* a QoS 0 record is done once sent, the others wait for MQTTQueue_done */
+int MQTTQueue_sent(MQTTQueue* q, MQTTQueueEntry* e, unsigned short id)
+{
+    MQTTQueueLog* l = &q->tier[e->tier];
+    unsigned char b[2];
+    int rc = 0;
+
+    if (l->send != e->offset)
+        return -1;  // dropped meanwhile
+    l->send = step(l, l->send);
+    if (e->qos == 0)
+    {
+        b[0] = 0;
+        if ((rc = l->medium.write(l->medium.ctx, e->offset + 1, b, 1)) == 0)
+            l->count--;
+        skipDone(l);
+    }
+    else if (e->id == 0)
+    {
+        put16(b, id);   // kept for a reboot, to go again as a duplicate
+        rc = l->medium.write(l->medium.ctx, e->offset + 8, b, 2);
+    }
+    return rc;
+}
+
+
+int MQTTQueue_done(MQTTQueue* q, unsigned short id)
+{
+    unsigned char h[MQTT_QUEUE_HEADER_LEN];
+    unsigned char zero = 0;
+    int i;
+
+    for (i = 0; i < q->tiers; i++)
+    {
+        MQTTQueueLog* l = &q->tier[i];
+        unsigned int at;
+
+        for (at = l->head; at != l->send; at = step(l, at))
+        {
+            if (readHeader(l, at, h) && isKept(h) && GET16(h + 8) == id)
+            {
+                if (l->medium.write(l->medium.ctx, at + 1, &zero, 1) != 0)
+                    return -1;
+                l->count--;
+                skipDone(l);
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+
+/* what was sent goes again, the client having dropped its in-flight messages */
+void MQTTQueue_rewind(MQTTQueue* q)
+{
+    int i;
+
+    for (i = 0; i < q->tiers; i++)
+        q->tier[i].send = q->tier[i].head;
+}
@@ -0,0 +1,100 @@
+#if !defined(__MQTT_QUEUE_H_)
+#define __MQTT_QUEUE_H_
+
+/*******************************************************************************
+ *
+ * Outbound message queue of MQTTClient, so the messages published while the
+ * network is down go once it is back, in the order they were queued.
+ *
+ *   - Two tiers, each a log of records in erase sectors: a RAM ring, and
+ *     optionally a flash region the messages spill to when the ring is full.
+ *     Every record of the ring is older than those in flash, give the ring
+ *     no room and all messages go to flash.
+ *   - A record leaves the queue when its PUBACK/PUBCOMP comes, a QoS 0 one
+ *     once sent. The packet id of a sent record is written to it, so after a
+ *     reboot the flash records go again with their id and the DUP flag.
+ *   - A record is committed by its first byte written last, a power cut
+ *     during a write loses that record only. A sector is erased when the
+ *     writes come to it.
+ *   - When the last tier is full, MQTT_QUEUE_DROP_OLDEST drops the oldest
+ *     sector of records, of the RAM ring while it holds any, the oldest
+ *     flash records then moving into the ring to make room in flash.
+ *     MQTT_QUEUE_DROP_NEWEST refuses the new message, as does either policy
+ *     for a message larger than a sector.
+ *
+ * MQTTSetQueue gives a queue to an MQTTClient, MQTTPublishQueued fills it and
+ * the client flushes it through its in-flight window. There is no locking,
+ * the client task makes the calls. Checked on the host with a simulated
+ * flash by tools/mqtt_queue_bench.
+ *
+ *******************************************************************************/
+
+#if defined(__cplusplus)
+ extern "C" {
+#endif
+
+#if !defined(MQTT_QUEUE_RAM_SECTORS)
+#define MQTT_QUEUE_RAM_SECTORS  4   /* the RAM ring is freed a quarter at a time */
+#endif
+
+#define MQTT_QUEUE_HEADER_LEN   14  /* a record is this, its topic and its payload */
+
+enum MQTTQueuePolicy { MQTT_QUEUE_DROP_OLDEST, MQTT_QUEUE_DROP_NEWEST };
+
+/* flash region of the queue, offsets from its start, 0 on success */
+typedef struct MQTTQueueFlash
+{
+    int (*read)(void* ctx, unsigned int offset, unsigned char* buf, unsigned int len);
+    int (*write)(void* ctx, unsigned int offset, const unsigned char* buf, unsigned int len);
+    int (*erase)(void* ctx, unsigned int offset);      /* the sector at offset, to 0xff */
+    void* ctx;
+    unsigned int size;          /* a multiple of sector */
+    unsigned int sector;
+} MQTTQueueFlash;
+
+typedef struct MQTTQueueLog
+{
+    MQTTQueueFlash medium;
+    unsigned int head,          /* oldest record kept */
+      send,                     /* next record to send */
+      tail;                     /* where the next record goes, a sector start is erased first */
+    int count;                  /* records kept */
+} MQTTQueueLog;
+
+typedef struct MQTTQueue
+{
+    MQTTQueueLog tier[2];       /* RAM, then flash */
+    int tiers;
+    int policy;
+    unsigned int seq;           /* of the next record */
+    unsigned char* ram;
+    int dropped;                /* records dropped by MQTT_QUEUE_DROP_OLDEST */
+} MQTTQueue;
+
+/* the next record to send, from MQTTQueue_next */
+typedef struct MQTTQueueEntry
+{
+    int tier;
+    unsigned int offset;
+    unsigned int seq;
+    unsigned short id;          /* 0 when never sent, else its packet id */
+    unsigned char qos;
+    unsigned char retained;
+    int topiclen;
+    int payloadlen;
+} MQTTQueueEntry;
+
+int MQTTQueue_init(MQTTQueue* q, unsigned char* ram, unsigned int ram_size, const MQTTQueueFlash* flash, int policy);
+int MQTTQueue_push(MQTTQueue* q, const char* topic, int qos, unsigned char retained, const void* payload, int payloadlen);
+int MQTTQueue_count(MQTTQueue* q);
+int MQTTQueue_next(MQTTQueue* q, MQTTQueueEntry* e);
+int MQTTQueue_read(MQTTQueue* q, MQTTQueueEntry* e, char* topic, unsigned char* payload);
+int MQTTQueue_sent(MQTTQueue* q, MQTTQueueEntry* e, unsigned short id);
+int MQTTQueue_done(MQTTQueue* q, unsigned short id);
+void MQTTQueue_rewind(MQTTQueue* q);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,486 @@
+/*******************************************************************************
+ *
+ * Subscription index of the MQTT clients, see MQTTTopicTrie.h.
+ *
+ *******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "MQTTTopicTrie.h"
+
+/* literal children a node scans in a list, above that they are hashed */
+#define MQTT_TOPIC_LIST_MAX     8
+#define MQTT_TOPIC_BUCKETS_MAX  32768
+
+typedef struct MQTTTopicValue
+{
+    struct MQTTTopicValue* next;
+    void* value;
+} MQTTTopicValue;
+
+struct MQTTTopicNode
+{
+    MQTTTopicNode* parent;
+    MQTTTopicNode* child;       /* first literal level below, while they are not hashed */
+    MQTTTopicNode** buckets;    /* literal levels below hashed, NULL while they are few */
+    MQTTTopicNode* sibling;     /* next literal level of the parent, in the same bucket */
+    MQTTTopicNode* plus;        /* "+" level below */
+    MQTTTopicNode* hash;        /* "#" level below */
+    MQTTTopicValue* values;     /* of the filters ending here, in subscription order */
+    unsigned short nbuckets;    /* a power of two */
+    unsigned short nchildren;   /* literal ones */
+    unsigned short len;
+    char level[1];              /* len bytes, not terminated */
+};
+
+typedef struct MQTTTopicMatch
+{
+    MQTTTopicNode* root;
+    const char* end;
+    int dollar;                 /* the topic starts with '$' */
+    int count;
+    MQTTTopicVisit visit;
+    void* arg;
+} MQTTTopicMatch;
+
+
+static int levelLen(const char* p, const char* end)
+{
+    const char* q = p;
+
+    while (q < end && *q != '/')
+        q++;
+    return (int)(q - p);
+}
+
+
+static MQTTTopicNode* newNode(MQTTTopicNode* parent, const char* level, int len)
+{
+    MQTTTopicNode* node = (MQTTTopicNode*)malloc(sizeof(MQTTTopicNode) + len);
+
+    if (node == NULL)
+        return NULL;
+    memset(node, 0, sizeof(MQTTTopicNode));
+    node->parent = parent;
+    node->len = (unsigned short)len;
+    memcpy(node->level, level, len);
+    return node;
+}
+
+
+static unsigned int hashLevel(const char* level, int len)
+{
+    unsigned int h = 2166136261u;   /* FNV-1a */
+
+    while (len-- > 0)
+        h = (h ^ (unsigned char)*level++) * 16777619u;
+    return h;
+}
+
+
+/* the list of literal children where level is or goes */
+static MQTTTopicNode** childList(MQTTTopicNode* node, const char* level, int len)
+{
+    if (node->buckets == NULL)
+        return &node->child;
+    return &node->buckets[hashLevel(level, len) & (node->nbuckets - 1)];
+}
+
+
+static MQTTTopicNode* findLiteral(MQTTTopicNode* node, const char* level, int len)
+{
+    MQTTTopicNode* child;
+
+    for (child = *childList(node, level, len); child != NULL; child = child->sibling)
+        if (child->len == len && memcmp(child->level, level, len) == 0)
+            return child;
+    return NULL;
+}
+
+
+/* the literal children lists of node, buckets or the one list */
+static MQTTTopicNode** childLists(MQTTTopicNode* node, int* n)
+{
+    *n = node->buckets ? node->nbuckets : 1;
+    return node->buckets ? node->buckets : &node->child;
+}
+
+
+/* more buckets for the literal children, left as they are without memory */
+static void growChildren(MQTTTopicNode* node)
+{
+    unsigned int nbuckets = node->buckets ? node->nbuckets * 2u : MQTT_TOPIC_LIST_MAX * 2u;
+    MQTTTopicNode** old;
+    MQTTTopicNode** buckets;
+    MQTTTopicNode* child;
+    int n, i;
+
+    if (nbuckets > MQTT_TOPIC_BUCKETS_MAX)
+        return;
+    if ((buckets = (MQTTTopicNode**)calloc(nbuckets, sizeof(MQTTTopicNode*))) == NULL)
+        return;
+    old = childLists(node, &n);
+    for (i = 0; i < n; i++)
+    {
+        while ((child = old[i]) != NULL)
+        {
+            old[i] = child->sibling;
+            child->sibling = buckets[hashLevel(child->level, child->len) & (nbuckets - 1)];
+            buckets[hashLevel(child->level, child->len) & (nbuckets - 1)] = child;
+        }
+    }
+    free(node->buckets);
+    node->buckets = buckets;
+    node->nbuckets = (unsigned short)nbuckets;
+}
+
+
+/* the child of node for one level of a filter, wildcards taken as such */
+static MQTTTopicNode* getChild(MQTTTopicNode* node, const char* level, int len, int create)
+{
+    MQTTTopicNode** slot = NULL;
+    MQTTTopicNode* child;
+
+    if (len == 1 && level[0] == '+')
+        slot = &node->plus;
+    else if (len == 1 && level[0] == '#')
+        slot = &node->hash;
+    else if ((child = findLiteral(node, level, len)) != NULL || !create)
+        return child;
+
+    if (slot != NULL && (*slot != NULL || !create))
+        return *slot;
+    if ((child = newNode(node, level, len)) == NULL)
+        return NULL;
+    if (slot != NULL)
+        *slot = child;
+    else
+    {
+        slot = childList(node, level, len);
+        child->sibling = *slot;
+        *slot = child;
+        node->nchildren++;
+        if (node->nchildren > (node->buckets ? 2 * node->nbuckets : MQTT_TOPIC_LIST_MAX))
+            growChildren(node);
+    }
+    return child;
+}
+
+
+/* free node and its parents as long as they hold nothing */
+static void prune(MQTTTopicTrie* t, MQTTTopicNode* node)
+{
+    MQTTTopicNode* parent;
+    MQTTTopicNode** pp;
+
+    while (node != NULL && node->values == NULL && node->nchildren == 0 && node->plus == NULL && node->hash == NULL)
+    {
+        parent = node->parent;
+        if (parent == NULL)
+            t->root = NULL;
+        else if (parent->plus == node)
+            parent->plus = NULL;
+        else if (parent->hash == node)
+            parent->hash = NULL;
+        else
+        {
+            for (pp = childList(parent, node->level, node->len); *pp != node; pp = &(*pp)->sibling)
+                ;
+            *pp = node->sibling;
+            if (--parent->nchildren == 0 && parent->buckets != NULL)
+            {
+                free(parent->buckets);
+                parent->buckets = NULL;
+                parent->nbuckets = 0;
+            }
+        }
+        free(node->buckets);
+        free(node);
+        node = parent;
+    }
+}
+
+
+/* "+" and "#" stand alone in their level, "#" is the last one */
+static int validFilter(const char* filter)
+{
+    const char* p = filter;
+    const char* end = filter + strlen(filter);
+    int len;
+
+    if (p == end)
+        return 0;
+    while (1)
+    {
+        len = levelLen(p, end);
+        if ((memchr(p, '+', len) != NULL || memchr(p, '#', len) != NULL) && len != 1)
+            return 0;
+        if (p + len == end)
+            return 1;
+        if (*p == '#')
+            return 0;
+        p += len + 1;
+    }
+}
+
+
+/* the node where filter ends, created on the way if create */
+static MQTTTopicNode* findFilter(MQTTTopicTrie* t, const char* filter, int create)
+{
+    const char* p = filter;
+    const char* end = filter + strlen(filter);
+    MQTTTopicNode* node;
+    MQTTTopicNode* parent;
+    int len;
+
+    if (t->root == NULL && create)
+        t->root = newNode(NULL, "", 0);
+    node = t->root;
+    while (node != NULL)
+    {
+        len = levelLen(p, end);
+        parent = node;
+        if ((node = getChild(parent, p, len, create)) == NULL && create)
+            prune(t, parent);   /* out of memory, drop the levels made so far */
+        if (p + len == end)
+            break;
+        p += len + 1;
+    }
+    return node;
+}
+
+
+void MQTTTopicTrie_init(MQTTTopicTrie* t)
+{
+    t->root = NULL;
+    t->count = 0;
+}
+
+
+/**
+ * Subscribe value to filter. The same value may be added again, to the same
+ * filter or to others.
+ *
+ * @return 0, -1 if the filter is not valid or on allocation failure
+ */
+int MQTTTopicTrie_add(MQTTTopicTrie* t, const char* filter, void* value)
+{
+    MQTTTopicNode* node;
+    MQTTTopicValue* v;
+    MQTTTopicValue** pv;
+
+    if (!validFilter(filter))
+        return -1;
+    if ((node = findFilter(t, filter, 1)) == NULL)
+        return -1;
+    if ((v = (MQTTTopicValue*)malloc(sizeof(MQTTTopicValue))) == NULL)
+    {
+        prune(t, node);
+        return -1;
+    }
+    v->next = NULL;
+    v->value = value;
+    for (pv = &node->values; *pv != NULL; pv = &(*pv)->next)
+        ;
+    *pv = v;
+    t->count++;
+    return 0;
+}
+
+
+/**
+ * Take value off filter, the levels left empty are freed.
+ *
+ * @return 0, -1 if value was not subscribed to filter
+ */
+int MQTTTopicTrie_remove(MQTTTopicTrie* t, const char* filter, void* value)
+{
+    MQTTTopicNode* node = findFilter(t, filter, 0);
+    MQTTTopicValue** pv;
+    MQTTTopicValue* v;
+
+    if (node == NULL)
+        return -1;
+    for (pv = &node->values; *pv != NULL && (*pv)->value != value; pv = &(*pv)->next)
+        ;
+    if ((v = *pv) == NULL)
+        return -1;
+    *pv = v->next;
+    free(v);
+    t->count--;
+    prune(t, node);
+    return 0;
+}
+
+
+/**
+ * The values subscribed to exactly filter (wildcards compared as characters),
+ * in subscription order: the first one for prev NULL, then the one after prev.
+ *
+ * @return NULL after the last one
+ */
+void* MQTTTopicTrie_next(MQTTTopicTrie* t, const char* filter, void* prev)
+{
+    MQTTTopicNode* node = findFilter(t, filter, 0);
+    MQTTTopicValue* v;
+
+    if (node == NULL)
+        return NULL;
+    v = node->values;
+    if (prev != NULL)
+    {
+        while (v != NULL && v->value != prev)
+            v = v->next;
+        if (v != NULL)
+            v = v->next;
+    }
+    return (v != NULL) ? v->value : NULL;
+}
+
+
+static int visitValues(MQTTTopicNode* node, MQTTTopicMatch* m)
+{
+    MQTTTopicValue* v;
+
+    for (v = node->values; v != NULL; v = v->next)
+    {
+        m->count++;
+        if (m->visit != NULL && m->visit(v->value, m->arg))
+            return 1;
+    }
+    return 0;
+}
+
+
+/* node matched the levels before p, p is NULL when the topic has no level left */
+static int matchNode(MQTTTopicNode* node, const char* p, MQTTTopicMatch* m)
+{
+    MQTTTopicNode* child;
+    const char* next;
+    int wild = !(node == m->root && m->dollar);
+    int len;
+
+    if (p == NULL)
+    {
+        if (visitValues(node, m))
+            return 1;
+    }
+    else
+    {
+        len = levelLen(p, m->end);
+        next = (p + len < m->end) ? p + len + 1 : NULL;
+        if ((child = findLiteral(node, p, len)) != NULL && matchNode(child, next, m))
+            return 1;
+        if (node->plus != NULL && wild && matchNode(node->plus, next, m))
+            return 1;
+    }
+    if (node->hash != NULL && wild)
+        return visitValues(node->hash, m);
+    return 0;
+}
+
+
+/**
+ * Visit the values of the filters matching a topic name, the exact levels of
+ * a filter before "+" before "#". visit must not change the trie.
+ *
+ * @param topic: len bytes, no wildcard, not terminated
+ * @param visit: NULL to only count them
+ * @return number of values visited
+ */
+int MQTTTopicTrie_match(MQTTTopicTrie* t, const char* topic, int len, MQTTTopicVisit visit, void* arg)
+{
+    MQTTTopicMatch m;
+
+    if (t->root == NULL || len <= 0)
+        return 0;
+    m.root = t->root;
+    m.end = topic + len;
+    m.dollar = (topic[0] == '$');
+    m.count = 0;
+    m.visit = visit;
+    m.arg = arg;
+    matchNode(t->root, topic, &m);
+    return m.count;
+}
+
+
+static int foreachNode(MQTTTopicNode* node, MQTTTopicMatch* m)
+{
+    MQTTTopicNode** lists;
+    MQTTTopicNode* child;
+    int n, i;
+
+    if (visitValues(node, m))
+        return 1;
+    lists = childLists(node, &n);
+    for (i = 0; i < n; i++)
+        for (child = lists[i]; child != NULL; child = child->sibling)
+            if (foreachNode(child, m))
+                return 1;
+    if (node->plus != NULL && foreachNode(node->plus, m))
+        return 1;
+    return node->hash != NULL && foreachNode(node->hash, m);
+}
+
+
+/**
+ * Visit every value of the trie. visit must not change the trie.
+ *
+ * @return number of values visited
+ */
+int MQTTTopicTrie_foreach(MQTTTopicTrie* t, MQTTTopicVisit visit, void* arg)
+{
+    MQTTTopicMatch m;
+
+    memset(&m, 0, sizeof(m));
+    m.visit = visit;
+    m.arg = arg;
+    if (t->root != NULL)
+        foreachNode(t->root, &m);
+    return m.count;
+}
+
+
+static void clearNode(MQTTTopicNode* node, MQTTTopicVisit visit, void* arg)
+{
+    MQTTTopicNode** lists;
+    MQTTTopicNode* child;
+    MQTTTopicValue* v;
+    int n, i;
+
+    lists = childLists(node, &n);
+    for (i = 0; i < n; i++)
+    {
+        while ((child = lists[i]) != NULL)
+        {
+            lists[i] = child->sibling;
+            clearNode(child, visit, arg);
+        }
+    }
+    free(node->buckets);
+    if (node->plus != NULL)
+        clearNode(node->plus, visit, arg);
+    if (node->hash != NULL)
+        clearNode(node->hash, visit, arg);
+    while ((v = node->values) != NULL)
+    {
+        node->values = v->next;
+        if (visit != NULL)
+            visit(v->value, arg);
+        free(v);
+    }
+    free(node);
+}
+
+
+/**
+ * Empty the trie, visit (may be NULL) gets every value before it goes, to
+ * free it. Its return value is ignored.
+ */
+void MQTTTopicTrie_clear(MQTTTopicTrie* t, MQTTTopicVisit visit, void* arg)
+{
+    if (t->root != NULL)
+        clearNode(t->root, visit, arg);
+    MQTTTopicTrie_init(t);
+}
@@ -0,0 +1,52 @@
+#if !defined(__MQTT_TOPIC_TRIE_H_)
+#define __MQTT_TOPIC_TRIE_H_
+
+/*******************************************************************************
+ *
+ * Subscription index of the MQTT clients (MQTTClient and the QCloud SDK): the
+ * topic filters in a tree of topic levels, so dispatching a PUBLISH costs one
+ * step per level of its topic name instead of one match per subscription.
+ *
+ *   - "+" and "#" levels are kept apart from the literal children of a node,
+ *     a topic level looks at most at its literal child and at those two.
+ *     Literal children are hashed once a node has more than a few, so a
+ *     gateway's hundreds of sub-device levels cost one lookup too.
+ *   - "#" also matches the parent level ("a/#" gets "a"), and a filter that
+ *     starts with a wildcard does not match a topic starting with '$', as
+ *     MQTT 3.1.1 section 4.7 asks.
+ *   - Every filter holds any number of values (the client's handlers),
+ *     nodes and values are allocated with malloc() as filters come.
+ *
+ * There is no locking, the client serializes the calls. Measured and checked
+ * on the host by tools/mqtt_topic_bench.
+ *
+ *******************************************************************************/
+
+#if defined(__cplusplus)
+ extern "C" {
+#endif
+
+typedef struct MQTTTopicNode MQTTTopicNode;
+
+typedef struct MQTTTopicTrie
+{
+    MQTTTopicNode* root;
+    int count;                  /* values in the trie */
+} MQTTTopicTrie;
+
+/* return non zero to stop the walk */
+typedef int (*MQTTTopicVisit)(void* value, void* arg);
+
+void MQTTTopicTrie_init(MQTTTopicTrie* t);
+int MQTTTopicTrie_add(MQTTTopicTrie* t, const char* filter, void* value);
+int MQTTTopicTrie_remove(MQTTTopicTrie* t, const char* filter, void* value);
+void* MQTTTopicTrie_next(MQTTTopicTrie* t, const char* filter, void* prev);
+int MQTTTopicTrie_match(MQTTTopicTrie* t, const char* topic, int len, MQTTTopicVisit visit, void* arg);
+int MQTTTopicTrie_foreach(MQTTTopicTrie* t, MQTTTopicVisit visit, void* arg);
+void MQTTTopicTrie_clear(MQTTTopicTrie* t, MQTTTopicVisit visit, void* arg);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
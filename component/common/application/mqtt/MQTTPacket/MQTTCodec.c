@@ -0,0 +1,229 @@
+/*******************************************************************************
+ *
+ * Codec of the PUBLISH, ack and zero length packets, see MQTTCodec.h.
+ *
+ * The functions return the length of the packet, or MQTTCODEC_ERROR for a
+ * malformed packet or argument, MQTTCODEC_BUFFER_TOO_SHORT when it does not
+ * fit. The first byte of a packet is its type in bits 4-7, DUP in bit 3, QoS
+ * in bits 1-2 and RETAIN in bit 0, written here with shifts rather than the
+ * bit fields of MQTTHeader whose order is up to the compiler.
+ *
+ *******************************************************************************/
+
+#include <string.h>
+#include "MQTTCodec.h"
+
+#define MQTTCODEC_PUBLISH	3
+#define MQTTCODEC_PUBREL	6
+
+#define HEADER(type, dup, qos, retained) \
+	(unsigned char)(((type) << 4) | (((dup) & 1) << 3) | (((qos) & 3) << 1) | ((retained) & 1))
+
+
+/* bytes taken by the remaining length rem */
+static int remLengthLen(int rem)
+{
+	return (rem < 128) ? 1 : (rem < 16384) ? 2 : (rem < 2097152) ? 3 : 4;
+}
+
+
+static int putRemLength(unsigned char* p, int rem)
+{
+	int n = 0;
+
+	if (rem < 128)
+	{
+		p[0] = (unsigned char)rem;
+		return 1;
+	}
+	do
+	{
+		unsigned char d = rem % 128;
+
+		rem /= 128;
+		if (rem > 0)
+			d |= 128;
+		p[n++] = d;
+	} while (rem > 0);
+	return n;
+}
+
+
+/* reads the remaining length from the avail bytes at p, returns the bytes it took */
+static int getRemLength(const unsigned char* p, int avail, int* rem)
+{
+	int mult = 1, n = 0;
+
+	*rem = 0;
+	do
+	{
+		if (n == 4 || n >= avail)
+			return MQTTCODEC_ERROR;
+		*rem += (p[n] & 127) * mult;
+		mult *= 128;
+	} while (p[n++] & 128);
+	return n;
+}
+
+
+/**
+  * Length of the remaining part of a PUBLISH, after the fixed header
+  * @param qos the MQTT QoS of the publish (packetid is omitted for QoS 0)
+  * @param topiclen the length of the topic name
+  * @param payloadlen the length of the payload
+  * @return the remaining length, MQTTCODEC_ERROR when out of the MQTT limits
+  */
+int MQTTCodec_publishLength(int qos, int topiclen, int payloadlen)
+{
+	if (qos < 0 || qos > 2 || topiclen < 0 || topiclen > 65535 || payloadlen < 0 ||
+		payloadlen > MQTTCODEC_MAX_REM_LEN - 4 - topiclen)
+		return MQTTCODEC_ERROR;
+	return 2 + topiclen + ((qos > 0) ? 2 : 0) + payloadlen;
+}
+
+
+/**
+  * Writes the fixed header, topic and packet id of a PUBLISH, the payload
+  * is for the caller to append or send on its own
+  * @return the length written, which is where the payload goes
+  */
+int MQTTCodec_encodePublishHeader(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+		unsigned short packetid, const char* topic, int topiclen, int payloadlen)
+{
+	unsigned char* ptr = buf;
+	int rem = MQTTCodec_publishLength(qos, topiclen, payloadlen);
+
+	if (rem < 0)
+		return MQTTCODEC_ERROR;
+	if (1 + remLengthLen(rem) + rem - payloadlen > buflen)
+		return MQTTCODEC_BUFFER_TOO_SHORT;
+
+	*ptr++ = HEADER(MQTTCODEC_PUBLISH, dup, qos, retained);
+	ptr += putRemLength(ptr, rem);
+	*ptr++ = (unsigned char)(topiclen >> 8);
+	*ptr++ = (unsigned char)topiclen;
+	memcpy(ptr, topic, topiclen);
+	ptr += topiclen;
+	if (qos > 0)
+	{
+		*ptr++ = (unsigned char)(packetid >> 8);
+		*ptr++ = (unsigned char)packetid;
+	}
+	return ptr - buf;
+}
+
+
+/**
+  * Writes a whole PUBLISH
+  * @return the length of the packet
+  */
+int MQTTCodec_encodePublish(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+		unsigned short packetid, const char* topic, int topiclen, const unsigned char* payload, int payloadlen)
+{
+	int len = MQTTCodec_encodePublishHeader(buf, buflen, dup, qos, retained, packetid, topic, topiclen, payloadlen);
+
+	if (len < 0)
+		return len;
+	if (payloadlen > buflen - len)
+		return MQTTCODEC_BUFFER_TOO_SHORT;
+	memcpy(buf + len, payload, payloadlen);
+	return len + payloadlen;
+}
+
+
+/**
+  * Reads a PUBLISH from the buflen bytes received at buf. The topic is not
+  * null terminated, and the payload may go past buf + buflen.
+  * @return the length of the packet given by its remaining length
+  */
+int MQTTCodec_decodePublish(unsigned char* buf, int buflen, unsigned char* dup, int* qos, unsigned char* retained,
+		unsigned short* packetid, char** topic, int* topiclen, unsigned char** payload, int* payloadlen)
+{
+	unsigned char* ptr;
+	unsigned char* end;
+	int rem, n, len;
+
+	if (buflen < 2 || (buf[0] >> 4) != MQTTCODEC_PUBLISH || ((buf[0] >> 1) & 3) == 3)
+		return MQTTCODEC_ERROR;
+	if ((n = getRemLength(buf + 1, buflen - 1, &rem)) < 0)
+		return MQTTCODEC_ERROR;
+
+	ptr = buf + 1 + n;
+	end = buf + buflen;                 /* of what came, the packet may be longer */
+	if (rem < 2 || end - ptr < 2)
+		return MQTTCODEC_ERROR;
+	len = (ptr[0] << 8) | ptr[1];
+	ptr += 2;
+	*qos = (buf[0] >> 1) & 3;
+	if (2 + len + ((*qos > 0) ? 2 : 0) > rem || len + ((*qos > 0) ? 2 : 0) > end - ptr)
+		return MQTTCODEC_ERROR;
+
+	*dup = (buf[0] >> 3) & 1;
+	*retained = buf[0] & 1;
+	*topic = (char*)ptr;
+	*topiclen = len;
+	ptr += len;
+	if (*qos > 0)
+	{
+		*packetid = (unsigned short)((ptr[0] << 8) | ptr[1]);
+		ptr += 2;
+	}
+	*payload = ptr;
+	*payloadlen = rem - (ptr - (buf + 1 + n));
+	return 1 + n + rem;
+}
+
+
+/**
+  * Writes an ack, PUBACK, PUBREC, PUBREL or PUBCOMP
+  * @return MQTTCODEC_ACK_LEN
+  */
+int MQTTCodec_encodeAck(unsigned char* buf, int buflen, unsigned char packettype, unsigned char dup, unsigned short packetid)
+{
+	if (buflen < MQTTCODEC_ACK_LEN)
+		return MQTTCODEC_BUFFER_TOO_SHORT;
+	buf[0] = HEADER(packettype, dup, (packettype == MQTTCODEC_PUBREL) ? 1 : 0, 0);
+	buf[1] = 2;
+	buf[2] = (unsigned char)(packetid >> 8);
+	buf[3] = (unsigned char)packetid;
+	return MQTTCODEC_ACK_LEN;
+}
+
+
+/**
+  * Reads the type, DUP flag and packet id of a packet made of them, an ack
+  * or UNSUBACK
+  * @return the length of the packet given by its remaining length
+  */
+int MQTTCodec_decodeAck(unsigned char* buf, int buflen, unsigned char* packettype, unsigned char* dup, unsigned short* packetid)
+{
+	unsigned char* ptr;
+	int rem, n;
+
+	if (buflen < MQTTCODEC_ACK_LEN)
+		return MQTTCODEC_ERROR;
+	if (buf[1] == 2)
+		n = 1, rem = 2;                 /* as it always is */
+	else if ((n = getRemLength(buf + 1, buflen - 1, &rem)) < 0 || rem < 2 || buflen - 1 - n < 2)
+		return MQTTCODEC_ERROR;
+
+	ptr = buf + 1 + n;
+	*packettype = buf[0] >> 4;
+	*dup = (buf[0] >> 3) & 1;
+	*packetid = (unsigned short)((ptr[0] << 8) | ptr[1]);
+	return 1 + n + rem;
+}
+
+
+/**
+  * Writes a packet of no more than its type, PINGREQ or DISCONNECT
+  * @return MQTTCODEC_ZERO_LEN
+  */
+int MQTTCodec_encodeZero(unsigned char* buf, int buflen, unsigned char packettype)
+{
+	if (buflen < MQTTCODEC_ZERO_LEN)
+		return MQTTCODEC_BUFFER_TOO_SHORT;
+	buf[0] = HEADER(packettype, 0, 0, 0);
+	buf[1] = 0;
+	return MQTTCODEC_ZERO_LEN;
+}
@@ -0,0 +1,51 @@
+/*******************************************************************************
+ *
+ * Codec of the PUBLISH, ack and zero length packets, shared by MQTTPacket
+ * (MQTTSerialize_publish, MQTTDeserialize_publish, MQTTSerialize_ack, ...)
+ * and the QCloud SDK (mqtt_client_publish.c), so both clients read and write
+ * these packets the same way.
+ *
+ *   - Every byte read or written is checked against the buffer length. The
+ *     fixed header, topic and packet id of a received PUBLISH must be in the
+ *     buffer; its payload may go past it, as with MQTTClient streaming a
+ *     payload larger than its read buffer, the caller knows how much came.
+ *   - The topic comes with its length, measured once by the caller, and the
+ *     remaining length is written without a loop for the sizes of topic and
+ *     payload of a device. An ack is its 4 bytes and PINGREQ its 2.
+ *   - Plain C types only, it includes nothing of either client.
+ *
+ * Fuzzed and measured against the former codecs on the host by
+ * tools/mqtt_codec_fuzz.
+ *
+ *******************************************************************************/
+
+#if !defined(MQTTCODEC_H_)
+#define MQTTCODEC_H_
+
+#if defined(__cplusplus)
+ extern "C" {
+#endif
+
+#define MQTTCODEC_BUFFER_TOO_SHORT	-2	/* as MQTTPACKET_BUFFER_TOO_SHORT */
+#define MQTTCODEC_ERROR				-1
+
+#define MQTTCODEC_ACK_LEN			4
+#define MQTTCODEC_ZERO_LEN			2
+#define MQTTCODEC_MAX_REM_LEN		268435455
+
+int MQTTCodec_publishLength(int qos, int topiclen, int payloadlen);
+int MQTTCodec_encodePublishHeader(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+		unsigned short packetid, const char* topic, int topiclen, int payloadlen);
+int MQTTCodec_encodePublish(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained,
+		unsigned short packetid, const char* topic, int topiclen, const unsigned char* payload, int payloadlen);
+int MQTTCodec_decodePublish(unsigned char* buf, int buflen, unsigned char* dup, int* qos, unsigned char* retained,
+		unsigned short* packetid, char** topic, int* topiclen, unsigned char** payload, int* payloadlen);
+int MQTTCodec_encodeAck(unsigned char* buf, int buflen, unsigned char packettype, unsigned char dup, unsigned short packetid);
+int MQTTCodec_decodeAck(unsigned char* buf, int buflen, unsigned char* packettype, unsigned char* dup, unsigned short* packetid);
+int MQTTCodec_encodeZero(unsigned char* buf, int buflen, unsigned char packettype);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
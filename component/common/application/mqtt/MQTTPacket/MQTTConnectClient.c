@@ -15,6 +15,7 @@
  *******************************************************************************/
 
 #include "MQTTPacket.h"
+#include "MQTTCodec.h"
 #include "StackTrace.h"
 
 #include <string.h>
@@ -168,23 +169,10 @@ exit:
   */
 int MQTTSerialize_zero(unsigned char* buf, int buflen, unsigned char packettype)
 {
-	MQTTHeader header = {0};
 	int rc = -1;
-	unsigned char *ptr = buf;
 
 	FUNC_ENTRY;
-	if (buflen < 2)
-	{
-		rc = MQTTPACKET_BUFFER_TOO_SHORT;
-		goto exit;
-	}
-	header.byte = 0;
-	header.bits.type = packettype;
-	writeChar(&ptr, header.byte); /* write header */
-
-	ptr += MQTTPacket_encode(ptr, 0); /* write remaining length */
-	rc = ptr - buf;
-exit:
+	rc = MQTTCodec_encodeZero(buf, buflen, packettype);
 	FUNC_EXIT_RC(rc);
 	return rc;
 }
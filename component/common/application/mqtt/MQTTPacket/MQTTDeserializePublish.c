@@ -16,6 +16,7 @@
 
 #include "StackTrace.h"
 #include "MQTTPacket.h"
+#include "MQTTCodec.h"
 #include <string.h>
 
 #define min(a, b) ((a < b) ? 1 : 0)
@@ -36,34 +37,13 @@
 int MQTTDeserialize_publish(unsigned char* dup, int* qos, unsigned char* retained, unsigned short* packetid, MQTTString* topicName,
 		unsigned char** payload, int* payloadlen, unsigned char* buf, int buflen)
 {
-	MQTTHeader header = {0};
-	unsigned char* curdata = buf;
-	unsigned char* enddata = NULL;
 	int rc = 0;
-	int mylen = 0;
 
 	FUNC_ENTRY;
-	header.byte = readChar(&curdata);
-	if (header.bits.type != PUBLISH)
-		goto exit;
-	*dup = header.bits.dup;
-	*qos = header.bits.qos;
-	*retained = header.bits.retain;
-
-	curdata += (rc = MQTTPacket_decodeBuf(curdata, &mylen)); /* read remaining length */
-	enddata = curdata + mylen;
-
-	if (!readMQTTLenString(topicName, &curdata, enddata) ||
-		enddata - curdata < 0) /* do we have enough data to read the protocol version byte? */
-		goto exit;
-
-	if (*qos > 0)
-		*packetid = readInt(&curdata);
-
-	*payloadlen = enddata - curdata;
-	*payload = curdata;
-	rc = 1;
-exit:
+	topicName->cstring = NULL;
+	if (MQTTCodec_decodePublish(buf, buflen, dup, qos, retained, packetid, &topicName->lenstring.data,
+			&topicName->lenstring.len, payload, payloadlen) > 0)
+		rc = 1;
 	FUNC_EXIT_RC(rc);
 	return rc;
 }
@@ -81,25 +61,11 @@ exit:
   */
 int MQTTDeserialize_ack(unsigned char* packettype, unsigned char* dup, unsigned short* packetid, unsigned char* buf, int buflen)
 {
-	MQTTHeader header = {0};
-	unsigned char* curdata = buf;
-	unsigned char* enddata = NULL;
 	int rc = 0;
-	int mylen;
 
 	FUNC_ENTRY;
-	header.byte = readChar(&curdata);
-	*dup = header.bits.dup;
-	*packettype = header.bits.type;
-	curdata += (rc = MQTTPacket_decodeBuf(curdata, &mylen)); /* read remaining length */
-	enddata = curdata + mylen;
-
-	if (enddata - curdata < 2)
-		goto exit;
-	*packetid = readInt(&curdata);
-
-	rc = 1;
-exit:
+	if (MQTTCodec_decodeAck(buf, buflen, packettype, dup, packetid) > 0)
+		rc = 1;
 	FUNC_EXIT_RC(rc);
 	return rc;
 }
\ No newline at end of file
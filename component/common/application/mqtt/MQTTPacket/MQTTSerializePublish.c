@@ -16,6 +16,7 @@
  *******************************************************************************/
 
 #include "MQTTPacket.h"
+#include "MQTTCodec.h"
 #include "StackTrace.h"
 
 #include <string.h>
@@ -55,37 +56,17 @@ int MQTTSerialize_publishLength(int qos, MQTTString topicName, int payloadlen)
 int MQTTSerialize_publish(unsigned char* buf, int buflen, unsigned char dup, int qos, unsigned char retained, unsigned short packetid,
 		MQTTString topicName, unsigned char* payload, int payloadlen)
 {
-	unsigned char *ptr = buf;
-	MQTTHeader header = {0};
-	int rem_len = 0;
+	const char* topic = topicName.lenstring.data;
+	int topiclen = topicName.lenstring.len;
 	int rc = 0;
 
 	FUNC_ENTRY;
-	if (MQTTPacket_len(rem_len = MQTTSerialize_publishLength(qos, topicName, payloadlen)) > buflen)
+	if (topicName.cstring)
 	{
-		rc = MQTTPACKET_BUFFER_TOO_SHORT;
-		goto exit;
+		topic = topicName.cstring;
+		topiclen = strlen(topic);
 	}
-
-	header.bits.type = PUBLISH;
-	header.bits.dup = dup;
-	header.bits.qos = qos;
-	header.bits.retain = retained;
-	writeChar(&ptr, header.byte); /* write header */
-
-	ptr += MQTTPacket_encode(ptr, rem_len); /* write remaining length */;
-
-	writeMQTTString(&ptr, topicName);
-
-	if (qos > 0)
-		writeInt(&ptr, packetid);
-
-	memcpy(ptr, payload, payloadlen);
-	ptr += payloadlen;
-
-	rc = ptr - buf;
-
-exit:
+	rc = MQTTCodec_encodePublish(buf, buflen, dup, qos, retained, packetid, topic, topiclen, payload, payloadlen);
 	FUNC_EXIT_RC(rc);
 	return rc;
 }
@@ -103,25 +84,10 @@ exit:
   */
 int MQTTSerialize_ack(unsigned char* buf, int buflen, unsigned char packettype, unsigned char dup, unsigned short packetid)
 {
-	MQTTHeader header = {0};
 	int rc = 0;
-	unsigned char *ptr = buf;
 
 	FUNC_ENTRY;
-	if (buflen < 4)
-	{
-		rc = MQTTPACKET_BUFFER_TOO_SHORT;
-		goto exit;
-	}
-	header.bits.type = packettype;
-	header.bits.dup = dup;
-	header.bits.qos = (packettype == PUBREL) ? 1 : 0;
-	writeChar(&ptr, header.byte); /* write header */
-
-	ptr += MQTTPacket_encode(ptr, 2); /* write remaining length */
-	writeInt(&ptr, packetid);
-	rc = ptr - buf;
-exit:
+	rc = MQTTCodec_encodeAck(buf, buflen, packettype, dup, packetid);
 	FUNC_EXIT_RC(rc);
 	return rc;
 }
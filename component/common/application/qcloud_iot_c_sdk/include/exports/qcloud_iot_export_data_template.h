@@ -29,6 +29,7 @@ extern "C" {
 #include "qcloud_iot_export_mqtt.h"
 
 #define MAX_CONTORL_REPLY_STATUS_LEN 64  // max len of status within control reply msg
+#define MAX_BATCH_REPORT_PROPERTIES  32  // max properties pending in a coalesced report
 
 /**
  * @brief Data type of template
@@ -263,6 +264,17 @@ bool IOT_Template_Get_Yield_Status(void *pClient, int *exit_code);
  */
 void IOT_Template_Set_Yield_Status(void *pClient, bool running_state, int code);
 
+/**
+ * @brief Have a reactor yield the data_template client instead of the default
+ * yield thread, IOT_Reactor_Remove() to stop, IOT_Template_Get_Yield_Status()
+ * tells when it has
+ *
+ * @param pClient       handle to data_template client
+ * @param pReactor      handle to reactor, see IOT_Reactor_Construct()
+ * @return QCLOUD_RET_SUCCESS when success, err code for failure
+ */
+int IOT_Template_Attach_Reactor(void *pClient, void *pReactor);
+
 /**
  * @brief Only release Data_Template Client resource, retain mqtt client for
  * multi-thread case
@@ -333,6 +345,38 @@ int IOT_Template_JSON_ConstructReportArray(void *handle, char *jsonBuffer, size_
 int IOT_Template_Report(void *handle, char *pJsonDoc, size_t sizeOfBuffer, OnReplyCallback callback, void *userContext,
                         uint32_t timeout_ms);
 
+/**
+ * @brief coalesce the properties reported within a time or size window into one report message
+ *
+ * @param pClient           handle to data_template client
+ * @param window_ms         how long the first pending property waits for others, 0 to turn batching off
+ * @param max_size          size of the largest report document, a report is sent before it would overflow
+ * @param callback          callback when response of a coalesced report arrive
+ * @param userContext       user data for callback
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Template_Set_Report_Batch(void *handle, uint32_t window_ms, size_t max_size, OnReplyCallback callback,
+                                  void *userContext);
+
+/**
+ * @brief add properties to the coalesced report, sent by IOT_Template_Yield once the window is over.
+ *        A property pending already is reported once, with its value at the time of sending
+ *
+ * @param pClient           handle to data_template client
+ * @param count             number of properties
+ * @param pDeviceProperties array of properties
+ * @return                  QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Template_Report_Batch(void *handle, uint8_t count, DeviceProperty *pDeviceProperties[]);
+
+/**
+ * @brief send the pending properties of the coalesced report now
+ *
+ * @param pClient           handle to data_template client
+ * @return                  QCLOUD_RET_SUCCESS when success or nothing pending, or err code for failure
+ */
+int IOT_Template_Flush_Report(void *handle);
+
 /**
  * @brief report data_template data in synchronized way
  *
@@ -214,6 +214,17 @@ void IOT_Gateway_Stop_Yield_Thread(void *pClient);
  * @return true= thread running, false = thread quit
  */
 bool IOT_Gateway_Get_Yield_Status(void *pClient, int *exit_code);
+
+/**
+ * @brief Have a reactor yield the gateway client instead of the default yield
+ * thread, e.g. one reactor for the gateway and the clients of its subdevices,
+ * IOT_Reactor_Remove() to stop, IOT_Gateway_Get_Yield_Status() tells when it has
+ *
+ * @param pClient       handle to gateway client
+ * @param pReactor      handle to reactor, see IOT_Reactor_Construct()
+ * @return QCLOUD_RET_SUCCESS when success, err code for failure
+ */
+int IOT_Gateway_Attach_Reactor(void *pClient, void *pReactor);
 #endif
 
 #ifdef __cplusplus
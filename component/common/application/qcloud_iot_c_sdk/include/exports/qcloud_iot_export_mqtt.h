@@ -54,13 +54,19 @@ typedef struct {
 
     void * payload;      // MQTT msg payload
     size_t payload_len;  // MQTT length of msg payload
+
+    /* received only: a PUBLISH larger than the read buffer comes in pieces to a
+     * subscription with payload_streaming set, payload is payload_len bytes at
+     * payload_offset of payload_total; other subscriptions never see one */
+    size_t payload_offset;
+    size_t payload_total;
 } MQTTMessage;
 
 typedef MQTTMessage PublishParams;
 
 #define DEFAULT_PUB_PARAMS              \
     {                                   \
-        QOS0, 0, 0, 0, NULL, 0, NULL, 0 \
+        QOS0, 0, 0, 0, NULL, 0, NULL, 0, 0, 0 \
     }
 
 typedef enum {
@@ -130,6 +136,7 @@ typedef struct {
     OnMessageHandler  on_message_handler;    // callback when message arrived
     OnSubEventHandler on_sub_event_handler;  // callback when event happened
     void *            user_data;             // user context for callback
+    uint8_t           payload_streaming;     // 1: take PUBLISH larger than read buffer in pieces, else discarded
 } SubscribeParams;
 
 /**
@@ -137,7 +144,7 @@ typedef struct {
  */
 #define DEFAULT_SUB_PARAMS     \
     {                          \
-        QOS0, NULL, NULL, NULL \
+        QOS0, NULL, NULL, NULL, 0 \
     }
 
 typedef struct {
@@ -246,6 +253,16 @@ int IOT_MQTT_Yield(void *pClient, uint32_t timeout_ms);
  */
 #ifdef MULTITHREAD_ENABLED
 void IOT_MQTT_Set_Yield_Thread_State(void *pClient, bool state);
+
+/**
+ * @brief Have a reactor yield the MQTT client instead of a thread of its own,
+ * IOT_Reactor_Remove() to stop
+ *
+ * @param pClient    handle to MQTT client
+ * @param pReactor   handle to reactor, see IOT_Reactor_Construct()
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_MQTT_Attach_Reactor(void *pClient, void *pReactor);
 #endif
 
 
@@ -260,6 +277,33 @@ void IOT_MQTT_Set_Yield_Thread_State(void *pClient, bool state);
  */
 int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams);
 
+struct MQTTQueue;
+
+/**
+ * @brief Give the MQTT client an outbound queue, see MQTTQueue.h. Messages of
+ * IOT_MQTT_Publish_Queued() wait there while the client is offline and leave it
+ * once acked; a queue backed by flash keeps them, with their packet id, across
+ * reboots. IOT_MQTT_Yield() sends them in order, up to half the repub list at a
+ * time. The queue has no lock: publish to it from the task yielding the client.
+ *
+ * @param pClient       handle to MQTT client
+ * @param queue         initialized by MQTTQueue_init(), NULL for none
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_MQTT_Set_Queue(void *pClient, struct MQTTQueue *queue);
+
+/**
+ * @brief Publish MQTT message through the outbound queue, IOT_MQTT_Publish()
+ * without a queue
+ *
+ * @param pClient       handle to MQTT client
+ * @param topicName     MQTT topic name
+ * @param pParams       publish parameters, QoS0 or QoS1
+ *
+ * @return QCLOUD_RET_SUCCESS when queued, or err code (<0) when the queue refuses it
+ */
+int IOT_MQTT_Publish_Queued(void *pClient, char *topicName, PublishParams *pParams);
+
 /**
  * @brief Subscribe MQTT topic
  *
@@ -227,6 +227,25 @@ int IOT_OTA_IsFetchFinish(void *handle);
  */
 int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_s);
 
+/**
+ * @brief Download the whole firmware into the OTA flash of the platform (HAL_OTA_Flash_*), in place of
+ * IOT_OTA_StartDownload and IOT_OTA_FetchYield
+ *
+ * Receiving, hashing and flash programming go through a ring of blocks, the flash written by a task of its own
+ * when MULTITHREAD_ENABLED. Progress is kept in flash: a later call for the same firmware (same MD5), after a
+ * failure or a reboot, resumes where this one stopped with an HTTP Range request. A firmware failing
+ * IOT_OTAG_CHECK_FIRMWARE drops the progress, so the next call downloads it again from the start.
+ *
+ * Once done, check the firmware with IOT_OTAG_CHECK_FIRMWARE, then make it bootable with HAL_OTA_Flash_Finish.
+ *
+ * @param handle:       OTA module handle, fetching
+ * @param timeout_s:    timeout value in second of each receive, as in IOT_OTA_FetchYield
+ *
+ * @retval   0 : the whole firmware is in flash
+ * @retval < 0 : error code for failure
+ */
+int IOT_OTA_FetchToFlash(void *handle, uint32_t timeout_s);
+
 /**
  * @brief Get OTA info (version, file_size, MD5, download state) from OTA module
  *
@@ -0,0 +1,148 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef QCLOUD_IOT_EXPORT_REACTOR_H_
+#define QCLOUD_IOT_EXPORT_REACTOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef MULTITHREAD_ENABLED
+
+/*
+ * Reactor: one task driving several MQTT, data template and gateway clients, and timers, in place of a yield
+ * thread for each client.
+ *
+ * The reactor waits on the sockets of all its clients at once, a client is yielded when its socket has something
+ * to read or when its next event is due (keep alive, reconnect, ack timeout, report batch window). The due times
+ * of clients and timers are kept in one heap. Clients or timers added from another task are looked at within
+ * REACTOR_MAX_WAIT_MS. A client reconnecting holds the others up for the time of its connect attempt.
+ */
+
+#define REACTOR_MAX_CLIENTS (8)
+#define REACTOR_MAX_TIMERS  (8)
+#define REACTOR_MAX_WAIT_MS (1000) /* longest wait, also how often the network link is looked at */
+
+/**
+ * @brief how the reactor drives a client, see IOT_MQTT_Attach_Reactor, IOT_Template_Attach_Reactor and
+ * IOT_Gateway_Attach_Reactor
+ */
+typedef struct {
+    int (*yield)(void *handle, uint32_t timeout_ms);  // read and handle what came, do what is due
+    uint32_t (*next_event_ms)(void *handle);          // time to the next due work, NULL for the MQTT client's own
+    void (*detached)(void *handle, int exit_code);    // the client is left alone from now on, not to call the reactor
+} ReactorClientOps;
+
+typedef void (*ReactorTimerFunc)(void *context);
+
+/**
+ * @brief Create a reactor
+ *
+ * @return a valid reactor handle when success, or NULL otherwise
+ */
+void *IOT_Reactor_Construct(void);
+
+/**
+ * @brief Destroy a reactor, its thread stopped, detaching its clients
+ *
+ * @param pReactor  handle to reactor
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Reactor_Destroy(void *pReactor);
+
+/**
+ * @brief Add a client to drive
+ *
+ * @param pReactor      handle to reactor
+ * @param handle        handle passed to ops
+ * @param mqtt_client   MQTT client under handle, whose socket is waited on
+ * @param ops           how to drive the client, must stay valid while attached
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Reactor_Add(void *pReactor, void *handle, void *mqtt_client, const ReactorClientOps *ops);
+
+/**
+ * @brief Stop driving a client, its detached callback tells when it is left alone
+ *
+ * @param pReactor  handle to reactor
+ * @param handle    handle given to IOT_Reactor_Add
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Reactor_Remove(void *pReactor, void *handle);
+
+/**
+ * @brief Add a timer, called in the reactor
+ *
+ * @param pReactor  handle to reactor
+ * @param delay_ms  time to the first call
+ * @param period_ms time between calls, 0 for one call
+ * @param func      function to call
+ * @param context   argument of func
+ * @return timer id (>=0) when success, or err code (<0) for failure
+ */
+int IOT_Reactor_Add_Timer(void *pReactor, uint32_t delay_ms, uint32_t period_ms, ReactorTimerFunc func,
+                          void *context);
+
+/**
+ * @brief Remove a timer before its next call
+ *
+ * @param pReactor  handle to reactor
+ * @param timer_id  id from IOT_Reactor_Add_Timer
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Reactor_Remove_Timer(void *pReactor, int timer_id);
+
+/**
+ * @brief Run the reactor once in the calling task: wait for a socket or the next due time, then handle them
+ *
+ * @param pReactor      handle to reactor
+ * @param timeout_ms    longest wait
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Reactor_Run(void *pReactor, uint32_t timeout_ms);
+
+/**
+ * @brief Start a thread running the reactor
+ *
+ * @param pReactor      handle to reactor
+ * @param stack_size    stack size of the thread
+ * @param priority      priority of the thread
+ * @return QCLOUD_RET_SUCCESS when success, or err code for failure
+ */
+int IOT_Reactor_Start_Thread(void *pReactor, uint32_t stack_size, uint16_t priority);
+
+/**
+ * @brief Stop the reactor thread, returning once it has
+ *
+ * @param pReactor  handle to reactor
+ */
+void IOT_Reactor_Stop_Thread(void *pReactor);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QCLOUD_IOT_EXPORT_REACTOR_H_ */
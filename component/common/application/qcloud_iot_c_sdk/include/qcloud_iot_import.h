@@ -413,6 +413,15 @@ int HAL_TLS_Write(uintptr_t handle, unsigned char *data, size_t totalLen, uint32
  */
 int HAL_TLS_Read(uintptr_t handle, unsigned char *data, size_t totalLen, uint32_t timeout_ms, size_t *read_len);
 
+/**
+ * @brief Get the socket under a TLS connection, to wait on with HAL_Socket_Wait_Readable
+ *
+ * @param handle        TLS connect handle
+ * @param pending       set to the bytes already decrypted, to read without waiting
+ * @return              the socket, or -1 when there is none
+ */
+int HAL_TLS_Socket(uintptr_t handle, size_t *pending);
+
 /********** DTLS network **********/
 #ifdef COAP_COMM_ENABLED
 typedef SSLConnectParams DTLSConnectParams;
@@ -461,6 +470,18 @@ int HAL_DTLS_Read(uintptr_t handle, unsigned char *data, size_t datalen, uint32_
 #endif  // COAP_COMM_ENABLED
 #endif  // AUTH_WITH_NOTLS
 
+/********** network link **********/
+/**
+ * @brief Get the state of the network link (e.g. Wi-Fi associated and its keys set)
+ *
+ * The MQTT client does not try to reconnect while the link is down, and tries at
+ * once when it comes up again.
+ *
+ * @param up_count  if not NULL, the number of times the link came up so far
+ * @return          true when the link is up, a platform without link events returns true
+ */
+bool HAL_Network_Link_Up(uint32_t *up_count);
+
 /********** TCP network **********/
 /**
  * @brief Setup TCP connection with server
@@ -503,6 +524,25 @@ int HAL_TCP_Write(uintptr_t fd, const unsigned char *data, uint32_t len, uint32_
  */
 int HAL_TCP_Read(uintptr_t fd, unsigned char *data, uint32_t len, uint32_t timeout_ms, size_t *read_len);
 
+/**
+ * @brief Get the socket of a TCP connection, to wait on with HAL_Socket_Wait_Readable
+ *
+ * @param fd            TCP socket handle
+ * @return              the socket, or -1 when there is none
+ */
+int HAL_TCP_Socket(uintptr_t fd);
+
+/**
+ * @brief Wait for any of a few sockets to have something to read (or an error)
+ *
+ * @param sockets       sockets from HAL_TCP_Socket/HAL_TLS_Socket, -1 for none
+ * @param count         number of sockets, up to 32
+ * @param timeout_ms    timeout value in millisecond, slept when no socket is given
+ * @param readable      set to a mask of the sockets to read, bit i for sockets[i]
+ * @return              number of sockets to read, 0 on timeout, or negative on error
+ */
+int HAL_Socket_Wait_Readable(const int *sockets, int count, uint32_t timeout_ms, uint32_t *readable);
+
 /********** UDP network **********/
 #ifdef COAP_COMM_ENABLED
 /**
@@ -589,6 +629,74 @@ int HAL_Log_Del(void);
 size_t HAL_Log_Get_Size(void);
 #endif
 
+/********** OTA firmware storage **********/
+/**
+ * @brief Open the flash region for a firmware image, e.g. the firmware slot not running
+ *
+ * @param size          size of the image
+ * @return              size of an erase unit (sector) when success, or err code (<0) for failure
+ */
+int HAL_OTA_Flash_Open(uint32_t size);
+
+/**
+ * @brief Erase the sector at offset in the image
+ *
+ * @param offset        offset of the sector, a multiple of the sector size
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_OTA_Flash_Erase(uint32_t offset);
+
+/**
+ * @brief Program erased bytes of the image
+ *
+ * @param offset        offset in the image
+ * @param data          bytes to program
+ * @param len           number of bytes
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_OTA_Flash_Write(uint32_t offset, const char *data, uint32_t len);
+
+/**
+ * @brief Read back bytes of the image as they were received
+ *
+ * @param offset        offset in the image
+ * @param data          destination buffer
+ * @param len           number of bytes
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_OTA_Flash_Read(uint32_t offset, char *data, uint32_t len);
+
+/**
+ * @brief Keep across reboots how far the image is programmed
+ *
+ * @param image_id      string identifying the image, e.g. its MD5
+ * @param offset        bytes of the image programmed
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_OTA_Flash_Save_Progress(const char *image_id, uint32_t offset);
+
+/**
+ * @brief Get the progress kept for an image, the progress of any other image is dropped
+ *
+ * @param image_id      string identifying the image, e.g. its MD5
+ * @return              bytes of the image programmed, 0 when nothing is kept
+ */
+uint32_t HAL_OTA_Flash_Load_Progress(const char *image_id);
+
+/**
+ * @brief Drop the progress kept, e.g. the image failed its check: the next download starts from scratch
+ *
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_OTA_Flash_Clear_Progress(void);
+
+/**
+ * @brief The image is whole and checked: make it the one to boot next, and drop its progress
+ *
+ * @return              QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int HAL_OTA_Flash_Finish(void);
+
 #if defined(__cplusplus)
 }
 #endif
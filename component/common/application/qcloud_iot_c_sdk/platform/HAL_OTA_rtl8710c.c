@@ -0,0 +1,277 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "flash_api.h"
+#include "device_lock.h"
+
+#include "qcloud_iot_import.h"
+#include "qcloud_iot_export_log.h"
+#include "qcloud_iot_export_error.h"
+
+/*
+ * OTA image in the firmware slot not running (fw1/fw2 of partition.json), as ota_8710c.c writes it: the first
+ * 32 bytes are the signature, held back and written last so that a partial image never boots.
+ *
+ * The last sector of the slot keeps the held back signature, then progress records appended one by one. The last
+ * valid record tells how far the image is programmed, so a download resumes after a reboot with the signature.
+ */
+
+extern uint32_t sys_update_ota_prepare_addr(void);
+
+#define OTA_FLASH_SECTOR_SIZE 0x1000
+#define OTA_FLASH_SLOT_SIZE   0x80000 /* length of fw1 and fw2 in partition.json */
+#define OTA_FLASH_SIG_LEN     32
+#define OTA_PROGRESS_SECTOR   (OTA_FLASH_SLOT_SIZE - OTA_FLASH_SECTOR_SIZE)
+#define OTA_PROGRESS_MAGIC    0x5041544F /* "OTAP" */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t image_id; /* hash of the image id */
+    uint32_t offset;
+    uint32_t check; /* ~(image_id ^ offset) */
+} OTAProgressRecord;
+
+#define OTA_PROGRESS_RECORDS ((int)((OTA_FLASH_SECTOR_SIZE - OTA_FLASH_SIG_LEN) / sizeof(OTAProgressRecord)))
+
+static flash_t  sg_ota_flash;
+static uint32_t sg_ota_addr = 0xFFFFFFFF;
+static uint32_t sg_ota_size = 0;
+static int      sg_ota_next_record = -1; /* free record slot, -1 when not scanned */
+
+static uint32_t _image_id_hash(const char *image_id)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*image_id) {
+        hash = (hash ^ (uint8_t)*image_id++) * 16777619u;
+    }
+    return hash;
+}
+
+static int _flash_read(uint32_t addr, void *data, uint32_t len)
+{
+    int ret;
+
+    device_mutex_lock(RT_DEV_LOCK_FLASH);
+    ret = flash_stream_read(&sg_ota_flash, addr, len, (uint8_t *)data);
+    device_mutex_unlock(RT_DEV_LOCK_FLASH);
+    return (ret == 1) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_FAILURE;
+}
+
+static int _flash_write(uint32_t addr, const void *data, uint32_t len)
+{
+    int ret;
+
+    device_mutex_lock(RT_DEV_LOCK_FLASH);
+    ret = flash_burst_write(&sg_ota_flash, addr, len, (uint8_t *)data);
+    device_mutex_unlock(RT_DEV_LOCK_FLASH);
+    return (ret < 0) ? QCLOUD_ERR_FAILURE : QCLOUD_RET_SUCCESS;
+}
+
+static void _flash_erase(uint32_t addr)
+{
+    device_mutex_lock(RT_DEV_LOCK_FLASH);
+    flash_erase_sector(&sg_ota_flash, addr);
+    device_mutex_unlock(RT_DEV_LOCK_FLASH);
+}
+
+static bool _record_valid(const OTAProgressRecord *record)
+{
+    return record->magic == OTA_PROGRESS_MAGIC && record->check == ~(record->image_id ^ record->offset);
+}
+
+/* the last valid record, the free slot after it noted */
+static int _last_record(OTAProgressRecord *last)
+{
+    OTAProgressRecord record;
+    uint32_t          addr = sg_ota_addr + OTA_PROGRESS_SECTOR + OTA_FLASH_SIG_LEN;
+    int               i, found = QCLOUD_ERR_FAILURE;
+
+    for (i = 0; i < OTA_PROGRESS_RECORDS; i++, addr += sizeof(record)) {
+        if (_flash_read(addr, &record, sizeof(record)) != QCLOUD_RET_SUCCESS || record.magic == 0xFFFFFFFF) {
+            break;
+        }
+        if (_record_valid(&record)) {
+            *last = record;
+            found = QCLOUD_RET_SUCCESS;
+        }
+    }
+    sg_ota_next_record = i;
+    return found;
+}
+
+int HAL_OTA_Flash_Open(uint32_t size)
+{
+    uint32_t addr = sys_update_ota_prepare_addr();
+
+    if (addr == 0xFFFFFFFF || addr == 0) {
+        Log_e("no OTA slot");
+        return QCLOUD_ERR_FAILURE;
+    }
+    if (size == 0 || size > OTA_PROGRESS_SECTOR) {
+        Log_e("image size %u does not fit the OTA slot", size);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    if (addr != sg_ota_addr) {
+        sg_ota_next_record = -1;
+    }
+    sg_ota_addr = addr;
+    sg_ota_size = size;
+    return OTA_FLASH_SECTOR_SIZE;
+}
+
+int HAL_OTA_Flash_Erase(uint32_t offset)
+{
+    if (offset >= OTA_PROGRESS_SECTOR || (offset % OTA_FLASH_SECTOR_SIZE) != 0) {
+        return QCLOUD_ERR_INVAL;
+    }
+    _flash_erase(sg_ota_addr + offset);
+    return QCLOUD_RET_SUCCESS;
+}
+
+int HAL_OTA_Flash_Write(uint32_t offset, const char *data, uint32_t len)
+{
+    uint32_t sig_len;
+
+    if (offset + len > sg_ota_size) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    // the signature goes to the progress sector, its place in the image stays erased until HAL_OTA_Flash_Finish
+    if (offset < OTA_FLASH_SIG_LEN) {
+        sig_len = (len < OTA_FLASH_SIG_LEN - offset) ? len : OTA_FLASH_SIG_LEN - offset;
+        if (_flash_write(sg_ota_addr + OTA_PROGRESS_SECTOR + offset, data, sig_len) != QCLOUD_RET_SUCCESS) {
+            return QCLOUD_ERR_FAILURE;
+        }
+        offset += sig_len;
+        data += sig_len;
+        len -= sig_len;
+    }
+
+    if (len == 0) {
+        return QCLOUD_RET_SUCCESS;
+    }
+    return _flash_write(sg_ota_addr + offset, data, len);
+}
+
+int HAL_OTA_Flash_Read(uint32_t offset, char *data, uint32_t len)
+{
+    uint32_t sig_len;
+
+    if (offset + len > sg_ota_size) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    if (offset < OTA_FLASH_SIG_LEN) {
+        sig_len = (len < OTA_FLASH_SIG_LEN - offset) ? len : OTA_FLASH_SIG_LEN - offset;
+        if (_flash_read(sg_ota_addr + OTA_PROGRESS_SECTOR + offset, data, sig_len) != QCLOUD_RET_SUCCESS) {
+            return QCLOUD_ERR_FAILURE;
+        }
+        offset += sig_len;
+        data += sig_len;
+        len -= sig_len;
+    }
+
+    if (len == 0) {
+        return QCLOUD_RET_SUCCESS;
+    }
+    return _flash_read(sg_ota_addr + offset, data, len);
+}
+
+int HAL_OTA_Flash_Save_Progress(const char *image_id, uint32_t offset)
+{
+    OTAProgressRecord record;
+    uint8_t           sig[OTA_FLASH_SIG_LEN];
+
+    if (sg_ota_next_record < 0) {
+        (void)_last_record(&record);
+    }
+
+    // the sector is full: start it again with the signature
+    if (sg_ota_next_record >= OTA_PROGRESS_RECORDS) {
+        if (_flash_read(sg_ota_addr + OTA_PROGRESS_SECTOR, sig, sizeof(sig)) != QCLOUD_RET_SUCCESS) {
+            return QCLOUD_ERR_FAILURE;
+        }
+        _flash_erase(sg_ota_addr + OTA_PROGRESS_SECTOR);
+        if (_flash_write(sg_ota_addr + OTA_PROGRESS_SECTOR, sig, sizeof(sig)) != QCLOUD_RET_SUCCESS) {
+            return QCLOUD_ERR_FAILURE;
+        }
+        sg_ota_next_record = 0;
+    }
+
+    record.magic    = OTA_PROGRESS_MAGIC;
+    record.image_id = _image_id_hash(image_id);
+    record.offset   = offset;
+    record.check    = ~(record.image_id ^ record.offset);
+    if (_flash_write(sg_ota_addr + OTA_PROGRESS_SECTOR + OTA_FLASH_SIG_LEN + sg_ota_next_record * sizeof(record),
+                     &record, sizeof(record)) != QCLOUD_RET_SUCCESS) {
+        return QCLOUD_ERR_FAILURE;
+    }
+    sg_ota_next_record++;
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+uint32_t HAL_OTA_Flash_Load_Progress(const char *image_id)
+{
+    OTAProgressRecord record;
+
+    if (_last_record(&record) == QCLOUD_RET_SUCCESS && record.image_id == _image_id_hash(image_id) &&
+        record.offset <= sg_ota_size) {
+        return record.offset;
+    }
+
+    // none, or of another image: start again from an erased sector
+    _flash_erase(sg_ota_addr + OTA_PROGRESS_SECTOR);
+    sg_ota_next_record = 0;
+    return 0;
+}
+
+int HAL_OTA_Flash_Clear_Progress(void)
+{
+    if (sg_ota_addr == 0xFFFFFFFF) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    // the held back signature goes with the records: nothing of the image is kept
+    _flash_erase(sg_ota_addr + OTA_PROGRESS_SECTOR);
+    sg_ota_next_record = 0;
+    return QCLOUD_RET_SUCCESS;
+}
+
+int HAL_OTA_Flash_Finish(void)
+{
+    uint8_t sig[OTA_FLASH_SIG_LEN];
+
+    if (_flash_read(sg_ota_addr + OTA_PROGRESS_SECTOR, sig, sizeof(sig)) != QCLOUD_RET_SUCCESS) {
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    // as update_ota_signature(): the second half first, the image is valid once the first half is there
+    if (_flash_write(sg_ota_addr + 16, sig + 16, 16) != QCLOUD_RET_SUCCESS ||
+        _flash_write(sg_ota_addr, sig, 16) != QCLOUD_RET_SUCCESS) {
+        Log_e("write OTA signature failed");
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    _flash_erase(sg_ota_addr + OTA_PROGRESS_SECTOR);
+    sg_ota_next_record = 0;
+
+    return QCLOUD_RET_SUCCESS;
+}
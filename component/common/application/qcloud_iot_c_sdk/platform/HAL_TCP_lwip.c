@@ -21,6 +21,9 @@
 #include "lwip/netdb.h"
 #include "lwip/inet.h"
 
+#include "wifi_conf.h"
+#include "wifi_ind.h"
+
 #include "qcloud_iot_import.h"
 #include "qcloud_iot_export_log.h"
 #include "qcloud_iot_export_error.h"
@@ -29,6 +32,34 @@
 /* lwIP socket handle start from 0 */
 #define LWIP_SOCKET_FD_SHIFT 3
 
+/* Wi-Fi link up events, the handlers are registered by the first HAL_Network_Link_Up() */
+static volatile uint32_t sg_link_up_count = 0;
+static bool              sg_link_handlers = false;
+
+static void _link_up_handler(char *buf, int buf_len, int flags, void *user_data)
+{
+    sg_link_up_count++;
+}
+
+bool HAL_Network_Link_Up(uint32_t *up_count)
+{
+    if (!sg_link_handlers) {
+        sg_link_handlers = true;
+        /* an open AP only sends the connect event, a WPA one the handshake done after it,
+         * and a roam that changed our address the IP changed */
+        wifi_reg_event_handler(WIFI_EVENT_CONNECT, _link_up_handler, NULL);
+        wifi_reg_event_handler(WIFI_EVENT_FOURWAY_HANDSHAKE_DONE, _link_up_handler, NULL);
+        wifi_reg_event_handler(WIFI_EVENT_IP_CHANGED, _link_up_handler, NULL);
+    }
+
+    if (up_count != NULL) {
+        *up_count = sg_link_up_count;
+    }
+
+    /* the driver state, so a full event list only costs the early reconnect */
+    return wifi_is_connected_to_ap() == RTW_SUCCESS;
+}
+
 
 static uint32_t _time_left(uint32_t t_end, uint32_t t_now)
 {
@@ -266,3 +297,44 @@ int HAL_TCP_Read(uintptr_t fd, unsigned char *buf, uint32_t len, uint32_t timeou
 
     return (len == len_recv) ? QCLOUD_RET_SUCCESS : err_code;
 }
+
+int HAL_TCP_Socket(uintptr_t fd)
+{
+    return (fd >= LWIP_SOCKET_FD_SHIFT) ? (int)(fd - LWIP_SOCKET_FD_SHIFT) : -1;
+}
+
+int HAL_Socket_Wait_Readable(const int *sockets, int count, uint32_t timeout_ms, uint32_t *readable)
+{
+    fd_set sets;
+    struct timeval timeout;
+    int i, ret, max_fd = -1;
+
+    *readable = 0;
+    FD_ZERO(&sets);
+    for (i = 0; i < count && i < 32; i++) {
+        if (sockets[i] >= 0) {
+            FD_SET(sockets[i], &sets);
+            max_fd = Max(max_fd, sockets[i]);
+        }
+    }
+
+    if (max_fd < 0) {
+        HAL_SleepMs(timeout_ms);
+        return 0;
+    }
+
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    ret = select(max_fd + 1, &sets, NULL, NULL, &timeout);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    for (i = 0; i < count && i < 32; i++) {
+        if (sockets[i] >= 0 && FD_ISSET(sockets[i], &sets)) {
+            *readable |= 1UL << i;
+        }
+    }
+    return ret;
+}
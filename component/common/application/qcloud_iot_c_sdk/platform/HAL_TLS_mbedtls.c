@@ -35,6 +35,13 @@ extern "C" {
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/error.h"
 
+#include "lwip/sockets.h"
+#include "lwip/inet.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "qcloud_iot_common.h"
 #include "utils_timer.h"
 
 #ifndef AUTH_MODE_CERT
@@ -57,6 +64,29 @@ typedef struct {
 #endif
 } TLSDataParams;
 
+#define TLS_SERVER_CACHE_NUM   2                  /* the MQTT server, and one more (e.g. of OTA) */
+#define TLS_SERVER_ADDR_TTL_MS (10 * 60 * 1000)   /* an address is used this long without a DNS query */
+
+/**
+ * @brief what the last connection to a server leaves to the next one: its address, so a reconnect
+ * skips the DNS query, and its TLS session, so the handshake resumes it (by session ID or ticket)
+ * instead of a full one
+ */
+typedef struct {
+    char     host[HOST_STR_LENGTH];
+    int      port;
+    char     addr[16];      /* dotted IPv4, empty when unknown */
+    uint32_t addr_time;     /* when addr was resolved */
+    uint32_t used_time;
+#if defined(MBEDTLS_SSL_CLI_C)
+    bool                has_session;
+    mbedtls_ssl_session session;
+#endif
+} TLSServerCache;
+
+static TLSServerCache sg_server_cache[TLS_SERVER_CACHE_NUM];
+static void *         sg_server_cache_lock = NULL;
+
 
 /********************** RTK8710 porting *****************************/
 //static int my_random(void *p_rng, unsigned char *output, size_t output_len)
@@ -85,7 +115,74 @@ static void my_debug(void *ctx, int level, const char *file, int line, const cha
 }
 /********************** RTK8710 porting *****************************/
 
- 
+static void _server_cache_lock(void)
+{
+    void *lock;
+
+    if (sg_server_cache_lock == NULL) {
+        lock = HAL_MutexCreate();
+        taskENTER_CRITICAL();
+        if (sg_server_cache_lock == NULL) {
+            sg_server_cache_lock = lock;
+            lock                 = NULL;
+        }
+        taskEXIT_CRITICAL();
+        if (lock != NULL) {
+            HAL_MutexDestroy(lock);
+        }
+    }
+    HAL_MutexLock(sg_server_cache_lock);
+}
+
+static void _server_cache_unlock(void)
+{
+    HAL_MutexUnlock(sg_server_cache_lock);
+}
+
+static void _server_cache_drop_session(TLSServerCache *entry)
+{
+#if defined(MBEDTLS_SSL_CLI_C)
+    if (entry->has_session) {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->has_session = false;
+    }
+#endif
+}
+
+/**
+ * @brief the entry of host:port, or if add the least recently used one, emptied for it
+ *
+ * The caller holds the cache lock.
+ */
+static TLSServerCache *_server_cache_get(const char *host, int port, bool add)
+{
+    TLSServerCache *entry = &sg_server_cache[0];
+    uint32_t        now   = HAL_GetTimeMs();
+    int             i;
+
+    for (i = 0; i < TLS_SERVER_CACHE_NUM; i++) {
+        if (sg_server_cache[i].port == port && 0 == strncmp(sg_server_cache[i].host, host, HOST_STR_LENGTH)) {
+            entry = &sg_server_cache[i];
+            entry->used_time = now;
+            return entry;
+        }
+        if (now - sg_server_cache[i].used_time > now - entry->used_time) {
+            entry = &sg_server_cache[i];
+        }
+    }
+
+    if (!add) {
+        return NULL;
+    }
+
+    _server_cache_drop_session(entry);
+    memset(entry, 0, sizeof(TLSServerCache));
+    strncpy(entry->host, host, HOST_STR_LENGTH - 1);
+    entry->port      = port;
+    entry->used_time = now;
+    return entry;
+}
+
 /**
  * @brief free memory/resources allocated by mbedtls
  */
@@ -247,7 +344,11 @@ int _qcloud_server_certificate_verify(void *hostname, mbedtls_x509_crt *crt, int
 
 uintptr_t HAL_TLS_Connect(TLSConnectParams *pConnectParams, const char *host, int port)
 {
-    int ret = 0;
+    int                ret = 0;
+    TLSServerCache *   entry;
+    char               addr[16] = {0};
+    struct sockaddr_in peer;
+    socklen_t          peer_len = sizeof(peer);
 
     Log_i("Before TLS connect, free heap size: %d", xPortGetFreeHeapSize());
     
@@ -317,9 +418,31 @@ uintptr_t HAL_TLS_Connect(TLSConnectParams *pConnectParams, const char *host, in
     mbedtls_ssl_set_bio(&(pDataParams->ssl), &(pDataParams->socket_fd), mbedtls_net_send, mbedtls_net_recv,
                         mbedtls_net_recv_timeout);
 
+    // what the last connection to this server left: its address and session
+    _server_cache_lock();
+    entry = _server_cache_get(host, port, true);
+    if (entry->addr[0] != '\0' && HAL_GetTimeMs() - entry->addr_time < TLS_SERVER_ADDR_TTL_MS) {
+        strcpy(addr, entry->addr);
+    }
+#if defined(MBEDTLS_SSL_CLI_C)
+    if (entry->has_session && (ret = mbedtls_ssl_set_session(&(pDataParams->ssl), &entry->session)) != 0) {
+        Log_w("mbedtls_ssl_set_session failed returned 0x%04x", ret<0?-ret:ret);
+    }
+#endif
+    _server_cache_unlock();
+
     Log_d("Performing the SSL/TLS handshake...");
     Log_d("Connecting to /%s/%d...", host, port);
-    if ((ret = _mbedtls_tcp_connect(&(pDataParams->socket_fd), host, port)) != QCLOUD_RET_SUCCESS) {
+    if (addr[0] != '\0') {
+        if (_mbedtls_tcp_connect(&(pDataParams->socket_fd), addr, port) != QCLOUD_RET_SUCCESS) {
+            Log_w("server %s no more at %s, resolving it again", host, addr);
+            mbedtls_net_free(&(pDataParams->socket_fd));
+            mbedtls_net_init(&(pDataParams->socket_fd));
+            addr[0] = '\0';
+        }
+    }
+    if (addr[0] == '\0' &&
+        (ret = _mbedtls_tcp_connect(&(pDataParams->socket_fd), host, port)) != QCLOUD_RET_SUCCESS) {
         goto error;
     }
 
@@ -343,11 +466,33 @@ uintptr_t HAL_TLS_Connect(TLSConnectParams *pConnectParams, const char *host, in
 
     mbedtls_ssl_conf_read_timeout(&(pDataParams->ssl_conf), 100);
 
+    // kept for the next connection to this server
+    _server_cache_lock();
+    entry = _server_cache_get(host, port, true);
+    if (addr[0] == '\0' && 0 == getpeername(pDataParams->socket_fd.fd, (struct sockaddr *)&peer, &peer_len) &&
+        peer.sin_family == AF_INET) {
+        inet_ntoa_r(peer.sin_addr, entry->addr, sizeof(entry->addr));
+        entry->addr_time = HAL_GetTimeMs();
+    }
+#if defined(MBEDTLS_SSL_CLI_C)
+    _server_cache_drop_session(entry);
+    entry->has_session = (0 == mbedtls_ssl_get_session(&(pDataParams->ssl), &entry->session));
+#endif
+    _server_cache_unlock();
+
     Log_i("connected with /%s/%d...", host, port);
     Log_i("After TLS connect, free heap size: %d", xPortGetFreeHeapSize());
     return (uintptr_t)pDataParams;
 
 error:
+    // a DNS query and a full handshake next time
+    _server_cache_lock();
+    if ((entry = _server_cache_get(host, port, false)) != NULL) {
+        _server_cache_drop_session(entry);
+        entry->addr[0] = '\0';
+    }
+    _server_cache_unlock();
+
     _free_mebedtls(pDataParams);
     return 0;
 }
@@ -458,6 +603,18 @@ int HAL_TLS_Read(uintptr_t handle, unsigned char *msg, size_t totalLen, uint32_t
     }
 }
 
+int HAL_TLS_Socket(uintptr_t handle, size_t *pending)
+{
+    TLSDataParams *pParams = (TLSDataParams *)handle;
+
+    *pending = 0;
+    if (pParams == NULL) {
+        return -1;
+    }
+    *pending = mbedtls_ssl_get_bytes_avail(&(pParams->ssl));
+    return pParams->socket_fd.fd;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,20 +36,25 @@
 // Action Subscribe
 static int _parse_action_input(DeviceAction *pAction, char *pInput)
 {
+    static JsonToken tokens[MAX_JSON_TOKENS_OF_DOC];
+
     int             i;
     char *          temp;
     DeviceProperty *pActionInput = pAction->pInput;
+    JsonIndex       index;
+
+    json_index_build(&index, pInput, strlen(pInput), tokens, MAX_JSON_TOKENS_OF_DOC);
 
     // check and copy
     for (i = 0; i < pAction->input_num; i++) {
         if (JSTRING == pActionInput[i].type) {
-            pActionInput[i].data = LITE_json_value_of(pActionInput[i].key, pInput);
+            pActionInput[i].data = LITE_json_index_value_of(pActionInput[i].key, &index);
             if (NULL == pActionInput[i].data) {
                 Log_e("action input data [%s] not found!", pActionInput[i].key);
                 return -1;
             }
         } else {
-            temp = LITE_json_value_of(pActionInput[i].key, pInput);
+            temp = LITE_json_index_value_of(pActionInput[i].key, &index);
             if (NULL == temp) {
                 Log_e("action input data [%s] not found!", pActionInput[i].key);
                 return -1;
@@ -133,16 +138,21 @@ static void _on_action_handle_callback(void *pClient, MQTTMessage *message, void
     //  (Qcloud_IoT_Template*)mqtt_client->event_handle.context;
     Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template *)pUserData;
 
-    char *type_str     = NULL;
-    char *client_token = NULL;
-    char *action_id    = NULL;
-    char *pInput       = NULL;
-    int   timestamp    = 0;
+    static JsonToken tokens[MAX_JSON_TOKENS_OF_DOC];
+
+    JsonIndex index;
+    char *    type_str     = NULL;
+    char *    client_token = NULL;
+    char *    action_id    = NULL;
+    char *    pInput       = NULL;
+    int       timestamp    = 0;
 
     Log_d("recv:%.*s", (int)message->payload_len, (char *)message->payload);
 
+    json_index_build(&index, (char *)message->payload, message->payload_len, tokens, MAX_JSON_TOKENS_OF_DOC);
+
     // prase_method
-    if (!parse_template_method_type((char *)message->payload, &type_str)) {
+    if (!parse_template_method_type(&index, &type_str)) {
         Log_e("Fail to parse method!");
         goto EXIT;
     }
@@ -152,25 +162,25 @@ static void _on_action_handle_callback(void *pClient, MQTTMessage *message, void
     }
 
     // prase client Token
-    if (!parse_client_token((char *)message->payload, &client_token)) {
+    if (!parse_client_token(&index, &client_token)) {
         Log_e("fail to parse client token!");
         goto EXIT;
     }
 
     // prase action ID
-    if (!parse_action_id((char *)message->payload, &action_id)) {
+    if (!parse_action_id(&index, &action_id)) {
         Log_e("fail to parse action id!");
         goto EXIT;
     }
 
     // prase timestamp
-    if (!parse_time_stamp((char *)message->payload, &timestamp)) {
+    if (!parse_time_stamp(&index, &timestamp)) {
         Log_e("fail to parse timestamp!");
         goto EXIT;
     }
 
     // prase action input
-    if (!parse_action_input((char *)message->payload, &pInput)) {
+    if (!parse_action_input(&index, &pInput)) {
         Log_e("fail to parse action input!");
         goto EXIT;
     }
@@ -455,6 +455,176 @@ int IOT_Template_Report_Sync(void *pClient, char *pJsonDoc, size_t sizeOfBuffer,
     IOT_FUNC_EXIT_RC(rc);
 }
 
+/* caller holds report_batch.mutex */
+static int _flush_report_batch(Qcloud_IoT_Template *pTemplate)
+{
+    TemplateReportBatch *batch = &pTemplate->report_batch;
+    int                  rc;
+
+    if (batch->count == 0) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    // the values are read now, the latest of each property
+    rc = IOT_Template_JSON_ConstructReportArray(pTemplate, batch->buffer, batch->max_size, batch->count, batch->pending);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("construct coalesced report failed, %d properties dropped: %d", batch->count, rc);
+        batch->count = 0;
+        return rc;
+    }
+
+    rc = IOT_Template_Report(pTemplate, batch->buffer, batch->max_size, batch->callback, batch->userContext,
+                             QCLOUD_IOT_MQTT_COMMAND_TIMEOUT);
+    if (rc == QCLOUD_RET_SUCCESS) {
+        batch->count = 0;
+    }  // else kept for the next yield, the connection may be back
+
+    return rc;
+}
+
+/* add the properties not pending yet, false when they are too many */
+static bool _add_report_batch(TemplateReportBatch *batch, uint8_t count, DeviceProperty *pDeviceProperties[])
+{
+    uint8_t i, j;
+
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < batch->count && batch->pending[j] != pDeviceProperties[i]; j++)
+            ;
+        if (j < batch->count) {
+            continue;
+        }
+        if (batch->count == MAX_BATCH_REPORT_PROPERTIES) {
+            return false;
+        }
+        batch->pending[batch->count++] = pDeviceProperties[i];
+    }
+
+    return true;
+}
+
+static void _handle_report_batch(Qcloud_IoT_Template *pTemplate)
+{
+    TemplateReportBatch *batch = &pTemplate->report_batch;
+
+    if (batch->mutex == NULL || batch->count == 0 || !expired(&batch->timer)) {
+        return;
+    }
+
+    HAL_MutexLock(batch->mutex);
+    if (batch->count > 0 && expired(&batch->timer)) {
+        _flush_report_batch(pTemplate);
+    }
+    HAL_MutexUnlock(batch->mutex);
+}
+
+int IOT_Template_Set_Report_Batch(void *pClient, uint32_t window_ms, size_t max_size, OnReplyCallback callback,
+                                  void *userContext)
+{
+    IOT_FUNC_ENTRY;
+    int rc = QCLOUD_RET_SUCCESS;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    NUMBERIC_SANITY_CHECK(max_size, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    TemplateReportBatch *batch     = &pTemplate->report_batch;
+
+    if (batch->mutex == NULL && (batch->mutex = HAL_MutexCreate()) == NULL) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
+    }
+
+    HAL_MutexLock(batch->mutex);
+    if ((rc = _flush_report_batch(pTemplate)) == QCLOUD_RET_SUCCESS && batch->max_size != max_size) {
+        if (batch->buffer != NULL) {
+            HAL_Free(batch->buffer);
+        }
+        batch->max_size = 0;
+        if ((batch->buffer = (char *)HAL_Malloc(max_size)) == NULL) {
+            Log_e("memory not enough to malloc report batch buffer");
+            rc = QCLOUD_ERR_MALLOC;
+        } else {
+            batch->max_size = max_size;
+        }
+    }
+    if (rc == QCLOUD_RET_SUCCESS) {
+        batch->window_ms   = window_ms;
+        batch->callback    = callback;
+        batch->userContext = userContext;
+    }
+    HAL_MutexUnlock(batch->mutex);
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+int IOT_Template_Report_Batch(void *pClient, uint8_t count, DeviceProperty *pDeviceProperties[])
+{
+    IOT_FUNC_ENTRY;
+    int     rc = QCLOUD_RET_SUCCESS;
+    uint8_t pending;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pDeviceProperties, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+    TemplateReportBatch *batch     = &pTemplate->report_batch;
+
+    if (batch->buffer == NULL) {
+        Log_e("report batch not set");
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
+    }
+
+    HAL_MutexLock(batch->mutex);
+    pending = batch->count;
+    if (!_add_report_batch(batch, count, pDeviceProperties) ||
+        IOT_Template_JSON_ConstructReportArray(pTemplate, batch->buffer, batch->max_size, batch->count,
+                                               batch->pending) != QCLOUD_RET_SUCCESS) {
+        // no room left, what was pending goes first
+        batch->count = pending;
+        if ((rc = _flush_report_batch(pTemplate)) != QCLOUD_RET_SUCCESS) {
+            goto exit;
+        }
+        if (!_add_report_batch(batch, count, pDeviceProperties) ||
+            (rc = IOT_Template_JSON_ConstructReportArray(pTemplate, batch->buffer, batch->max_size, batch->count,
+                                                         batch->pending)) != QCLOUD_RET_SUCCESS) {
+            Log_e("properties do not fit in a report of %u bytes", (unsigned)batch->max_size);
+            batch->count = 0;
+            rc           = (rc != QCLOUD_RET_SUCCESS) ? rc : QCLOUD_ERR_INVAL;
+            goto exit;
+        }
+        pending = 0;
+    }
+
+    if (pending == 0) {
+        InitTimer(&batch->timer);
+        countdown_ms(&batch->timer, batch->window_ms);
+    }
+    if (batch->window_ms == 0) {
+        rc = _flush_report_batch(pTemplate);
+    }
+
+exit:
+    HAL_MutexUnlock(batch->mutex);
+    IOT_FUNC_EXIT_RC(rc);
+}
+
+int IOT_Template_Flush_Report(void *pClient)
+{
+    IOT_FUNC_ENTRY;
+    int rc = QCLOUD_RET_SUCCESS;
+
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+
+    if (pTemplate->report_batch.mutex != NULL) {
+        HAL_MutexLock(pTemplate->report_batch.mutex);
+        rc = _flush_report_batch(pTemplate);
+        HAL_MutexUnlock(pTemplate->report_batch.mutex);
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
 int IOT_Template_JSON_ConstructSysInfo(void *pClient, char *jsonBuffer, size_t sizeOfBuffer, DeviceProperty *pPlatInfo,
                                        DeviceProperty *pSelfInfo)
 {
@@ -723,6 +893,7 @@ static void template_yield_thread(void *ptr)
 
     Log_d("template yield thread start ...");
     while (pTemplate->yield_thread_running) {
+        _handle_report_batch(pTemplate);
         rc = IOT_MQTT_Yield(pTemplate->mqtt, 200);
         if (rc == QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT) {
             HAL_SleepMs(THREAD_SLEEP_INTERVAL_MS);
@@ -796,6 +967,70 @@ bool IOT_Template_Get_Yield_Status(void *pClient, int *exit_code)
     return pTemplate->yield_thread_running;
 }
 
+static int _template_reactor_yield(void *handle, uint32_t timeout_ms)
+{
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)handle;
+
+    handle_template_expired_reply(pTemplate);
+    _handle_report_batch(pTemplate);
+
+#ifdef EVENT_POST_ENABLED
+    handle_template_expired_event(pTemplate);
+#endif
+
+    return IOT_MQTT_Yield(pTemplate->mqtt, timeout_ms);
+}
+
+static uint32_t _template_reactor_next_event_ms(void *handle)
+{
+#define TEMPLATE_EXPIRED_CHECK_MS 1000
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)handle;
+    uint32_t             next      = qcloud_iot_mqtt_next_event_ms(pTemplate->mqtt);
+
+    if (pTemplate->report_batch.count > 0) {
+        next = Min(next, Max(left_ms(&pTemplate->report_batch.timer), 0));
+    }
+
+    // replies and events wait for seconds, a look every second is enough
+    if ((pTemplate->inner_data.reply_list != NULL && pTemplate->inner_data.reply_list->len > 0) ||
+        (pTemplate->inner_data.event_list != NULL && pTemplate->inner_data.event_list->len > 0)) {
+        next = Min(next, TEMPLATE_EXPIRED_CHECK_MS);
+    }
+
+    return next;
+#undef TEMPLATE_EXPIRED_CHECK_MS
+}
+
+static void _template_reactor_detached(void *handle, int exit_code)
+{
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)handle;
+
+    pTemplate->yield_thread_running   = false;
+    pTemplate->yield_thread_exit_code = exit_code;
+    IOT_MQTT_Set_Yield_Thread_State(pTemplate->mqtt, false);
+}
+
+static const ReactorClientOps sg_template_reactor_ops = {_template_reactor_yield, _template_reactor_next_event_ms,
+                                                         _template_reactor_detached};
+
+int IOT_Template_Attach_Reactor(void *pClient, void *pReactor)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
+
+    pTemplate->yield_thread_running = true;
+    IOT_MQTT_Set_Yield_Thread_State(pTemplate->mqtt, true);
+
+    int rc = IOT_Reactor_Add(pReactor, pClient, pTemplate->mqtt, &sg_template_reactor_ops);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        pTemplate->yield_thread_running = false;
+        IOT_MQTT_Set_Yield_Thread_State(pTemplate->mqtt, false);
+    }
+
+    return rc;
+}
+
 int IOT_Template_Destroy_Except_MQTT(void *pClient)
 {
     IOT_FUNC_ENTRY;
@@ -835,6 +1070,7 @@ int IOT_Template_Yield(void *pClient, uint32_t timeout_ms)
     Qcloud_IoT_Template *pTemplate = (Qcloud_IoT_Template *)pClient;
 
     handle_template_expired_reply(pTemplate);
+    _handle_report_batch(pTemplate);
 
 #ifdef EVENT_POST_ENABLED
     handle_template_expired_event(pTemplate);
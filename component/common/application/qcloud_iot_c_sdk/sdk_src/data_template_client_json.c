@@ -218,23 +218,23 @@ void build_empty_json(uint32_t *tokenNumber, char *pJsonBuffer, char *tokenPrefi
                  (*tokenNumber)++);
 }
 
-bool parse_client_token(char *pJsonDoc, char **pClientToken)
+bool parse_client_token(JsonIndex *pIndex, char **pClientToken)
 {
-    *pClientToken = LITE_json_value_of(CLIENT_TOKEN_FIELD, pJsonDoc);
+    *pClientToken = LITE_json_index_value_of(CLIENT_TOKEN_FIELD, pIndex);
     return *pClientToken == NULL ? false : true;
 }
 
-bool parse_action_id(char *pJsonDoc, char **pActionID)
+bool parse_action_id(JsonIndex *pIndex, char **pActionID)
 {
-    *pActionID = LITE_json_value_of(ACTION_ID_FIELD, pJsonDoc);
+    *pActionID = LITE_json_index_value_of(ACTION_ID_FIELD, pIndex);
     return *pActionID == NULL ? false : true;
 }
 
-bool parse_time_stamp(char *pJsonDoc, int32_t *pTimestamp)
+bool parse_time_stamp(JsonIndex *pIndex, int32_t *pTimestamp)
 {
     bool ret = false;
 
-    char *timestamp = LITE_json_value_of(TIME_STAMP_FIELD, pJsonDoc);
+    char *timestamp = LITE_json_index_value_of(TIME_STAMP_FIELD, pIndex);
     if (timestamp == NULL)
         return false;
 
@@ -249,17 +249,17 @@ bool parse_time_stamp(char *pJsonDoc, int32_t *pTimestamp)
     return ret;
 }
 
-bool parse_action_input(char *pJsonDoc, char **pActionInput)
+bool parse_action_input(JsonIndex *pIndex, char **pActionInput)
 {
-    *pActionInput = LITE_json_value_of(CMD_CONTROL_PARA, pJsonDoc);
+    *pActionInput = LITE_json_index_value_of(CMD_CONTROL_PARA, pIndex);
     return *pActionInput == NULL ? false : true;
 }
 
-bool parse_code_return(char *pJsonDoc, int32_t *pCode)
+bool parse_code_return(JsonIndex *pIndex, int32_t *pCode)
 {
     bool ret = false;
 
-    char *code = LITE_json_value_of(REPLY_CODE, pJsonDoc);
+    char *code = LITE_json_index_value_of(REPLY_CODE, pIndex);
     if (code == NULL)
         return false;
 
@@ -274,17 +274,17 @@ bool parse_code_return(char *pJsonDoc, int32_t *pCode)
     return ret;
 }
 
-bool parse_status_return(char *pJsonDoc, char **pStatus)
+bool parse_status_return(JsonIndex *pIndex, char **pStatus)
 {
-    *pStatus = LITE_json_value_of(REPLY_STATUS, pJsonDoc);
+    *pStatus = LITE_json_index_value_of(REPLY_STATUS, pIndex);
     return *pStatus == NULL ? false : true;
 }
 
-bool update_value_if_key_match(char *pJsonDoc, DeviceProperty *pProperty)
+bool update_value_if_key_match(JsonIndex *pIndex, DeviceProperty *pProperty)
 {
     bool ret = false;
 
-    char *property_data = LITE_json_value_of(pProperty->key, pJsonDoc);
+    char *property_data = LITE_json_index_value_of(pProperty->key, pIndex);
     if ((property_data == NULL) || !(strncmp(property_data, "null", 4)) || !(strncmp(property_data, "NULL", 4))) {
         ret = false;
     } else {
@@ -299,21 +299,21 @@ bool update_value_if_key_match(char *pJsonDoc, DeviceProperty *pProperty)
     return ret;
 }
 
-bool parse_template_method_type(char *pJsonDoc, char **pMethod)
+bool parse_template_method_type(JsonIndex *pIndex, char **pMethod)
 {
-    *pMethod = LITE_json_value_of(METHOD_FIELD, pJsonDoc);
+    *pMethod = LITE_json_index_value_of(METHOD_FIELD, pIndex);
     return *pMethod == NULL ? false : true;
 }
 
-bool parse_template_get_control(char *pJsonDoc, char **control)
+bool parse_template_get_control(JsonIndex *pIndex, char **control)
 {
-    *control = LITE_json_value_of(GET_CONTROL_PARA, pJsonDoc);
+    *control = LITE_json_index_value_of(GET_CONTROL_PARA, pIndex);
     return *control == NULL ? false : true;
 }
 
-bool parse_template_cmd_control(char *pJsonDoc, char **control)
+bool parse_template_cmd_control(JsonIndex *pIndex, char **control)
 {
-    *control = LITE_json_value_of(CMD_CONTROL_PARA, pJsonDoc);
+    *control = LITE_json_index_value_of(CMD_CONTROL_PARA, pIndex);
     return *control == NULL ? false : true;
 }
 
@@ -39,6 +39,10 @@ typedef void (*TraverseTemplateHandle)(Qcloud_IoT_Template *pTemplate, ListNode
 static char sg_template_cloud_rcv_buf[CLOUD_IOT_JSON_RX_BUF_LEN];
 static char sg_template_clientToken[MAX_SIZE_OF_CLIENT_TOKEN];
 
+static JsonToken sg_template_cloud_rcv_tokens[MAX_JSON_TOKENS_OF_DOC];
+static JsonIndex sg_template_cloud_rcv_index;
+static JsonToken sg_template_control_tokens[MAX_JSON_TOKENS_OF_DOC];
+
 /**
  * @brief unsubsribe topic:  $thing/down/property/{ProductId}/{DeviceName}
  */
@@ -292,6 +296,17 @@ void qcloud_iot_template_reset(Qcloud_IoT_Template *pTemplate)
         list_destroy(pTemplate->inner_data.action_handle_list);
         pTemplate->inner_data.action_handle_list = NULL;
     }
+
+    if (NULL != pTemplate->report_batch.buffer) {
+        HAL_Free(pTemplate->report_batch.buffer);
+        pTemplate->report_batch.buffer = NULL;
+    }
+
+    if (NULL != pTemplate->report_batch.mutex) {
+        HAL_MutexDestroy(pTemplate->report_batch.mutex);
+        pTemplate->report_batch.mutex = NULL;
+    }
+    pTemplate->report_batch.count = 0;
 }
 
 int qcloud_iot_template_init(Qcloud_IoT_Template *pTemplate)
@@ -304,6 +319,8 @@ int qcloud_iot_template_init(Qcloud_IoT_Template *pTemplate)
     if (pTemplate->mutex == NULL)
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
 
+    memset(&pTemplate->report_batch, 0, sizeof(TemplateReportBatch));
+
     pTemplate->inner_data.property_handle_list = list_new();
     if (pTemplate->inner_data.property_handle_list) {
         pTemplate->inner_data.property_handle_list->free = HAL_Free;
@@ -358,10 +375,13 @@ int send_template_request(Qcloud_IoT_Template *pTemplate, RequestParams *pParams
     POINTER_SANITY_CHECK(pJsonDoc, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
 
-    char *client_token = NULL;
+    char *    client_token = NULL;
+    JsonToken tokens[MAX_JSON_TOKENS_OF_DOC];
+    JsonIndex index;
 
     // parse clientToken in pJsonDoc, return err if parse failed
-    if (!parse_client_token(pJsonDoc, &client_token)) {
+    json_index_build(&index, pJsonDoc, strlen(pJsonDoc), tokens, MAX_JSON_TOKENS_OF_DOC);
+    if (!parse_client_token(&index, &client_token)) {
         Log_e("fail to parse client token!");
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
     }
@@ -393,6 +413,11 @@ static void _handle_control(Qcloud_IoT_Template *pTemplate, char *control_str)
         ListIterator *   iter;
         ListNode *       node            = NULL;
         PropertyHandler *property_handle = NULL;
+        JsonIndex        control_index;
+
+        // one pass over the control params for the lookups of all the properties
+        json_index_build(&control_index, control_str, strlen(control_str), sg_template_control_tokens,
+                         MAX_JSON_TOKENS_OF_DOC);
 
         if (NULL == (iter = list_iterator_new(pTemplate->inner_data.property_handle_list, LIST_TAIL))) {
             HAL_MutexUnlock(pTemplate->mutex);
@@ -412,7 +437,7 @@ static void _handle_control(Qcloud_IoT_Template *pTemplate, char *control_str)
             }
 
             if (property_handle->property != NULL) {
-                if (update_value_if_key_match(control_str, property_handle->property)) {
+                if (update_value_if_key_match(&control_index, property_handle->property)) {
                     if (property_handle->callback != NULL) {
                         property_handle->callback(pTemplate, control_str, strlen(control_str),
                                                   property_handle->property);
@@ -443,7 +468,7 @@ static void _handle_template_reply_callback(Qcloud_IoT_Template *pTemplate, List
         // check operation success or not according to code field of reply message
         int32_t reply_code = 0;
 
-        bool parse_success = parse_code_return(sg_template_cloud_rcv_buf, &reply_code);
+        bool parse_success = parse_code_return(&sg_template_cloud_rcv_index, &reply_code);
         if (parse_success) {
             if (reply_code == 0) {
                 status = ACK_ACCEPTED;
@@ -453,7 +478,7 @@ static void _handle_template_reply_callback(Qcloud_IoT_Template *pTemplate, List
 
             if (strcmp(pType, GET_STATUS_REPLY) == 0 && status == ACK_ACCEPTED) {
                 char *control_str = NULL;
-                if (parse_template_get_control(sg_template_cloud_rcv_buf, &control_str)) {
+                if (parse_template_get_control(&sg_template_cloud_rcv_index, &control_str)) {
                     Log_d("control data from get_status_reply");
                     _set_control_clientToken(pClientToken);
                     _handle_control(pTemplate, control_str);
@@ -503,14 +528,16 @@ static void _on_template_downstream_topic_handler(void *pClient, MQTTMessage *me
     memcpy(sg_template_cloud_rcv_buf, message->payload, cloud_rcv_len + 1);
     sg_template_cloud_rcv_buf[cloud_rcv_len] = '\0';  // jsmn_parse relies on a string
 //    Log_d("recv:%s", sg_template_cloud_rcv_buf);
+    json_index_build(&sg_template_cloud_rcv_index, sg_template_cloud_rcv_buf, cloud_rcv_len,
+                     sg_template_cloud_rcv_tokens, MAX_JSON_TOKENS_OF_DOC);
 
     // parse the message type from topic $thing/down/property
-    if (!parse_template_method_type(sg_template_cloud_rcv_buf, &type_str)) {
+    if (!parse_template_method_type(&sg_template_cloud_rcv_index, &type_str)) {
         Log_e("Fail to parse method!");
         goto End;
     }
 
-    if (!parse_client_token(sg_template_cloud_rcv_buf, &client_token)) {
+    if (!parse_client_token(&sg_template_cloud_rcv_index, &client_token)) {
         Log_e("Fail to parse client token! Json=%s", sg_template_cloud_rcv_buf);
         goto End;
     }
@@ -519,7 +546,7 @@ static void _on_template_downstream_topic_handler(void *pClient, MQTTMessage *me
     if (!strcmp(type_str, CONTROL_CMD)) {
         HAL_MutexLock(template_client->mutex);
         char *control_str = NULL;
-        if (parse_template_cmd_control(sg_template_cloud_rcv_buf, &control_str)) {
+        if (parse_template_cmd_control(&sg_template_cloud_rcv_index, &control_str)) {
             Log_d("control_str:%s", control_str);
             _set_control_clientToken(client_token);
             _handle_control(template_client, control_str);
@@ -100,26 +100,31 @@ static void _on_event_reply_callback(void *pClient, MQTTMessage *message, void *
     POINTER_SANITY_CHECK_RTN(message);
     Qcloud_IoT_Template *template_client = (Qcloud_IoT_Template *)userData;
 
-    int32_t code;
-    char *  client_token = NULL;
-    char *  status       = NULL;
+    static JsonToken tokens[MAX_JSON_TOKENS_OF_DOC];
+
+    int32_t   code;
+    char *    client_token = NULL;
+    char *    status       = NULL;
+    JsonIndex index;
 
     Log_d("recv:%.*s", (int)message->payload_len, (char *)message->payload);
 
+    json_index_build(&index, (char *)message->payload, message->payload_len, tokens, MAX_JSON_TOKENS_OF_DOC);
+
     // parse clientToken from payload
-    if (!parse_client_token((char *)message->payload, &client_token)) {
+    if (!parse_client_token(&index, &client_token)) {
         Log_e("fail to parse client token!");
         return;
     }
 
     // parse code from payload
-    if (!parse_code_return((char *)message->payload, &code)) {
+    if (!parse_code_return(&index, &code)) {
         HAL_Free(client_token);
         Log_e("fail to parse code");
         return;
     }
 
-    if (!parse_status_return((char *)message->payload, &status)) {
+    if (!parse_status_return(&index, &status)) {
         // Log_d("no status return");
     }
 
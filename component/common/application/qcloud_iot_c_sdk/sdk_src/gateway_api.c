@@ -99,6 +99,40 @@ bool IOT_Gateway_Get_Yield_Status(void *pClient, int *exit_code)
 
     return pGateway->yield_thread_running;
 }
+
+static int _gateway_reactor_yield(void *handle, uint32_t timeout_ms)
+{
+    return IOT_Gateway_Yield(handle, timeout_ms);
+}
+
+static void _gateway_reactor_detached(void *handle, int exit_code)
+{
+    Gateway *pGateway = (Gateway *)handle;
+
+    pGateway->yield_thread_running   = false;
+    pGateway->yield_thread_exit_code = exit_code;
+    IOT_MQTT_Set_Yield_Thread_State(pGateway->mqtt, false);
+}
+
+static const ReactorClientOps sg_gateway_reactor_ops = {_gateway_reactor_yield, NULL, _gateway_reactor_detached};
+
+int IOT_Gateway_Attach_Reactor(void *pClient, void *pReactor)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    Gateway *pGateway = (Gateway *)pClient;
+
+    pGateway->yield_thread_running = true;
+    IOT_MQTT_Set_Yield_Thread_State(pGateway->mqtt, true);
+
+    int rc = IOT_Reactor_Add(pReactor, pClient, pGateway->mqtt, &sg_gateway_reactor_ops);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        pGateway->yield_thread_running = false;
+        IOT_MQTT_Set_Yield_Thread_State(pGateway->mqtt, false);
+    }
+
+    return rc;
+}
 #endif
 
 void _gateway_event_handler(void *client, void *context, MQTTEventMsg *msg)
@@ -40,6 +40,18 @@ extern "C" {
 
 #define MAX_CLEAE_DOC_LEN 256
 
+typedef struct _TemplateReportBatch {
+    uint32_t        window_ms;  // how long the first pending property waits, 0 for no batching
+    size_t          max_size;   // of the coalesced report document
+    char *          buffer;     // max_size bytes for the document
+    void *          mutex;
+    uint8_t         count;
+    DeviceProperty *pending[MAX_BATCH_REPORT_PROPERTIES];
+    Timer           timer;  // started by the first pending property
+    OnReplyCallback callback;
+    void *          userContext;
+} TemplateReportBatch;
+
 typedef struct _TemplateInnerData {
     uint32_t token_num;
     int32_t  sync_status;
@@ -59,6 +71,7 @@ typedef struct _Template {
     DeviceInfo            device_info;
     MQTTEventHandler      event_handle;
     TemplateInnerData     inner_data;
+    TemplateReportBatch   report_batch;
     DataTemplateDestroyCb DataTemplateDestroyCb;
 
 #ifdef MULTITHREAD_ENABLED
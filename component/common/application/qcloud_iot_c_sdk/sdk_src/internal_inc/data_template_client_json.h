@@ -24,6 +24,7 @@
 #ifdef __cplusplus
 extern "C" {
 #endif
+#include "json_parser.h"
 #include "qcloud_iot_export.h"
 #include "qcloud_iot_import.h"
 
@@ -35,6 +36,9 @@ extern "C" {
 /* Size of buffer to receive JSON document from server */
 #define CLOUD_IOT_JSON_RX_BUF_LEN (QCLOUD_IOT_MQTT_RX_BUF_LEN + 1)
 
+/* Max number of JSON tokens indexed in a document, one with more is parsed without index */
+#define MAX_JSON_TOKENS_OF_DOC (64)
+
 /* Max size of clientToken */
 #define MAX_SIZE_OF_CLIENT_TOKEN (MAX_SIZE_OF_CLIENT_ID + 10)
 
@@ -173,92 +177,92 @@ void build_empty_json(uint32_t *tokenNumber, char *pJsonBuffer, char *tokenPrefi
 /**
  * @brief parse field of clientToken from JSON string
  *
- * @param pJsonDoc       source JSON string
+ * @param pIndex         index of the source JSON string
  * @param pClientToken   pointer to field of ClientToken
  * @return               true for success
  */
-bool parse_client_token(char *pJsonDoc, char **pClientToken);
+bool parse_client_token(JsonIndex *pIndex, char **pClientToken);
 
 /**
  * @brief parse field of aciont_id from JSON string
  *
- * @param pJsonDoc       source JSON string
+ * @param pIndex         index of the source JSON string
  * @param pActionID   	 pointer to field of action_id
  * @return               true for success
  */
-bool parse_action_id(char *pJsonDoc, char **pActionID);
+bool parse_action_id(JsonIndex *pIndex, char **pActionID);
 
 /**
  * @brief parse field of timestamp from JSON string
  *
- * @param pJsonDoc       source JSON string
+ * @param pIndex         index of the source JSON string
  * @param pTimestamp     pointer to field of timestamp
  * @return               true for success
  */
-bool parse_time_stamp(char *pJsonDoc, int32_t *pTimestamp);
+bool parse_time_stamp(JsonIndex *pIndex, int32_t *pTimestamp);
 
 /**
  * @brief parse field of input from JSON string
  *
- * @param pJsonDoc       source JSON string
+ * @param pIndex         index of the source JSON string
  * @param pActionInput   filed of params as action input parameters
  * @return               true for success
  */
-bool parse_action_input(char *pJsonDoc, char **pActionInput);
+bool parse_action_input(JsonIndex *pIndex, char **pActionInput);
 
 /**
  * @brief parse field of status from JSON string
  *
- * @param pJsonDoc       source JSON string
+ * @param pIndex         index of the source JSON string
  * @param pStatus   	 pointer to field of status
  * @return               true for success
  */
-bool parse_status_return(char *pJsonDoc, char **pStatus);
+bool parse_status_return(JsonIndex *pIndex, char **pStatus);
 
 /**
  * @brief parse field of code from JSON string
  *
- * @param pJsonDoc       source JSON string
+ * @param pIndex         index of the source JSON string
  * @param pCode   		 pointer to field of Code
  * @return               true for success
  */
-bool parse_code_return(char *pJsonDoc, int32_t *pCode);
+bool parse_code_return(JsonIndex *pIndex, int32_t *pCode);
 
 /**
  * @brief update value in JSON if key is matched, not for OBJECT type
  *
- * @param pJsonDoc       JSON string
+ * @param pIndex         index of the JSON string
  * @param pProperty      device property
  * @return               true for success
  */
-bool update_value_if_key_match(char *pJsonDoc, DeviceProperty *pProperty);
+bool update_value_if_key_match(JsonIndex *pIndex, DeviceProperty *pProperty);
 
 /**
  * @brief parse field of method from JSON string
  *
- * @param pJsonDoc		 source JSON string
+ * @param pIndex  		 index of the source JSON string
  * @param pMethod 		 pointer to field of method
  * @return				 true for success
  */
-bool parse_template_method_type(char *pJsonDoc, char **pMethod);
+bool parse_template_method_type(JsonIndex *pIndex, char **pMethod);
 
 /**
  * @brief parse field of control from get_status_reply JSON string
  *
- * @param pJsonDoc		 source JSON string
+ * @param pIndex  		 index of the source JSON string
  * @param control 		 pointer to field of control
  * @return				 true for success
  */
-bool parse_template_get_control(char *pJsonDoc, char **control);
+bool parse_template_get_control(JsonIndex *pIndex, char **control);
 
 /**
  * @brief parse field of control from control JSON string
  *
- * @param pJsonDoc		 source JSON string
+ * @param pIndex  		 index of the source JSON string
  * @param control 		 pointer to field of control
  * @return				 true for success
  */
-bool parse_template_cmd_control(char *pJsonDoc, char **control);
+bool parse_template_cmd_control(JsonIndex *pIndex, char **control);
 
 #ifdef __cplusplus
 }
@@ -70,6 +70,83 @@ int json_parse_name_value(char *p_cJsonStr, int iStrLen, json_parse_cb pfnCB, vo
  **/
 char *json_get_value_by_name(char *p_cJsonStr, int iStrLen, char *p_cName, int *p_iValueLen, int *p_iValueType);
 
+/**
+The longest JSON string and the deepest nesting a JSON index takes
+**/
+#define JSON_INDEX_MAX_LEN   (0xFFFF)
+#define JSON_INDEX_MAX_DEPTH (16)
+
+/**
+A value of the JSON string, in document order: an object is followed by its keys and values in turn, an array by
+its entries
+**/
+typedef struct {
+    uint16_t start; /* offset of the value, a string's past its opening quote */
+    uint16_t len;   /* length of the value, a string's without its quotes */
+    uint16_t skip;  /* tokens of the value with its own, the next one after it is this index + skip */
+    int8_t   type;  /* JSONTYPE */
+} JsonToken;
+
+/**
+The token index of a JSON string, built once for all the lookups in it
+**/
+typedef struct {
+    const char *json;
+    JsonToken * tokens;
+    int         count; /* JSON_RESULT_ERR when the JSON string could not be indexed */
+} JsonIndex;
+
+/**
+ * @brief Index a JSON string in one pass, without allocation
+ *
+ * @param[out] index      @n  The JSON index
+ * @param[in]  json       @n  The JSON string, kept by the index
+ * @param[in]  len        @n  The JSON string length, it also ends at '\0'
+ * @param[in]  tokens     @n  Room for the tokens
+ * @param[in]  max_tokens @n  Number of tokens there is room for
+ * @return the number of tokens, or JSON_RESULT_ERR when the string is not JSON, or needs more tokens, or is longer
+ *         than JSON_INDEX_MAX_LEN or deeper than JSON_INDEX_MAX_DEPTH
+ * @see None.
+ * @note a failed index still keeps the string, for LITE_json_index_value_of to fall back on.
+ **/
+int json_index_build(JsonIndex *index, const char *json, int len, JsonToken *tokens, int max_tokens);
+
+/**
+ * @brief Find a value by its path from a token of the index
+ *
+ * @param[in]  index  @n  The JSON index
+ * @param[in]  parent @n  The token to start from, 0 for the whole JSON string
+ * @param[in]  path   @n  Keys separated by '.', array entries as [n], e.g. "payload.devices[0].result"
+ * @return The token of the value, or JSON_RESULT_ERR when there is none
+ * @see None.
+ * @note the first of duplicated keys is found.
+ **/
+int json_index_find(const JsonIndex *index, int parent, const char *path);
+
+/**
+ * @brief Get the value of a token
+ *
+ * @param[in]  index        @n the JSON index
+ * @param[in]  token        @n the token, from json_index_find
+ * @param[out] p_iValueLen  @n the value length
+ * @param[out] p_iValueType @n the value type
+ * @return A pointer to the value in the JSON string, as json_get_value_by_name gives it, or NULL
+ * @see None.
+ * @note None.
+ **/
+char *json_index_value(const JsonIndex *index, int token, int *p_iValueLen, int *p_iValueType);
+
+/**
+ * @brief Get a copy of the value by its path, as LITE_json_value_of does, from the index
+ *
+ * @param[in] path  @n the path, see json_index_find
+ * @param[in] index @n the JSON index, a failed one falls back on LITE_json_value_of
+ * @return the value to be freed by HAL_Free, or NULL
+ * @see None.
+ * @note None.
+ **/
+char *LITE_json_index_value_of(const char *path, JsonIndex *index);
+
 /**
  * @brief Get the JSON object point associate with a given type.
  *
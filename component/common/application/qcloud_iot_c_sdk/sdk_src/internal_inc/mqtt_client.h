@@ -30,6 +30,8 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
+#include "MQTTQueue.h"
+#include "MQTTTopicTrie.h"
 #include "mqtt_client_net.h"
 #include "qcloud_iot_common.h"
 #include "qcloud_iot_export.h"
@@ -44,12 +46,18 @@ extern "C" {
 /* Max size of conn Id  */
 #define MAX_CONN_ID_LEN (6)
 
-/* Max number of topic subscribed */
+/* Max number of topic subscriptions waiting for SUBACK */
 #define MAX_MESSAGE_HANDLERS (10)
 
+/* Max number of topic filters in a SUBSCRIBE packet, when resubscribing */
+#define MAX_TOPICS_PER_SUBSCRIBE (16)
+
 /* Max number in repub list */
 #define MAX_REPUB_NUM (20)
 
+/* Max number of queued messages in repub list, the rest is left to direct publishes */
+#define MAX_QUEUE_INFLIGHT_NUM (MAX_REPUB_NUM / 2)
+
 /* Minimal wait interval when reconnect */
 #define MIN_RECONNECT_WAIT_INTERVAL (1000)
 
@@ -174,6 +182,7 @@ typedef struct SubTopicHandle {
     OnSubEventHandler sub_event_handler;  // callback when event of this subscription happens
     void *            handler_user_data;  // user context for callback
     QoS               qos;                // QoS
+    uint8_t           payload_streaming;  // takes a PUBLISH larger than the read buffer in pieces
 } SubTopicHandle;
 
 /**
@@ -190,6 +199,8 @@ typedef struct Client {
 
     uint32_t current_reconnect_wait_interval;  // unit:ms
     uint32_t counter_network_disconnected;     // number of disconnection
+    uint32_t link_up_count;                    // network link up events seen, from HAL_Network_Link_Up
+    uint32_t reconnect_jitter_state;           // xorshift32 state of the reconnect jitter, never 0
 
     size_t        write_buf_size;                         // size of MQTT write buffer
     size_t        read_buf_size;                          // size of MQTT read buffer
@@ -203,6 +214,8 @@ typedef struct Client {
     void *lock_list_sub;  // mutex/lock for suback waiting list
 
     List *list_pub_wait_ack;  // puback waiting list
+
+    MQTTQueue *queue;  // outbound queue of IOT_MQTT_Publish_Queued, NULL for none
     List *list_sub_wait_ack;  // suback waiting list
 
     MQTTEventHandler event_handle;  // callback for MQTT event
@@ -214,7 +227,7 @@ typedef struct Client {
     Timer ping_timer;             // MQTT ping timer
     Timer reconnect_delay_timer;  // MQTT reconnect delay timer
 
-    SubTopicHandle sub_handles[MAX_MESSAGE_HANDLERS];  // subscription handle array
+    MQTTTopicTrie sub_handles;  // subscription handles (SubTopicHandle), indexed by topic filter
 
     char host_addr[HOST_STR_LENGTH];
 
@@ -253,6 +266,7 @@ typedef struct REPUBLISH_INFO {
     Timer          pub_start_time; /* timer for puback waiting */
     MQTTNodeState  node_state;     /* node state in wait list */
     uint16_t       msg_id;         /* packet id */
+    uint8_t        queued;         /* sent from the outbound queue */
     uint32_t       len;            /* msg length */
     unsigned char *buf;            /* msg buffer */
 } QcloudIotPubInfo;
@@ -326,6 +340,25 @@ int qcloud_iot_mqtt_disconnect(Qcloud_IoT_Client *pClient);
  */
 int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams);
 
+/**
+ * @brief Put MQTT message in the outbound queue, then send what the repub list takes of it
+ *
+ * @param pClient       handle to MQTT client
+ * @param topicName     MQTT topic name
+ * @param pParams       publish parameters
+ *
+ * @return QCLOUD_RET_SUCCESS when queued, or err code for failure
+ */
+int qcloud_iot_mqtt_publish_queued(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams);
+
+/**
+ * @brief Send queued messages, in order, while connected and the repub list has room
+ *
+ * @param pClient       handle to MQTT client
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+int qcloud_iot_mqtt_flush_queue(Qcloud_IoT_Client *pClient);
+
 /**
  * @brief Subscribe MQTT topic
  *
@@ -382,6 +415,15 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms);
 // workaround wrapper for qcloud_iot_mqtt_yield for multi-thread mode
 int qcloud_iot_mqtt_yield_mt(Qcloud_IoT_Client *mqtt_client, uint32_t timeout_ms);
 
+/**
+ * @brief Time left before the client has work to do that no packet brings (reconnect, PINGREQ, ack timeout)
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return time in ms, 0 when due
+ */
+uint32_t qcloud_iot_mqtt_next_event_ms(Qcloud_IoT_Client *pClient);
+
 /**
  * @brief Check if auto reconnect is enabled or not
  *
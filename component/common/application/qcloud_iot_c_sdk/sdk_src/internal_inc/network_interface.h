@@ -81,6 +81,9 @@ int network_init(Network *pNetwork);
 /* return the handle */
 int is_network_connected(Network *pNetwork);
 
+/* return the socket to wait on, -1 when there is none (AT, UDP/DTLS, not connected), and the bytes already held */
+int network_get_socket(Network *pNetwork, size_t *pending);
+
 /* network stack API */
 #ifdef AT_TCP_ENABLED
 
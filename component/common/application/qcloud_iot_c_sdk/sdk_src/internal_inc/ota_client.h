@@ -25,6 +25,7 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Specify the maximum characters of version */
@@ -55,6 +56,8 @@ int qcloud_osc_report_version(void *handle, const char *msg);
 
 int qcloud_osc_report_upgrade_result(void *handle, const char *msg);
 
+int qcloud_ota_fetch_yield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_ms, bool update_md5);
+
 #ifdef __cplusplus
 }
 #endif
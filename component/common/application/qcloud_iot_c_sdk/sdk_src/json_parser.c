@@ -257,3 +257,249 @@ char *json_get_value_by_name(char *p_cJsonStr, int iStrLen, char *p_cName, int *
     }
     return stNV.pV;
 }
+
+/* what json_index_build looks for next */
+enum JSON_INDEX_STATE {
+    JSON_INDEX_VALUE,
+    JSON_INDEX_VALUE_OR_END, /* first entry of an array */
+    JSON_INDEX_KEY,
+    JSON_INDEX_KEY_OR_END, /* first key of an object */
+    JSON_INDEX_COLON,
+    JSON_INDEX_COMMA_OR_END,
+    JSON_INDEX_DONE
+};
+
+static int _json_index_add(JsonToken *tokens, int max_tokens, int *count, int type, int start, int len)
+{
+    if (*count >= max_tokens) {
+        return JSON_RESULT_ERR;
+    }
+    tokens[*count].type  = type;
+    tokens[*count].start = start;
+    tokens[*count].len   = len;
+    tokens[*count].skip  = 1;
+    return (*count)++;
+}
+
+static int _json_index_literal(const char *json, int pos, int len)
+{
+    static const char *literals[] = {"true", "TRUE", "false", "FALSE", "null", "NULL"};
+    size_t             i;
+    int                n;
+
+    for (i = 0; i < sizeof(literals) / sizeof(literals[0]); i++) {
+        n = (int)strlen(literals[i]);
+        if (pos + n <= len && !strncmp(json + pos, literals[i], n)) {
+            return n;
+        }
+    }
+    return 0;
+}
+
+int json_index_build(JsonIndex *index, const char *json, int len, JsonToken *tokens, int max_tokens)
+{
+    int  stack[JSON_INDEX_MAX_DEPTH]; /* objects and arrays open */
+    int  depth = 0, count = 0, pos = 0, state = JSON_INDEX_VALUE;
+    int  start, n, token;
+    char c, close;
+
+    index->json   = json;
+    index->tokens = tokens;
+    index->count  = JSON_RESULT_ERR;
+
+    if (json == NULL || tokens == NULL || len <= 0 || len > JSON_INDEX_MAX_LEN) {
+        return JSON_RESULT_ERR;
+    }
+
+    while (pos < len && json[pos] != '\0' && state != JSON_INDEX_DONE) {
+        c = json[pos];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            pos++;
+            continue;
+        }
+
+        close = (depth == 0) ? 0 : (tokens[stack[depth - 1]].type == JSOBJECT) ? '}' : ']';
+
+        switch (state) {
+            case JSON_INDEX_KEY_OR_END:
+            case JSON_INDEX_VALUE_OR_END:
+                if (c != close) {
+                    state = (state == JSON_INDEX_KEY_OR_END) ? JSON_INDEX_KEY : JSON_INDEX_VALUE;
+                    continue;
+                }
+                /* fall through */
+            case JSON_INDEX_COMMA_OR_END:
+                if (c == ',' && state == JSON_INDEX_COMMA_OR_END) {
+                    state = (close == '}') ? JSON_INDEX_KEY : JSON_INDEX_VALUE;
+                    pos++;
+                    continue;
+                }
+                if (c != close) {
+                    return JSON_RESULT_ERR;
+                }
+                token               = stack[--depth];
+                tokens[token].len   = pos + 1 - tokens[token].start;
+                tokens[token].skip  = count - token;
+                pos++;
+                state = (depth == 0) ? JSON_INDEX_DONE : JSON_INDEX_COMMA_OR_END;
+                continue;
+
+            case JSON_INDEX_COLON:
+                if (c != ':') {
+                    return JSON_RESULT_ERR;
+                }
+                pos++;
+                state = JSON_INDEX_VALUE;
+                continue;
+
+            case JSON_INDEX_KEY:
+                if (c != '"') {
+                    return JSON_RESULT_ERR;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        /* a key or a value starts at pos */
+        if (c == '{' || c == '[') {
+            if (depth >= JSON_INDEX_MAX_DEPTH ||
+                (token = _json_index_add(tokens, max_tokens, &count, (c == '{') ? JSOBJECT : JSARRAY, pos, 0)) < 0) {
+                return JSON_RESULT_ERR;
+            }
+            stack[depth++] = token;
+            pos++;
+            state = (c == '{') ? JSON_INDEX_KEY_OR_END : JSON_INDEX_VALUE_OR_END;
+            continue;
+        }
+
+        if (c == '"') {
+            start = ++pos;
+            while (pos < len && json[pos] != '\0' && json[pos] != '"') {
+                pos += (json[pos] == '\\' && pos + 1 < len && json[pos + 1] != '\0') ? 2 : 1;
+            }
+            if (pos >= len || json[pos] != '"') {
+                return JSON_RESULT_ERR;
+            }
+            token = _json_index_add(tokens, max_tokens, &count, JSSTRING, start, pos - start);
+            pos++;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            start = pos;
+            n     = 0;
+            while (pos < len && (json[pos] == '-' || json[pos] == '+' || json[pos] == '.' || json[pos] == 'e' ||
+                                 json[pos] == 'E' || (json[pos] >= '0' && json[pos] <= '9'))) {
+                n += (json[pos] >= '0' && json[pos] <= '9');
+                pos++;
+            }
+            if (n == 0) {
+                return JSON_RESULT_ERR;
+            }
+            token = _json_index_add(tokens, max_tokens, &count, JSNUMBER, start, pos - start);
+        } else if ((n = _json_index_literal(json, pos, len)) > 0) {
+            token = _json_index_add(tokens, max_tokens, &count, (c == 'n' || c == 'N') ? JSNULL : JSBOOLEAN, pos, n);
+            pos += n;
+        } else {
+            return JSON_RESULT_ERR;
+        }
+        if (token < 0) {
+            return JSON_RESULT_ERR;
+        }
+
+        if (state == JSON_INDEX_KEY) {
+            state = JSON_INDEX_COLON;
+        } else {
+            state = (depth == 0) ? JSON_INDEX_DONE : JSON_INDEX_COMMA_OR_END;
+        }
+    }
+
+    if (state != JSON_INDEX_DONE) {
+        return JSON_RESULT_ERR;
+    }
+
+    index->count = count;
+    return count;
+}
+
+/* the value of a key in an object */
+static int _json_index_member(const JsonIndex *index, int object, const char *key, int key_len)
+{
+    const JsonToken *tokens = index->tokens;
+    int              i, end = object + tokens[object].skip;
+
+    if (tokens[object].type != JSOBJECT) {
+        return JSON_RESULT_ERR;
+    }
+
+    for (i = object + 1; i < end; i += 1 + tokens[i + 1].skip) {
+        if (tokens[i].len == key_len && !strncmp(index->json + tokens[i].start, key, key_len)) {
+            return i + 1;
+        }
+    }
+    return JSON_RESULT_ERR;
+}
+
+/* an entry of an array */
+static int _json_index_entry(const JsonIndex *index, int array, int entry)
+{
+    const JsonToken *tokens = index->tokens;
+    int              i, end = array + tokens[array].skip;
+
+    if (tokens[array].type != JSARRAY) {
+        return JSON_RESULT_ERR;
+    }
+
+    for (i = array + 1; i < end; i += tokens[i].skip) {
+        if (entry-- == 0) {
+            return i;
+        }
+    }
+    return JSON_RESULT_ERR;
+}
+
+int json_index_find(const JsonIndex *index, int parent, const char *path)
+{
+    int token = parent;
+    int len, entry;
+
+    if (index == NULL || path == NULL || parent < 0 || parent >= index->count) {
+        return JSON_RESULT_ERR;
+    }
+
+    while (token >= 0 && *path != '\0') {
+        if (*path == '[') {
+            for (entry = 0, path++; *path >= '0' && *path <= '9'; path++) {
+                entry = entry * 10 + (*path - '0');
+            }
+            if (*path++ != ']') {
+                return JSON_RESULT_ERR;
+            }
+            token = _json_index_entry(index, token, entry);
+        } else {
+            len   = strcspn(path, ".[");
+            token = _json_index_member(index, token, path, len);
+            path += len;
+        }
+
+        if (*path == '.') {
+            path++;
+        }
+    }
+
+    return token;
+}
+
+char *json_index_value(const JsonIndex *index, int token, int *p_iValueLen, int *p_iValueType)
+{
+    if (index == NULL || token < 0 || token >= index->count) {
+        return NULL;
+    }
+
+    if (p_iValueLen) {
+        *p_iValueLen = index->tokens[token].len;
+    }
+    if (p_iValueType) {
+        *p_iValueType = index->tokens[token].type;
+    }
+    return (char *)index->json + index->tokens[token].start;
+}
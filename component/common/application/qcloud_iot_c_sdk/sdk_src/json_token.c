@@ -77,6 +77,28 @@ char *LITE_json_value_of(char *key, char *src)
     return ret;
 }
 
+char *LITE_json_index_value_of(const char *path, JsonIndex *index)
+{
+    char *value, *ret;
+    int   value_len;
+
+    if (index->count == JSON_RESULT_ERR) {
+        return (index->json != NULL) ? LITE_json_value_of((char *)path, (char *)index->json) : NULL;
+    }
+
+    value = json_index_value(index, json_index_find(index, 0, path), &value_len, NULL);
+    if (NULL == value) {
+        return NULL;
+    }
+    ret = HAL_Malloc(value_len + 1);
+    if (NULL == ret) {
+        return NULL;
+    }
+    memcpy(ret, value, value_len);
+    ret[value_len] = '\0';
+    return ret;
+}
+
 list_head_t *LITE_json_keys_of(char *src, char *prefix)
 {
     static LIST_HEAD(keylist);
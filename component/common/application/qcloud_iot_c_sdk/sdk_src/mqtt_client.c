@@ -47,6 +47,36 @@ static uint16_t _get_random_start_packet_id(void)
     return rand() % 65536 + 1;
 }
 
+/* seed of the reconnect jitter: the device identity (FNV-1a), so devices started together still differ */
+static uint32_t _get_reconnect_jitter_seed(MQTTInitParams *pParams)
+{
+    const char *id[2] = {pParams->product_id, pParams->device_name};
+    uint32_t    seed  = 0x811C9DC5;
+    int         i;
+
+    for (i = 0; i < 2; i++) {
+        const char *c = id[i];
+        while (*c) {
+            seed = (seed ^ (uint8_t)*c++) * 0x01000193;
+        }
+    }
+    seed ^= HAL_GetTimeMs();
+    return seed ? seed : 1;
+}
+
+/* notify the subscriber that the client goes, then free its handle */
+static int _destroy_sub_handle(void *value, void *arg)
+{
+    SubTopicHandle *sub_handle = (SubTopicHandle *)value;
+
+    if (NULL != sub_handle->sub_event_handler)
+        sub_handle->sub_event_handler(arg, MQTT_EVENT_CLIENT_DESTROY, sub_handle->handler_user_data);
+
+    HAL_Free((void *)sub_handle->topic_filter);
+    HAL_Free(sub_handle);
+    return 0;
+}
+
 // currently return a constant value
 int IOT_MQTT_GetErrCode(void)
 {
@@ -146,18 +176,7 @@ int IOT_MQTT_Destroy(void **pClient)
         set_client_conn_state(mqtt_client, NOTCONNECTED);
     }
 
-    int i = 0;
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        /* notify this event to topic subscriber */
-        if (NULL != mqtt_client->sub_handles[i].topic_filter && NULL != mqtt_client->sub_handles[i].sub_event_handler)
-            mqtt_client->sub_handles[i].sub_event_handler(mqtt_client, MQTT_EVENT_CLIENT_DESTROY,
-                    mqtt_client->sub_handles[i].handler_user_data);
-
-        if (NULL != mqtt_client->sub_handles[i].topic_filter) {
-            HAL_Free((void *)mqtt_client->sub_handles[i].topic_filter);
-            mqtt_client->sub_handles[i].topic_filter = NULL;
-        }
-    }
+    MQTTTopicTrie_clear(&mqtt_client->sub_handles, _destroy_sub_handle, mqtt_client);
 
 #ifdef MQTT_RMDUP_MSG_ENABLED
     reset_repeat_packet_id_buffer(mqtt_client);
@@ -205,6 +224,36 @@ void IOT_MQTT_Set_Yield_Thread_State(void *pClient, bool state)
     Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
     mqtt_client->yield_thread_running = state;
 }
+
+static int _mqtt_reactor_yield(void *handle, uint32_t timeout_ms)
+{
+    return IOT_MQTT_Yield(handle, timeout_ms);
+}
+
+static void _mqtt_reactor_detached(void *handle, int exit_code)
+{
+    Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)handle;
+
+    mqtt_client->yield_thread_running   = false;
+    mqtt_client->yield_thread_exit_code = exit_code;
+}
+
+static const ReactorClientOps sg_mqtt_reactor_ops = {_mqtt_reactor_yield, NULL, _mqtt_reactor_detached};
+
+int IOT_MQTT_Attach_Reactor(void *pClient, void *pReactor)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    mqtt_client->yield_thread_running = true;
+    int rc                            = IOT_Reactor_Add(pReactor, pClient, pClient, &sg_mqtt_reactor_ops);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        mqtt_client->yield_thread_running = false;
+    }
+
+    return rc;
+}
 #endif
 
 int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams)
@@ -214,6 +263,23 @@ int IOT_MQTT_Publish(void *pClient, char *topicName, PublishParams *pParams)
     return qcloud_iot_mqtt_publish(mqtt_client, topicName, pParams);
 }
 
+int IOT_MQTT_Set_Queue(void *pClient, struct MQTTQueue *queue)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    mqtt_client->queue = queue;
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_MQTT_Publish_Queued(void *pClient, char *topicName, PublishParams *pParams)
+{
+    Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
+
+    return qcloud_iot_mqtt_publish_queued(mqtt_client, topicName, pParams);
+}
+
 int IOT_MQTT_Subscribe(void *pClient, char *topicFilter, SubscribeParams *pParams)
 {
     Qcloud_IoT_Client *mqtt_client = (Qcloud_IoT_Client *)pClient;
@@ -264,14 +330,7 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
 
-    int i = 0;
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        pClient->sub_handles[i].topic_filter      = NULL;
-        pClient->sub_handles[i].message_handler   = NULL;
-        pClient->sub_handles[i].sub_event_handler = NULL;
-        pClient->sub_handles[i].qos               = QOS0;
-        pClient->sub_handles[i].handler_user_data = NULL;
-    }
+    MQTTTopicTrie_init(&pClient->sub_handles);
 
     if (pParams->command_timeout < MIN_COMMAND_TIMEOUT)
         pParams->command_timeout = MIN_COMMAND_TIMEOUT;
@@ -286,6 +345,8 @@ int qcloud_iot_mqtt_init(Qcloud_IoT_Client *pClient, MQTTInitParams *pParams)
     pClient->is_ping_outstanding          = 0;
     pClient->was_manually_disconnected    = 0;
     pClient->counter_network_disconnected = 0;
+    (void)HAL_Network_Link_Up(&pClient->link_up_count);
+    pClient->reconnect_jitter_state       = _get_reconnect_jitter_seed(pParams);
 #ifdef MULTITHREAD_ENABLED
     pClient->yield_thread_running = false;
 #endif
@@ -24,11 +24,15 @@ extern "C" {
 #include <time.h>
 
 #include "mqtt_client.h"
+#include "mqtt/MQTTPacket/MQTTCodec.h"
 #include "utils_list.h"
 
 /* remain waiting time after MQTT header is received (unit: ms) */
 #define QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS (2000)
 
+/* handlers of a topic notified by the SUBACK of a resubscribe packet */
+#define MAX_RESUBACK_HANDLERS_PER_TOPIC (4)
+
 #define MAX_NO_OF_REMAINING_LENGTH_BYTES 4
 
 /* return: 0, identical; NOT 0, different. */
@@ -445,7 +449,7 @@ int deserialize_suback_packet(uint16_t *packet_id, uint32_t max_count, uint32_t
     // read payload
     *count = 0;
     while (curdata < enddata) {
-        if (*count > max_count) {
+        if (*count >= max_count) {
             IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
         }
         grantedQoSs[(*count)++] = (QoS)mqtt_read_char(&curdata);
@@ -498,26 +502,12 @@ int serialize_packet_with_zero_payload(unsigned char *buf, size_t buf_len, Messa
     POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(serialized_len, QCLOUD_ERR_INVAL);
 
-    unsigned char  header = 0;
-    unsigned char *ptr    = buf;
-    int            rc;
+    int rc = MQTTCodec_encodeZero(buf, (int)buf_len, packetType);
 
-    /* Buffer should have at least 2 bytes for the header */
-    if (4 > buf_len) {
+    if (0 > rc) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
     }
-
-    rc = mqtt_init_packet_header(&header, packetType, QOS0, 0, 0);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        IOT_FUNC_EXIT_RC(rc);
-    }
-
-    /* write header */
-    mqtt_write_char(&ptr, header);
-
-    /* write remaining length */
-    ptr += mqtt_write_packet_rem_len(ptr, 0);
-    *serialized_len = (uint32_t)(ptr - buf);
+    *serialized_len = (uint32_t)rc;
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
@@ -590,6 +580,92 @@ static int _decode_packet_rem_len_with_net_read(Qcloud_IoT_Client *pClient, uint
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+/**
+ * @brief Drop the rest of a packet the read buffer cannot hold
+ *
+ * @param pClient        MQTT Client
+ * @param timer          timeout timer
+ * @param rem_len        bytes of the packet left in the network stack
+ */
+static void _discard_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint32_t rem_len)
+{
+    size_t  total_bytes_read = 0;
+    size_t  bytes_to_be_read;
+    size_t  read_len = 0;
+    int32_t ret_val  = 0;
+    int     timer_left_ms;
+
+    timer_left_ms = left_ms(timer);
+    if (timer_left_ms <= 0) {
+        timer_left_ms = 1;
+    }
+    timer_left_ms += QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS;
+
+    bytes_to_be_read = (rem_len >= pClient->read_buf_size) ? pClient->read_buf_size : rem_len;
+    while (total_bytes_read < rem_len && ret_val == QCLOUD_RET_SUCCESS) {
+        ret_val = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, bytes_to_be_read,
+                                              timer_left_ms, &read_len);
+        if (ret_val == QCLOUD_RET_SUCCESS) {
+            total_bytes_read += read_len;
+            if ((rem_len - total_bytes_read) >= pClient->read_buf_size) {
+                bytes_to_be_read = pClient->read_buf_size;
+            } else {
+                bytes_to_be_read = rem_len - total_bytes_read;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Read the topic and packet id of a PUBLISH larger than the read buffer
+ *
+ * Its payload is left in the network stack, _deliver_publish() reads it into
+ * the rest of the read buffer.
+ *
+ * @param pClient        MQTT Client
+ * @param timer          timeout timer
+ * @param len            length of the fixed header, already in the read buffer
+ * @param rem_len        remaining length of the PUBLISH
+ * @return QCLOUD_RET_SUCCESS for success, or err code for failure
+ */
+static int _read_publish_header(Qcloud_IoT_Client *pClient, Timer *timer, uint32_t len, uint32_t rem_len)
+{
+    IOT_FUNC_ENTRY;
+
+    size_t   read_len = 0;
+    uint32_t var_len;
+    int      rc;
+    int      timer_left_ms = left_ms(timer);
+
+    if (timer_left_ms <= 0) {
+        timer_left_ms = 1;
+    }
+    timer_left_ms += QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS;
+
+    rc = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf + len, 2, timer_left_ms, &read_len);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        IOT_FUNC_EXIT_RC(rc);
+    }
+
+    // topic name, then the packet id of QoS 1 and 2
+    var_len = 2 + ((pClient->read_buf[len] << 8) | pClient->read_buf[len + 1]);
+    if (pClient->read_buf[0] & MQTT_HEADER_QOS_MASK) {
+        var_len += 2;
+    }
+    if (var_len > rem_len || len + var_len >= pClient->read_buf_size) {
+        _discard_mqtt_packet(pClient, timer, rem_len - 2);
+        Log_e("MQTT Recv buffer not enough for the topic: %d < %d", pClient->read_buf_size, len + var_len);
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
+    }
+
+    if (var_len > 2) {
+        rc = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf + len + 2, var_len - 2,
+                                         timer_left_ms, &read_len);
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
 /**
  * @brief Read MQTT packet from network stack
  *
@@ -641,32 +717,23 @@ static int _read_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *
         IOT_FUNC_EXIT_RC(rc);
     }
 
+    // a PUBLISH too large for the read buffer is streamed, see _deliver_publish()
+    if (PUBLISH == ((pClient->read_buf[0] & MQTT_HEADER_TYPE_MASK) >> MQTT_HEADER_TYPE_SHIFT)) {
+        len += mqtt_write_packet_rem_len(pClient->read_buf + 1, rem_len);
+        if (len + rem_len > pClient->read_buf_size) {
+            rc = _read_publish_header(pClient, timer, len, rem_len);
+            if (QCLOUD_RET_SUCCESS == rc) {
+                *packet_type = PUBLISH;
+            }
+            IOT_FUNC_EXIT_RC(rc);
+        }
+        len = 1;
+    }
+
     // if read buffer is not enough to read the remaining length, discard the
     // packet
     if (rem_len >= pClient->read_buf_size) {
-        size_t  total_bytes_read = 0;
-        size_t  bytes_to_be_read;
-        int32_t ret_val = 0;
-
-        timer_left_ms = left_ms(timer);
-        if (timer_left_ms <= 0) {
-            timer_left_ms = 1;
-        }
-        timer_left_ms += QCLOUD_IOT_MQTT_MAX_REMAIN_WAIT_MS;
-
-        bytes_to_be_read = pClient->read_buf_size;
-        do {
-            ret_val = pClient->network_stack.read(&(pClient->network_stack), pClient->read_buf, bytes_to_be_read,
-                                                  timer_left_ms, &read_len);
-            if (ret_val == QCLOUD_RET_SUCCESS) {
-                total_bytes_read += read_len;
-                if ((rem_len - total_bytes_read) >= pClient->read_buf_size) {
-                    bytes_to_be_read = pClient->read_buf_size;
-                } else {
-                    bytes_to_be_read = rem_len - total_bytes_read;
-                }
-            }
-        } while (total_bytes_read < rem_len && ret_val == QCLOUD_RET_SUCCESS);
+        _discard_mqtt_packet(pClient, timer, rem_len);
 
         Log_e("MQTT Recv buffer not enough: %d < %d", pClient->read_buf_size, rem_len);
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
@@ -704,72 +771,26 @@ static int _read_mqtt_packet(Qcloud_IoT_Client *pClient, Timer *timer, uint8_t *
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
-/**
- * @brief Check if two topic equals
- *
- * @param topic_filter
- * @param topicName
- * @return
- */
-static uint8_t _is_topic_equals(char *topic_filter, char *topicName)
-{
-    return (uint8_t)(strlen(topic_filter) == strlen(topicName) && !strcmp(topic_filter, topicName));
-}
-
-/**
- * @brief Check if topic match
- *
- * assume topic filter and name is in correct format
- * # can only be at end
- * + and # can only be next to separator
- *
- * @param topic_filter  topic name filter, wildcard is supported
- * @param topicName     topic name, no wildcard
- * @param topicNameLen  length of topic name
- * @return
- */
-static uint8_t _is_topic_matched(char *topic_filter, char *topicName, uint16_t topicNameLen)
+/* take the first matching subscription with a message handler */
+static int _find_message_handler(void *value, void *arg)
 {
-    char *curf;
-    char *curn;
-    char *curn_end;
-
-    curf     = topic_filter;
-    curn     = topicName;
-    curn_end = curn + topicNameLen;
-
-    while (*curf && (curn < curn_end)) {
-        if (*curf == '+' && *curn == '/') {
-            curf++;
-            continue;
-        }
-
-        if (*curn == '/' && *curf != '/') {
-            break;
-        }
-
-        if (*curf != '+' && *curf != '#' && *curf != *curn) {
-            break;
-        }
-
-        if (*curf == '+') {
-            /* skip until we meet the next separator, or end of string */
-            char *nextpos = curn + 1;
-            while (nextpos < curn_end && *nextpos != '/') nextpos = ++curn + 1;
-        } else if (*curf == '#') {
-            /* skip until end of string */
-            curn = curn_end - 1;
-        }
+    SubTopicHandle *sub_handle = (SubTopicHandle *)value;
 
-        curf++;
-        curn++;
+    if (NULL == sub_handle->message_handler) {
+        return 0;
     }
+    *(SubTopicHandle *)arg = *sub_handle;
+    return 1;
+}
 
-    if (*curf == '\0') {
-        return (uint8_t)(curn == curn_end);
-    } else {
-        return (uint8_t)((*curf == '#') || *(curf + 1) == '#' || (*curf == '+' && *(curn - 1) == '/'));
-    }
+/* the subscription a PUBLISH on topicName goes to, one step per topic level whatever their number */
+static void _match_sub_handle(Qcloud_IoT_Client *pClient, char *topicName, uint16_t topicNameLen,
+                              SubTopicHandle *sub_handle)
+{
+    memset(sub_handle, 0, sizeof(SubTopicHandle));
+    HAL_MutexLock(pClient->lock_generic);
+    MQTTTopicTrie_match(&pClient->sub_handles, topicName, topicNameLen, _find_message_handler, sub_handle);
+    HAL_MutexUnlock(pClient->lock_generic);
 }
 
 /**
@@ -791,24 +812,16 @@ static int _deliver_message(Qcloud_IoT_Client *pClient, char *topicName, uint16_
     message->ptopic    = topicName;
     message->topic_len = (size_t)topicNameLen;
 
-    uint32_t i;
-    HAL_MutexLock(pClient->lock_generic);
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((pClient->sub_handles[i].topic_filter != NULL) &&
-            (_is_topic_equals(topicName, (char *)pClient->sub_handles[i].topic_filter) ||
-             _is_topic_matched((char *)pClient->sub_handles[i].topic_filter, topicName, topicNameLen))) {
-            HAL_MutexUnlock(pClient->lock_generic);
-            if (pClient->sub_handles[i].message_handler != NULL) {
-                pClient->sub_handles[i].message_handler(pClient, message, pClient->sub_handles[i].handler_user_data);
-                IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
-            }
-            HAL_MutexLock(pClient->lock_generic);
-        }
+    SubTopicHandle sub_handle;
+    _match_sub_handle(pClient, topicName, topicNameLen, &sub_handle);
+
+    if (NULL != sub_handle.message_handler) {
+        sub_handle.message_handler(pClient, message, sub_handle.handler_user_data);
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
     }
 
     /* Message handler not found for topic */
     /* May be we do not care  change FAILURE  use SUCCESS*/
-    HAL_MutexUnlock(pClient->lock_generic);
 
     Log_d("no matching any topic, call default handle function");
 
@@ -822,6 +835,69 @@ static int _deliver_message(Qcloud_IoT_Client *pClient, char *topicName, uint16_
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+/**
+ * @brief deliver a PUBLISH, a read buffer at a time when it did not fit in
+ *
+ * _read_mqtt_packet() left the payload of such a PUBLISH in the network stack,
+ * it is read into the rest of the read buffer and given to the user callback
+ * in pieces, see payload_offset and payload_total of MQTTMessage. Only a
+ * subscription with payload_streaming set gets the pieces, for the others
+ * the message is read and discarded as before.
+ *
+ * @param pClient
+ * @param topicName
+ * @param message
+ * @param deliver        0 to only drain the payload of a repeated message
+ * @return
+ */
+static int _deliver_publish(Qcloud_IoT_Client *pClient, char *topicName, uint16_t topicNameLen, MQTTMessage *message,
+                            int deliver)
+{
+    IOT_FUNC_ENTRY;
+
+    unsigned char *chunk    = (unsigned char *)message->payload;
+    size_t         room     = pClient->read_buf + pClient->read_buf_size - chunk;
+    size_t         read_len = 0;
+    int            rc       = QCLOUD_RET_SUCCESS;
+
+    message->payload_offset = 0;
+    message->payload_total  = message->payload_len;
+    if (message->payload_total <= room) {
+        IOT_FUNC_EXIT_RC(deliver ? _deliver_message(pClient, topicName, topicNameLen, message) : QCLOUD_RET_SUCCESS);
+    }
+
+    if (deliver) {
+        SubTopicHandle sub_handle;
+        _match_sub_handle(pClient, topicName, topicNameLen, &sub_handle);
+        if (NULL == sub_handle.message_handler || !sub_handle.payload_streaming) {
+            Log_e("MQTT Recv buffer not enough: %u < %u, message on %.*s discarded", (unsigned)pClient->read_buf_size,
+                  (unsigned)message->payload_total, topicNameLen, topicName);
+            deliver = 0;
+        }
+    }
+
+    while (message->payload_offset < message->payload_total) {
+        message->payload_len = message->payload_total - message->payload_offset;
+        if (message->payload_len > room) {
+            message->payload_len = room;
+        }
+        rc = pClient->network_stack.read(&(pClient->network_stack), chunk, message->payload_len,
+                                         pClient->command_timeout_ms, &read_len);
+        if (QCLOUD_RET_SUCCESS != rc) {
+            /* the rest of the payload is still on the way, the connection is out of step */
+            Log_e("read payload failed at %u of %u, rc: %d", (unsigned)message->payload_offset,
+                  (unsigned)message->payload_total, rc);
+            IOT_FUNC_EXIT_RC(QCLOUD_ERR_TCP_READ_FAIL);
+        }
+        if (deliver) {
+            rc = _deliver_message(pClient, topicName, topicNameLen, message);
+        }
+        message->payload_offset += message->payload_len;
+    }
+
+    IOT_FUNC_EXIT_RC(rc);
+}
+
 /**
  * @brief remove node signed with msgId from publish ACK wait list
  *
@@ -860,6 +936,9 @@ static int _mask_pubInfo_from(Qcloud_IoT_Client *c, uint16_t msgId)
             }
 
             if (repubInfo->msg_id == msgId) {
+                if (repubInfo->queued && NULL != c->queue && MQTT_NODE_STATE_INVALID != repubInfo->node_state) {
+                    MQTTQueue_done(c->queue, msgId);
+                }
                 repubInfo->node_state = MQTT_NODE_STATE_INVALID; /* set as invalid node */
             }
         }
@@ -949,6 +1028,117 @@ static int _handle_puback_packet(Qcloud_IoT_Client *pClient, Timer *timer)
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
+/**
+ * @brief handle the SUBACK of a packet of qcloud_iot_mqtt_resubscribe
+ *
+ * Such a packet waits without a handler of its own, the handlers of each of its topics get
+ * the return code of that topic.
+ *
+ * @return false when packet_id is not the one of a resubscribe packet
+ */
+static bool _handle_resuback_packet(Qcloud_IoT_Client *pClient, uint16_t packet_id, QoS *grantedQoSs, uint32_t count)
+{
+    unsigned char *packet = NULL;
+    unsigned char *curdata, *enddata;
+    uint32_t       len = 0, rem_len = 0, rem_len_bytes = 0;
+    uint32_t       i, j, n;
+    uint16_t       topic_len;
+    bool           found = false, sub_nack = false;
+    char           topic[MAX_SIZE_OF_CLOUD_TOPIC + 1];
+    SubTopicHandle handles[MAX_RESUBACK_HANDLERS_PER_TOPIC];
+    SubTopicHandle *stored;
+    MQTTEventType  event;
+
+    HAL_MutexLock(pClient->lock_list_sub);
+    if (pClient->list_sub_wait_ack->len) {
+        ListIterator *    iter;
+        ListNode *        node     = NULL;
+        QcloudIotSubInfo *sub_info = NULL;
+
+        if (NULL != (iter = list_iterator_new(pClient->list_sub_wait_ack, LIST_TAIL))) {
+            while (NULL != (node = list_iterator_next(iter))) {
+                sub_info = (QcloudIotSubInfo *)node->val;
+                if (NULL == sub_info || sub_info->msg_id != packet_id || SUBSCRIBE != sub_info->type ||
+                    MQTT_NODE_STATE_INVALID == sub_info->node_state || NULL != sub_info->handler.topic_filter) {
+                    continue;
+                }
+
+                // the topics are read from the packet sent
+                if (NULL != (packet = HAL_Malloc(sub_info->len))) {
+                    memcpy(packet, sub_info->buf, sub_info->len);
+                    len = sub_info->len;
+                }
+                sub_info->node_state = MQTT_NODE_STATE_INVALID; /* mark as invalid node */
+                found                = true;
+                break;
+            }
+            list_iterator_destroy(iter);
+        }
+    }
+    HAL_MutexUnlock(pClient->lock_list_sub);
+
+    if (!found) {
+        return false;
+    }
+
+    // fixed header, remaining length and packet id, then each topic filter and its QoS
+    if (NULL == packet || len < 2 ||
+        QCLOUD_RET_SUCCESS != mqtt_read_packet_rem_len_form_buf(packet + 1, &rem_len, &rem_len_bytes)) {
+        Log_e("resubscribe packet lost, packet_id: %u", packet_id);
+        HAL_Free(packet);
+        return true;
+    }
+    curdata = packet + 1 + rem_len_bytes + 2;
+    enddata = packet + len;
+
+    for (i = 0; i < count && curdata + 2 <= enddata; i++) {
+        topic_len = mqtt_read_uint16_t(&curdata);
+        if (topic_len > MAX_SIZE_OF_CLOUD_TOPIC || curdata + topic_len + 1 > enddata) {
+            break;
+        }
+        memcpy(topic, curdata, topic_len);
+        topic[topic_len] = '\0';
+        curdata += topic_len + 1;
+
+        // check return code in SUBACK packet: 0x00(QOS0, SUCCESS),0x01(QOS1,
+        // SUCCESS),0x02(QOS2, SUCCESS),0x80(Failure)
+        if (grantedQoSs[i] == 0x80) {
+            Log_e("MQTT resubscribe failed, packet_id: %u topic: %s", packet_id, topic);
+            event    = MQTT_EVENT_SUBCRIBE_NACK;
+            sub_nack = true;
+        } else {
+            event = MQTT_EVENT_SUBCRIBE_SUCCESS;
+        }
+
+        // the handlers are called out of the lock, as for a single topic SUBACK
+        n      = 0;
+        stored = NULL;
+        HAL_MutexLock(pClient->lock_generic);
+        while (n < MAX_RESUBACK_HANDLERS_PER_TOPIC &&
+               (stored = MQTTTopicTrie_next(&pClient->sub_handles, topic, stored)) != NULL) {
+            handles[n++] = *stored;
+        }
+        HAL_MutexUnlock(pClient->lock_generic);
+
+        /* notify this event to topic subscriber */
+        for (j = 0; j < n; j++) {
+            if (NULL != handles[j].sub_event_handler)
+                handles[j].sub_event_handler(pClient, event, handles[j].handler_user_data);
+        }
+    }
+    HAL_Free(packet);
+
+    /* notify this event to user callback */
+    if (NULL != pClient->event_handle.h_fp) {
+        MQTTEventMsg msg;
+        msg.event_type = sub_nack ? MQTT_EVENT_SUBCRIBE_NACK : MQTT_EVENT_SUBCRIBE_SUCCESS;
+        msg.msg        = (void *)(uintptr_t)packet_id;
+        pClient->event_handle.h_fp(pClient, pClient->event_handle.context, &msg);
+    }
+
+    return true;
+}
+
 static int _handle_suback_packet(Qcloud_IoT_Client *pClient, Timer *timer, QoS qos)
 {
     IOT_FUNC_ENTRY;
@@ -956,18 +1146,23 @@ static int _handle_suback_packet(Qcloud_IoT_Client *pClient, Timer *timer, QoS q
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(timer, QCLOUD_ERR_INVAL);
 
-    uint32_t count         = 0;
-    uint16_t packet_id     = 0;
-    QoS      grantedQoS[3] = {QOS0, QOS0, QOS0};
+    uint32_t count     = 0;
+    uint16_t packet_id = 0;
+    QoS      grantedQoS[MAX_TOPICS_PER_SUBSCRIBE];
     int      rc;
     bool     sub_nack = false;
 
-    rc = deserialize_suback_packet(&packet_id, 1, &count, grantedQoS, pClient->read_buf, pClient->read_buf_size);
+    rc = deserialize_suback_packet(&packet_id, MAX_TOPICS_PER_SUBSCRIBE, &count, grantedQoS, pClient->read_buf,
+                                   pClient->read_buf_size);
     if (QCLOUD_RET_SUCCESS != rc) {
         IOT_FUNC_EXIT_RC(rc);
     }
 
-    int flag_dup = 0, i_free = -1;
+    if (_handle_resuback_packet(pClient, packet_id, grantedQoS, count)) {
+        IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    }
+
+    int flag_dup = 0;
     // check return code in SUBACK packet: 0x00(QOS0, SUCCESS),0x01(QOS1,
     // SUCCESS),0x02(QOS2, SUCCESS),0x80(Failure)
     if (grantedQoS[0] == 0x80) {
@@ -1004,40 +1199,31 @@ static int _handle_suback_packet(Qcloud_IoT_Client *pClient, Timer *timer, QoS q
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_SUB);
     }
 
-    int i;
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((NULL != pClient->sub_handles[i].topic_filter)) {
-            if (0 == _check_handle_is_identical(&pClient->sub_handles[i], &sub_handle)) {
-                flag_dup = 1;
-                Log_w("Identical topic found: %s", sub_handle.topic_filter);
-                if (pClient->sub_handles[i].handler_user_data != sub_handle.handler_user_data) {
-                    Log_w("Update handler_user_data %p -> %p!", pClient->sub_handles[i].handler_user_data,
-                          sub_handle.handler_user_data);
-                    pClient->sub_handles[i].handler_user_data = sub_handle.handler_user_data;
-                }
-                HAL_Free((void *)sub_handle.topic_filter);
-                sub_handle.topic_filter = NULL;
-                break;
-            }
-        } else {
-            if (-1 == i_free) {
-                i_free = i; /* record available element */
+    SubTopicHandle *stored = NULL;
+    while ((stored = MQTTTopicTrie_next(&pClient->sub_handles, sub_handle.topic_filter, stored)) != NULL) {
+        if (0 == _check_handle_is_identical(stored, &sub_handle)) {
+            flag_dup = 1;
+            Log_w("Identical topic found: %s", sub_handle.topic_filter);
+            if (stored->handler_user_data != sub_handle.handler_user_data) {
+                Log_w("Update handler_user_data %p -> %p!", stored->handler_user_data, sub_handle.handler_user_data);
+                stored->handler_user_data = sub_handle.handler_user_data;
             }
+            HAL_Free((void *)sub_handle.topic_filter);
+            sub_handle.topic_filter = NULL;
+            break;
         }
     }
 
     if (0 == flag_dup) {
-        if (-1 == i_free) {
+        stored = HAL_Malloc(sizeof(SubTopicHandle));
+        if (NULL == stored || 0 != MQTTTopicTrie_add(&pClient->sub_handles, sub_handle.topic_filter, stored)) {
             Log_e("NO more @sub_handles space!");
             HAL_MutexUnlock(pClient->lock_generic);
+            HAL_Free(stored);
+            HAL_Free((void *)sub_handle.topic_filter);
             IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-        } else {
-            pClient->sub_handles[i_free].topic_filter      = sub_handle.topic_filter;
-            pClient->sub_handles[i_free].message_handler   = sub_handle.message_handler;
-            pClient->sub_handles[i_free].sub_event_handler = sub_handle.sub_event_handler;
-            pClient->sub_handles[i_free].qos               = sub_handle.qos;
-            pClient->sub_handles[i_free].handler_user_data = sub_handle.handler_user_data;
         }
+        *stored = sub_handle;
     }
 
     HAL_MutexUnlock(pClient->lock_generic);
@@ -1158,7 +1344,7 @@ static int _handle_publish_packet(Qcloud_IoT_Client *pClient, Timer *timer)
     memcpy(fix_topic, topic_name, topic_len);
 
     if (QOS0 == msg.qos) {
-        rc = _deliver_message(pClient, fix_topic, topic_len, &msg);
+        rc = _deliver_publish(pClient, fix_topic, topic_len, &msg, 1);
         if (QCLOUD_RET_SUCCESS != rc)
             IOT_FUNC_EXIT_RC(rc);
 
@@ -1170,14 +1356,14 @@ static int _handle_publish_packet(Qcloud_IoT_Client *pClient, Timer *timer)
         // check if packet_id has been received before
         int repeat_id = _get_packet_id_in_repeat_buf(pClient, msg.id);
 
-        // deliver to msg callback
-        if (repeat_id < 0) {
+        // deliver to msg callback, a repeated one is only drained
+        rc = _deliver_publish(pClient, fix_topic, topic_len, &msg, repeat_id < 0);
+#else
+        rc = _deliver_publish(pClient, fix_topic, topic_len, &msg, 1);
 #endif
-            rc = _deliver_message(pClient, fix_topic, topic_len, &msg);
-            if (QCLOUD_RET_SUCCESS != rc)
-                IOT_FUNC_EXIT_RC(rc);
+        if (QCLOUD_RET_SUCCESS != rc)
+            IOT_FUNC_EXIT_RC(rc);
 #ifdef MQTT_RMDUP_MSG_ENABLED
-        }
         _add_packet_id_to_repeat_buf(pClient, msg.id);
 #endif
     }
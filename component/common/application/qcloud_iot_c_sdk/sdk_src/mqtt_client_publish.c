@@ -22,60 +22,10 @@ extern "C" {
 #include <string.h>
 
 #include "mqtt_client.h"
+#include "mqtt/MQTTPacket/MQTTCodec.h"
 #include "utils_list.h"
 
-/**
- * @param mqttstring the MQTTString structure into which the data is to be read
- * @param pptr pointer to the output buffer - incremented by the number of bytes
- * used & returned
- * @param enddata pointer to the end of the data: do not read beyond
- * @return SUCCESS if successful, FAILURE if not
- */
-static int _read_string_with_len(char **string, uint16_t *stringLen, unsigned char **pptr, unsigned char *enddata)
-{
-    int rc = QCLOUD_ERR_FAILURE;
-
-    /* the first two bytes are the length of the string */
-    /* enough length to read the integer? */
-    if (enddata - (*pptr) > 1) {
-        *stringLen = mqtt_read_uint16_t(pptr); /* increments pptr to point past length */
-
-        if (*stringLen > QCLOUD_IOT_MQTT_RX_BUF_LEN) {
-            Log_e("stringLen exceed QCLOUD_IOT_MQTT_RX_BUF_LEN");
-            IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-        }
-
-        if (&(*pptr)[*stringLen] <= enddata) {
-            *string = (char *)*pptr;
-            *pptr += *stringLen;
-            rc = QCLOUD_RET_SUCCESS;
-        }
-    }
-
-    return rc;
-}
-
-/**
- * Determines the length of the MQTT publish packet that would be produced using
- * the supplied parameters
- * @param qos the MQTT QoS of the publish (packetid is omitted for QoS 0)
- * @param topicName the topic name to be used in the publish
- * @param payload_len the length of the payload to be sent
- * @return the length of buffer needed to contain the serialized version of the
- * packet
- */
-static uint32_t _get_publish_packet_len(uint8_t qos, char *topicName, size_t payload_len)
-{
-    size_t len = 0;
-
-    len += 2 + strlen(topicName) + payload_len;
-    if (qos > 0) {
-        len += 2; /* packetid */
-    }
-    return (uint32_t)len;
-}
-
-static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, ListNode **node)
+static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, int len, unsigned short msgId, uint8_t queued, ListNode **node)
 {
     IOT_FUNC_ENTRY;
 
@@ -106,6 +56,7 @@ static int _mask_push_pubInfo_to(Qcloud_IoT_Client *c, int len, unsigned short m
 
     repubInfo->node_state = MQTT_NODE_STATE_NORMANL;
     repubInfo->msg_id     = msgId;
+    repubInfo->queued     = queued;
     repubInfo->len        = len;
     InitTimer(&repubInfo->pub_start_time);
     countdown_ms(&repubInfo->pub_start_time, c->command_timeout_ms);
@@ -154,53 +105,16 @@ int deserialize_publish_packet(uint8_t *dup, QoS *qos, uint8_t *retained, uint16
     POINTER_SANITY_CHECK(retained, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(packet_id, QCLOUD_ERR_INVAL);
 
-    unsigned char  header, type = 0;
-    unsigned char *curdata = buf;
-    unsigned char *enddata = NULL;
-    int            rc;
-    uint32_t       decodedLen   = 0;
-    uint32_t       readBytesLen = 0;
-
-    /* Publish header size is at least four bytes.
-     * Fixed header is two bytes.
-     * Variable header size depends on QoS And Topic Name.
-     * QoS level 0 doesn't have a message identifier (0 - 2 bytes)
-     * Topic Name length fields decide size of topic name field (at least 2 bytes)
-     * MQTT v3.1.1 Specification 3.3.1 */
-    if (4 > buf_len) {
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
-    }
+    int qos_value = 0, topic_len = 0, len = 0;
+    int rc = MQTTCodec_decodePublish(buf, (int)buf_len, dup, &qos_value, retained, packet_id, topicName, &topic_len,
+                                     payload, &len);
 
-    header    = mqtt_read_char(&curdata);
-    type      = (header & MQTT_HEADER_TYPE_MASK) >> MQTT_HEADER_TYPE_SHIFT;
-    *dup      = (header & MQTT_HEADER_DUP_MASK) >> MQTT_HEADER_DUP_SHIFT;
-    *qos      = (QoS)((header & MQTT_HEADER_QOS_MASK) >> MQTT_HEADER_QOS_SHIFT);
-    *retained = header & MQTT_HEADER_RETAIN_MASK;
-
-    if (PUBLISH != type) {
+    if (0 > rc) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
     }
-
-    /* read remaining length */
-    rc = mqtt_read_packet_rem_len_form_buf(curdata, &decodedLen, &readBytesLen);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        IOT_FUNC_EXIT_RC(rc);
-    }
-    curdata += (readBytesLen);
-    enddata = curdata + decodedLen;
-
-    /* do we have enough data to read the protocol version byte? */
-    if (QCLOUD_RET_SUCCESS != _read_string_with_len(topicName, topicNameLen, &curdata, enddata) ||
-        (0 > (enddata - curdata))) {
-        IOT_FUNC_EXIT_RC(QCLOUD_ERR_FAILURE);
-    }
-
-    if (QOS0 != *qos) {
-        *packet_id = mqtt_read_uint16_t(&curdata);
-    }
-
-    *payload_len = (size_t)(enddata - curdata);
-    *payload     = curdata;
+    *qos          = (QoS)qos_value;
+    *topicNameLen = (uint16_t)topic_len;
+    *payload_len  = (size_t)len;
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
@@ -221,25 +135,12 @@ int serialize_pub_ack_packet(unsigned char *buf, size_t buf_len, MessageTypes pa
     POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(serialized_len, QCLOUD_ERR_INVAL);
 
-    unsigned char  header     = 0;
-    unsigned char *ptr        = buf;
-    QoS            requestQoS = (PUBREL == packet_type) ? QOS1 : QOS0;  // refer to MQTT spec 3.6.1
-    int            rc         = mqtt_init_packet_header(&header, packet_type, requestQoS, dup, 0);
+    int rc = MQTTCodec_encodeAck(buf, (int)buf_len, packet_type, dup, packet_id);
 
-    /* Minimum byte length required by ACK headers is
-     * 2 for fixed and 2 for variable part */
-    if (4 > buf_len) {
+    if (0 > rc) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
     }
-
-    if (QCLOUD_RET_SUCCESS != rc) {
-        IOT_FUNC_EXIT_RC(rc);
-    }
-    mqtt_write_char(&ptr, header); /* write header */
-
-    ptr += mqtt_write_packet_rem_len(ptr, 2); /* write remaining length */
-    mqtt_write_uint_16(&ptr, packet_id);
-    *serialized_len = (uint32_t)(ptr - buf);
+    *serialized_len = (uint32_t)rc;
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
@@ -254,54 +155,36 @@ int serialize_pub_ack_packet(unsigned char *buf, size_t buf_len, MessageTypes pa
  * @param retained integer - the MQTT retained flag
  * @param packet_id integer - the MQTT packet identifier
  * @param topicName MQTTString - the MQTT topic in the publish
+ * @param topic_len the length of topicName, measured once by the caller
  * @param payload byte buffer - the MQTT publish payload
  * @param payload_len integer - the length of the MQTT payload
  * @return the length of the serialized data.  <= 0 indicates error
  */
 static int _serialize_publish_packet(unsigned char *buf, size_t buf_len, uint8_t dup, QoS qos, uint8_t retained,
-                                     uint16_t packet_id, char *topicName, unsigned char *payload, size_t payload_len,
-                                     uint32_t *serialized_len)
+                                     uint16_t packet_id, char *topicName, size_t topic_len, unsigned char *payload,
+                                     size_t payload_len, uint32_t *serialized_len)
 {
     IOT_FUNC_ENTRY;
     POINTER_SANITY_CHECK(buf, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(serialized_len, QCLOUD_ERR_INVAL);
     POINTER_SANITY_CHECK(payload, QCLOUD_ERR_INVAL);
 
-    unsigned char *ptr     = buf;
-    unsigned char  header  = 0;
-    uint32_t       rem_len = 0;
-    int            rc;
+    int rc = MQTTCodec_encodePublish(buf, (int)buf_len, dup, qos, retained, packet_id, topicName, (int)topic_len, payload,
+                                     (int)payload_len);
 
-    rem_len = _get_publish_packet_len(qos, topicName, payload_len);
-    if (get_mqtt_packet_len(rem_len) > buf_len) {
+    if (MQTTCODEC_BUFFER_TOO_SHORT == rc) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_BUF_TOO_SHORT);
+    } else if (0 > rc) {
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
     }
-
-    rc = mqtt_init_packet_header(&header, PUBLISH, qos, dup, retained);
-    if (QCLOUD_RET_SUCCESS != rc) {
-        IOT_FUNC_EXIT_RC(rc);
-    }
-
-    mqtt_write_char(&ptr, header); /* write header */
-
-    ptr += mqtt_write_packet_rem_len(ptr, rem_len); /* write remaining length */
-    ;
-
-    mqtt_write_utf8_string(&ptr, topicName); /* Variable Header: Topic Name */
-
-    if (qos > 0) {
-        mqtt_write_uint_16(&ptr, packet_id); /* Variable Header: Topic Name */
-    }
-
-    memcpy(ptr, payload, payload_len);
-    ptr += payload_len;
-
-    *serialized_len = (uint32_t)(ptr - buf);
+    *serialized_len = (uint32_t)rc;
 
     IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
 }
 
-int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams)
+/* resend_id: packet id of a queued message sent before a reboot, 0 for a new one */
+static int _mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams, uint16_t resend_id,
+                         uint8_t queued)
 {
     IOT_FUNC_ENTRY;
 
@@ -334,7 +217,7 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
 
     HAL_MutexLock(pClient->lock_write_buf);
     if (pParams->qos == QOS1) {
-        pParams->id = get_next_packet_id(pClient);
+        pParams->id = resend_id ? resend_id : get_next_packet_id(pClient);
         if (IOT_Log_Get_Level() <= eLOG_DEBUG) {
             Log_d("publish topic seq=%d|topicName=%s|payload=%s", pParams->id, topicName, (char *)pParams->payload);
         } else {
@@ -348,16 +231,17 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
         }
     }
 
-    rc = _serialize_publish_packet(pClient->write_buf, pClient->write_buf_size, 0, pParams->qos, pParams->retained,
-                                   pParams->id, topicName, (unsigned char *)pParams->payload, pParams->payload_len,
-                                   &len);
+    rc = _serialize_publish_packet(pClient->write_buf, pClient->write_buf_size, resend_id ? 1 : 0, pParams->qos,
+                                   pParams->retained,
+                                   pParams->id, topicName, topicLen, (unsigned char *)pParams->payload,
+                                   pParams->payload_len, &len);
     if (QCLOUD_RET_SUCCESS != rc) {
         HAL_MutexUnlock(pClient->lock_write_buf);
         IOT_FUNC_EXIT_RC(rc);
     }
 
     if (pParams->qos > QOS0) {
-        rc = _mask_push_pubInfo_to(pClient, len, pParams->id, &node);
+        rc = _mask_push_pubInfo_to(pClient, len, pParams->id, queued, &node);
         if (QCLOUD_RET_SUCCESS != rc) {
             Log_e("push publish into to pubInfolist failed!");
             HAL_MutexUnlock(pClient->lock_write_buf);
@@ -383,6 +267,104 @@ int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, Publish
     IOT_FUNC_EXIT_RC(pParams->id);
 }
 
+int qcloud_iot_mqtt_publish(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams)
+{
+    return _mqtt_publish(pClient, topicName, pParams, 0, 0);
+}
+
+/* a queued message in the repub list (one cut short by a reboot still owns its id), and how many there are */
+static int _queued_in_flight(Qcloud_IoT_Client *pClient, uint16_t msg_id, bool *id_taken)
+{
+    ListIterator *    iter;
+    ListNode *        node;
+    QcloudIotPubInfo *repubInfo;
+    int               count = 0;
+
+    *id_taken = false;
+    HAL_MutexLock(pClient->lock_list_pub);
+    if (NULL != (iter = list_iterator_new(pClient->list_pub_wait_ack, LIST_TAIL))) {
+        while (NULL != (node = list_iterator_next(iter))) {
+            repubInfo = (QcloudIotPubInfo *)node->val;
+            if (NULL == repubInfo || MQTT_NODE_STATE_INVALID == repubInfo->node_state) {
+                continue;
+            }
+            if (repubInfo->msg_id == msg_id) {
+                *id_taken = true;
+            }
+            count += repubInfo->queued;
+        }
+        list_iterator_destroy(iter);
+    }
+    HAL_MutexUnlock(pClient->lock_list_pub);
+    return count;
+}
+
+int qcloud_iot_mqtt_flush_queue(Qcloud_IoT_Client *pClient)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+
+    MQTTQueue *    q = pClient->queue;
+    MQTTQueueEntry e;
+    PublishParams  params;
+    char *         topic;
+    bool           id_taken;
+    int            rc = QCLOUD_RET_SUCCESS;
+
+    while (q != NULL && get_client_conn_state(pClient) && MQTTQueue_next(q, &e) == 0) {
+        if (_queued_in_flight(pClient, e.id, &id_taken) >= MAX_QUEUE_INFLIGHT_NUM || (e.id != 0 && id_taken)) {
+            break;
+        }
+
+        if ((topic = (char *)HAL_Malloc(e.topiclen + 1 + e.payloadlen + 1)) == NULL) {
+            rc = QCLOUD_ERR_MALLOC;
+            break;
+        }
+        memset(&params, 0, sizeof(PublishParams));
+        params.qos         = (QoS)e.qos;
+        params.retained    = e.retained;
+        params.payload     = topic + e.topiclen + 1;
+        params.payload_len = e.payloadlen;
+        if (MQTTQueue_read(q, &e, topic, (unsigned char *)params.payload) != 0) {
+            rc = QCLOUD_ERR_FAILURE;
+        } else {
+            ((char *)params.payload)[e.payloadlen] = '\0';  // for the debug log
+            rc = _mqtt_publish(pClient, topic, &params, e.id, 1);
+        }
+        HAL_Free(topic);
+        if (rc < 0) {
+            break;
+        }
+        rc = QCLOUD_RET_SUCCESS;
+        MQTTQueue_sent(q, &e, params.id);
+    }
+    return rc;
+}
+
+int qcloud_iot_mqtt_publish_queued(Qcloud_IoT_Client *pClient, char *topicName, PublishParams *pParams)
+{
+    POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(pParams, QCLOUD_ERR_INVAL);
+    STRING_PTR_SANITY_CHECK(topicName, QCLOUD_ERR_INVAL);
+
+    if (NULL == pClient->queue) {
+        return qcloud_iot_mqtt_publish(pClient, topicName, pParams);
+    }
+    if (pParams->qos == QOS2) {
+        Log_e("QoS2 is not supported currently");
+        return QCLOUD_ERR_MQTT_QOS_NOT_SUPPORT;
+    }
+    if (strlen(topicName) > MAX_SIZE_OF_CLOUD_TOPIC) {
+        return QCLOUD_ERR_MAX_TOPIC_LENGTH;
+    }
+    if (MQTTQueue_push(pClient->queue, topicName, pParams->qos, pParams->retained, pParams->payload,
+                       (int)pParams->payload_len) != 0) {
+        Log_e("outbound queue refused message on %s", topicName);
+        return QCLOUD_ERR_FAILURE;
+    }
+    (void)qcloud_iot_mqtt_flush_queue(pClient);
+    return QCLOUD_RET_SUCCESS;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,7 +37,7 @@ static uint32_t _get_subscribe_packet_rem_len(uint32_t count, char **topicFilter
     size_t len = 2; /* packetid */
 
     for (i = 0; i < count; ++i) {
-        len += 2 + strlen(*topicFilters + i) + 1; /* length + topic + req_qos */
+        len += 2 + strlen(topicFilters[i]) + 1; /* length + topic + req_qos */
     }
 
     return (uint32_t)len;
@@ -90,7 +90,7 @@ static int _serialize_subscribe_packet(unsigned char *buf, size_t buf_len, uint8
     mqtt_write_uint_16(&ptr, packet_id);
     // payload
     for (i = 0; i < count; ++i) {
-        mqtt_write_utf8_string(&ptr, *topicFilters + i);
+        mqtt_write_utf8_string(&ptr, topicFilters[i]);
         mqtt_write_char(&ptr, (unsigned char)requestedQoSs[i]);
     }
 
@@ -161,6 +161,7 @@ int qcloud_iot_mqtt_subscribe(Qcloud_IoT_Client *pClient, char *topicFilter, Sub
     sub_handle.sub_event_handler = pParams->on_sub_event_handler;
     sub_handle.qos               = pParams->qos;
     sub_handle.handler_user_data = pParams->user_data;
+    sub_handle.payload_streaming = pParams->payload_streaming;
 
     rc = push_sub_info_to(pClient, len, (unsigned int)packet_id, SUBSCRIBE, &sub_handle, &node);
     if (QCLOUD_RET_SUCCESS != rc) {
@@ -187,16 +188,101 @@ int qcloud_iot_mqtt_subscribe(Qcloud_IoT_Client *pClient, char *topicFilter, Sub
     IOT_FUNC_EXIT_RC(packet_id);
 }
 
+typedef struct {
+    Qcloud_IoT_Client *client;
+    int                rc;
+    uint32_t           count;                              // topic filters in the packet being built
+    uint32_t           rem_len;                            // its remaining length so far
+    char *             topics[MAX_TOPICS_PER_SUBSCRIBE];
+    QoS                qos[MAX_TOPICS_PER_SUBSCRIBE];
+} _ResubscribeCtx;
+
+/**
+ * @brief send the SUBSCRIBE packet of the topic filters gathered in ctx
+ *
+ * The packet waits for its SUBACK without a handler of its own: the handlers of its topics are
+ * still in sub_handles, the SUBACK finds them from the topics of the packet.
+ */
+static int _send_resubscribe_packet(_ResubscribeCtx *ctx)
+{
+    Qcloud_IoT_Client *pClient = ctx->client;
+    Timer              timer;
+    uint32_t           len       = 0;
+    uint16_t           packet_id = 0;
+    ListNode *         node      = NULL;
+    SubTopicHandle     sub_handle;
+    int                rc;
+
+    InitTimer(&timer);
+    countdown_ms(&timer, pClient->command_timeout_ms);
+
+    HAL_MutexLock(pClient->lock_write_buf);
+    packet_id = get_next_packet_id(pClient);
+    Log_d("resubscribe %u topics|packet_id=%d", ctx->count, packet_id);
+
+    rc = _serialize_subscribe_packet(pClient->write_buf, pClient->write_buf_size, 0, packet_id, ctx->count, ctx->topics,
+                                     ctx->qos, &len);
+    if (QCLOUD_RET_SUCCESS == rc) {
+        memset(&sub_handle, 0, sizeof(SubTopicHandle));
+        rc = push_sub_info_to(pClient, len, (unsigned int)packet_id, SUBSCRIBE, &sub_handle, &node);
+    }
+
+    if (QCLOUD_RET_SUCCESS == rc) {
+        rc = send_mqtt_packet(pClient, len, &timer);
+        if (QCLOUD_RET_SUCCESS != rc) {
+            HAL_MutexLock(pClient->lock_list_sub);
+            list_remove(pClient->list_sub_wait_ack, node);
+            HAL_MutexUnlock(pClient->lock_list_sub);
+        }
+    }
+    HAL_MutexUnlock(pClient->lock_write_buf);
+
+    ctx->count   = 0;
+    ctx->rem_len = 2; /* packetid */
+    return rc;
+}
+
+static int _resubscribe_handle(void *value, void *arg)
+{
+    SubTopicHandle * sub_handle = (SubTopicHandle *)value;
+    _ResubscribeCtx *ctx        = (_ResubscribeCtx *)arg;
+    SubTopicHandle * other      = NULL;
+    QoS              qos        = sub_handle->qos;
+    uint32_t         len        = 2 + strlen(sub_handle->topic_filter) + 1; /* length + topic + req_qos */
+
+    // a topic filter goes once, at the highest QoS of its handlers
+    if (MQTTTopicTrie_next(&ctx->client->sub_handles, sub_handle->topic_filter, NULL) != sub_handle) {
+        return 0;
+    }
+    while ((other = MQTTTopicTrie_next(&ctx->client->sub_handles, sub_handle->topic_filter, other)) != NULL) {
+        if (other->qos > qos) {
+            qos = other->qos;
+        }
+    }
+
+    if (ctx->count == MAX_TOPICS_PER_SUBSCRIBE ||
+        (ctx->count > 0 && get_mqtt_packet_len(ctx->rem_len + len) > ctx->client->write_buf_size)) {
+        ctx->rc = _send_resubscribe_packet(ctx);
+        if (ctx->rc != QCLOUD_RET_SUCCESS) {
+            Log_e("resubscribe failed %d, topic: %s", ctx->rc, sub_handle->topic_filter);
+            return 1;
+        }
+    }
+
+    ctx->topics[ctx->count] = (char *)sub_handle->topic_filter;
+    ctx->qos[ctx->count]    = qos;
+    ctx->count++;
+    ctx->rem_len += len;
+    return 0;
+}
+
 int qcloud_iot_mqtt_resubscribe(Qcloud_IoT_Client *pClient)
 {
     IOT_FUNC_ENTRY;
-    int rc;
 
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
 
-    uint32_t        itr   = 0;
-    char *          topic = NULL;
-    SubscribeParams temp_param;
+    _ResubscribeCtx ctx;
 
     if (NULL == pClient) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_INVAL);
@@ -206,24 +292,22 @@ int qcloud_iot_mqtt_resubscribe(Qcloud_IoT_Client *pClient)
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_NO_CONN);
     }
 
-    for (itr = 0; itr < MAX_MESSAGE_HANDLERS; itr++) {
-        topic = (char *)pClient->sub_handles[itr].topic_filter;
-        if (topic == NULL) {
-            continue;
-        }
-        temp_param.on_message_handler   = pClient->sub_handles[itr].message_handler;
-        temp_param.on_sub_event_handler = pClient->sub_handles[itr].sub_event_handler;
-        temp_param.qos                  = pClient->sub_handles[itr].qos;
-        temp_param.user_data            = pClient->sub_handles[itr].handler_user_data;
-
-        rc = qcloud_iot_mqtt_subscribe(pClient, topic, &temp_param);
-        if (rc < 0) {
-            Log_e("resubscribe failed %d, topic: %s", rc, topic);
-            IOT_FUNC_EXIT_RC(rc);
+    // all the topic filters in as few SUBSCRIBE packets as the write buffer allows, one round trip
+    ctx.client  = pClient;
+    ctx.rc      = QCLOUD_RET_SUCCESS;
+    ctx.count   = 0;
+    ctx.rem_len = 2; /* packetid */
+    HAL_MutexLock(pClient->lock_generic);
+    MQTTTopicTrie_foreach(&pClient->sub_handles, _resubscribe_handle, &ctx);
+    if (ctx.rc == QCLOUD_RET_SUCCESS && ctx.count > 0) {
+        ctx.rc = _send_resubscribe_packet(&ctx);
+        if (ctx.rc != QCLOUD_RET_SUCCESS) {
+            Log_e("resubscribe failed %d", ctx.rc);
         }
     }
+    HAL_MutexUnlock(pClient->lock_generic);
 
-    IOT_FUNC_EXIT_RC(QCLOUD_RET_SUCCESS);
+    IOT_FUNC_EXIT_RC(ctx.rc < 0 ? ctx.rc : QCLOUD_RET_SUCCESS);
 }
 
 bool qcloud_iot_mqtt_is_sub_ready(Qcloud_IoT_Client *pClient, char *topicFilter)
@@ -237,18 +321,15 @@ bool qcloud_iot_mqtt_is_sub_ready(Qcloud_IoT_Client *pClient, char *topicFilter)
         return false;
     }
 
-    int i = 0;
-    HAL_MutexLock(pClient->lock_generic);
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((pClient->sub_handles[i].topic_filter != NULL &&
-             !strcmp(pClient->sub_handles[i].topic_filter, topicFilter)) ||
-            strstr(topicFilter, "/#") != NULL || strstr(topicFilter, "/+") != NULL) {
-            HAL_MutexUnlock(pClient->lock_generic);
-            return true;
-        }
+    if (strstr(topicFilter, "/#") != NULL || strstr(topicFilter, "/+") != NULL) {
+        return true;
     }
+
+    bool ready;
+    HAL_MutexLock(pClient->lock_generic);
+    ready = (MQTTTopicTrie_next(&pClient->sub_handles, topicFilter, NULL) != NULL);
     HAL_MutexUnlock(pClient->lock_generic);
-    return false;
+    return ready;
 }
 
 #ifdef __cplusplus
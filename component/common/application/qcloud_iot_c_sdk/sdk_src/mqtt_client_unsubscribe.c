@@ -102,12 +102,13 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
     STRING_PTR_SANITY_CHECK(topicFilter, QCLOUD_ERR_INVAL);
 
-    int      i = 0;
     Timer    timer;
     uint32_t len          = 0;
     uint16_t packet_id    = 0;
     bool     suber_exists = false;
 
+    SubTopicHandle *stored;
+
     ListNode *node = NULL;
 
     size_t topicLen = strlen(topicFilter);
@@ -115,25 +116,20 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MAX_TOPIC_LENGTH);
     }
 
-    /* Remove from message handler array */
+    /* Remove from message handlers, every one of this topic filter */
     HAL_MutexLock(pClient->lock_generic);
-    for (i = 0; i < MAX_MESSAGE_HANDLERS; ++i) {
-        if ((pClient->sub_handles[i].topic_filter != NULL &&
-             !strcmp(pClient->sub_handles[i].topic_filter, topicFilter)) ||
-            strstr(topicFilter, "/#") != NULL || strstr(topicFilter, "/+") != NULL) {
-            /* notify this event to topic subscriber */
-            if (NULL != pClient->sub_handles[i].sub_event_handler)
-                pClient->sub_handles[i].sub_event_handler(pClient, MQTT_EVENT_UNSUBSCRIBE,
-                                                          pClient->sub_handles[i].handler_user_data);
-
-            /* Free the topic filter malloced in qcloud_iot_mqtt_subscribe */
-            HAL_Free((void *)pClient->sub_handles[i].topic_filter);
-            pClient->sub_handles[i].topic_filter = NULL;
-
-            /* We don't want to break here, if the same topic is registered
-             * with 2 callbacks. Unlikely scenario */
-            suber_exists = true;
-        }
+    while ((stored = MQTTTopicTrie_next(&pClient->sub_handles, topicFilter, NULL)) != NULL) {
+        /* notify this event to topic subscriber */
+        if (NULL != stored->sub_event_handler)
+            stored->sub_event_handler(pClient, MQTT_EVENT_UNSUBSCRIBE, stored->handler_user_data);
+
+        MQTTTopicTrie_remove(&pClient->sub_handles, topicFilter, stored);
+
+        /* Free the topic filter malloced in qcloud_iot_mqtt_subscribe */
+        HAL_Free((void *)stored->topic_filter);
+        HAL_Free(stored);
+
+        suber_exists = true;
     }
     HAL_MutexUnlock(pClient->lock_generic);
 
@@ -173,6 +169,7 @@ int qcloud_iot_mqtt_unsubscribe(Qcloud_IoT_Client *pClient, char *topicFilter)
     sub_handle.sub_event_handler = NULL;
     sub_handle.message_handler   = NULL;
     sub_handle.handler_user_data = NULL;
+    sub_handle.payload_streaming = 0;
 
     rc = push_sub_info_to(pClient, len, (unsigned int)packet_id, UNSUBSCRIBE, &sub_handle, &node);
     if (QCLOUD_RET_SUCCESS != rc) {
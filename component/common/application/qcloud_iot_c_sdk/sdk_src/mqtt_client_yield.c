@@ -29,6 +29,19 @@ static uint32_t _get_random_interval(void)
     return (rand() % 100 + 100) * 10;
 }
 
+/* random in [interval / 2, interval], so devices cut off together do not come back together */
+static uint32_t _get_jittered_interval(Qcloud_IoT_Client *pClient, uint32_t interval)
+{
+    uint32_t x = pClient->reconnect_jitter_state;
+
+    /* xorshift32 on the state of this client, seeded once in qcloud_iot_mqtt_init() */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pClient->reconnect_jitter_state = x;
+    return interval / 2 + x % (interval / 2 + 1);
+}
+
 static void _iot_disconnect_callback(Qcloud_IoT_Client *pClient)
 {
     if (NULL != pClient->event_handle.h_fp) {
@@ -92,49 +105,75 @@ static int _handle_reconnect(Qcloud_IoT_Client *pClient)
 {
     IOT_FUNC_ENTRY;
 
-    int8_t isPhysicalLayerConnected = 1;
-    int    rc                       = QCLOUD_RET_MQTT_RECONNECTED;
+    int      rc;
+    uint32_t link_up_count;
 
-    // reconnect control by delay timer (increase interval exponentially )
-    if (!expired(&(pClient->reconnect_delay_timer))) {
+    // no link, no attempt: wait for it to come up, the interval does not grow meanwhile
+    if (!HAL_Network_Link_Up(&link_up_count)) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT);
     }
 
-    if (NULL != pClient->network_stack.is_connected) {
-        isPhysicalLayerConnected =
-            (int8_t)pClient->network_stack.is_connected(&(pClient->network_stack));  // always return 1
+    if (link_up_count != pClient->link_up_count) {
+        // the link came up again (e.g. after a roam), try at once from the minimal interval
+        pClient->link_up_count                   = link_up_count;
+        pClient->current_reconnect_wait_interval = MIN_RECONNECT_WAIT_INTERVAL;
+    } else if (!expired(&(pClient->reconnect_delay_timer))) {
+        // reconnect control by delay timer (increase interval exponentially, with jitter)
+        IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT);
     }
 
-    if (isPhysicalLayerConnected) {
-        rc = qcloud_iot_mqtt_attempt_reconnect(pClient);
-        if (rc == QCLOUD_RET_MQTT_RECONNECTED) {
-            Log_e("attempt to reconnect success.");
-            _reconnect_callback(pClient);
+    rc = qcloud_iot_mqtt_attempt_reconnect(pClient);
+    if (rc == QCLOUD_RET_MQTT_RECONNECTED) {
+        Log_e("attempt to reconnect success.");
+        _reconnect_callback(pClient);
 #ifdef LOG_UPLOAD
-            if (is_log_uploader_init()) {
-                int log_level;
-                if (qcloud_get_log_level(&log_level) < 0) {
-                    Log_e("client get log topic failed: %d", rc);
-                }
+        if (is_log_uploader_init()) {
+            int log_level;
+            if (qcloud_get_log_level(&log_level) < 0) {
+                Log_e("client get log topic failed: %d", rc);
             }
-#endif
-            IOT_FUNC_EXIT_RC(rc);
-        } else {
-            Log_e("attempt to reconnect failed, errCode: %d", rc);
-            rc = QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT;
         }
+#endif
+        IOT_FUNC_EXIT_RC(rc);
     }
 
+    Log_e("attempt to reconnect failed, errCode: %d", rc);
+    rc = QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT;
+
     pClient->current_reconnect_wait_interval *= 2;
 
     if (MAX_RECONNECT_WAIT_INTERVAL < pClient->current_reconnect_wait_interval) {
         IOT_FUNC_EXIT_RC(QCLOUD_ERR_MQTT_RECONNECT_TIMEOUT);
     }
-    countdown_ms(&(pClient->reconnect_delay_timer), pClient->current_reconnect_wait_interval);
+    countdown_ms(&(pClient->reconnect_delay_timer), _get_jittered_interval(pClient, pClient->current_reconnect_wait_interval));
 
     IOT_FUNC_EXIT_RC(rc);
 }
 
+/**
+ * @brief probe the connection at once when the network link came up again
+ *
+ * A roam may have broken the connection without a word from the server, the PINGREQ finds
+ * it in seconds instead of a keep alive interval.
+ *
+ * @param pClient
+ */
+static void _check_link_renewed(Qcloud_IoT_Client *pClient)
+{
+    uint32_t link_up_count;
+
+    if (!HAL_Network_Link_Up(&link_up_count) || link_up_count == pClient->link_up_count) {
+        return;
+    }
+    pClient->link_up_count = link_up_count;
+
+    HAL_MutexLock(pClient->lock_generic);
+    if (0 == pClient->is_ping_outstanding) {
+        countdown_ms(&pClient->ping_timer, 0);
+    }
+    HAL_MutexUnlock(pClient->lock_generic);
+}
+
 /**
  * @brief handle MQTT keep alive (hearbeat with server)
  *
@@ -218,6 +257,7 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
     int     rc = QCLOUD_RET_SUCCESS;
     Timer   timer;
     uint8_t packet_type;
+    int     wait_ms;
 
     POINTER_SANITY_CHECK(pClient, QCLOUD_ERR_INVAL);
     NUMBERIC_SANITY_CHECK(timeout_ms, QCLOUD_ERR_INVAL);
@@ -243,16 +283,25 @@ int qcloud_iot_mqtt_yield(Qcloud_IoT_Client *pClient, uint32_t timeout_ms)
                 break;
             }
             rc = _handle_reconnect(pClient);
+            if (rc == QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT && (wait_ms = left_ms(&timer)) > 0) {
+                // leave the CPU to the Wi-Fi and DHCP tasks bringing the link back
+                HAL_SleepMs(Min(wait_ms, 50));
+            }
 
             continue;
         }
 
+        _check_link_renewed(pClient);
+
         rc = cycle_for_read(pClient, &timer, &packet_type, QOS0);
 
         if (rc == QCLOUD_RET_SUCCESS) {
             /* check list of wait publish ACK to remove node that is ACKED or timeout */
             qcloud_iot_mqtt_pub_info_proc(pClient);
 
+            /* send what waits in the outbound queue, reconnected or acked */
+            qcloud_iot_mqtt_flush_queue(pClient);
+
             /* check list of wait subscribe(or unsubscribe) ACK to remove node that is ACKED or timeout */
             qcloud_iot_mqtt_sub_info_proc(pClient);
 
@@ -300,6 +349,57 @@ int qcloud_iot_mqtt_yield_mt(Qcloud_IoT_Client *mqtt_client, uint32_t timeout_ms
     return qcloud_iot_mqtt_yield(mqtt_client, timeout_ms);
 }
 
+/**
+ * @brief time left before the client has work to do that no packet brings: a reconnect attempt, a PINGREQ, an ack
+ * waited for too long
+ *
+ * @param pClient    handle to MQTT client
+ *
+ * @return time in ms, 0 when due, MAX_RECONNECT_WAIT_INTERVAL when nothing is waited for
+ */
+uint32_t qcloud_iot_mqtt_next_event_ms(Qcloud_IoT_Client *pClient)
+{
+    int           next = MAX_RECONNECT_WAIT_INTERVAL;
+    ListIterator *iter;
+    ListNode *    node;
+
+    if (!get_client_conn_state(pClient)) {
+        if (pClient->was_manually_disconnected == 1) {
+            return 0;  // yield gives the reason at once
+        }
+        if (pClient->options.auto_connect_enable == 0 || !HAL_Network_Link_Up(NULL)) {
+            return next;  // nothing to do before the link comes up
+        }
+        return Max(left_ms(&pClient->reconnect_delay_timer), 0);
+    }
+
+    if (pClient->options.keep_alive_interval != 0) {
+        next = Min(next, left_ms(&pClient->ping_timer));
+    }
+
+    HAL_MutexLock(pClient->lock_list_pub);
+    if (pClient->list_pub_wait_ack->len && NULL != (iter = list_iterator_new(pClient->list_pub_wait_ack, LIST_TAIL))) {
+        while (NULL != (node = list_iterator_next(iter))) {
+            QcloudIotPubInfo *repubInfo = (QcloudIotPubInfo *)node->val;
+            next = (NULL == repubInfo) ? 0 : Min(next, left_ms(&repubInfo->pub_start_time));
+        }
+        list_iterator_destroy(iter);
+    }
+    HAL_MutexUnlock(pClient->lock_list_pub);
+
+    HAL_MutexLock(pClient->lock_list_sub);
+    if (pClient->list_sub_wait_ack->len && NULL != (iter = list_iterator_new(pClient->list_sub_wait_ack, LIST_TAIL))) {
+        while (NULL != (node = list_iterator_next(iter))) {
+            QcloudIotSubInfo *sub_info = (QcloudIotSubInfo *)node->val;
+            next = (NULL == sub_info) ? 0 : Min(next, left_ms(&sub_info->sub_start_time));
+        }
+        list_iterator_destroy(iter);
+    }
+    HAL_MutexUnlock(pClient->lock_list_sub);
+
+    return Max(next, 0);
+}
+
 /**
  * @brief puback waiting timeout process
  *
@@ -369,6 +469,11 @@ int qcloud_iot_mqtt_pub_info_proc(Qcloud_IoT_Client *pClient)
             countdown_ms(&repubInfo->pub_start_time, pClient->command_timeout_ms);
             HAL_MutexLock(pClient->lock_list_pub);
 
+            /* a queued message stays queued, to go again with its packet id */
+            if (repubInfo->queued && NULL != pClient->queue) {
+                MQTTQueue_rewind(pClient->queue);
+            }
+
             /* notify timeout event */
             if (NULL != pClient->event_handle.h_fp) {
                 MQTTEventMsg msg;
@@ -111,6 +111,30 @@ int network_init(Network *pNetwork)
     return pNetwork->init(pNetwork);
 }
 
+int network_get_socket(Network *pNetwork, size_t *pending)
+{
+    *pending = 0;
+
+    if (!pNetwork->is_connected(pNetwork)) {
+        return -1;
+    }
+
+    switch (pNetwork->type) {
+#ifndef AT_TCP_ENABLED
+        case NETWORK_TCP:
+            return HAL_TCP_Socket(pNetwork->handle);
+#endif
+
+#ifndef AUTH_WITH_NOTLS
+        case NETWORK_TLS:
+            return HAL_TLS_Socket(pNetwork->handle, pending);
+#endif
+
+        default:
+            return -1;
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -55,7 +55,8 @@ typedef struct {
     void *ch_signal; /* channel handle of signal exchanged with OTA server */
     void *ch_fetch;  /* channel handle of download */
 
-    int err; /* last error code */
+    int  err;            /* last error code */
+    bool fetch_to_flash; /* fetched by IOT_OTA_FetchToFlash, its progress kept by HAL_OTA_Flash_* */
 
     short current_signal_type;
 
@@ -513,6 +514,12 @@ int IOT_OTA_IsFetchFinish(void *handle)
 }
 
 int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_ms)
+{
+    return qcloud_ota_fetch_yield(handle, buf, buf_len, timeout_ms, true);
+}
+
+/* IOT_OTA_FetchYield, the MD5 left to the caller when update_md5 is false */
+int qcloud_ota_fetch_yield(void *handle, char *buf, uint32_t buf_len, uint32_t timeout_ms, bool update_md5)
 {
     int           ret;
     OTA_Struct_t *h_ota = (OTA_Struct_t *)handle;
@@ -525,6 +532,7 @@ int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeo
         h_ota->err = IOT_OTA_ERR_INVALID_STATE;
         return IOT_OTA_ERR_INVALID_STATE;
     }
+    h_ota->fetch_to_flash = !update_md5;
 
     ret = qcloud_ofc_fetch(h_ota->ch_fetch, buf, buf_len, timeout_ms);
     if (ret < 0) {
@@ -567,7 +575,9 @@ int IOT_OTA_FetchYield(void *handle, char *buf, uint32_t buf_len, uint32_t timeo
         h_ota->state = IOT_OTAS_FETCHED;
     }
 
-    qcloud_otalib_md5_update(h_ota->md5, buf, ret);
+    if (update_md5) {
+        qcloud_otalib_md5_update(h_ota->md5, buf, ret);
+    }
 
     return ret;
 }
@@ -633,6 +643,10 @@ int IOT_OTA_Ioctl(void *handle, IOT_OTA_CmdType type, void *buf, size_t buf_len)
                     *((uint32_t *)buf) = 1;
                 } else {
                     *((uint32_t *)buf) = 0;
+                    // a retry of IOT_OTA_FetchToFlash must not resume the corrupt image in flash
+                    if (h_ota->fetch_to_flash) {
+                        HAL_OTA_Flash_Clear_Progress();
+                    }
                     // report MD5 inconsistent
                     IOT_OTA_ReportUpgradeResult(h_ota, h_ota->version, IOT_OTAR_MD5_NOT_MATCH);
                 }
@@ -27,39 +27,25 @@ extern "C" {
 #include <stdio.h>
 #include <string.h>
 
+#include "json_parser.h"
 #include "lite-utils.h"
 #include "ota_client.h"
 #include "qcloud_iot_export.h"
 #include "qcloud_iot_import.h"
 #include "utils_md5.h"
 
+/* Max number of JSON tokens indexed in an OTA message */
+#define OTA_JSON_TOKENS (24)
+
 /* Get the specific @key value, and copy to @dest */
 /* 0, successful; -1, failed */
-static int _qcloud_otalib_get_firmware_fixlen_para(const char *json_doc, const char *key, char *dest, size_t dest_len)
+static int _qcloud_otalib_get_firmware_fixlen_para(JsonIndex *index, const char *key, char *dest, size_t dest_len)
 {
     IOT_FUNC_ENTRY;
 
     int ret = QCLOUD_RET_SUCCESS;
 
-    char *key_bak = HAL_Malloc(strlen(key) + 1);
-    if (key_bak == NULL) {
-        Log_e("not enough memory for malloc key");
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
-    }
-
-    char *json_doc_bak = HAL_Malloc(strlen(json_doc) + 1);
-    if (json_doc_bak == NULL) {
-        Log_e("not enough memory for malloc json");
-        HAL_Free(key_bak);
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
-    }
-
-    strcpy(key_bak, key);
-    strcpy(json_doc_bak, json_doc);
-
-    char *value = LITE_json_value_of(key_bak, json_doc_bak);
+    char *value = LITE_json_index_value_of(key, index);
     if (value == NULL) {
         Log_e("Not '%s' key in json doc of OTA", key);
         ret = IOT_OTA_ERR_FAIL;
@@ -76,60 +62,24 @@ static int _qcloud_otalib_get_firmware_fixlen_para(const char *json_doc, const c
         HAL_Free(value);
     }
 
-    if (key_bak != NULL) {
-        HAL_Free(key_bak);
-    }
-    if (json_doc_bak != NULL) {
-        HAL_Free(json_doc_bak);
-    }
-
     IOT_FUNC_EXIT_RC(ret);
 }
 
 /* Get variant length parameter of firmware, and copy to @dest */
 /* 0, successful; -1, failed */
-static int _qcloud_otalib_get_firmware_varlen_para(const char *json_doc, const char *key, char **dest)
+static int _qcloud_otalib_get_firmware_varlen_para(JsonIndex *index, const char *key, char **dest)
 {
-#define OTA_FIRMWARE_JSON_VALUE_MAX_LENGTH (64)
-
     IOT_FUNC_ENTRY;
 
     int ret = QCLOUD_RET_SUCCESS;
 
-    char *key_bak = HAL_Malloc(strlen(key) + 1);
-    if (key_bak == NULL) {
-        Log_e("not enough memory for malloc key");
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
-    }
-
-    char *json_doc_bak = HAL_Malloc(strlen(json_doc) + 1);
-    if (json_doc_bak == NULL) {
-        Log_e("not enough memory for malloc json");
-        HAL_Free(key_bak);
-        ret = IOT_OTA_ERR_FAIL;
-        IOT_FUNC_EXIT_RC(ret);
-    }
-
-    strcpy(key_bak, key);
-    strcpy(json_doc_bak, json_doc);
-
-    *dest = LITE_json_value_of(key_bak, json_doc_bak);
+    *dest = LITE_json_index_value_of(key, index);
     if (*dest == NULL) {
-        Log_e("Not '%s' key in json '%s' doc of OTA", key_bak, json_doc_bak);
+        Log_e("Not '%s' key in json '%s' doc of OTA", key, index->json);
         ret = IOT_OTA_ERR_FAIL;
     }
 
-    if (key_bak != NULL) {
-        HAL_Free(key_bak);
-    }
-    if (json_doc_bak != NULL) {
-        HAL_Free(json_doc_bak);
-    }
-
     IOT_FUNC_EXIT_RC(ret);
-
-#undef OTA_FIRMWARE_JSON_VALUE_MAX_LENGTH
 }
 
 void *qcloud_otalib_md5_init(void)
@@ -172,16 +122,24 @@ void qcloud_otalib_md5_deinit(void *md5)
 
 int qcloud_otalib_get_firmware_type(const char *json, char **type)
 {
-    return _qcloud_otalib_get_firmware_varlen_para(json, TYPE_FIELD, type);
+    JsonToken tokens[OTA_JSON_TOKENS];
+    JsonIndex index;
+
+    json_index_build(&index, json, strlen(json), tokens, OTA_JSON_TOKENS);
+    return _qcloud_otalib_get_firmware_varlen_para(&index, TYPE_FIELD, type);
 }
 
 int qcloud_otalib_get_report_version_result(const char *json)
 {
     IOT_FUNC_ENTRY;
 
-    char *result_code = NULL;
+    char *    result_code = NULL;
+    JsonToken tokens[OTA_JSON_TOKENS];
+    JsonIndex index;
+
+    json_index_build(&index, json, strlen(json), tokens, OTA_JSON_TOKENS);
 
-    int rc = _qcloud_otalib_get_firmware_varlen_para(json, RESULT_FIELD, &result_code);
+    int rc = _qcloud_otalib_get_firmware_varlen_para(&index, RESULT_FIELD, &result_code);
     if (rc != QCLOUD_RET_SUCCESS || strcmp(result_code, "0") != 0) {
         if (NULL != result_code)
             HAL_Free(result_code);
@@ -199,34 +157,39 @@ int qcloud_otalib_get_params(const char *json, char **type, char **url, char **v
 
     IOT_FUNC_ENTRY;
 
-    char file_size_str[OTA_FILESIZE_STR_LEN + 1] = {0};
+    char      file_size_str[OTA_FILESIZE_STR_LEN + 1] = {0};
+    JsonToken tokens[OTA_JSON_TOKENS];
+    JsonIndex index;
+
+    // one pass over the message for the lookups of all the parameters
+    json_index_build(&index, json, strlen(json), tokens, OTA_JSON_TOKENS);
 
     /* get type */
-    if (0 != _qcloud_otalib_get_firmware_varlen_para(json, TYPE_FIELD, type)) {
+    if (0 != _qcloud_otalib_get_firmware_varlen_para(&index, TYPE_FIELD, type)) {
         Log_e("get value of type key failed");
         IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
 
     /* get version */
-    if (0 != _qcloud_otalib_get_firmware_varlen_para(json, VERSION_FIELD, version)) {
+    if (0 != _qcloud_otalib_get_firmware_varlen_para(&index, VERSION_FIELD, version)) {
         Log_e("get value of version key failed");
         IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
 
     /* get URL */
-    if (0 != _qcloud_otalib_get_firmware_varlen_para(json, URL_FIELD, url)) {
+    if (0 != _qcloud_otalib_get_firmware_varlen_para(&index, URL_FIELD, url)) {
         Log_e("get value of url key failed");
         IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
 
     /* get md5 */
-    if (0 != _qcloud_otalib_get_firmware_fixlen_para(json, MD5_FIELD, md5, 32)) {
+    if (0 != _qcloud_otalib_get_firmware_fixlen_para(&index, MD5_FIELD, md5, 32)) {
         Log_e("get value of md5 key failed");
         IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
 
     /* get file size */
-    if (0 != _qcloud_otalib_get_firmware_fixlen_para(json, FILESIZE_FIELD, file_size_str, OTA_FILESIZE_STR_LEN)) {
+    if (0 != _qcloud_otalib_get_firmware_fixlen_para(&index, FILESIZE_FIELD, file_size_str, OTA_FILESIZE_STR_LEN)) {
         Log_e("get value of size key failed");
         IOT_FUNC_EXIT_RC(IOT_OTA_ERR_FAIL);
     }
@@ -0,0 +1,342 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "ota_client.h"
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_param_check.h"
+
+/*
+ * Firmware download into flash in stages linked by a ring of blocks: the calling task receives HTTP chunks into
+ * free blocks, the writer hashes each full block, then programs it. Sectors are erased just ahead of the write
+ * position, the writer erasing the next one whenever it has nothing to write (up to OTA_PIPELINE_ERASE_AHEAD),
+ * so most erases happen while waiting for the network. With MULTITHREAD_ENABLED the writer is a task of its own
+ * and the stages overlap, otherwise the calling task writes each block after receiving it.
+ *
+ * Progress is kept by the HAL every OTA_PIPELINE_CHECKPOINT bytes, at a sector boundary. A download of the same
+ * firmware (same MD5) resumes there with an HTTP Range request, even after a reboot: what is in flash is hashed
+ * again, and the sector at the resume point is erased again, as a reset may have cut its programming.
+ */
+
+#define OTA_PIPELINE_BLOCK_SIZE  (4096)
+#define OTA_PIPELINE_BLOCKS      (4)
+#define OTA_PIPELINE_CHECKPOINT  (16 * 1024)
+#define OTA_PIPELINE_ERASE_AHEAD (32 * 1024) /* how far past the write position sectors are erased while idle */
+#define OTA_PIPELINE_STACK_SIZE  (1024)
+#define OTA_PIPELINE_PRIORITY    (1)
+#define OTA_PIPELINE_WAIT_MS     (1)
+
+typedef struct {
+    uint32_t len;
+    char *   data;
+} OTAPipelineBlock;
+
+typedef struct {
+    void *           h_ota;
+    char             md5sum[33];
+    uint32_t         size;     // of the firmware
+    uint32_t         sector;   // erase unit of the flash
+    uint32_t         written;  // bytes programmed
+    uint32_t         erased;   // bytes erased from the start, a multiple of sector
+    uint32_t         saved;    // progress kept
+    void *           lock;
+    OTAPipelineBlock blocks[OTA_PIPELINE_BLOCKS];
+    uint32_t         head;  // blocks received, the receiver moves it
+    uint32_t         tail;  // blocks written, the writer moves it
+    volatile bool    received_all;
+    volatile int     error;
+#ifdef MULTITHREAD_ENABLED
+    volatile bool writer_exited;
+    ThreadParams  writer_params;
+#endif
+} OTAPipeline;
+
+static uint32_t _blocks_pending(OTAPipeline *pipe)
+{
+    uint32_t pending;
+
+    HAL_MutexLock(pipe->lock);
+    pending = pipe->head - pipe->tail;
+    HAL_MutexUnlock(pipe->lock);
+    return pending;
+}
+
+static int _erase_next(OTAPipeline *pipe)
+{
+    int rc = HAL_OTA_Flash_Erase(pipe->erased);
+
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("erase OTA flash at %u failed: %d", pipe->erased, rc);
+        return rc;
+    }
+    pipe->erased += pipe->sector;
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _checkpoint(OTAPipeline *pipe)
+{
+    uint32_t offset = pipe->written - pipe->written % pipe->sector;
+
+    // a whole firmware is not kept as progress: resuming it must fetch something to leave the fetching state
+    if (offset > pipe->saved && offset < pipe->size) {
+        if (HAL_OTA_Flash_Save_Progress(pipe->md5sum, offset) == QCLOUD_RET_SUCCESS) {
+            pipe->saved = offset;
+        }
+    }
+}
+
+/**
+ * @brief one step of the writer: hash and program the oldest received block, or erase ahead when there is none
+ *
+ * @return true when it did something
+ */
+static bool _writer_step(OTAPipeline *pipe)
+{
+    OTAPipelineBlock *block;
+    int               rc;
+
+    if (pipe->error != QCLOUD_RET_SUCCESS) {
+        return false;
+    }
+
+    if (_blocks_pending(pipe) == 0) {
+        if (pipe->erased >= pipe->size || pipe->erased >= pipe->written + OTA_PIPELINE_ERASE_AHEAD) {
+            return false;
+        }
+        pipe->error = _erase_next(pipe);
+        return true;
+    }
+
+    block = &pipe->blocks[pipe->tail % OTA_PIPELINE_BLOCKS];
+    IOT_OTA_UpdateClientMd5(pipe->h_ota, block->data, block->len);
+
+    while (pipe->erased < pipe->written + block->len) {
+        if ((pipe->error = _erase_next(pipe)) != QCLOUD_RET_SUCCESS) {
+            return false;
+        }
+    }
+
+    rc = HAL_OTA_Flash_Write(pipe->written, block->data, block->len);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("write OTA flash at %u failed: %d", pipe->written, rc);
+        pipe->error = rc;
+        return false;
+    }
+    pipe->written += block->len;
+
+    HAL_MutexLock(pipe->lock);
+    pipe->tail++;
+    HAL_MutexUnlock(pipe->lock);
+
+    if (pipe->written - pipe->saved >= OTA_PIPELINE_CHECKPOINT) {
+        _checkpoint(pipe);
+    }
+    return true;
+}
+
+#ifdef MULTITHREAD_ENABLED
+static void _ota_pipeline_writer(void *arg)
+{
+    OTAPipeline *pipe = (OTAPipeline *)arg;
+
+    while (pipe->error == QCLOUD_RET_SUCCESS) {
+        if (!_writer_step(pipe)) {
+            if (pipe->received_all && _blocks_pending(pipe) == 0) {
+                break;
+            }
+            HAL_SleepMs(OTA_PIPELINE_WAIT_MS);
+        }
+    }
+
+    _checkpoint(pipe);
+    pipe->writer_exited = true;
+}
+#endif
+
+/* hash what a previous download left in flash */
+static int _rehash_flash(OTAPipeline *pipe, uint32_t offset)
+{
+    uint32_t pos, len;
+    int      rc;
+
+    if ((rc = IOT_OTA_ResetClientMD5(pipe->h_ota)) != QCLOUD_RET_SUCCESS) {
+        return rc;
+    }
+
+    for (pos = 0; pos < offset; pos += len) {
+        len = Min(offset - pos, OTA_PIPELINE_BLOCK_SIZE);
+        if ((rc = HAL_OTA_Flash_Read(pos, pipe->blocks[0].data, len)) != QCLOUD_RET_SUCCESS) {
+            return rc;
+        }
+        IOT_OTA_UpdateClientMd5(pipe->h_ota, pipe->blocks[0].data, len);
+    }
+    return QCLOUD_RET_SUCCESS;
+}
+
+static int _receive(OTAPipeline *pipe, uint32_t timeout_s)
+{
+    OTAPipelineBlock *block;
+    int               len;
+
+    while (!IOT_OTA_IsFetchFinish(pipe->h_ota) && pipe->error == QCLOUD_RET_SUCCESS) {
+        // a free block: written by the writer task, or here without one
+        while (_blocks_pending(pipe) == OTA_PIPELINE_BLOCKS && pipe->error == QCLOUD_RET_SUCCESS) {
+#ifdef MULTITHREAD_ENABLED
+            HAL_SleepMs(OTA_PIPELINE_WAIT_MS);
+#else
+            _writer_step(pipe);
+#endif
+        }
+        if (pipe->error != QCLOUD_RET_SUCCESS) {
+            break;
+        }
+
+        block = &pipe->blocks[pipe->head % OTA_PIPELINE_BLOCKS];
+        len   = qcloud_ota_fetch_yield(pipe->h_ota, block->data, OTA_PIPELINE_BLOCK_SIZE, timeout_s, false);
+        if (len < 0) {
+            Log_e("download fail rc=%d", len);
+            return len;
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        block->len = len;
+        HAL_MutexLock(pipe->lock);
+        pipe->head++;
+        HAL_MutexUnlock(pipe->lock);
+
+#ifndef MULTITHREAD_ENABLED
+        while (_blocks_pending(pipe) > 0 && _writer_step(pipe)) {
+        }
+#endif
+    }
+
+    return pipe->error;
+}
+
+int IOT_OTA_FetchToFlash(void *handle, uint32_t timeout_s)
+{
+    POINTER_SANITY_CHECK(handle, IOT_OTA_ERR_INVALID_PARAM);
+
+    OTAPipeline *pipe;
+    char *       data;
+    uint32_t     offset;
+    int          rc, i;
+
+    if (!IOT_OTA_IsFetching(handle)) {
+        return IOT_OTA_ERR_INVALID_STATE;
+    }
+
+    if ((pipe = (OTAPipeline *)HAL_Malloc(sizeof(OTAPipeline))) == NULL ||
+        (data = (char *)HAL_Malloc(OTA_PIPELINE_BLOCK_SIZE * OTA_PIPELINE_BLOCKS)) == NULL) {
+        Log_e("memory not enough to malloc OTA pipeline");
+        HAL_Free(pipe);
+        return IOT_OTA_ERR_NOMEM;
+    }
+    memset(pipe, 0, sizeof(OTAPipeline));
+    for (i = 0; i < OTA_PIPELINE_BLOCKS; i++) {
+        pipe->blocks[i].data = data + i * OTA_PIPELINE_BLOCK_SIZE;
+    }
+    pipe->h_ota = handle;
+
+    if ((pipe->lock = HAL_MutexCreate()) == NULL) {
+        rc = IOT_OTA_ERR_NOMEM;
+        goto exit;
+    }
+
+    IOT_OTA_Ioctl(handle, IOT_OTAG_FILE_SIZE, &pipe->size, 4);
+    IOT_OTA_Ioctl(handle, IOT_OTAG_MD5SUM, pipe->md5sum, sizeof(pipe->md5sum));
+
+    rc = HAL_OTA_Flash_Open(pipe->size);
+    if (rc <= 0) {
+        rc = IOT_OTA_ERR_FAIL;
+        goto exit;
+    }
+    pipe->sector = rc;
+
+    // resume a download of the same firmware, from the start of the sector it stopped in
+    offset = HAL_OTA_Flash_Load_Progress(pipe->md5sum);
+    offset = (offset < pipe->size) ? offset - offset % pipe->sector : 0;
+    if (offset > 0 && _rehash_flash(pipe, offset) != QCLOUD_RET_SUCCESS) {
+        Log_w("rehash of %u bytes in flash failed, download from start", offset);
+        offset = 0;
+    }
+    if (offset == 0 && (rc = IOT_OTA_ResetClientMD5(handle)) != QCLOUD_RET_SUCCESS) {
+        goto exit;
+    }
+    pipe->written = pipe->erased = pipe->saved = offset;
+    Log_i("download FW of %u bytes into flash from offset %u", pipe->size, offset);
+
+    rc = IOT_OTA_StartDownload(handle, offset, pipe->size);
+    if (rc != QCLOUD_RET_SUCCESS) {
+        Log_e("OTA download start err,rc:%d", rc);
+        goto exit;
+    }
+
+#ifdef MULTITHREAD_ENABLED
+    pipe->writer_params.thread_func = _ota_pipeline_writer;
+    pipe->writer_params.thread_name = "ota_writer_thread";
+    pipe->writer_params.user_arg    = pipe;
+    pipe->writer_params.stack_size  = OTA_PIPELINE_STACK_SIZE;
+    pipe->writer_params.priority    = OTA_PIPELINE_PRIORITY;
+    if (HAL_ThreadCreate(&pipe->writer_params) != QCLOUD_RET_SUCCESS) {
+        Log_e("create ota_writer_thread fail");
+        rc = QCLOUD_ERR_FAILURE;
+        goto exit;
+    }
+
+    rc                 = _receive(pipe, timeout_s);
+    pipe->received_all = true;
+    while (!pipe->writer_exited) {
+        HAL_SleepMs(10);
+    }
+#else
+    rc = _receive(pipe, timeout_s);
+    _checkpoint(pipe);
+#endif
+
+    if (rc == QCLOUD_RET_SUCCESS) {
+        rc = pipe->error;
+    }
+    if (rc == QCLOUD_RET_SUCCESS && pipe->written != pipe->size) {
+        Log_e("firmware of %u bytes, %u written", pipe->size, pipe->written);
+        rc = IOT_OTA_ERR_FETCH_FAILED;
+    }
+
+exit:
+    if (pipe->lock != NULL) {
+        HAL_MutexDestroy(pipe->lock);
+    }
+    HAL_Free(data);
+    HAL_Free(pipe);
+
+    return rc;
+}
+
+#ifdef __cplusplus
+}
+#endif
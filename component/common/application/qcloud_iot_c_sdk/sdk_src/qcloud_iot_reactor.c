@@ -0,0 +1,561 @@
+/*
+ * Tencent is pleased to support the open source community by making IoT Hub
+ available.
+ * Copyright (C) 2018-2020 THL A29 Limited, a Tencent company. All rights
+ reserved.
+
+ * Licensed under the MIT License (the "License"); you may not use this file
+ except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+
+ * Unless required by applicable law or agreed to in writing, software
+ distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ KIND,
+ * either express or implied. See the License for the specific language
+ governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "mqtt_client.h"
+#include "qcloud_iot_export.h"
+#include "qcloud_iot_import.h"
+#include "utils_param_check.h"
+
+#ifdef MULTITHREAD_ENABLED
+
+#define REACTOR_POLL_MS    (200)    // due time of a connected client whose socket cannot be waited on (AT, UDP)
+#define REACTOR_STEP_MS    (1)      // yield timeout of a client, what there is to read is there already
+#define REACTOR_MAX_DUE_MS (60000)  // due times are kept below half the range of the ms clock
+#define REACTOR_MAX_EVENTS (REACTOR_MAX_CLIENTS + REACTOR_MAX_TIMERS)
+
+/* event ids: client slot i is id i, timer slot i is id REACTOR_MAX_CLIENTS + i */
+#define REACTOR_TIMER_ID(i) (REACTOR_MAX_CLIENTS + (i))
+
+typedef struct {
+    void *                  handle;  // NULL for a free slot
+    Qcloud_IoT_Client *     mqtt;
+    const ReactorClientOps *ops;
+    bool                    removing;  // detached once no run is in progress
+    int                     exit_code;
+} ReactorClient;
+
+typedef struct {
+    ReactorTimerFunc func;  // NULL for a free slot
+    void *           context;
+    uint32_t         period_ms;
+} ReactorTimer;
+
+typedef struct {
+    uint32_t due;
+    int      id;
+} ReactorEvent;
+
+typedef struct {
+    void *        lock;
+    ReactorClient clients[REACTOR_MAX_CLIENTS];
+    ReactorTimer  timers[REACTOR_MAX_TIMERS];
+    ReactorEvent  heap[REACTOR_MAX_EVENTS];  // min-heap of due times
+    int           pos[REACTOR_MAX_EVENTS];   // index in heap of each id, -1 when not scheduled
+    int           size;
+    uint32_t      link_up_count;
+    bool          in_run;
+    volatile bool thread_running;
+    volatile bool thread_exited;
+    ThreadParams  thread_params;  // the thread keeps a pointer to it
+} Qcloud_IoT_Reactor;
+
+/* due times are compared as distances, the ms clock wraps */
+static bool _before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static void _heap_place(Qcloud_IoT_Reactor *pReactor, int i, ReactorEvent ev)
+{
+    pReactor->heap[i]    = ev;
+    pReactor->pos[ev.id] = i;
+}
+
+static void _heap_sift(Qcloud_IoT_Reactor *pReactor, int i)
+{
+    ReactorEvent ev = pReactor->heap[i];
+    int          child;
+
+    while (i > 0 && _before(ev.due, pReactor->heap[(i - 1) / 2].due)) {
+        _heap_place(pReactor, i, pReactor->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+
+    while ((child = 2 * i + 1) < pReactor->size) {
+        if (child + 1 < pReactor->size && _before(pReactor->heap[child + 1].due, pReactor->heap[child].due)) {
+            child++;
+        }
+        if (!_before(pReactor->heap[child].due, ev.due)) {
+            break;
+        }
+        _heap_place(pReactor, i, pReactor->heap[child]);
+        i = child;
+    }
+
+    _heap_place(pReactor, i, ev);
+}
+
+/* lock held */
+static void _schedule(Qcloud_IoT_Reactor *pReactor, int id, uint32_t due)
+{
+    int i = pReactor->pos[id];
+
+    if (i < 0) {
+        i = pReactor->size++;
+    }
+    pReactor->heap[i].due = due;
+    pReactor->heap[i].id  = id;
+    _heap_sift(pReactor, i);
+}
+
+/* lock held */
+static void _unschedule(Qcloud_IoT_Reactor *pReactor, int id)
+{
+    int i = pReactor->pos[id];
+
+    if (i < 0) {
+        return;
+    }
+    pReactor->pos[id] = -1;
+    if (i != --pReactor->size) {
+        _heap_place(pReactor, i, pReactor->heap[pReactor->size]);
+        _heap_sift(pReactor, i);
+    }
+}
+
+/* lock held, the callback is called with it held too */
+static void _detach(Qcloud_IoT_Reactor *pReactor, int id)
+{
+    ReactorClient *client = &pReactor->clients[id];
+
+    _unschedule(pReactor, id);
+    if (client->ops->detached != NULL) {
+        client->ops->detached(client->handle, client->exit_code);
+    }
+    memset(client, 0, sizeof(ReactorClient));
+}
+
+static void _reap_clients(Qcloud_IoT_Reactor *pReactor)
+{
+    int id;
+
+    for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+        if (pReactor->clients[id].handle != NULL && pReactor->clients[id].removing) {
+            _detach(pReactor, id);
+        }
+    }
+}
+
+/**
+ * @brief yield a client once, then schedule it at its next event
+ */
+static void _step_client(Qcloud_IoT_Reactor *pReactor, int id)
+{
+    ReactorClient *         client = &pReactor->clients[id];
+    void *                  handle;
+    const ReactorClientOps *ops;
+    uint32_t                next;
+    size_t                  pending;
+    int                     rc;
+
+    HAL_MutexLock(pReactor->lock);
+    handle = client->removing ? NULL : client->handle;
+    ops    = client->ops;
+    HAL_MutexUnlock(pReactor->lock);
+    if (handle == NULL) {
+        return;
+    }
+
+    // the client is not detached while a run is in progress, no lock is held across its callbacks
+    rc = ops->yield(handle, REACTOR_STEP_MS);
+    if (rc == QCLOUD_RET_MQTT_MANUALLY_DISCONNECTED || rc == QCLOUD_ERR_MQTT_RECONNECT_TIMEOUT) {
+        Log_e("reactor client exit with error: %d", rc);
+        HAL_MutexLock(pReactor->lock);
+        client->removing  = true;
+        client->exit_code = rc;
+        _unschedule(pReactor, id);
+        HAL_MutexUnlock(pReactor->lock);
+        return;
+    } else if (rc != QCLOUD_RET_SUCCESS && rc != QCLOUD_RET_MQTT_RECONNECTED &&
+               rc != QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT) {
+        Log_e("Something goes error: %d", rc);
+    }
+
+    next = (ops->next_event_ms != NULL) ? ops->next_event_ms(handle) : qcloud_iot_mqtt_next_event_ms(client->mqtt);
+    next = Min(next, REACTOR_MAX_DUE_MS);
+    if (get_client_conn_state(client->mqtt) && network_get_socket(&client->mqtt->network_stack, &pending) < 0) {
+        next = Min(next, REACTOR_POLL_MS);
+    }
+
+    HAL_MutexLock(pReactor->lock);
+    if (!client->removing) {
+        _schedule(pReactor, id, HAL_GetTimeMs() + next);
+    }
+    HAL_MutexUnlock(pReactor->lock);
+}
+
+/**
+ * @brief call a due timer, a periodic one scheduled again before the call
+ */
+static void _fire_timer(Qcloud_IoT_Reactor *pReactor, int slot, uint32_t now)
+{
+    ReactorTimer *   timer = &pReactor->timers[slot];
+    ReactorTimerFunc func;
+    void *           context;
+
+    HAL_MutexLock(pReactor->lock);
+    func    = timer->func;
+    context = timer->context;
+    if (func != NULL && timer->period_ms > 0) {
+        _schedule(pReactor, REACTOR_TIMER_ID(slot), now + timer->period_ms);
+    } else {
+        _unschedule(pReactor, REACTOR_TIMER_ID(slot));
+        memset(timer, 0, sizeof(ReactorTimer));
+    }
+    HAL_MutexUnlock(pReactor->lock);
+
+    if (func != NULL) {
+        func(context);
+    }
+}
+
+void *IOT_Reactor_Construct(void)
+{
+    Qcloud_IoT_Reactor *pReactor;
+    int                 i;
+
+    if ((pReactor = (Qcloud_IoT_Reactor *)HAL_Malloc(sizeof(Qcloud_IoT_Reactor))) == NULL) {
+        Log_e("memory not enough to malloc reactor");
+        return NULL;
+    }
+    memset(pReactor, 0, sizeof(Qcloud_IoT_Reactor));
+
+    if ((pReactor->lock = HAL_MutexCreate()) == NULL) {
+        Log_e("create reactor lock failed");
+        HAL_Free(pReactor);
+        return NULL;
+    }
+
+    for (i = 0; i < REACTOR_MAX_EVENTS; i++) {
+        pReactor->pos[i] = -1;
+    }
+    (void)HAL_Network_Link_Up(&pReactor->link_up_count);
+
+    return pReactor;
+}
+
+int IOT_Reactor_Destroy(void *pReactor)
+{
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+    int                 id;
+
+    IOT_Reactor_Stop_Thread(reactor);
+
+    HAL_MutexLock(reactor->lock);
+    if (reactor->in_run) {
+        HAL_MutexUnlock(reactor->lock);
+        Log_e("reactor is running");
+        return QCLOUD_ERR_FAILURE;
+    }
+    for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+        if (reactor->clients[id].handle != NULL) {
+            _detach(reactor, id);
+        }
+    }
+    HAL_MutexUnlock(reactor->lock);
+
+    HAL_MutexDestroy(reactor->lock);
+    HAL_Free(reactor);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Reactor_Add(void *pReactor, void *handle, void *mqtt_client, const ReactorClientOps *ops)
+{
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(mqtt_client, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(ops, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(ops->yield, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+    int                 id, free_id = -1;
+
+    HAL_MutexLock(reactor->lock);
+    for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+        if (reactor->clients[id].handle == handle) {
+            HAL_MutexUnlock(reactor->lock);
+            Log_e("client already in reactor");
+            return QCLOUD_ERR_INVAL;
+        }
+        if (reactor->clients[id].handle == NULL && free_id < 0) {
+            free_id = id;
+        }
+    }
+    if (free_id < 0) {
+        HAL_MutexUnlock(reactor->lock);
+        Log_e("reactor full, max clients: %d", REACTOR_MAX_CLIENTS);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    reactor->clients[free_id].handle    = handle;
+    reactor->clients[free_id].mqtt      = (Qcloud_IoT_Client *)mqtt_client;
+    reactor->clients[free_id].ops       = ops;
+    reactor->clients[free_id].removing  = false;
+    reactor->clients[free_id].exit_code = QCLOUD_RET_SUCCESS;
+    _schedule(reactor, free_id, HAL_GetTimeMs());
+    HAL_MutexUnlock(reactor->lock);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Reactor_Remove(void *pReactor, void *handle)
+{
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(handle, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+    int                 id;
+
+    HAL_MutexLock(reactor->lock);
+    for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+        if (reactor->clients[id].handle == handle) {
+            break;
+        }
+    }
+    if (id == REACTOR_MAX_CLIENTS) {
+        HAL_MutexUnlock(reactor->lock);
+        return QCLOUD_ERR_INVAL;
+    }
+
+    // a run in progress may be yielding it, it is detached when the run ends
+    reactor->clients[id].removing = true;
+    if (!reactor->in_run) {
+        _detach(reactor, id);
+    }
+    HAL_MutexUnlock(reactor->lock);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Reactor_Add_Timer(void *pReactor, uint32_t delay_ms, uint32_t period_ms, ReactorTimerFunc func,
+                          void *context)
+{
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    POINTER_SANITY_CHECK(func, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+    int                 slot;
+
+    if (delay_ms > REACTOR_MAX_DUE_MS || period_ms > REACTOR_MAX_DUE_MS) {
+        Log_e("timer longer than %d ms", REACTOR_MAX_DUE_MS);
+        return QCLOUD_ERR_INVAL;
+    }
+
+    HAL_MutexLock(reactor->lock);
+    for (slot = 0; slot < REACTOR_MAX_TIMERS; slot++) {
+        if (reactor->timers[slot].func == NULL) {
+            break;
+        }
+    }
+    if (slot == REACTOR_MAX_TIMERS) {
+        HAL_MutexUnlock(reactor->lock);
+        Log_e("reactor full, max timers: %d", REACTOR_MAX_TIMERS);
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    reactor->timers[slot].func      = func;
+    reactor->timers[slot].context   = context;
+    reactor->timers[slot].period_ms = period_ms;
+    _schedule(reactor, REACTOR_TIMER_ID(slot), HAL_GetTimeMs() + delay_ms);
+    HAL_MutexUnlock(reactor->lock);
+
+    return slot;
+}
+
+int IOT_Reactor_Remove_Timer(void *pReactor, int timer_id)
+{
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+
+    if (timer_id < 0 || timer_id >= REACTOR_MAX_TIMERS) {
+        return QCLOUD_ERR_INVAL;
+    }
+
+    HAL_MutexLock(reactor->lock);
+    _unschedule(reactor, REACTOR_TIMER_ID(timer_id));
+    memset(&reactor->timers[timer_id], 0, sizeof(ReactorTimer));
+    HAL_MutexUnlock(reactor->lock);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+int IOT_Reactor_Run(void *pReactor, uint32_t timeout_ms)
+{
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+    int                 due_ids[REACTOR_MAX_EVENTS];
+    int                 sockets[REACTOR_MAX_CLIENTS];
+    uint32_t            readable = 0, ready = 0;
+    uint32_t            now, wait_ms, link_up_count;
+    size_t              pending;
+    int                 id, n, i, rc;
+
+    HAL_MutexLock(reactor->lock);
+    if (reactor->in_run) {
+        HAL_MutexUnlock(reactor->lock);
+        return QCLOUD_ERR_FAILURE;
+    }
+    reactor->in_run = true;
+
+    _reap_clients(reactor);
+
+    // the link came up again: every client looks at its connection, or tries to reconnect, at once
+    now = HAL_GetTimeMs();
+    if (HAL_Network_Link_Up(&link_up_count) && link_up_count != reactor->link_up_count) {
+        for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+            if (reactor->clients[id].handle != NULL && !reactor->clients[id].removing) {
+                _schedule(reactor, id, now);
+            }
+        }
+    }
+    reactor->link_up_count = link_up_count;
+
+    wait_ms = timeout_ms;
+    if (reactor->size > 0) {
+        wait_ms = _before(now, reactor->heap[0].due) ? Min(wait_ms, reactor->heap[0].due - now) : 0;
+    }
+
+    for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+        sockets[id] = -1;
+        if (reactor->clients[id].handle != NULL && !reactor->clients[id].removing) {
+            sockets[id] = network_get_socket(&reactor->clients[id].mqtt->network_stack, &pending);
+            if (pending > 0) {
+                // already decrypted, no socket event comes for it
+                ready |= 1u << id;
+                wait_ms = 0;
+            }
+        }
+    }
+    HAL_MutexUnlock(reactor->lock);
+
+    // 1. wait for a socket or the next due time
+    rc = HAL_Socket_Wait_Readable(sockets, REACTOR_MAX_CLIENTS, wait_ms, &readable);
+    if (rc < 0) {
+        // a socket closed under us, its client finds out when it reads
+        readable = 0;
+        for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+            if (sockets[id] >= 0) {
+                readable |= 1u << id;
+            }
+        }
+    }
+    ready |= readable;
+
+    // 2. clients with something to read
+    for (id = 0; id < REACTOR_MAX_CLIENTS; id++) {
+        if (ready & (1u << id)) {
+            _step_client(reactor, id);
+        }
+    }
+
+    // 3. due clients and timers, each at most once in a run: all taken out before any is called, one due
+    // again at once (next event 0) waits for the next run
+    now = HAL_GetTimeMs();
+    n   = 0;
+    HAL_MutexLock(reactor->lock);
+    while (reactor->size > 0 && !_before(now, reactor->heap[0].due)) {
+        due_ids[n++] = reactor->heap[0].id;
+        // not due again in this run before its step schedules it
+        _schedule(reactor, reactor->heap[0].id, now + REACTOR_MAX_DUE_MS);
+    }
+    HAL_MutexUnlock(reactor->lock);
+
+    for (i = 0; i < n; i++) {
+        if (due_ids[i] < REACTOR_MAX_CLIENTS) {
+            _step_client(reactor, due_ids[i]);
+        } else {
+            _fire_timer(reactor, due_ids[i] - REACTOR_MAX_CLIENTS, now);
+        }
+    }
+
+    HAL_MutexLock(reactor->lock);
+    _reap_clients(reactor);
+    reactor->in_run = false;
+    HAL_MutexUnlock(reactor->lock);
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+static void _reactor_thread(void *ptr)
+{
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)ptr;
+
+    Log_d("reactor thread start ...");
+    while (reactor->thread_running) {
+        IOT_Reactor_Run(reactor, REACTOR_MAX_WAIT_MS);
+    }
+    reactor->thread_exited = true;
+}
+
+int IOT_Reactor_Start_Thread(void *pReactor, uint32_t stack_size, uint16_t priority)
+{
+    POINTER_SANITY_CHECK(pReactor, QCLOUD_ERR_INVAL);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+    int                 rc;
+
+    if (reactor->thread_running) {
+        return QCLOUD_RET_SUCCESS;
+    }
+
+    memset(&reactor->thread_params, 0, sizeof(ThreadParams));
+    reactor->thread_params.thread_func = _reactor_thread;
+    reactor->thread_params.thread_name = "reactor_thread";
+    reactor->thread_params.user_arg    = reactor;
+    reactor->thread_params.stack_size  = stack_size;
+    reactor->thread_params.priority    = priority;
+    reactor->thread_running            = true;
+    reactor->thread_exited             = false;
+
+    rc = HAL_ThreadCreate(&reactor->thread_params);
+    if (rc) {
+        Log_e("create reactor_thread fail: %d", rc);
+        reactor->thread_running = false;
+        return QCLOUD_ERR_FAILURE;
+    }
+
+    return QCLOUD_RET_SUCCESS;
+}
+
+void IOT_Reactor_Stop_Thread(void *pReactor)
+{
+    POINTER_SANITY_CHECK_RTN(pReactor);
+    Qcloud_IoT_Reactor *reactor = (Qcloud_IoT_Reactor *)pReactor;
+
+    if (!reactor->thread_running) {
+        return;
+    }
+
+    reactor->thread_running = false;
+    while (!reactor->thread_exited) {
+        HAL_SleepMs(10);
+    }
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
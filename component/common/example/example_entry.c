@@ -237,6 +237,10 @@
 #include <uart_atcmd/example_uart_atcmd.h>
 #endif
 
+#if (defined(CONFIG_EXAMPLE_SPI_ATCMD) && CONFIG_EXAMPLE_SPI_ATCMD)
+#include <spi_atcmd/example_spi_atcmd.h>
+#endif
+
 #if CONFIG_EXAMPLE_SSL_SERVER
 #include <ssl_server/example_ssl_server.h>
 #endif
@@ -12,6 +12,9 @@
 #include "wifi_conf.h"
 
 #define MQTT_SELECT_TIMEOUT 1
+/* messages published while the broker is away wait in a RAM ring, and in
+ * flash when MQTT_EXAMPLE_QUEUE_FLASH_ADDR/SIZE give a free region */
+#define MQTT_QUEUE_RAM_LEN	4096
 static void messageArrived(MessageData* data)
 {
 	mqtt_printf(MQTT_INFO, "Message arrived on topic %s: %s\n", data->topicName->lenstring.data, (char *)data->message->payload);
@@ -90,9 +93,26 @@ void prvMQTTEchoTask(void *pvParameters)
 }
 
 #if defined(MQTT_TASK)
+static void MQTTExampleQueueInit(MQTTClient* c)
+{
+	static MQTTQueue queue;
+	static unsigned char ram[MQTT_QUEUE_RAM_LEN];
+#if defined(MQTT_EXAMPLE_QUEUE_FLASH_ADDR) && defined(MQTT_EXAMPLE_QUEUE_FLASH_SIZE)
+	MQTTQueueFlash flash;
+
+	FlashQueueInit(&flash, MQTT_EXAMPLE_QUEUE_FLASH_ADDR, MQTT_EXAMPLE_QUEUE_FLASH_SIZE);
+	if (MQTTQueue_init(&queue, ram, sizeof(ram), &flash, MQTT_QUEUE_DROP_OLDEST) != 0)
+		return;
+#else
+	if (MQTTQueue_init(&queue, ram, sizeof(ram), NULL, MQTT_QUEUE_DROP_OLDEST) != 0)
+		return;
+#endif
+	MQTTSetQueue(c, &queue);
+	mqtt_printf(MQTT_INFO, "%d queued messages from the last boot", MQTTQueue_count(&queue));
+}
+
 void MQTTPublishMessage(MQTTClient* c, char *topic)
 {	
-	int rc = 0;
 	static int count = 0;
 	MQTTMessage message;
 	char payload[300];
@@ -100,18 +120,14 @@ void MQTTPublishMessage(MQTTClient* c, char *topic)
 	message.retained = 0;		
 	message.payload = payload;
 	
-	if(c->mqttstatus == MQTT_RUNNING){
-		count++;
-		sprintf(payload, "hello from AMEBA %d", count);
-		message.payloadlen = strlen(payload);			
-		mqtt_printf(MQTT_INFO, "Publish Topic %s : %d", topic, count);
-		if ((rc = MQTTPublish(c, topic, &message)) != 0){
-			mqtt_printf(MQTT_INFO, "Return code from MQTT publish is %d\n", rc);
-			MQTTSetStatus(c, MQTT_START);
-			c->ipstack->disconnect(c->ipstack);
-		}
-	}
-
+	count++;
+	sprintf(payload, "hello from AMEBA %d", count);
+	message.payloadlen = strlen(payload);
+	mqtt_printf(MQTT_INFO, "Publish Topic %s : %d", topic, count);
+	// no wait for PUBACK: up to MQTT_MAX_INFLIGHT messages may be on the way, the rest, and all
+	// of them while the broker is away, wait in the queue and go in order once the client runs
+	if (MQTTPublishQueued(c, topic, &message) != SUCCESS)
+		mqtt_printf(MQTT_INFO, "MQTT queue refused message %d", count);
 }
 
 static void prvMQTTTask(void *pvParameters)
@@ -132,6 +148,7 @@ static void prvMQTTTask(void *pvParameters)
 
 	NetworkInit(&network);
 	MQTTClientInit(&client, &network, 30000, sendbuf, sizeof(sendbuf), readbuf, sizeof(readbuf));
+	MQTTExampleQueueInit(&client);
 
 	while (1)
 	{	
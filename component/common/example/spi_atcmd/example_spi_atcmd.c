@@ -11,641 +11,617 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 #include <platform/platform_stdlib.h>
 #include "semphr.h"
 #include "device.h"
-#include "osdep_api.h"
 #include "osdep_service.h"
 #include "device_lock.h"
+#include "wifi_conf.h"
 
 #include "spi_atcmd/example_spi_atcmd.h"
 
 #include "at_cmd/log_service.h"
 #include "at_cmd/atcmd_wifi.h"
 #include "at_cmd/atcmd_lwip.h"
+#include "at_cmd/atcmd_frame.h"
+#include "at_cmd/atcmd_spi.h"
+#include "at_cmd/atcmd_record.h"
 
 #include "flash_api.h"
 
 #include "spi_api.h"
 #include "spi_ex_api.h"
+#include "gpio_api.h"
+#include "sys_api.h"
 
-#include "gpio_irq_api.h"
-#include "gpio_irq_ex_api.h"
-
-/**** SPI FUNCTIONS ****/
-spi_t spi_obj;
-gpio_t gpio_cs;
+typedef int (*init_done_ptr)(void);
+extern init_done_ptr p_wlan_init_done_callback;
+extern char log_buf[LOG_SERVICE_BUFLEN];
+extern int atcmd_wifi_restore_from_flash(void);
+extern int atcmd_lwip_restore_from_flash(void);
+extern void at_set_debug_mask(unsigned int newDbgFlag);
 
-#define SPI_RX_BUFFER_SIZE ATSTRING_LEN/2
-#define SPI_TX_BUFFER_SIZE ATSTRING_LEN/2
-uint16_t spi_chunk_buffer[ATSTRING_LEN/2];
+/**** LOG SERVICE ****/
+char at_string[ATSTRING_LEN];
 
-_Sema master_rx_done_sema;
-_Sema master_tx_done_sema;
+/**** SETTINGS ****/
 
-#define SPI_USE_STREAM (0)
-#define SPI_USE_DMA    (1)
+/*
+ * The AT partitions are records of a store appended to SPI_SETTING_SECTOR
+ * and SPI_SETTING_BACKUP_SECTOR in turn, as for the UART AT example.
+ */
+static struct atcmd_record_store spi_at_record;
+static u8 spi_at_record_mounted = 0;
 
-/**** SLAVE HARDWARE READY ****/
-gpio_t gpio_hrdy;
+static const struct atcmd_record_legacy spi_at_record_legacy[] = {
+	{AT_PARTITION_SPI, SPI_CONF_DATA_OFFSET, SPI_CONF_DATA_SIZE},
+	{AT_PARTITION_WIFI, WIFI_CONF_DATA_OFFSET, WIFI_CONF_DATA_SIZE},
+	{AT_PARTITION_LWIP, LWIP_CONF_DATA_OFFSET, LWIP_CONF_DATA_SIZE},
+};
 
-#define SPI_SLAVE_BUSY 0
-#define SPI_SLAVE_READY 1
+static int spi_at_record_read(u32 addr, u32 len, u8 *data)
+{
+	flash_t flash;
 
-volatile int spi_slave_status = SPI_SLAVE_BUSY;
-_Sema spi_check_hrdy_sema;
+	return (flash_stream_read(&flash, addr, len, data) == 1) ? 0 : -1;
+}
 
-#define BLOCKING    1
-#define NONBLOCKING 0
+static int spi_at_record_write(u32 addr, u32 len, const u8 *data)
+{
+	flash_t flash;
 
-volatile int hrdy_pull_down_counter = 0;
+	return (flash_stream_write(&flash, addr, len, (u8 *)data) == 1) ? 0 : -1;
+}
 
-/**** SLAVE SYNC ****/
+static int spi_at_record_erase(u32 addr)
+{
+	flash_t flash;
 
-gpio_irq_t gpio_sync;
+	flash_erase_sector(&flash, addr);
+	return 0;
+}
 
-#define SPI_STATE_MISO 0
-#define SPI_STATE_MOSI 1
+static const struct atcmd_record_flash spi_at_record_flash = {
+	spi_at_record_read,
+	spi_at_record_write,
+	spi_at_record_erase
+};
 
-int spi_state = SPI_STATE_MISO;
+void atcmd_update_partition_info(AT_PARTITION id, AT_PARTITION_OP ops, u8 *data, u16 len)
+{
+	int ret = 0;
 
-/**** TASK THREAD ****/
+	if(id > AT_PARTITION_LWIP){
+		printf("partition id is invalid!\r\n");
+		return;
+	}
 
-_Sema spi_check_trx_sema;
+	device_mutex_lock(RT_DEV_LOCK_FLASH);
 
-/**** LOG SERVICE ****/
-char at_string[ATSTRING_LEN];
+	if(!spi_at_record_mounted){
+		atcmd_record_mount(&spi_at_record, &spi_at_record_flash, SPI_SETTING_SECTOR, SPI_SETTING_BACKUP_SECTOR,
+			spi_at_record_legacy, sizeof(spi_at_record_legacy) / sizeof(spi_at_record_legacy[0]));
+		spi_at_record_mounted = 1;
+	}
 
-extern char log_buf[LOG_SERVICE_BUFLEN];
-extern xSemaphoreHandle log_rx_interrupt_sema;
+	if(id == AT_PARTITION_ALL){
+		if(ops == AT_PARTITION_ERASE)
+			ret = atcmd_record_clear(&spi_at_record);
+	}
+	else if(ops == AT_PARTITION_READ)
+		atcmd_record_read(&spi_at_record, (u8)id, data, len);
+	else if(ops == AT_PARTITION_WRITE)
+		ret = atcmd_record_write(&spi_at_record, (u8)id, data, len);
+	else
+		ret = atcmd_record_write(&spi_at_record, (u8)id, NULL, 0);
 
-#define LOG_TX_BUFFER_SIZE 16*1024
-char log_tx_buffer[LOG_TX_BUFFER_SIZE];
-uint32_t log_tx_idx = 0;
-uint32_t log_rx_idx = 0;
+	device_mutex_unlock(RT_DEV_LOCK_FLASH);
 
-/**** DATA FORMAT ****/
-#define PREAMBLE_COMMAND     0x6000
-#define PREAMBLE_DATA_READ   0x1000
-#define PREAMBLE_DATA_WRITE  0x0000
+	if(ret < 0)
+		printf("AT settings: partition %d not saved\r\n", id);
+	return;
+}
 
-#define COMMAND_DUMMY             0x0000
-#define COMMAND_BEGIN             0x0304
-#define COMMAND_END               0x0305
-#define COMMAND_READ_BEGIN        0x0012
-#define COMMAND_READ_RAW          0x0013
-#define COMMAND_WRITE_BEGIN       0x0014
-#define COMMAND_READ_WRITE_END    0x0015
+/**** LINK ****/
+
+/*
+ * The device is the SPI slave of the host MCU, transactions are described
+ * in at_cmd/atcmd_spi.h. The link task arms both SSI directions by GDMA for
+ * each phase and raises RDY, the RX done interrupt drops it again. Frames of
+ * the host batch are split into SPI_AT_RX_DEPTH receive buffers and queued
+ * to the exec task: CMD frames run through log_service_exec() with their
+ * output collected into RSP frames, DATA frames are sent on their
+ * connection. Output of any other task goes out as EVT frames, and data
+ * received in auto receive mode as DATA frames. All of it is packed into
+ * the batch that is not being clocked, the link task swaps the two.
+ */
+#define SPI_AT_RX_SIZE		(LOG_SERVICE_BUFLEN - 1 + ATFRAME_CRC_LEN)
+#define SPI_AT_DATA_CHUNK	1460	// max. socket payload of one DATA frame to the host
+
+struct spi_at_msg {
+	u8 *buf;	// payload, NULL for a rejected frame
+	u16 len;
+	u8 type;
+	u8 seq;
+	u8 nak;
+};
+
+static spi_t spi_at_obj;
+static gpio_t spi_at_rdy;
+static gpio_t spi_at_int;
+static _sema spi_at_xfer_sema;			// a phase was clocked
+static _sema spi_at_room_sema;			// the batches were swapped
+static _mutex spi_at_tx_mutex;			// spi_at_batch[spi_at_fill], INT
+static u8 spi_at_hdr_tx[ATSPI_HDR_LEN];
+static u8 spi_at_hdr_rx[ATSPI_HDR_LEN];
+static u8 *spi_at_rx_batch;
+static struct atspi_batch spi_at_batch[2];
+static u8 spi_at_fill = 0;				// batch the tasks add frames to
+static u8 spi_at_seq = 0;
+static u8 spi_at_credit = 0;			// credit of the last header sent
+static struct atframe_rx spi_at_rx;
+static xQueueHandle spi_at_free_q;		// free receive buffers
+static xQueueHandle spi_at_cmd_q;		// struct spi_at_msg
+static xTaskHandle spi_at_exec_task = NULL;
+static u8 *spi_at_rsp;					// RSP payload under construction
+static u16 spi_at_rsp_len;
+static u8 spi_at_rsp_seq;
+static u8 spi_at_out_seq = 0;			// EVT and DATA frames
+static volatile u8 spi_at_in_cmd = 0;
+static volatile u8 spi_at_ready = 0;
+/* statistics */
+static u32 spi_at_xfers = 0;
+static u32 spi_at_resyncs = 0;
+static u32 spi_at_dropped = 0;
+
+static void spi_at_irq(uint32_t id, SpiIrq event)
+{
+	/* To avoid gcc warnings */
+	( void ) id;
 
-#define REGISTER_ADDR        0x2000
+	if(event == SpiRxIrq){
+		gpio_write(&spi_at_rdy, 0);
+		rtw_up_sema_from_isr(&spi_at_xfer_sema);
+	}
+}
 
-void atcmd_update_partition_info(AT_PARTITION id, AT_PARTITION_OP ops, u8 *data, u16 len) {
-	flash_t flash;
-	int size, offset, i;
-	u32 read_data;
+static void spi_at_hw_init(void)
+{
+	spi_init(&spi_at_obj, SPI0_MOSI, SPI0_MISO, SPI0_SCLK, SPI0_CS);
+	spi_format(&spi_at_obj, DfsEightBits, SPI_AT_MODE, 1);
+	hal_ssi_toggle_between_frame(&spi_at_obj.hal_ssi_adaptor, ENABLE);
+	spi_irq_hook(&spi_at_obj, (spi_irq_handler)spi_at_irq, (uint32_t)&spi_at_obj);
+}
 
-	switch(id){
-		case AT_PARTITION_SPI:
-			size = SPI_CONF_DATA_SIZE;
-			offset = SPI_CONF_DATA_OFFSET;
-			break;
-		case AT_PARTITION_WIFI:
-			size = WIFI_CONF_DATA_SIZE;
-			offset = WIFI_CONF_DATA_OFFSET;
-			break;
-		case AT_PARTITION_LWIP:
-			size = LWIP_CONF_DATA_SIZE;
-			offset = LWIP_CONF_DATA_OFFSET;
-			break;
-		case AT_PARTITION_ALL:
-			size = 0x1000;
-			offset = 0;
-			break;
-		default:
-			printf("partition id is invalid!\r\n");
-			return;
-	}
+/* arm one phase and wait until the host clocked it, timeout_ms 0 waits forever */
+static int spi_at_xfer(u8 *tx, u8 *rx, u16 len, u32 timeout_ms)
+{
+	spi_flush_rx_fifo(&spi_at_obj);
+	if(spi_slave_read_stream_dma(&spi_at_obj, (char *)rx, len) != HAL_OK)
+		return -1;
+	if(spi_slave_write_stream_dma(&spi_at_obj, (char *)tx, len) != HAL_OK)
+		return -1;
+	gpio_write(&spi_at_rdy, 1);
+
+	if(timeout_ms == 0)
+		return (rtw_down_sema(&spi_at_xfer_sema) == _SUCCESS) ? 0 : -1;
+	return (rtw_down_timeout_sema(&spi_at_xfer_sema, timeout_ms) == RTW_FALSE) ? -1 : 0;
+}
 
-	device_mutex_lock(RT_DEV_LOCK_FLASH);
+/* a header failed its check or phase 2 stalled: go quiet, then start over */
+static void spi_at_resync(void)
+{
+	gpio_write(&spi_at_rdy, 0);
+	spi_at_resyncs++;
+	rtw_msleep_os(ATSPI_RESYNC_MS);
+	spi_free(&spi_at_obj);
+	spi_at_hw_init();
+	while(rtw_down_timeout_sema(&spi_at_xfer_sema, 0) != RTW_FALSE);
+	AT_DBG_MSG(AT_FLAG_COMMON, AT_DBG_WARNING, "SPI AT: resync %d after %d transactions", spi_at_resyncs, spi_at_xfers);
+}
 
-	if(id == AT_PARTITION_ALL && ops == AT_PARTITION_ERASE){
-		flash_erase_sector(&flash, SPI_SETTING_SECTOR);
-		goto exit;
-	}
-	
-	if(ops == AT_PARTITION_READ){
-		flash_stream_read(&flash, SPI_SETTING_SECTOR+offset, len, data);
-		goto exit;
-	}
+static u8 spi_at_credit_now(void)
+{
+	u32 credit = uxQueueMessagesWaiting(spi_at_free_q) + (spi_at_rx.buf ? 1 : 0);
 
-	//erase BACKUP_SECTOR
-	flash_erase_sector(&flash, SPI_SETTING_BACKUP_SECTOR);
+	return (credit > 0xFF) ? 0xFF : (u8)credit;
+}
 
-	if(ops == AT_PARTITION_WRITE){
-		// backup new data
-		flash_stream_write(&flash, SPI_SETTING_BACKUP_SECTOR+offset, len, data);
-	}
-	
-	//backup front data to backup sector
-	for(i = 0; i < offset; i += sizeof(read_data)){
-		flash_read_word(&flash, SPI_SETTING_SECTOR + i, &read_data);
-		flash_write_word(&flash, SPI_SETTING_BACKUP_SECTOR + i,read_data);
-	}
-	
-	//backup rear data
-	for(i = (offset + size); i < 0x1000; i += sizeof(read_data)){
-		flash_read_word(&flash, SPI_SETTING_SECTOR + i, &read_data);
-		flash_write_word(&flash, SPI_SETTING_BACKUP_SECTOR + i,read_data);
-	}
-	
-	//erase UART_SETTING_SECTOR
-	flash_erase_sector(&flash, SPI_SETTING_SECTOR);
-	
-	//retore data to UART_SETTING_SECTOR from UART_SETTING_BACKUP_SECTOR
-	for(i = 0; i < 0x1000; i+= sizeof(read_data)){
-		flash_read_word(&flash, SPI_SETTING_BACKUP_SECTOR + i, &read_data);
-		flash_write_word(&flash, SPI_SETTING_SECTOR + i,read_data);
-	}
-	
-	//erase BACKUP_SECTOR
-	flash_erase_sector(&flash, SPI_SETTING_BACKUP_SECTOR);
+/* caller holds spi_at_tx_mutex */
+static void spi_at_int_update(void)
+{
+	int pending = spi_at_batch[0].len || spi_at_batch[1].len;
 
-exit:
-	device_mutex_unlock(RT_DEV_LOCK_FLASH);
-	return;
+	/* a host that ran out of credit learns it is back */
+	if((spi_at_credit == 0) && spi_at_credit_now())
+		pending = 1;
+	gpio_write(&spi_at_int, pending);
 }
 
-/* AT cmd V2 API */
-void spi_at_send_string(char *str) {
-    spi_at_send_buf(str, strlen(str));
+static void spi_at_rx_release(u8 *buf)
+{
+	xQueueSend(spi_at_free_q, &buf, 0);
+	rtw_mutex_get(&spi_at_tx_mutex);
+	if(spi_at_credit == 0)
+		spi_at_int_update();
+	rtw_mutex_put(&spi_at_tx_mutex);
 }
 
-/* AT cmd V2 API */
-void spi_at_send_buf(u8 *buf, u32 len) {
-    int i;
-    int spi_tx_tail_next;
+/* split the host batch into frames, each one into a free receive buffer */
+static void spi_at_rx_parse(u16 len)
+{
+	struct spi_at_msg msg;
+	u8 *data = spi_at_rx_batch;
+	u8 *buf;
+	u32 used;
+	int ret;
+
+	/* frames never span two batches */
+	atframe_rx_reset(&spi_at_rx);
+	while(len){
+		if((spi_at_rx.buf == NULL) && (xQueueReceive(spi_at_free_q, &buf, 0) == pdTRUE))
+			atframe_rx_set_buf(&spi_at_rx, buf, SPI_AT_RX_SIZE);
+		buf = spi_at_rx.buf;
+		ret = atframe_rx_feed(&spi_at_rx, data, len, &used);
+		data += used;
+		len -= used;
+		if(ret == ATFRAME_RX_MORE)
+			break;
 
-	if( !len || (!buf) ){
-		return;
+		msg.type = spi_at_rx.type;
+		msg.seq = spi_at_rx.seq;
+		if(ret == ATFRAME_RX_FRAME){
+			msg.buf = buf;
+			msg.len = spi_at_rx.len;
+			msg.nak = 0;
+		}
+		else{
+			msg.buf = NULL;
+			msg.len = 0;
+			msg.nak = spi_at_rx.nak;
+		}
+		if((xQueueSend(spi_at_cmd_q, &msg, 0) != pdTRUE) && msg.buf)
+			xQueueSend(spi_at_free_q, &msg.buf, 0);
 	}
-
-    if (buf == log_tx_buffer) {
-        log_tx_idx = len;
-    } else {
-        for (i=0; i<len; i++) {
-            if (log_tx_idx == LOG_TX_BUFFER_SIZE) {
-                // overflow!
-                break;
-            }
-            log_tx_buffer[log_tx_idx++] = buf[i];
-        }
-    }
-
-    if (__get_IPSR() != 0) {
-        RtlUpSema(&spi_check_trx_sema);
-    } else {
-        RtlUpSemaFromISR(&spi_check_trx_sema);
-    }
-}
-
-/* IRQ handler called when SPI TX/RX finish */
-void master_trx_done_callback(void *pdata, SpiIrq event) {
-    switch(event){
-        case SpiRxIrq:
-            RtlUpSemaFromISR(&master_rx_done_sema);
-            //DBG_8195A("Master RX done!\n");
-            break;
-        case SpiTxIrq:
-            //DBG_8195A("Master TX done!\n");
-            break;
-        default:
-            DBG_8195A("unknown interrput evnent!\n");
-    }
 }
 
-/* IRQ handler called when SPI TX finish */
-static void master_tx_done_callback(uint32_t id) {
-	RtlUpSemaFromISR(&master_tx_done_sema);
+static void spi_at_link_thread(void *param)
+{
+	struct atspi_hdr m, s;
+	struct atspi_batch *tx;
+	u16 n;
+
+	/* To avoid gcc warnings */
+	( void ) param;
+
+	while(1){
+		rtw_mutex_get(&spi_at_tx_mutex);
+		tx = &spi_at_batch[spi_at_fill ^ 1];
+		if((tx->len == 0) && spi_at_batch[spi_at_fill].len){
+			spi_at_fill ^= 1;
+			tx = &spi_at_batch[spi_at_fill ^ 1];
+			rtw_up_sema(&spi_at_room_sema);
+		}
+		s.flags = spi_at_batch[spi_at_fill].len ? ATSPI_F_MORE : 0;
+		s.credit = spi_at_credit_now();
+		spi_at_credit = s.credit;
+		spi_at_int_update();
+		rtw_mutex_put(&spi_at_tx_mutex);
+		s.seq = spi_at_seq++;
+		s.len = tx->len;
+		atspi_hdr_encode(spi_at_hdr_tx, &s);
+
+		/* phase 1, the host comes whenever it likes */
+		if(spi_at_xfer(spi_at_hdr_tx, spi_at_hdr_rx, ATSPI_HDR_LEN, 0) < 0){
+			spi_at_resync();
+			continue;
+		}
+		if(atspi_hdr_decode(spi_at_hdr_rx, &m) < 0){
+			spi_at_resync();
+			continue;
+		}
+
+		/* phase 2, both batches at once */
+		n = atspi_xfer_len(&m, &s);
+		if(n){
+			n = atspi_batch_pad(tx, n);
+			if(spi_at_xfer(tx->buf, spi_at_rx_batch, n, SPI_AT_XFER_TIMEOUT_MS) < 0){
+				/* our batch is kept and announced again */
+				spi_at_resync();
+				continue;
+			}
+			if(m.credit)
+				atspi_batch_reset(tx, tx->buf, tx->size);
+			spi_at_rx_parse(m.len);
+		}
+		spi_at_xfers++;
+	}
 }
 
-/* IRQ handler as gpio hrdy hit rising edge */
-void slave_hrdy_change_callback(uint32_t id) {
-    gpio_irq_disable(&gpio_hrdy);
+/**** OUTPUT ****/
 
-    if (spi_slave_status == SPI_SLAVE_BUSY) {
-        // Transition from LOW to HIGH. Change to listen IRQ_LOW
-        spi_slave_status = SPI_SLAVE_READY;
-        hrdy_pull_down_counter++;
-
-        gpio_irq_set(&gpio_hrdy, IRQ_LOW, 1);
-        gpio_irq_enable(&gpio_hrdy);
-    } else {
-        // Transition from HIGH to LOW. Change to listen IRQ_HIGH
-        spi_slave_status = SPI_SLAVE_BUSY;
+/* append one frame, seq < 0 numbers it as EVT/DATA, waits for the host to make room */
+static int spi_at_put(u8 type, int seq, const u8 *pre, u16 pre_len, const u8 *data, u16 len)
+{
+	struct atspi_batch *batch;
+	u32 waited = 0;
+	u16 room;
+	u8 *dst;
+
+	rtw_mutex_get(&spi_at_tx_mutex);
+	while(1){
+		batch = &spi_at_batch[spi_at_fill];
+		dst = atspi_batch_room(batch, &room);
+		if(dst && (room >= pre_len + len))
+			break;
+		rtw_mutex_put(&spi_at_tx_mutex);
+		if(waited >= SPI_AT_TX_TIMEOUT_MS){
+			spi_at_dropped++;
+			return -1;
+		}
+		rtw_down_timeout_sema(&spi_at_room_sema, 10);
+		waited += 10;
+		rtw_mutex_get(&spi_at_tx_mutex);
+	}
+	if(pre_len)
+		memcpy(dst, pre, pre_len);
+	memcpy(dst + pre_len, data, len);
+	if(seq < 0)
+		seq = spi_at_out_seq++;
+	atspi_batch_add(batch, type, (u8)seq, pre_len + len);
+	gpio_write(&spi_at_int, 1);
+	rtw_mutex_put(&spi_at_tx_mutex);
+	return 0;
+}
 
-        gpio_irq_set(&gpio_hrdy, IRQ_HIGH, 1);
-        gpio_irq_enable(&gpio_hrdy);
-    }
+static void spi_at_rsp_flush(u8 flags)
+{
+	spi_at_put(ATFRAME_TYPE_RSP | flags, spi_at_rsp_seq, NULL, 0, spi_at_rsp, spi_at_rsp_len);
+	spi_at_rsp_len = 0;
+}
 
-    RtlUpSemaFromISR(&spi_check_hrdy_sema);
+/* AT cmd V2 API */
+void spi_at_send_string(char *str)
+{
+	spi_at_send_buf((u8 *)str, strlen(str));
 }
 
-/* IRQ Handler as gpio sync state change */
-void slave_sync_chagne_callback(uint32_t id)
+/* AT cmd V2 API */
+void spi_at_send_buf(u8 *buf, u32 len)
 {
-    gpio_irq_disable(&gpio_sync);
+	u32 n;
 
-    if (spi_state == SPI_STATE_MISO) {
-        // Transition from LOW to HIGH. Change to listen IRQ_LOW
-        spi_state = SPI_STATE_MOSI;
+	if(!len || (!buf) || !spi_at_ready)
+		return;
 
-        gpio_irq_set(&gpio_sync, IRQ_LOW, 1);
-        gpio_irq_enable(&gpio_sync);
-    } else {
-        // Transition from HIGH to LOW. Change to listen IRQ_HIGH
-        spi_state = SPI_STATE_MISO;
+	if(spi_at_in_cmd && (xTaskGetCurrentTaskHandle() == spi_at_exec_task)){
+		while(len){
+			/* a full frame only goes out flagged MORE once more output follows */
+			if(spi_at_rsp_len == SPI_AT_RSP_CHUNK)
+				spi_at_rsp_flush(ATFRAME_FLAG_MORE);
+			n = SPI_AT_RSP_CHUNK - spi_at_rsp_len;
+			if(n > len)
+				n = len;
+			memcpy(spi_at_rsp + spi_at_rsp_len, buf, n);
+			spi_at_rsp_len += n;
+			buf += n;
+			len -= n;
+		}
+		return;
+	}
 
-        gpio_irq_set(&gpio_sync, IRQ_HIGH, 1);
-        gpio_irq_enable(&gpio_sync);
-    }
+	while(len){
+		n = (len > SPI_AT_RSP_CHUNK) ? SPI_AT_RSP_CHUNK : len;
+		if(spi_at_put(ATFRAME_TYPE_EVT, -1, NULL, 0, buf, n) < 0)
+			return;
+		buf += n;
+		len -= n;
+	}
+}
 
-    RtlUpSemaFromISR(&spi_check_trx_sema);
+/**
+ * Hand data received on a connection to the host as DATA frames, instead of
+ * the "[ATPR] OK,<size>,<con_id>:" text. Blocks while the host does not
+ * take it, which holds the socket back.
+ *
+ * @return 0, -1 if not sent (link down or the host stopped reading)
+ */
+int spi_at_data_send(int con_id, u8 *data, u32 len)
+{
+	u8 id = (u8)con_id;
+	u32 n;
+
+	if(!spi_at_ready)
+		return -1;
+	while(len){
+		n = (len > SPI_AT_DATA_CHUNK) ? SPI_AT_DATA_CHUNK : len;
+		if(spi_at_put(ATFRAME_TYPE_DATA, -1, &id, 1, data, n) < 0)
+			return -1;
+		data += n;
+		len -= n;
+	}
+	return 0;
 }
 
-void spi_atcmd_main(void)
+/**** EXEC ****/
+
+static void spi_at_nak(u8 seq, u8 reason)
 {
-    wifi_disable_powersave();    
-
-    // read settings
-	SPI_LOG_CONF spiconf;
-	spiconf.bits = 16;
-    spiconf.frequency = 20000000;
-    spiconf.mode = (SPI_SCLK_IDLE_LOW|SPI_SCLK_TOGGLE_MIDDLE);
-
-    // init spi
-    spi_init(&spi_obj, SPI0_MOSI, SPI0_MISO, SPI0_SCLK, SPI0_CS);
-    spi_frequency(&spi_obj, spiconf.frequency);
-    spi_format(&spi_obj, spiconf.bits, spiconf.mode, 0);
-
-    spi_bus_tx_done_irq_hook(&spi_obj, master_tx_done_callback, (uint32_t)&spi_obj);
-    spi_irq_hook(&spi_obj, master_trx_done_callback, (uint32_t)&spi_obj);
-
-    // init simulated spi cs
-    gpio_init(&gpio_cs, GPIO_CS);
-    gpio_dir(&gpio_cs, PIN_OUTPUT);
-    gpio_mode(&gpio_cs, PullNone);
-    gpio_write(&gpio_cs, 1);
-
-    // init gpio for check if spi slave hw ready 
-    gpio_init(&gpio_hrdy, GPIO_HRDY);
-    gpio_dir(&gpio_hrdy, PIN_INPUT);
-    gpio_mode(&gpio_hrdy, PullDown);
-
-    gpio_irq_init(&gpio_hrdy, GPIO_HRDY, slave_hrdy_change_callback, (uint32_t)&gpio_hrdy);
-    gpio_irq_set(&gpio_hrdy, IRQ_HIGH, 1);
-    gpio_irq_enable(&gpio_hrdy); 
-
-    // init gpio for check if spi slave want to send data
-    gpio_irq_init(&gpio_sync, GPIO_SYNC, slave_sync_chagne_callback,(uint32_t)&gpio_sync);
-    gpio_irq_set(&gpio_sync, IRQ_HIGH, 1);
-    gpio_irq_enable(&gpio_sync);
-
-    // init semaphore for check hardware ready
-    RtlInitSema(&spi_check_hrdy_sema, 1);
-    RtlDownSema(&spi_check_hrdy_sema);
-
-    // init semaphore that makes spi tx/rx thread to check something
-    RtlInitSema(&spi_check_trx_sema, 1);
-    RtlDownSema(&spi_check_trx_sema);
-
-    // init semaphore for master tx
-	RtlInitSema(&master_tx_done_sema, 1);
-	RtlDownSema(&master_tx_done_sema);
-
-    // init semaphore for master rx
-    RtlInitSema(&master_rx_done_sema, 1);
-    RtlDownSema(&master_rx_done_sema);
+	spi_at_put(ATFRAME_TYPE_NAK, seq, NULL, 0, &reason, 1);
 }
 
-int32_t spi_master_send(spi_t *obj, char *tx_buffer, uint32_t length) {
-    hrdy_pull_down_counter = 0;
-    spi_master_write_stream_dma(obj, tx_buffer, length);
-    RtlDownSema(&master_tx_done_sema);
+static void spi_at_exec(struct spi_at_msg *msg)
+{
+	u16 len = msg->len;
+	char *data;
+
+#if CONFIG_LOG_SERVICE_LOCK
+	log_service_lock();
+#endif
+	memcpy(log_buf, msg->buf, len);
+	log_buf[len] = '\0';
+	spi_at_rx_release(msg->buf);
+
+	/* same layout the text path hands to data commands: header '\0' raw data */
+	if(strncmp(log_buf, "ATPT", C_NUM_AT_CMD) == 0){
+		data = memchr(log_buf, ':', len);
+		if(data)
+			*data = '\0';
+	}
 
-    if (spi_slave_status == SPI_SLAVE_BUSY) {
-        while (hrdy_pull_down_counter == 0);
-        hrdy_pull_down_counter = 0;
-    }
+	spi_at_rsp_seq = msg->seq;
+	spi_at_rsp_len = 0;
+	spi_at_in_cmd = 1;
+	log_service_exec(log_buf);
+	spi_at_in_cmd = 0;
+	spi_at_rsp_flush(0);
+	log_buf[0] = '\0';
+#if CONFIG_LOG_SERVICE_LOCK
+	log_service_unlock();
+#endif
 }
 
-int32_t spi_master_recv(spi_t *obj, char *rx_buffer, uint32_t length) {
-    hrdy_pull_down_counter = 0;
-    spi_flush_rx_fifo(obj);
-    spi_master_read_stream_dma(obj, rx_buffer, length);
-    RtlDownSema(&master_rx_done_sema);
-    RtlDownSema(&master_tx_done_sema);
-
-    if (spi_slave_status == SPI_SLAVE_BUSY) {
-        while (hrdy_pull_down_counter == 0);
-        hrdy_pull_down_counter = 0;
-    }
+/* DATA frame from the host: con_id, then the bytes to send on it as they are */
+static void spi_at_data_recv(struct spi_at_msg *msg)
+{
+	int con_id = 0;
+	int error_no = 1;
+
+	if(msg->len >= 2){
+		con_id = msg->buf[0];
+#if CONFIG_LOG_SERVICE_LOCK
+		log_service_lock();
+#endif
+		error_no = atcmd_lwip_send_con(con_id, msg->buf + 1, msg->len - 1);
+#if CONFIG_LOG_SERVICE_LOCK
+		log_service_unlock();
+#endif
+	}
+	spi_at_rx_release(msg->buf);
+	if(error_no)
+		at_printf("\r\n[ATPT] ERROR:%d,%d", error_no, con_id);
 }
 
-void atcmd_check_special_case(char *buf) {
-    int i;
-    if (strlen(buf) > 4) {
-        if (strncmp(buf, "ATPT", 4) == 0) {
-            for (i=0; i<strlen(buf); i++) {
-                if (buf[i] == ':') {
-                    buf[i] = '\0';
-                    break;
-                }
-            }
-        }
-    }
+static void spi_at_exec_thread(void *param)
+{
+	struct spi_at_msg msg;
+
+	/* To avoid gcc warnings */
+	( void ) param;
+
+	while(1){
+		if(xQueueReceive(spi_at_cmd_q, &msg, portMAX_DELAY) != pdTRUE)
+			continue;
+		if(msg.buf == NULL){
+			spi_at_nak(msg.seq, msg.nak);
+			continue;
+		}
+		switch(msg.type & ATFRAME_TYPE_MASK){
+			case ATFRAME_TYPE_CMD:
+				spi_at_exec(&msg);
+				break;
+			case ATFRAME_TYPE_DATA:
+				spi_at_data_recv(&msg);
+				break;
+			default:
+				spi_at_rx_release(msg.buf);
+				spi_at_nak(msg.seq, ATFRAME_NAK_TYPE);
+				break;
+		}
+	}
 }
 
-static void spi_trx_thread(void *param)
+/**** INIT ****/
+
+static int spi_atcmd_main(void)
 {
-    uint32_t i;
-    uint32_t rxlen, txlen;
-    uint32_t recv_len, recv_remain, send_len;
-
-    uint16_t dummy, L_address, H_address, L_size, H_size;
-
-    int slave_ready = 0;
-    do {
-        slave_ready = gpio_read(&gpio_hrdy);
-        rtw_msleep_os(1000);
-    } while(slave_ready == 0);
-
-    while(1) {
-        RtlDownSema(&spi_check_trx_sema);
-
-        if (spi_state == SPI_STATE_MOSI) {
-            if (log_tx_idx > 0) {
-                /* Slave hw is ready, and Master has something to send. */
-
-                // stage A, read target address
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_BEGIN;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                gpio_write(&gpio_cs, 0);
-                spi_chunk_buffer[0] = PREAMBLE_DATA_READ;
-                spi_master_send(&spi_obj, spi_chunk_buffer, 1 * 2);
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                dummy     = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                L_address = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                H_address = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                L_size    = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                H_size    = spi_chunk_buffer[0];
-                gpio_write(&gpio_cs, 1);
-
-                // stage B, write data
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_WRITE_BEGIN;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                if (log_tx_idx % 2 != 0) {
-                    log_tx_buffer[log_tx_idx++] = 0;
-                }
-                send_len = log_tx_idx / 2;
-                L_size = send_len & 0x0000FFFF;
-                H_size = (send_len & 0xFFFF0000) >> 16;
-
-                gpio_write(&gpio_cs, 0);
-                txlen = 1;
-                spi_chunk_buffer[0] = PREAMBLE_DATA_WRITE;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = L_address;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = H_address;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = L_size;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = H_size;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                gpio_write(&gpio_cs, 0);
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_DATA_WRITE;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                txlen = log_tx_idx/2;
-                spi_master_send(&spi_obj, log_tx_buffer, txlen * 2); // sending raw data
-                gpio_write(&gpio_cs, 1);
-
-                // stage C, write data end
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_READ_WRITE_END;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                // stage final
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_END;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                L_size = log_tx_idx & 0x0000FFFF;
-                H_size = (log_tx_idx & 0xFFFF0000) >> 16;
-
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_DATA_WRITE;
-                spi_chunk_buffer[txlen++] = L_size;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_DATA_WRITE;
-                spi_chunk_buffer[txlen++] = H_size;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                // finalize
-                log_tx_idx = 0;
-            }
-
-        } else if (spi_state == SPI_STATE_MISO) {
-            /* Slave hw is ready, and Slave want to send something. */
-            do {
-                // stage A, read target address
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_BEGIN;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_DATA_READ;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                dummy     = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                L_address = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                H_address = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                L_size    = spi_chunk_buffer[0];
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2);
-                H_size    = spi_chunk_buffer[0];
-                gpio_write(&gpio_cs, 1);
-
-                recv_len = ((H_size << 16) | L_size);
-
-                if (recv_len == 0) {
-                    break;
-                }
-
-                // Stage B, confirm addr & len
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_READ_BEGIN;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                gpio_write(&gpio_cs, 0);
-                txlen = 1;
-
-                spi_chunk_buffer[0] = PREAMBLE_DATA_WRITE;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = L_address;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = H_address;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = L_size;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_chunk_buffer[0] = H_size;
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                // Stage C, begin to read
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_READ_RAW;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_DATA_READ;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                spi_master_recv(&spi_obj, spi_chunk_buffer, 1 * 2); // recv dummy
-                rxlen = recv_len;
-                spi_master_recv(&spi_obj, log_buf, rxlen * 2);
-                log_buf[rxlen*2]= '\0';
-                gpio_write(&gpio_cs, 1);
-
-                // Stage D, read end
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_READ_WRITE_END;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                // stage final
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_COMMAND;
-                spi_chunk_buffer[txlen++] = COMMAND_END;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                L_size = (recv_len) & 0x0000FFFF;
-                H_size = ((recv_len) & 0xFFFF0000) >> 16;
-
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_DATA_WRITE;
-                spi_chunk_buffer[txlen++] = L_size;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                txlen = 0;
-                spi_chunk_buffer[txlen++] = PREAMBLE_DATA_WRITE;
-                spi_chunk_buffer[txlen++] = H_size;
-
-                gpio_write(&gpio_cs, 0);
-                spi_master_send(&spi_obj, spi_chunk_buffer, txlen * 2);
-                gpio_write(&gpio_cs, 1);
-
-                // finalize
-                //printf("%s", log_buf);
-                atcmd_check_special_case(log_buf);
-                RtlUpSema(&log_rx_interrupt_sema);
-                taskYIELD();
-            } while (0);
-        }
-    }
-
-    vTaskDelete(NULL);
+	u8 *buf;
+	int i;
+
+	wifi_disable_powersave();
+
+	spi_at_free_q = xQueueCreate(SPI_AT_RX_DEPTH, sizeof(u8 *));
+	spi_at_cmd_q = xQueueCreate(SPI_AT_RX_DEPTH + 2, sizeof(struct spi_at_msg));
+	spi_at_rx_batch = rtw_zmalloc(ATSPI_XFER_MAX);
+	spi_at_rsp = rtw_zmalloc(SPI_AT_RSP_CHUNK);
+	for(i = 0; i < 2; i++){
+		buf = rtw_zmalloc(ATSPI_XFER_MAX);
+		if(buf == NULL)
+			return -1;
+		atspi_batch_reset(&spi_at_batch[i], buf, ATSPI_XFER_MAX);
+	}
+	if(!spi_at_free_q || !spi_at_cmd_q || !spi_at_rx_batch || !spi_at_rsp)
+		return -1;
+	for(i = 0; i < SPI_AT_RX_DEPTH; i++){
+		buf = rtw_zmalloc(SPI_AT_RX_SIZE);
+		if(buf == NULL)
+			return -1;
+		xQueueSend(spi_at_free_q, &buf, 0);
+	}
+	atframe_rx_reset(&spi_at_rx);
+	atframe_rx_set_buf(&spi_at_rx, NULL, 0);
+
+	rtw_init_sema(&spi_at_xfer_sema, 0);
+	rtw_init_sema(&spi_at_room_sema, 0);
+	rtw_mutex_init(&spi_at_tx_mutex);
+
+	if((SPI0_SCLK == PA_3) || (SPI0_CS == PA_2))
+		sys_jtag_off();
+
+	gpio_init(&spi_at_rdy, GPIO_RDY);
+	gpio_dir(&spi_at_rdy, PIN_OUTPUT);
+	gpio_mode(&spi_at_rdy, PullNone);
+	gpio_write(&spi_at_rdy, 0);
+
+	gpio_init(&spi_at_int, GPIO_INT);
+	gpio_dir(&spi_at_int, PIN_OUTPUT);
+	gpio_mode(&spi_at_int, PullNone);
+	gpio_write(&spi_at_int, 0);
+
+	spi_at_hw_init();
+
+	if(xTaskCreate(spi_at_exec_thread, ((const char*)"spi_at_exec"), 1024, NULL, tskIDLE_PRIORITY + 5, &spi_at_exec_task) != pdPASS){
+		printf("\n\r%s xTaskCreate(spi_at_exec_thread) failed", __FUNCTION__);
+		return -1;
+	}
+	spi_at_ready = 1;
+	if(xTaskCreate(spi_at_link_thread, ((const char*)"spi_at_link"), 1024, NULL, tskIDLE_PRIORITY + 6, NULL) != pdPASS){
+		printf("\n\r%s xTaskCreate(spi_at_link_thread) failed", __FUNCTION__);
+		spi_at_ready = 0;
+		return -1;
+	}
+	return 0;
 }
 
 static void spi_atcmd_thread(void *param)
 {
-    p_wlan_init_done_callback = NULL;
-    atcmd_wifi_restore_from_flash();
-    atcmd_lwip_restore_from_flash();
-    rtw_msleep_os(20);
-    spi_atcmd_main();
+	/* To avoid gcc warnings */
+	( void ) param;
 
-    // the rx_buffer of atcmd is to receive and sending out to log_tx
-    atcmd_lwip_set_rx_buffer(log_tx_buffer, sizeof(log_tx_buffer));
+	p_wlan_init_done_callback = NULL;
+	atcmd_wifi_restore_from_flash();
+	atcmd_lwip_restore_from_flash();
+	rtw_msleep_os(20);
 
-    at_set_debug_mask(0x0);
+	at_set_debug_mask(0x0);
 
-    if(xTaskCreate(spi_trx_thread, ((const char*)"spi_trx_thread"), 4096, NULL, tskIDLE_PRIORITY+1 , NULL) != pdPASS)
-        printf("\n\r%s xTaskCreate(spi_trx_thread) failed", __FUNCTION__);
+	if(spi_atcmd_main() < 0)
+		printf("\n\r%s SPI AT transport not started", __FUNCTION__);
 
-    vTaskDelete(NULL);
+	vTaskDelete(NULL);
 }
 
 int spi_atcmd_module_init(void){
-    if(xTaskCreate(spi_atcmd_thread, ((const char*)"spi_atcmd_thread"), 1024, NULL, tskIDLE_PRIORITY+1 , NULL) != pdPASS)
-        printf("\n\r%s xTaskCreate(spi_atcmd_thread) failed", __FUNCTION__);
-    return 0;
+	if(xTaskCreate(spi_atcmd_thread, ((const char*)"spi_atcmd_thread"), 1024, NULL, tskIDLE_PRIORITY+1 , NULL) != pdPASS)
+		printf("\n\r%s xTaskCreate(spi_atcmd_thread) failed", __FUNCTION__);
+	return 0;
 }
 
 void example_spi_atcmd(void)
 {
-    p_wlan_init_done_callback = spi_atcmd_module_init;
-    return;
+	p_wlan_init_done_callback = spi_atcmd_module_init;
+	return;
 }
 
 #endif // #if CONFIG_EXAMPLE_SPI_ATCMD
@@ -10,14 +10,21 @@
 
 #if CONFIG_EXAMPLE_SPI_ATCMD
 
-#define SPI0_MOSI  PC_2
-#define SPI0_MISO  PC_3
-#define SPI0_SCLK  PC_1
-#define SPI0_CS    PC_0
-
-#define GPIO_CS    PA_3
-#define GPIO_HRDY  PA_1
-#define GPIO_SYNC  PB_3
+/* SPI slave pinmux, PA_2/PA_3 turn JTAG off */
+#define SPI0_MOSI  PA_19
+#define SPI0_MISO  PA_20
+#define SPI0_SCLK  PA_3
+#define SPI0_CS    PA_2
+
+/* handshake outputs to the host, see at_cmd/atcmd_spi.h */
+#define GPIO_RDY   PA_17
+#define GPIO_INT   PA_18
+
+#define SPI_AT_MODE			(SPI_SCLK_IDLE_LOW|SPI_SCLK_TOGGLE_MIDDLE)
+#define SPI_AT_RX_DEPTH		4		// frames the host may keep in flight, the initial credit
+#define SPI_AT_RSP_CHUNK	1024	// max. payload of one RSP/EVT frame
+#define SPI_AT_XFER_TIMEOUT_MS	100	// phase 2 not clocked this long, resynchronize
+#define SPI_AT_TX_TIMEOUT_MS	1000	// output waiting this long for the host is dropped
 
 void example_spi_atcmd(void);
 
@@ -23,6 +23,12 @@
 #include "at_cmd/atcmd_wifi.h"
 #include "at_cmd/atcmd_lwip.h"
 #include "pinmap.h"
+#include "at_cmd/atcmd_tt_ring.h"
+#include "at_cmd/atcmd_record.h"
+#if UART_AT_FRAME_EN
+#include "at_cmd/atcmd_frame.h"
+#include "queue.h"
+#endif
 
 #if CONFIG_EXAMPLE_UART_ATCMD
 
@@ -47,79 +53,86 @@ unsigned char gAT_Echo = 1; // default echo on
 
 #define UART_AT_USE_DMA_TX 0
 
-void atcmd_update_partition_info(AT_PARTITION id, AT_PARTITION_OP ops, u8 *data, u16 len){
+static u8 uart_at_flow_ctrl = 0;	// RTS/CTS configured
+static u8 uart_at_ready = 0;		// uart_atcmd_main() done
+
+/*
+ * The AT partitions are records of a store appended to UART_SETTING_SECTOR
+ * and UART_SETTING_BACKUP_SECTOR in turn (atcmd_record.c): a change costs
+ * one record write instead of erasing and copying both sectors. A device
+ * still holding the fixed layout below is read in place and converted by
+ * the first change.
+ */
+static struct atcmd_record_store uart_at_record;
+static u8 uart_at_record_mounted = 0;
+
+static const struct atcmd_record_legacy uart_at_record_legacy[] = {
+	{AT_PARTITION_UART, UART_CONF_DATA_OFFSET, UART_CONF_DATA_SIZE},
+	{AT_PARTITION_WIFI, WIFI_CONF_DATA_OFFSET, WIFI_CONF_DATA_SIZE},
+	{AT_PARTITION_LWIP, LWIP_CONF_DATA_OFFSET, LWIP_CONF_DATA_SIZE},
+};
+
+static int uart_at_record_read(u32 addr, u32 len, u8 *data)
+{
 	flash_t flash;
-	int size, offset, i;
-	u32 read_data;
 
-	switch(id){
-		case AT_PARTITION_UART:
-			size = UART_CONF_DATA_SIZE;
-			offset = UART_CONF_DATA_OFFSET;
-			break;
-		case AT_PARTITION_WIFI:
-			size = WIFI_CONF_DATA_SIZE;
-			offset = WIFI_CONF_DATA_OFFSET;
-			break;
-		case AT_PARTITION_LWIP:
-			size = LWIP_CONF_DATA_SIZE;
-			offset = LWIP_CONF_DATA_OFFSET;
-			break;
-		case AT_PARTITION_ALL:
-			size = 0x1000;
-			offset = 0;
-			break;
-		default:
-			printf("partition id is invalid!\r\n");
-			return;
-	}
+	return (flash_stream_read(&flash, addr, len, data) == 1) ? 0 : -1;
+}
 
-	device_mutex_lock(RT_DEV_LOCK_FLASH);
+static int uart_at_record_write(u32 addr, u32 len, const u8 *data)
+{
+	flash_t flash;
 
-	if(id == AT_PARTITION_ALL && ops == AT_PARTITION_ERASE){
-		flash_erase_sector(&flash, UART_SETTING_SECTOR);
-		goto exit;
-	}
-	
-	if(ops == AT_PARTITION_READ){
-		flash_stream_read(&flash, UART_SETTING_SECTOR+offset, len, data);
-		goto exit;
-	}
+	return (flash_stream_write(&flash, addr, len, (u8 *)data) == 1) ? 0 : -1;
+}
 
-	//erase BACKUP_SECTOR
-	flash_erase_sector(&flash, UART_SETTING_BACKUP_SECTOR);
+static int uart_at_record_erase(u32 addr)
+{
+	flash_t flash;
 
-	if(ops == AT_PARTITION_WRITE){
-		// backup new data
-		flash_stream_write(&flash, UART_SETTING_BACKUP_SECTOR+offset, len, data);
-	}
-	
-	//backup front data to backup sector
-	for(i = 0; i < offset; i += sizeof(read_data)){
-		flash_read_word(&flash, UART_SETTING_SECTOR + i, &read_data);
-		flash_write_word(&flash, UART_SETTING_BACKUP_SECTOR + i,read_data);
+	flash_erase_sector(&flash, addr);
+	return 0;
+}
+
+static const struct atcmd_record_flash uart_at_record_flash = {
+	uart_at_record_read,
+	uart_at_record_write,
+	uart_at_record_erase
+};
+
+void atcmd_update_partition_info(AT_PARTITION id, AT_PARTITION_OP ops, u8 *data, u16 len){
+	int ret = 0;
+
+	if(id > AT_PARTITION_LWIP){
+		printf("partition id is invalid!\r\n");
+		return;
 	}
-	
-	//backup rear data
-	for(i = (offset + size); i < 0x1000; i += sizeof(read_data)){
-		flash_read_word(&flash, UART_SETTING_SECTOR + i, &read_data);
-		flash_write_word(&flash, UART_SETTING_BACKUP_SECTOR + i,read_data);
+
+	device_mutex_lock(RT_DEV_LOCK_FLASH);
+
+	if(!uart_at_record_mounted){
+		atcmd_record_mount(&uart_at_record, &uart_at_record_flash, UART_SETTING_SECTOR, UART_SETTING_BACKUP_SECTOR,
+			uart_at_record_legacy, sizeof(uart_at_record_legacy) / sizeof(uart_at_record_legacy[0]));
+		uart_at_record_mounted = 1;
+		AT_DBG_MSG(AT_FLAG_COMMON, AT_DBG_INFO, "AT settings: seq %d, %d bytes used, %d torn",
+			uart_at_record.seq, uart_at_record.tail, uart_at_record.torn);
 	}
-	
-	//erase UART_SETTING_SECTOR
-	flash_erase_sector(&flash, UART_SETTING_SECTOR);
-	
-	//retore data to UART_SETTING_SECTOR from UART_SETTING_BACKUP_SECTOR
-	for(i = 0; i < 0x1000; i+= sizeof(read_data)){
-		flash_read_word(&flash, UART_SETTING_BACKUP_SECTOR + i, &read_data);
-		flash_write_word(&flash, UART_SETTING_SECTOR + i,read_data);
+
+	if(id == AT_PARTITION_ALL){
+		if(ops == AT_PARTITION_ERASE)
+			ret = atcmd_record_clear(&uart_at_record);
 	}
-	
-	//erase BACKUP_SECTOR
-	flash_erase_sector(&flash, UART_SETTING_BACKUP_SECTOR);
+	else if(ops == AT_PARTITION_READ)
+		atcmd_record_read(&uart_at_record, (u8)id, data, len);
+	else if(ops == AT_PARTITION_WRITE)
+		ret = atcmd_record_write(&uart_at_record, (u8)id, data, len);
+	else
+		ret = atcmd_record_write(&uart_at_record, (u8)id, NULL, 0);
 
-exit:
 	device_mutex_unlock(RT_DEV_LOCK_FLASH);
+
+	if(ret < 0)
+		printf("AT settings: partition %d not saved\r\n", id);
 	return;
 }
 
@@ -292,6 +305,7 @@ void uart_at_rx_wakeup()
 #endif
 
 void uart_atcmd_reinit(UART_LOG_CONF* uartconf){
+	uart_at_tx_drain();
 	serial_baud(&at_cmd_sobj,uartconf->BaudRate);
 	serial_format(&at_cmd_sobj, uartconf->DataBits, (SerialParity)uartconf->Parity, uartconf->StopBits);
 
@@ -305,15 +319,729 @@ void uart_atcmd_reinit(UART_LOG_CONF* uartconf){
 	}
 	else
 		serial_set_flow_control(&at_cmd_sobj, FlowControlNone, rxflow, txflow);
+	uart_at_flow_ctrl = uartconf->FlowControl ? 1 : 0;
+}
+
+#if UART_AT_FRAME_EN
+/*
+ * Binary framed mode. RX is DMA driven by the frame codec: a header is
+ * received, then exactly the payload it announces, straight into one of
+ * UART_AT_FRAME_RX_DEPTH buffers. Complete frames are queued to the frame
+ * task, so the host can send the next commands while one executes. Output
+ * printed by the executing command is collected into RSP frames tagged with
+ * the command's seq, output of any other task goes out as EVT frames.
+ */
+#define UART_AT_FRAME_RX_SIZE	(LOG_SERVICE_BUFLEN - 1 + ATFRAME_CRC_LEN)
+#define UART_AT_FRAME_TX_SIZE	(UART_AT_FRAME_TX_CHUNK + ATFRAME_OVERHEAD)
+
+struct uart_at_frame_msg {
+	u8 *buf;	// payload, NULL for a rejected frame
+	u16 len;
+	u8 type;
+	u8 seq;
+	u8 nak;
+};
+
+static struct atframe_rx uart_at_frame_rx;
+static u8 *uart_at_frame_rx_buf;		// buffer the codec receives into
+static xQueueHandle uart_at_frame_free_q;	// free RX buffers
+static xQueueHandle uart_at_frame_cmd_q;	// struct uart_at_frame_msg
+static xTaskHandle uart_at_frame_task = NULL;
+static _sema uart_at_frame_tx_sema;
+static _mutex uart_at_frame_tx_mutex;
+static u8 *uart_at_frame_rsp;			// RSP frame under construction
+static u16 uart_at_frame_rsp_len;
+static u8 uart_at_frame_rsp_seq;
+static u8 *uart_at_frame_evt;
+static u8 uart_at_frame_evt_seq;
+static volatile u8 uart_at_frame_active = 0;
+static volatile u8 uart_at_frame_in_cmd = 0;
+static u8 uart_at_frame_exit = 0;
+static volatile u8 uart_at_frame_rx_on = 0;	// RX DMA owned by the codec
+static volatile u32 uart_at_frame_rx_tick;
+
+#if (UART_AT_TX_MODE != UART_AT_TX_BLOCKING)
+static void uart_at_tx_done(uint32_t id);
+#elif UART_AT_USE_DMA_TX
+static void uart_at_send_buf_done(uint32_t id);
+#endif
+
+int uart_at_frame_is_active(void)
+{
+	return uart_at_frame_active;
+}
+
+static void uart_at_frame_rx_arm(void)
+{
+	u16 len;
+	u8 *dst = atframe_rx_want(&uart_at_frame_rx, &len);
+
+	serial_recv_stream_dma(&at_cmd_sobj, (char *)dst, len);
+}
+
+static void uart_at_frame_rx_done(uint32_t id)
+{
+	struct uart_at_frame_msg msg;
+	portBASE_TYPE task_woken = pdFALSE;
+	u16 len;
+	int ret;
+
+	/* To avoid gcc warnings */
+	( void ) id;
+
+	if(!uart_at_frame_rx_on)
+		return;
+
+	atframe_rx_want(&uart_at_frame_rx, &len);
+	ret = atframe_rx_put(&uart_at_frame_rx, len);
+	uart_at_frame_rx_tick = xTaskGetTickCountFromISR();
+
+	if(ret != ATFRAME_RX_MORE){
+		msg.type = uart_at_frame_rx.type;
+		msg.seq = uart_at_frame_rx.seq;
+		if(ret == ATFRAME_RX_FRAME){
+			msg.buf = uart_at_frame_rx_buf;
+			msg.len = uart_at_frame_rx.len;
+			msg.nak = 0;
+			if(xQueueReceiveFromISR(uart_at_frame_free_q, &uart_at_frame_rx_buf, &task_woken) != pdTRUE)
+				uart_at_frame_rx_buf = NULL;
+			atframe_rx_set_buf(&uart_at_frame_rx, uart_at_frame_rx_buf, UART_AT_FRAME_RX_SIZE);
+		}
+		else{
+			msg.buf = NULL;
+			msg.len = 0;
+			msg.nak = uart_at_frame_rx.nak;
+		}
+		if((xQueueSendFromISR(uart_at_frame_cmd_q, &msg, &task_woken) != pdTRUE) && msg.buf)
+			xQueueSendFromISR(uart_at_frame_free_q, &msg.buf, &task_woken);
+	}
+
+	uart_at_frame_rx_arm();
+	portEND_SWITCHING_ISR(task_woken);
+}
+
+static void uart_at_frame_rx_release(u8 *buf)
+{
+	taskENTER_CRITICAL();
+	if(uart_at_frame_rx_buf == NULL){
+		/* the codec ran dry, give it the buffer directly */
+		uart_at_frame_rx_buf = buf;
+		atframe_rx_set_buf(&uart_at_frame_rx, buf, UART_AT_FRAME_RX_SIZE);
+		buf = NULL;
+	}
+	taskEXIT_CRITICAL();
+	if(buf)
+		xQueueSend(uart_at_frame_free_q, &buf, 0);
+}
+
+static void uart_at_frame_tx_done(uint32_t id)
+{
+	/* To avoid gcc warnings */
+	( void ) id;
+
+	rtw_up_sema_from_isr(&uart_at_frame_tx_sema);
+}
+
+/* caller holds uart_at_frame_tx_mutex */
+static void uart_at_frame_send(u8 *frame, u16 len)
+{
+	if(serial_send_stream_dma(&at_cmd_sobj, (char *)frame, len) == HAL_OK){
+		rtw_down_sema(&uart_at_frame_tx_sema);
+		return;
+	}
+	while(len--)
+		serial_putc(&at_cmd_sobj, *frame++);
+}
+
+static void uart_at_frame_rsp_flush(u8 flags)
+{
+	u16 len;
+
+	rtw_mutex_get(&uart_at_frame_tx_mutex);
+	len = atframe_seal(uart_at_frame_rsp, ATFRAME_TYPE_RSP | flags, uart_at_frame_rsp_seq, uart_at_frame_rsp_len);
+	uart_at_frame_send(uart_at_frame_rsp, len);
+	rtw_mutex_put(&uart_at_frame_tx_mutex);
+	uart_at_frame_rsp_len = 0;
+}
+
+static void uart_at_frame_nak(u8 seq, u8 reason)
+{
+	u16 len;
+
+	rtw_mutex_get(&uart_at_frame_tx_mutex);
+	len = atframe_encode(uart_at_frame_evt, UART_AT_FRAME_TX_SIZE, ATFRAME_TYPE_NAK, seq, &reason, 1);
+	uart_at_frame_send(uart_at_frame_evt, len);
+	rtw_mutex_put(&uart_at_frame_tx_mutex);
+}
+
+static void uart_at_frame_output(const u8 *data, u32 len)
+{
+	u32 n;
+
+	if(uart_at_frame_in_cmd && (xTaskGetCurrentTaskHandle() == uart_at_frame_task)){
+		while(len){
+			/* a full frame only goes out flagged MORE once more output follows */
+			if(uart_at_frame_rsp_len == UART_AT_FRAME_TX_CHUNK)
+				uart_at_frame_rsp_flush(ATFRAME_FLAG_MORE);
+			n = UART_AT_FRAME_TX_CHUNK - uart_at_frame_rsp_len;
+			if(n > len)
+				n = len;
+			memcpy(uart_at_frame_rsp + ATFRAME_HDR_LEN + uart_at_frame_rsp_len, data, n);
+			uart_at_frame_rsp_len += n;
+			data += n;
+			len -= n;
+		}
+		return;
+	}
+
+	rtw_mutex_get(&uart_at_frame_tx_mutex);
+	while(len){
+		n = (len > UART_AT_FRAME_TX_CHUNK) ? UART_AT_FRAME_TX_CHUNK : len;
+		memcpy(uart_at_frame_evt + ATFRAME_HDR_LEN, data, n);
+		uart_at_frame_send(uart_at_frame_evt, atframe_seal(uart_at_frame_evt, ATFRAME_TYPE_EVT, uart_at_frame_evt_seq++, n));
+		data += n;
+		len -= n;
+	}
+	rtw_mutex_put(&uart_at_frame_tx_mutex);
+}
+
+static void uart_at_frame_exec(struct uart_at_frame_msg *msg)
+{
+	u16 len = msg->len;
+	char *data;
+
+#if CONFIG_LOG_SERVICE_LOCK
+	log_service_lock();
+#endif
+	memcpy(log_buf, msg->buf, len);
+	log_buf[len] = '\0';
+	uart_at_frame_rx_release(msg->buf);
+
+	/* same layout the text path hands to data commands: header '\0' raw data */
+	if(strncmp(log_buf, "ATPT", C_NUM_AT_CMD) == 0){
+		data = memchr(log_buf, ':', len);
+		if(data)
+			*data = '\0';
+	}
+
+	uart_at_frame_rsp_seq = msg->seq;
+	uart_at_frame_rsp_len = 0;
+	uart_at_frame_in_cmd = 1;
+	log_service_exec(log_buf);
+	uart_at_frame_in_cmd = 0;
+	uart_at_frame_rsp_flush(0);
+	log_buf[0] = '\0';
+#if CONFIG_LOG_SERVICE_LOCK
+	log_service_unlock();
+#endif
+}
+
+static void uart_at_frame_stop(void)
+{
+	struct uart_at_frame_msg msg;
+
+	uart_at_frame_active = 0;
+	uart_at_frame_rx_on = 0;
+	serial_recv_stream_abort(&at_cmd_sobj);
+	/* commands pipelined behind the one that left framed mode are dropped */
+	while(xQueueReceive(uart_at_frame_cmd_q, &msg, 0) == pdTRUE){
+		if(msg.buf)
+			uart_at_frame_rx_release(msg.buf);
+	}
+#if (UART_AT_TX_MODE != UART_AT_TX_BLOCKING)
+	serial_send_comp_handler(&at_cmd_sobj, (void*)uart_at_tx_done, (uint32_t)&at_cmd_sobj);
+#elif UART_AT_USE_DMA_TX
+	serial_send_comp_handler(&at_cmd_sobj, (void*)uart_at_send_buf_done, (uint32_t)&at_cmd_sobj);
+#endif
+	serial_irq_set(&at_cmd_sobj, RxIrq, 1);
+	at_printf(STR_END_OF_ATCMD_RET);
+}
+
+static void uart_at_frame_check_stall(void)
+{
+	if(!uart_at_frame_active || atframe_rx_idle(&uart_at_frame_rx))
+		return;
+	if(rtw_systime_to_ms(xTaskGetTickCount() - uart_at_frame_rx_tick) > UART_AT_FRAME_RX_TIMEOUT_MS){
+		/* the host stopped mid frame, drop it and hunt for the next header */
+		uart_at_frame_rx_on = 0;
+		serial_recv_stream_abort(&at_cmd_sobj);
+		atframe_rx_reset(&uart_at_frame_rx);
+		uart_at_frame_rx.errors++;
+		uart_at_frame_rx_tick = xTaskGetTickCount();
+		uart_at_frame_rx_on = 1;
+		uart_at_frame_rx_arm();
+	}
+}
+
+static void uart_at_frame_thread(void *param)
+{
+	struct uart_at_frame_msg msg;
+
+	/* To avoid gcc warnings */
+	( void ) param;
+
+	while(1){
+		if(xQueueReceive(uart_at_frame_cmd_q, &msg, UART_AT_FRAME_RX_TIMEOUT_MS / portTICK_RATE_MS) != pdTRUE){
+			uart_at_frame_check_stall();
+			continue;
+		}
+		if(!uart_at_frame_active){
+			if(msg.buf)
+				uart_at_frame_rx_release(msg.buf);
+			continue;
+		}
+		if(msg.buf == NULL){
+			uart_at_frame_nak(msg.seq, msg.nak);
+			continue;
+		}
+		if((msg.type & ATFRAME_TYPE_MASK) != ATFRAME_TYPE_CMD){
+			uart_at_frame_rx_release(msg.buf);
+			uart_at_frame_nak(msg.seq, ATFRAME_NAK_TYPE);
+			continue;
+		}
+		uart_at_frame_exec(&msg);
+		if(uart_at_frame_exit){
+			uart_at_frame_exit = 0;
+			uart_at_frame_stop();
+		}
+	}
+}
+
+/**
+ * Allocate the framed mode buffers and task, once.
+ */
+int uart_at_frame_init(void)
+{
+	static int rx_bufs = 0, locks = 0;
+	u8 *buf;
+
+	if(uart_at_frame_task)
+		return 0;
+
+	/* resumes where a previous attempt ran out of memory */
+	if(!uart_at_frame_free_q)
+		uart_at_frame_free_q = xQueueCreate(UART_AT_FRAME_RX_DEPTH, sizeof(u8 *));
+	if(!uart_at_frame_cmd_q)
+		uart_at_frame_cmd_q = xQueueCreate(UART_AT_FRAME_RX_DEPTH + 2, sizeof(struct uart_at_frame_msg));
+	if(!uart_at_frame_rsp)
+		uart_at_frame_rsp = rtw_zmalloc(UART_AT_FRAME_TX_SIZE);
+	if(!uart_at_frame_evt)
+		uart_at_frame_evt = rtw_zmalloc(UART_AT_FRAME_TX_SIZE);
+	if(!uart_at_frame_free_q || !uart_at_frame_cmd_q || !uart_at_frame_rsp || !uart_at_frame_evt)
+		return -1;
+	for(; rx_bufs < UART_AT_FRAME_RX_DEPTH; rx_bufs++){
+		buf = rtw_zmalloc(UART_AT_FRAME_RX_SIZE);
+		if(buf == NULL)
+			return -1;
+		xQueueSend(uart_at_frame_free_q, &buf, 0);
+	}
+	if(!locks){
+		rtw_init_sema(&uart_at_frame_tx_sema, 0);
+		rtw_mutex_init(&uart_at_frame_tx_mutex);
+		locks = 1;
+	}
+
+	if(xTaskCreate(uart_at_frame_thread, ((const char*)"uart_at_frame"), 1024, NULL, tskIDLE_PRIORITY + 5, &uart_at_frame_task) != pdPASS){
+		printf("\n\r%s xTaskCreate(uart_at_frame_thread) failed", __FUNCTION__);
+		uart_at_frame_task = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Switch the AT UART to framed mode. Called by ATSF after its text reply,
+ * uart_at_frame_init() must have succeeded.
+ */
+void uart_at_frame_start(void)
+{
+	if(uart_at_frame_active || (uart_at_frame_task == NULL))
+		return;
+
+	/* the text reply of ATSF leaves before the TX DMA changes hands */
+	uart_at_tx_drain();
+	serial_irq_set(&at_cmd_sobj, RxIrq, 0);
+	serial_recv_comp_handler(&at_cmd_sobj, (void*)uart_at_frame_rx_done, (uint32_t)&at_cmd_sobj);
+	serial_send_comp_handler(&at_cmd_sobj, (void*)uart_at_frame_tx_done, (uint32_t)&at_cmd_sobj);
+
+	atframe_rx_reset(&uart_at_frame_rx);
+	if(uart_at_frame_rx_buf == NULL)
+		xQueueReceive(uart_at_frame_free_q, &uart_at_frame_rx_buf, 0);
+	atframe_rx_set_buf(&uart_at_frame_rx, uart_at_frame_rx_buf, UART_AT_FRAME_RX_SIZE);
+	uart_at_frame_rx_tick = xTaskGetTickCount();
+	uart_at_frame_exit = 0;
+	uart_at_frame_active = 1;
+	uart_at_frame_rx_on = 1;
+	uart_at_frame_rx_arm();
+}
+
+/**
+ * Leave framed mode once the current command's response has been sent.
+ */
+void uart_at_frame_stop_request(void)
+{
+	if(uart_at_frame_active)
+		uart_at_frame_exit = 1;
+}
+#else
+int uart_at_frame_is_active(void)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Transparent transmission RX. The UART receives by DMA into the buffers of
+ * a ring, a completed buffer is committed from the interrupt and the TT task
+ * (atcmd_lwip_tt_handler) sends it while DMA already fills the next one. The
+ * TT task flushes a partial buffer when no buffer completed for
+ * ATCMD_LWIP_TT_MAX_DELAY_TIME_MS. Once every buffer waits for the socket,
+ * DMA stops and RTS is raised (with flow control configured) until the TT
+ * task releases a buffer; without flow control the UART FIFO overruns.
+ */
+static struct atcmd_tt_ring uart_at_tt_ring;
+static volatile u8 uart_at_tt_on = 0;		// RX owned by the ring
+static volatile u8 uart_at_tt_rx_on = 0;	// a DMA transfer is armed
+static u8 uart_at_tt_idle = 0;			// the next buffer starts after a flush
+
+/* interrupt or critical section */
+static void uart_at_tt_rx_arm(void)
+{
+	u8 *buf = atcmd_tt_ring_fill(&uart_at_tt_ring);
+
+	if(buf == NULL){
+		uart_at_tt_rx_on = 0;
+		if(uart_at_flow_ctrl)
+			serial_rts_control(&at_cmd_sobj, 0);
+		return;
+	}
+	uart_at_tt_rx_on = 1;
+	serial_recv_stream_dma(&at_cmd_sobj, (char *)buf, UART_AT_TT_BUF_SIZE);
+}
+
+static void uart_at_tt_commit(u16 len)
+{
+	atcmd_tt_ring_commit(&uart_at_tt_ring, len, uart_at_tt_idle ? ATCMD_TT_F_IDLE : 0);
+	uart_at_tt_idle = 0;
+}
+
+static void uart_at_tt_rx_done(uint32_t id)
+{
+	/* To avoid gcc warnings */
+	( void ) id;
+
+	if(!uart_at_tt_rx_on)
+		return;
+
+	uart_at_tt_commit(UART_AT_TT_BUF_SIZE);
+	uart_at_tt_rx_arm();
+	rtw_up_sema_from_isr(&atcmd_lwip_tt_sema);
+}
+
+static void uart_at_tt_engage(void)
+{
+	serial_irq_set(&at_cmd_sobj, RxIrq, 0);
+	serial_recv_comp_handler(&at_cmd_sobj, (void*)uart_at_tt_rx_done, (uint32_t)&at_cmd_sobj);
+	uart_at_tt_idle = 1;
+	taskENTER_CRITICAL();
+	uart_at_tt_on = 1;
+	uart_at_tt_rx_arm();
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * Switch UART RX to the TT ring. Called by atcmd_lwip_start_tt_task(), also
+ * before uart_atcmd_main() when TT mode is restored from flash.
+ *
+ * @return the ring the TT task consumes, NULL if out of memory or the UART
+ *         is in framed mode
+ */
+struct atcmd_tt_ring *uart_at_tt_start(void)
+{
+	u8 *mem;
+
+	if(uart_at_tt_ring.mem)
+		return &uart_at_tt_ring;
+	if(uart_at_frame_is_active())
+		return NULL;
+
+	mem = rtw_malloc(UART_AT_TT_BUF_NUM * UART_AT_TT_BUF_SIZE);
+	if(mem == NULL)
+		return NULL;
+	atcmd_tt_ring_init(&uart_at_tt_ring, mem, UART_AT_TT_BUF_NUM, UART_AT_TT_BUF_SIZE);
+
+	if(uart_at_ready)
+		uart_at_tt_engage();
+	return &uart_at_tt_ring;
+}
+
+/**
+ * Commit what DMA has received into the current buffer so far. TT task only.
+ */
+void uart_at_tt_flush(void)
+{
+	s32 len;
+
+	taskENTER_CRITICAL();
+	/* a transfer that already completed is committed by its interrupt */
+	if(uart_at_tt_rx_on && (at_cmd_sobj.uart_adp.state & HAL_UART_STATE_DMARX_BUSY)){
+		uart_at_tt_rx_on = 0;
+		len = serial_recv_stream_abort(&at_cmd_sobj);
+		if(len > 0)
+			uart_at_tt_commit((u16)len);
+		uart_at_tt_idle = 1;
+		uart_at_tt_rx_arm();
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * Give the oldest buffer back to the ring, resumes a stalled receiver.
+ * TT task only.
+ */
+void uart_at_tt_release(void)
+{
+	atcmd_tt_ring_release(&uart_at_tt_ring);
+
+	taskENTER_CRITICAL();
+	if(uart_at_tt_on && !uart_at_tt_rx_on){
+		uart_at_tt_rx_arm();
+		if(uart_at_tt_rx_on && uart_at_flow_ctrl)
+			serial_rts_control(&at_cmd_sobj, 1);
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * Back to interrupt RX for the command line, data still in the ring is
+ * dropped.
+ */
+void uart_at_tt_stop(void)
+{
+	if(uart_at_tt_ring.mem == NULL)
+		return;
+
+	taskENTER_CRITICAL();
+	uart_at_tt_on = 0;
+	uart_at_tt_rx_on = 0;
+	taskEXIT_CRITICAL();
+	if(uart_at_ready){
+		serial_recv_stream_abort(&at_cmd_sobj);
+		if(uart_at_flow_ctrl)
+			serial_rts_control(&at_cmd_sobj, 1);
+		serial_irq_set(&at_cmd_sobj, RxIrq, 1);
+	}
+
+	AT_DBG_MSG(AT_FLAG_LWIP, AT_DBG_ALWAYS, "TT RX: %d bytes, %d flushes, %d stalls",
+		uart_at_tt_ring.bytes, uart_at_tt_ring.flushes, uart_at_tt_ring.stalls);
+	rtw_free(uart_at_tt_ring.mem);
+	uart_at_tt_ring.mem = NULL;
+}
+
+#if (UART_AT_TX_MODE != UART_AT_TX_BLOCKING)
+/*
+ * Text mode output goes through a ring and leaves by DMA: at_printf() only
+ * copies, and whatever was queued while a transfer ran goes out in the next
+ * one. In UART_AT_TX_RESPONSE mode the output of the command being executed
+ * by log_service is held until uart_at_resp_end(), or until the ring is half
+ * full, so a scan list or connection table leaves in few transfers. Output
+ * of other tasks is never held, the ring keeps the order of everything.
+ */
+#if (UART_AT_TX_RING_SIZE & (UART_AT_TX_RING_SIZE - 1))
+#error "UART_AT_TX_RING_SIZE must be a power of two"
+#endif
+#define UART_AT_TX_COPY_MAX		256	// bytes copied per critical section
+
+static u8 uart_at_tx_ring[UART_AT_TX_RING_SIZE];
+static volatile u32 uart_at_tx_head = 0;	// bytes queued
+static volatile u32 uart_at_tx_tail = 0;	// bytes sent
+static volatile u32 uart_at_tx_len = 0;		// transfer in progress, 0 if idle
+static volatile u8 uart_at_tx_pio = 0;		// no GDMA, the caller sends by hand
+static _sema uart_at_tx_space_sema;
+static xTaskHandle uart_at_tx_hold_task = NULL;
+
+/* interrupt or critical section: claim the next contiguous chunk */
+static u32 uart_at_tx_chunk(u32 *off)
+{
+	u32 len;
+
+	if(uart_at_tx_len || (uart_at_tx_head == uart_at_tx_tail))
+		return 0;
+	*off = uart_at_tx_tail & (UART_AT_TX_RING_SIZE - 1);
+	len = uart_at_tx_head - uart_at_tx_tail;
+	if(len > UART_AT_TX_RING_SIZE - *off)
+		len = UART_AT_TX_RING_SIZE - *off;
+	uart_at_tx_len = len;
+	return len;
+}
+
+/* interrupt or critical section */
+static void uart_at_tx_start(void)
+{
+	u32 off, len;
+
+	if(uart_at_tx_pio)
+		return;
+	len = uart_at_tx_chunk(&off);
+	if(len && (serial_send_stream_dma(&at_cmd_sobj, (char *)&uart_at_tx_ring[off], len) != HAL_OK)){
+		uart_at_tx_pio = 1;
+		uart_at_tx_len = 0;
+	}
+}
+
+static void uart_at_tx_done(uint32_t id)
+{
+	/* To avoid gcc warnings */
+	( void ) id;
+
+	uart_at_tx_tail += uart_at_tx_len;
+	uart_at_tx_len = 0;
+	uart_at_tx_start();
+	rtw_up_sema_from_isr(&uart_at_tx_space_sema);
+}
+
+static void uart_at_tx_kick(void)
+{
+	u32 off, len, i;
+
+	if(!uart_at_ready)
+		return;
+
+	taskENTER_CRITICAL();
+	uart_at_tx_start();
+	taskEXIT_CRITICAL();
+
+	while(uart_at_tx_pio){
+		taskENTER_CRITICAL();
+		len = uart_at_tx_chunk(&off);
+		taskEXIT_CRITICAL();
+		if(len == 0)
+			break;
+		for(i = 0; i < len; i++)
+			serial_putc(&at_cmd_sobj, uart_at_tx_ring[off + i]);
+		taskENTER_CRITICAL();
+		uart_at_tx_tail += len;
+		uart_at_tx_len = 0;
+		taskEXIT_CRITICAL();
+	}
+}
+
+static void uart_at_tx_write(const u8 *data, u32 len)
+{
+	u32 n, off, first, used;
+	int held;
+
+	while(len){
+		taskENTER_CRITICAL();
+		used = uart_at_tx_head - uart_at_tx_tail;
+		n = UART_AT_TX_RING_SIZE - used;
+		if(n > len)
+			n = len;
+		if(n > UART_AT_TX_COPY_MAX)
+			n = UART_AT_TX_COPY_MAX;
+		off = uart_at_tx_head & (UART_AT_TX_RING_SIZE - 1);
+		first = (n < UART_AT_TX_RING_SIZE - off) ? n : (UART_AT_TX_RING_SIZE - off);
+		memcpy(&uart_at_tx_ring[off], data, first);
+		memcpy(uart_at_tx_ring, data + first, n - first);
+		uart_at_tx_head += n;
+		used += n;
+		taskEXIT_CRITICAL();
+		data += n;
+		len -= n;
+
+		if(!uart_at_ready){
+			/* printed before the UART is up, it goes out with the first kick */
+			if(n == 0)
+				return;
+			continue;
+		}
+		held = (uart_at_tx_hold_task != NULL) && (uart_at_tx_hold_task == xTaskGetCurrentTaskHandle()) &&
+			(used < UART_AT_TX_RING_SIZE / 2);
+		if(!held)
+			uart_at_tx_kick();
+		if(n == 0)
+			rtw_down_timeout_sema(&uart_at_tx_space_sema, 10);
+	}
+}
+
+/**
+ * Send everything queued and wait for it to leave the UART. Needed before
+ * the UART is reconfigured, handed to framed mode or the system resets.
+ */
+void uart_at_tx_drain(void)
+{
+	if(!uart_at_ready)
+		return;
+
+	uart_at_tx_kick();
+	while((uart_at_tx_head != uart_at_tx_tail) || uart_at_tx_len){
+		rtw_down_timeout_sema(&uart_at_tx_space_sema, 10);
+		uart_at_tx_kick();
+	}
+}
+
+/**
+ * log_service brackets each command with these, UART_AT_TX_RESPONSE holds
+ * the output of the command in between.
+ */
+void uart_at_resp_begin(void)
+{
+#if (UART_AT_TX_MODE == UART_AT_TX_RESPONSE)
+	uart_at_tx_hold_task = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+void uart_at_resp_end(void)
+{
+	uart_at_tx_hold_task = NULL;
+	uart_at_tx_kick();
+}
+
+static void uart_at_tx_init(void)
+{
+	rtw_init_sema(&uart_at_tx_space_sema, 0);
+	serial_send_comp_handler(&at_cmd_sobj, (void*)uart_at_tx_done, (uint32_t)&at_cmd_sobj);
+}
+#else
+void uart_at_tx_drain(void)
+{
+}
+
+void uart_at_resp_begin(void)
+{
+}
+
+void uart_at_resp_end(void)
+{
+}
+#endif
+
+/* for the RX interrupt, which cannot queue */
+static void uart_at_putc_string(serial_t *sobj, const char *str)
+{
+	while(*str)
+		serial_putc(sobj, *str++);
 }
 
 void uart_at_send_string(char *str)
 {
 	unsigned int i=0;
+#if UART_AT_FRAME_EN
+	if(uart_at_frame_active){
+		uart_at_frame_output((u8 *)str, strlen(str));
+		return;
+	}
+#endif
+#if (UART_AT_TX_MODE != UART_AT_TX_BLOCKING)
+	/* To avoid gcc warnings */
+	( void ) i;
+	uart_at_tx_write((u8 *)str, strlen(str));
+#else
 	while (str[i] != '\0') {
 		serial_putc(&at_cmd_sobj, str[i]);
 		i++;
 	}
+#endif
 }
 
 #if UART_AT_USE_DMA_TX
@@ -331,7 +1059,15 @@ void uart_at_send_buf(u8 *buf, u32 len)
 	if(!len || (!buf)){
 		return;
 	}
-#if UART_AT_USE_DMA_TX
+#if UART_AT_FRAME_EN
+	if(uart_at_frame_active){
+		uart_at_frame_output(buf, len);
+		return;
+	}
+#endif
+#if (UART_AT_TX_MODE != UART_AT_TX_BLOCKING)
+	uart_at_tx_write(st_p, len);
+#elif UART_AT_USE_DMA_TX
 	int ret;
 	while(rtw_down_sema(&uart_at_dma_tx_sema) == _TRUE){
 		ret = serial_send_stream_dma(&at_cmd_sobj, st_p, len);
@@ -379,6 +1115,8 @@ void uart_irq(uint32_t id, SerialIrq event)
 	if(event == RxIrq) {
 		rc = serial_getc(sobj);
 		
+		/* TT mode normally receives by DMA (uart_at_tt_*), this byte path
+		 * is left for builds whose TT task does not use the ring */
 		if(atcmd_lwip_is_tt_mode()){
 			if(atcmd_lwip_tt_datasize < LOG_SERVICE_BUFLEN){
 				log_buf[atcmd_lwip_tt_datasize++] = rc;
@@ -420,7 +1158,7 @@ void uart_irq(uint32_t id, SerialIrq event)
 			
 			if(data_cmd_sz){
 				if((!gAT_Echo) && (rtw_systime_to_ms(xTaskGetTickCountFromISR() - last_tickcnt) > UART_AT_MAX_DELAY_TIME_MS)){
-					uart_at_send_string("\r\nERROR: data timeout\r\n\n# ");
+					uart_at_putc_string(sobj, "\r\nERROR: data timeout\r\n\n# ");
 					memset(log_buf, 0, buf_count);
 					is_data_cmd = _FALSE;
 					data_sz = 0;
@@ -475,7 +1213,7 @@ void uart_irq(uint32_t id, SerialIrq event)
 				buf_count=0;
 				last_tickcnt = 0;
 			}else{
-				uart_at_send_string(STR_END_OF_ATCMD_RET);
+				uart_at_putc_string(sobj, STR_END_OF_ATCMD_RET);
 			}
 		}
 		else if(rc == KEY_BS){
@@ -495,7 +1233,7 @@ void uart_irq(uint32_t id, SerialIrq event)
 				// some consoles send "\r\n" for enter, 
 				//so skip '\n' here to prevent ERROR message each time it sends command
 				if(gAT_Echo == 1 && rc != KEY_NL){
-					uart_at_send_string("\r\nERROR:command should start with 'A'"STR_END_OF_ATCMD_RET);
+					uart_at_putc_string(sobj, "\r\nERROR:command should start with 'A'"STR_END_OF_ATCMD_RET);
 				}
 				return;
 			}
@@ -509,7 +1247,7 @@ void uart_irq(uint32_t id, SerialIrq event)
 			else if(buf_count == (LOG_SERVICE_BUFLEN - 1)){
 				temp_buf[buf_count] = '\0';
 				if(gAT_Echo == 1){
-					uart_at_send_string("\r\nERROR:exceed size limit"STR_END_OF_ATCMD_RET);
+					uart_at_putc_string(sobj, "\r\nERROR:exceed size limit"STR_END_OF_ATCMD_RET);
 				}
 			}
 		}
@@ -536,6 +1274,7 @@ void uart_atcmd_main(void)
 	}
 	else
 		serial_set_flow_control(&at_cmd_sobj, FlowControlNone, rxflow, txflow);
+	uart_at_flow_ctrl = uartconf.FlowControl ? 1 : 0;
 
 	/*uart_at_lock_init();*/
 
@@ -550,6 +1289,17 @@ void uart_atcmd_main(void)
 	serial_irq_handler(&at_cmd_sobj, uart_irq, (uint32_t)&at_cmd_sobj);
 	serial_irq_set(&at_cmd_sobj, RxIrq, 1);
 
+#if (UART_AT_TX_MODE != UART_AT_TX_BLOCKING)
+	uart_at_tx_init();
+#endif
+	uart_at_ready = 1;
+#if (UART_AT_TX_MODE != UART_AT_TX_BLOCKING)
+	uart_at_tx_kick();
+#endif
+	/* TT mode restored from flash before the UART was up */
+	if(uart_at_tt_ring.mem)
+		uart_at_tt_engage();
+
 #if ATCMD_RX_GPIO_WAKEUP
 #if defined(configUSE_WAKELOCK_PMU) && (configUSE_WAKELOCK_PMU == 1)
 	uart_at_rx_wakeup();
@@ -40,6 +40,23 @@
 #endif
 
 #define ATCMD_RX_GPIO_WAKEUP 0
+
+/* Binary framed AT mode (ATSF=1), see at_cmd/atcmd_frame.h */
+#define UART_AT_FRAME_EN			1
+#define UART_AT_FRAME_RX_DEPTH		3	// commands the host may keep in flight
+#define UART_AT_FRAME_TX_CHUNK		512	// max. payload of one RSP/EVT frame
+#define UART_AT_FRAME_RX_TIMEOUT_MS	100	// a frame stalled this long is dropped
+
+/* Transparent transmission RX, see at_cmd/atcmd_tt_ring.h */
+#define UART_AT_TT_BUF_NUM			4		// DMA receives into one while the others are sent
+#define UART_AT_TT_BUF_SIZE			1460	// one TCP segment per send()
+
+/* Text mode output */
+#define UART_AT_TX_BLOCKING			0	// serial_putc() per byte in the caller
+#define UART_AT_TX_QUEUED			1	// copied to a ring, sent by DMA while the caller goes on
+#define UART_AT_TX_RESPONSE			2	// as QUEUED, a command's output is held and sent in one go when it completes
+#define UART_AT_TX_MODE				UART_AT_TX_RESPONSE
+#define UART_AT_TX_RING_SIZE		2048	// power of two
 #define KEY_NL			0xa // '\n'
 #define KEY_ENTER		0xd // '\r'
 #define KEY_BS			0x8
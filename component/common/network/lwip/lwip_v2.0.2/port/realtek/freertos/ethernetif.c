@@ -50,11 +50,14 @@
 #include "lwip/sys.h"
 #include "lwip/tcpip.h"
 #include "lwip/icmp.h"
+#include "lwip/snmp.h"
+#include "lwip/ip4_frag.h"
 #include "netif/etharp.h"
 #include "err.h"
 #include "ethernetif.h"
 #include "queue.h"
 #include "lwip_netconf.h"
+#include "snmp/snmp_ameba.h"
 
 #include "lwip/ethip6.h" //Add for ipv6
 
@@ -63,6 +66,9 @@
 
 #if CONFIG_WLAN
 #include <lwip_intf.h>
+#if ETHERNETIF_MCAST_FILTER && ETHERNETIF_MCAST_SYNC_DRIVER
+#include <wifi_conf.h>
+#endif
 #endif
 
 #if defined(CONFIG_INIC_HOST) && CONFIG_INIC_HOST
@@ -87,6 +93,15 @@ static void arp_timer(void *arg);
 extern void rltk_mii_recv(struct eth_drv_sg *sg_list, int sg_len);
 extern s8 rltk_mii_send(struct eth_drv_sg *sg_list, int sg_len, int total_len);
 
+#if ETHERNETIF_MCAST_FILTER
+#if LWIP_IGMP
+static err_t ethernetif_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+static err_t ethernetif_mld_mac_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action);
+#endif
+#endif
+
 /**
  * In this function, the hardware should be initialized.
  * Called from ethernetif_init().
@@ -110,6 +125,19 @@ static void low_level_init(struct netif *netif)
 #if LWIP_IGMP
 	/* make LwIP_Init do igmp_start to add group 224.0.0.1 */
 	netif->flags |= NETIF_FLAG_IGMP;
+#if ETHERNETIF_MCAST_FILTER
+	netif_set_igmp_mac_filter(netif, ethernetif_igmp_mac_filter);
+#endif
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD && ETHERNETIF_MCAST_FILTER
+	/* all-nodes is joined implicitly by lwIP, let it through the filter */
+	{
+		ip6_addr_t ip6_allnodes_ll;
+		ip6_addr_set_allnodes_linklocal(&ip6_allnodes_ll);
+		netif_set_mld_mac_filter(netif, ethernetif_mld_mac_filter);
+		ethernetif_mld_mac_filter(netif, &ip6_allnodes_ll, NETIF_ADD_MAC_FILTER);
+	}
 #endif
 
 	/* Wlan interface is initialized later */
@@ -141,8 +169,10 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
 	int sg_len = 0;
 	struct pbuf *q;
 #if CONFIG_WLAN
-	if(!rltk_wlan_running(netif_get_idx(netif)))
+	if(!rltk_wlan_running(netif_get_idx(netif))) {
+		SNMP_AMEBA_CNT_INC(tx_drop_ifdown);
 		return ERR_IF;
+	}
 #endif
 	for (q = p; q != NULL && sg_len < MAX_ETH_DRV_SG; q = q->next) {
 		sg_list[sg_len].buf = (unsigned int) q->payload;
@@ -157,9 +187,17 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
 #else
                 if(1)
 #endif
+		{
+			SNMP_AMEBA_CNT_INC(tx_frames);
+			SNMP_AMEBA_CNT_ADD(tx_octets, p->tot_len);
+			MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
 			return ERR_OK;
-		else
+		}
+		else {
+			SNMP_AMEBA_CNT_INC(tx_drop_busy);
+			MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
 			return ERR_BUF;	// return a non-fatal error
+		}
 	}
 	return ERR_OK;
 }
@@ -207,6 +245,64 @@ static err_t low_level_output_mii(struct netif *netif, struct pbuf *p)
 //void ethernetif_input( void * pvParameters )
 
 
+#if ETHERNETIF_MCAST_FILTER
+/* The group table is in ethernetif_mcast.c; the WLAN driver filter follows it here */
+static err_t mcast_update(struct netif *netif, const u8_t *mac, enum netif_mac_filter_action action)
+{
+	u8_t changed;
+	err_t err = ethernetif_mcast_update(netif, mac, action, &changed);
+
+#if CONFIG_WLAN && ETHERNETIF_MCAST_SYNC_DRIVER
+	if(changed && (netif_get_idx(netif) == 0) && rltk_wlan_running(0)) {
+		rtw_mac_t group;
+		memcpy(group.octet, mac, ETHARP_HWADDR_LEN);
+		if(action == NETIF_ADD_MAC_FILTER)
+			wifi_register_multicast_address(&group);
+		else
+			wifi_unregister_multicast_address(&group);
+	}
+#else
+	(void) changed;
+#endif
+	return err;
+}
+
+#if LWIP_IGMP
+static err_t ethernetif_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action)
+{
+	u8_t mac[ETHARP_HWADDR_LEN];
+	u32_t addr = lwip_ntohl(ip4_addr_get_u32(group));
+
+	/* 01:00:5e + low 23 bits of the group address */
+	mac[0] = 0x01;
+	mac[1] = 0x00;
+	mac[2] = 0x5e;
+	mac[3] = (u8_t)((addr >> 16) & 0x7f);
+	mac[4] = (u8_t)(addr >> 8);
+	mac[5] = (u8_t)addr;
+	return mcast_update(netif, mac, action);
+}
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+static err_t ethernetif_mld_mac_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action)
+{
+	u8_t mac[ETHARP_HWADDR_LEN];
+	u32_t addr = lwip_ntohl(group->addr[3]);
+
+	/* 33:33 + low 32 bits of the group address */
+	mac[0] = 0x33;
+	mac[1] = 0x33;
+	mac[2] = (u8_t)(addr >> 24);
+	mac[3] = (u8_t)(addr >> 16);
+	mac[4] = (u8_t)(addr >> 8);
+	mac[5] = (u8_t)addr;
+	return mcast_update(netif, mac, action);
+}
+#endif
+
+#endif /* ETHERNETIF_MCAST_FILTER */
+
 /* Refer to eCos eth_drv_recv to do similarly in ethernetif_input */
 void ethernetif_recv(struct netif *netif, int total_len)
 {
@@ -214,8 +310,20 @@ void ethernetif_recv(struct netif *netif, int total_len)
 	struct pbuf *p, *q;
 	int sg_len = 0;
 #if CONFIG_WLAN
-	if(!rltk_wlan_running(netif_get_idx(netif)))
+	if(!rltk_wlan_running(netif_get_idx(netif))) {
+		SNMP_AMEBA_CNT_INC(rx_drop_ifdown);
 		return;
+	}
+#if ETHERNETIF_MCAST_FILTER
+	/* peek at the destination MAC while the frame is still in the driver skb */
+	if(total_len >= ETHARP_HWADDR_LEN) {
+		struct sk_buff *skb = rltk_wlan_get_recv_skb(netif_get_idx(netif));
+		if(skb && !ethernetif_mcast_accept(netif, skb->data)) {
+			SNMP_AMEBA_CNT_INC(rx_drop_mcast);
+			return;
+		}
+	}
+#endif
 #endif
 	if ((total_len > MAX_ETH_MSG) || (total_len < 0))
 		total_len = MAX_ETH_MSG;
@@ -223,9 +331,18 @@ void ethernetif_recv(struct netif *netif, int total_len)
 	// Allocate buffer to store received packet
 	p = pbuf_alloc(PBUF_RAW, total_len, PBUF_POOL);
 	if (p == NULL) {
+		SNMP_AMEBA_CNT_INC(rx_drop_nopbuf);
+		MIB2_STATS_NETIF_INC(netif, ifindiscards);
+#if LWIP_IPV4 && IP_REASSEMBLY
+		/* let the tcpip thread release pool pbufs held by stale fragments */
+		ip_reass_mem_pressure();
+#endif
 		printf("\n\rCannot allocate pbuf to receive packet");
 		return;
 	}
+	SNMP_AMEBA_CNT_INC(rx_frames);
+	SNMP_AMEBA_CNT_ADD(rx_octets, total_len);
+	MIB2_STATS_NETIF_ADD(netif, ifinoctets, total_len);
 
 	// Create scatter list
 	for (q = p; q != NULL && sg_len < MAX_ETH_DRV_SG; q = q->next) {
@@ -16,10 +16,50 @@ struct eth_drv_sg {
 #define MAX_ETH_DRV_SG	32
 #define MAX_ETH_MSG	1540
 
+/*
+ * Multicast group filter. lwIP reports every IGMP/MLD group join and leave
+ * through the netif mac filter hooks; the resulting MAC addresses are kept in
+ * a small hash table that ethernetif_recv() checks against the destination of
+ * each received frame before a pbuf is allocated. Frames to groups nobody
+ * joined are dropped in the WLAN RX path instead of in ip4_input(). While
+ * more groups are joined than the table holds, no multicast is dropped.
+ */
+#ifndef ETHERNETIF_MCAST_FILTER
+#define ETHERNETIF_MCAST_FILTER		(LWIP_IGMP || (LWIP_IPV6 && LWIP_IPV6_MLD))
+#endif
+
+/* Max. multicast MAC addresses over all interfaces */
+#ifndef ETHERNETIF_MCAST_MAX_GROUPS
+#define ETHERNETIF_MCAST_MAX_GROUPS	16
+#endif
+
+/* Hash buckets, must be a power of 2 */
+#ifndef ETHERNETIF_MCAST_HASH_SIZE
+#define ETHERNETIF_MCAST_HASH_SIZE	16
+#endif
+
+/* Also register groups with the WLAN driver filter (STA interface only) */
+#ifndef ETHERNETIF_MCAST_SYNC_DRIVER
+#define ETHERNETIF_MCAST_SYNC_DRIVER	0
+#endif
+
+struct ethernetif_mcast_group {
+	u8_t netif_num;
+	u8_t mac[6];
+	u32_t hits;		/* frames accepted for this group */
+};
+
 void ethernetif_recv(struct netif *netif, int total_len);
 err_t ethernetif_init(struct netif *netif);
 err_t ethernetif_mii_init(struct netif *netif);
 void lwip_PRE_SLEEP_PROCESSING(void);
 void lwip_POST_SLEEP_PROCESSING(void);
+#if ETHERNETIF_MCAST_FILTER
+err_t ethernetif_mcast_update(struct netif *netif, const u8_t *mac, enum netif_mac_filter_action action, u8_t *changed);
+int ethernetif_mcast_accept(struct netif *netif, const u8_t *dst);
+int ethernetif_mcast_get_groups(struct ethernetif_mcast_group *groups, int max_groups);
+u32_t ethernetif_mcast_get_dropped(void);
+u16_t ethernetif_mcast_get_overflow(void);
+#endif
 
 #endif 
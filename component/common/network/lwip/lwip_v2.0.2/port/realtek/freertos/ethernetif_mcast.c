@@ -0,0 +1,222 @@
+/******************************************************************************
+ *
+ * Multicast group filter of ethernetif.c, see ethernetif.h.
+ *
+ * Kept apart from the WLAN glue so that it builds without the driver, for the
+ * lwIP unit tests (test/unit/ethernetif).
+ *
+ ******************************************************************************/
+#include "lwip/opt.h"
+#include "lwip/sys.h"
+#include "lwip/prot/etharp.h"
+#include "ethernetif.h"
+
+#include <string.h>
+
+#if ETHERNETIF_MCAST_FILTER
+/*
+ * Multicast MAC table. Entries are chained per hash bucket through an index
+ * so the table needs no allocation; the same MAC joined through several IP
+ * groups (32:1 IPv4 mapping) shares one reference counted entry. Join/leave
+ * run in the tcpip thread, lookups in the WLAN RX path, both under
+ * SYS_ARCH_PROTECT.
+ *
+ * lwIP does not undo a join its filter hook failed, so a join that finds the
+ * table full is counted in mcast_overflow instead, and all IGMP/MLD
+ * multicast is let through until as many leaves of MACs not in the table
+ * came in.
+ */
+#define MCAST_NONE		0xFF
+
+struct mcast_entry {
+	u8_t mac[ETHARP_HWADDR_LEN];
+	u8_t netif_num;
+	u8_t next;
+	u16_t refs;
+	u32_t hits;
+};
+
+static struct mcast_entry mcast_table[ETHERNETIF_MCAST_MAX_GROUPS];
+static u8_t mcast_bucket[ETHERNETIF_MCAST_HASH_SIZE];
+static u8_t mcast_inited;
+static u16_t mcast_overflow;
+static u32_t mcast_dropped;
+
+static u8_t mcast_hash(const u8_t *mac)
+{
+	/* the group bits of both IPv4 (01:00:5e) and IPv6 (33:33) are in the low bytes */
+	return (u8_t)((mac[3] * 31 + mac[4]) * 31 + mac[5]) & (ETHERNETIF_MCAST_HASH_SIZE - 1);
+}
+
+static void mcast_init(void)
+{
+	int i;
+
+	for(i = 0; i < ETHERNETIF_MCAST_HASH_SIZE; i++)
+		mcast_bucket[i] = MCAST_NONE;
+	memset(mcast_table, 0, sizeof(mcast_table));
+	mcast_inited = 1;
+}
+
+static struct mcast_entry *mcast_find(u8_t netif_num, const u8_t *mac, u8_t **link)
+{
+	u8_t *prev = &mcast_bucket[mcast_hash(mac)];
+	u8_t idx;
+
+	for(idx = *prev; idx != MCAST_NONE; idx = mcast_table[idx].next) {
+		struct mcast_entry *e = &mcast_table[idx];
+		if((e->netif_num == netif_num) && (memcmp(e->mac, mac, ETHARP_HWADDR_LEN) == 0)) {
+			if(link)
+				*link = prev;
+			return e;
+		}
+		prev = &e->next;
+	}
+	return NULL;
+}
+
+/**
+ * Join or leave a multicast MAC on a netif, from its IGMP/MLD mac filter hook.
+ *
+ * @param changed set to 1 if the MAC went in or out of the table
+ * @return ERR_MEM if the table is full: the group is then let through
+ *         anyway, with all other multicast, until it is left
+ */
+err_t ethernetif_mcast_update(struct netif *netif, const u8_t *mac, enum netif_mac_filter_action action, u8_t *changed)
+{
+	struct mcast_entry *e;
+	u8_t *link = NULL;
+	err_t err = ERR_OK;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	*changed = 0;
+	SYS_ARCH_PROTECT(lev);
+	if(!mcast_inited)
+		mcast_init();
+	e = mcast_find(netif->num, mac, &link);
+	if(action == NETIF_ADD_MAC_FILTER) {
+		if(e) {
+			e->refs++;
+		}
+		else {
+			u8_t idx;
+			for(idx = 0; idx < ETHERNETIF_MCAST_MAX_GROUPS; idx++)
+				if(mcast_table[idx].refs == 0)
+					break;
+			if(idx < ETHERNETIF_MCAST_MAX_GROUPS) {
+				u8_t *head = &mcast_bucket[mcast_hash(mac)];
+				e = &mcast_table[idx];
+				memcpy(e->mac, mac, ETHARP_HWADDR_LEN);
+				e->netif_num = netif->num;
+				e->refs = 1;
+				e->hits = 0;
+				e->next = *head;
+				*head = idx;
+				*changed = 1;
+			}
+			else {
+				mcast_overflow++;
+				err = ERR_MEM;
+			}
+		}
+	}
+	else if(e) {
+		if(--e->refs == 0) {
+			*link = e->next;
+			*changed = 1;
+		}
+	}
+	else if(mcast_overflow) {
+		/* one of the groups that did not fit */
+		mcast_overflow--;
+	}
+	SYS_ARCH_UNPROTECT(lev);
+
+	if(err != ERR_OK)
+		LWIP_PLATFORM_DIAG(("\n\rmulticast filter table full, passing all multicast"));
+	return err;
+}
+
+/**
+ * @return 1 if a frame to dst may be passed to lwIP. Only multicast MACs lwIP
+ * manages (IPv4 with IGMP enabled on the netif, IPv6 with MLD) are filtered;
+ * broadcast and other link multicast is always accepted, and so is all of it
+ * while a joined group is missing from the table.
+ */
+int ethernetif_mcast_accept(struct netif *netif, const u8_t *dst)
+{
+	struct mcast_entry *e;
+	int accept;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	if(!(dst[0] & 0x01))
+		return 1;
+#if LWIP_IGMP
+	if((dst[0] == 0x01) && (dst[1] == 0x00) && (dst[2] == 0x5e)) {
+		if(!(netif->flags & NETIF_FLAG_IGMP))
+			return 1;
+	}
+	else
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+	if((dst[0] == 0x33) && (dst[1] == 0x33)) {
+		/* filtered */
+	}
+	else
+#endif
+		return 1;
+
+	SYS_ARCH_PROTECT(lev);
+	e = mcast_inited ? mcast_find(netif->num, dst, NULL) : NULL;
+	accept = (e != NULL) || (mcast_overflow != 0);
+	if(e)
+		e->hits++;
+	else if(!accept)
+		mcast_dropped++;
+	SYS_ARCH_UNPROTECT(lev);
+
+	return accept;
+}
+
+/**
+ * Copy the joined multicast groups and their hit counters.
+ *
+ * @param groups array receiving up to max_groups entries
+ * @return number of entries written
+ */
+int ethernetif_mcast_get_groups(struct ethernetif_mcast_group *groups, int max_groups)
+{
+	int i, n = 0;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	SYS_ARCH_PROTECT(lev);
+	for(i = 0; (i < ETHERNETIF_MCAST_MAX_GROUPS) && (n < max_groups); i++) {
+		if(mcast_table[i].refs) {
+			groups[n].netif_num = mcast_table[i].netif_num;
+			memcpy(groups[n].mac, mcast_table[i].mac, ETHARP_HWADDR_LEN);
+			groups[n].hits = mcast_table[i].hits;
+			n++;
+		}
+	}
+	SYS_ARCH_UNPROTECT(lev);
+
+	return n;
+}
+
+/**
+ * @return number of multicast frames dropped because no group was joined
+ */
+u32_t ethernetif_mcast_get_dropped(void)
+{
+	return mcast_dropped;
+}
+
+/**
+ * @return number of joins that found the table full and are not left yet;
+ *         multicast is not filtered while it is not 0
+ */
+u16_t ethernetif_mcast_get_overflow(void)
+{
+	return mcast_overflow;
+}
+#endif /* ETHERNETIF_MCAST_FILTER */
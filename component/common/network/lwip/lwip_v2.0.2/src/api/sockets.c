@@ -289,6 +289,11 @@ static struct lwip_select_cb *select_cb_list;
     and checked in event_callback to see if it has changed. */
 static volatile int select_cb_ctr;
 
+/* Added by Realtek start */
+/** Called by event_callback() for every socket event, see lwip_set_event_hook() */
+static lwip_event_hook_fn socket_event_hook;
+/* Added by Realtek end */
+
 #if LWIP_SOCKET_SET_ERRNO
 #ifndef set_errno
 #define set_errno(err) do { if (err) { errno = (err); } } while(0)
@@ -770,7 +775,10 @@ lwip_recvfrom(int s, void *mem, size_t len, int flags,
           return off;
         }
         LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recvfrom(%d): returning EWOULDBLOCK\n", s));
-        set_errno(EWOULDBLOCK);
+/* Added by Realtek start */
+        /* also on the socket, for lwip_getsocklasterr() without LWIP_SOCKET_SET_ERRNO */
+        sock_set_errno(sock, EWOULDBLOCK);
+/* Added by Realtek end */
         return -1;
       }
 
@@ -1630,6 +1638,14 @@ event_callback(struct netconn *conn, enum netconn_evt evt, u16_t len)
       break;
   }
 
+/* Added by Realtek start */
+  if (socket_event_hook != NULL) {
+    SYS_ARCH_UNPROTECT(lev);
+    socket_event_hook(s, (int)evt);
+    SYS_ARCH_PROTECT(lev);
+  }
+/* Added by Realtek end */
+
   if (sock->select_waiting == 0) {
     /* noone is waiting for this socket, no need to check select_cb_list */
     SYS_ARCH_UNPROTECT(lev);
@@ -1779,6 +1795,20 @@ lwip_getpeername(int s, struct sockaddr *name, socklen_t *namelen)
   return lwip_getaddrname(s, name, namelen, 0);
 }
 
+/* Added by Realtek start */
+/**
+ * Register a function called for every socket event, after the socket state
+ * was updated (evt is an enum netconn_evt). It runs in the context raising
+ * the event, mostly the tcpip thread, so it may only signal and return.
+ * This lets one task serve many sockets without select().
+ */
+void
+lwip_set_event_hook(lwip_event_hook_fn hook)
+{
+  socket_event_hook = hook;
+}
+/* Added by Realtek end */
+
 /* Added by Realtek start */
 int
 lwip_getsocklasterr(int s)
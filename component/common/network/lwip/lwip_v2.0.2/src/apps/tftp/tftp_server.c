@@ -63,6 +63,7 @@
 #define TFTP_DATA  3
 #define TFTP_ACK   4
 #define TFTP_ERROR 5
+#define TFTP_OACK  6
 
 enum tftp_error {
   TFTP_ERROR_FILE_NOT_FOUND    = 1,
@@ -74,12 +75,16 @@ enum tftp_error {
   TFTP_ERROR_NO_SUCH_USER      = 7
 };
 
+/* Options (RFC 2347) accepted from a request */
+#define TFTP_OPT_BLKSIZE      0x01
+#define TFTP_OPT_WINDOWSIZE   0x02
+
 #include <string.h>
+#include <stdlib.h>
 
 struct tftp_state {
   const struct tftp_context *ctx;
   void *handle;
-  struct pbuf *last_data;
   struct udp_pcb *upcb;
   ip_addr_t addr;
   u16_t port;
@@ -88,22 +93,48 @@ struct tftp_state {
   u16_t blknum;
   u8_t retries;
   u8_t mode_write;
+  /* Added by Realtek: negotiated block size (RFC 2348) and window (RFC 7440) */
+  u16_t blksize;
+  u16_t windowsize;
+  /* Packets sent but not acknowledged yet (DATA blocks starting at block
+   * number win_base, or the OACK), kept for retransmission */
+  struct pbuf *window[TFTP_MAX_WINDOWSIZE];
+  u16_t win_base;
+  u8_t win_count;
+  /* Read: the last block of the file has been read */
+  u8_t eof;
+  /* Write: blocks received in order since the last ACK */
+  u16_t win_rcvd;
+  /* Write: the gap in the received blocks has been reported */
+  u8_t gap_acked;
 };
 
 static struct tftp_state tftp_state;
 
 static void tftp_tmr(void* arg);
 
+static void
+free_window(u8_t count)
+{
+  u8_t i;
+
+  for (i = 0; i < count; i++) {
+    pbuf_free(tftp_state.window[i]);
+  }
+  tftp_state.win_count = (u8_t)(tftp_state.win_count - count);
+  for (i = 0; i < tftp_state.win_count; i++) {
+    tftp_state.window[i] = tftp_state.window[i + count];
+  }
+  tftp_state.win_base = (u16_t)(tftp_state.win_base + count);
+}
+
 static void
 close_handle(void)
 {
   tftp_state.port = 0;
   ip_addr_set_any(0, &tftp_state.addr);
 
-  if(tftp_state.last_data != NULL) {
-    pbuf_free(tftp_state.last_data);
-    tftp_state.last_data = NULL;
-  }
+  free_window(tftp_state.win_count);
 
   sys_untimeout(tftp_tmr, NULL);
   
@@ -154,14 +185,14 @@ send_ack(u16_t blknum)
 }
 
 static void
-resend_data(void)
+send_copy(struct pbuf *q)
 {
-  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, tftp_state.last_data->len, PBUF_RAM);
+  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, q->len, PBUF_RAM);
   if(p == NULL) {
     return;
   }
 
-  if(pbuf_copy(p, tftp_state.last_data) != ERR_OK) {
+  if(pbuf_copy(p, q) != ERR_OK) {
     pbuf_free(p);
     return;
   }
@@ -171,33 +202,140 @@ resend_data(void)
 }
 
 static void
+resend_data(void)
+{
+  u8_t i;
+
+  for (i = 0; i < tftp_state.win_count; i++) {
+    send_copy(tftp_state.window[i]);
+  }
+}
+
+static int
 send_data(void)
 {
+  struct pbuf *p;
   u16_t *payload;
   int ret;
 
-  if(tftp_state.last_data != NULL) {
-    pbuf_free(tftp_state.last_data);
-  }
-  
-  tftp_state.last_data = pbuf_alloc(PBUF_TRANSPORT, TFTP_HEADER_LENGTH + TFTP_MAX_PAYLOAD_SIZE, PBUF_RAM);
-  if(tftp_state.last_data == NULL) {
-    return;
+  p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(TFTP_HEADER_LENGTH + tftp_state.blksize), PBUF_RAM);
+  if(p == NULL) {
+    return -1;
   }
 
-  payload = (u16_t *) tftp_state.last_data->payload;
+  payload = (u16_t *) p->payload;
   payload[0] = PP_HTONS(TFTP_DATA);
   payload[1] = lwip_htons(tftp_state.blknum);
 
-  ret = tftp_state.ctx->read(tftp_state.handle, &payload[2], TFTP_MAX_PAYLOAD_SIZE);
+  ret = tftp_state.ctx->read(tftp_state.handle, &payload[2], tftp_state.blksize);
   if (ret < 0) {
+    pbuf_free(p);
     send_error(&tftp_state.addr, tftp_state.port, TFTP_ERROR_ACCESS_VIOLATION, "Error occured while reading the file.");
     close_handle();
-    return;
+    return -1;
+  }
+
+  pbuf_realloc(p, (u16_t)(TFTP_HEADER_LENGTH + ret));
+  tftp_state.eof = (ret < tftp_state.blksize);
+  tftp_state.window[tftp_state.win_count++] = p;
+  tftp_state.blknum++;
+  send_copy(p);
+  return 0;
+}
+
+/* Send new blocks until the window is full or the file is read completely */
+static void
+fill_window(void)
+{
+  while ((tftp_state.handle != NULL) && !tftp_state.eof &&
+         (tftp_state.win_count < tftp_state.windowsize)) {
+    if (send_data() != 0) {
+      break;
+    }
   }
+}
+
+/*
+ * Parse the options (RFC 2347) following the mode string of a request,
+ * set the transfer parameters and return the options accepted.
+ * Unknown options are ignored.
+ */
+static u8_t
+parse_options(struct pbuf *p, u16_t offset)
+{
+  const char tftp_null = 0;
+  char name[TFTP_MAX_OPTION_LEN];
+  char value[TFTP_MAX_OPTION_LEN];
+  u8_t accepted = 0;
+
+  while (offset < p->tot_len) {
+    u16_t name_end = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), offset);
+    u16_t value_end;
+    int val;
+
+    if (name_end == 0xFFFF) {
+      break;
+    }
+    value_end = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), name_end + 1);
+    if (value_end == 0xFFFF) {
+      break;
+    }
+    if (((u16_t)(name_end - offset) < sizeof(name)) &&
+        ((u16_t)(value_end - name_end - 1) < sizeof(value))) {
+      pbuf_copy_partial(p, name, name_end - offset + 1, offset);
+      pbuf_copy_partial(p, value, value_end - name_end, name_end + 1);
+      val = atoi(value);
+
+      if ((lwip_stricmp(name, "blksize") == 0) && (val >= 8)) {
+        tftp_state.blksize = (u16_t)LWIP_MIN(val, TFTP_MAX_BLKSIZE);
+        accepted |= TFTP_OPT_BLKSIZE;
+      } else if ((lwip_stricmp(name, "windowsize") == 0) && (val >= 1)) {
+        tftp_state.windowsize = (u16_t)LWIP_MIN(val, TFTP_MAX_WINDOWSIZE);
+        accepted |= TFTP_OPT_WINDOWSIZE;
+      }
+    }
+    offset = value_end + 1;
+  }
+  return accepted;
+}
+
+static u16_t
+append_option(char *buf, u16_t len, const char *name, u16_t val)
+{
+  u16_t name_len = (u16_t)(strlen(name) + 1);
 
-  pbuf_realloc(tftp_state.last_data, (u16_t)(TFTP_HEADER_LENGTH + ret));
-  resend_data();
+  MEMCPY(buf + len, name, name_len);
+  len = (u16_t)(len + name_len);
+  lwip_itoa(buf + len, 6, val);
+  return (u16_t)(len + strlen(buf + len) + 1);
+}
+
+/* Acknowledge the accepted options. The OACK is kept in the window so that it
+ * is retransmitted until the client answers it. */
+static void
+send_oack(u8_t accepted)
+{
+  char buf[TFTP_HEADER_LENGTH + sizeof("blksize") + 6 + sizeof("windowsize") + 6];
+  u16_t len = 2;
+  struct pbuf *p;
+
+  buf[0] = 0;
+  buf[1] = TFTP_OACK;
+  if (accepted & TFTP_OPT_BLKSIZE) {
+    len = append_option(buf, len, "blksize", tftp_state.blksize);
+  }
+  if (accepted & TFTP_OPT_WINDOWSIZE) {
+    len = append_option(buf, len, "windowsize", tftp_state.windowsize);
+  }
+
+  p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+  if (p == NULL) {
+    return;
+  }
+  pbuf_take(p, buf, len);
+  tftp_state.window[0] = p;
+  tftp_state.win_count = 1;
+  send_copy(p);
 }
 
 static void
@@ -230,6 +368,7 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       char mode[TFTP_MAX_MODE_LEN];
       u16_t filename_end_offset;
       u16_t mode_end_offset;
+      u8_t options;
 
       if(tftp_state.handle != NULL) {
         send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "Only one connection at a time is supported");
@@ -240,11 +379,11 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
       /* find \0 in pbuf -> end of filename string */
       filename_end_offset = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), 2);
-      if((u16_t)(filename_end_offset-2) > sizeof(filename)) {
+      if((u16_t)(filename_end_offset-1) > sizeof(filename)) {
         send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "Filename too long/not NULL terminated");
         break;
       }
-      pbuf_copy_partial(p, filename, filename_end_offset-2, 2);
+      pbuf_copy_partial(p, filename, filename_end_offset-1, 2);
 
       /* find \0 in pbuf -> end of mode string */
       mode_end_offset = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), filename_end_offset+1);
@@ -253,9 +392,17 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
         break;
       }
       pbuf_copy_partial(p, mode, mode_end_offset-filename_end_offset, filename_end_offset+1);
+
+      tftp_state.blksize = TFTP_MAX_PAYLOAD_SIZE;
+      tftp_state.windowsize = 1;
+      options = parse_options(p, (u16_t)(mode_end_offset + 1));
  
       tftp_state.handle = tftp_state.ctx->open(filename, mode, opcode == PP_HTONS(TFTP_WRQ));
       tftp_state.blknum = 1;
+      tftp_state.win_base = options ? 0 : 1;
+      tftp_state.win_rcvd = 0;
+      tftp_state.gap_acked = 0;
+      tftp_state.eof = 0;
 
       if (!tftp_state.handle) {
         send_error(addr, port, TFTP_ERROR_FILE_NOT_FOUND, "Unable to open requested file.");
@@ -264,17 +411,20 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
       LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: %s request from ", (opcode == PP_HTONS(TFTP_WRQ)) ? "write" : "read"));
       ip_addr_debug_print(TFTP_DEBUG | LWIP_DBG_STATE, addr);
-      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, (" for '%s' mode '%s'\n", filename, mode));
+      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, (" for '%s' mode '%s' blksize %"U16_F" windowsize %"U16_F"\n",
+        filename, mode, tftp_state.blksize, tftp_state.windowsize));
 
       ip_addr_copy(tftp_state.addr, *addr);
       tftp_state.port = port;
+      tftp_state.mode_write = (opcode == PP_HTONS(TFTP_WRQ));
 
-      if (opcode == PP_HTONS(TFTP_WRQ)) {
-        tftp_state.mode_write = 1;
+      if (options) {
+        /* transfer starts when the client answers the OACK */
+        send_oack(options);
+      } else if (tftp_state.mode_write) {
         send_ack(0);
       } else {
-        tftp_state.mode_write = 0;
-        send_data();
+        fill_window();
       }
 
       break;
@@ -295,18 +445,45 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
         break;
       }
 
+      /* any DATA answers the OACK */
+      free_window(tftp_state.win_count);
+
       blknum = lwip_ntohs(sbuf[1]);
+      if (blknum != tftp_state.blknum) {
+        /* A block was lost or repeated: acknowledge the last block received in
+         * order, the client then sends again from the block after it
+         * (RFC 7440). Report a gap once, but always answer a repeated block. */
+        if (!tftp_state.gap_acked || ((u16_t)(blknum + 1) == tftp_state.blknum)) {
+          send_ack((u16_t)(tftp_state.blknum - 1));
+          tftp_state.gap_acked = 1;
+        }
+        tftp_state.win_rcvd = 0;
+        break;
+      }
+
       pbuf_header(p, -TFTP_HEADER_LENGTH);
 
       ret = tftp_state.ctx->write(tftp_state.handle, p);
+      if (ret == ERR_WOULDBLOCK) {
+        /* not taken: handled like a lost block, the client sends it again */
+        tftp_state.win_rcvd = 0;
+        break;
+      }
       if (ret < 0) {
         send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "error writing file");
         close_handle();
-      } else {
+        break;
+      }
+
+      tftp_state.blknum++;
+      tftp_state.win_rcvd++;
+      tftp_state.gap_acked = 0;
+      if ((tftp_state.win_rcvd >= tftp_state.windowsize) || (p->tot_len < tftp_state.blksize)) {
         send_ack(blknum);
+        tftp_state.win_rcvd = 0;
       }
 
-      if (p->tot_len < TFTP_MAX_PAYLOAD_SIZE) {
+      if (p->tot_len < tftp_state.blksize) {
         close_handle();
       }
       break;
@@ -315,7 +492,7 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
     case PP_HTONS(TFTP_ACK):
     {
       u16_t blknum;
-      int lastpkt;
+      s16_t acked;
 
       if (tftp_state.handle == NULL) {
         send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "No connection");
@@ -327,27 +504,39 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
         break;
       }
 
+      /* number of packets at the head of the window acknowledged by this ACK */
       blknum = lwip_ntohs(sbuf[1]);
-      if (blknum != tftp_state.blknum) {
-        send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+      acked = (s16_t)(blknum - tftp_state.win_base + 1);
+      if (acked <= 0) {
+        /* RFC 7440: duplicate or stale ACK of blocks acknowledged before,
+           dropped, the timer retransmits if needed */
         break;
       }
-
-      lastpkt = 0;
-
-      if (tftp_state.last_data != NULL) {
-        lastpkt = tftp_state.last_data->tot_len != (TFTP_MAX_PAYLOAD_SIZE + TFTP_HEADER_LENGTH);
+      if (acked > tftp_state.win_count) {
+        /* beyond the last block sent */
+        send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+        break;
       }
+      free_window((u8_t)acked);
 
-      if (!lastpkt) {
-        tftp_state.blknum++;
-        send_data();
-      } else {
+      if ((tftp_state.win_count == 0) && tftp_state.eof) {
         close_handle();
+        break;
       }
 
+      /* RFC 7440: blocks after the acknowledged one were lost, send them again */
+      resend_data();
+      fill_window();
       break;
     }
+
+    case PP_HTONS(TFTP_ERROR):
+      /* the client aborts the transfer, e.g. rejects the OACK */
+      if (tftp_state.handle != NULL) {
+        LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: transfer aborted by client\n"));
+        close_handle();
+      }
+      break;
     
     default:
       send_error(addr, port, TFTP_ERROR_ILLEGAL_OPERATION, "Unknown operation");
@@ -371,14 +560,21 @@ tftp_tmr(void* arg)
   sys_timeout(TFTP_TIMER_MSECS, tftp_tmr, NULL);
 
   if ((tftp_state.timer - tftp_state.last_pkt) > (TFTP_TIMEOUT_MSECS / TFTP_TIMER_MSECS)) {
-    if ((tftp_state.last_data != NULL) && (tftp_state.retries < TFTP_MAX_RETRIES)) {
+    if ((tftp_state.win_count != 0) && (tftp_state.retries < TFTP_MAX_RETRIES)) {
       LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout, retrying\n"));
       resend_data();
       tftp_state.retries++;
+    } else if (tftp_state.mode_write && (tftp_state.retries < TFTP_MAX_RETRIES)) {
+      /* our last ACK may have been lost, repeat it */
+      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout, acknowledging again\n"));
+      send_ack((u16_t)(tftp_state.blknum - 1));
+      tftp_state.win_rcvd = 0;
+      tftp_state.retries++;
     } else {
       LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout\n"));
       close_handle();
     }
+    tftp_state.last_pkt = tftp_state.timer;
   }
 }
 
@@ -402,11 +598,8 @@ tftp_init(const struct tftp_context *ctx)
     return ret;
   }
 
-  tftp_state.handle    = NULL;
-  tftp_state.port      = 0;
+  memset(&tftp_state, 0, sizeof(tftp_state));
   tftp_state.ctx       = ctx;
-  tftp_state.timer     = 0;
-  tftp_state.last_data = NULL;
   tftp_state.upcb      = pcb;
 
   udp_recv(pcb, recv, NULL);
@@ -414,4 +607,26 @@ tftp_init(const struct tftp_context *ctx)
   return ERR_OK;
 }
 
+/** @ingroup tftp
+ * Deinitialize TFTP server, aborting a transfer in progress.
+ */
+void
+tftp_cleanup(void)
+{
+  LWIP_ASSERT("Cleanup called on non-initialized TFTP", tftp_state.upcb != NULL);
+  close_handle();
+  udp_remove(tftp_state.upcb);
+  memset(&tftp_state, 0, sizeof(tftp_state));
+}
+
+/** @ingroup tftp
+ * Block size negotiated for the transfer in progress. A block written with
+ * fewer bytes than this is the last one of the file.
+ */
+u16_t
+tftp_get_blksize(void)
+{
+  return tftp_state.blksize;
+}
+
 #endif /* LWIP_UDP */
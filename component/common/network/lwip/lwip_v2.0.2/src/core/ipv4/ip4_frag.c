@@ -113,10 +113,16 @@ PACK_STRUCT_END
 /* global variables */
 static struct ip_reassdata *reassdatagrams;
 static u16_t ip_reass_pbufcount;
+/* Added by Realtek: set from any context by ip_reass_mem_pressure(), consumed in the tcpip thread */
+static volatile u8_t ip_reass_pressure;
 
 /* function prototypes */
 static void ip_reass_dequeue_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev);
 static int ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev);
+#if IP_REASS_FREE_OLDEST
+static int ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed, const ip4_addr_p_t *src);
+#endif /* IP_REASS_FREE_OLDEST */
+static void ip_reass_relieve_pressure(struct ip_hdr *fraghdr);
 
 /**
  * Reassembly timer base function
@@ -129,6 +135,9 @@ ip_reass_tmr(void)
 {
   struct ip_reassdata *r, *prev = NULL;
 
+  /* Added by Realtek: release fragments if the receive path ran out of pbufs */
+  ip_reass_relieve_pressure(NULL);
+
   r = reassdatagrams;
   while (r != NULL) {
     /* Decrement the timer. Once it reaches 0,
@@ -218,13 +227,14 @@ ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *p
  * Free the oldest datagram to make room for enqueueing new fragments.
  * The datagram 'fraghdr' belongs to is not freed!
  *
- * @param fraghdr IP header of the current fragment
+ * @param fraghdr IP header of the current fragment (may be NULL)
  * @param pbufs_needed number of pbufs needed to enqueue
  *        (used for freeing other datagrams if not enough space)
+ * @param src if not NULL, only datagrams from this source are freed
  * @return the number of pbufs freed
  */
 static int
-ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed)
+ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed, const ip4_addr_p_t *src)
 {
   /* @todo Can't we simply remove the last datagram in the
    *       linked list behind reassdatagrams?
@@ -242,7 +252,8 @@ ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed)
     other_datagrams = 0;
     r = reassdatagrams;
     while (r != NULL) {
-      if (!IP_ADDRESSES_AND_ID_MATCH(&r->iphdr, fraghdr)) {
+      if (((fraghdr == NULL) || !IP_ADDRESSES_AND_ID_MATCH(&r->iphdr, fraghdr)) &&
+          ((src == NULL) || ip4_addr_cmp(&r->iphdr.src, src))) {
         /* Not the same datagram as fraghdr */
         other_datagrams++;
         if (oldest == NULL) {
@@ -268,6 +279,111 @@ ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed)
 }
 #endif /* IP_REASS_FREE_OLDEST */
 
+/* Added by Realtek start */
+/**
+ * Signal that the receive path could not allocate a pbuf. May be called from
+ * any context (e.g. the WLAN RX task); incomplete datagrams are released the
+ * next time the reassembly code runs in the tcpip thread.
+ */
+void
+ip_reass_mem_pressure(void)
+{
+  ip_reass_pressure = 1;
+}
+
+/**
+ * If memory pressure was signalled, free incomplete datagrams (oldest first,
+ * never the one 'fraghdr' belongs to) until at most IP_REASS_PRESSURE_LOW_WATER
+ * pbufs are left enqueued.
+ */
+static void
+ip_reass_relieve_pressure(struct ip_hdr *fraghdr)
+{
+  if (!ip_reass_pressure) {
+    return;
+  }
+  ip_reass_pressure = 0;
+
+  while (ip_reass_pbufcount > IP_REASS_PRESSURE_LOW_WATER) {
+    struct ip_reassdata *r, *prev = NULL, *oldest = NULL, *oldest_prev = NULL;
+
+    for (r = reassdatagrams; r != NULL; prev = r, r = r->next) {
+      if ((fraghdr != NULL) && IP_ADDRESSES_AND_ID_MATCH(&r->iphdr, fraghdr)) {
+        continue;
+      }
+      if ((oldest == NULL) || (r->timer <= oldest->timer)) {
+        oldest = r;
+        oldest_prev = prev;
+      }
+    }
+    if (oldest == NULL) {
+      break;
+    }
+    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass_relieve_pressure: dropping datagram ID=%"X16_F"\n",
+      lwip_ntohs(IPH_ID(&oldest->iphdr))));
+    IPFRAG_STATS_INC(ip_frag.memerr);
+    ip_reass_free_complete_datagram(oldest, oldest_prev);
+  }
+}
+
+/**
+ * Enforce IP_REASS_MAX_PBUFS_PER_SRC for the source of 'fraghdr'.
+ *
+ * @return 1 if 'clen' more pbufs from this source may be enqueued, 0 otherwise
+ */
+static int
+ip_reass_check_src_quota(struct ip_hdr *fraghdr, u16_t clen)
+{
+  struct ip_reassdata *r;
+  u16_t src_pbufs = 0;
+
+  for (r = reassdatagrams; r != NULL; r = r->next) {
+    if (ip4_addr_cmp(&r->iphdr.src, &fraghdr->src)) {
+      src_pbufs = (u16_t)(src_pbufs + r->pbufcount);
+    }
+  }
+  if ((src_pbufs + clen) <= IP_REASS_MAX_PBUFS_PER_SRC) {
+    return 1;
+  }
+#if IP_REASS_FREE_OLDEST
+  /* this source competes with itself: free its own oldest datagrams first */
+  src_pbufs = (u16_t)(src_pbufs - ip_reass_remove_oldest_datagram(fraghdr,
+    (src_pbufs + clen) - IP_REASS_MAX_PBUFS_PER_SRC, &fraghdr->src));
+  if ((src_pbufs + clen) <= IP_REASS_MAX_PBUFS_PER_SRC) {
+    return 1;
+  }
+#endif /* IP_REASS_FREE_OLDEST */
+  return 0;
+}
+
+#if IP_REASS_COPY_CONTIGUOUS
+/**
+ * Copy a reassembled datagram into one PBUF_RAM pbuf so the pool pbufs of the
+ * fragments can be reused right away. Returns 'p' unchanged if it is too big
+ * or the heap is exhausted.
+ */
+static struct pbuf *
+ip_reass_make_contiguous(struct pbuf *p)
+{
+  struct pbuf *q;
+
+  if ((p->next == NULL) || (p->tot_len > IP_REASS_COPY_MAX_LEN)) {
+    return p;
+  }
+  q = pbuf_alloc(PBUF_LINK, p->tot_len, PBUF_RAM);
+  if (q == NULL) {
+    return p;
+  }
+  if (pbuf_copy(q, p) != ERR_OK) {
+    pbuf_free(q);
+    return p;
+  }
+  pbuf_free(p);
+  return q;
+}
+#endif /* IP_REASS_COPY_CONTIGUOUS */
+/* Added by Realtek end */
+
 /**
  * Enqueues a new fragment into the fragment queue
  * @param fraghdr points to the new fragments IP hdr
@@ -286,7 +402,7 @@ ip_reass_enqueue_new_datagram(struct ip_hdr *fraghdr, int clen)
   ipr = (struct ip_reassdata *)memp_malloc(MEMP_REASSDATA);
   if (ipr == NULL) {
 #if IP_REASS_FREE_OLDEST
-    if (ip_reass_remove_oldest_datagram(fraghdr, clen) >= clen) {
+    if (ip_reass_remove_oldest_datagram(fraghdr, clen, NULL) >= clen) {
       ipr = (struct ip_reassdata *)memp_malloc(MEMP_REASSDATA);
     }
     if (ipr == NULL)
@@ -482,8 +598,8 @@ ip_reass_chain_frag_into_datagram_and_validate(struct ip_reassdata *ipr, struct
   return IP_REASS_VALIDATE_PBUF_QUEUED; /* not yet valid! */
 #if IP_REASS_CHECK_OVERLAP
 freepbuf:
-  ip_reass_pbufcount -= pbuf_clen(new_p);
-  pbuf_free(new_p);
+  /* Realtek modified: new_p is not counted in ip_reass_pbufcount yet and is
+   * freed by the caller; freeing it here as well caused a double free */
   return IP_REASS_VALIDATE_PBUF_DROPPED;
 #endif /* IP_REASS_CHECK_OVERLAP */
 }
@@ -519,11 +635,20 @@ ip4_reass(struct pbuf *p)
   offset = (lwip_ntohs(IPH_OFFSET(fraghdr)) & IP_OFFMASK) * 8;
   len = lwip_ntohs(IPH_LEN(fraghdr)) - IPH_HL(fraghdr) * 4;
 
+  /* Added by Realtek: drop incomplete datagrams early if the RX path is starving */
+  ip_reass_relieve_pressure(fraghdr);
+
   /* Check if we are allowed to enqueue more datagrams. */
   clen = pbuf_clen(p);
+  if (!ip_reass_check_src_quota(fraghdr, clen)) {
+    LWIP_DEBUGF(IP_REASS_DEBUG,("ip4_reass: source quota exceeded, clen=%d, MAX=%d\n",
+      clen, IP_REASS_MAX_PBUFS_PER_SRC));
+    IPFRAG_STATS_INC(ip_frag.memerr);
+    goto nullreturn;
+  }
   if ((ip_reass_pbufcount + clen) > IP_REASS_MAX_PBUFS) {
 #if IP_REASS_FREE_OLDEST
-    if (!ip_reass_remove_oldest_datagram(fraghdr, clen) ||
+    if (!ip_reass_remove_oldest_datagram(fraghdr, clen, NULL) ||
         ((ip_reass_pbufcount + clen) > IP_REASS_MAX_PBUFS))
 #endif /* IP_REASS_FREE_OLDEST */
     {
@@ -578,14 +703,14 @@ ip4_reass(struct pbuf *p)
     u16_t datagram_len = (u16_t)(offset + len);
     if ((datagram_len < offset) || (datagram_len > (0xFFFF - IP_HLEN))) {
       /* u16_t overflow, cannot handle this */
-      goto nullreturn;
+      goto nullreturn_ipr;
     }
   }
   /* find the right place to insert this pbuf */
   /* @todo: trim pbufs if fragments are overlapping */
   valid = ip_reass_chain_frag_into_datagram_and_validate(ipr, p, is_last);
   if (valid == IP_REASS_VALIDATE_PBUF_DROPPED) {
-    goto nullreturn;
+    goto nullreturn_ipr;
   }
   /* if we come here, the pbuf has been enqueued */
 
@@ -593,6 +718,7 @@ ip4_reass(struct pbuf *p)
      the number of fragments that may be enqueued at any one time
      (overflow checked by testing against IP_REASS_MAX_PBUFS) */
   ip_reass_pbufcount = (u16_t)(ip_reass_pbufcount + clen);
+  ipr->pbufcount = (u16_t)(ipr->pbufcount + clen);
   if (is_last) {
     u16_t datagram_len = (u16_t)(offset + len);
     ipr->datagram_len = datagram_len;
@@ -655,6 +781,10 @@ ip4_reass(struct pbuf *p)
 
     MIB2_STATS_INC(mib2.ipreasmoks);
 
+#if IP_REASS_COPY_CONTIGUOUS
+    p = ip_reass_make_contiguous(p);
+#endif /* IP_REASS_COPY_CONTIGUOUS */
+
     /* Return the pbuf chain */
     return p;
   }
@@ -662,6 +792,20 @@ ip4_reass(struct pbuf *p)
   LWIP_DEBUGF(IP_REASS_DEBUG,("ip_reass_pbufcount: %d out\n", ip_reass_pbufcount));
   return NULL;
 
+nullreturn_ipr:
+  /* Realtek modified: do not leave an empty entry behind for a new datagram */
+  if (ipr->p == NULL) {
+    struct ip_reassdata *ipr_prev = NULL;
+    if (ipr != reassdatagrams) {
+      for (ipr_prev = reassdatagrams; ipr_prev != NULL; ipr_prev = ipr_prev->next) {
+        if (ipr_prev->next == ipr) {
+          break;
+        }
+      }
+    }
+    ip_reass_dequeue_datagram(ipr, ipr_prev);
+  }
+
 nullreturn:
   LWIP_DEBUGF(IP_REASS_DEBUG,("ip4_reass: nullreturn\n"));
   IPFRAG_STATS_INC(ip_frag.drop);
@@ -98,6 +98,31 @@
 #define TFTP_MAX_MODE_LEN     7
 #endif
 
+/* Added by Realtek start */
+/**
+ * Largest block size accepted from a client's "blksize" option (RFC 2348).
+ * Blocks are 512 bytes unless the client asks for another size.
+ */
+#if !defined TFTP_MAX_BLKSIZE || defined __DOXYGEN__
+#define TFTP_MAX_BLKSIZE      1468
+#endif
+
+/**
+ * Largest window accepted from a client's "windowsize" option (RFC 7440).
+ * A read transfer keeps up to this many blocks in RAM for retransmission.
+ */
+#if !defined TFTP_MAX_WINDOWSIZE || defined __DOXYGEN__
+#define TFTP_MAX_WINDOWSIZE   4
+#endif
+
+/**
+ * Max. length of an option name or value in a request
+ */
+#if !defined TFTP_MAX_OPTION_LEN || defined __DOXYGEN__
+#define TFTP_MAX_OPTION_LEN   12
+#endif
+/* Added by Realtek end */
+
 /**
  * @}
  */
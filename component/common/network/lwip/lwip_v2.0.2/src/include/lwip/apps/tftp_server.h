@@ -80,12 +80,16 @@ struct tftp_context {
    * @param pbuf PBUF adjusted such that payload pointer points
    *             to the beginning of write data. In other words,
    *             TFTP headers are stripped off.
-   * @returns &gt;= 0: Success; &lt; 0: Error
+   * @returns &gt;= 0: Success; ERR_WOULDBLOCK: block not taken, it is
+   *          acknowledged only when the client sends it again; other
+   *          &lt; 0: Error
    */
   int (*write)(void* handle, struct pbuf* p);
 };
 
 err_t tftp_init(const struct tftp_context* ctx);
+void tftp_cleanup(void);
+u16_t tftp_get_blksize(void);
 
 #ifdef __cplusplus
 }
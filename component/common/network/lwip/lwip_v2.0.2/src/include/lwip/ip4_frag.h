@@ -65,11 +65,13 @@ struct ip_reassdata {
   u16_t datagram_len;
   u8_t flags;
   u8_t timer;
+  u16_t pbufcount; /* Added by Realtek: pbufs enqueued for this datagram */
 };
 
 void ip_reass_init(void);
 void ip_reass_tmr(void);
 struct pbuf * ip4_reass(struct pbuf *p);
+void ip_reass_mem_pressure(void); /* Added by Realtek */
 #endif /* IP_REASSEMBLY */
 
 #if IP_FRAG
@@ -705,6 +705,42 @@
 #define IP_REASS_MAX_PBUFS              10
 #endif
 
+/* Added by Realtek start */
+/**
+ * IP_REASS_MAX_PBUFS_PER_SRC: Maximum amount of pbufs one source address may
+ * keep waiting for reassembly. When a source exceeds its quota, its own oldest
+ * datagram is freed instead of another source's. Half of IP_REASS_MAX_PBUFS by
+ * default, so one source always leaves room for the others; it also bounds the
+ * fragments of the largest datagram one source can send.
+ */
+#if !defined IP_REASS_MAX_PBUFS_PER_SRC || defined __DOXYGEN__
+#define IP_REASS_MAX_PBUFS_PER_SRC      (IP_REASS_MAX_PBUFS / 2)
+#endif
+
+/**
+ * IP_REASS_PRESSURE_LOW_WATER: After ip_reass_mem_pressure() was signalled,
+ * incomplete datagrams are freed (oldest first) until no more than this many
+ * pbufs are left waiting for reassembly.
+ */
+#if !defined IP_REASS_PRESSURE_LOW_WATER || defined __DOXYGEN__
+#define IP_REASS_PRESSURE_LOW_WATER     (IP_REASS_MAX_PBUFS / 2)
+#endif
+
+/**
+ * IP_REASS_COPY_CONTIGUOUS==1: Copy a completely reassembled datagram of at
+ * most IP_REASS_COPY_MAX_LEN bytes into one PBUF_RAM pbuf, so that the pool
+ * pbufs holding the fragments are returned to the receive path immediately
+ * instead of waiting until the application consumed the datagram. Falls back
+ * to the fragment chain if the heap is exhausted.
+ */
+#if !defined IP_REASS_COPY_CONTIGUOUS || defined __DOXYGEN__
+#define IP_REASS_COPY_CONTIGUOUS        0
+#endif
+#if !defined IP_REASS_COPY_MAX_LEN || defined __DOXYGEN__
+#define IP_REASS_COPY_MAX_LEN           (MEM_SIZE / 2)
+#endif
+/* Added by Realtek end */
+
 /**
  * IP_DEFAULT_TTL: Default value for Time-To-Live used by transport layers.
  */
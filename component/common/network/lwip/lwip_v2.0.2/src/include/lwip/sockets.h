@@ -488,6 +488,8 @@ int lwip_getpeername (int s, struct sockaddr *name, socklen_t *namelen);
 int lwip_getsockname (int s, struct sockaddr *name, socklen_t *namelen);
 int lwip_getsockopt (int s, int level, int optname, void *optval, socklen_t *optlen);
 int lwip_setsockopt (int s, int level, int optname, const void *optval, socklen_t optlen);
+typedef void (*lwip_event_hook_fn)(int s, int evt);	//Realtek add
+void lwip_set_event_hook(lwip_event_hook_fn hook);		//Realtek add
 int lwip_getsocklasterr(int s);			//Realtek add
 int lwip_close(int s);
 int lwip_connect(int s, const struct sockaddr *name, socklen_t namelen);
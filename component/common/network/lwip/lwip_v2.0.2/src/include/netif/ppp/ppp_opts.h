@@ -186,6 +186,17 @@
 #define PPP_FCS_TABLE                   1
 #endif
 
+/* Added by Realtek start */
+/**
+ * PPPOS_HDLC_FAST==1: Escape/unescape PPPoS data and update the FCS a 32-bit
+ * word at a time for runs of bytes that need no escaping, instead of byte per
+ * byte. Needs PPP_FCS_TABLE and costs another 3*256*2 bytes of FCS tables.
+ */
+#ifndef PPPOS_HDLC_FAST
+#define PPPOS_HDLC_FAST                 0
+#endif
+/* Added by Realtek end */
+
 /**
  * PAP_SUPPORT==1: Support PAP.
  */
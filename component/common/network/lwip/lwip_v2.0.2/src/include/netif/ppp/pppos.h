@@ -100,6 +100,8 @@ ppp_pcb *pppos_create(struct netif *pppif, pppos_output_cb_fn output_cb,
 #if !NO_SYS && !PPP_INPROC_IRQ_SAFE
 /* Pass received raw characters to PPPoS to be decoded through lwIP TCPIP thread. */
 err_t pppos_input_tcpip(ppp_pcb *ppp, u8_t *s, int l);
+/* Pass a pbuf chain of received raw characters (e.g. filled by UART DMA) without copying. Added by Realtek */
+err_t pppos_input_tcpip_pbuf(ppp_pcb *ppp, struct pbuf *p);
 #endif /* !NO_SYS && !PPP_INPROC_IRQ_SAFE */
 
 /* PPP over Serial: this is the input function to be called for received data. */
@@ -0,0 +1,158 @@
+#include "test_ethernetif.h"
+
+/* The multicast group filter of the Ameba port, ethernetif_mcast.c (see Makefile) */
+#include "ethernetif.h"
+
+#include "lwip/prot/etharp.h"
+
+#include <string.h>
+
+#if !ETHERNETIF_MCAST_FILTER
+#error "This tests needs the multicast filter of ethernetif (LWIP_IGMP) enabled"
+#endif
+
+/* One more group than the table holds */
+#define NUM_GROUPS    (ETHERNETIF_MCAST_MAX_GROUPS + 1)
+
+static struct netif test_netif;
+
+/* 01:00:5e:00:01:n, the MAC of 224.0.1.n */
+static void
+group_mac(u8_t *mac, u8_t n)
+{
+  mac[0] = 0x01;
+  mac[1] = 0x00;
+  mac[2] = 0x5e;
+  mac[3] = 0x00;
+  mac[4] = 0x01;
+  mac[5] = n;
+}
+
+static err_t
+group_update(u8_t n, enum netif_mac_filter_action action)
+{
+  u8_t mac[ETHARP_HWADDR_LEN];
+  u8_t changed;
+
+  group_mac(mac, n);
+  return ethernetif_mcast_update(&test_netif, mac, action, &changed);
+}
+
+static int
+group_accept(u8_t n)
+{
+  u8_t mac[ETHARP_HWADDR_LEN];
+
+  group_mac(mac, n);
+  return ethernetif_mcast_accept(&test_netif, mac);
+}
+
+/* Setups/teardown functions */
+
+static void
+ethernetif_setup(void)
+{
+  memset(&test_netif, 0, sizeof(test_netif));
+  test_netif.num = 1;
+  test_netif.flags = NETIF_FLAG_IGMP;
+}
+
+static void
+ethernetif_teardown(void)
+{
+}
+
+/* Test functions */
+
+START_TEST(test_ethernetif_mcast_filter)
+{
+  static const u8_t unicast[ETHARP_HWADDR_LEN] = {0x00, 0xe0, 0x4c, 0x87, 0x00, 0x01};
+  static const u8_t broadcast[ETHARP_HWADDR_LEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  struct ethernetif_mcast_group groups[2];
+  u32_t dropped;
+  LWIP_UNUSED_ARG(_i);
+
+  dropped = ethernetif_mcast_get_dropped();
+  fail_unless(group_update(1, NETIF_ADD_MAC_FILTER) == ERR_OK);
+  /* a second IP group on the same MAC */
+  fail_unless(group_update(1, NETIF_ADD_MAC_FILTER) == ERR_OK);
+
+  fail_unless(group_accept(1));
+  fail_unless(!group_accept(2));
+  fail_unless(ethernetif_mcast_accept(&test_netif, unicast));
+  fail_unless(ethernetif_mcast_accept(&test_netif, broadcast));
+  fail_unless(ethernetif_mcast_get_dropped() == dropped + 1);
+  fail_unless(ethernetif_mcast_get_groups(groups, 2) == 1);
+  fail_unless(groups[0].netif_num == 1);
+  fail_unless(groups[0].hits == 1);
+
+  /* still joined through the other IP group */
+  fail_unless(group_update(1, NETIF_DEL_MAC_FILTER) == ERR_OK);
+  fail_unless(group_accept(1));
+  fail_unless(group_update(1, NETIF_DEL_MAC_FILTER) == ERR_OK);
+  fail_unless(!group_accept(1));
+  fail_unless(ethernetif_mcast_get_groups(groups, 2) == 0);
+
+  /* not filtered without IGMP on the netif */
+  test_netif.flags = 0;
+  fail_unless(group_accept(2));
+}
+END_TEST
+
+START_TEST(test_ethernetif_mcast_overflow)
+{
+  u8_t n;
+  LWIP_UNUSED_ARG(_i);
+
+  for (n = 0; n < ETHERNETIF_MCAST_MAX_GROUPS; n++) {
+    fail_unless(group_update(n, NETIF_ADD_MAC_FILTER) == ERR_OK);
+  }
+  fail_unless(!group_accept(NUM_GROUPS));
+  fail_unless(ethernetif_mcast_get_overflow() == 0);
+
+  /* the group that does not fit is received, with all other multicast */
+  fail_unless(group_update(NUM_GROUPS - 1, NETIF_ADD_MAC_FILTER) == ERR_MEM);
+  fail_unless(ethernetif_mcast_get_overflow() == 1);
+  for (n = 0; n < NUM_GROUPS; n++) {
+    fail_unless(group_accept(n));
+  }
+  fail_unless(group_accept(NUM_GROUPS));
+
+  /* a group of the table left: still one group out of it */
+  fail_unless(group_update(0, NETIF_DEL_MAC_FILTER) == ERR_OK);
+  fail_unless(ethernetif_mcast_get_overflow() == 1);
+  fail_unless(group_accept(0));
+  fail_unless(group_accept(NUM_GROUPS - 1));
+
+  /* the group out of the table left: filtering again */
+  fail_unless(group_update(NUM_GROUPS - 1, NETIF_DEL_MAC_FILTER) == ERR_OK);
+  fail_unless(ethernetif_mcast_get_overflow() == 0);
+  fail_unless(!group_accept(0));
+  fail_unless(!group_accept(NUM_GROUPS - 1));
+  fail_unless(!group_accept(NUM_GROUPS));
+  for (n = 1; n < ETHERNETIF_MCAST_MAX_GROUPS; n++) {
+    fail_unless(group_accept(n));
+  }
+
+  /* a leave of a group never joined does not count */
+  fail_unless(group_update(NUM_GROUPS, NETIF_DEL_MAC_FILTER) == ERR_OK);
+  fail_unless(ethernetif_mcast_get_overflow() == 0);
+
+  for (n = 1; n < ETHERNETIF_MCAST_MAX_GROUPS; n++) {
+    fail_unless(group_update(n, NETIF_DEL_MAC_FILTER) == ERR_OK);
+  }
+  fail_unless(!group_accept(1));
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+ethernetif_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_ethernetif_mcast_filter),
+    TESTFUNC(test_ethernetif_mcast_overflow),
+  };
+  return create_suite("ETHERNETIF", tests, sizeof(tests)/sizeof(testfunc), ethernetif_setup, ethernetif_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_ETHERNETIF_H
+#define LWIP_HDR_TEST_ETHERNETIF_H
+
+#include "../lwip_check.h"
+
+Suite* ethernetif_suite(void);
+
+#endif
@@ -0,0 +1,288 @@
+#include "test_ip4.h"
+
+#include "lwip/ip4.h"
+#include "lwip/ip4_frag.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/stats.h"
+#include "lwip/prot/ip4.h"
+
+#include <string.h>
+
+#if !LWIP_STATS || !MEMP_STATS || !MIB2_STATS
+#error "This tests needs MEMP- and MIB2-statistics enabled"
+#endif
+#if !IP_REASSEMBLY
+#error "This tests needs IP_REASSEMBLY enabled"
+#endif
+
+#define FRAG_LEN      64
+#define MAX_FRAGS     16
+
+/* Helper functions */
+
+static struct pbuf *
+create_frag(u8_t src, u16_t id, u16_t offset, u16_t len, int more)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  ip4_addr_t addr;
+  u8_t *payload;
+  u16_t i;
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(IP_HLEN + len), PBUF_POOL);
+  EXPECT_RETNULL(p != NULL);
+  EXPECT_RETNULL(p->next == NULL);
+
+  iphdr = (struct ip_hdr *)p->payload;
+  memset(iphdr, 0, IP_HLEN);
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, lwip_htons((u16_t)(IP_HLEN + len)));
+  IPH_ID_SET(iphdr, lwip_htons(id));
+  IPH_OFFSET_SET(iphdr, lwip_htons((u16_t)((offset / 8) | (more ? IP_MF : 0))));
+  IPH_TTL_SET(iphdr, 64);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  IP4_ADDR(&addr, 192, 168, 1, src);
+  ip4_addr_copy(iphdr->src, addr);
+  IP4_ADDR(&addr, 192, 168, 1, 80);
+  ip4_addr_copy(iphdr->dest, addr);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  payload = (u8_t *)p->payload + IP_HLEN;
+  for (i = 0; i < len; i++) {
+    payload[i] = (u8_t)(offset + i);
+  }
+  return p;
+}
+
+static struct pbuf *
+send_frag(u8_t src, u16_t id, u16_t index, u16_t count)
+{
+  struct pbuf *p = create_frag(src, id, (u16_t)(index * FRAG_LEN), FRAG_LEN, index + 1 < count);
+  EXPECT_RETNULL(p != NULL);
+  return ip4_reass(p);
+}
+
+static void
+check_datagram(struct pbuf *p, u16_t count)
+{
+  u16_t i;
+
+  EXPECT_RET(p != NULL);
+  EXPECT(p->tot_len == IP_HLEN + count * FRAG_LEN);
+  EXPECT(lwip_ntohs(IPH_LEN((struct ip_hdr *)p->payload)) == p->tot_len);
+  for (i = 0; i < count * FRAG_LEN; i++) {
+    EXPECT_RET(pbuf_get_at(p, (u16_t)(IP_HLEN + i)) == (u8_t)i);
+  }
+}
+
+static void
+ip4_reass_flush(void)
+{
+  int i;
+  for (i = 0; i <= IP_REASS_MAXAGE + 1; i++) {
+    ip_reass_tmr();
+  }
+}
+
+/* Setups/teardown functions */
+
+static void
+ip4_setup(void)
+{
+  ip4_reass_flush();
+}
+
+static void
+ip4_teardown(void)
+{
+  ip4_reass_flush();
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == 0);
+  fail_unless(MEMP_STATS_GET(used, MEMP_REASSDATA) == 0);
+}
+
+
+/* Test functions */
+
+START_TEST(test_ip4_reass_in_order)
+{
+  struct pbuf *p = NULL;
+  u16_t i;
+  u32_t oks = lwip_stats.mib2.ipreasmoks;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < 4; i++) {
+    p = send_frag(1, 0x1000, i, 4);
+    if (i < 3) {
+      fail_unless(p == NULL);
+    }
+  }
+  check_datagram(p, 4);
+  fail_unless(lwip_stats.mib2.ipreasmoks == oks + 1);
+  pbuf_free(p);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_reorder_duplicate)
+{
+  static const u16_t order[] = {3, 0, 3, 2, 0, 2, 1};
+  struct pbuf *p = NULL;
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < LWIP_ARRAYSIZE(order); i++) {
+    p = send_frag(1, 0x1001, order[i], 4);
+    if (i + 1 < LWIP_ARRAYSIZE(order)) {
+      fail_unless(p == NULL);
+    }
+  }
+  check_datagram(p, 4);
+  pbuf_free(p);
+  /* duplicates must not leak or be counted as enqueued */
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == 0);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_missing_fragment_times_out)
+{
+  u32_t fails = lwip_stats.mib2.ipreasmfails;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(send_frag(1, 0x1002, 0, 3) == NULL);
+  fail_unless(send_frag(1, 0x1002, 2, 3) == NULL);
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == 2);
+
+  ip4_reass_flush();
+  fail_unless(lwip_stats.mib2.ipreasmfails == fails + 1);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_src_quota)
+{
+  struct pbuf *p;
+  u16_t id;
+  LWIP_UNUSED_ARG(_i);
+
+  /* one source opening many datagrams only evicts its own oldest ones */
+  fail_unless(send_frag(2, 0x2000, 0, 2) == NULL);
+  for (id = 1; id <= IP_REASS_MAX_PBUFS_PER_SRC + 2; id++) {
+    fail_unless(send_frag(1, (u16_t)(0x2000 + id), 0, 2) == NULL);
+    fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) <= IP_REASS_MAX_PBUFS_PER_SRC + 1);
+  }
+
+  /* the other source's datagram survived and completes */
+  p = send_frag(2, 0x2000, 1, 2);
+  check_datagram(p, 2);
+  pbuf_free(p);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_src_quota_full)
+{
+  struct pbuf *p = NULL;
+  u16_t i;
+  u32_t oks = lwip_stats.mib2.ipreasmoks;
+  LWIP_UNUSED_ARG(_i);
+
+  /* source 1 fills its quota with a datagram one fragment too big for it */
+  for (i = 0; i < IP_REASS_MAX_PBUFS_PER_SRC; i++) {
+    fail_unless(send_frag(1, 0x2100, i, IP_REASS_MAX_PBUFS_PER_SRC + 1) == NULL);
+  }
+  fail_unless(send_frag(1, 0x2100, i, IP_REASS_MAX_PBUFS_PER_SRC + 1) == NULL);
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == IP_REASS_MAX_PBUFS_PER_SRC);
+
+  /* source 2 still reassembles a datagram of as many fragments */
+  for (i = 0; i < IP_REASS_MAX_PBUFS_PER_SRC; i++) {
+    fail_unless(p == NULL);
+    p = send_frag(2, 0x2100, i, IP_REASS_MAX_PBUFS_PER_SRC);
+  }
+  check_datagram(p, IP_REASS_MAX_PBUFS_PER_SRC);
+  pbuf_free(p);
+  fail_unless(lwip_stats.mib2.ipreasmoks == oks + 1);
+
+  /* and the fragments of source 1 were left alone */
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == IP_REASS_MAX_PBUFS_PER_SRC);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_mem_pressure)
+{
+  u16_t id;
+  LWIP_UNUSED_ARG(_i);
+
+  for (id = 0; id < IP_REASS_MAX_PBUFS - 1; id++) {
+    fail_unless(send_frag((u8_t)(10 + id), (u16_t)(0x3000 + id), 0, 2) == NULL);
+  }
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == IP_REASS_MAX_PBUFS - 1);
+
+  /* RX path starved: incomplete datagrams are dropped on the next fragment */
+  ip_reass_mem_pressure();
+  fail_unless(send_frag(1, 0x3100, 0, 2) == NULL);
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) <= IP_REASS_PRESSURE_LOW_WATER + 1);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_random)
+{
+  u16_t order[MAX_FRAGS * 2];
+  int round;
+  LWIP_UNUSED_ARG(_i);
+
+  srand(0x5eed);
+  for (round = 0; round < 200; round++) {
+    u16_t count = (u16_t)(2 + rand() % (MAX_FRAGS - 1));
+    u16_t sent = 0, i, dropped;
+    int drop = (rand() % 4) == 0;
+    struct pbuf *p = NULL;
+
+    if (count > IP_REASS_MAX_PBUFS_PER_SRC) {
+      count = IP_REASS_MAX_PBUFS_PER_SRC;
+    }
+    dropped = (u16_t)(rand() % count);
+    /* every fragment once, some twice, then shuffled */
+    for (i = 0; i < count; i++) {
+      if (!drop || (i != dropped)) {
+        order[sent++] = i;
+        if ((rand() % 3) == 0) {
+          order[sent++] = i;
+        }
+      }
+    }
+    for (i = sent; i > 1; i--) {
+      u16_t j = (u16_t)(rand() % i);
+      u16_t tmp = order[i - 1];
+      order[i - 1] = order[j];
+      order[j] = tmp;
+    }
+
+    /* duplicates arriving after completion would start a new datagram */
+    for (i = 0; (i < sent) && (p == NULL); i++) {
+      p = send_frag(1, (u16_t)(0x4000 + round), order[i], count);
+    }
+    if (drop) {
+      fail_unless(p == NULL);
+      ip4_reass_flush();
+    } else {
+      check_datagram(p, count);
+      pbuf_free(p);
+    }
+    fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == 0);
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+ip4_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_ip4_reass_in_order),
+    TESTFUNC(test_ip4_reass_reorder_duplicate),
+    TESTFUNC(test_ip4_reass_missing_fragment_times_out),
+    TESTFUNC(test_ip4_reass_src_quota),
+    TESTFUNC(test_ip4_reass_src_quota_full),
+    TESTFUNC(test_ip4_reass_mem_pressure),
+    TESTFUNC(test_ip4_reass_random),
+  };
+  return create_suite("IPv4", tests, sizeof(tests)/sizeof(testfunc), ip4_setup, ip4_teardown);
+}
@@ -9,6 +9,10 @@
 #include "etharp/test_etharp.h"
 #include "dhcp/test_dhcp.h"
 #include "mdns/test_mdns.h"
+#include "ppp/test_pppos.h"
+#include "tftp/test_tftp.h"
+#include "snmp/test_snmp.h"
+#include "ethernetif/test_ethernetif.h"
 
 #include "lwip/init.h"
 
@@ -46,7 +50,11 @@ int main(void)
     pbuf_suite,
     etharp_suite,
     dhcp_suite,
-    mdns_suite
+    mdns_suite,
+    pppos_suite,
+    tftp_suite,
+    snmp_suite,
+    ethernetif_suite
   };
   size_t num = sizeof(suites)/sizeof(void*);
   LWIP_ASSERT("No suites defined", num > 0);
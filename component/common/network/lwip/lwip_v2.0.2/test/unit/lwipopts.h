@@ -62,4 +62,17 @@
 /* MIB2 stats are required to check IPv4 reassembly results */
 #define MIB2_STATS                      1
 
+/* One datagram per reassembly pbuf for the IPv4 tests, which run with the
+   default per-source quota */
+#define MEMP_NUM_REASSDATA              IP_REASS_MAX_PBUFS
+
+/* PPPoS with the word-at-a-time HDLC path for the PPPoS tests */
+#define PPP_SUPPORT                     1
+#define PPPOS_SUPPORT                   1
+#define PPPOS_HDLC_FAST                 1
+#define MEMP_NUM_PPP_PCB                2
+
+/* Loopback on the test netif for the TFTP server tests */
+#define LWIP_NETIF_LOOPBACK             1
+
 #endif /* LWIP_HDR_LWIPOPTS_H */
@@ -0,0 +1,216 @@
+#include "test_pppos.h"
+
+#include "lwip/udp.h"
+#include "lwip/stats.h"
+#include "netif/ppp/pppos.h"
+#include "netif/ppp/ppp_impl.h"
+
+#include <string.h>
+
+#if !PPP_SUPPORT || !PPPOS_SUPPORT || !PPP_IPV4_SUPPORT
+#error "This tests needs PPPoS with IPv4 enabled"
+#endif
+#if !LWIP_STATS || !LINK_STATS || !MEMP_STATS
+#error "This tests needs LINK- and MEMP-statistics enabled"
+#endif
+#if MEMP_NUM_PPP_PCB < 2
+#error "This tests needs two PPP PCBs"
+#endif
+
+#define WIRE_SIZE     8192
+#define TEST_PORT     5000
+#define TEST_LEN      1200
+
+/* Two PPPoS peers connected back to back through a byte queue per direction */
+static struct netif test_netif[2];
+static ppp_pcb *test_pcb[2];
+static u8_t wire[2][WIRE_SIZE];
+static u32_t wire_len[2];
+static u8_t test_data[TEST_LEN];
+static int rx_count;
+
+/* Helper functions */
+
+static u32_t
+pppos_test_output(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx)
+{
+  int side = (int)(size_t)ctx;
+  LWIP_UNUSED_ARG(pcb);
+
+  if (wire_len[side] + len > WIRE_SIZE) {
+    return 0;
+  }
+  memcpy(&wire[side][wire_len[side]], data, len);
+  wire_len[side] += len;
+  return len;
+}
+
+static void
+pppos_test_status(ppp_pcb *pcb, int err_code, void *ctx)
+{
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(err_code);
+  LWIP_UNUSED_ARG(ctx);
+}
+
+/* Deliver everything on the wire in odd sized chunks at odd buffer offsets,
+ * so the word-at-a-time input path sees every alignment. */
+static void
+pppos_pump(void)
+{
+  static u8_t buf[WIRE_SIZE + 3];
+  int rounds, side;
+  u32_t chunk = 1;
+
+  for (rounds = 0; rounds < 100 && (wire_len[0] || wire_len[1]); rounds++) {
+    for (side = 0; side < 2; side++) {
+      u32_t len = wire_len[side], off = 0;
+      u8_t *data = buf + (rounds & 3);
+
+      memcpy(data, wire[side], len);
+      wire_len[side] = 0;
+      while (off < len) {
+        u32_t n = LWIP_MIN(chunk, len - off);
+        pppos_input(test_pcb[side ^ 1], data + off, (int)n);
+        off += n;
+        chunk = (chunk * 7 + 3) % 61 + 1;
+      }
+    }
+  }
+  fail_unless(wire_len[0] == 0 && wire_len[1] == 0);
+}
+
+static void
+pppos_test_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+
+  fail_unless(p->tot_len == TEST_LEN);
+  if (p->tot_len == TEST_LEN) {
+    u8_t data[TEST_LEN];
+    fail_unless(pbuf_copy_partial(p, data, TEST_LEN, 0) == TEST_LEN);
+    fail_unless(memcmp(data, test_data, TEST_LEN) == 0);
+  }
+  rx_count++;
+  pbuf_free(p);
+}
+
+/* Setups/teardown functions */
+
+static void
+pppos_setup(void)
+{
+  ip4_addr_t addr;
+  int side;
+
+  for (side = 0; side < 2; side++) {
+    wire_len[side] = 0;
+    test_pcb[side] = pppos_create(&test_netif[side], pppos_test_output, pppos_test_status, (void *)(size_t)side);
+    fail_unless(test_pcb[side] != NULL);
+    IP4_ADDR(&addr, 10, 0, 0, 1 + side);
+    ppp_set_ipcp_ouraddr(test_pcb[side], &addr);
+  }
+  rx_count = 0;
+}
+
+static void
+pppos_teardown(void)
+{
+  int side;
+
+  for (side = 0; side < 2; side++) {
+    ppp_close(test_pcb[side], 1);
+    wire_len[side] = 0;
+    ppp_free(test_pcb[side]);
+  }
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == 0);
+}
+
+static void
+pppos_connect_both(void)
+{
+  fail_unless(ppp_connect(test_pcb[0], 0) == ERR_OK);
+  fail_unless(ppp_connect(test_pcb[1], 0) == ERR_OK);
+  pppos_pump();
+  fail_unless(test_pcb[0]->phase == PPP_PHASE_RUNNING);
+  fail_unless(test_pcb[1]->phase == PPP_PHASE_RUNNING);
+}
+
+
+/* Test functions */
+
+START_TEST(test_pppos_link_up)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  pppos_connect_both();
+}
+END_TEST
+
+START_TEST(test_pppos_escaped_data)
+{
+  struct udp_pcb *tx, *rx;
+  struct pbuf *p;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  pppos_connect_both();
+
+  /* every byte value, then long runs of the flag and escape characters
+   * interleaved with plain data at every offset */
+  for (i = 0; i < TEST_LEN; i++) {
+    test_data[i] = (u8_t)((i < 256) ? i : ((i % 11) < 3 ? PPP_FLAG - (i & 1) : (i * 13)));
+  }
+
+  rx = udp_new();
+  fail_unless(rx != NULL);
+  fail_unless(udp_bind(rx, IP_ADDR_ANY, TEST_PORT) == ERR_OK);
+  udp_recv(rx, pppos_test_recv, NULL);
+  tx = udp_new();
+  fail_unless(tx != NULL);
+
+  p = pbuf_alloc(PBUF_TRANSPORT, TEST_LEN, PBUF_POOL);
+  fail_unless(p != NULL);
+  pbuf_take(p, test_data, TEST_LEN);
+  fail_unless(udp_sendto_if(tx, p, netif_ip_gw4(&test_netif[0]), TEST_PORT, &test_netif[0]) == ERR_OK);
+  pbuf_free(p);
+  pppos_pump();
+  fail_unless(rx_count == 1);
+
+  udp_remove(tx);
+  udp_remove(rx);
+}
+END_TEST
+
+START_TEST(test_pppos_bad_fcs)
+{
+  static const u8_t frame[] = {
+    PPP_FLAG, PPP_ALLSTATIONS, PPP_UI, 0xc0, 0x21, 0x09, 0x01, 0x00, 0x08,
+    0x11, 0x22, 0x33, 0x44, 0x55, 0x66, PPP_FLAG
+  };
+  u32_t chkerr = lwip_stats.link.chkerr;
+  LWIP_UNUSED_ARG(_i);
+
+  pppos_connect_both();
+  /* an LCP echo request with a garbage FCS is dropped */
+  pppos_input(test_pcb[1], (u8_t *)frame, sizeof(frame));
+  fail_unless(lwip_stats.link.chkerr == chkerr + 1);
+  fail_unless(wire_len[1] == 0);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+pppos_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_pppos_link_up),
+    TESTFUNC(test_pppos_escaped_data),
+    TESTFUNC(test_pppos_bad_fcs),
+  };
+  return create_suite("PPPOS", tests, sizeof(tests)/sizeof(testfunc), pppos_setup, pppos_teardown);
+}
@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_PPPOS_H
+#define LWIP_HDR_TEST_PPPOS_H
+
+#include "../lwip_check.h"
+
+Suite* pppos_suite(void);
+
+#endif
@@ -0,0 +1,197 @@
+#include "test_snmp.h"
+
+/* The table cursor of the Ameba agent, snmp_ameba_cursor.c (see Makefile) */
+#include "snmp_ameba.h"
+
+#include <string.h>
+
+#define KEY_LEN       5           /* as ipNetToMediaTable: ifIndex, IP address */
+#define MAX_ROWS      1000
+#define WALK_COLUMNS  4
+
+static u32_t keys[MAX_ROWS * KEY_LEN];
+static u16_t row_count;
+static struct snmp_ameba_cursor_table table;
+
+/* The way lwIP answers a GetNext in its MIB2 tables: every row looked at for the smallest greater index */
+static s8_t
+ref_cmp(const u32_t *a, u8_t a_len, const u32_t *b, u8_t b_len)
+{
+  u8_t i;
+
+  for (i = 0; (i < a_len) && (i < b_len); i++) {
+    if (a[i] != b[i]) {
+      return (a[i] < b[i]) ? -1 : 1;
+    }
+  }
+  if (a_len == b_len) {
+    return 0;
+  }
+  return (a_len < b_len) ? -1 : 1;
+}
+
+static s32_t
+ref_next(const u32_t *oid, u8_t oid_len)
+{
+  s32_t best = -1;
+  u16_t i;
+
+  for (i = 0; i < row_count; i++) {
+    if ((ref_cmp(&keys[i * KEY_LEN], KEY_LEN, oid, oid_len) > 0) &&
+        ((best < 0) || (ref_cmp(&keys[i * KEY_LEN], KEY_LEN, &keys[best * KEY_LEN], KEY_LEN) < 0))) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+static s32_t
+ref_find(const u32_t *oid, u8_t oid_len)
+{
+  u16_t i;
+
+  for (i = 0; i < row_count; i++) {
+    if (ref_cmp(&keys[i * KEY_LEN], KEY_LEN, oid, oid_len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void
+random_key(u32_t *key)
+{
+  u8_t i;
+
+  key[0] = 1 + (u32_t)(rand() % 3);
+  for (i = 1; i < KEY_LEN; i++) {
+    key[i] = (u32_t)(rand() % 256);
+  }
+}
+
+/* Fills the table with rows random keys, inserted in random order */
+static void
+fill_table(u16_t rows)
+{
+  u32_t key[KEY_LEN];
+  s32_t row;
+
+  row_count = 0;
+  while (row_count < rows) {
+    random_key(key);
+    row = snmp_ameba_cursor_insert(keys, KEY_LEN, row_count, key);
+    if (row >= 0) {
+      fail_unless(memcmp(&keys[row * KEY_LEN], key, sizeof(key)) == 0);
+      row_count++;
+    }
+  }
+  snmp_ameba_cursor_reset(&table, keys, KEY_LEN, row_count);
+}
+
+/* Setups/teardown functions */
+
+static void
+snmp_setup(void)
+{
+  srand(1);
+}
+
+static void
+snmp_teardown(void)
+{
+}
+
+/* Test functions */
+
+START_TEST(test_snmp_cursor_insert)
+{
+  u32_t key[KEY_LEN];
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  fill_table(MAX_ROWS);
+
+  /* ascending, no key twice */
+  for (i = 1; i < row_count; i++) {
+    fail_unless(ref_cmp(&keys[(i - 1) * KEY_LEN], KEY_LEN, &keys[i * KEY_LEN], KEY_LEN) < 0);
+  }
+
+  /* a key present is refused and nothing moves */
+  memcpy(key, &keys[500 * KEY_LEN], sizeof(key));
+  fail_unless(snmp_ameba_cursor_insert(keys, KEY_LEN, row_count, key) == -1);
+  fail_unless(memcmp(&keys[500 * KEY_LEN], key, sizeof(key)) == 0);
+}
+END_TEST
+
+START_TEST(test_snmp_cursor_walk)
+{
+  u32_t oid[KEY_LEN];
+  u8_t len;
+  u16_t col, rows;
+  s32_t row;
+  LWIP_UNUSED_ARG(_i);
+
+  fill_table(300);
+
+  /* each column of a walk starts from the empty row index and sees every row once, in order */
+  for (col = 0; col < WALK_COLUMNS; col++) {
+    len = 0;
+    rows = 0;
+    while ((row = snmp_ameba_cursor_next(&table, oid, len)) >= 0) {
+      fail_unless(row == rows);
+      memcpy(oid, &keys[row * KEY_LEN], sizeof(oid));
+      len = KEY_LEN;
+      fail_unless(snmp_ameba_cursor_find(&table, oid, len) == row);
+      rows++;
+    }
+    fail_unless(rows == row_count);
+  }
+
+  /* an empty table */
+  snmp_ameba_cursor_reset(&table, keys, KEY_LEN, 0);
+  fail_unless(snmp_ameba_cursor_next(&table, oid, 0) == -1);
+  fail_unless(snmp_ameba_cursor_find(&table, keys, KEY_LEN) == -1);
+}
+END_TEST
+
+START_TEST(test_snmp_cursor_random)
+{
+  u32_t oid[KEY_LEN + 2];
+  u8_t len;
+  int k;
+  LWIP_UNUSED_ARG(_i);
+
+  fill_table(500);
+
+  /* GetNext and Get of any index, shorter, longer, from rows or not, the cursor wherever the last one left it */
+  for (k = 0; k < 20000; k++) {
+    len = (u8_t)(rand() % (KEY_LEN + 3));
+    if ((rand() % 2) && (len >= KEY_LEN)) {
+      memcpy(oid, &keys[(rand() % row_count) * KEY_LEN], KEY_LEN * sizeof(u32_t));
+      oid[KEY_LEN] = (u32_t)rand();
+      oid[KEY_LEN + 1] = (u32_t)rand();
+    } else {
+      random_key(oid);
+      oid[KEY_LEN] = (u32_t)rand();
+      oid[KEY_LEN + 1] = (u32_t)rand();
+    }
+
+    fail_unless(snmp_ameba_cursor_next(&table, oid, len) == ref_next(oid, len));
+
+    fail_unless(snmp_ameba_cursor_find(&table, oid, len) == ref_find(oid, len));
+  }
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+snmp_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_snmp_cursor_insert),
+    TESTFUNC(test_snmp_cursor_walk),
+    TESTFUNC(test_snmp_cursor_random),
+  };
+  return create_suite("SNMP", tests, sizeof(tests)/sizeof(testfunc), snmp_setup, snmp_teardown);
+}
@@ -0,0 +1,476 @@
+#include "test_tftp.h"
+
+#include "lwip/apps/tftp_server.h"
+#include "lwip/udp.h"
+#include "lwip/netif.h"
+#include "lwip/stats.h"
+
+#include <string.h>
+
+#if !LWIP_UDP || !LWIP_NETIF_LOOPBACK
+#error "This tests needs UDP and LWIP_NETIF_LOOPBACK enabled"
+#endif
+#if !LWIP_STATS || !MEMP_STATS
+#error "This tests needs MEMP-statistics enabled"
+#endif
+#if TFTP_MAX_WINDOWSIZE < 4 || TFTP_MAX_BLKSIZE < 1024
+#error "This tests needs a window of 4 blocks of 1024 bytes"
+#endif
+
+#define FILE_SIZE     5000
+#define MAX_RX        16
+
+/* The "file" served and written by the server */
+static u8_t file_data[FILE_SIZE];
+static u8_t test_data_src[FILE_SIZE];
+static u16_t file_len;
+static u16_t file_pos;
+static int file_open;
+static int write_busy;    /* blocks refused with ERR_WOULDBLOCK */
+
+/* Test client, talking to the server through the loopback of test_netif */
+static struct netif test_netif;
+static struct udp_pcb *client;
+static u8_t rx_pkt[MAX_RX][TFTP_MAX_BLKSIZE + 4];
+static u16_t rx_len[MAX_RX];
+static int rx_count;
+
+/* File callbacks */
+
+static void *
+ram_open(const char *fname, const char *mode, u8_t write)
+{
+  LWIP_UNUSED_ARG(mode);
+
+  if (strcmp(fname, "image.bin") != 0) {
+    return NULL;
+  }
+  if (write) {
+    file_len = 0;
+  }
+  file_pos = 0;
+  file_open = 1;
+  return &file_open;
+}
+
+static void
+ram_close(void *handle)
+{
+  LWIP_UNUSED_ARG(handle);
+  file_open = 0;
+}
+
+static int
+ram_read(void *handle, void *buf, int bytes)
+{
+  int n = LWIP_MIN(bytes, file_len - file_pos);
+  LWIP_UNUSED_ARG(handle);
+
+  memcpy(buf, &file_data[file_pos], (size_t)n);
+  file_pos = (u16_t)(file_pos + n);
+  return n;
+}
+
+static int
+ram_write(void *handle, struct pbuf *p)
+{
+  LWIP_UNUSED_ARG(handle);
+
+  if (write_busy > 0) {
+    write_busy--;
+    return ERR_WOULDBLOCK;
+  }
+  if (file_len + p->tot_len > FILE_SIZE) {
+    return -1;
+  }
+  pbuf_copy_partial(p, &file_data[file_len], p->tot_len, 0);
+  file_len = (u16_t)(file_len + p->tot_len);
+  return 0;
+}
+
+static const struct tftp_context ram_ctx = {
+  ram_open, ram_close, ram_read, ram_write
+};
+
+/* Helper functions */
+
+static err_t
+testif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *addr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  LWIP_UNUSED_ARG(addr);
+  fail();
+  return ERR_OK;
+}
+
+static err_t
+testif_init(struct netif *netif)
+{
+  netif->name[0] = 't';
+  netif->name[1] = 'f';
+  netif->output = testif_output;
+  netif->mtu = 1500;
+  return ERR_OK;
+}
+
+static void
+client_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(addr);
+
+  /* the server answers from its well-known port in this implementation */
+  fail_unless(port == TFTP_PORT);
+  udp_connect(pcb, addr, port);
+  if (rx_count < MAX_RX) {
+    rx_len[rx_count] = pbuf_copy_partial(p, rx_pkt[rx_count], sizeof(rx_pkt[0]), 0);
+    rx_count++;
+  }
+  pbuf_free(p);
+}
+
+/* Deliver all looped back packets, including the answers they trigger */
+static void
+pump(void)
+{
+  rx_count = 0;
+  while (test_netif.loop_first != NULL) {
+    netif_poll(&test_netif);
+  }
+}
+
+static void
+client_send(const void *data, u16_t len)
+{
+  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+  fail_unless(p != NULL);
+  pbuf_take(p, data, len);
+  fail_unless(udp_sendto(client, p, &test_netif.ip_addr, TFTP_PORT) == ERR_OK);
+  pbuf_free(p);
+  pump();
+}
+
+static void
+client_request(u8_t opcode, const char *options, u16_t options_len)
+{
+  u8_t buf[64];
+  u16_t len = 0;
+
+  buf[len++] = 0;
+  buf[len++] = opcode;
+  memcpy(&buf[len], "image.bin\0octet", 16);
+  len += 16;
+  if (options_len > 0) {
+    memcpy(&buf[len], options, options_len);
+    len = (u16_t)(len + options_len);
+  }
+  client_send(buf, len);
+}
+
+static void
+client_ack(u16_t blknum)
+{
+  u8_t buf[4];
+  buf[0] = 0;
+  buf[1] = 4;
+  buf[2] = (u8_t)(blknum >> 8);
+  buf[3] = (u8_t)blknum;
+  client_send(buf, sizeof(buf));
+}
+
+static void
+client_data(u16_t blknum, u16_t blksize)
+{
+  u8_t buf[4 + TFTP_MAX_BLKSIZE];
+  u16_t off = (u16_t)((blknum - 1) * blksize);
+  u16_t len = (u16_t)LWIP_MIN(blksize, FILE_SIZE - off);
+
+  buf[0] = 0;
+  buf[1] = 3;
+  buf[2] = (u8_t)(blknum >> 8);
+  buf[3] = (u8_t)blknum;
+  memcpy(&buf[4], &test_data_src[off], len);
+  client_send(buf, (u16_t)(4 + len));
+}
+
+static int
+is_packet(int i, u8_t opcode, u16_t blknum)
+{
+  return (i < rx_count) && (rx_pkt[i][1] == opcode) &&
+         (((rx_pkt[i][2] << 8) | rx_pkt[i][3]) == blknum);
+}
+
+/* Read the whole file with the given parameters. 'drop' is a block lost once
+ * on its way to the client (0: none). */
+static void
+read_file(u16_t blksize, u16_t windowsize, u16_t drop)
+{
+  u8_t rx_file[FILE_SIZE + TFTP_MAX_BLKSIZE];
+  u16_t rx_file_len = 0;
+  u16_t expected = 1;
+  int done = 0, rounds, i;
+
+  for (rounds = 0; !done && rounds < 100; rounds++) {
+    u16_t last_ok = (u16_t)(expected - 1);
+    fail_unless(rx_count <= windowsize);
+    for (i = 0; i < rx_count; i++) {
+      u16_t blknum = (u16_t)((rx_pkt[i][2] << 8) | rx_pkt[i][3]);
+      fail_unless(rx_pkt[i][1] == 3);
+      if (blknum == drop) {
+        drop = 0;
+        continue;
+      }
+      if (blknum != expected) {
+        continue;
+      }
+      fail_unless(rx_len[i] - 4 <= blksize);
+      memcpy(&rx_file[rx_file_len], &rx_pkt[i][4], rx_len[i] - 4);
+      rx_file_len = (u16_t)(rx_file_len + rx_len[i] - 4);
+      last_ok = expected++;
+      if (rx_len[i] - 4 < blksize) {
+        done = 1;
+      }
+    }
+    client_ack(last_ok);
+  }
+  fail_unless(done);
+  fail_unless(rx_file_len == FILE_SIZE);
+  fail_unless(memcmp(rx_file, test_data_src, FILE_SIZE) == 0);
+  fail_unless(!file_open);
+}
+
+/* Setups/teardown functions */
+
+static void
+tftp_setup(void)
+{
+  ip4_addr_t addr, netmask, gw;
+  u16_t i;
+
+  for (i = 0; i < FILE_SIZE; i++) {
+    test_data_src[i] = (u8_t)(i * 7 + (i >> 8));
+  }
+  memcpy(file_data, test_data_src, FILE_SIZE);
+  file_len = FILE_SIZE;
+  file_open = 0;
+  write_busy = 0;
+
+  IP4_ADDR(&addr, 10, 0, 0, 1);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 10, 0, 0, 254);
+  netif_add(&test_netif, &addr, &netmask, &gw, NULL, testif_init, ip4_input);
+  netif_set_up(&test_netif);
+  netif_set_link_up(&test_netif);
+
+  fail_unless(tftp_init(&ram_ctx) == ERR_OK);
+  client = udp_new();
+  fail_unless(client != NULL);
+  udp_recv(client, client_recv, NULL);
+  rx_count = 0;
+}
+
+static void
+tftp_teardown(void)
+{
+  tftp_cleanup();
+  udp_remove(client);
+  pump();
+  netif_remove(&test_netif);
+  fail_unless(MEMP_STATS_GET(used, MEMP_PBUF_POOL) == 0);
+  fail_unless(MEMP_STATS_GET(used, MEMP_UDP_PCB) == 0);
+}
+
+
+/* Test functions */
+
+START_TEST(test_tftp_read_lockstep)
+{
+  LWIP_UNUSED_ARG(_i);
+
+  /* no options: plain RFC 1350, one 512 byte block per ACK */
+  client_request(1, NULL, 0);
+  fail_unless(rx_count == 1);
+  fail_unless(is_packet(0, 3, 1));
+  fail_unless(rx_len[0] == 4 + 512);
+  read_file(512, 1, 0);
+}
+END_TEST
+
+START_TEST(test_tftp_read_window)
+{
+  static const char opts[] = "blksize\0" "1024\0" "windowsize\0" "4\0";
+  LWIP_UNUSED_ARG(_i);
+
+  client_request(1, opts, sizeof(opts) - 1);
+  fail_unless(rx_count == 1);
+  fail_unless(rx_pkt[0][1] == 6);
+  fail_unless(rx_len[0] == 2 + sizeof(opts) - 1);
+  fail_unless(memcmp(&rx_pkt[0][2], opts, sizeof(opts) - 1) == 0);
+
+  /* ACK 0 opens the first window */
+  client_ack(0);
+  fail_unless(rx_count == 4);
+  fail_unless(is_packet(0, 3, 1) && is_packet(3, 3, 4));
+  read_file(1024, 4, 0);
+}
+END_TEST
+
+START_TEST(test_tftp_read_window_loss)
+{
+  static const char opts[] = "blksize\0" "1024\0" "windowsize\0" "4\0";
+  LWIP_UNUSED_ARG(_i);
+
+  client_request(1, opts, sizeof(opts) - 1);
+  client_ack(0);
+  /* block 2 is lost: ACK 1 makes the server resend 2..4 and send 5 */
+  read_file(1024, 4, 2);
+}
+END_TEST
+
+START_TEST(test_tftp_read_stale_ack)
+{
+  static const char opts[] = "blksize\0" "1024\0" "windowsize\0" "4\0";
+  LWIP_UNUSED_ARG(_i);
+
+  client_request(1, opts, sizeof(opts) - 1);
+  client_ack(0);
+  client_ack(2);
+  fail_unless(rx_count == 3);
+  fail_unless(is_packet(0, 3, 3) && is_packet(2, 3, 5));
+
+  /* ACKs of blocks acknowledged before are dropped without an answer */
+  client_ack(1);
+  fail_unless(rx_count == 0);
+  client_ack(0);
+  fail_unless(rx_count == 0);
+  client_ack(2);
+  fail_unless(rx_count == 0);
+  fail_unless(file_open);
+
+  /* an ACK of a block never sent is an error */
+  client_ack(6);
+  fail_unless(rx_count == 1);
+  fail_unless(rx_pkt[0][1] == 5);
+
+  client_ack(5);
+  fail_unless(!file_open);
+}
+END_TEST
+
+START_TEST(test_tftp_read_options_clamped)
+{
+  static const char opts[] = "tsize\0" "0\0" "BLKSIZE\0" "65464\0" "windowsize\0" "99\0";
+  LWIP_UNUSED_ARG(_i);
+
+  /* unknown options are ignored, values above the limits are lowered */
+  client_request(1, opts, sizeof(opts) - 1);
+  fail_unless(rx_count == 1);
+  fail_unless(rx_pkt[0][1] == 6);
+  fail_unless(lwip_strnstr((const char *)&rx_pkt[0][2], "blksize", rx_len[0] - 2) != NULL);
+  fail_unless(lwip_strnstr((const char *)&rx_pkt[0][2], "tsize", rx_len[0] - 2) == NULL);
+  client_ack(0);
+  fail_unless(rx_count == TFTP_MAX_WINDOWSIZE);
+  fail_unless(rx_len[0] == 4 + TFTP_MAX_BLKSIZE);
+}
+END_TEST
+
+START_TEST(test_tftp_write_window)
+{
+  static const char opts[] = "blksize\0" "1024\0" "windowsize\0" "4\0";
+  u16_t blknum;
+  LWIP_UNUSED_ARG(_i);
+
+  client_request(2, opts, sizeof(opts) - 1);
+  fail_unless(rx_count == 1);
+  fail_unless(rx_pkt[0][1] == 6);
+  fail_unless(file_open);
+
+  /* one ACK per window of 4 blocks, and one for the short last block */
+  for (blknum = 1; blknum <= 5; blknum++) {
+    client_data(blknum, 1024);
+    if (blknum == 4 || blknum == 5) {
+      fail_unless(rx_count == 1);
+      fail_unless(is_packet(0, 4, blknum));
+    } else {
+      fail_unless(rx_count == 0);
+    }
+  }
+  fail_unless(!file_open);
+  fail_unless(file_len == FILE_SIZE);
+  fail_unless(memcmp(file_data, test_data_src, FILE_SIZE) == 0);
+}
+END_TEST
+
+START_TEST(test_tftp_write_window_gap)
+{
+  static const char opts[] = "blksize\0" "1024\0" "windowsize\0" "4\0";
+  u16_t blknum;
+  LWIP_UNUSED_ARG(_i);
+
+  client_request(2, opts, sizeof(opts) - 1);
+  client_data(1, 1024);
+  fail_unless(rx_count == 0);
+  /* block 2 lost: the gap is reported once by acknowledging block 1 */
+  client_data(3, 1024);
+  fail_unless(rx_count == 1);
+  fail_unless(is_packet(0, 4, 1));
+  client_data(4, 1024);
+  fail_unless(rx_count == 0);
+
+  /* the client goes back to block 2 */
+  for (blknum = 2; blknum <= 5; blknum++) {
+    client_data(blknum, 1024);
+  }
+  fail_unless(rx_count == 1);
+  fail_unless(is_packet(0, 4, 5));
+  fail_unless(file_len == FILE_SIZE);
+  fail_unless(memcmp(file_data, test_data_src, FILE_SIZE) == 0);
+}
+END_TEST
+
+START_TEST(test_tftp_write_busy)
+{
+  static const char opts[] = "blksize\0" "1024\0" "windowsize\0" "4\0";
+  u16_t blknum;
+  LWIP_UNUSED_ARG(_i);
+
+  client_request(2, opts, sizeof(opts) - 1);
+  client_data(1, 1024);
+  /* block 2 not taken: it is not acknowledged, block 3 reports the gap */
+  write_busy = 1;
+  client_data(2, 1024);
+  fail_unless(rx_count == 0);
+  client_data(3, 1024);
+  fail_unless(rx_count == 1);
+  fail_unless(is_packet(0, 4, 1));
+  fail_unless(file_len == 1024);
+
+  for (blknum = 2; blknum <= 5; blknum++) {
+    client_data(blknum, 1024);
+  }
+  fail_unless(rx_count == 1);
+  fail_unless(is_packet(0, 4, 5));
+  fail_unless(!file_open);
+  fail_unless(file_len == FILE_SIZE);
+  fail_unless(memcmp(file_data, test_data_src, FILE_SIZE) == 0);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+tftp_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_tftp_read_lockstep),
+    TESTFUNC(test_tftp_read_window),
+    TESTFUNC(test_tftp_read_window_loss),
+    TESTFUNC(test_tftp_read_stale_ack),
+    TESTFUNC(test_tftp_read_options_clamped),
+    TESTFUNC(test_tftp_write_window),
+    TESTFUNC(test_tftp_write_window_gap),
+    TESTFUNC(test_tftp_write_busy),
+  };
+  return create_suite("TFTP", tests, sizeof(tests)/sizeof(testfunc), tftp_setup, tftp_teardown);
+}
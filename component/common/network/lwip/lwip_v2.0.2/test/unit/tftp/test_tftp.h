@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_TFTP_H
+#define LWIP_HDR_TEST_TFTP_H
+
+#include "../lwip_check.h"
+
+Suite* tftp_suite(void);
+
+#endif
@@ -0,0 +1,560 @@
+/******************************************************************************
+ *
+ * SNMP agent integration for Ameba.
+ *
+ * Registers the lwIP MIB2 together with a private MIB that exposes WLAN link
+ * quality, heap usage and driver level packet counters:
+ *
+ *   .1.3.6.1.4.1.<enterprise>.<SNMP_AMEBA_MIB_ID>
+ *       .1  amebaWlan       rssi, snr, max data rate, channel, connected
+ *       .2  amebaSystem     free heap, min ever free heap, lwIP heap/pool usage
+ *       .3  amebaCounters   snmp_ameba_counters_t
+ *       .4  amebaStaTable   stations associated to the soft AP, indexed by MAC
+ *
+ * The agent runs on SNMP_USE_RAW, i.e. inside the tcpip thread, so MIB2
+ * handlers read stack state directly instead of posting one threadsync
+ * request per varbind.
+ *
+ * Tables are answered from a snapshot sorted by index through the cursor of
+ * snmp_ameba_cursor.c. The MIB2 tcpConnTable and ipNetToMediaTable, which
+ * lwIP answers by scanning every PCB or ARP entry for each GetNext, are
+ * registered again the same way as inner MIBs, which snmp_core prefers over
+ * the MIB2 nodes they cover.
+ *
+ ******************************************************************************/
+#include "snmp_ameba.h"
+
+#if LWIP_SNMP
+#include "lwip/apps/snmp_mib2.h"
+#include "lwip/apps/snmp_scalar.h"
+#include "lwip/apps/snmp_table.h"
+#include "lwip/etharp.h"
+#include "lwip/init.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+#include "lwip/priv/tcp_priv.h"
+
+#include <FreeRTOS.h>
+#include <wifi_conf.h>
+#include <string.h>
+
+snmp_ameba_counters_t snmp_ameba_counters;
+
+/* --- amebaWlan .1 --------------------------------------------------------- */
+
+static s16_t wlan_get_value(const struct snmp_scalar_array_node_def *node, void *value)
+{
+	s32_t *sint_ptr = (s32_t *)value;
+	u32_t *uint_ptr = (u32_t *)value;
+	int val = 0;
+	__u8 rate = 0;
+
+	switch (node->oid) {
+	case 1: /* amebaWlanRssi */
+		wifi_get_rssi(&val);
+		*sint_ptr = val;
+		break;
+	case 2: /* amebaWlanSnr */
+		wifi_get_snr(&val);
+		*sint_ptr = val;
+		break;
+	case 3: /* amebaWlanMaxDataRate, kbit/s */
+		wifi_get_sta_max_data_rate(&rate);
+		*uint_ptr = (u32_t)rate * 500;
+		break;
+	case 4: /* amebaWlanChannel */
+		wifi_get_channel(&val);
+		*sint_ptr = val;
+		break;
+	case 5: /* amebaWlanConnected, TruthValue */
+		*sint_ptr = (wifi_is_connected_to_ap() == RTW_SUCCESS) ? 1 : 2;
+		break;
+	default:
+		LWIP_DEBUGF(SNMP_MIB_DEBUG, ("wlan_get_value(): unknown id: %"U32_F"\n", node->oid));
+		return 0;
+	}
+
+	return sizeof(u32_t);
+}
+
+static const struct snmp_scalar_array_node_def wlan_nodes[] = {
+	{1, SNMP_ASN1_TYPE_INTEGER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaWlanRssi */
+	{2, SNMP_ASN1_TYPE_INTEGER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaWlanSnr */
+	{3, SNMP_ASN1_TYPE_GAUGE,   SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaWlanMaxDataRate */
+	{4, SNMP_ASN1_TYPE_INTEGER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaWlanChannel */
+	{5, SNMP_ASN1_TYPE_INTEGER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaWlanConnected */
+};
+
+static const struct snmp_scalar_array_node wlan_root = SNMP_SCALAR_CREATE_ARRAY_NODE(1, wlan_nodes, wlan_get_value, NULL, NULL);
+
+/* --- amebaSystem .2 ------------------------------------------------------- */
+
+static s16_t system_get_value(const struct snmp_scalar_array_node_def *node, void *value)
+{
+	u32_t *uint_ptr = (u32_t *)value;
+
+	switch (node->oid) {
+	case 1: /* amebaFreeHeap */
+		*uint_ptr = (u32_t)xPortGetFreeHeapSize();
+		break;
+	case 2: /* amebaMinEverFreeHeap */
+		*uint_ptr = (u32_t)xPortGetMinimumEverFreeHeapSize();
+		break;
+	case 3: /* amebaLwipHeapUsed */
+#if MEM_STATS
+		*uint_ptr = (u32_t)lwip_stats.mem.used;
+#else
+		*uint_ptr = 0;
+#endif
+		break;
+	case 4: /* amebaPbufPoolUsed */
+#if MEMP_STATS
+		*uint_ptr = (u32_t)lwip_stats.memp[MEMP_PBUF_POOL]->used;
+#else
+		*uint_ptr = 0;
+#endif
+		break;
+	default:
+		LWIP_DEBUGF(SNMP_MIB_DEBUG, ("system_get_value(): unknown id: %"U32_F"\n", node->oid));
+		return 0;
+	}
+
+	return sizeof(*uint_ptr);
+}
+
+static const struct snmp_scalar_array_node_def system_nodes[] = {
+	{1, SNMP_ASN1_TYPE_GAUGE, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaFreeHeap */
+	{2, SNMP_ASN1_TYPE_GAUGE, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaMinEverFreeHeap */
+	{3, SNMP_ASN1_TYPE_GAUGE, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaLwipHeapUsed */
+	{4, SNMP_ASN1_TYPE_GAUGE, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaPbufPoolUsed */
+};
+
+static const struct snmp_scalar_array_node system_root = SNMP_SCALAR_CREATE_ARRAY_NODE(2, system_nodes, system_get_value, NULL, NULL);
+
+/* --- amebaCounters .3 ----------------------------------------------------- */
+
+static s16_t counters_get_value(const struct snmp_scalar_array_node_def *node, void *value)
+{
+	u32_t *uint_ptr = (u32_t *)value;
+	/* sub-id n maps to the n-th word of snmp_ameba_counters_t */
+	const volatile u32_t *counters = (const volatile u32_t *)&snmp_ameba_counters;
+
+	if ((node->oid == 0) || (node->oid > sizeof(snmp_ameba_counters_t) / sizeof(u32_t)))
+		return 0;
+
+	*uint_ptr = counters[node->oid - 1];
+	return sizeof(*uint_ptr);
+}
+
+static const struct snmp_scalar_array_node_def counters_nodes[] = {
+	{1, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaRxFrames */
+	{2, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaRxOctets */
+	{3, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaRxDropNoPbuf */
+	{4, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaRxDropIfDown */
+	{5, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaTxFrames */
+	{6, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaTxOctets */
+	{7, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaTxDropBusy */
+	{8, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaTxDropIfDown */
+	{9, SNMP_ASN1_TYPE_COUNTER, SNMP_NODE_INSTANCE_READ_ONLY},	/* amebaRxDropMcast */
+};
+
+static const struct snmp_scalar_array_node counters_root = SNMP_SCALAR_CREATE_ARRAY_NODE(3, counters_nodes, counters_get_value, NULL, NULL);
+
+/* --- amebaStaTable .4 ----------------------------------------------------- */
+
+#define STA_KEY_LEN		6
+
+static struct {
+	u32_t keys[SNMP_AMEBA_MAX_STA * STA_KEY_LEN];
+	u8_t mac[SNMP_AMEBA_MAX_STA][6];
+	u16_t count;
+	u32_t stamp;
+	u8_t valid;
+	struct snmp_ameba_cursor_table cursor;
+} sta_snapshot;
+
+/* Re-reads the client list at most once per SNMP_AMEBA_SNAPSHOT_MS, sorted by MAC */
+static void sta_snapshot_refresh(void)
+{
+	struct {
+		u32_t count;
+		rtw_mac_t mac_list[SNMP_AMEBA_MAX_STA];
+	} client_info;
+	u32_t now = sys_now();
+	u16_t i, j;
+
+	if (sta_snapshot.valid && ((u32_t)(now - sta_snapshot.stamp) < SNMP_AMEBA_SNAPSHOT_MS))
+		return;
+
+	client_info.count = SNMP_AMEBA_MAX_STA;
+	if (wifi_get_associated_client_list(&client_info, sizeof(client_info)) != RTW_SUCCESS)
+		client_info.count = 0;
+	if (client_info.count > SNMP_AMEBA_MAX_STA)
+		client_info.count = SNMP_AMEBA_MAX_STA;
+
+	/* insertion sort, the list is short */
+	sta_snapshot.count = 0;
+	for (i = 0; i < client_info.count; i++) {
+		const u8_t *mac = client_info.mac_list[i].octet;
+
+		for (j = sta_snapshot.count; (j > 0) && (memcmp(sta_snapshot.mac[j - 1], mac, 6) > 0); j--)
+			memcpy(sta_snapshot.mac[j], sta_snapshot.mac[j - 1], 6);
+		memcpy(sta_snapshot.mac[j], mac, 6);
+		sta_snapshot.count++;
+	}
+	for (i = 0; i < sta_snapshot.count; i++) {
+		for (j = 0; j < STA_KEY_LEN; j++)
+			sta_snapshot.keys[i * STA_KEY_LEN + j] = sta_snapshot.mac[i][j];
+	}
+
+	snmp_ameba_cursor_reset(&sta_snapshot.cursor, sta_snapshot.keys, STA_KEY_LEN, sta_snapshot.count);
+	sta_snapshot.stamp = now;
+	sta_snapshot.valid = 1;
+}
+
+static snmp_err_t sta_table_get_cell_value_core(u16_t row, const u32_t *column, union snmp_variant_value *value, u32_t *value_len)
+{
+	switch (*column) {
+	case 1: /* amebaStaMacAddress */
+		value->const_ptr = sta_snapshot.mac[row];
+		*value_len = 6;
+		break;
+	default:
+		return SNMP_ERR_NOSUCHINSTANCE;
+	}
+
+	return SNMP_ERR_NOERROR;
+}
+
+static snmp_err_t sta_table_get_cell_value(const u32_t *column, const u32_t *row_oid, u8_t row_oid_len, union snmp_variant_value *value, u32_t *value_len)
+{
+	s32_t row;
+
+	sta_snapshot_refresh();
+	row = snmp_ameba_cursor_find(&sta_snapshot.cursor, row_oid, row_oid_len);
+	if (row < 0)
+		return SNMP_ERR_NOSUCHINSTANCE;
+
+	return sta_table_get_cell_value_core((u16_t)row, column, value, value_len);
+}
+
+static snmp_err_t sta_table_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
+{
+	s32_t row;
+
+	sta_snapshot_refresh();
+	row = snmp_ameba_cursor_next(&sta_snapshot.cursor, row_oid->id, row_oid->len);
+	if (row < 0)
+		return SNMP_ERR_NOSUCHINSTANCE;
+
+	snmp_oid_assign(row_oid, &sta_snapshot.keys[row * STA_KEY_LEN], STA_KEY_LEN);
+	return sta_table_get_cell_value_core((u16_t)row, column, value, value_len);
+}
+
+static const struct snmp_table_simple_col_def sta_table_columns[] = {
+	{1, SNMP_ASN1_TYPE_OCTET_STRING, SNMP_VARIANT_VALUE_TYPE_CONST_PTR},	/* amebaStaMacAddress */
+};
+
+static const struct snmp_table_simple_node sta_table = SNMP_TABLE_CREATE_SIMPLE(4, sta_table_columns, sta_table_get_cell_value, sta_table_get_next_cell_instance_and_value);
+
+/* --- MIB2 tcpConnTable .1.3.6.1.2.1.6.13 ---------------------------------- */
+
+#if LWIP_TCP && LWIP_IPV4
+
+#define TCP_KEY_LEN		10	/* local address, local port, remote address, remote port */
+
+static struct {
+	u32_t keys[SNMP_AMEBA_MAX_TCP * TCP_KEY_LEN];
+	u8_t state[SNMP_AMEBA_MAX_TCP];
+	u16_t count;
+	u32_t stamp;
+	u8_t valid;
+	struct snmp_ameba_cursor_table cursor;
+} tcp_snapshot;
+
+/* Re-reads the PCB lists at most once per SNMP_AMEBA_SNAPSHOT_MS, sorted by index as in lwIP */
+static void tcp_snapshot_refresh(void)
+{
+	u32_t now = sys_now();
+	u32_t key[TCP_KEY_LEN];
+	struct tcp_pcb *pcb;
+	s32_t row;
+	u8_t i;
+
+	if (tcp_snapshot.valid && ((u32_t)(now - tcp_snapshot.stamp) < SNMP_AMEBA_SNAPSHOT_MS))
+		return;
+
+	tcp_snapshot.count = 0;
+	for (i = 0; i < LWIP_ARRAYSIZE(tcp_pcb_lists); i++) {
+		for (pcb = *tcp_pcb_lists[i]; (pcb != NULL) && (tcp_snapshot.count < SNMP_AMEBA_MAX_TCP); pcb = pcb->next) {
+			if (!IP_IS_V4_VAL(pcb->local_ip))
+				continue;
+			snmp_ip4_to_oid(ip_2_ip4(&pcb->local_ip), &key[0]);
+			key[4] = pcb->local_port;
+			/* PCBs in state LISTEN are not connected and have no remote_ip or remote_port */
+			if (pcb->state == LISTEN) {
+				snmp_ip4_to_oid(IP4_ADDR_ANY4, &key[5]);
+				key[9] = 0;
+			} else {
+				if (!IP_IS_V4_VAL(pcb->remote_ip))
+					continue;
+				snmp_ip4_to_oid(ip_2_ip4(&pcb->remote_ip), &key[5]);
+				key[9] = pcb->remote_port;
+			}
+
+			row = snmp_ameba_cursor_insert(tcp_snapshot.keys, TCP_KEY_LEN, tcp_snapshot.count, key);
+			if (row < 0)
+				continue;
+			memmove(&tcp_snapshot.state[row + 1], &tcp_snapshot.state[row], tcp_snapshot.count - row);
+			tcp_snapshot.state[row] = (u8_t)pcb->state;
+			tcp_snapshot.count++;
+		}
+	}
+
+	snmp_ameba_cursor_reset(&tcp_snapshot.cursor, tcp_snapshot.keys, TCP_KEY_LEN, tcp_snapshot.count);
+	tcp_snapshot.stamp = now;
+	tcp_snapshot.valid = 1;
+}
+
+static snmp_err_t tcp_table_get_cell_value_core(u16_t row, const u32_t *column, union snmp_variant_value *value, u32_t *value_len)
+{
+	const u32_t *key = &tcp_snapshot.keys[row * TCP_KEY_LEN];
+	ip4_addr_t ip;
+
+	LWIP_UNUSED_ARG(value_len);
+
+	switch (*column) {
+	case 1: /* tcpConnState */
+		value->u32 = (u32_t)tcp_snapshot.state[row] + 1;
+		break;
+	case 2: /* tcpConnLocalAddress */
+		snmp_oid_to_ip4(&key[0], &ip);
+		value->u32 = ip.addr;
+		break;
+	case 3: /* tcpConnLocalPort */
+		value->u32 = key[4];
+		break;
+	case 4: /* tcpConnRemAddress */
+		snmp_oid_to_ip4(&key[5], &ip);
+		value->u32 = ip.addr;
+		break;
+	case 5: /* tcpConnRemPort */
+		value->u32 = key[9];
+		break;
+	default:
+		return SNMP_ERR_NOSUCHINSTANCE;
+	}
+
+	return SNMP_ERR_NOERROR;
+}
+
+static snmp_err_t tcp_table_get_cell_value(const u32_t *column, const u32_t *row_oid, u8_t row_oid_len, union snmp_variant_value *value, u32_t *value_len)
+{
+	s32_t row;
+
+	tcp_snapshot_refresh();
+	row = snmp_ameba_cursor_find(&tcp_snapshot.cursor, row_oid, row_oid_len);
+	if (row < 0)
+		return SNMP_ERR_NOSUCHINSTANCE;
+
+	return tcp_table_get_cell_value_core((u16_t)row, column, value, value_len);
+}
+
+static snmp_err_t tcp_table_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
+{
+	s32_t row;
+
+	tcp_snapshot_refresh();
+	row = snmp_ameba_cursor_next(&tcp_snapshot.cursor, row_oid->id, row_oid->len);
+	if (row < 0)
+		return SNMP_ERR_NOSUCHINSTANCE;
+
+	snmp_oid_assign(row_oid, &tcp_snapshot.keys[row * TCP_KEY_LEN], TCP_KEY_LEN);
+	return tcp_table_get_cell_value_core((u16_t)row, column, value, value_len);
+}
+
+static const struct snmp_table_simple_col_def tcp_table_columns[] = {
+	{1, SNMP_ASN1_TYPE_INTEGER, SNMP_VARIANT_VALUE_TYPE_U32},	/* tcpConnState */
+	{2, SNMP_ASN1_TYPE_IPADDR,  SNMP_VARIANT_VALUE_TYPE_U32},	/* tcpConnLocalAddress */
+	{3, SNMP_ASN1_TYPE_INTEGER, SNMP_VARIANT_VALUE_TYPE_U32},	/* tcpConnLocalPort */
+	{4, SNMP_ASN1_TYPE_IPADDR,  SNMP_VARIANT_VALUE_TYPE_U32},	/* tcpConnRemAddress */
+	{5, SNMP_ASN1_TYPE_INTEGER, SNMP_VARIANT_VALUE_TYPE_U32},	/* tcpConnRemPort */
+};
+
+static const struct snmp_table_simple_node tcp_table = SNMP_TABLE_CREATE_SIMPLE(13, tcp_table_columns, tcp_table_get_cell_value, tcp_table_get_next_cell_instance_and_value);
+
+static const u32_t tcp_table_base_oid[] = {1, 3, 6, 1, 2, 1, 6, 13};
+static const struct snmp_mib tcp_table_mib = SNMP_MIB_CREATE(tcp_table_base_oid, &tcp_table.node.node);
+
+#endif /* LWIP_TCP && LWIP_IPV4 */
+
+/* --- MIB2 ipNetToMediaTable .1.3.6.1.2.1.4.22 ------------------------------ */
+
+#if LWIP_ARP && LWIP_IPV4
+
+#define ARP_KEY_LEN		5	/* ifIndex, IP address */
+
+static struct {
+	u32_t keys[ARP_TABLE_SIZE * ARP_KEY_LEN];
+	struct eth_addr mac[ARP_TABLE_SIZE];
+	u16_t count;
+	u32_t stamp;
+	u8_t valid;
+	struct snmp_ameba_cursor_table cursor;
+} arp_snapshot;
+
+/* Re-reads the ARP cache at most once per SNMP_AMEBA_SNAPSHOT_MS, sorted by index as in lwIP */
+static void arp_snapshot_refresh(void)
+{
+	u32_t now = sys_now();
+	u32_t key[ARP_KEY_LEN];
+	ip4_addr_t *ip;
+	struct netif *netif;
+	struct eth_addr *ethaddr;
+	s32_t row;
+	u8_t i;
+
+	if (arp_snapshot.valid && ((u32_t)(now - arp_snapshot.stamp) < SNMP_AMEBA_SNAPSHOT_MS))
+		return;
+
+	arp_snapshot.count = 0;
+	for (i = 0; i < ARP_TABLE_SIZE; i++) {
+		if (!etharp_get_entry(i, &ip, &netif, &ethaddr))
+			continue;
+		key[0] = netif_to_num(netif);
+		snmp_ip4_to_oid(ip, &key[1]);
+
+		row = snmp_ameba_cursor_insert(arp_snapshot.keys, ARP_KEY_LEN, arp_snapshot.count, key);
+		if (row < 0)
+			continue;
+		memmove(&arp_snapshot.mac[row + 1], &arp_snapshot.mac[row], (arp_snapshot.count - row) * sizeof(struct eth_addr));
+		arp_snapshot.mac[row] = *ethaddr;
+		arp_snapshot.count++;
+	}
+
+	snmp_ameba_cursor_reset(&arp_snapshot.cursor, arp_snapshot.keys, ARP_KEY_LEN, arp_snapshot.count);
+	arp_snapshot.stamp = now;
+	arp_snapshot.valid = 1;
+}
+
+static snmp_err_t arp_table_get_cell_value_core(u16_t row, const u32_t *column, union snmp_variant_value *value, u32_t *value_len)
+{
+	const u32_t *key = &arp_snapshot.keys[row * ARP_KEY_LEN];
+	ip4_addr_t ip;
+
+	switch (*column) {
+	case 1: /* ipNetToMediaIfIndex */
+		value->u32 = key[0];
+		break;
+	case 2: /* ipNetToMediaPhysAddress */
+		value->const_ptr = &arp_snapshot.mac[row];
+		*value_len = sizeof(struct eth_addr);
+		break;
+	case 3: /* ipNetToMediaNetAddress */
+		snmp_oid_to_ip4(&key[1], &ip);
+		value->u32 = ip.addr;
+		break;
+	case 4: /* ipNetToMediaType */
+		value->u32 = 3; /* dynamic */
+		break;
+	default:
+		return SNMP_ERR_NOSUCHINSTANCE;
+	}
+
+	return SNMP_ERR_NOERROR;
+}
+
+static snmp_err_t arp_table_get_cell_value(const u32_t *column, const u32_t *row_oid, u8_t row_oid_len, union snmp_variant_value *value, u32_t *value_len)
+{
+	s32_t row;
+
+	arp_snapshot_refresh();
+	row = snmp_ameba_cursor_find(&arp_snapshot.cursor, row_oid, row_oid_len);
+	if (row < 0)
+		return SNMP_ERR_NOSUCHINSTANCE;
+
+	return arp_table_get_cell_value_core((u16_t)row, column, value, value_len);
+}
+
+static snmp_err_t arp_table_get_next_cell_instance_and_value(const u32_t *column, struct snmp_obj_id *row_oid, union snmp_variant_value *value, u32_t *value_len)
+{
+	s32_t row;
+
+	arp_snapshot_refresh();
+	row = snmp_ameba_cursor_next(&arp_snapshot.cursor, row_oid->id, row_oid->len);
+	if (row < 0)
+		return SNMP_ERR_NOSUCHINSTANCE;
+
+	snmp_oid_assign(row_oid, &arp_snapshot.keys[row * ARP_KEY_LEN], ARP_KEY_LEN);
+	return arp_table_get_cell_value_core((u16_t)row, column, value, value_len);
+}
+
+static const struct snmp_table_simple_col_def arp_table_columns[] = {
+	{1, SNMP_ASN1_TYPE_INTEGER,      SNMP_VARIANT_VALUE_TYPE_U32},		/* ipNetToMediaIfIndex */
+	{2, SNMP_ASN1_TYPE_OCTET_STRING, SNMP_VARIANT_VALUE_TYPE_CONST_PTR},	/* ipNetToMediaPhysAddress */
+	{3, SNMP_ASN1_TYPE_IPADDR,       SNMP_VARIANT_VALUE_TYPE_U32},		/* ipNetToMediaNetAddress */
+	{4, SNMP_ASN1_TYPE_INTEGER,      SNMP_VARIANT_VALUE_TYPE_U32},		/* ipNetToMediaType */
+};
+
+static const struct snmp_table_simple_node arp_table = SNMP_TABLE_CREATE_SIMPLE(22, arp_table_columns, arp_table_get_cell_value, arp_table_get_next_cell_instance_and_value);
+
+static const u32_t arp_table_base_oid[] = {1, 3, 6, 1, 2, 1, 4, 22};
+static const struct snmp_mib arp_table_mib = SNMP_MIB_CREATE(arp_table_base_oid, &arp_table.node.node);
+
+#endif /* LWIP_ARP && LWIP_IPV4 */
+
+/* --- root ----------------------------------------------------------------- */
+
+static const struct snmp_node *const ameba_nodes[] = {
+	&wlan_root.node.node,
+	&system_root.node.node,
+	&counters_root.node.node,
+	&sta_table.node.node
+};
+
+static const struct snmp_tree_node ameba_root = SNMP_CREATE_TREE_NODE(SNMP_AMEBA_MIB_ID, ameba_nodes);
+
+static const u32_t ameba_base_oid[] = {1, 3, 6, 1, 4, 1, SNMP_LWIP_ENTERPRISE_OID, SNMP_AMEBA_MIB_ID};
+const struct snmp_mib snmp_ameba_mib = SNMP_MIB_CREATE(ameba_base_oid, &ameba_root.node);
+
+static const struct snmp_mib *ameba_mibs[] = {
+#if SNMP_LWIP_MIB2
+	&mib2,
+	/* inner MIBs, in place of the MIB2 tables they cover */
+#if LWIP_TCP && LWIP_IPV4
+	&tcp_table_mib,
+#endif
+#if LWIP_ARP && LWIP_IPV4
+	&arp_table_mib,
+#endif
+#endif
+	&snmp_ameba_mib
+};
+
+static const u8_t ameba_sysdescr[] = "Realtek Ameba lwIP " LWIP_VERSION_STRING;
+
+static void snmp_ameba_init_core(void *ctx)
+{
+	LWIP_UNUSED_ARG(ctx);
+
+#if SNMP_LWIP_MIB2
+	snmp_mib2_set_sysdescr(ameba_sysdescr, NULL);
+#endif
+	snmp_set_mibs(ameba_mibs, (u8_t)LWIP_ARRAYSIZE(ameba_mibs));
+	snmp_init();
+}
+
+void snmp_ameba_init(void)
+{
+	/* raw API agent must be set up from the tcpip thread */
+	tcpip_callback(snmp_ameba_init_core, NULL);
+}
+
+#else
+
+void snmp_ameba_init(void)
+{
+}
+
+#endif /* LWIP_SNMP */
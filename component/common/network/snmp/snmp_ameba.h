@@ -0,0 +1,92 @@
+#ifndef __SNMP_AMEBA_H__
+#define __SNMP_AMEBA_H__
+
+#include "lwip/opt.h"
+
+#if LWIP_SNMP
+#include "lwip/apps/snmp.h"
+#include "lwip/apps/snmp_core.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sub-identifier of the Ameba private MIB below the device enterprise OID,
+ * i.e. .1.3.6.1.4.1.<SNMP_LWIP_ENTERPRISE_OID>.SNMP_AMEBA_MIB_ID */
+#ifndef SNMP_AMEBA_MIB_ID
+#define SNMP_AMEBA_MIB_ID			8710
+#endif
+
+/* Max. rows kept in the station table snapshot */
+#ifndef SNMP_AMEBA_MAX_STA
+#define SNMP_AMEBA_MAX_STA			8
+#endif
+
+/* Max. rows kept in the tcpConnTable snapshot, every PCB there can be */
+#ifndef SNMP_AMEBA_MAX_TCP
+#define SNMP_AMEBA_MAX_TCP			(MEMP_NUM_TCP_PCB + MEMP_NUM_TCP_PCB_LISTEN)
+#endif
+
+/* A walk re-reads driver and stack tables at most once per SNMP_AMEBA_SNAPSHOT_MS */
+#ifndef SNMP_AMEBA_SNAPSHOT_MS
+#define SNMP_AMEBA_SNAPSHOT_MS		1000
+#endif
+
+/*
+ * Driver level counters. Each counter has a single writer (the WLAN RX path
+ * or the tcpip thread) and is a naturally aligned 32-bit word, so writers
+ * increment without locking and the agent reads them without taking the
+ * tcpip thread.
+ */
+typedef struct snmp_ameba_counters {
+	volatile u32_t rx_frames;
+	volatile u32_t rx_octets;
+	volatile u32_t rx_drop_nopbuf;
+	volatile u32_t rx_drop_ifdown;
+	volatile u32_t tx_frames;
+	volatile u32_t tx_octets;
+	volatile u32_t tx_drop_busy;
+	volatile u32_t tx_drop_ifdown;
+	volatile u32_t rx_drop_mcast;	/* multicast to a group nobody joined */
+} snmp_ameba_counters_t;
+
+#if LWIP_SNMP
+extern snmp_ameba_counters_t snmp_ameba_counters;
+#define SNMP_AMEBA_CNT_INC(name)		(snmp_ameba_counters.name++)
+#define SNMP_AMEBA_CNT_ADD(name, n)		(snmp_ameba_counters.name += (u32_t)(n))
+#else
+#define SNMP_AMEBA_CNT_INC(name)
+#define SNMP_AMEBA_CNT_ADD(name, n)
+#endif
+
+/*
+ * Sorted row index with a get-next cursor. Rows are kept ordered by their
+ * index OID; the cursor remembers the row returned last so that the
+ * GetNext/GetBulk of a walk resolves in O(1) instead of rescanning all rows,
+ * and a random GetNext falls back to a binary search.
+ */
+struct snmp_ameba_cursor_table {
+	const u32_t *keys;		/* row_count * key_len sub-ids, ascending */
+	u16_t key_len;
+	u16_t row_count;
+	u16_t cursor;			/* row returned by the last lookup */
+	u8_t cursor_valid;
+};
+
+void snmp_ameba_cursor_reset(struct snmp_ameba_cursor_table *table, const u32_t *keys, u16_t key_len, u16_t row_count);
+s32_t snmp_ameba_cursor_find(struct snmp_ameba_cursor_table *table, const u32_t *oid, u8_t oid_len);
+s32_t snmp_ameba_cursor_next(struct snmp_ameba_cursor_table *table, const u32_t *oid, u8_t oid_len);
+s32_t snmp_ameba_cursor_insert(u32_t *keys, u16_t key_len, u16_t row_count, const u32_t *key);
+
+#if LWIP_SNMP
+extern const struct snmp_mib snmp_ameba_mib;
+#endif
+
+void snmp_ameba_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SNMP_AMEBA_H__ */
@@ -0,0 +1,129 @@
+/******************************************************************************
+ *
+ * Sorted row index with a get-next cursor for the tables of snmp_ameba.c.
+ *
+ * Kept apart from the MIB so that it builds without the WLAN driver and the
+ * agent, for the lwIP unit tests (test/unit/snmp).
+ *
+ ******************************************************************************/
+#include "snmp_ameba.h"
+
+#include <string.h>
+
+void snmp_ameba_cursor_reset(struct snmp_ameba_cursor_table *table, const u32_t *keys, u16_t key_len, u16_t row_count)
+{
+	table->keys = keys;
+	table->key_len = key_len;
+	table->row_count = row_count;
+	table->cursor = 0;
+	table->cursor_valid = 0;
+}
+
+/* Same order as snmp_oid_compare() */
+static s8_t cursor_cmp_key(const u32_t *key, u16_t key_len, const u32_t *oid, u8_t oid_len)
+{
+	u16_t i;
+
+	for (i = 0; (i < key_len) && (i < oid_len); i++) {
+		if (key[i] != oid[i])
+			return (key[i] < oid[i]) ? -1 : 1;
+	}
+	if (key_len == oid_len)
+		return 0;
+	return (key_len < oid_len) ? -1 : 1;
+}
+
+static s8_t cursor_cmp_row(const struct snmp_ameba_cursor_table *table, u16_t row, const u32_t *oid, u8_t oid_len)
+{
+	return cursor_cmp_key(&table->keys[row * table->key_len], table->key_len, oid, oid_len);
+}
+
+/* Returns the row whose key equals oid, -1 if there is none */
+s32_t snmp_ameba_cursor_find(struct snmp_ameba_cursor_table *table, const u32_t *oid, u8_t oid_len)
+{
+	u16_t lo = 0, hi = table->row_count;
+
+	if (oid_len != table->key_len)
+		return -1;
+
+	if (table->cursor_valid && (table->cursor < table->row_count) &&
+	    (cursor_cmp_row(table, table->cursor, oid, oid_len) == 0))
+		return table->cursor;
+
+	while (lo < hi) {
+		u16_t mid = (u16_t)((lo + hi) / 2);
+		s8_t cmp = cursor_cmp_row(table, mid, oid, oid_len);
+
+		if (cmp == 0) {
+			table->cursor = mid;
+			table->cursor_valid = 1;
+			return mid;
+		}
+		if (cmp < 0)
+			lo = (u16_t)(mid + 1);
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
+/* Returns the first row whose key is lexicographically greater than oid, -1 at end of table */
+s32_t snmp_ameba_cursor_next(struct snmp_ameba_cursor_table *table, const u32_t *oid, u8_t oid_len)
+{
+	u16_t lo = 0, hi = table->row_count;
+	u16_t next;
+
+	/* walk in progress: the manager asks for the successor of the row returned last */
+	if (table->cursor_valid && (table->cursor < table->row_count) &&
+	    (cursor_cmp_row(table, table->cursor, oid, oid_len) == 0)) {
+		next = (u16_t)(table->cursor + 1);
+		goto found;
+	}
+
+	while (lo < hi) {
+		u16_t mid = (u16_t)((lo + hi) / 2);
+
+		if (cursor_cmp_row(table, mid, oid, oid_len) <= 0)
+			lo = (u16_t)(mid + 1);
+		else
+			hi = mid;
+	}
+	next = lo;
+
+found:
+	if (next >= table->row_count) {
+		/* next column restarts from the first row */
+		table->cursor_valid = 0;
+		return -1;
+	}
+	table->cursor = next;
+	table->cursor_valid = 1;
+	return next;
+}
+
+/*
+ * Inserts key into the row_count ascending keys, moving the rows after it up
+ * by one; the caller moves its row data the same way. Returns the new row, -1
+ * if the key is there already (a walk must never see the same index twice).
+ */
+s32_t snmp_ameba_cursor_insert(u32_t *keys, u16_t key_len, u16_t row_count, const u32_t *key)
+{
+	u16_t lo = 0, hi = row_count;
+
+	while (lo < hi) {
+		u16_t mid = (u16_t)((lo + hi) / 2);
+		s8_t cmp = cursor_cmp_key(&keys[mid * key_len], key_len, key, (u8_t)key_len);
+
+		if (cmp == 0)
+			return -1;
+		if (cmp < 0)
+			lo = (u16_t)(mid + 1);
+		else
+			hi = mid;
+	}
+
+	memmove(&keys[(lo + 1) * key_len], &keys[lo * key_len], (size_t)(row_count - lo) * key_len * sizeof(u32_t));
+	memcpy(&keys[lo * key_len], key, key_len * sizeof(u32_t));
+	return lo;
+}
@@ -0,0 +1,266 @@
+#include "tftp_flash.h"
+
+#include "lwip/def.h"
+#include "lwip/sys.h"
+#include "lwip/tcpip.h"
+#include "flash_api.h"
+#include "device_lock.h"
+#include "mbedtls/sha256.h"
+
+#include <string.h>
+
+#if LWIP_UDP
+
+#define TFTP_FLASH_SECTOR_SIZE		4096
+
+/* Blocks handed to the flash worker and not programmed yet. One slot is kept
+ * for the end of transfer message. */
+#ifndef TFTP_FLASH_QUEUE_LEN
+#define TFTP_FLASH_QUEUE_LEN		16
+#endif
+#ifndef TFTP_FLASH_THREAD_PRIO
+#define TFTP_FLASH_THREAD_PRIO		(TCPIP_THREAD_PRIO - 1)
+#endif
+#define TFTP_FLASH_THREAD_STACKSIZE	512
+
+/* end of transfer, in place of a pbuf */
+#define TFTP_FLASH_MSG_DONE			((void *) &tftp_flash)
+#define TFTP_FLASH_MSG_ABORT		((void *) &tftp_flash.flash)
+
+struct tftp_flash_state {
+	flash_t flash;
+	u32_t base;
+	u32_t max_len;
+	u32_t pos;			/* next offset to read or write */
+	u32_t erased;		/* bytes erased from base */
+	u8_t busy;			/* cleared by the worker once a write is finished */
+	u8_t write;
+	/* tcpip thread side of a write */
+	u32_t queued;		/* bytes handed to the worker */
+	u8_t last;			/* short block queued, the file is complete */
+	/* flash worker */
+	sys_mbox_t mbox;
+	int pending;		/* messages in mbox */
+	volatile u8_t failed;
+	/* last upload */
+	u8_t valid;
+	u32_t len;
+	u8_t digest[TFTP_FLASH_DIGEST_LEN];
+	mbedtls_sha256_context sha;
+};
+
+static struct tftp_flash_state tftp_flash;
+
+static void *tftp_flash_open(const char *fname, const char *mode, u8_t write)
+{
+	LWIP_UNUSED_ARG(fname);
+
+	if(tftp_flash.busy || (lwip_stricmp(mode, "octet") != 0))
+		return NULL;
+	if(!write && !tftp_flash.valid)
+		return NULL;
+
+	tftp_flash.pos = 0;
+	tftp_flash.write = write;
+	if(write) {
+		tftp_flash.valid = 0;
+		tftp_flash.erased = 0;
+		tftp_flash.queued = 0;
+		tftp_flash.last = 0;
+		tftp_flash.failed = 0;
+		mbedtls_sha256_init(&tftp_flash.sha);
+		mbedtls_sha256_starts(&tftp_flash.sha, 0);
+	}
+	tftp_flash.busy = 1;
+	return &tftp_flash;
+}
+
+/* Flash is erased and programmed by a worker task, so that sector erases do
+ * not hold up the tcpip thread the TFTP callbacks run in. */
+static void tftp_flash_program(struct pbuf *p)
+{
+	struct pbuf *q;
+
+	device_mutex_lock(RT_DEV_LOCK_FLASH);
+	/* erase sectors only when the data reaches them */
+	while(tftp_flash.erased < (tftp_flash.pos + p->tot_len)) {
+		flash_erase_sector(&tftp_flash.flash, tftp_flash.base + tftp_flash.erased);
+		tftp_flash.erased += TFTP_FLASH_SECTOR_SIZE;
+	}
+	for(q = p; q != NULL; q = q->next) {
+		if(flash_stream_write(&tftp_flash.flash, tftp_flash.base + tftp_flash.pos, q->len, q->payload) < 0) {
+			tftp_flash.failed = 1;
+			break;
+		}
+		mbedtls_sha256_update(&tftp_flash.sha, q->payload, q->len);
+		tftp_flash.pos += q->len;
+	}
+	device_mutex_unlock(RT_DEV_LOCK_FLASH);
+}
+
+static void tftp_flash_finish(u8_t complete)
+{
+	mbedtls_sha256_finish(&tftp_flash.sha, tftp_flash.digest);
+	mbedtls_sha256_free(&tftp_flash.sha);
+	if(complete && !tftp_flash.failed) {
+		tftp_flash.len = tftp_flash.pos;
+		tftp_flash.valid = 1;
+		printf("\n\rTFTP: %u bytes written to flash 0x%x\n", tftp_flash.len, tftp_flash.base);
+	}
+	else
+		printf("\n\rTFTP: upload aborted after %u bytes\n", tftp_flash.pos);
+	tftp_flash.busy = 0;
+}
+
+static void tftp_flash_thread(void *arg)
+{
+	void *msg;
+	SYS_ARCH_DECL_PROTECT(lev);
+	LWIP_UNUSED_ARG(arg);
+
+	while(1) {
+		sys_arch_mbox_fetch(&tftp_flash.mbox, &msg, 0);
+		if((msg == TFTP_FLASH_MSG_DONE) || (msg == TFTP_FLASH_MSG_ABORT))
+			tftp_flash_finish(msg == TFTP_FLASH_MSG_DONE);
+		else {
+			if(!tftp_flash.failed)
+				tftp_flash_program((struct pbuf *) msg);
+			pbuf_free((struct pbuf *) msg);
+		}
+		SYS_ARCH_PROTECT(lev);
+		tftp_flash.pending--;
+		SYS_ARCH_UNPROTECT(lev);
+	}
+}
+
+static int tftp_flash_post(void *msg, int reserve)
+{
+	int ret = -1;
+	SYS_ARCH_DECL_PROTECT(lev);
+
+	SYS_ARCH_PROTECT(lev);
+	if(tftp_flash.pending < (TFTP_FLASH_QUEUE_LEN - reserve)) {
+		tftp_flash.pending++;
+		ret = 0;
+	}
+	SYS_ARCH_UNPROTECT(lev);
+	/* a slot was counted, so the post cannot fail */
+	if(ret == 0)
+		sys_mbox_trypost(&tftp_flash.mbox, msg);
+	return ret;
+}
+
+static void tftp_flash_close(void *handle)
+{
+	LWIP_UNUSED_ARG(handle);
+
+	/* lwIP closes after the last block, but also on timeouts and errors */
+	if(tftp_flash.write)
+		tftp_flash_post(tftp_flash.last ? TFTP_FLASH_MSG_DONE : TFTP_FLASH_MSG_ABORT, 0);
+	else
+		tftp_flash.busy = 0;
+}
+
+static int tftp_flash_read(void *handle, void *buf, int bytes)
+{
+	u32_t n = tftp_flash.len - tftp_flash.pos;
+	LWIP_UNUSED_ARG(handle);
+
+	if(n > (u32_t) bytes)
+		n = bytes;
+	if(n > 0) {
+		device_mutex_lock(RT_DEV_LOCK_FLASH);
+		flash_stream_read(&tftp_flash.flash, tftp_flash.base + tftp_flash.pos, n, buf);
+		device_mutex_unlock(RT_DEV_LOCK_FLASH);
+		tftp_flash.pos += n;
+	}
+	return n;
+}
+
+static int tftp_flash_write(void *handle, struct pbuf *p)
+{
+	LWIP_UNUSED_ARG(handle);
+
+	if(tftp_flash.failed)
+		return -1;
+	if((tftp_flash.queued + p->tot_len) > tftp_flash.max_len) {
+		printf("\n\rTFTP: image exceeds %u bytes\n", tftp_flash.max_len);
+		return -1;
+	}
+
+	pbuf_ref(p);
+	if(tftp_flash_post(p, 1) < 0) {
+		/* worker behind: the client sends the block again later */
+		pbuf_free(p);
+		return ERR_WOULDBLOCK;
+	}
+	tftp_flash.queued += p->tot_len;
+	if(p->tot_len < tftp_get_blksize())
+		tftp_flash.last = 1;
+
+	return 0;
+}
+
+static const struct tftp_context tftp_flash_ctx = {
+	tftp_flash_open,
+	tftp_flash_close,
+	tftp_flash_read,
+	tftp_flash_write
+};
+
+static void tftp_flash_start_core(void *arg)
+{
+	LWIP_UNUSED_ARG(arg);
+
+	if(tftp_init(&tftp_flash_ctx) != ERR_OK)
+		printf("\n\rTFTP: server start failed\n");
+}
+
+static void tftp_flash_stop_core(void *arg)
+{
+	LWIP_UNUSED_ARG(arg);
+	tftp_cleanup();
+}
+
+int tftp_flash_server_start(u32_t flash_addr, u32_t max_len)
+{
+	if((flash_addr % TFTP_FLASH_SECTOR_SIZE) || (max_len % TFTP_FLASH_SECTOR_SIZE) || (max_len == 0))
+		return -1;
+
+	if(tftp_flash.busy)
+		return -1;
+	tftp_flash.base = flash_addr;
+	tftp_flash.max_len = max_len;
+	tftp_flash.valid = 0;
+
+	/* the worker is created once and kept, lwIP threads cannot be deleted */
+	if(!sys_mbox_valid(&tftp_flash.mbox)) {
+		if(sys_mbox_new(&tftp_flash.mbox, TFTP_FLASH_QUEUE_LEN) != ERR_OK)
+			return -1;
+		if(sys_thread_new("tftp_flash", tftp_flash_thread, NULL, TFTP_FLASH_THREAD_STACKSIZE, TFTP_FLASH_THREAD_PRIO) == NULL) {
+			sys_mbox_free(&tftp_flash.mbox);
+			sys_mbox_set_invalid(&tftp_flash.mbox);
+			return -1;
+		}
+	}
+
+	/* raw API server must be set up from the tcpip thread */
+	return (tcpip_callback(tftp_flash_start_core, NULL) == ERR_OK) ? 0 : -1;
+}
+
+void tftp_flash_server_stop(void)
+{
+	tcpip_callback(tftp_flash_stop_core, NULL);
+}
+
+int tftp_flash_get_result(u32_t *len, u8_t digest[TFTP_FLASH_DIGEST_LEN])
+{
+	if(!tftp_flash.valid)
+		return -1;
+
+	*len = tftp_flash.len;
+	memcpy(digest, tftp_flash.digest, TFTP_FLASH_DIGEST_LEN);
+	return 0;
+}
+
+#endif /* LWIP_UDP */
@@ -0,0 +1,35 @@
+#ifndef TFTP_FLASH_H
+#define TFTP_FLASH_H
+
+#include "lwip/apps/tftp_server.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TFTP_FLASH_DIGEST_LEN		32
+
+/*
+ * TFTP server backed by a flash region. A write request (WRQ) streams the
+ * received blocks into the region from a worker task, erasing each sector the
+ * first time it is reached, and hashes them with SHA-256 on the way. Blocks
+ * arriving while TFTP_FLASH_QUEUE_LEN are still waiting for flash are left
+ * for the client to send again. An upload counts only once its last block is
+ * written; a timed out or failed one leaves no result. A read request
+ * (RRQ) returns the image uploaded last. Blocks up to TFTP_MAX_BLKSIZE bytes
+ * and windows of TFTP_MAX_WINDOWSIZE blocks are negotiated with the client.
+ *
+ * flash_addr and max_len must be sector aligned.
+ */
+int tftp_flash_server_start(u32_t flash_addr, u32_t max_len);
+void tftp_flash_server_stop(void);
+
+/* Length and SHA-256 digest of the last upload, to be verified by the caller
+ * before the image is used. Returns -1 if nothing was uploaded yet. */
+int tftp_flash_get_result(u32_t *len, u8_t digest[TFTP_FLASH_DIGEST_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TFTP_FLASH_H */
@@ -30,6 +30,12 @@ do{\
 extern void lwip_selectevindicate(int fd);
 extern void lwip_setsockrcvevent(int fd, int rcvevent);
 extern int lwip_allocsocketsd();
+extern void serial_rx_fifo_level(serial_t *obj, SerialFifoLevel FifoLv);
+
+#if (UART_RECV_BUFFER_LEN & (UART_RECV_BUFFER_LEN - 1))
+#error "UART_RECV_BUFFER_LEN must be a power of two"
+#endif
+#define UART_RX_MASK	(UART_RECV_BUFFER_LEN - 1)
 
 /*************************************************************************
 *                               uart releated  fuantions                          *
@@ -37,21 +43,34 @@ extern int lwip_allocsocketsd();
 static void uart_irq(uint32_t id, SerialIrq event)
 {
 	uart_socket_t *u = (uart_socket_t *)id;
+	u32 head, count;
 
 	if(event == RxIrq) {
-		if( u->rx_start == 0 ){
-			rtw_up_sema_from_isr(&u->action_sema);	//up action semaphore 
-			u->rx_start = 1; // set this flag in uart_irq to indicate data recved
-		}
-		u->recv_buf[u->prxwrite++] = serial_getc(&u->sobj);
-		if(u->prxwrite > (UART_RECV_BUFFER_LEN -1)){	//restart from  head if  reach tail
-			u->prxwrite = 0;
-			u->rxoverlap = 1;							//set overlap indicated that overlaped 
-		}
-		if(u->rxoverlap && (u->prxwrite + 1) > u->prxread ){
-			u->prxread = u->prxwrite;		//if pwrite overhead pread ,pread is always flow rwrite 
+		/* The RX interrupt comes at half FIFO or on the FIFO timeout, drain
+		 * everything in one go. Only head is written here, the reader owns tail. */
+		head = u->rx_head;
+		while(serial_readable(&u->sobj)){
+			u8 c = (u8)serial_getc(&u->sobj);
+			if((head - u->rx_tail) < UART_RECV_BUFFER_LEN)
+				u->recv_buf[(head++) & UART_RX_MASK] = c;
+			else
+				u->rx_dropped++;	//ring full, the reader is behind
 		}
+		u->rx_head = head;
 		u->last_update =  xTaskGetTickCountFromISR();	// update tick everytime recved data
+
+		if(!u->rx_signalled){
+			count = head - u->rx_tail;
+			if(count >= u->rx_lowat){
+				u->rx_signalled = 1;	//uart_action_handler wakes select() at once
+				u->rx_start = 0;	//a pending quiet-line wait is moot now
+				rtw_up_sema_from_isr(&u->action_sema);
+			}
+			else if(count && (u->rx_start == 0)){
+				u->rx_start = 1;	//below the watermark, wait for the line to go quiet
+				rtw_up_sema_from_isr(&u->action_sema);
+			}
+		}
 	}
 
 	if(event == TxIrq){
@@ -102,7 +121,7 @@ static s32 uart_wait_rx_complete(uart_socket_t *u)
 {
 	s32 tick_current = xTaskGetTickCount();
 
-	while((tick_current -u->last_update) < UART_MAX_DELAY_TIME ){
+	while(((tick_current -u->last_update) < UART_MAX_DELAY_TIME) && !u->rx_signalled){
 		vTaskDelay(5);
 		tick_current = xTaskGetTickCount();
 	}	
@@ -118,14 +137,23 @@ static void uart_action_handler(void* param)
 	while(rtw_down_sema(&u->action_sema) == pdTRUE) {
 		if(u->fd == -1)
 			goto Exit;
-		if(u->rx_start){
-			/* Blocked here to wait uart rx data completed */
+		if(u->rx_start && !u->rx_signalled){
+			/* Blocked here to wait uart rx data completed, unless the
+			 * watermark is reached meanwhile */
 			uart_wait_rx_complete(u);
-
+			u->rx_start = 0;
+			if(u->rx_head != u->rx_tail)
+				u->rx_signalled = 1;
+		}
+		if(u->rx_signalled){
 			/* As we did not register netconn callback function.,so call lwip_selectevindicate unblocking select */
-			lwip_setsockrcvevent(u->fd, 1);
+			taskENTER_CRITICAL();
+			if(u->rx_signalled){	//the reader may have drained the ring meanwhile
+				lwip_setsockrcvevent(u->fd, 1);
+				u->rx_start = 0;	//re-arm uart_irq for the next burst below rx_lowat
+			}
+			taskEXIT_CRITICAL();
 			lwip_selectevindicate(u->fd);	//unblocking select()
-			u->rx_start = 0;
 		}
 		if(u->tx_start){
 #if 1			
@@ -172,6 +200,8 @@ uart_socket_t* uart_open(uart_set_str *puartpara)
 	serial_init(&u->sobj, uart_tx,uart_rx);
 	serial_baud(&u->sobj,puartpara->BaudRate);
 	serial_format(&u->sobj, puartpara->number, (SerialParity)puartpara->parity, puartpara->StopBits);
+	serial_rx_fifo_level(&u->sobj, FifoLvHalf);
+	u->rx_lowat = UART_RECV_BUFFER_LEN / 2;
 
 	/*uart irq handle*/
 	serial_irq_handler(&u->sobj, uart_irq, (int)u);
@@ -237,51 +267,104 @@ int uart_close(uart_socket_t *u)
 	return 0;
 }
 
+/**
+ * Zero copy read: describe the received data in place, as up to two
+ * regions of the ring (the second one when the data wraps). The data stays
+ * valid until uart_read_done().
+ *
+ * @return bytes available, -1 on error
+ */
+int uart_read_peek(uart_socket_t *u, struct iovec *iov, int iovcnt)
+{
+	u32 tail, count, first;
+
+	if(!u || !iov || iovcnt < 1){
+		uart_printf("uart_read_peek(): input error\r\n");
+		return -1;
+	}
+
+	tail = u->rx_tail;
+	count = u->rx_head - tail;
+	first = UART_RECV_BUFFER_LEN - (tail & UART_RX_MASK);
+	if(first > count)
+		first = count;
+
+	iov[0].iov_base = u->recv_buf + (tail & UART_RX_MASK);
+	iov[0].iov_len = first;
+	if(iovcnt < 2)
+		return first;
+	iov[1].iov_base = u->recv_buf;
+	iov[1].iov_len = count - first;
+	return count;
+}
+
+/**
+ * Release size bytes described by uart_read_peek(). select() stops
+ * reporting the socket readable once the ring is empty.
+ *
+ * @return bytes released
+ */
+int uart_read_done(uart_socket_t *u, size_t size)
+{
+	u32 count;
+
+	if(!u)
+		return -1;
+
+	taskENTER_CRITICAL();
+	count = u->rx_head - u->rx_tail;
+	if(size > count)
+		size = count;
+	u->rx_tail += size;
+	if(u->rx_head == u->rx_tail){
+		u->rx_signalled = 0;
+		lwip_setsockrcvevent(u->fd, 0);
+	}
+	taskEXIT_CRITICAL();
+
+	return size;
+}
+
+/**
+ * select() reports the socket readable as soon as lowat bytes are buffered,
+ * less data once the line has been quiet for UART_MAX_DELAY_TIME. The
+ * default, half the ring, keeps whole messages together at low rates and
+ * leaves the reader half a ring of time at high ones; 1 wakes it for every
+ * burst.
+ */
+int uart_set_rx_lowat(uart_socket_t *u, u32 lowat)
+{
+	if(!u || lowat == 0 || lowat > UART_RECV_BUFFER_LEN)
+		return -1;
+	u->rx_lowat = lowat;
+	return 0;
+}
+
 int uart_read(uart_socket_t *u, void *read_buf, size_t size)
 {
 	/*the same as socket*/
-	int read_bytes = 0;
-	int pread_local,pwrite_local;
-	char *ptr = (char *)read_buf;
+	struct iovec iov[2];
+	int read_bytes;
+	size_t n;
 
-	uart_printf("==>uart_read()\n");
 	if(!size || !read_buf || !u){
 		uart_printf("uart_read(): input error,size should not be null\r\n");
 		return -1;
 	}
-	
-	pread_local = u->prxread;
-	pwrite_local = u->prxwrite;
-	/*calculate how much data not read */
-	if(!u->rxoverlap){
-		read_bytes = pwrite_local - pread_local;
-	} else {
-		read_bytes = (UART_RECV_BUFFER_LEN - pread_local) + pwrite_local;
-	}
+
+	read_bytes = uart_read_peek(u, iov, 2);
+	if(read_bytes <= 0)
+		return read_bytes;
 	/*decide how much data shoule copy to application*/
-	if(size < read_bytes)
+	if(size < (size_t)read_bytes)
 		read_bytes = size;
-	
-	if(!u->rxoverlap){
-		memcpy(ptr, (u->recv_buf+ pread_local), read_bytes );
-	} else {
-		uart_printf("uart recv buf is write through!!\n");
-		if((pread_local + read_bytes) > UART_RECV_BUFFER_LEN){
-			memcpy(ptr,(u->recv_buf+ pread_local), (UART_RECV_BUFFER_LEN-pread_local));
-			memcpy(ptr+(UART_RECV_BUFFER_LEN-pread_local), u->recv_buf, read_bytes-(UART_RECV_BUFFER_LEN- pread_local));
-		} else
-			memcpy(ptr,(u->recv_buf+ pread_local), read_bytes);
-	}
-	lwip_setsockrcvevent(u->fd, 0);
-	
-	if((pread_local + read_bytes) >= UART_RECV_BUFFER_LEN){		//update pread
-		u->prxread = (pread_local + read_bytes) - UART_RECV_BUFFER_LEN;
-		u->rxoverlap = 0;		//clean overlap flags
-	} else
-		u->prxread = pread_local + read_bytes;
-	
-	return read_bytes;
 
+	n = (iov[0].iov_len < (size_t)read_bytes) ? iov[0].iov_len : (size_t)read_bytes;
+	memcpy(read_buf, iov[0].iov_base, n);
+	if(n < (size_t)read_bytes)
+		memcpy((u8 *)read_buf + n, iov[1].iov_base, read_bytes - n);
+
+	return uart_read_done(u, read_bytes);
 }
 
 
@@ -6,9 +6,10 @@
 
 #include "serial_api.h"
 #include "serial_ex_api.h"
+#include "lwip/sockets.h"	//struct iovec
 
 #define UART_SEND_BUFFER_LEN	512
-#define UART_RECV_BUFFER_LEN	1024
+#define UART_RECV_BUFFER_LEN	1024	// power of two
 #define UART_MAX_DELAY_TIME   20
 
 typedef struct _uart_set_str 
@@ -26,12 +27,14 @@ typedef struct _uart_socket_t
 	serial_t sobj;
 	int fd;
 
-	/* Used for UART RX */
-	u32 rx_start;
-	//u32 rx_bytes;
-	u32 prxread;
-	u32 prxwrite;
-	u32 rxoverlap;
+	/* Used for UART RX, single producer (uart_irq) single consumer (reader)
+	 * ring, head and tail are free running byte counts */
+	volatile u32 rx_head;	//written by uart_irq only
+	volatile u32 rx_tail;	//written by the reader only
+	u32 rx_lowat;			//select() reports readable from this many bytes on
+	volatile u32 rx_start;	//data below rx_lowat waits for the line to go quiet
+	volatile u32 rx_signalled;	//rcvevent set, cleared when the ring is drained
+	u32 rx_dropped;			//bytes lost because the ring was full
 	u32 last_update;  //tick count when rx byte
 	u8 recv_buf[UART_RECV_BUFFER_LEN];
 
@@ -50,6 +53,9 @@ typedef struct _uart_socket_t
 uart_socket_t* uart_open(uart_set_str *puartpara);
 int uart_close(uart_socket_t *u);
 int uart_read(uart_socket_t *u, void *read_buf, size_t size);
+int uart_read_peek(uart_socket_t *u, struct iovec *iov, int iovcnt);
+int uart_read_done(uart_socket_t *u, size_t size);
+int uart_set_rx_lowat(uart_socket_t *u, u32 lowat);
 int uart_write(uart_socket_t *u, void *pbuf, size_t size);
 
 #endif //__UART_SOCKET_H_
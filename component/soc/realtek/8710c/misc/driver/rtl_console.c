@@ -12,6 +12,7 @@
 #include "device.h"
 #include "serial_api.h"
 #include "log_service.h"
+#include "log_line.h"
 #include "osdep_service.h"
 #include "serial_ex_api.h"
 #include "pinmap.h"
@@ -40,13 +41,13 @@ extern hal_uart_adapter_t log_uart;
 #define STR_END_OF_MP_FORMAT	"\r\n\r\r#"
 
 
-#define CMD_HISTORY_LEN	4	// max number of executed command saved
+#define CMD_HISTORY_SIZE	256	// bytes keeping the latest executed commands, as many as fit
 #if SUPPORT_LOG_SERVICE
 extern char log_buf[LOG_SERVICE_BUFLEN];
 extern xSemaphoreHandle log_rx_interrupt_sema;
 #endif
-char cmd_history[CMD_HISTORY_LEN][LOG_SERVICE_BUFLEN];
-static unsigned int cmd_history_count = 0;
+static char cmd_history_buf[CMD_HISTORY_SIZE];
+static struct log_history cmd_history;
 
 void uart_put_char(u8 c){
         stdio_port_putc(c);
@@ -83,7 +84,7 @@ static void uart_irq(u32 id,u32 event)
 	static unsigned char combo_key = 0;
 	static short buf_count = 0;
 	static unsigned char key_enter = 0;
-	static char cmd_history_index = 0;
+	static int cmd_history_index = -1;	// -1: the line being typed
 	if (event == RxIrq) {
 		stdio_port_getc((char*)&rc);
 		if (key_enter && rc == KEY_NL) {
@@ -99,29 +100,26 @@ static void uart_irq(u32 id,u32 event)
 			else
 				combo_key = 0;
 		} else if (combo_key == 2) {
-			if (rc == 'A' || rc == 'B') { // UP or Down
+			if ((rc == 'A' || rc == 'B') && (cmd_history.count > 0)) { // UP (older) or Down (newer), both wrap
 				if (rc == 'A') {
-					cmd_history_index--;
-					if(cmd_history_index < 0)
-						cmd_history_index = (cmd_history_count>CMD_HISTORY_LEN)?CMD_HISTORY_LEN-1:(cmd_history_count-1)%CMD_HISTORY_LEN;
-				} else {
 					cmd_history_index++;
-					if(cmd_history_index > (cmd_history_count>CMD_HISTORY_LEN?CMD_HISTORY_LEN-1:(cmd_history_count-1)%CMD_HISTORY_LEN))
+					if(cmd_history_index >= cmd_history.count)
 						cmd_history_index = 0;
+				} else {
+					cmd_history_index--;
+					if(cmd_history_index < 0)
+						cmd_history_index = cmd_history.count - 1;
 				}
-				
-				if (cmd_history_count > 0) {
-					buf_count = strlen((char const*)temp_buf);
-					memset(temp_buf,'\0',buf_count);
-					while (--buf_count >= 0) {
-						stdio_port_putc(KEY_BS);
-						stdio_port_putc(' ');
-						stdio_port_putc(KEY_BS);
-					}
-					uart_send_string(cmd_history[cmd_history_index%CMD_HISTORY_LEN]);
-					strcpy((char*)temp_buf, cmd_history[cmd_history_index%CMD_HISTORY_LEN]);
-					buf_count = strlen((char const*)temp_buf);
+
+				while (--buf_count >= 0) {
+					stdio_port_putc(KEY_BS);
+					stdio_port_putc(' ');
+					stdio_port_putc(KEY_BS);
 				}
+				buf_count = log_history_get(&cmd_history, cmd_history_index, (char*)temp_buf, LOG_SERVICE_BUFLEN);
+				if (buf_count < 0)
+					buf_count = 0;
+				uart_send_string((char*)temp_buf);
 			}
 			// exit combo
 			combo_key = 0;
@@ -132,16 +130,15 @@ static void uart_irq(u32 id,u32 event)
 			if (buf_count > 0) {
 				stdio_port_putc(KEY_NL);
 				stdio_port_putc(KEY_ENTER);
-				memset(log_buf,'\0',LOG_SERVICE_BUFLEN);
-				strncpy(log_buf,(char *)&temp_buf[0],buf_count);
+				temp_buf[buf_count] = '\0';
+				memcpy(log_buf, temp_buf, buf_count + 1);
 				rtw_up_sema_from_isr((_sema*)&log_rx_interrupt_sema);
-				memset(temp_buf,'\0',buf_count);
 
 				/* save command */
-				memset(cmd_history[((cmd_history_count)%CMD_HISTORY_LEN)], '\0', buf_count+1);
-				strcpy(cmd_history[((cmd_history_count++)%CMD_HISTORY_LEN)], log_buf);
-				cmd_history_index = cmd_history_count%CMD_HISTORY_LEN;
+				log_history_add(&cmd_history, (char *)temp_buf);
+				cmd_history_index = -1;
 				buf_count=0;
+				temp_buf[0] = '\0';
 			}else{
 				uart_send_string(STR_END_OF_MP_FORMAT);
 #if defined(configUSE_TICKLESS_IDLE) && (configUSE_TICKLESS_IDLE > 0)
@@ -178,9 +175,7 @@ static void uart_irq(u32 id,u32 event)
 extern void log_service_init(void);
 void console_init(void)
 {
-	int i;
-	for(i = 0; i < CMD_HISTORY_LEN; i++)
-		memset(cmd_history[i], '\0', LOG_SERVICE_BUFLEN);
+	log_history_init(&cmd_history, cmd_history_buf, sizeof(cmd_history_buf));
 #if SUPPORT_LOG_SERVICE		
 	log_service_init();
 #endif
@@ -139,6 +139,10 @@ SRC_C += ../../../component/soc/realtek/8710c/cmsis/rtl8710c/source/ram/sys_irq.
 SRC_C += ../../../component/soc/realtek/8710c/misc/utilities/source/ram/libc_wrap.c
 
 #console
+SRC_C += ../../../component/common/api/at_cmd/atcmd_frame.c
+SRC_C += ../../../component/common/api/at_cmd/atcmd_tt_ring.c
+SRC_C += ../../../component/common/api/at_cmd/atcmd_record.c
+SRC_C += ../../../component/common/api/at_cmd/atcmd_spi.c
 SRC_C += ../../../component/common/api/at_cmd/atcmd_lwip.c
 SRC_C += ../../../component/common/api/at_cmd/atcmd_mp.c
 SRC_C += ../../../component/common/api/at_cmd/atcmd_mp_ext2.c
@@ -147,6 +151,7 @@ SRC_C += ../../../component/common/api/at_cmd/atcmd_wifi.c
 SRC_C += ../../../component/soc/realtek/8710c/app/shell/cmd_shell.c
 SRC_C += ../../../component/soc/realtek/8710c/app/shell/ram_s/consol_cmds.c
 SRC_C += ../../../component/common/api/at_cmd/log_service.c
+SRC_C += ../../../component/common/api/at_cmd/log_line.c
 SRC_C += ../../../component/soc/realtek/8710c/misc/driver/rtl_console.c
 
 #network - api
@@ -180,6 +185,7 @@ SRC_C += ../../../component/common/utilities/xml.c
 
 #network - app - mqtt
 SRC_C += ../../../component/common/application/mqtt/MQTTClient/MQTTClient.c
+SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTCodec.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTConnectClient.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTConnectServer.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTDeserializePublish.c
@@ -189,6 +195,8 @@ SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTPacket.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTSerializePublish.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTSubscribeClient.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTSubscribeServer.c
+SRC_C += ../../../component/common/application/mqtt/MQTTClient/MQTTTopicTrie.c
+SRC_C += ../../../component/common/application/mqtt/MQTTClient/MQTTQueue.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTUnsubscribeClient.c
 SRC_C += ../../../component/common/application/mqtt/MQTTPacket/MQTTUnsubscribeServer.c
 
@@ -221,9 +229,11 @@ SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/ota_clie
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/ota_fetch.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/ota_lib.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/ota_mqtt.c
+SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/ota_pipeline.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/qcloud_iot_ca.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/qcloud_iot_device.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/qcloud_iot_log.c
+SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/qcloud_iot_reactor.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/string_utils.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/system_mqtt.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/utils_aes.c
@@ -239,6 +249,7 @@ SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/sdk_src/utils_ti
 
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/platform/HAL_Device_freertos.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/platform/HAL_OS_freertos.c
+SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/platform/HAL_OTA_rtl8710c.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/platform/HAL_TCP_lwip.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/platform/HAL_Timer_freertos.c
 SRC_C += ../../../component/common/application/qcloud_iot_c_sdk/platform/HAL_TLS_mbedtls.c
@@ -261,6 +272,9 @@ SRC_C += ../../../component/common/network/httpd/httpd_tls.c
 #network
 SRC_C += ../../../component/common/network/dhcp/dhcps.c
 SRC_C += ../../../component/common/network/sntp/sntp.c
+SRC_C += ../../../component/common/network/snmp/snmp_ameba.c
+SRC_C += ../../../component/common/network/snmp/snmp_ameba_cursor.c
+SRC_C += ../../../component/common/network/tftp/tftp_flash.c
 
 #network - lwip
 #network - lwip - api
@@ -316,8 +330,29 @@ SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/core/ipv6/nd6.c
 #network - lwip - netif
 SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/netif/ethernet.c
 
+#network - lwip - apps
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_asn1.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_core.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2_icmp.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2_interfaces.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2_ip.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2_snmp.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2_system.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2_tcp.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_mib2_udp.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_msg.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_pbuf_stream.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_raw.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_scalar.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_table.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_threadsync.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/snmp/snmp_traps.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/src/apps/tftp/tftp_server.c
+
 #network - lwip - port
 SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/port/realtek/freertos/ethernetif.c
+SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/port/realtek/freertos/ethernetif_mcast.c
 SRC_C += ../../../component/common/drivers/wlan/realtek/src/osdep/lwip_intf.c
 SRC_C += ../../../component/common/network/lwip/lwip_v2.0.2/port/realtek/freertos/sys_arch.c
 
@@ -476,6 +511,7 @@ SRC_C += ../../../component/common/example/sntp_showtime/example_sntp_showtime.c
 SRC_C += ../../../component/common/example/socket_select/example_socket_select.c
 SRC_C += ../../../component/common/example/socket_tcp_trx/example_socket_tcp_trx_1.c
 SRC_C += ../../../component/common/example/socket_tcp_trx/example_socket_tcp_trx_2.c
+SRC_C += ../../../component/common/example/spi_atcmd/example_spi_atcmd.c
 SRC_C += ../../../component/common/example/ssl_download/example_ssl_download.c
 SRC_C += ../../../component/common/example/ssl_server/example_ssl_server.c
 SRC_C += ../../../component/common/example/tcp_keepalive/example_tcp_keepalive.c
@@ -522,6 +558,22 @@ CFLAGS += -Wno-maybe-uninitialized --save-temps -c -MMD
 CFLAGS += -DCONFIG_PLATFORM_8710C -DCONFIG_BUILD_RAM=1
 CFLAGS += -DV8M_STKOVF
 
+# AT commands of the at_cmd tables are resolved through a const perfect hash
+# generated from their preprocessed sources by $(PYTHON). Without it, or with
+# ATCMD_PHASH=0, the lists registered at boot are walked as before
+PYTHON ?= python
+ifndef ATCMD_PHASH
+ATCMD_PHASH := $(if $(shell command -v $(PYTHON) 2>/dev/null),1,0)
+ifeq ($(ATCMD_PHASH), 0)
+$(info $(PYTHON) not found, AT commands are looked up without the perfect hash)
+endif
+endif
+ifeq ($(ATCMD_PHASH), 1)
+CFLAGS += -DCONFIG_LOG_SERVICE_PHASH=1
+ATCMD_PHASH_I = $(addprefix $(INFO_DIR)/,$(patsubst %.c,%.i,$(notdir $(filter ../../../component/common/api/at_cmd/%.c,$(SRC_C)))))
+ATCMD_PHASH_O = $(OBJ_DIR)/log_service_phash_$(TARGET).o
+endif
+
 LFLAGS = 
 LFLAGS += -O2 -march=armv8-m.main+dsp -mthumb -mcmse -mfloat-abi=soft -nostartfiles -nodefaultlibs -nostdlib -specs=nosys.specs
 LFLAGS += -Wl,--gc-sections -Wl,--warn-section-align -Wl,--cref -Wl,--build-id=none -Wl,--use-blx
@@ -566,8 +618,8 @@ OTA_BIN =
 # -------------------------------------------------------------------
 
 .PHONY: application_is
-application_is: prerequirement $(SRC_O) $(SRAM_O) $(ERAM_O)
-	$(LD) $(LFLAGS) -o $(BIN_DIR)/$(TARGET).axf  $(OBJ_LIST) $(ROMIMG) $(LIBFLAGS) -T$(LDSCRIPT)  
+application_is: prerequirement $(SRC_O) $(SRAM_O) $(ERAM_O) $(ATCMD_PHASH_O)
+	$(LD) $(LFLAGS) -o $(BIN_DIR)/$(TARGET).axf  $(OBJ_LIST) $(ATCMD_PHASH_O) $(ROMIMG) $(LIBFLAGS) -T$(LDSCRIPT)  
 	$(OBJDUMP) -d $(BIN_DIR)/$(TARGET).axf > $(BIN_DIR)/$(TARGET).asm
 
 # Manipulate Image
@@ -653,6 +705,20 @@ $(ERAM_O): %_$(TARGET).o : %.c
 	mv $(notdir $*.s) $(INFO_DIR)
 	chmod 777 $(OBJ_DIR)/$(notdir $@)
 
+ifeq ($(ATCMD_PHASH), 1)
+$(ATCMD_PHASH_O): $(SRC_O) $(SRAM_O) $(ERAM_O)
+	$(PYTHON) ../../../component/common/api/at_cmd/log_service_phash.py -o $(INFO_DIR)/log_service_phash.c $(ATCMD_PHASH_I)
+	$(CC) $(CFLAGS) $(INCLUDES) -c $(INFO_DIR)/log_service_phash.c -o $@
+	mv log_service_phash.i $(INFO_DIR)
+	mv log_service_phash.s $(INFO_DIR)
+endif
+
+# Check on the host that every command of the at_cmd tables resolves
+.PHONY: atcmd_phash_check
+atcmd_phash_check:
+	mkdir -p $(INFO_DIR)
+	$(PYTHON) ../../../component/common/api/at_cmd/log_service_phash.py -o $(INFO_DIR)/log_service_phash_check.c --check ../../../component/common/api/at_cmd/*.c
+
 -include $(DEPENDENCY_LIST)
 
 # Only needed for FPGA phase
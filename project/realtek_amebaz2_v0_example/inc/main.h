@@ -23,9 +23,9 @@ void wlan_network(void);
 #define WEP40_KEY		{0x12, 0x34, 0x56, 0x78, 0x90}
 
 #define ATVER_1 1 // For First AT command
-#define ATVER_2 2 // For UART Module AT command
+#define ATVER_2 2 // For UART/SPI Module AT command
 
-#if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
+#if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD) || (defined(CONFIG_EXAMPLE_SPI_ATCMD) && CONFIG_EXAMPLE_SPI_ATCMD)
 #define ATCMD_VER ATVER_2
 #else
 #define ATCMD_VER ATVER_1
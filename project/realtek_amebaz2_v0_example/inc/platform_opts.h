@@ -18,7 +18,7 @@
 #define LOG_SERVICE_BUFLEN     100 //can't larger than UART_LOG_CMD_BUFLEN(127)
 #define CONFIG_LOG_HISTORY	0
 #if CONFIG_LOG_HISTORY
-#define LOG_HISTORY_LEN    5
+#define LOG_HISTORY_SIZE    512
 #endif
 #define SUPPORT_INTERACTIVE_MODE	0//on/off wifi_interactive_mode
 #define CONFIG_LOG_SERVICE_LOCK		0
@@ -56,6 +56,11 @@
 #define UART_SETTING_SECTOR		(0x200000 - 0x5000)
 #define DCT_BEGIN_ADDR			(0x200000 - 0x29000) /*!< DCT begin address of flash, ex: 0x200000 = 2M, the default size of DCT is 24K; ; if backup enabled, the size is 48k; if wear leveling enabled, the size is 144k*/
 #define FLASH_APP_BASE			(0x200000 - 0xA9000) /*!< FATFS begin address, default size used is 512KB (can be adjusted based on user requirement)*/
+/* Free flash between fw2 (partition.json, up to 0x110000) and FATFS. Its start is the staging window of
+ * ATSK=SEC_BOOT_EN (atcmd_sys.c): the partition table at 0x110000, the bootloader at 0x111000..0x119000. */
+#define ATSK_SEC_BOOT_STAGING		(0x110000)
+#define ATSK_SEC_BOOT_STAGING_END	(0x119000)
+#define ATCMD_RECORD_FLASH_BASE		(FLASH_APP_BASE - 0x3000) /*!< 3 sectors of the AT record stores (atcmd_record.c), just below FATFS */
 
 /**
  * For Wlan configurations
@@ -137,6 +142,7 @@
 
 /* For LWIP configuration */
 #define CONFIG_LWIP_DHCP_COARSE_TIMER 60
+#define CONFIG_SNMP_AGENT	0 //on or off SNMP agent with MIB2 and Ameba private MIB
 
 /**
  * For Ethernet configurations
@@ -305,7 +311,10 @@
 /* For UART Module AT command example */
 #define CONFIG_EXAMPLE_UART_ATCMD			0
 #if (defined(CONFIG_EXAMPLE_UART_ATCMD) && CONFIG_EXAMPLE_UART_ATCMD)
-#define UART_SETTING_BACKUP_SECTOR			(FLASH_BAKEUP_SECTOR)
+/* the AT record store (atcmd_record.c) keeps live records in both of its sectors, the
+ * second one is taken from ATCMD_RECORD_FLASH_BASE, FLASH_BAKEUP_SECTOR being erased by
+ * other code */
+#define UART_SETTING_BACKUP_SECTOR			(ATCMD_RECORD_FLASH_BASE)
 #undef CONFIG_OTA_UPDATE
 #define CONFIG_OTA_UPDATE					1
 #undef CONFIG_TRANSPORT
@@ -318,4 +327,39 @@
 #define CONFIG_EXAMPLE_WLAN_FAST_CONNECT	0
 #endif
 
+/* For SPI Module AT command example, see at_cmd/atcmd_spi.h */
+#define CONFIG_EXAMPLE_SPI_ATCMD			0
+#if (defined(CONFIG_EXAMPLE_SPI_ATCMD) && CONFIG_EXAMPLE_SPI_ATCMD)
+/* a record store of its own, next to the UART one in ATCMD_RECORD_FLASH_BASE, see
+ * CONFIG_EXAMPLE_UART_ATCMD */
+#define SPI_SETTING_SECTOR					(ATCMD_RECORD_FLASH_BASE + 0x1000)
+#define SPI_SETTING_BACKUP_SECTOR			(ATCMD_RECORD_FLASH_BASE + 0x2000)
+#undef CONFIG_OTA_UPDATE
+#define CONFIG_OTA_UPDATE					1
+#undef CONFIG_TRANSPORT
+#define CONFIG_TRANSPORT					1
+#undef LOG_SERVICE_BUFLEN
+#define LOG_SERVICE_BUFLEN					1600
+#undef CONFIG_LOG_SERVICE_LOCK
+#define CONFIG_LOG_SERVICE_LOCK				1
+#undef CONFIG_EXAMPLE_WLAN_FAST_CONNECT
+#define CONFIG_EXAMPLE_WLAN_FAST_CONNECT	0
+#endif
+
+/* ATSK=SEC_BOOT_EN burns whatever is in its staging window as partition table and bootloader:
+ * no AT record store sector may lie there */
+#define ATSK_STAGING_OVERLAPS(sector)	(((sector) + 0x1000 > ATSK_SEC_BOOT_STAGING) && ((sector) < ATSK_SEC_BOOT_STAGING_END))
+#if defined(UART_SETTING_BACKUP_SECTOR) && ATSK_STAGING_OVERLAPS(UART_SETTING_BACKUP_SECTOR)
+#error "UART_SETTING_BACKUP_SECTOR is in the ATSK=SEC_BOOT_EN staging window"
+#endif
+#if defined(SPI_SETTING_SECTOR) && ATSK_STAGING_OVERLAPS(SPI_SETTING_SECTOR)
+#error "SPI_SETTING_SECTOR is in the ATSK=SEC_BOOT_EN staging window"
+#endif
+#if defined(SPI_SETTING_BACKUP_SECTOR) && ATSK_STAGING_OVERLAPS(SPI_SETTING_BACKUP_SECTOR)
+#error "SPI_SETTING_BACKUP_SECTOR is in the ATSK=SEC_BOOT_EN staging window"
+#endif
+#if ATSK_STAGING_OVERLAPS(UART_SETTING_SECTOR)
+#error "UART_SETTING_SECTOR is in the ATSK=SEC_BOOT_EN staging window"
+#endif
+
 #endif
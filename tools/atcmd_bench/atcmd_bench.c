@@ -0,0 +1,723 @@
+/*
+ * AT command benchmark, see readme.txt.
+ *
+ * Runs log_service, the ATP* commands of atcmd_lwip.c and lwIP as built
+ * for the device, on the host (bench_os.c, bench_port.c). A script feeds
+ * the command lines as the UART would and a peer task on the same lwIP
+ * stack plays the remote end of the connections. Every command is timed
+ * from the end of its line to the end of its response, data transfers are
+ * timed until the last byte arrived at the other end.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/sockets.h"
+#include "log_service.h"
+#include "bench.h"
+
+#undef printf	// platform_stdlib_rtl8710c.h, the report goes to stdout whatever -v says
+
+#define BENCH_RESP_TIMEOUT_MS	10000
+#define BENCH_DATA_TIMEOUT_MS	10000
+#define BENCH_LINE_MAX			256
+#define BENCH_SCRIPT_MAX		1024	// lines
+#define BENCH_REPEAT_DEPTH		8
+#define BENCH_VAR_MAX			16
+#define BENCH_CMD_MAX			64		// distinct commands timed
+#define BENCH_HIST_BUCKETS		24		// 1us << n
+
+extern void log_service_init(void);
+
+int bench_verbose;
+static int bench_test;
+static u32 bench_baud = 115200;
+static int bench_failures;
+
+/**** statistics ****/
+
+struct bench_cmd_stat {
+	char name[16];
+	u32 count;
+	u32 *us;			// host time of each run
+	u32 us_size;
+	u64 wire_bytes;		// UART bytes both ways, all runs
+	u32 hist[BENCH_HIST_BUCKETS];
+};
+
+static struct bench_cmd_stat cmd_stat[BENCH_CMD_MAX];
+static int cmd_stat_num;
+
+static struct bench_cmd_stat *bench_stat(const char *name)
+{
+	struct bench_cmd_stat *st;
+	int i;
+
+	for(i = 0; i < cmd_stat_num; i++)
+		if(strcmp(cmd_stat[i].name, name) == 0)
+			return &cmd_stat[i];
+	if(cmd_stat_num == BENCH_CMD_MAX)
+		return NULL;
+	st = &cmd_stat[cmd_stat_num++];
+	strncpy(st->name, name, sizeof(st->name) - 1);
+	return st;
+}
+
+static void bench_stat_add(const char *name, u32 us, u32 wire_bytes)
+{
+	struct bench_cmd_stat *st = bench_stat(name);
+	int b = 0;
+
+	if(st == NULL)
+		return;
+	if(st->count == st->us_size){
+		st->us_size = st->us_size ? st->us_size * 2 : 64;
+		st->us = realloc(st->us, st->us_size * sizeof(u32));
+	}
+	st->us[st->count++] = us;
+	st->wire_bytes += wire_bytes;
+	while((b < BENCH_HIST_BUCKETS - 1) && (us >= (2u << b)))
+		b++;
+	st->hist[b]++;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* microseconds the UART needs for bytes at 8N1 */
+static u32 bench_wire_us(u64 bytes)
+{
+	return (u32)(bytes * 10 * 1000000 / bench_baud);
+}
+
+static void bench_report_commands(void)
+{
+	struct bench_cmd_stat *st;
+	int i, b;
+
+	printf("\ncommand latency, host us from the end of the line to the end of the response\n");
+	printf("%-10s %7s %8s %8s %8s %8s %8s %10s\n", "command", "runs", "min", "p50", "p90", "p99", "max", "wire avg");
+	for(i = 0; i < cmd_stat_num; i++){
+		st = &cmd_stat[i];
+		qsort(st->us, st->count, sizeof(u32), bench_cmp_u32);
+		printf("%-10s %7u %8u %8u %8u %8u %8u %10u\n", st->name, (unsigned)st->count,
+			(unsigned)st->us[0], (unsigned)st->us[st->count / 2], (unsigned)st->us[st->count * 9 / 10],
+			(unsigned)st->us[st->count * 99 / 100], (unsigned)st->us[st->count - 1],
+			(unsigned)(bench_wire_us(st->wire_bytes) / st->count));
+	}
+	printf("\nhistogram, runs per bucket of host us\n");
+	for(i = 0; i < cmd_stat_num; i++){
+		st = &cmd_stat[i];
+		printf("%-10s", st->name);
+		for(b = 0; b < BENCH_HIST_BUCKETS; b++)
+			if(st->hist[b])
+				printf(" <%u:%u", 2u << b, (unsigned)st->hist[b]);
+		printf("\n");
+	}
+}
+
+static void bench_report_transfer(const char *what, u32 bytes, u64 us, u64 wire_bytes)
+{
+	double host = us ? (double)bytes * 1000000 / us / 1024 : 0;
+	double wire = wire_bytes ? (double)bytes * bench_baud / 10 / wire_bytes / 1024 : 0;
+
+	printf("%-28s %8u bytes %9.3f s  host %9.1f KB/s  UART %8.1f KB/s at %u baud\n",
+		what, (unsigned)bytes, (double)us / 1000000, host, wire, (unsigned)bench_baud);
+}
+
+static void bench_fail(const char *script, int line, const char *what)
+{
+	printf("%s:%d: FAIL %s\n", script, line, what);
+	bench_failures++;
+}
+
+/**** peer ****/
+
+/*
+ * The remote end, on the same lwIP stack: one connection, either accepted
+ * on a listening port (the device runs ATPC) or opened to a device server
+ * (ATPS). It checks what it receives against bench_pattern(), echoes it
+ * back in echo mode, and sends pattern streams on request.
+ *
+ * The RX task owns both sockets and closes them itself, it wakes up every
+ * PEER_POLL_MS to see whether the script closed the peer.
+ */
+#define PEER_POLL_MS	50
+
+static struct {
+	int listen_fd;
+	volatile int fd;
+	int echo;
+	volatile int closing;
+	volatile int running;
+	volatile u32 rx;
+	volatile u32 rx_errors;
+	volatile u32 tx_left;
+	u32 tx_off;
+} peer = {-1, -1};
+
+static void bench_peer_poll(int fd)
+{
+	int ms = PEER_POLL_MS;
+
+	lwip_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &ms, sizeof(ms));
+}
+
+static void bench_peer_rx_task(void *param)
+{
+	static u8 buf[2048];
+	int fd, n, i;
+
+	( void ) param;
+	while(!peer.closing){
+		if(peer.fd < 0){
+			if(peer.listen_fd < 0){
+				/* connected to a device server which closed, wait for the script */
+				usleep(PEER_POLL_MS * 1000);
+				continue;
+			}
+			fd = lwip_accept(peer.listen_fd, NULL, NULL);
+			if(fd < 0)
+				continue;
+			bench_peer_poll(fd);
+			peer.fd = fd;
+		}
+		n = lwip_recv(peer.fd, buf, sizeof(buf), 0);
+		if((n < 0) && (lwip_getsocklasterr(peer.fd) == EWOULDBLOCK))
+			continue;
+		if(n <= 0){
+			fd = peer.fd;
+			peer.fd = -1;
+			lwip_close(fd);
+			continue;
+		}
+		for(i = 0; i < n; i++)
+			if(buf[i] != bench_pattern(peer.rx + i))
+				peer.rx_errors++;
+		peer.rx += n;
+		if(peer.echo)
+			lwip_send(peer.fd, buf, n, 0);
+	}
+	if((fd = peer.fd) >= 0){
+		peer.fd = -1;
+		lwip_close(fd);
+	}
+	if(peer.listen_fd >= 0){
+		lwip_close(peer.listen_fd);
+		peer.listen_fd = -1;
+	}
+	peer.running = 0;
+	vTaskDelete(NULL);
+}
+
+static void bench_peer_tx_task(void *param)
+{
+	u8 buf[1460];
+	u32 n, i;
+
+	( void ) param;
+	while(peer.tx_left && (peer.fd >= 0)){
+		n = (peer.tx_left < sizeof(buf)) ? peer.tx_left : sizeof(buf);
+		for(i = 0; i < n; i++)
+			buf[i] = bench_pattern(peer.tx_off + i);
+		if(lwip_send(peer.fd, buf, n, 0) != (int)n)
+			break;
+		peer.tx_off += n;
+		peer.tx_left -= n;
+	}
+	peer.tx_left = 0;
+	vTaskDelete(NULL);
+}
+
+static int bench_peer_start(int echo)
+{
+	peer.echo = echo;
+	peer.closing = 0;
+	peer.running = 1;
+	if(xTaskCreate(bench_peer_rx_task, "peer_rx", 1024, NULL, 1, NULL) != pdPASS){
+		peer.running = 0;
+		return -1;
+	}
+	return 0;
+}
+
+static int bench_peer_listen(int port, int echo)
+{
+	struct sockaddr_in addr;
+
+	if(peer.running)
+		return -1;
+	peer.listen_fd = lwip_socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = lwip_htons(port);
+	addr.sin_addr.s_addr = INADDR_ANY;
+	if((lwip_bind(peer.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (lwip_listen(peer.listen_fd, 1) < 0)){
+		lwip_close(peer.listen_fd);
+		peer.listen_fd = -1;
+		return -1;
+	}
+	bench_peer_poll(peer.listen_fd);
+	return bench_peer_start(echo);
+}
+
+static int bench_peer_connect(int port, int echo)
+{
+	struct sockaddr_in addr;
+	int fd;
+
+	if(peer.running)
+		return -1;
+	fd = lwip_socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = lwip_htons(port);
+	addr.sin_addr.s_addr = inet_addr(BENCH_DEVICE_IP);
+	if(lwip_connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0){
+		lwip_close(fd);
+		return -1;
+	}
+	bench_peer_poll(fd);
+	peer.fd = fd;
+	return bench_peer_start(echo);
+}
+
+/* back to no peer, once the RX task closed its sockets */
+static void bench_peer_close(void)
+{
+	while(peer.tx_left)
+		usleep(1000);
+	peer.closing = 1;
+	while(peer.running)
+		usleep(1000);
+}
+
+/* start a fresh pattern stream in both directions */
+static void bench_peer_reset(void)
+{
+	peer.rx = 0;
+	peer.rx_errors = 0;
+	peer.tx_off = 0;
+}
+
+static int bench_peer_send(u32 bytes)
+{
+	peer.tx_left = bytes;
+	return (xTaskCreate(bench_peer_tx_task, "peer_tx", 1024, NULL, 1, NULL) == pdPASS) ? 0 : -1;
+}
+
+static int bench_peer_wait_rx(u32 bytes, u32 timeout_ms)
+{
+	u64 start = bench_now_us();
+
+	while(peer.rx < bytes){
+		if(bench_now_us() - start > (u64)timeout_ms * 1000)
+			return -1;
+		usleep(100);
+	}
+	return 0;
+}
+
+/**** scripts ****/
+
+struct bench_script {
+	const char *path;
+	char *line[BENCH_SCRIPT_MAX];
+	int num;
+	char var_name[BENCH_VAR_MAX][32];
+	int var_value[BENCH_VAR_MAX];
+	int var_num;
+	char last[BENCH_TEXT_MAX];		// response of the last command
+	char last_name[16];
+	u64 last_start;
+};
+
+static void bench_var_set(struct bench_script *s, const char *name, int value)
+{
+	int i;
+
+	for(i = 0; i < s->var_num; i++)
+		if(strcmp(s->var_name[i], name) == 0)
+			break;
+	if(i == BENCH_VAR_MAX)
+		return;
+	if(i == s->var_num){
+		snprintf(s->var_name[i], sizeof(s->var_name[i]), "%s", name);
+		s->var_num++;
+	}
+	s->var_value[i] = value;
+}
+
+/* line with every $name replaced by its value */
+static void bench_expand(struct bench_script *s, const char *in, char *out, int out_size)
+{
+	int len = 0, i, n;
+
+	while(*in && (len < out_size - 1)){
+		if(*in == '$'){
+			for(i = 0; i < s->var_num; i++){
+				n = strlen(s->var_name[i]);
+				if(strncmp(in + 1, s->var_name[i], n) == 0){
+					len += snprintf(out + len, out_size - len, "%d", s->var_value[i]);
+					in += 1 + n;
+					break;
+				}
+			}
+			if(i < s->var_num)
+				continue;
+		}
+		out[len++] = *in++;
+	}
+	out[(len < out_size) ? len : out_size - 1] = '\0';
+}
+
+/* ATPC=0,... is timed as ATPC, AT?? as AT?? */
+static void bench_cmd_name(const char *line, char *name, int size)
+{
+	int i;
+
+	for(i = 0; (i < size - 1) && line[i] && (line[i] != '='); i++)
+		name[i] = line[i];
+	name[i] = '\0';
+}
+
+/**
+ * Run one command line, or one ATPT with its data, and time it.
+ *
+ * @return 0, -1 if no response came
+ */
+static int bench_command(struct bench_script *s, const char *line, const u8 *data, u32 data_len, const char *stat_name)
+{
+	char name[16];
+	u32 wire = bench_uart_rx_bytes + bench_uart_tx_bytes;
+	u64 start;
+	u32 us;
+
+	bench_cmd_name(line, name, sizeof(name));
+	start = bench_now_us();
+	snprintf(s->last_name, sizeof(s->last_name), "%s", name);
+	s->last_start = start;
+	bench_uart_command(line, data, data_len);
+	if(bench_uart_wait_response(BENCH_RESP_TIMEOUT_MS) < 0)
+		return -1;
+	us = (u32)(bench_now_us() - start);
+	strcpy(s->last, bench_uart_text());
+	bench_stat_add(stat_name ? stat_name : name, us, bench_uart_rx_bytes + bench_uart_tx_bytes - wire);
+	return 0;
+}
+
+/* send CON SIZE COUNT: COUNT ATPT of SIZE bytes to the peer */
+static void bench_do_send(struct bench_script *s, int ln, int con, u32 size, u32 count)
+{
+	static u8 data[LOG_SERVICE_BUFLEN];
+	char line[64], stat[16];
+	u32 wire = bench_uart_rx_bytes + bench_uart_tx_bytes;
+	u32 i, j, off = 0;
+	u64 start;
+
+	if(size + 32 > LOG_SERVICE_BUFLEN){
+		bench_fail(s->path, ln, "send: size over the command buffer");
+		return;
+	}
+	bench_peer_reset();
+	snprintf(line, sizeof(line), "ATPT=%u,%d", (unsigned)size, con);
+	snprintf(stat, sizeof(stat), "ATPT/%u", (unsigned)size);
+	start = bench_now_us();
+	for(i = 0; i < count; i++){
+		for(j = 0; j < size; j++)
+			data[j] = bench_pattern(off + j);
+		off += size;
+		if((bench_command(s, line, data, size, stat) < 0) || !strstr(s->last, "OK")){
+			bench_fail(s->path, ln, "send: ATPT failed");
+			printf("  response: %s\n  peer received %u of %u\n", s->last, (unsigned)peer.rx, (unsigned)off);
+			return;
+		}
+	}
+	if(bench_peer_wait_rx(off, BENCH_DATA_TIMEOUT_MS) < 0)
+		bench_fail(s->path, ln, "send: the peer did not receive everything");
+	if(peer.rx_errors)
+		bench_fail(s->path, ln, "send: the peer received corrupted data");
+	if(!bench_test){
+		snprintf(line, sizeof(line), "ATPT %u x %u", (unsigned)size, (unsigned)count);
+		bench_report_transfer(line, peer.rx, bench_now_us() - start, bench_uart_rx_bytes + bench_uart_tx_bytes - wire);
+	}
+}
+
+/* read CON SIZE TOTAL: the peer sends TOTAL bytes, ATPR until all came out */
+static void bench_do_read(struct bench_script *s, int ln, int con, u32 size, u32 total)
+{
+	char line[64], stat[16];
+	u32 wire = bench_uart_rx_bytes + bench_uart_tx_bytes;
+	u64 start;
+
+	bench_peer_reset();
+	bench_uart_data_reset();
+	snprintf(line, sizeof(line), "ATPR=%d,%u", con, (unsigned)size);
+	snprintf(stat, sizeof(stat), "ATPR/%u", (unsigned)size);
+	start = bench_now_us();
+	bench_peer_send(total);
+	while(bench_uart_data_bytes() < total){
+		if(bench_now_us() - start > (u64)BENCH_DATA_TIMEOUT_MS * 1000){
+			bench_fail(s->path, ln, "read: not everything came out");
+			return;
+		}
+		if(bench_command(s, line, NULL, 0, stat) < 0){
+			bench_fail(s->path, ln, "read: ATPR did not respond");
+			return;
+		}
+	}
+	if(bench_uart_data_errors())
+		bench_fail(s->path, ln, "read: corrupted data");
+	if(!bench_test){
+		snprintf(line, sizeof(line), "ATPR %u", (unsigned)size);
+		bench_report_transfer(line, total, bench_now_us() - start, bench_uart_rx_bytes + bench_uart_tx_bytes - wire);
+	}
+}
+
+/* autorecv TOTAL: the peer sends TOTAL bytes, auto receive outputs them */
+static void bench_do_autorecv(struct bench_script *s, int ln, u32 total)
+{
+	u32 wire = bench_uart_rx_bytes + bench_uart_tx_bytes;
+	u64 start;
+
+	bench_peer_reset();
+	bench_uart_data_reset();
+	start = bench_now_us();
+	bench_peer_send(total);
+	if(bench_uart_wait_data(total, BENCH_DATA_TIMEOUT_MS) < 0){
+		bench_fail(s->path, ln, "autorecv: not everything came out");
+		return;
+	}
+	if(bench_uart_data_errors())
+		bench_fail(s->path, ln, "autorecv: corrupted data");
+	if(!bench_test)
+		bench_report_transfer("auto receive", total, bench_now_us() - start, bench_uart_rx_bytes + bench_uart_tx_bytes - wire);
+}
+
+/* tt TOTAL: TOTAL bytes through transparent transmission to the peer */
+static void bench_do_tt(struct bench_script *s, int ln, u32 total)
+{
+	u8 buf[512];
+	u32 wire = bench_uart_rx_bytes + bench_uart_tx_bytes;
+	u32 off, n, i;
+	u64 start;
+
+	bench_peer_reset();
+	start = bench_now_us();
+	for(off = 0; off < total; off += n){
+		n = (total - off < sizeof(buf)) ? total - off : sizeof(buf);
+		for(i = 0; i < n; i++)
+			buf[i] = bench_pattern(off + i);
+		if(bench_tt_write(buf, n, BENCH_DATA_TIMEOUT_MS) < 0){
+			bench_fail(s->path, ln, "tt: the ring stayed full");
+			return;
+		}
+	}
+	bench_tt_pause();	// the last partial buffer leaves after the pause
+	if(bench_peer_wait_rx(total, BENCH_DATA_TIMEOUT_MS) < 0)
+		bench_fail(s->path, ln, "tt: the peer did not receive everything");
+	if(peer.rx_errors)
+		bench_fail(s->path, ln, "tt: the peer received corrupted data");
+	if(!bench_test)
+		bench_report_transfer("TT", peer.rx, bench_now_us() - start, bench_uart_rx_bytes + bench_uart_tx_bytes - wire);
+}
+
+/* ttexit: "----" alone between two pauses, back to the command prompt */
+static void bench_do_ttexit(struct bench_script *s, int ln)
+{
+	u32 wire = bench_uart_rx_bytes + bench_uart_tx_bytes;
+	u64 start;
+
+	bench_tt_pause();
+	bench_uart_text_reset();
+	start = bench_now_us();
+	if(bench_tt_write((const u8 *)"----", 4, BENCH_DATA_TIMEOUT_MS) < 0){
+		bench_fail(s->path, ln, "ttexit: TT mode is not on");
+		return;
+	}
+	if(bench_uart_wait_text(STR_END_OF_ATCMD_RET, BENCH_RESP_TIMEOUT_MS) < 0){
+		bench_fail(s->path, ln, "ttexit: no prompt");
+		return;
+	}
+	bench_stat_add("----", (u32)(bench_now_us() - start), bench_uart_rx_bytes + bench_uart_tx_bytes - wire);
+}
+
+static int bench_load(struct bench_script *s, const char *path)
+{
+	char buf[BENCH_LINE_MAX];
+	FILE *f = fopen(path, "r");
+	int len;
+
+	if(f == NULL)
+		return -1;
+	while(s->num)
+		free(s->line[--s->num]);
+	memset(s, 0, sizeof(*s));
+	s->path = path;
+	while(fgets(buf, sizeof(buf), f) && (s->num < BENCH_SCRIPT_MAX)){
+		len = strlen(buf);
+		while(len && ((buf[len - 1] == '\n') || (buf[len - 1] == '\r')))
+			buf[--len] = '\0';
+		s->line[s->num] = malloc(len + 1);
+		memcpy(s->line[s->num++], buf, len + 1);
+	}
+	fclose(f);
+	return 0;
+}
+
+static void bench_run(struct bench_script *s)
+{
+	int loop_line[BENCH_REPEAT_DEPTH], loop_left[BENCH_REPEAT_DEPTH], depth = 0;
+	char line[BENCH_LINE_MAX], word[32], arg[BENCH_LINE_MAX];
+	int ln, a, b, c;
+	char *p;
+
+	for(ln = 0; ln < s->num; ln++){
+		bench_expand(s, s->line[ln], line, sizeof(line));
+		if((line[0] == '\0') || (line[0] == '#'))
+			continue;
+		word[0] = arg[0] = '\0';
+		sscanf(line, "%31s %[^\n]", word, arg);
+
+		if(strncmp(line, "AT", 2) == 0){
+			if(bench_command(s, line, NULL, 0, NULL) < 0)
+				bench_fail(s->path, ln + 1, "no response");
+		}
+		else if(strcmp(word, "expect") == 0){
+			if(strstr(s->last, arg) == NULL){
+				bench_fail(s->path, ln + 1, arg);
+				printf("  response: %s\n", s->last);
+			}
+		}
+		else if(strcmp(word, "wait") == 0){
+			if(bench_uart_wait_text(arg, BENCH_RESP_TIMEOUT_MS) < 0)
+				bench_fail(s->path, ln + 1, line);
+			else{
+				snprintf(word, sizeof(word), "%s done", s->last_name);
+				bench_stat_add(word, (u32)(bench_now_us() - s->last_start), 0);
+			}
+			strcpy(s->last, bench_uart_text());
+		}
+		else if(strcmp(word, "set") == 0){
+			word[0] = '\0';
+			sscanf(arg, "%31s %[^\n]", word, line);
+			p = strstr(s->last, line);
+			if((word[0] == '\0') || (p == NULL))
+				bench_fail(s->path, ln + 1, "set: key not in the response");
+			else
+				bench_var_set(s, word, atoi(p + strlen(line)));
+		}
+		else if(strcmp(word, "repeat") == 0){
+			if(depth == BENCH_REPEAT_DEPTH)
+				continue;
+			loop_line[depth] = ln;
+			loop_left[depth++] = atoi(arg);
+		}
+		else if(strcmp(word, "end") == 0){
+			if(depth && (--loop_left[depth - 1] > 0))
+				ln = loop_line[depth - 1];
+			else if(depth)
+				depth--;
+		}
+		else if(strcmp(word, "sleep") == 0)
+			usleep(atoi(arg) * 1000);
+		else if(strcmp(word, "peer") == 0){
+			a = 0;
+			sscanf(arg, "%31s %d", word, &a);
+			if((strcmp(word, "listen") == 0) || (strcmp(word, "connect") == 0)){
+				if(((word[0] == 'l') ? bench_peer_listen(a, strstr(arg, "echo") != NULL) : bench_peer_connect(a, strstr(arg, "echo") != NULL)) < 0)
+					bench_fail(s->path, ln + 1, line);
+			}
+			else if(strcmp(word, "close") == 0)
+				bench_peer_close();
+			else
+				bench_fail(s->path, ln + 1, line);
+		}
+		else if(strcmp(word, "send") == 0){
+			if(sscanf(arg, "%d %d %d", &a, &b, &c) == 3)
+				bench_do_send(s, ln + 1, a, b, c);
+			else
+				bench_fail(s->path, ln + 1, "usage: send <con_id> <size> <count>");
+		}
+		else if(strcmp(word, "read") == 0){
+			if(sscanf(arg, "%d %d %d", &a, &b, &c) == 3)
+				bench_do_read(s, ln + 1, a, b, c);
+			else
+				bench_fail(s->path, ln + 1, "usage: read <con_id> <size> <total>");
+		}
+		else if(strcmp(word, "autorecv") == 0)
+			bench_do_autorecv(s, ln + 1, atoi(arg));
+		else if(strcmp(word, "tt") == 0)
+			bench_do_tt(s, ln + 1, atoi(arg));
+		else if(strcmp(word, "ttexit") == 0)
+			bench_do_ttexit(s, ln + 1);
+		else
+			bench_fail(s->path, ln + 1, "unknown directive");
+	}
+}
+
+static void usage(void)
+{
+	printf("usage: atcmd_bench [-t] [-v] [-b BAUD] SCRIPT...\n");
+	printf("  -t       test mode: checks only, exit 1 on the first failing script\n");
+	printf("  -v       print the AT output and the debug messages\n");
+	printf("  -b BAUD  UART rate for the wire time estimates (default 115200)\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct bench_script script;
+	int opt, i, failed;
+
+	while((opt = getopt(argc, argv, "tvb:h")) != -1){
+		switch(opt){
+		case 't':
+			bench_test = 1;
+			break;
+		case 'v':
+			bench_verbose = 1;
+			break;
+		case 'b':
+			bench_baud = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+			return 2;
+		}
+	}
+	if((optind == argc) || (bench_baud == 0)){
+		usage();
+		return 2;
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	bench_port_init();
+	log_service_init();
+
+	for(i = optind; i < argc; i++){
+		if(bench_load(&script, argv[i]) < 0){
+			printf("%s: cannot open\n", argv[i]);
+			return 2;
+		}
+		if(!bench_test)
+			printf("== %s\n", argv[i]);
+		failed = bench_failures;
+		bench_run(&script);
+		bench_peer_close();	// a script that failed half way may leave it open
+		if(bench_test){
+			printf("%s: %s\n", argv[i], (bench_failures == failed) ? "PASS" : "FAIL");
+			if(bench_failures != failed)
+				return 1;
+		}
+	}
+	if(!bench_test)
+		bench_report_commands();
+	return bench_failures ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+/*
+ * Shared by the benchmark driver (atcmd_bench.c), the simulated UART and
+ * network interface (bench_port.c) and the OS layer (bench_os.c).
+ */
+#include "basic_types.h"
+
+#define BENCH_DEVICE_IP		"192.168.1.80"	// xnetif[0], what the peer connects to
+#define BENCH_TEXT_MAX		4096			// response text kept for checks
+
+u64 bench_now_us(void);
+extern int bench_verbose;
+
+/* byte n of every payload stream the benchmark sends */
+static inline u8 bench_pattern(u32 n)
+{
+	return (u8)(n * 7 + (n >> 8));
+}
+
+/* bench_port.c: the device end of the UART */
+void bench_port_init(void);
+void bench_uart_command(const char *line, const u8 *data, u32 data_len);
+int bench_uart_wait_response(u32 timeout_ms);
+const char *bench_uart_text(void);
+void bench_uart_text_reset(void);
+void bench_uart_data_reset(void);
+u32 bench_uart_data_bytes(void);
+u32 bench_uart_data_errors(void);
+int bench_uart_wait_data(u32 bytes, u32 timeout_ms);
+int bench_uart_wait_text(const char *text, u32 timeout_ms);
+int bench_tt_write(const u8 *data, u32 len, u32 timeout_ms);
+void bench_tt_pause(void);
+
+/* UART wire bytes since start, both directions */
+extern volatile u32 bench_uart_rx_bytes;
+extern volatile u32 bench_uart_tx_bytes;
+
+#endif
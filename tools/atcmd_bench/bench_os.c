@@ -0,0 +1,394 @@
+/*
+ * The part of FreeRTOS and of the osdep layer used by the AT command
+ * service and lwIP, on POSIX threads.
+ *
+ * Every task is a thread and runs whenever it is ready, priorities are
+ * recorded but not enforced. A queue (semaphores included) is a ring under
+ * a mutex, critical sections take one global recursive mutex. One tick is
+ * one millisecond of the monotonic clock, as configTICK_RATE_HZ on target.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "osdep_service.h"
+#include "bench.h"
+
+struct bench_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	u8 *mem;
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t count;
+	UBaseType_t head;		// next item out
+};
+
+struct bench_task {
+	pthread_t thread;
+	TaskFunction_t fn;
+	void *param;
+	UBaseType_t prio;
+	char name[configMAX_TASK_NAME_LEN];
+};
+
+static pthread_key_t task_key;
+static pthread_once_t task_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t critical_lock;
+static u64 tick_origin_us;
+
+static void bench_os_once(void)
+{
+	pthread_mutexattr_t attr;
+
+	pthread_key_create(&task_key, NULL);
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&critical_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	tick_origin_us = bench_now_us();
+}
+
+u64 bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000 + (u64)ts.tv_nsec / 1000;
+}
+
+/* the thread calling this is a task from now on, main() included */
+static struct bench_task *bench_task_self(void)
+{
+	struct bench_task *task;
+
+	pthread_once(&task_once, bench_os_once);
+	task = pthread_getspecific(task_key);
+	if(task == NULL){
+		task = calloc(1, sizeof(*task));
+		task->thread = pthread_self();
+		strcpy(task->name, "host");
+		pthread_setspecific(task_key, task);
+	}
+	return task;
+}
+
+/* absolute deadline of a wait of ticks, for pthread_cond_timedwait */
+static void bench_deadline(struct timespec *ts, TickType_t ticks)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += ticks / 1000;
+	ts->tv_nsec += (long)(ticks % 1000) * 1000000;
+	if(ts->tv_nsec >= 1000000000){
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/*
+ * Tasks
+ */
+static void *bench_task_entry(void *arg)
+{
+	struct bench_task *task = arg;
+
+	pthread_once(&task_once, bench_os_once);
+	pthread_setspecific(task_key, task);
+	task->fn(task->param);
+	/* a FreeRTOS task must not return, tolerate it anyway */
+	free(task);
+	return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char * const pcName, const configSTACK_DEPTH_TYPE usStackDepth,
+	void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask)
+{
+	struct bench_task *task;
+	pthread_attr_t attr;
+	int err;
+
+	( void ) usStackDepth;	// host stacks are larger than any of the target
+
+	pthread_once(&task_once, bench_os_once);
+	task = calloc(1, sizeof(*task));
+	if(task == NULL)
+		return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+	task->fn = pxTaskCode;
+	task->param = pvParameters;
+	task->prio = uxPriority;
+	strncpy(task->name, pcName ? pcName : "", sizeof(task->name) - 1);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&task->thread, &attr, bench_task_entry, task);
+	pthread_attr_destroy(&attr);
+	if(err){
+		free(task);
+		return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+	}
+	if(pxCreatedTask)
+		*pxCreatedTask = task;
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete)
+{
+	struct bench_task *self = bench_task_self();
+	struct bench_task *task = xTaskToDelete ? xTaskToDelete : self;
+
+	if(task == self){
+		free(task);
+		pthread_setspecific(task_key, NULL);
+		pthread_exit(NULL);
+	}
+	/* another task, only done on error paths of the AT commands */
+	pthread_cancel(task->thread);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	return bench_task_self();
+}
+
+void *vTaskGetCurrentTCB(void)
+{
+	return bench_task_self();
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask)
+{
+	struct bench_task *task = xTask ? xTask : bench_task_self();
+
+	return task->prio;
+}
+
+void vTaskPrioritySet(TaskHandle_t xTask, UBaseType_t uxNewPriority)
+{
+	struct bench_task *task = xTask ? xTask : bench_task_self();
+
+	task->prio = uxNewPriority;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	pthread_once(&task_once, bench_os_once);
+	return (TickType_t)((bench_now_us() - tick_origin_us) / 1000);
+}
+
+void vPortEnterCritical(void)
+{
+	pthread_once(&task_once, bench_os_once);
+	pthread_mutex_lock(&critical_lock);
+}
+
+void vPortExitCritical(void)
+{
+	pthread_mutex_unlock(&critical_lock);
+}
+
+size_t xPortGetFreeHeapSize(void)
+{
+	return 0;	// the host heap, not reported
+}
+
+/*
+ * Queues and semaphores
+ */
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType)
+{
+	struct bench_queue *q;
+
+	( void ) ucQueueType;
+
+	q = calloc(1, sizeof(*q));
+	if(q == NULL)
+		return NULL;
+	if(uxItemSize){
+		q->mem = malloc((size_t)uxQueueLength * uxItemSize);
+		if(q->mem == NULL){
+			free(q);
+			return NULL;
+		}
+	}
+	q->length = uxQueueLength;
+	q->item_size = uxItemSize;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->changed, NULL);
+	return q;
+}
+
+void vQueueDelete(QueueHandle_t xQueue)
+{
+	struct bench_queue *q = xQueue;
+
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->changed);
+	free(q->mem);
+	free(q);
+}
+
+/* wait under q->lock until cond holds, pdFALSE on timeout */
+#define QUEUE_WAIT(q, cond, ticks) ({ \
+	struct timespec _ts; \
+	BaseType_t _ok = pdTRUE; \
+	if(!(cond) && ((ticks) != portMAX_DELAY)) \
+		bench_deadline(&_ts, (ticks)); \
+	while(!(cond)){ \
+		if((ticks) == 0){ _ok = pdFALSE; break; } \
+		if((ticks) == portMAX_DELAY) \
+			pthread_cond_wait(&(q)->changed, &(q)->lock); \
+		else if(pthread_cond_timedwait(&(q)->changed, &(q)->lock, &_ts)){ \
+			_ok = (cond) ? pdTRUE : pdFALSE; \
+			break; \
+		} \
+	} \
+	_ok; })
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void * const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition)
+{
+	struct bench_queue *q = xQueue;
+	UBaseType_t pos;
+
+	pthread_mutex_lock(&q->lock);
+	if((xCopyPosition != queueOVERWRITE) && !QUEUE_WAIT(q, q->count < q->length, xTicksToWait)){
+		pthread_mutex_unlock(&q->lock);
+		return errQUEUE_FULL;
+	}
+	if(q->item_size && pvItemToQueue){
+		if(xCopyPosition == queueSEND_TO_FRONT){
+			q->head = (q->head + q->length - 1) % q->length;
+			pos = q->head;
+		}
+		else if(xCopyPosition == queueOVERWRITE)
+			pos = q->head;	// length 1
+		else
+			pos = (q->head + q->count) % q->length;
+		memcpy(q->mem + pos * q->item_size, pvItemToQueue, q->item_size);
+	}
+	if((xCopyPosition != queueOVERWRITE) || (q->count == 0))
+		q->count++;
+	pthread_cond_broadcast(&q->changed);
+	pthread_mutex_unlock(&q->lock);
+	return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+{
+	struct bench_queue *q = xQueue;
+
+	pthread_mutex_lock(&q->lock);
+	if(!QUEUE_WAIT(q, q->count > 0, xTicksToWait)){
+		pthread_mutex_unlock(&q->lock);
+		return errQUEUE_EMPTY;
+	}
+	if(q->item_size){
+		memcpy(pvBuffer, q->mem + q->head * q->item_size, q->item_size);
+		q->head = (q->head + 1) % q->length;
+	}
+	q->count--;
+	pthread_cond_broadcast(&q->changed);
+	pthread_mutex_unlock(&q->lock);
+	return pdPASS;
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait)
+{
+	struct bench_queue *q = xQueue;
+
+	pthread_mutex_lock(&q->lock);
+	if(!QUEUE_WAIT(q, q->count > 0, xTicksToWait)){
+		pthread_mutex_unlock(&q->lock);
+		return errQUEUE_EMPTY;
+	}
+	q->count--;
+	pthread_cond_broadcast(&q->changed);
+	pthread_mutex_unlock(&q->lock);
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+{
+	struct bench_queue *q = xQueue;
+	UBaseType_t count;
+
+	pthread_mutex_lock(&q->lock);
+	count = q->count;
+	pthread_mutex_unlock(&q->lock);
+	return count;
+}
+
+/*
+ * osdep, as freertos_service.c maps it
+ */
+void rtw_init_sema(_sema *sema, int init_val)
+{
+	*sema = xQueueGenericCreate(0xffffffff, 0, queueQUEUE_TYPE_COUNTING_SEMAPHORE);
+	while(init_val-- > 0)
+		xQueueGenericSend(*sema, NULL, 0, queueSEND_TO_BACK);
+}
+
+void rtw_free_sema(_sema *sema)
+{
+	if(*sema != NULL)
+		vQueueDelete(*sema);
+	*sema = NULL;
+}
+
+void rtw_up_sema(_sema *sema)
+{
+	xQueueGenericSend(*sema, NULL, 0, queueSEND_TO_BACK);
+}
+
+void rtw_up_sema_from_isr(_sema *sema)
+{
+	rtw_up_sema(sema);
+}
+
+u32 rtw_down_timeout_sema(_sema *sema, u32 timeout)
+{
+	return xQueueSemaphoreTake(*sema, (timeout == RTW_MAX_DELAY) ? portMAX_DELAY : timeout) == pdTRUE;
+}
+
+u32 rtw_down_sema(_sema *sema)
+{
+	while(xQueueSemaphoreTake(*sema, portMAX_DELAY) != pdTRUE);
+	return _TRUE;
+}
+
+void rtw_msleep_os(int ms)
+{
+	usleep(ms * 1000);
+}
+
+void rtw_memcpy(void *dst, void *src, u32 sz)
+{
+	memcpy(dst, src, sz);
+}
+
+int rtw_memcmp(void *dst, void *src, u32 sz)
+{
+	return memcmp(dst, src, sz) == 0;
+}
+
+void rtw_memset(void *pbuf, int c, u32 sz)
+{
+	memset(pbuf, c, sz);
+}
+
+/* platform_stdlib_rtl8710c.h sends malloc() to the FreeRTOS heap */
+#undef malloc
+void *pvPortMalloc(size_t xWantedSize)
+{
+	return malloc(xWantedSize);
+}
+
+void vPortFree(void *pv)
+{
+	free(pv);
+}
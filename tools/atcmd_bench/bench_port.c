@@ -0,0 +1,493 @@
+/*
+ * What example_uart_atcmd.c and the Wi-Fi stack provide to the AT command
+ * service on the device, simulated on the host:
+ *
+ *   - the command line goes into log_buf and log_rx_interrupt_sema is given,
+ *     as uart_irq() does, an ATPT keeps its data behind the '\0' of the
+ *     command. Output of at_printf()/at_print_data() is captured here.
+ *   - TT mode receives through the same atcmd_tt_ring as the UART DMA, the
+ *     benchmark writes into it as the DMA would.
+ *   - xnetif[0] is a station interface at BENCH_DEVICE_IP. Its link output
+ *     drops everything, traffic to its own address is looped back by lwIP
+ *     (LWIP_NETIF_LOOPBACK), so the peer of the benchmark and the device
+ *     share one stack.
+ *   - the settings partition lives in RAM, the Wi-Fi, ping and power
+ *     management hooks do nothing.
+ */
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "lwip_netconf.h"
+#include "osdep_service.h"
+#include "log_service.h"
+#include "atcmd_wifi.h"
+#include "atcmd_lwip.h"
+#include "atcmd_tt_ring.h"
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"	// the hex helpers of the header
+#include "uart_atcmd/example_uart_atcmd.h"
+#pragma GCC diagnostic pop
+#include "bench.h"
+
+extern char log_buf[LOG_SERVICE_BUFLEN];
+extern xSemaphoreHandle log_rx_interrupt_sema;
+extern _sema atcmd_lwip_tt_sema;
+
+char at_string[ATSTRING_LEN];
+struct netif xnetif[NET_IF_NUM];
+
+volatile u32 bench_uart_rx_bytes;
+volatile u32 bench_uart_tx_bytes;
+
+static pthread_mutex_t uart_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t uart_changed = PTHREAD_COND_INITIALIZER;
+static char uart_text[BENCH_TEXT_MAX];
+static u32 uart_text_len;
+static u32 uart_resp_count;		// uart_at_resp_end() calls
+static u32 uart_resp_wait;		// count the command in flight waits for
+static u32 uart_data_bytes;		// through at_print_data()
+static u32 uart_data_errors;	// of them, not following bench_pattern()
+
+/* absolute deadline for pthread_cond_timedwait */
+static void uart_deadline(struct timespec *ts, u32 ms)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (long)(ms % 1000) * 1000000;
+	if(ts->tv_nsec >= 1000000000){
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/**** UART, command mode ****/
+
+void uart_at_send_string(char *str)
+{
+	u32 len = strlen(str);
+	u32 room;
+
+	pthread_mutex_lock(&uart_lock);
+	room = sizeof(uart_text) - 1 - uart_text_len;
+	memcpy(uart_text + uart_text_len, str, (len < room) ? len : room);
+	uart_text_len += (len < room) ? len : room;
+	uart_text[uart_text_len] = '\0';
+	bench_uart_tx_bytes += len;
+	pthread_cond_broadcast(&uart_changed);
+	pthread_mutex_unlock(&uart_lock);
+	if(bench_verbose)
+		fputs(str, stdout);
+}
+
+void uart_at_send_buf(u8 *buf, u32 len)
+{
+	u32 i;
+
+	pthread_mutex_lock(&uart_lock);
+	for(i = 0; i < len; i++)
+		if(buf[i] != bench_pattern(uart_data_bytes + i))
+			uart_data_errors++;
+	uart_data_bytes += len;
+	bench_uart_tx_bytes += len;
+	pthread_cond_broadcast(&uart_changed);
+	pthread_mutex_unlock(&uart_lock);
+	if(bench_verbose)
+		printf("<%u data bytes>", (unsigned)len);
+}
+
+void uart_at_resp_begin(void)
+{
+}
+
+void uart_at_resp_end(void)
+{
+	pthread_mutex_lock(&uart_lock);
+	uart_resp_count++;
+	pthread_cond_broadcast(&uart_changed);
+	pthread_mutex_unlock(&uart_lock);
+}
+
+int uart_at_frame_is_active(void)
+{
+	return 0;
+}
+
+void bench_uart_text_reset(void)
+{
+	pthread_mutex_lock(&uart_lock);
+	uart_text_len = 0;
+	uart_text[0] = '\0';
+	pthread_mutex_unlock(&uart_lock);
+}
+
+/**
+ * Hand a command line to log_service as uart_irq() does on '\r', or on the
+ * last data byte of an ATPT. The previous command must have completed.
+ */
+void bench_uart_command(const char *line, const u8 *data, u32 data_len)
+{
+	u32 len = strlen(line);
+
+	bench_uart_text_reset();
+	pthread_mutex_lock(&uart_lock);
+	uart_resp_wait = uart_resp_count + 1;
+	pthread_mutex_unlock(&uart_lock);
+
+	memset(log_buf, 0, LOG_SERVICE_BUFLEN);
+	memcpy(log_buf, line, len);
+	if(data)
+		memcpy(log_buf + len + 1, data, data_len);	// after the ':' made '\0'
+	bench_uart_rx_bytes += len + 1 + data_len;
+	xSemaphoreGive(log_rx_interrupt_sema);
+}
+
+/**
+ * @return 0 once log_service completed the command, -1 on timeout
+ */
+int bench_uart_wait_response(u32 timeout_ms)
+{
+	struct timespec ts;
+	int ret = 0;
+
+	uart_deadline(&ts, timeout_ms);
+	pthread_mutex_lock(&uart_lock);
+	while((s32)(uart_resp_count - uart_resp_wait) < 0)
+		if(pthread_cond_timedwait(&uart_changed, &uart_lock, &ts)){
+			ret = ((s32)(uart_resp_count - uart_resp_wait) < 0) ? -1 : 0;
+			break;
+		}
+	pthread_mutex_unlock(&uart_lock);
+	return ret;
+}
+
+/* text output since the last command, truncated to BENCH_TEXT_MAX */
+const char *bench_uart_text(void)
+{
+	return uart_text;
+}
+
+/**
+ * @return 0 once text was output since the last command, -1 on timeout
+ */
+int bench_uart_wait_text(const char *text, u32 timeout_ms)
+{
+	struct timespec ts;
+	int ret = 0;
+
+	uart_deadline(&ts, timeout_ms);
+	pthread_mutex_lock(&uart_lock);
+	while(strstr(uart_text, text) == NULL)
+		if(pthread_cond_timedwait(&uart_changed, &uart_lock, &ts)){
+			ret = strstr(uart_text, text) ? 0 : -1;
+			break;
+		}
+	pthread_mutex_unlock(&uart_lock);
+	return ret;
+}
+
+void bench_uart_data_reset(void)
+{
+	pthread_mutex_lock(&uart_lock);
+	uart_data_bytes = 0;
+	uart_data_errors = 0;
+	pthread_mutex_unlock(&uart_lock);
+}
+
+u32 bench_uart_data_bytes(void)
+{
+	return uart_data_bytes;
+}
+
+u32 bench_uart_data_errors(void)
+{
+	return uart_data_errors;
+}
+
+/**
+ * @return 0 once bytes of data were output since bench_uart_data_reset(),
+ *         -1 on timeout
+ */
+int bench_uart_wait_data(u32 bytes, u32 timeout_ms)
+{
+	struct timespec ts;
+	int ret = 0;
+
+	uart_deadline(&ts, timeout_ms);
+	pthread_mutex_lock(&uart_lock);
+	while(uart_data_bytes < bytes)
+		if(pthread_cond_timedwait(&uart_changed, &uart_lock, &ts)){
+			ret = (uart_data_bytes < bytes) ? -1 : 0;
+			break;
+		}
+	pthread_mutex_unlock(&uart_lock);
+	return ret;
+}
+
+/**** UART, TT mode ****/
+
+/*
+ * As in example_uart_atcmd.c, with bench_tt_write() in place of the RX DMA:
+ * tt_fill is the buffer armed for "DMA", NULL while the ring is full.
+ */
+static struct atcmd_tt_ring tt_ring;
+static u8 *tt_fill;
+static u16 tt_fill_len;
+static u8 tt_idle;
+
+static void tt_commit(u16 len)
+{
+	atcmd_tt_ring_commit(&tt_ring, len, tt_idle ? ATCMD_TT_F_IDLE : 0);
+	tt_idle = 0;
+	tt_fill = atcmd_tt_ring_fill(&tt_ring);
+	tt_fill_len = 0;
+}
+
+struct atcmd_tt_ring *uart_at_tt_start(void)
+{
+	u8 *mem;
+
+	if(tt_ring.mem)
+		return &tt_ring;
+	mem = malloc(UART_AT_TT_BUF_NUM * UART_AT_TT_BUF_SIZE);
+	if(mem == NULL)
+		return NULL;
+	atcmd_tt_ring_init(&tt_ring, mem, UART_AT_TT_BUF_NUM, UART_AT_TT_BUF_SIZE);
+
+	taskENTER_CRITICAL();
+	tt_idle = 1;
+	tt_fill = atcmd_tt_ring_fill(&tt_ring);
+	tt_fill_len = 0;
+	taskEXIT_CRITICAL();
+	return &tt_ring;
+}
+
+void uart_at_tt_flush(void)
+{
+	taskENTER_CRITICAL();
+	if(tt_fill){
+		if(tt_fill_len)
+			tt_commit(tt_fill_len);
+		tt_idle = 1;
+	}
+	taskEXIT_CRITICAL();
+}
+
+void uart_at_tt_release(void)
+{
+	atcmd_tt_ring_release(&tt_ring);
+
+	taskENTER_CRITICAL();
+	if(tt_ring.mem && (tt_fill == NULL))
+		tt_fill = atcmd_tt_ring_fill(&tt_ring);
+	taskEXIT_CRITICAL();
+}
+
+void uart_at_tt_stop(void)
+{
+	if(tt_ring.mem == NULL)
+		return;
+
+	taskENTER_CRITICAL();
+	tt_fill = NULL;
+	free(tt_ring.mem);
+	tt_ring.mem = NULL;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * Receive len bytes in TT mode. While the ring is full the sender is held
+ * off, as RTS would.
+ *
+ * @return 0, -1 if TT mode stopped or stayed stalled for timeout_ms
+ */
+int bench_tt_write(const u8 *data, u32 len, u32 timeout_ms)
+{
+	u64 stalled = 0;
+	u32 n;
+
+	while(len){
+		taskENTER_CRITICAL();
+		if(tt_ring.mem == NULL){
+			taskEXIT_CRITICAL();
+			return -1;
+		}
+		if(tt_fill == NULL){
+			taskEXIT_CRITICAL();
+			if(stalled == 0)
+				stalled = bench_now_us();
+			else if(bench_now_us() - stalled > (u64)timeout_ms * 1000)
+				return -1;
+			usleep(50);
+			continue;
+		}
+		stalled = 0;
+		n = UART_AT_TT_BUF_SIZE - tt_fill_len;
+		if(n > len)
+			n = len;
+		memcpy(tt_fill + tt_fill_len, data, n);
+		tt_fill_len += n;
+		bench_uart_rx_bytes += n;
+		data += n;
+		len -= n;
+		if(tt_fill_len == UART_AT_TT_BUF_SIZE){
+			tt_commit(UART_AT_TT_BUF_SIZE);
+			rtw_up_sema(&atcmd_lwip_tt_sema);
+		}
+		taskEXIT_CRITICAL();
+	}
+	return 0;
+}
+
+/* the line goes quiet until the TT task flushed what was received */
+void bench_tt_pause(void)
+{
+	u64 start = bench_now_us();
+	int done;
+
+	do{
+		usleep(ATCMD_LWIP_TT_MAX_DELAY_TIME_MS * 1000);
+		taskENTER_CRITICAL();
+		done = (tt_ring.mem == NULL) || ((tt_fill != NULL) && (tt_fill_len == 0) && tt_idle);
+		taskEXIT_CRITICAL();
+	}while(!done && (bench_now_us() - start < 1000000));
+}
+
+/**** settings partition ****/
+
+static u8 partition[AT_PARTITION_LWIP + 1][512];
+
+void atcmd_update_partition_info(AT_PARTITION id, AT_PARTITION_OP ops, u8 *data, u16 len)
+{
+	if(id > AT_PARTITION_LWIP)
+		return;
+	if(len > sizeof(partition[0]))
+		len = sizeof(partition[0]);
+
+	if(id == AT_PARTITION_ALL){
+		if(ops == AT_PARTITION_ERASE)
+			memset(partition, 0xff, sizeof(partition));
+	}
+	else if(ops == AT_PARTITION_READ)
+		memcpy(data, partition[id], len);
+	else if(ops == AT_PARTITION_WRITE)
+		memcpy(partition[id], data, len);
+	else
+		memset(partition[id], 0xff, sizeof(partition[id]));
+}
+
+/**** network interface ****/
+
+static err_t bench_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+	( void ) netif;
+	( void ) p;
+	( void ) ipaddr;
+	return ERR_OK;	// nobody else on the link
+}
+
+static err_t bench_netif_init(struct netif *netif)
+{
+	netif->name[0] = 'r';
+	netif->name[1] = '0';
+	netif->mtu = 1500;
+	netif->output = bench_netif_output;
+	netif->flags = NETIF_FLAG_BROADCAST;
+	return ERR_OK;
+}
+
+static void bench_tcpip_ready(void *arg)
+{
+	ip4_addr_t ipaddr, netmask, gw;
+
+	ip4addr_aton(BENCH_DEVICE_IP, &ipaddr);
+	IP4_ADDR(&netmask, 255, 255, 255, 0);
+	IP4_ADDR(&gw, 192, 168, 1, 1);
+	netif_add(&xnetif[0], &ipaddr, &netmask, &gw, NULL, bench_netif_init, tcpip_input);
+	netif_set_default(&xnetif[0]);
+	netif_set_up(&xnetif[0]);
+	netif_set_link_up(&xnetif[0]);
+	xSemaphoreGive((xSemaphoreHandle)arg);
+}
+
+unsigned char *LwIP_GetIP(struct netif *pnetif)
+{
+	return (unsigned char *)&(pnetif->ip_addr);
+}
+
+void bench_port_init(void)
+{
+	xSemaphoreHandle ready = xSemaphoreCreateBinary();
+
+	memset(partition, 0xff, sizeof(partition));
+	tcpip_init(bench_tcpip_ready, ready);
+	xSemaphoreTake(ready, portMAX_DELAY);
+	vSemaphoreDelete(ready);
+}
+
+/**** the rest of the device ****/
+
+void at_wifi_init(void)
+{
+}
+
+void at_sys_init(void)
+{
+}
+
+void print_wlan_help(void)
+{
+}
+
+int wext_private_command(const char *ifname, char *cmd, int show_msg)
+{
+	( void ) ifname;
+	( void ) cmd;
+	( void ) show_msg;
+	return -1;
+}
+
+void do_ping_call(char *ip, int loop, int count)
+{
+	( void ) ip;
+	( void ) loop;
+	( void ) count;
+}
+
+int get_ping_report(int *ping_lost)
+{
+	*ping_lost = 0;
+	return 0;
+}
+
+void pmu_release_wakelock(uint32_t nDeviceId)
+{
+	( void ) nDeviceId;
+}
+
+/* platform_stdlib_rtl8710c.h sends these to the ROM */
+int __wrap_printf(const char *fmt, ...)
+{
+	va_list ap;
+	int ret = 0;
+
+	if(bench_verbose){
+		va_start(ap, fmt);
+		ret = vprintf(fmt, ap);
+		va_end(ap);
+	}
+	return ret;
+}
+
+#undef strtok
+char *__wrap_strtok(char *str, const char *delim)
+{
+	return strtok(str, delim);
+}
@@ -0,0 +1,41 @@
+/*
+ * Host stand-in for port/realtek/arch/cc.h, found first on the include path
+ * of the benchmark. The port typedefs mem_ptr_t as u32_t and s32_t as long,
+ * which only holds on the 32 bit target.
+ */
+#ifndef __CC_H__
+#define __CC_H__
+
+#include <stdint.h>
+#include "arch/cpu.h"
+
+typedef uint8_t		u8_t;
+typedef int8_t		s8_t;
+typedef uint16_t	u16_t;
+typedef int16_t		s16_t;
+typedef uint32_t	u32_t;
+typedef int32_t		s32_t;
+typedef uintptr_t	mem_ptr_t;
+typedef int sys_prot_t;
+
+#define U16_F "d"
+#define S16_F "d"
+#define X16_F "x"
+#define U32_F "u"
+#define S32_F "d"
+#define X32_F "x"
+#define SZT_F "zu"
+
+#define PACK_STRUCT_BEGIN
+#define PACK_STRUCT_STRUCT __attribute__ ((__packed__))
+#define PACK_STRUCT_END
+#define PACK_STRUCT_FIELD(x) x
+#define PACK_STRUCT_USE_INCLUDES
+
+#define LWIP_PLATFORM_ASSERT(x)
+
+#define LWIP_NO_STDINT_H 1
+#define LWIP_TIMEVAL_PRIVATE 0
+#define IN_ADDR_T_DEFINED 1
+
+#endif /* __CC_H__ */
@@ -0,0 +1,489 @@
+/******************************************************************************
+ *
+ * Host side tool for the binary framed AT mode, see readme.txt.
+ *
+ * -t runs a loopback self test: a simulated device with the same receive
+ * window as the firmware (UART_AT_FRAME_RX_DEPTH buffers, NAK BUSY when the
+ * host exceeds it, RSP split in MORE fragments) talks to a host that keeps
+ * several commands in flight over a lossy wire.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atcmd_frame.h"
+
+#define SIM_WINDOW			3		// UART_AT_FRAME_RX_DEPTH
+#define SIM_TX_CHUNK		48		// small on purpose, exercises MORE fragments
+#define SIM_CMD_MAX			256
+#define SIM_RSP_MAX			1024
+#define SIM_WIRE_SIZE		8192
+#define SIM_TIMEOUT			40		// host retransmit timeout, in steps
+#define SIM_STALL			4		// device drops a partial frame after this many idle steps
+
+struct sim_wire {
+	u8 data[SIM_WIRE_SIZE];
+	u32 head;
+	u32 tail;
+};
+
+static int sim_error_rate;
+static u32 sim_corrupted;
+
+static void sim_wire_put(struct sim_wire *w, u8 *frame, u16 len)
+{
+	/* corrupt a frame on the wire: flip a bit, truncate it or drop it */
+	if(sim_error_rate && ((rand() % 100) < sim_error_rate)){
+		sim_corrupted++;
+		switch(rand() % 3){
+			case 0:
+				frame[rand() % len] ^= (u8)(1 << (rand() % 8));
+				break;
+			case 1:
+				len = (u16)(rand() % len);
+				break;
+			default:
+				return;
+		}
+	}
+	if(w->tail + len > SIM_WIRE_SIZE){
+		memmove(w->data, w->data + w->head, w->tail - w->head);
+		w->tail -= w->head;
+		w->head = 0;
+	}
+	if(w->tail + len > SIM_WIRE_SIZE){
+		printf("wire overflow\n");
+		exit(1);
+	}
+	memcpy(w->data + w->tail, frame, len);
+	w->tail += len;
+}
+
+/* simulated device */
+struct sim_dev {
+	struct atframe_rx rx;
+	u8 pool[SIM_WINDOW][SIM_CMD_MAX + ATFRAME_CRC_LEN];
+	u8 pool_used[SIM_WINDOW];
+	u8 *cur;		// buffer handed to rx
+	struct {
+		u8 seq;
+		u16 len;
+		u8 *buf;
+	} q[SIM_WINDOW];
+	int q_n;
+	int idle;
+	u32 naks;
+	u32 executed;
+};
+
+static void sim_dev_give_buf(struct sim_dev *dev)
+{
+	int i;
+
+	if(dev->rx.buf)
+		return;
+	for(i = 0; i < SIM_WINDOW; i++){
+		if(!dev->pool_used[i]){
+			dev->pool_used[i] = 1;
+			dev->cur = dev->pool[i];
+			atframe_rx_set_buf(&dev->rx, dev->pool[i], sizeof(dev->pool[i]));
+			return;
+		}
+	}
+}
+
+static void sim_dev_release(struct sim_dev *dev, u8 *buf)
+{
+	dev->pool_used[(buf - dev->pool[0]) / sizeof(dev->pool[0])] = 0;
+	sim_dev_give_buf(dev);
+}
+
+/* what the device answers to a command, also used by the host to verify */
+static u16 sim_response(const u8 *cmd, u16 len, u8 *rsp)
+{
+	u16 n = 0, i;
+
+	/* long enough to need several fragments */
+	for(i = 0; i < 3; i++){
+		memcpy(rsp + n, "[ECHO] ", 7);
+		n += 7;
+		memcpy(rsp + n, cmd, len);
+		n = (u16)(n + len);
+	}
+	memcpy(rsp + n, "\r\nOK\r\n", 6);
+	return (u16)(n + 6);
+}
+
+static void sim_dev_send(struct sim_wire *out, u8 type, u8 seq, const u8 *payload, u16 len)
+{
+	u8 frame[SIM_TX_CHUNK + ATFRAME_OVERHEAD];
+
+	sim_wire_put(out, frame, atframe_encode(frame, sizeof(frame), type, seq, payload, len));
+}
+
+static void sim_dev_step(struct sim_dev *dev, struct sim_wire *in, struct sim_wire *out)
+{
+	u8 rsp[SIM_RSP_MAX];
+	u16 rsp_len, off;
+	u32 used;
+	int ret;
+
+	if(in->head == in->tail){
+		/* the firmware drops a frame the host stopped sending mid way */
+		if(!atframe_rx_idle(&dev->rx) && (++dev->idle > SIM_STALL)){
+			atframe_rx_reset(&dev->rx);
+			dev->rx.errors++;
+			dev->idle = 0;
+		}
+	}
+	else
+		dev->idle = 0;
+
+	while(in->head < in->tail){
+		ret = atframe_rx_feed(&dev->rx, in->data + in->head, in->tail - in->head, &used);
+		in->head += used;
+		if(ret == ATFRAME_RX_FRAME){
+			dev->q[dev->q_n].seq = dev->rx.seq;
+			dev->q[dev->q_n].len = dev->rx.len;
+			dev->q[dev->q_n].buf = dev->cur;
+			dev->cur = NULL;
+			dev->q_n++;
+			sim_dev_give_buf(dev);
+		}
+		else if(ret == ATFRAME_RX_ERROR){
+			dev->naks++;
+			sim_dev_send(out, ATFRAME_TYPE_NAK, dev->rx.seq, &dev->rx.nak, 1);
+		}
+	}
+
+	/* execute one command per step, in arrival order */
+	if(dev->q_n){
+		rsp_len = sim_response(dev->q[0].buf, dev->q[0].len, rsp);
+		for(off = 0; off < rsp_len; off = (u16)(off + SIM_TX_CHUNK)){
+			u16 n = (u16)(rsp_len - off);
+			u8 type = ATFRAME_TYPE_RSP;
+			if(n > SIM_TX_CHUNK){
+				n = SIM_TX_CHUNK;
+				type |= ATFRAME_FLAG_MORE;
+			}
+			sim_dev_send(out, type, dev->q[0].seq, rsp + off, n);
+		}
+		dev->executed++;
+		sim_dev_release(dev, dev->q[0].buf);
+		dev->q_n--;
+		memmove(&dev->q[0], &dev->q[1], dev->q_n * sizeof(dev->q[0]));
+	}
+}
+
+/* host side of the self test */
+struct sim_slot {
+	int busy;
+	u32 id;
+	u8 seq;
+	u8 cmd[SIM_CMD_MAX];
+	u16 cmd_len;
+	u8 rsp[SIM_RSP_MAX];
+	u16 rsp_len;
+	u32 sent_at;
+	u32 tries;
+};
+
+static void sim_host_send(struct sim_slot *s, struct sim_wire *out, u32 now)
+{
+	u8 frame[SIM_CMD_MAX + ATFRAME_OVERHEAD];
+
+	s->rsp_len = 0;
+	s->sent_at = now;
+	s->tries++;
+	sim_wire_put(out, frame, atframe_encode(frame, sizeof(frame), ATFRAME_TYPE_CMD, s->seq, s->cmd, s->cmd_len));
+}
+
+static int sim_selftest(u32 count)
+{
+	static struct sim_wire h2d, d2h;
+	static struct sim_dev dev;
+	struct sim_slot slot[SIM_WINDOW];
+	struct atframe_rx rx;
+	u8 rx_buf[SIM_TX_CHUNK + ATFRAME_CRC_LEN];
+	u8 expect[SIM_RSP_MAX];
+	u32 next_id = 0, done = 0, retrans = 0, now, used;
+	u8 next_seq = 0;
+	int i, ret;
+
+	memset(slot, 0, sizeof(slot));
+	memset(&rx, 0, sizeof(rx));
+	atframe_rx_set_buf(&rx, rx_buf, sizeof(rx_buf));
+	sim_dev_give_buf(&dev);
+
+	for(now = 0; done < count; now++){
+		if(now > count * SIM_TIMEOUT * 10){
+			printf("FAIL: no progress, %u of %u commands done\n", (unsigned)done, (unsigned)count);
+			return 1;
+		}
+
+		/* keep the window full */
+		for(i = 0; i < SIM_WINDOW && next_id < count; i++){
+			struct sim_slot *s = &slot[i];
+			if(s->busy)
+				continue;
+			s->busy = 1;
+			s->id = next_id++;
+			s->seq = next_seq++;
+			s->tries = 0;
+			s->cmd_len = (u16)sprintf((char *)s->cmd, "ATSV=%u,%.*s", (unsigned)s->id,
+				(int)(s->id % 100), "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789");
+			sim_host_send(s, &h2d, now);
+		}
+
+		sim_dev_step(&dev, &h2d, &d2h);
+
+		while(d2h.head < d2h.tail){
+			ret = atframe_rx_feed(&rx, d2h.data + d2h.head, d2h.tail - d2h.head, &used);
+			d2h.head += used;
+			if(ret != ATFRAME_RX_FRAME)
+				continue;
+			atframe_rx_set_buf(&rx, rx_buf, sizeof(rx_buf));
+			for(i = 0; i < SIM_WINDOW; i++)
+				if(slot[i].busy && slot[i].seq == rx.seq)
+					break;
+			if(i == SIM_WINDOW)
+				continue;	// late answer to a command already completed
+			if((rx.type & ATFRAME_TYPE_MASK) == ATFRAME_TYPE_NAK){
+				retrans++;
+				sim_host_send(&slot[i], &h2d, now);
+				continue;
+			}
+			if((rx.type & ATFRAME_TYPE_MASK) != ATFRAME_TYPE_RSP)
+				continue;
+			if(slot[i].rsp_len + rx.len <= SIM_RSP_MAX){
+				memcpy(slot[i].rsp + slot[i].rsp_len, rx_buf, rx.len);
+				slot[i].rsp_len = (u16)(slot[i].rsp_len + rx.len);
+			}
+			if(rx.type & ATFRAME_FLAG_MORE)
+				continue;
+			if((sim_response(slot[i].cmd, slot[i].cmd_len, expect) == slot[i].rsp_len) &&
+				(memcmp(expect, slot[i].rsp, slot[i].rsp_len) == 0)){
+				slot[i].busy = 0;
+				done++;
+			}
+			else{
+				/* a fragment got lost, ask again */
+				retrans++;
+				sim_host_send(&slot[i], &h2d, now);
+			}
+		}
+
+		for(i = 0; i < SIM_WINDOW; i++){
+			if(slot[i].busy && (now - slot[i].sent_at > SIM_TIMEOUT)){
+				retrans++;
+				sim_host_send(&slot[i], &h2d, now);
+			}
+		}
+	}
+
+	printf("commands %u, steps %u, corrupted frames %u, retransmits %u\n",
+		(unsigned)count, (unsigned)now, (unsigned)sim_corrupted, (unsigned)retrans);
+	printf("device: frames %u, errors %u, NAK %u, executed %u\n",
+		(unsigned)dev.rx.frames, (unsigned)dev.rx.errors, (unsigned)dev.naks, (unsigned)dev.executed);
+	printf("host: frames %u, errors %u\n", (unsigned)rx.frames, (unsigned)rx.errors);
+	printf("PASS\n");
+	return 0;
+}
+
+#if defined(_WIN32)
+static int sim_serial(int argc, char **argv)
+{
+	(void)argc;
+	(void)argv;
+	printf("serial mode is not supported on this platform, use -t\n");
+	return 1;
+}
+#else
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+static speed_t sim_baud(long baud)
+{
+	switch(baud){
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+#ifdef B460800
+		case 460800:	return B460800;
+#endif
+#ifdef B921600
+		case 921600:	return B921600;
+#endif
+		default:		return 0;
+	}
+}
+
+/* read with timeout, returns bytes read, 0 on timeout */
+static int sim_read(int fd, u8 *buf, int size, int timeout_ms)
+{
+	fd_set fds;
+	struct timeval tv;
+	int n;
+
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	if(select(fd + 1, &fds, NULL, NULL, &tv) <= 0)
+		return 0;
+	n = (int)read(fd, buf, size);
+	return (n > 0) ? n : 0;
+}
+
+static int sim_write(int fd, const u8 *buf, int len)
+{
+	while(len > 0){
+		int n = (int)write(fd, buf, len);
+		if(n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int sim_send_cmd(int fd, u8 seq, const char *cmd)
+{
+	u8 frame[SIM_CMD_MAX + ATFRAME_OVERHEAD];
+	u16 len = atframe_encode(frame, sizeof(frame), ATFRAME_TYPE_CMD, seq, (const u8 *)cmd, (u16)strlen(cmd));
+
+	if(len == 0){
+		printf("command too long: %s\n", cmd);
+		return -1;
+	}
+	printf(">%3u %s\n", seq, cmd);
+	return sim_write(fd, frame, len);
+}
+
+static int sim_serial(int argc, char **argv)
+{
+	static u8 rx_buf[4096 + ATFRAME_CRC_LEN];
+	struct atframe_rx rx;
+	struct termios tio;
+	u8 in[256];
+	char text[256];
+	int fd, n, text_len = 0, next = 3, in_flight = 0, quiet = 0, bye = 0;
+	u32 pos, used;
+	u8 seq = 0;
+	speed_t speed = sim_baud(atol(argv[2]));
+
+	if(speed == 0){
+		printf("unsupported baudrate %s\n", argv[2]);
+		return 1;
+	}
+	fd = open(argv[1], O_RDWR | O_NOCTTY);
+	if(fd < 0){
+		perror(argv[1]);
+		return 1;
+	}
+	tcgetattr(fd, &tio);
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tcsetattr(fd, TCSANOW, &tio);
+	tcflush(fd, TCIOFLUSH);
+
+	/* switch to framed mode, the OK of ATSF=1 is the last text output */
+	sim_write(fd, (const u8 *)"ATSF=1\r\n", 8);
+	while((n = sim_read(fd, in, sizeof(in) - 1, 1000)) > 0){
+		if(text_len + n >= (int)sizeof(text))
+			text_len = 0;
+		memcpy(text + text_len, in, n);
+		text_len += n;
+		text[text_len] = '\0';
+		if(strstr(text, "[ATSF] OK"))
+			break;
+		if(strstr(text, "[ATSF] ERROR")){
+			printf("%s\n", text);
+			close(fd);
+			return 1;
+		}
+	}
+	if(n <= 0){
+		printf("no answer to ATSF=1\n");
+		close(fd);
+		return 1;
+	}
+
+	memset(&rx, 0, sizeof(rx));
+	atframe_rx_set_buf(&rx, rx_buf, sizeof(rx_buf));
+
+	while(!bye){
+		/* keep up to SIM_WINDOW commands in flight, ATSF=0 goes last */
+		while(in_flight < SIM_WINDOW && next <= argc){
+			if(next == argc){
+				if(in_flight)
+					break;
+				sim_send_cmd(fd, seq++, "ATSF=0");
+			}
+			else
+				sim_send_cmd(fd, seq++, argv[next]);
+			next++;
+			in_flight++;
+		}
+
+		n = sim_read(fd, in, sizeof(in), 2000);
+		if(n == 0){
+			if(++quiet == 3){
+				printf("timeout, %d command(s) unanswered\n", in_flight);
+				break;
+			}
+			continue;
+		}
+		quiet = 0;
+		for(pos = 0; pos < (u32)n; pos += used){
+			int ret = atframe_rx_feed(&rx, in + pos, n - pos, &used);
+			if(ret != ATFRAME_RX_FRAME)
+				continue;
+			atframe_rx_set_buf(&rx, rx_buf, sizeof(rx_buf));
+			switch(rx.type & ATFRAME_TYPE_MASK){
+				case ATFRAME_TYPE_RSP:
+					printf("<%3u %.*s%s", rx.seq, rx.len, rx_buf, (rx.type & ATFRAME_FLAG_MORE) ? "" : "\n");
+					if(!(rx.type & ATFRAME_FLAG_MORE)){
+						in_flight--;
+						if(next > argc && in_flight == 0)
+							bye = 1;
+					}
+					break;
+				case ATFRAME_TYPE_EVT:
+					printf("<EVT %.*s\n", rx.len, rx_buf);
+					break;
+				case ATFRAME_TYPE_NAK:
+					printf("<%3u NAK reason %u\n", rx.seq, rx.len ? rx_buf[0] : 0);
+					in_flight--;
+					break;
+			}
+		}
+	}
+	printf("frames %u, errors %u\n", (unsigned)rx.frames, (unsigned)rx.errors);
+	close(fd);
+	return 0;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	if(argc >= 2 && strcmp(argv[1], "-t") == 0){
+		u32 count = (argc >= 3) ? (u32)atol(argv[2]) : 1000;
+		sim_error_rate = (argc >= 4) ? atoi(argv[3]) : 5;
+		srand(1);
+		return sim_selftest(count);
+	}
+	if(argc >= 4)
+		return sim_serial(argc, argv);
+
+	printf("usage: %s -t [COUNT] [ERROR_RATE]\n", argv[0]);
+	printf("       %s TTY BAUDRATE CMD [CMD ...]\n", argv[0]);
+	return 1;
+}
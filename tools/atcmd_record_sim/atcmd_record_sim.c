@@ -0,0 +1,215 @@
+/******************************************************************************
+ *
+ * Host side test of the AT settings record store, see readme.txt.
+ *
+ * The two sectors live in a simulated NOR flash: erase sets 0xFF, a write
+ * can only clear bits, and power can be cut after any number of programmed
+ * bytes. The store is component/common/api/at_cmd/atcmd_record.c, mounted
+ * again after every step the way the device does at boot.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atcmd_record.h"
+
+#define SIM_SECTOR0			0x1000	// UART_SETTING_SECTOR
+#define SIM_SECTOR1			0x3000	// UART_SETTING_BACKUP_SECTOR
+#define SIM_FLASH_SIZE		0x4000
+#define SIM_IDS				3		// AT_PARTITION_UART .. AT_PARTITION_LWIP
+#define SIM_LEN_MAX			600
+
+static u8 sim_flash[SIM_FLASH_SIZE];
+static long sim_budget = -1;		// bytes programmed before the power cut, -1 none
+static u32 sim_erases = 0;
+
+static const u16 sim_len[SIM_IDS + 1] = {0, 20, 480, 84};	// legacy segment sizes
+
+static int sim_read(u32 addr, u32 len, u8 *data)
+{
+	memcpy(data, &sim_flash[addr], len);
+	return 0;
+}
+
+static int sim_write(u32 addr, u32 len, const u8 *data)
+{
+	while(len--){
+		if(sim_budget == 0)
+			return -1;
+		if(sim_budget > 0)
+			sim_budget--;
+		sim_flash[addr++] &= *data++;
+	}
+	return 0;
+}
+
+static int sim_erase(u32 addr)
+{
+	if(sim_budget == 0)
+		return -1;
+	/* a cut erase leaves the sector in any state, take the worst: half done */
+	memset(&sim_flash[addr], 0xFF, (sim_budget > 0) && (sim_budget < 64) ? 0x800 : 0x1000);
+	if(sim_budget > 0)
+		sim_budget = (sim_budget < 64) ? 0 : sim_budget - 64;
+	sim_erases++;
+	return 0;
+}
+
+static const struct atcmd_record_flash sim_ops = {sim_read, sim_write, sim_erase};
+
+static const struct atcmd_record_legacy sim_legacy[] = {
+	{1, 0, 20},
+	{2, 20, 480},
+	{3, 500, 84},
+};
+
+/* what the store must return for each id */
+struct sim_model {
+	u16 len[SIM_IDS + 1];
+	u8 data[SIM_IDS + 1][SIM_LEN_MAX];
+};
+
+static void sim_fill(u8 *data, u16 len, u32 seed)
+{
+	u16 i;
+
+	for(i = 0; i < len; i++)
+		data[i] = (u8)(seed * 31 + i * 7 + (i >> 3));
+}
+
+static int sim_match(struct atcmd_record_store *store, struct sim_model *m, int id)
+{
+	u8 buf[SIM_LEN_MAX];
+	int n = atcmd_record_read(store, (u8)id, buf, SIM_LEN_MAX);
+
+	return (n == m->len[id]) && (memcmp(buf, m->data[id], m->len[id]) == 0);
+}
+
+static int sim_mount(struct atcmd_record_store *store)
+{
+	return atcmd_record_mount(store, &sim_ops, SIM_SECTOR0, SIM_SECTOR1,
+		sim_legacy, sizeof(sim_legacy) / sizeof(sim_legacy[0]));
+}
+
+/* a device that only knew the legacy layout, with id 3 never written */
+static void sim_legacy_flash(struct sim_model *m)
+{
+	memset(sim_flash, 0xFF, sizeof(sim_flash));
+	memset(m, 0, sizeof(*m));
+	m->len[1] = sim_len[1];
+	sim_fill(m->data[1], m->len[1], 1000);
+	m->len[2] = sim_len[2];
+	sim_fill(m->data[2], m->len[2], 2000);
+	memcpy(&sim_flash[SIM_SECTOR0 + 0], m->data[1], m->len[1]);
+	memcpy(&sim_flash[SIM_SECTOR0 + 20], m->data[2], m->len[2]);
+}
+
+/* random writes and deletes, remounted after each one */
+static int sim_random(u32 steps)
+{
+	struct atcmd_record_store store;
+	struct sim_model m;
+	u32 i, bad = 0;
+	int id;
+
+	sim_legacy_flash(&m);
+	sim_erases = 0;
+	srand(1);
+	sim_mount(&store);
+	for(i = 0; i < steps; i++){
+		id = 1 + rand() % SIM_IDS;
+		if(rand() % 16 == 0)
+			m.len[id] = 0;
+		else{
+			m.len[id] = (u16)(1 + rand() % sim_len[id]);
+			sim_fill(m.data[id], m.len[id], i);
+		}
+		if(atcmd_record_write(&store, (u8)id, m.data[id], m.len[id]) < 0)
+			bad++;
+		sim_mount(&store);
+		for(id = 1; id <= SIM_IDS; id++)
+			bad += !sim_match(&store, &m, id);
+	}
+	printf("random     : %u writes, %u sector erases (%u with two erases per write), %u mismatches\n",
+		steps, sim_erases, steps * 2, bad);
+	return bad ? 1 : 0;
+}
+
+/* one write of id 2 cut after every possible number of programmed bytes */
+enum {
+	SIM_CUT_LEGACY = 0,		// the write migrates the legacy layout
+	SIM_CUT_APPEND,
+	SIM_CUT_COMPACT
+};
+
+static int sim_power_cut(int mode)
+{
+	static const char *name[] = {"legacy ", "append ", "compact"};
+	struct atcmd_record_store store;
+	struct sim_model m, next;
+	static u8 image[SIM_FLASH_SIZE];
+	u8 buf[40];
+	long cut;
+	u32 runs = 0, bad = 0, i;
+	int id, done = 0;
+
+	sim_legacy_flash(&m);
+	sim_mount(&store);
+	next = m;
+	next.len[2] = 300;
+	sim_fill(next.data[2], next.len[2], 77);
+	for(i = 0; mode != SIM_CUT_LEGACY; i++){
+		if(store.seq && (mode == SIM_CUT_APPEND))
+			break;
+		/* the active sector too full to take the write */
+		if(store.seq && (store.tail + 8 + next.len[2] > ATCMD_RECORD_SECTOR_SIZE))
+			break;
+		m.len[1] = (u16)(4 + i % 16);
+		sim_fill(m.data[1], m.len[1], i);
+		atcmd_record_write(&store, 1, m.data[1], m.len[1]);
+	}
+	next.len[1] = m.len[1];
+	memcpy(next.data[1], m.data[1], m.len[1]);
+	memcpy(image, sim_flash, sizeof(sim_flash));
+
+	for(cut = 0; !done; cut++){
+		memcpy(sim_flash, image, sizeof(sim_flash));
+		sim_mount(&store);
+		sim_budget = cut;
+		done = (atcmd_record_write(&store, 2, next.data[2], next.len[2]) == 0) && (sim_budget != 0);
+		sim_budget = -1;
+		runs++;
+
+		/* after the reboot: each record is old or new, never anything else */
+		sim_mount(&store);
+		for(id = 1; id <= SIM_IDS; id++){
+			if(!sim_match(&store, &m, id) && !sim_match(&store, &next, id))
+				bad++;
+		}
+		/* and the store keeps working */
+		if(atcmd_record_write(&store, 3, next.data[2], sizeof(buf)) < 0)
+			bad++;
+		sim_mount(&store);
+		if((atcmd_record_read(&store, 3, buf, sizeof(buf)) != sizeof(buf)) || memcmp(buf, next.data[2], sizeof(buf)))
+			bad++;
+	}
+	printf("cut %s: %u power cuts, %u bad\n", name[mode], runs, bad);
+	return bad ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	int fail = 0;
+
+	if(argc >= 2 && strcmp(argv[1], "-t") == 0){
+		fail |= sim_random(2000);
+		fail |= sim_power_cut(SIM_CUT_LEGACY);
+		fail |= sim_power_cut(SIM_CUT_APPEND);
+		fail |= sim_power_cut(SIM_CUT_COMPACT);
+		printf("%s\n", fail ? "FAIL" : "PASS");
+		return fail;
+	}
+
+	printf("usage: %s -t\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,555 @@
+/******************************************************************************
+ *
+ * Host side model of the SPI AT transport, see readme.txt.
+ *
+ * A simulated SPI master talks to a model of the slave link task of the SPI
+ * AT example: the same headers, credit and batch handling, built on the same
+ * code, component/common/api/at_cmd/atcmd_spi.c. Time is modelled from the
+ * SPI clock, the slave arming latency and the execution time of commands, so
+ * the run also gives the throughput the link allows.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atcmd_spi.h"
+
+#define SIM_RX_DEPTH		4		// SPI_AT_RX_DEPTH
+#define SIM_RX_SIZE			(1600 - 1 + ATFRAME_CRC_LEN)	// SPI_AT_RX_SIZE
+#define SIM_RSP_CHUNK		1024	// SPI_AT_RSP_CHUNK
+#define SIM_DATA_CHUNK		1460	// SPI_AT_DATA_CHUNK
+#define SIM_XFER_TIMEOUT_US	100000	// SPI_AT_XFER_TIMEOUT_MS
+#define SIM_ARM_US			20		// slave task wakes up and arms the DMA
+#define SIM_CMD_US			300		// a command executes
+#define SIM_DATA_US			40		// a DATA frame is handed to the socket
+#define SIM_CMD_MAX			64
+#define SIM_RSP_MAX			3000
+#define SIM_CMDS			200
+#define SIM_STREAM			(1 << 20)	// bytes echoed through con_id 1
+#define SIM_CON_ID			1
+
+static double sim_clock_hz;
+static int sim_error_rate;		// per mille of headers corrupted, each direction
+static int sim_hold_rate;		// per mille of master headers with credit 0
+static double sim_now;			// us
+
+static double sim_clock_us(u32 bytes)
+{
+	return bytes * 8 * 1e6 / sim_clock_hz;
+}
+
+/* command text and response of command id, the response size varies to exercise MORE */
+static u16 sim_cmd(u32 id, u8 *cmd)
+{
+	return (u16)sprintf((char *)cmd, "ATSV=%u", (unsigned)id);
+}
+
+static u16 sim_response(const u8 *cmd, u16 len, u8 *rsp)
+{
+	u32 id = (u32)atoi((const char *)cmd + 5);
+	u16 n = (u16)((id * 397) % SIM_RSP_MAX), i;
+
+	(void)len;
+	for(i = 0; i < n; i++)
+		rsp[i] = (u8)(id + i * 7);
+	return n;
+}
+
+static u8 sim_stream_byte(u32 off)
+{
+	return (u8)((off * 31) ^ (off >> 9));
+}
+
+/**** SLAVE, the link and exec tasks of example_spi_atcmd.c ****/
+
+struct sim_msg {
+	u8 *buf;
+	u16 len;
+	u8 type;
+	u8 seq;
+	double t;		// arrival
+};
+
+struct sim_slave {
+	u8 pool[SIM_RX_DEPTH][SIM_RX_SIZE];
+	u8 *free_buf[SIM_RX_DEPTH];
+	int free_num;
+	struct atframe_rx rx;
+	struct sim_msg q[SIM_RX_DEPTH];
+	int q_num;
+	u8 batch_buf[2][ATSPI_XFER_MAX];
+	struct atspi_batch batch[2];
+	int fill;
+	u8 seq;
+	u8 credit;		// announced in the last header
+	u8 out_seq;
+	u8 rx_batch[ATSPI_XFER_MAX];
+	double armed;	// phase 1 armed at
+	/* exec task, one message at a time */
+	int busy;
+	int stalled;	// waiting for room in the batch
+	double ready;	// output of the current message starts
+	double free;	// exec task idle since
+	u8 out[SIM_RSP_MAX + SIM_DATA_CHUNK];
+	u16 out_len;
+	u16 out_pos;
+	u8 out_type;
+	u8 out_seq_rsp;
+	/* statistics */
+	u32 xfers;
+	u32 resyncs;
+	u32 naks;
+	u32 data_in;
+};
+
+static void sim_slave_init(struct sim_slave *s)
+{
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	for(i = 0; i < SIM_RX_DEPTH; i++)
+		s->free_buf[s->free_num++] = s->pool[i];
+	atspi_batch_reset(&s->batch[0], s->batch_buf[0], ATSPI_XFER_MAX);
+	atspi_batch_reset(&s->batch[1], s->batch_buf[1], ATSPI_XFER_MAX);
+}
+
+static int sim_slave_int(struct sim_slave *s)
+{
+	return s->batch[0].len || s->batch[1].len || ((s->credit == 0) && s->free_num);
+}
+
+/* spi_at_put(), without the wait: 0 if there is no room yet */
+static int sim_slave_put(struct sim_slave *s, u8 type, u8 seq, const u8 *pre, u16 pre_len, const u8 *data, u16 len)
+{
+	struct atspi_batch *batch = &s->batch[s->fill];
+	u16 room;
+	u8 *dst = atspi_batch_room(batch, &room);
+
+	if((dst == NULL) || (room < pre_len + len))
+		return 0;
+	memcpy(dst, pre, pre_len);
+	memcpy(dst + pre_len, data, len);
+	atspi_batch_add(batch, type, seq, (u16)(pre_len + len));
+	return 1;
+}
+
+/* run the exec task up to now */
+static void sim_slave_exec(struct sim_slave *s, double now)
+{
+	struct sim_msg m;
+	u8 con_id = SIM_CON_ID;
+	u16 n;
+	int ok;
+
+	while(1){
+		if(!s->busy){
+			if(s->q_num == 0)
+				return;
+			m = s->q[0];
+			if(m.t > s->free)
+				s->free = m.t;
+			if(s->free > now)
+				return;
+			s->q_num--;
+			memmove(&s->q[0], &s->q[1], s->q_num * sizeof(s->q[0]));
+			s->busy = 1;
+			s->stalled = 0;
+			s->out_pos = 0;
+			s->out_seq_rsp = m.seq;
+			switch(m.type & ATFRAME_TYPE_MASK){
+				case ATFRAME_TYPE_CMD:
+					m.buf[m.len] = 0;
+					s->out_type = ATFRAME_TYPE_RSP;
+					s->out_len = sim_response(m.buf, m.len, s->out);
+					s->ready = s->free + SIM_CMD_US;
+					break;
+				case ATFRAME_TYPE_DATA:
+					/* the peer on con_id echoes the payload */
+					s->out_type = ATFRAME_TYPE_DATA;
+					s->out_len = (u16)(m.len - 1);
+					memcpy(s->out, m.buf + 1, s->out_len);
+					s->data_in += s->out_len;
+					s->ready = s->free + SIM_DATA_US;
+					break;
+				default:
+					/* a NAK of the rx path */
+					s->naks++;
+					s->out_type = ATFRAME_TYPE_NAK;
+					s->out[0] = m.seq;
+					s->out_len = 1;
+					s->ready = s->free;
+					break;
+			}
+			if(m.buf)
+				s->free_buf[s->free_num++] = m.buf;
+		}
+		if(s->ready > now)
+			return;
+
+		/* output as spi_at_rsp_flush()/spi_at_data_send() frames it */
+		do{
+			n = (u16)(s->out_len - s->out_pos);
+			if(s->out_type == ATFRAME_TYPE_RSP){
+				u8 type = ATFRAME_TYPE_RSP;
+				if(n > SIM_RSP_CHUNK){
+					n = SIM_RSP_CHUNK;
+					type |= ATFRAME_FLAG_MORE;
+				}
+				ok = sim_slave_put(s, type, s->out_seq_rsp, NULL, 0, s->out + s->out_pos, n);
+			}
+			else if(s->out_type == ATFRAME_TYPE_DATA){
+				if(n > SIM_DATA_CHUNK)
+					n = SIM_DATA_CHUNK;
+				ok = sim_slave_put(s, ATFRAME_TYPE_DATA, s->out_seq++, &con_id, 1, s->out + s->out_pos, n);
+			}
+			else{
+				ok = sim_slave_put(s, ATFRAME_TYPE_NAK, s->out_seq_rsp, NULL, 0, s->out, n);
+			}
+			if(!ok){
+				s->stalled = 1;
+				return;
+			}
+			s->out_pos = (u16)(s->out_pos + n);
+		}while(s->out_pos < s->out_len);
+
+		s->busy = 0;
+		s->free = s->stalled ? now : s->ready;
+	}
+}
+
+/* when the exec task can go on without a transaction, -1 if it cannot */
+static double sim_slave_next(struct sim_slave *s)
+{
+	if(s->busy)
+		return s->stalled ? -1 : s->ready;
+	if(s->q_num)
+		return (s->q[0].t > s->free ? s->q[0].t : s->free);
+	return -1;
+}
+
+/* spi_at_rx_parse() */
+static void sim_slave_parse(struct sim_slave *s, u16 len, double now)
+{
+	struct sim_msg *m;
+	u8 *data = s->rx_batch, *buf;
+	u32 used;
+	int ret;
+
+	atframe_rx_reset(&s->rx);
+	while(len){
+		if((s->rx.buf == NULL) && s->free_num)
+			atframe_rx_set_buf(&s->rx, s->free_buf[--s->free_num], SIM_RX_SIZE);
+		buf = s->rx.buf;
+		ret = atframe_rx_feed(&s->rx, data, len, &used);
+		data += used;
+		len = (u16)(len - used);
+		if(ret == ATFRAME_RX_MORE)
+			break;
+		if(s->q_num == SIM_RX_DEPTH){
+			if(ret == ATFRAME_RX_FRAME)
+				s->free_buf[s->free_num++] = buf;
+			continue;
+		}
+		m = &s->q[s->q_num++];
+		m->type = (ret == ATFRAME_RX_FRAME) ? s->rx.type : ATFRAME_TYPE_NAK;
+		m->seq = s->rx.seq;
+		m->buf = (ret == ATFRAME_RX_FRAME) ? buf : NULL;
+		m->len = (ret == ATFRAME_RX_FRAME) ? s->rx.len : 0;
+		m->t = now;
+	}
+}
+
+/**** MASTER ****/
+
+struct sim_cmd {
+	u8 cmd[SIM_CMD_MAX];
+	u16 cmd_len;
+	u8 rsp[SIM_RSP_MAX];
+	u16 rsp_len;
+	double sent;
+	int done;
+};
+
+struct sim_master {
+	u8 batch_buf[ATSPI_XFER_MAX];
+	struct atspi_batch batch;
+	u8 rx_batch[ATSPI_XFER_MAX];
+	u8 rx_buf[SIM_RSP_CHUNK + 1 + SIM_DATA_CHUNK + ATFRAME_CRC_LEN];
+	struct atframe_rx rx;
+	int avail;		// frames the slave can still take
+	u8 seq;
+	u32 next_cmd;
+	u32 cmds_done;
+	u32 tx_off;		// stream bytes sent
+	u32 rx_off;		// stream bytes echoed back
+	u8 data_seq;
+	struct sim_cmd cmd[SIM_CMDS];
+	double latency;
+	/* statistics */
+	u32 bad;
+	u32 dropped;
+	u32 held;
+};
+
+static void sim_master_fill(struct sim_master *h)
+{
+	u16 room, n;
+	u8 *dst;
+
+	while(h->avail > (int)h->batch.frames){
+		dst = atspi_batch_room(&h->batch, &room);
+		if(dst == NULL)
+			return;
+		if(h->next_cmd < SIM_CMDS){
+			struct sim_cmd *c = &h->cmd[h->next_cmd];
+			if(room < SIM_CMD_MAX)
+				return;
+			c->cmd_len = sim_cmd(h->next_cmd, c->cmd);
+			memcpy(dst, c->cmd, c->cmd_len);
+			atspi_batch_add(&h->batch, ATFRAME_TYPE_CMD, (u8)h->next_cmd, c->cmd_len);
+			c->sent = sim_now;
+			h->next_cmd++;
+			/* a stream chunk between two commands */
+		}
+		if(h->tx_off < SIM_STREAM){
+			dst = atspi_batch_room(&h->batch, &room);
+			if((dst == NULL) || (room < 2) || (h->avail <= (int)h->batch.frames))
+				return;
+			n = (u16)(room - 1);
+			if(n > SIM_DATA_CHUNK)
+				n = SIM_DATA_CHUNK;
+			if(n > SIM_STREAM - h->tx_off)
+				n = (u16)(SIM_STREAM - h->tx_off);
+			dst[0] = SIM_CON_ID;
+			for(room = 0; room < n; room++)
+				dst[1 + room] = sim_stream_byte(h->tx_off + room);
+			atspi_batch_add(&h->batch, ATFRAME_TYPE_DATA, h->data_seq++, (u16)(n + 1));
+			h->tx_off += n;
+		}
+		else if(h->next_cmd >= SIM_CMDS)
+			return;
+	}
+}
+
+static int sim_master_parse(struct sim_master *h, u16 len)
+{
+	u8 expect[SIM_RSP_MAX];
+	u8 *data = h->rx_batch;
+	struct sim_cmd *c;
+	u32 used;
+	u16 i;
+	int ret;
+
+	atframe_rx_reset(&h->rx);
+	while(len){
+		atframe_rx_set_buf(&h->rx, h->rx_buf, sizeof(h->rx_buf));
+		ret = atframe_rx_feed(&h->rx, data, len, &used);
+		data += used;
+		len = (u16)(len - used);
+		if(ret == ATFRAME_RX_MORE)
+			break;
+		if(ret != ATFRAME_RX_FRAME){
+			printf("FAIL: bad frame from the slave\n");
+			return -1;
+		}
+		switch(h->rx.type & ATFRAME_TYPE_MASK){
+			case ATFRAME_TYPE_RSP:
+				c = &h->cmd[h->cmds_done];
+				if((h->cmds_done >= SIM_CMDS) || (h->rx.seq != (u8)h->cmds_done) || (c->rsp_len + h->rx.len > SIM_RSP_MAX)){
+					printf("FAIL: response seq %u out of order\n", h->rx.seq);
+					return -1;
+				}
+				memcpy(c->rsp + c->rsp_len, h->rx_buf, h->rx.len);
+				c->rsp_len = (u16)(c->rsp_len + h->rx.len);
+				if(h->rx.type & ATFRAME_FLAG_MORE)
+					break;
+				if((sim_response(c->cmd, c->cmd_len, expect) != c->rsp_len) || memcmp(expect, c->rsp, c->rsp_len)){
+					printf("FAIL: response of command %u corrupted\n", (unsigned)h->cmds_done);
+					return -1;
+				}
+				c->done = 1;
+				h->latency += sim_now - c->sent;
+				h->cmds_done++;
+				break;
+			case ATFRAME_TYPE_DATA:
+				if(h->rx_buf[0] != SIM_CON_ID){
+					printf("FAIL: DATA for con_id %u\n", h->rx_buf[0]);
+					return -1;
+				}
+				for(i = 1; i < h->rx.len; i++){
+					if(h->rx_buf[i] != sim_stream_byte(h->rx_off)){
+						printf("FAIL: echoed stream differs at byte %u\n", (unsigned)h->rx_off);
+						return -1;
+					}
+					h->rx_off++;
+				}
+				break;
+			default:
+				printf("FAIL: slave sent frame type %u (NAK reason %u)\n", h->rx.type & ATFRAME_TYPE_MASK, h->rx_buf[0]);
+				return -1;
+		}
+	}
+	return 0;
+}
+
+/**** TRANSACTION ****/
+
+static void sim_corrupt(u8 *hdr)
+{
+	if(sim_error_rate && ((rand() % 1000) < sim_error_rate))
+		hdr[rand() % ATSPI_HDR_LEN] ^= (u8)(1 << (rand() % 8));
+}
+
+static int sim_transaction(struct sim_master *h, struct sim_slave *s)
+{
+	struct atspi_hdr mh, sh, m, sl;
+	u8 m_out[ATSPI_HDR_LEN], s_out[ATSPI_HDR_LEN];
+	struct atspi_batch *tx;
+	u16 n;
+
+	/* slave: the header is built when phase 1 is armed */
+	sim_slave_exec(s, s->armed);
+	tx = &s->batch[s->fill ^ 1];
+	if((tx->len == 0) && s->batch[s->fill].len){
+		s->fill ^= 1;
+		tx = &s->batch[s->fill ^ 1];
+	}
+	sh.flags = s->batch[s->fill].len ? ATSPI_F_MORE : 0;
+	sh.credit = (u8)s->free_num;
+	s->credit = sh.credit;
+	sh.seq = s->seq++;
+	sh.len = tx->len;
+	atspi_hdr_encode(s_out, &sh);
+
+	/* master, on the rising edge of RDY */
+	if(sim_now < s->armed)
+		sim_now = s->armed;
+	sim_slave_exec(s, sim_now);
+	sim_master_fill(h);
+	mh.flags = 0;
+	mh.credit = (sim_hold_rate && ((rand() % 1000) < sim_hold_rate)) ? 0 : 1;
+	h->held += !mh.credit;
+	mh.seq = h->seq++;
+	mh.len = h->batch.len;
+	atspi_hdr_encode(m_out, &mh);
+
+	sim_now += sim_clock_us(ATSPI_HDR_LEN);
+	sim_corrupt(m_out);
+	sim_corrupt(s_out);
+
+	if(atspi_hdr_decode(m_out, &m) < 0){
+		/* slave resynchronizes, the master sees no RDY edge for phase 2 */
+		s->resyncs++;
+		h->dropped++;
+		sim_now += ATSPI_ARM_MS * 1000 + ATSPI_RESYNC_MS * 1000;
+		s->armed = sim_now + SIM_ARM_US;
+		return 0;
+	}
+	if(atspi_hdr_decode(s_out, &sl) < 0){
+		/* the master does not clock phase 2, the slave times out */
+		h->bad++;
+		h->dropped++;
+		s->resyncs++;
+		sim_now += SIM_XFER_TIMEOUT_US + ATSPI_RESYNC_MS * 1000;
+		s->armed = sim_now + SIM_ARM_US;
+		return 0;
+	}
+
+	n = atspi_xfer_len(&m, &sh);
+	if(n != atspi_xfer_len(&mh, &sl)){
+		printf("FAIL: both sides disagree on phase 2\n");
+		return -1;
+	}
+	if(n){
+		sim_now += SIM_ARM_US + sim_clock_us(n);
+		atspi_batch_pad(tx, n);
+		atspi_batch_pad(&h->batch, n);
+		memcpy(s->rx_batch, h->batch.buf, n);
+		memcpy(h->rx_batch, tx->buf, n);
+
+		/* slave side */
+		if(m.credit)
+			atspi_batch_reset(tx, tx->buf, tx->size);
+		sim_slave_parse(s, m.len, sim_now);
+
+		/* master side */
+		h->avail = sl.credit - h->batch.frames;
+		atspi_batch_reset(&h->batch, h->batch_buf, ATSPI_XFER_MAX);
+		if(mh.credit && (sim_master_parse(h, sl.len) < 0))
+			return -1;
+	}
+	else
+		h->avail = sl.credit;
+	s->xfers++;
+	s->armed = sim_now + SIM_ARM_US;
+	return 0;
+}
+
+static int sim_run(double clock_mhz, int error_rate, int hold_rate)
+{
+	static struct sim_slave s;
+	static struct sim_master h;
+	double next;
+	u32 idle = 0;
+
+	sim_clock_hz = clock_mhz * 1e6;
+	sim_error_rate = error_rate;
+	sim_hold_rate = hold_rate;
+	sim_now = 0;
+	srand(1);
+	sim_slave_init(&s);
+	memset(&h, 0, sizeof(h));
+	atspi_batch_reset(&h.batch, h.batch_buf, ATSPI_XFER_MAX);
+
+	while((h.cmds_done < SIM_CMDS) || (h.rx_off < SIM_STREAM)){
+		sim_master_fill(&h);
+		if(!h.batch.len && !sim_slave_int(&s)){
+			/* nothing to clock, wait for the slave to produce output */
+			next = sim_slave_next(&s);
+			if((next < 0) || (++idle > 1000)){
+				printf("FAIL: link stalled, %u of %u commands, %u of %u bytes echoed\n",
+					(unsigned)h.cmds_done, SIM_CMDS, (unsigned)h.rx_off, SIM_STREAM);
+				return 1;
+			}
+			if(next > sim_now)
+				sim_now = next;
+			sim_slave_exec(&s, sim_now);
+			continue;
+		}
+		idle = 0;
+		if(sim_transaction(&h, &s) < 0)
+			return 1;
+	}
+
+	printf("SPI %.1f MHz, header errors %d/1000, master holds %d/1000\n", clock_mhz, error_rate, hold_rate);
+	printf("  %u transactions, %u dropped, %u resyncs, %u held, %.1f ms\n",
+		(unsigned)s.xfers, (unsigned)h.dropped, (unsigned)s.resyncs, (unsigned)h.held, sim_now / 1000);
+	printf("  %u commands, average latency %.0f us\n", SIM_CMDS, h.latency / SIM_CMDS);
+	printf("  %u bytes echoed, %.2f Mbps each way\n", SIM_STREAM, SIM_STREAM * 8 / sim_now);
+	if(s.naks){
+		printf("FAIL: %u NAKs\n", (unsigned)s.naks);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	double clock_mhz = 20;
+	int ret = 0;
+
+	if((argc < 2) || strcmp(argv[1], "-t")){
+		printf("usage: atcmd_spi_sim -t [CLOCK_MHZ [ERROR_RATE]]\n");
+		return 1;
+	}
+	if(argc > 2)
+		clock_mhz = atof(argv[2]);
+	if(argc > 3)
+		return sim_run(clock_mhz, atoi(argv[3]), 0);
+
+	ret |= sim_run(clock_mhz, 0, 0);
+	ret |= sim_run(clock_mhz, 0, 50);
+	ret |= sim_run(clock_mhz, 20, 50);
+	printf(ret ? "FAIL\n" : "PASS\n");
+	return ret;
+}
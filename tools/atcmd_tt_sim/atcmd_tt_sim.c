@@ -0,0 +1,229 @@
+/******************************************************************************
+ *
+ * Host side throughput test of the transparent transmission (TT) receive
+ * path, see readme.txt.
+ *
+ * The UART, its FIFO and RX DMA, the host honouring RTS and the socket are
+ * simulated one byte time at a time. The device side mirrors uart_at_tt_*()
+ * in example_uart_atcmd.c and atcmd_lwip_tt_handler() in atcmd_lwip.c on top
+ * of the same ring, component/common/api/at_cmd/atcmd_tt_ring.c.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atcmd_tt_ring.h"
+
+#define SIM_FIFO			64		// UART RX FIFO
+#define SIM_FIFO_RTS		32		// hardware flow control raises RTS at this level
+#define SIM_FLUSH_US		20000	// ATCMD_LWIP_TT_MAX_DELAY_TIME_MS
+#define SIM_ESCAPE_GAP_US	50000	// host silence before "----"
+
+struct sim_cfg {
+	u32 baud;
+	u32 net_kbps;		// socket drain rate
+	u32 send_us;		// fixed cost of one send()
+	int flow;			// RTS/CTS
+	u16 buf_num;
+	u16 buf_size;
+	u32 bytes;			// payload the host sends
+};
+
+struct sim_dev {
+	struct atcmd_tt_ring ring;
+	u8 fifo[SIM_FIFO];
+	u32 fifo_n;
+	u8 *dma;			// armed buffer, NULL when stalled
+	u32 dma_n;
+	int idle;
+	int rts;			// software RTS, 1 = host may send
+	u32 overruns;
+};
+
+static u8 sim_data(u32 i)
+{
+	return (u8)(i * 7 + (i >> 9) + 1);
+}
+
+static void sim_dev_arm(struct sim_dev *dev)
+{
+	dev->dma = atcmd_tt_ring_fill(&dev->ring);
+	dev->dma_n = 0;
+	if(dev->dma == NULL)
+		dev->rts = 0;
+}
+
+static void sim_dev_commit(struct sim_dev *dev, u16 len)
+{
+	atcmd_tt_ring_commit(&dev->ring, len, dev->idle ? ATCMD_TT_F_IDLE : 0);
+	dev->idle = 0;
+}
+
+/* DMA drains the FIFO, a full buffer completes like uart_at_tt_rx_done() */
+static int sim_dev_dma(struct sim_dev *dev, u16 size)
+{
+	int done = 0;
+
+	while(dev->dma && dev->fifo_n){
+		dev->dma[dev->dma_n++] = dev->fifo[0];
+		memmove(dev->fifo, dev->fifo + 1, --dev->fifo_n);
+		if(dev->dma_n == size){
+			sim_dev_commit(dev, size);
+			sim_dev_arm(dev);
+			done = 1;
+		}
+	}
+	return done;
+}
+
+static int sim_run(struct sim_cfg *cfg)
+{
+	struct sim_dev dev;
+	u8 *mem = malloc((size_t)cfg->buf_num * cfg->buf_size);
+	double byte_us = 10.0 * 1000000.0 / cfg->baud;
+	double t = 0, t_busy = -1, t_wait = 0, t_last_tx = 0, t_first = -1, t_end = 0;
+	u32 sent = 0, esc_sent = 0, got = 0, bad = 0, sends = 0;
+	u16 len = 0;
+	u8 flags, *data;
+	int escaped = 0, sending = 0;
+
+	memset(&dev, 0, sizeof(dev));
+	if(atcmd_tt_ring_init(&dev.ring, mem, cfg->buf_num, cfg->buf_size) < 0){
+		printf("invalid ring %u x %u\n", cfg->buf_num, cfg->buf_size);
+		free(mem);
+		return -1;
+	}
+	dev.idle = 1;
+	dev.rts = 1;
+	sim_dev_arm(&dev);
+
+	while(!escaped && (t < 60000000.0)){
+		/* host */
+		int cts = !cfg->flow || (dev.rts && (dev.fifo_n < SIM_FIFO_RTS));
+		int have = (sent < cfg->bytes) ||
+			((esc_sent < 4) && (esc_sent || (t - t_last_tx >= SIM_ESCAPE_GAP_US)));
+		if(have && cts){
+			u8 c = '-';
+			if(sent < cfg->bytes)
+				c = sim_data(sent++);
+			else
+				esc_sent++;
+			if(t_first < 0)
+				t_first = t;
+			t_last_tx = t;
+			if(dev.fifo_n < SIM_FIFO)
+				dev.fifo[dev.fifo_n++] = c;
+			else
+				dev.overruns++;
+		}
+		if(sim_dev_dma(&dev, cfg->buf_size))
+			t_wait = t;
+
+		/* TT task */
+		if(sending && (t >= t_busy)){
+			sending = 0;
+			atcmd_tt_ring_release(&dev.ring);
+			if(dev.dma == NULL){
+				sim_dev_arm(&dev);
+				if(dev.dma)
+					dev.rts = 1;
+			}
+			t_wait = t;
+		}
+		if(!sending){
+			data = atcmd_tt_ring_peek(&dev.ring, &len, &flags);
+			if(data == NULL){
+				if(t - t_wait >= SIM_FLUSH_US){
+					if(dev.dma){
+						if(dev.dma_n)
+							sim_dev_commit(&dev, (u16)dev.dma_n);
+						dev.idle = 1;
+						sim_dev_arm(&dev);
+					}
+					t_wait = t;
+				}
+			}
+			else if((flags & ATCMD_TT_F_IDLE) && (len >= 4) && (len < cfg->buf_size) && (memcmp(data, "----", 4) == 0)){
+				escaped = 1;
+			}
+			else{
+				u16 i;
+				for(i = 0; i < len; i++, got++){
+					if(data[i] != sim_data(got))
+						bad++;
+				}
+				if(got >= cfg->bytes && t_end == 0)
+					t_end = t;
+				sends++;
+				sending = 1;
+				t_busy = t + cfg->send_us + (double)len * 8000.0 / cfg->net_kbps;
+			}
+		}
+		t += byte_us;
+	}
+
+	if(t_end == 0)
+		t_end = t;
+	printf("%7u baud, net %6u kbps, flow %s, %u x %4u: %7.3f Mbps, %5.1f%% of line, "
+		"%u sends, %u flushes, %u stalls, lost %u, corrupt %u%s\n",
+		cfg->baud, cfg->net_kbps, cfg->flow ? "on " : "off", cfg->buf_num, cfg->buf_size,
+		got * 8.0 / (t_end - t_first),
+		100.0 * got * byte_us / (t_end - t_first),
+		sends, dev.ring.flushes, dev.ring.stalls, cfg->bytes - got, bad,
+		escaped ? "" : ", no escape");
+	free(mem);
+
+	/* nothing may be lost under flow control, and "----" must end TT mode */
+	if(!escaped || bad || (cfg->flow && (got != cfg->bytes || dev.overruns)))
+		return 1;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_cfg cfg = {4000000, 20000, 300, 1, 4, 1460, 1 << 20};
+	static const struct {
+		u32 net_kbps;
+		int flow;
+		u16 buf_num;
+	} matrix[] = {
+		{20000, 1, 4},	// socket faster than the line
+		{20000, 1, 2},
+		{2000, 1, 4},	// socket slower, RTS holds the host off
+		{2000, 1, 2},
+		{2000, 0, 4},	// no flow control: overruns, reported only
+	};
+	unsigned i;
+	int fail = 0;
+
+	if(argc >= 2 && strcmp(argv[1], "-t") == 0){
+		for(i = 0; i < sizeof(matrix) / sizeof(matrix[0]); i++){
+			cfg.net_kbps = matrix[i].net_kbps;
+			cfg.flow = matrix[i].flow;
+			cfg.buf_num = matrix[i].buf_num;
+			if(sim_run(&cfg) && cfg.flow)
+				fail = 1;
+		}
+		printf("%s\n", fail ? "FAIL" : "PASS");
+		return fail;
+	}
+	if(argc >= 3){
+		cfg.baud = (u32)atol(argv[1]);
+		cfg.net_kbps = (u32)atol(argv[2]);
+		if(argc >= 4)
+			cfg.flow = atoi(argv[3]);
+		if(argc >= 5)
+			cfg.buf_num = (u16)atoi(argv[4]);
+		if(argc >= 6)
+			cfg.buf_size = (u16)atoi(argv[5]);
+		if(argc >= 7)
+			cfg.bytes = (u32)atol(argv[6]);
+		if(cfg.baud == 0 || cfg.net_kbps == 0)
+			return 1;
+		return (sim_run(&cfg) < 0) ? 1 : 0;
+	}
+
+	printf("usage: %s -t\n", argv[0]);
+	printf("       %s BAUDRATE NET_KBPS [FLOW] [BUF_NUM] [BUF_SIZE] [BYTES]\n", argv[0]);
+	return 1;
+}
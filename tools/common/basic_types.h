@@ -0,0 +1,16 @@
+#ifndef __BASIC_TYPES_H__
+#define __BASIC_TYPES_H__
+
+/* host build shim for the firmware basic_types.h, shared by the AT command
+ * tools of this directory (-I../common) */
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t		u8;
+typedef uint16_t	u16;
+typedef uint32_t	u32;
+typedef int8_t		s8;
+typedef int16_t		s16;
+typedef int32_t		s32;
+
+#endif //#ifndef __BASIC_TYPES_H__
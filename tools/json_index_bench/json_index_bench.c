@@ -0,0 +1,330 @@
+/******************************************************************************
+ *
+ * Host side check, fuzz test and benchmark of the JSON token index of the
+ * QCloud IoT SDK, see readme.txt.
+ *
+ * Every lookup the data template makes in a control message is made both by
+ * LITE_json_value_of(), scanning the string again for each key, and through
+ * an index built once: both must give the same values. On any bytes, cut or
+ * damaged, the index must stay inside the string and hold together.
+ *
+ ******************************************************************************/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "json_parser.h"
+
+#define FUZZ_PROPS			40
+#define FUZZ_DOC			4096
+#define FUZZ_TOKENS			256
+
+#define BENCH_ROUNDS		100000
+
+/* what json_parser.c and json_token.c take from the platform and the SDK */
+void *HAL_Malloc(uint32_t size)
+{
+	return malloc(size);
+}
+
+void HAL_Free(void *ptr)
+{
+	free(ptr);
+}
+
+int HAL_Snprintf(char *str, const int len, const char *fmt, ...)
+{
+	va_list args;
+	int rc;
+
+	va_start(args, fmt);
+	rc = vsnprintf(str, len, fmt, args);
+	va_end(args);
+	return rc;
+}
+
+void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...)
+{
+	(void)file; (void)func; (void)line; (void)level; (void)fmt;
+}
+
+char *LITE_format_string(const char *fmt, ...)
+{
+	(void)fmt;
+	return NULL;
+}
+
+/* the index must hold together: tokens inside the string, children inside their parent */
+static int index_valid(const JsonIndex *index, int len)
+{
+	const JsonToken *t = index->tokens;
+	int i, j, end, n;
+
+	for (i = 0; i < index->count; i++)
+	{
+		if (t[i].skip < 1 || i + t[i].skip > index->count || t[i].start + t[i].len > len)
+			return 0;
+		if (t[i].type != JSOBJECT && t[i].type != JSARRAY)
+		{
+			if (t[i].skip != 1)
+				return 0;
+			continue;
+		}
+		end = i + t[i].skip;
+		for (j = i + 1, n = 0; j < end; j += t[j].skip, n++)
+		{
+			if (t[j].start < t[i].start || t[j].start + t[j].len > t[i].start + t[i].len)
+				return 0;
+			if (t[i].type == JSOBJECT && (n % 2) == 0 && t[j].type != JSSTRING)
+				return 0;
+		}
+		if (j != end || (t[i].type == JSOBJECT && (n % 2) != 0))
+			return 0;
+	}
+	return 1;
+}
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+	static const char *paths[] = { "method", "params", "params.power_switch", "params.color[1]", "[0]", "a.b[2].c", "" };
+	JsonToken tokens[FUZZ_TOKENS];
+	JsonIndex index;
+	char *doc = malloc(size ? size : 1);	// exactly the bytes, no '\0' after them
+	int i, token, vlen, vtype;
+
+	memcpy(doc, data, size);
+	if (json_index_build(&index, doc, (int)size, tokens, (rand() & 1) ? FUZZ_TOKENS : rand() % 8) >= 0)
+	{
+		if (!index_valid(&index, (int)size))
+			abort();
+		for (i = 0; i < (int)(sizeof(paths) / sizeof(paths[0])); i++)
+		{
+			token = json_index_find(&index, rand() % index.count, paths[i]);
+			if (token >= 0 && json_index_value(&index, token, &vlen, &vtype) == NULL)
+				abort();
+		}
+	}
+	free(doc);
+	return 0;
+}
+
+static const char *fuzz_value(char *buf, int *array_len)
+{
+	*array_len = -1;
+	switch (rand() % 8)
+	{
+	case 0: sprintf(buf, "%d", rand() % 2); break;
+	case 1: sprintf(buf, "%d", rand() - RAND_MAX / 2); break;
+	case 2: sprintf(buf, "%d.%02d", rand() % 1000, rand() % 100); break;
+	case 3: strcpy(buf, (rand() & 1) ? "true" : "false"); break;
+	case 4: sprintf(buf, "\"name %d\"", rand() % 100); break;
+	case 5: sprintf(buf, "\"say \\\"%d\\\"\"", rand() % 100); break;
+	case 6: sprintf(buf, "{\"r\":%d,\"g\":%d,\"b\":\"x\"}", rand() % 256, rand() % 256); break;
+	default:
+		*array_len = rand() % 5;
+		strcpy(buf, "[");
+		for (int i = 0; i < *array_len; i++)
+			sprintf(buf + strlen(buf), "%s%d", i ? "," : "", 100 + i);
+		strcat(buf, "]");
+		break;
+	}
+	return buf;
+}
+
+static int fuzz_fail(const char *what, int k, const char *doc)
+{
+	printf("FAIL: %s, round %d\n%s\n", what, k, doc);
+	return -1;
+}
+
+/* compare the copies of both lookups, NULL included */
+static int same_value(char *a, char *b)
+{
+	int same = (a == NULL) ? (b == NULL) : (b != NULL && !strcmp(a, b));
+
+	HAL_Free(a);
+	HAL_Free(b);
+	return same;
+}
+
+/* a random control message, looked up by both parsers, then cut and damaged */
+static int fuzz_control(int k)
+{
+	static char doc[FUZZ_DOC], params[FUZZ_DOC / 2], value[128], path[64];
+	JsonToken tokens[FUZZ_TOKENS];
+	JsonIndex index, params_index;
+	int props = rand() % FUZZ_PROPS, arrays[FUZZ_PROPS], i, j, len, token;
+	const char *sp = (rand() & 1) ? " " : "";
+	char *v;
+
+	len = sprintf(params, "{");
+	for (i = 0; i < props; i++)
+		len += sprintf(params + len, "%s\"prop_%d\":%s%s", i ? "," : "", i, sp, fuzz_value(value, &arrays[i]));
+	strcat(params, "}");
+	sprintf(doc, "{\"method\":%s\"control\",%s\"clientToken\":\"clientToken-%d\",\"params\":%s}", sp, sp, k, params);
+
+	if (json_index_build(&index, doc, strlen(doc), tokens, FUZZ_TOKENS) < 0 || !index_valid(&index, strlen(doc)))
+		return fuzz_fail("control message not indexed", k, doc);
+	if (!same_value(LITE_json_value_of("method", doc), LITE_json_index_value_of("method", &index)) ||
+		!same_value(LITE_json_value_of("clientToken", doc), LITE_json_index_value_of("clientToken", &index)) ||
+		!same_value(LITE_json_value_of("params", doc), LITE_json_index_value_of("params", &index)) ||
+		!same_value(LITE_json_value_of("absent", doc), LITE_json_index_value_of("absent", &index)))
+		return fuzz_fail("message fields differ", k, doc);
+
+	// as _handle_control() looks each property up in the params
+	json_index_build(&params_index, params, strlen(params), tokens, (rand() % 4) ? FUZZ_TOKENS : rand() % 16);
+	for (i = 0; i <= props; i++)
+	{
+		sprintf(path, "prop_%d", i);
+		if (!same_value(LITE_json_value_of(path, params), LITE_json_index_value_of(path, &params_index)))
+			return fuzz_fail("property differs", k, params);
+	}
+
+	// nested paths and array entries from the whole message
+	json_index_build(&index, doc, strlen(doc), tokens, FUZZ_TOKENS);
+	for (i = 0; i < props; i++)
+	{
+		sprintf(path, "params.prop_%d", i);
+		if (!same_value(LITE_json_value_of(path, doc), LITE_json_index_value_of(path, &index)))
+			return fuzz_fail("nested property differs", k, doc);
+		for (j = 0; j <= arrays[i]; j++)
+		{
+			sprintf(path, "params.prop_%d[%d]", i, j);
+			v = LITE_json_index_value_of(path, &index);
+			sprintf(value, "%d", 100 + j);
+			if (j < arrays[i] ? (v == NULL || strcmp(v, value)) : v != NULL)
+				return fuzz_fail("array entry differs", k, doc);
+			HAL_Free(v);
+		}
+	}
+	token = json_index_find(&index, 0, "params");
+	if (token < 0 || json_index_find(&index, token, "prop_0") != json_index_find(&index, 0, "params.prop_0"))
+		return fuzz_fail("lookup from a token differs", k, doc);
+
+	// what a socket may leave in the buffer: cut short and a few bytes changed
+	len = strlen(doc);
+	len = (rand() & 1) ? rand() % (len + 1) : len;
+	for (i = rand() % 4; i > 0 && len > 0; i--)
+		doc[rand() % len] = "{}[]\",:\\ 0t"[rand() % 11];
+	LLVMFuzzerTestOneInput((unsigned char *)doc, len);
+	return 0;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* the lookups of _on_template_downstream_topic_handler() and _handle_control() for one control message */
+static void control_former(char *doc, int props)
+{
+	char key[24], *params;
+	int i;
+
+	HAL_Free(LITE_json_value_of("method", doc));
+	HAL_Free(LITE_json_value_of("clientToken", doc));
+	params = LITE_json_value_of("params", doc);
+	for (i = 0; i < props; i++)
+	{
+		sprintf(key, "prop_%d", i);
+		HAL_Free(LITE_json_value_of(key, params));
+	}
+	HAL_Free(params);
+}
+
+static void control_indexed(char *doc, int props)
+{
+	static JsonToken tokens[64], params_tokens[64];
+	JsonIndex index, params_index;
+	char key[24], *params;
+	int i;
+
+	json_index_build(&index, doc, strlen(doc), tokens, 64);
+	HAL_Free(LITE_json_index_value_of("method", &index));
+	HAL_Free(LITE_json_index_value_of("clientToken", &index));
+	params = LITE_json_index_value_of("params", &index);
+	json_index_build(&params_index, params, strlen(params), params_tokens, 64);
+	for (i = 0; i < props; i++)
+	{
+		sprintf(key, "prop_%d", i);
+		HAL_Free(LITE_json_index_value_of(key, &params_index));
+	}
+	HAL_Free(params);
+}
+
+static void bench(void)
+{
+	static const int sizes[] = { 4, 8, 16, 30 };
+	static char doc[FUZZ_DOC];
+	double t0, former, indexed;
+	int s, i, len, props;
+
+	printf("per control message, %d rounds: method, clientToken, params, then each property\n", BENCH_ROUNDS);
+	for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+	{
+		props = sizes[s];
+		len = sprintf(doc, "{\"method\":\"control\",\"clientToken\":\"clientToken-Xx9Lr7TyF\",\"params\":{");
+		for (i = 0; i < props; i++)
+		{
+			switch (i % 4)
+			{
+			case 0: len += sprintf(doc + len, "%s\"prop_%d\":1", i ? "," : "", i); break;
+			case 1: len += sprintf(doc + len, ",\"prop_%d\":%d", i, 20 + i); break;
+			case 2: len += sprintf(doc + len, ",\"prop_%d\":36.5", i); break;
+			default: len += sprintf(doc + len, ",\"prop_%d\":\"warm white\"", i); break;
+			}
+		}
+		strcat(doc, "}}");
+
+		t0 = bench_now();
+		for (i = 0; i < BENCH_ROUNDS; i++)
+			control_former(doc, props);
+		former = (bench_now() - t0) / BENCH_ROUNDS;
+		t0 = bench_now();
+		for (i = 0; i < BENCH_ROUNDS; i++)
+			control_indexed(doc, props);
+		indexed = (bench_now() - t0) / BENCH_ROUNDS;
+		printf("  %2d properties, %4d bytes: LITE_json_value_of %8.1f ns, index %8.1f ns\n",
+			props, (int)strlen(doc), former, indexed);
+	}
+}
+
+#if !defined(JSON_INDEX_LIBFUZZER)
+int main(int argc, char **argv)
+{
+	int count = 100000, k;
+
+	if (argc < 2)
+	{
+		bench();
+		return 0;
+	}
+	if (strcmp(argv[1], "-t"))
+	{
+		printf("usage: json_index_bench [-t [COUNT]]\n");
+		return 1;
+	}
+	if (argc > 2)
+		count = (int)strtoul(argv[2], NULL, 0);
+	srand(1);
+
+	for (k = 0; k < count; k++)
+	{
+		unsigned char bytes[32];
+		int i, n = rand() % 32;
+
+		if (fuzz_control(k) < 0)
+			return 1;
+		for (i = 0; i < n; i++)
+			bytes[i] = "{}[]\",:\\ 0-.etrufalsn"[rand() % 22];
+		LLVMFuzzerTestOneInput(bytes, n);
+	}
+	printf("control messages %d, the same values as LITE_json_value_of, cut and damaged copies indexed in bounds\n", count);
+	printf("PASS\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,265 @@
+/******************************************************************************
+ *
+ * Host side fuzz test of the log service line helpers, see readme.txt.
+ *
+ * The in place tokenizer is checked against the parse_param() it replaced
+ * (kept below, working on a copy as it did), for memory safety on any input
+ * and for quoted parameters coming back exactly as they were escaped. The
+ * history ring is checked against a plain list of the latest lines.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log_line.h"
+
+#define FUZZ_ARGC			12		// MAX_ARGC
+#define FUZZ_LINE			100		// LOG_SERVICE_BUFLEN of the example project
+#define FUZZ_GUARD			16
+#define FUZZ_HIST_SIZE		64
+#define FUZZ_HIST_MAX		64
+
+static const char fuzz_chars[] = "ab1 =,,[]\"\"\\";
+
+static void fuzz_line(char *line, int max)
+{
+	int len = rand() % max, i;
+
+	for(i = 0; i < len; i++)
+		line[i] = fuzz_chars[rand() % (sizeof(fuzz_chars) - 1)];
+	line[len] = '\0';
+}
+
+/* the former parse_param(), argv sized for the ",," overrun it had */
+static int legacy_parse_param(char *buf, char **argv)
+{
+	int argc = 1;
+	char str_buf[FUZZ_LINE * 2];
+	int str_count = 0;
+	int buf_cnt = 0;
+	static char temp_buf[FUZZ_LINE * 2];
+	char *buf_pos = temp_buf;
+	memset(str_buf, 0, sizeof(str_buf));
+	memset(temp_buf, 0, sizeof(temp_buf));
+
+	if(buf == NULL)
+		goto exit;
+	strcpy(temp_buf, buf);
+
+	while((argc < FUZZ_ARGC) && (*buf_pos != '\0')) {
+		while((*buf_pos == ',') || (*buf_pos == '[') || (*buf_pos == ']')){
+			if((*buf_pos == ',') && (*(buf_pos+1) == ',')){
+				argv[argc] = NULL;
+				argc++;
+			}
+			*buf_pos = '\0';
+			buf_pos++;
+		}
+
+		if(*buf_pos == '\0')
+			break;
+		else if(*buf_pos == '"'){
+			memset(str_buf,'\0',sizeof(str_buf));
+			str_count = 0;
+			buf_cnt = 0;
+			*buf_pos = '\0';
+			buf_pos ++;
+			if(*buf_pos == '\0')
+				break;
+			argv[argc] = buf_pos;
+			while((*buf_pos != '"')&&(*buf_pos != '\0')){
+				if(*buf_pos == '\\'){
+					buf_pos ++;
+					buf_cnt++;
+				}
+				str_buf[str_count] = *buf_pos;
+				str_count++;
+				buf_cnt++;
+				buf_pos ++;
+			}
+			*buf_pos = '\0';
+			memcpy(buf_pos-buf_cnt,str_buf,buf_cnt);
+		}
+		else{
+			argv[argc] = buf_pos;
+		}
+		argc++;
+		buf_pos++;
+
+		while( (*buf_pos != ',')&&(*buf_pos != '\0')&&(*buf_pos != '[')&&(*buf_pos != ']') )
+			buf_pos++;
+	}
+exit:
+	return argc;
+}
+
+static int fuzz_tokenize(const char *line, u32 *compared)
+{
+	char mem[FUZZ_GUARD + FUZZ_LINE + FUZZ_GUARD];
+	char *buf = mem + FUZZ_GUARD;
+	char *argv[FUZZ_ARGC], *largv[FUZZ_ARGC * 2];
+	int len = (int)strlen(line), argc, largc, i;
+
+	memset(mem, 0x5A, sizeof(mem));
+	memcpy(buf, line, len + 1);
+	argc = log_line_tokenize(buf, argv, FUZZ_ARGC);
+
+	for(i = 0; i < FUZZ_GUARD; i++){
+		if((mem[i] != 0x5A) || (buf[len + 1 + i] != 0x5A)){
+			printf("FAIL: write outside the line \"%s\"\n", line);
+			return -1;
+		}
+	}
+	if((argc < 1) || (argc > FUZZ_ARGC)){
+		printf("FAIL: argc %d for \"%s\"\n", argc, line);
+		return -1;
+	}
+	for(i = 1; i < argc; i++){
+		if(argv[i] && ((argv[i] < buf) || (argv[i] > buf + len) || (memchr(argv[i], '\0', buf + len + 1 - argv[i]) == NULL))){
+			printf("FAIL: argv[%d] outside the line \"%s\"\n", i, line);
+			return -1;
+		}
+	}
+
+	/*
+	 * Same result as before, except where the old code was undefined: the
+	 * parameter cap reached (it overran argv on ",," and left the last one
+	 * unterminated) or a '\' ending the line inside quotes.
+	 */
+	if(len && (line[len - 1] == '\\'))
+		return 0;
+	largc = legacy_parse_param((char *)line, largv);
+	if(largc >= FUZZ_ARGC)
+		return 0;
+	if(largc != argc){
+		printf("FAIL: argc %d, was %d for \"%s\"\n", argc, largc, line);
+		return -1;
+	}
+	for(i = 1; i < argc; i++){
+		if((!argv[i] != !largv[i]) || (argv[i] && strcmp(argv[i], largv[i]))){
+			printf("FAIL: argv[%d] \"%s\", was \"%s\" for \"%s\"\n", i,
+				argv[i] ? argv[i] : "NULL", largv[i] ? largv[i] : "NULL", line);
+			return -1;
+		}
+	}
+	(*compared)++;
+	return 0;
+}
+
+/* quoted parameters with '"', '\' and separators in them come back as they were */
+static int fuzz_quoted(void)
+{
+	char param[4][16], line[FUZZ_LINE], *argv[FUZZ_ARGC];
+	int n = 1 + rand() % 4, len = 0, argc, i, j;
+
+	for(i = 0; i < n; i++){
+		fuzz_line(param[i], 8);
+		if(i)
+			line[len++] = ',';
+		line[len++] = '"';
+		for(j = 0; param[i][j]; j++){
+			if((param[i][j] == '"') || (param[i][j] == '\\'))
+				line[len++] = '\\';
+			line[len++] = param[i][j];
+		}
+		line[len++] = '"';
+	}
+	line[len] = '\0';
+
+	argc = log_line_tokenize(line, argv, FUZZ_ARGC);
+	if(argc != n + 1){
+		printf("FAIL: %d quoted parameters, got %d\n", n, argc - 1);
+		return -1;
+	}
+	for(i = 0; i < n; i++){
+		if(strcmp(argv[i + 1], param[i])){
+			printf("FAIL: quoted \"%s\" came back as \"%s\"\n", param[i], argv[i + 1]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* the ring against the latest lines whose bytes fit */
+static int fuzz_history(u32 count)
+{
+	char ring[FUZZ_HIST_SIZE], line[FUZZ_HIST_SIZE + 8], out[FUZZ_HIST_SIZE + 8];
+	static char model[FUZZ_HIST_MAX][FUZZ_HIST_SIZE + 8];
+	struct log_history h;
+	int n = 0, used = 0, len, i, out_size;
+	u32 k;
+
+	log_history_init(&h, ring, sizeof(ring));
+	for(k = 0; k < count; k++){
+		len = rand() % (FUZZ_HIST_SIZE + 4);
+		for(i = 0; i < len; i++)
+			line[i] = (char)('a' + rand() % 3);
+		line[len] = '\0';
+		if(rand() % 4 == 0 && n)
+			strcpy(line, model[n - 1]);
+		len = (int)strlen(line);
+
+		if(log_history_add(&h, line) < 0){
+			if(len && (len + 1 <= FUZZ_HIST_SIZE)){
+				printf("FAIL: history refused a line of %d\n", len);
+				return -1;
+			}
+		}
+		else if(!n || strcmp(model[n - 1], line)){
+			strcpy(model[n++], line);
+			used += len + 1;
+			while(used > FUZZ_HIST_SIZE){
+				used -= (int)strlen(model[0]) + 1;
+				memmove(model[0], model[1], (n - 1) * sizeof(model[0]));
+				n--;
+			}
+		}
+
+		if(h.count != n){
+			printf("FAIL: history holds %u lines, expected %d\n", h.count, n);
+			return -1;
+		}
+		for(i = 0; i < n; i++){
+			out_size = 1 + rand() % (FUZZ_HIST_SIZE + 2);
+			len = log_history_get(&h, (u16)i, out, (u16)out_size);
+			if((len != (int)strnlen(model[n - 1 - i], out_size - 1)) || strncmp(out, model[n - 1 - i], len) || out[len]){
+				printf("FAIL: history line %d\n", i);
+				return -1;
+			}
+		}
+		if(log_history_get(&h, (u16)n, out, sizeof(out)) != -1){
+			printf("FAIL: history line past the oldest\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char line[FUZZ_LINE];
+	u32 count = 200000, compared = 0, k;
+
+	if((argc < 2) || strcmp(argv[1], "-t")){
+		printf("usage: log_line_fuzz -t [COUNT]\n");
+		return 1;
+	}
+	if(argc > 2)
+		count = (u32)strtoul(argv[2], NULL, 0);
+	srand(1);
+
+	for(k = 0; k < count; k++){
+		fuzz_line(line, FUZZ_LINE);
+		if(fuzz_tokenize(line, &compared) < 0)
+			return 1;
+		if(fuzz_quoted() < 0)
+			return 1;
+	}
+	if(fuzz_history(count) < 0)
+		return 1;
+
+	printf("lines %u, %u compared with the former parse_param, history adds %u\n",
+		(unsigned)count, (unsigned)compared, (unsigned)count);
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,494 @@
+/******************************************************************************
+ *
+ * Host side check and benchmark of the MQTT outbound queue, see readme.txt.
+ *
+ * The queue runs on a simulated NOR flash: erase sets a sector to 0xff, a
+ * write can only clear bits, and a power cut stops the writes after a given
+ * number of bytes. A client is played against it, publishing, sending
+ * within an in-flight window, acking and rebooting, and what the queue gives
+ * back is checked against a model of what it must hold.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "MQTTQueue.h"
+
+#define SIM_SECTOR			1024
+#define SIM_SECTORS			8
+#define CHECK_WINDOW		4
+#define CHECK_PAYLOAD		300
+#define MODEL_MAX			4096
+#define ID_TORN				-1
+
+struct sim_flash {
+	unsigned char mem[SIM_SECTOR * SIM_SECTORS];
+	long budget;			// bytes written before the power cut, < 0 for none
+	int cut;
+	int errors;
+	unsigned long erases, written;
+};
+
+static int sim_read(void *ctx, unsigned int offset, unsigned char *buf, unsigned int len)
+{
+	struct sim_flash *f = ctx;
+
+	if(f->cut)
+		return -1;
+	memcpy(buf, f->mem + offset, len);
+	return 0;
+}
+
+static int sim_write(void *ctx, unsigned int offset, const unsigned char *buf, unsigned int len)
+{
+	struct sim_flash *f = ctx;
+	unsigned int i;
+
+	if(f->cut)
+		return -1;
+	if(offset + len > sizeof(f->mem)){
+		printf("write of %u at %u outside the flash\n", len, offset);
+		f->errors++;
+		return -1;
+	}
+	for(i = 0; i < len; i++){
+		if(f->budget == 0){
+			f->cut = 1;
+			return -1;
+		}
+		if(f->budget > 0)
+			f->budget--;
+		if((f->mem[offset + i] & buf[i]) != buf[i]){
+			printf("write at %u sets bits of 0x%02x to 0x%02x\n", offset + i, f->mem[offset + i], buf[i]);
+			f->errors++;
+		}
+		f->mem[offset + i] &= buf[i];
+	}
+	f->written += len;
+	return 0;
+}
+
+static int sim_erase(void *ctx, unsigned int offset)
+{
+	struct sim_flash *f = ctx;
+
+	if(f->cut)
+		return -1;
+	if(offset % SIM_SECTOR){
+		printf("erase at %u, not a sector\n", offset);
+		f->errors++;
+		return -1;
+	}
+	memset(f->mem + offset, 0xff, SIM_SECTOR);
+	f->erases++;
+	return 0;
+}
+
+static void sim_backend(MQTTQueueFlash *b, struct sim_flash *f)
+{
+	b->read = sim_read;
+	b->write = sim_write;
+	b->erase = sim_erase;
+	b->ctx = f;
+	b->size = sizeof(f->mem);
+	b->sector = SIM_SECTOR;
+}
+
+/* a message is known by its serial, its topic and payload follow from it */
+static void make_message(int k, char *topic, unsigned char *payload, int *len, int *qos)
+{
+	int i;
+
+	sprintf(topic, "dev/%d/t%d", k % 7, k % 3);
+	*len = (k * 37) % CHECK_PAYLOAD;
+	for(i = 0; i < *len; i++)
+		payload[i] = (unsigned char)(k * 31 + i);
+	if(*len >= 4)
+		memcpy(payload, &k, 4);
+	*qos = k % 5 ? 1 : 0;
+}
+
+struct model {
+	int k[MODEL_MAX];
+	int id[MODEL_MAX];					// persisted packet id, 0 if never sent, ID_TORN if cut short
+	int inflight[MODEL_MAX];			// sent in this boot
+	int n;
+};
+
+static void model_remove(struct model *m, int i)
+{
+	memmove(&m->k[i], &m->k[i + 1], (m->n - i - 1) * sizeof(m->k[0]));
+	memmove(&m->id[i], &m->id[i + 1], (m->n - i - 1) * sizeof(m->id[0]));
+	memmove(&m->inflight[i], &m->inflight[i + 1], (m->n - i - 1) * sizeof(m->inflight[0]));
+	m->n--;
+}
+
+static unsigned short next_id = 1;
+
+static unsigned short fresh_id(struct model *m)
+{
+	int i;
+
+again:
+	next_id = (next_id >= 0xff00) ? 1 : next_id + 1;	// a torn id reads 0xffxx
+	for(i = 0; i < m->n; i++)
+		if(m->id[i] == next_id)
+			goto again;
+	return next_id;
+}
+
+/*
+ * Exact check: with MQTT_QUEUE_DROP_NEWEST and no power cut, or with the
+ * flash only, the queue holds the model's messages in order.
+ */
+static int check_exact(int rounds, int ram_size, int use_flash, int cuts)
+{
+	static struct sim_flash f;
+	static struct model m;
+	static unsigned char ram[8192];
+	MQTTQueueFlash b;
+	MQTTQueue q;
+	MQTTQueueEntry e;
+	char topic[64], rtopic[64];
+	unsigned char payload[CHECK_PAYLOAD], rpayload[CHECK_PAYLOAD];
+	int r, i, k = 0, len, qos, inflight, errors = 0, reboots = 0, full = 0;
+
+	memset(&f, 0xff, sizeof(f.mem));
+	f.budget = -1;
+	f.cut = f.errors = 0;
+	sim_backend(&b, &f);
+	memset(&m, 0, sizeof(m));
+	MQTTQueue_init(&q, ram_size ? ram : NULL, ram_size, use_flash ? &b : NULL, MQTT_QUEUE_DROP_NEWEST);
+
+	for(r = 0; r < rounds && !errors; r++){
+		int op = rand() % 100;
+
+		for(i = 0, inflight = 0; i < m.n; i++)
+			inflight += m.inflight[i];
+
+		if(op < 40){
+			make_message(k, topic, payload, &len, &qos);
+			if(MQTTQueue_push(&q, topic, qos, 0, payload, len) == 0){
+				if(m.n == MODEL_MAX){
+					printf("model full\n");
+					errors++;
+					break;
+				}
+				m.k[m.n] = k;
+				m.id[m.n] = 0;
+				m.inflight[m.n] = 0;
+				m.n++;
+			}
+			else if(!f.cut)
+				full++;
+			k++;
+		}
+		else if(op < 75 && inflight < CHECK_WINDOW){
+			unsigned short id;
+
+			for(i = 0; i < m.n && m.inflight[i]; i++)
+				;
+			if(MQTTQueue_next(&q, &e) != 0){
+				if(i < m.n && !f.cut){
+					printf("round %d: no next, expected message %d\n", r, m.k[i]);
+					errors++;
+				}
+				goto cut;
+			}
+			if(i == m.n){
+				printf("round %d: next gives seq %u, nothing expected\n", r, e.seq);
+				errors++;
+				break;
+			}
+			make_message(m.k[i], topic, payload, &len, &qos);
+			if(MQTTQueue_read(&q, &e, rtopic, rpayload) != 0){
+				if(!f.cut){
+					printf("round %d: read failed\n", r);
+					errors++;
+				}
+				goto cut;
+			}
+			if(strcmp(topic, rtopic) || e.payloadlen != len || memcmp(payload, rpayload, len) || e.qos != qos ||
+				(e.id != m.id[i] && m.id[i] != ID_TORN)){
+				printf("round %d: message %d: topic %s payload %d qos %d id %d, expected %s %d %d %d\n", r, m.k[i],
+					rtopic, e.payloadlen, e.qos, e.id, topic, len, qos, m.id[i]);
+				errors++;
+				break;
+			}
+			if(m.id[i] == ID_TORN)
+				m.id[i] = e.id;
+			id = e.id ? e.id : fresh_id(&m);
+			if(MQTTQueue_sent(&q, &e, qos ? id : 0) == 0){
+				if(qos == 0)
+					model_remove(&m, i);
+				else{
+					m.id[i] = id;
+					m.inflight[i] = 1;
+				}
+			}
+			else if(!f.cut){
+				printf("round %d: sent failed\n", r);
+				errors++;
+			}
+			else{
+				if(qos && !e.id)
+					m.id[i] = ID_TORN;
+				m.inflight[i] = 1;	// skipped in this boot
+			}
+		}
+		else if(op < 95 && inflight > 0){
+			int pick = rand() % inflight;
+
+			for(i = 0; i < m.n; i++)
+				if(m.inflight[i] && pick-- == 0)
+					break;
+			if(MQTTQueue_done(&q, m.id[i]) == 0)
+				model_remove(&m, i);
+			else if(!f.cut){
+				printf("round %d: done of id %d failed\n", r, m.id[i]);
+				errors++;
+			}
+		}
+		else if(op >= 95 && use_flash && !ram_size){
+			if(cuts && !f.cut && f.budget < 0 && rand() % 2)
+				f.budget = rand() % 600;	// the power goes within the next writes
+			else
+				goto reboot;
+		}
+cut:
+		if(f.cut){
+reboot:
+			f.cut = 0;
+			f.budget = -1;
+			for(i = 0; i < m.n; i++)
+				m.inflight[i] = 0;
+			MQTTQueue_init(&q, NULL, 0, &b, MQTT_QUEUE_DROP_NEWEST);
+			reboots++;
+		}
+		if(MQTTQueue_count(&q) != m.n && !f.cut){
+			printf("round %d: queue holds %d, expected %d\n", r, MQTTQueue_count(&q), m.n);
+			errors++;
+		}
+		errors += f.errors;
+		f.errors = 0;
+	}
+	printf("%-26s %7d rounds, %6d messages, %5d full, %5d reboots: %s\n",
+		ram_size ? (use_flash ? "RAM ring, flash spill" : "RAM ring") : (cuts ? "flash, power cuts" : "flash"),
+		r, k, full, reboots, errors ? "FAIL" : "PASS");
+	return errors;
+}
+
+/*
+ * MQTT_QUEUE_DROP_OLDEST: nothing refused, messages sent in order, each
+ * one acked, kept or counted dropped.
+ */
+static int check_drop_oldest(int rounds, int ram_size, int use_flash)
+{
+	static struct sim_flash f;
+	static unsigned char ram[8192];
+	unsigned short ids[CHECK_WINDOW];
+	MQTTQueueFlash b;
+	MQTTQueue q;
+	MQTTQueueEntry e;
+	char topic[64];
+	unsigned char payload[CHECK_PAYLOAD];
+	int r, k = 0, len, qos, n = 0, acked = 0, last = -1, errors = 0, serial;
+
+	memset(&f, 0xff, sizeof(f.mem));
+	f.budget = -1;
+	f.cut = f.errors = 0;
+	sim_backend(&b, &f);
+	MQTTQueue_init(&q, ram_size ? ram : NULL, ram_size, use_flash ? &b : NULL, MQTT_QUEUE_DROP_OLDEST);
+
+	for(r = 0; r < rounds && !errors; r++){
+		int op = rand() % 100;
+
+		if(op < 60){
+			make_message(k, topic, payload, &len, &qos);
+			if(MQTTQueue_push(&q, topic, qos, 0, payload, len) != 0){
+				printf("round %d: message %d refused\n", r, k);
+				errors++;
+			}
+			k++;
+		}
+		else if(op < 80 && n < CHECK_WINDOW && MQTTQueue_next(&q, &e) == 0){
+			char rtopic[64];
+
+			MQTTQueue_read(&q, &e, rtopic, payload);
+			serial = (e.payloadlen >= 4) ? *(int *)payload : -1;
+			if(serial >= 0 && serial <= last){
+				printf("round %d: message %d after %d\n", r, serial, last);
+				errors++;
+			}
+			if(serial >= 0)
+				last = serial;
+			if(e.qos == 0){
+				MQTTQueue_sent(&q, &e, 0);
+				acked++;
+			}
+			else{
+				next_id = (next_id == 65535) ? 1 : next_id + 1;	// far more ids than the window
+				ids[n] = next_id;
+				MQTTQueue_sent(&q, &e, ids[n]);
+				n++;
+			}
+		}
+		else if(n > 0){
+			int i = rand() % n;
+
+			if(MQTTQueue_done(&q, ids[i]) == 0)
+				acked++;	// else dropped while in flight
+			ids[i] = ids[--n];
+		}
+		if(MQTTQueue_count(&q) + acked + q.dropped != k){
+			printf("round %d: %d kept, %d acked, %d dropped of %d\n", r, MQTTQueue_count(&q), acked, q.dropped, k);
+			errors++;
+		}
+		errors += f.errors;
+		f.errors = 0;
+	}
+	printf("%-26s %7d rounds, %6d messages, %5d dropped: %s\n",
+		use_flash ? (ram_size ? "drop oldest, RAM and flash" : "drop oldest, flash") : "drop oldest, RAM ring",
+		r, k, q.dropped, errors ? "FAIL" : "PASS");
+	return errors;
+}
+
+/*
+ * MQTT_QUEUE_DROP_OLDEST offline: the messages kept are the newest ones, in
+ * order, and one larger than a sector is refused with nothing dropped.
+ */
+static int check_drop_order(int ram_size)
+{
+	static struct sim_flash f;
+	static unsigned char ram[8192], big[1500];
+	MQTTQueueFlash b;
+	MQTTQueue q;
+	MQTTQueueEntry e;
+	char topic[64];
+	unsigned char payload[CHECK_PAYLOAD];
+	int k, n, serial, errors = 0;
+
+	memset(&f, 0xff, sizeof(f.mem));
+	f.budget = -1;
+	f.cut = f.errors = 0;
+	sim_backend(&b, &f);
+	MQTTQueue_init(&q, ram_size ? ram : NULL, ram_size, &b, MQTT_QUEUE_DROP_OLDEST);
+
+	for(k = 0; k < 10; k++){
+		memcpy(payload, &k, 4);
+		MQTTQueue_push(&q, "t", 1, 0, payload, 60);
+	}
+	if(MQTTQueue_push(&q, "t", 1, 0, big, sizeof(big)) == 0 || MQTTQueue_count(&q) != 10 || q.dropped != 0){
+		printf("message of %d bytes: %d kept, %d dropped\n", (int)sizeof(big), MQTTQueue_count(&q), q.dropped);
+		errors++;
+	}
+
+	for(; k < 1000; k++){
+		memcpy(payload, &k, 4);
+		if(MQTTQueue_push(&q, "t", 1, 0, payload, 60) != 0){
+			printf("message %d refused\n", k);
+			errors++;
+		}
+	}
+	for(n = 0; MQTTQueue_next(&q, &e) == 0; n++){
+		MQTTQueue_read(&q, &e, topic, payload);
+		memcpy(&serial, payload, 4);
+		if(serial != q.dropped + n){
+			printf("message %d kept at %d, expected %d\n", serial, n, q.dropped + n);
+			errors++;
+			break;
+		}
+		MQTTQueue_sent(&q, &e, (unsigned short)(n + 1));
+	}
+	if(q.dropped + n != k){
+		printf("%d kept and %d dropped of %d\n", n, q.dropped, k);
+		errors++;
+	}
+	errors += f.errors;
+	printf("%-26s %7d messages, %6d kept, the newest: %s\n",
+		ram_size ? "drop order, RAM and flash" : "drop order, flash", k, n, errors ? "FAIL" : "PASS");
+	return errors;
+}
+
+static int check(int rounds)
+{
+	int errors = 0;
+
+	errors += check_exact(rounds, 4096, 0, 0);
+	errors += check_exact(rounds, 0, 1, 0);
+	errors += check_exact(rounds, 1024, 1, 0);
+	errors += check_exact(rounds, 0, 1, 1);
+	errors += check_drop_oldest(rounds, 4096, 0);
+	errors += check_drop_oldest(rounds, 0, 1);
+	errors += check_drop_oldest(rounds, 1024, 1);
+	errors += check_drop_order(0);
+	errors += check_drop_order(2048);
+	return errors ? 1 : 0;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* a burst queued while offline, then replayed through the window */
+static void bench(const char *name, int ram_size, int use_flash, int burst, int payload_len)
+{
+	static struct sim_flash f;
+	static unsigned char ram[16384];
+	unsigned char payload[CHECK_PAYLOAD], rpayload[CHECK_PAYLOAD];
+	char topic[64];
+	MQTTQueueFlash b;
+	MQTTQueue q;
+	MQTTQueueEntry e;
+	double t0, t_push, t_replay;
+	int i, queued = 0, sent = 0;
+
+	memset(&f, 0xff, sizeof(f.mem));
+	f.budget = -1;
+	f.cut = 0;
+	f.erases = f.written = 0;
+	sim_backend(&b, &f);
+	MQTTQueue_init(&q, ram_size ? ram : NULL, ram_size, use_flash ? &b : NULL, MQTT_QUEUE_DROP_OLDEST);
+	memset(payload, 'x', sizeof(payload));
+
+	t0 = now_ns();
+	for(i = 0; i < burst; i++)
+		queued += MQTTQueue_push(&q, "sensor/PRODUCT01/dev0001/telemetry", 1, 0, payload, payload_len) == 0;
+	t_push = now_ns() - t0;
+
+	t0 = now_ns();
+	while(MQTTQueue_next(&q, &e) == 0){
+		MQTTQueue_read(&q, &e, topic, rpayload);
+		MQTTQueue_sent(&q, &e, (unsigned short)(sent % 65535 + 1));
+		MQTTQueue_done(&q, (unsigned short)(sent % 65535 + 1));		// acked at once
+		sent++;
+	}
+	t_replay = now_ns() - t0;
+
+	printf("%-22s %4d x %3d bytes: push %5.0f ns  replay %5.0f ns  per message, %3d replayed, %5.1f flash bytes and %4.2f erases a message\n",
+		name, burst, payload_len, t_push / burst, sent ? t_replay / sent : 0, sent,
+		queued ? (double)f.written / queued : 0, queued ? (double)f.erases / queued : 0);
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = 200000;
+
+	srand(1);
+	if((argc >= 2) && (strcmp(argv[1], "-t") == 0)){
+		if(argc >= 3)
+			rounds = atoi(argv[2]);
+		return check(rounds);
+	}
+
+	bench("RAM ring", 16384, 0, 100, 64);
+	bench("flash", 0, 1, 100, 64);
+	bench("RAM ring, flash spill", 4096, 1, 100, 64);
+	bench("flash", 0, 1, 100, 256);
+	return 0;
+}
@@ -0,0 +1,309 @@
+/******************************************************************************
+ *
+ * Host side check and benchmark of the MQTT subscription index, see
+ * readme.txt.
+ *
+ * The trie is checked against a plain MQTT 3.1.1 matcher run over a list of
+ * the same filters, through random adds and removes. The benchmark times a
+ * PUBLISH dispatch over a gateway's subscriptions, with the trie and with the
+ * linear scan of MQTTClient's deliverMessage() it replaced.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "MQTTTopicTrie.h"
+
+#define CHECK_FILTERS		200
+#define CHECK_LEVELS		5
+#define CHECK_WIDE			1000
+#define BENCH_TOPIC			128
+
+static const char *check_levels[] = {"a", "b", "cc", "", "$s", "+", "#"};
+
+/* MQTT 3.1.1 section 4.7, one level at a time */
+static int ref_match(const char *filter, const char *topic, int len)
+{
+	const char *end = topic + len, *f = filter, *t = topic;
+	int flen, tlen;
+
+	if((len > 0) && (topic[0] == '$') && ((filter[0] == '+') || (filter[0] == '#')))
+		return 0;
+	while(1){
+		flen = strcspn(f, "/");
+		for(tlen = 0; (t + tlen < end) && (t[tlen] != '/'); tlen++)
+			;
+		if((flen == 1) && (f[0] == '#'))
+			return 1;
+		if(!((flen == 1) && (f[0] == '+')) && ((flen != tlen) || memcmp(f, t, flen)))
+			return 0;
+		if(f[flen] == '\0')
+			return t + tlen == end;
+		if(t + tlen == end)
+			return strcmp(f + flen, "/#") == 0;	// "a/#" matches "a"
+		f += flen + 1;
+		t += tlen + 1;
+	}
+}
+
+/* the linear match of MQTTClient before the trie */
+static char legacy_isTopicMatched(const char *topicFilter, const char *topic, int len)
+{
+	const char *curf = topicFilter;
+	const char *curn = topic;
+	const char *curn_end = curn + len;
+
+	while (*curf && curn < curn_end)
+	{
+		if (*curn == '/' && *curf != '/')
+			break;
+		if (*curf != '+' && *curf != '#' && *curf != *curn)
+			break;
+		if (*curf == '+')
+		{
+			const char *nextpos = curn + 1;
+			while (nextpos < curn_end && *nextpos != '/')
+				nextpos = ++curn + 1;
+		}
+		else if (*curf == '#')
+			curn = curn_end - 1;
+		curf++;
+		curn++;
+	};
+
+	return (curn == curn_end) && (*curf == '\0');
+}
+
+static int legacy_deliver(char **filters, int num, const char *topic, int len)
+{
+	int i, n = 0;
+
+	for(i = 0; i < num; i++)
+		if(((strlen(filters[i]) == (size_t)len) && (memcmp(filters[i], topic, len) == 0)) ||
+			legacy_isTopicMatched(filters[i], topic, len))
+			n++;
+	return n;
+}
+
+static void random_topic(char *buf, int wild)
+{
+	int n = 1 + rand() % CHECK_LEVELS, i, k;
+	int choices = wild ? 7 : 5;
+
+	buf[0] = '\0';
+	for(i = 0; i < n; i++){
+		k = rand() % choices;
+		if((check_levels[k][0] == '$') && (i > 0))
+			k = 0;
+		if(i)
+			strcat(buf, "/");
+		strcat(buf, check_levels[k]);
+		if(check_levels[k][0] == '#')
+			break;
+	}
+}
+
+struct check_visit {
+	int seen[CHECK_FILTERS];
+};
+
+static int check_visit(void *value, void *arg)
+{
+	struct check_visit *cv = arg;
+
+	cv->seen[(int)(long)value]++;
+	return 0;
+}
+
+static int check(int rounds)
+{
+	static char filters[CHECK_FILTERS][64];
+	static int used[CHECK_FILTERS];
+	struct check_visit cv;
+	MQTTTopicTrie t;
+	char topic[64];
+	int r, i, k, n, expect, len, errors = 0;
+
+	MQTTTopicTrie_init(&t);
+	memset(used, 0, sizeof(used));
+	for(r = 0; r < rounds; r++){
+		/* churn: add a free slot or remove a used one */
+		k = rand() % CHECK_FILTERS;
+		if(used[k]){
+			if(MQTTTopicTrie_remove(&t, filters[k], (void *)(long)k) != 0){
+				printf("remove %s failed\n", filters[k]);
+				errors++;
+			}
+			used[k] = 0;
+		}
+		else{
+			do
+				random_topic(filters[k], 1);
+			while(filters[k][0] == '\0');
+			if(MQTTTopicTrie_add(&t, filters[k], (void *)(long)k) != 0){
+				printf("add %s failed\n", filters[k]);
+				errors++;
+			}
+			else
+				used[k] = 1;
+		}
+
+		do
+			random_topic(topic, 0);	// a topic name is one character at least
+		while((len = strlen(topic)) == 0);
+		memset(&cv, 0, sizeof(cv));
+		n = MQTTTopicTrie_match(&t, topic, len, check_visit, &cv);
+		for(i = 0, expect = 0; i < CHECK_FILTERS; i++){
+			int want = used[i] && ref_match(filters[i], topic, len);
+
+			expect += want;
+			if(cv.seen[i] != want){
+				printf("topic %s filter %s: visited %d, expected %d\n", topic, filters[i], cv.seen[i], want);
+				errors++;
+			}
+		}
+		if(n != expect){
+			printf("topic %s: %d matches, expected %d\n", topic, n, expect);
+			errors++;
+		}
+		for(i = 0, expect = 0; i < CHECK_FILTERS; i++)
+			expect += used[i];
+		if((t.count != expect) || (MQTTTopicTrie_foreach(&t, NULL, NULL) != expect)){
+			printf("count %d, foreach %d, expected %d\n", t.count, MQTTTopicTrie_foreach(&t, NULL, NULL), expect);
+			errors++;
+		}
+		if(errors)
+			break;
+	}
+
+	/* a wide level, hashed once it has many children and back to a list */
+	MQTTTopicTrie_clear(&t, NULL, NULL);
+	for(i = 0; i < CHECK_WIDE; i++){
+		snprintf(topic, sizeof(topic), "w/dev%d", i);
+		MQTTTopicTrie_add(&t, topic, (void *)(long)i);
+	}
+	MQTTTopicTrie_add(&t, "w/+", (void *)(long)-1);
+	for(k = CHECK_WIDE; k > 0; k /= 2){
+		for(i = 0; i < CHECK_WIDE; i++){
+			snprintf(topic, sizeof(topic), "w/dev%d", i);
+			n = MQTTTopicTrie_match(&t, topic, strlen(topic), NULL, NULL);
+			if(n != ((i < k) ? 2 : 1)){
+				printf("wide level of %d, %s: %d matches\n", k, topic, n);
+				errors++;
+			}
+		}
+		for(i = k / 2; i < k; i++){
+			snprintf(topic, sizeof(topic), "w/dev%d", i);
+			MQTTTopicTrie_remove(&t, topic, (void *)(long)i);
+		}
+	}
+	if(MQTTTopicTrie_remove(&t, "w/+", (void *)(long)-1) != 0 || t.root != NULL){
+		printf("wide level not freed\n");
+		errors++;
+	}
+
+	/* malformed filters are refused */
+	if((MQTTTopicTrie_add(&t, "a/#/b", NULL) == 0) || (MQTTTopicTrie_add(&t, "a+/b", NULL) == 0) ||
+		(MQTTTopicTrie_add(&t, "a/b#", NULL) == 0) || (MQTTTopicTrie_add(&t, "", NULL) == 0)){
+		printf("malformed filter accepted\n");
+		errors++;
+	}
+
+	MQTTTopicTrie_clear(&t, NULL, NULL);
+	if(t.root != NULL){
+		printf("clear left nodes\n");
+		errors++;
+	}
+	printf("%d rounds, %s\n", r, errors ? "FAIL" : "PASS");
+	return errors ? 1 : 0;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int bench_count(void *value, void *arg)
+{
+	( void ) value;
+	(*(int *)arg)++;
+	return 0;
+}
+
+/*
+ * A gateway proxying subs sub-devices: for each one the property, action and
+ * event topics of the QCloud data template, plus the gateway's own topics
+ * with a wildcard.
+ */
+static void bench(int subs, int dispatches)
+{
+	int num = subs * 3 + 2, i, k, sum_trie = 0, sum_legacy = 0, len;
+	char **filters = malloc(num * sizeof(char *));
+	char (*topics)[BENCH_TOPIC] = malloc(num * BENCH_TOPIC);
+	MQTTTopicTrie t;
+	double t0, t_trie, t_legacy;
+
+	MQTTTopicTrie_init(&t);
+	for(i = 0; i < subs; i++){
+		static const char *kind[] = {"property", "action", "event"};
+
+		for(k = 0; k < 3; k++){
+			filters[i * 3 + k] = malloc(BENCH_TOPIC);
+			snprintf(filters[i * 3 + k], BENCH_TOPIC, "$thing/down/%s/PRODUCT01/dev%04d", kind[k], i);
+			strcpy(topics[i * 3 + k], filters[i * 3 + k]);
+		}
+	}
+	filters[num - 2] = strdup("$gateway/operation/result/PRODUCT01");
+	strcpy(topics[num - 2], filters[num - 2]);
+	filters[num - 1] = strdup("PRODUCT01/GW/data/+");
+	strcpy(topics[num - 1], "PRODUCT01/GW/data/temperature");
+	for(i = 0; i < num; i++)
+		MQTTTopicTrie_add(&t, filters[i], filters[i]);
+
+	t0 = now_ns();
+	for(i = 0; i < dispatches; i++){
+		k = (i * 7919) % num;
+		MQTTTopicTrie_match(&t, topics[k], strlen(topics[k]), bench_count, &sum_trie);
+	}
+	t_trie = now_ns() - t0;
+
+	t0 = now_ns();
+	for(i = 0; i < dispatches; i++){
+		k = (i * 7919) % num;
+		len = strlen(topics[k]);
+		sum_legacy += legacy_deliver(filters, num, topics[k], len);
+	}
+	t_legacy = now_ns() - t0;
+
+	printf("%6d subscriptions  trie %8.0f ns  linear %9.0f ns  per PUBLISH%s\n", num,
+		t_trie / dispatches, t_legacy / dispatches, (sum_trie == sum_legacy) ? "" : "  (match counts differ)");
+
+	MQTTTopicTrie_clear(&t, NULL, NULL);
+	for(i = 0; i < num; i++)
+		free(filters[i]);
+	free(filters);
+	free(topics);
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = 200000;
+
+	srand(1);
+	if((argc >= 2) && (strcmp(argv[1], "-t") == 0)){
+		if(argc >= 3)
+			rounds = atoi(argv[2]);
+		return check(rounds);
+	}
+
+	bench(3, 200000);
+	bench(33, 100000);
+	bench(166, 20000);
+	bench(333, 10000);
+	bench(1000, 5000);
+	return 0;
+}
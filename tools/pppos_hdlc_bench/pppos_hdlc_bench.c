@@ -0,0 +1,408 @@
+/******************************************************************************
+ *
+ * Host side check and benchmark of the PPPoS HDLC framing, see readme.txt.
+ *
+ * pppos.c is linked twice (see Makefile): with PPPOS_HDLC_FAST, escaping and
+ * checksumming runs of plain bytes a word at a time, and with the per-byte
+ * code as pppos_byte_create/pppos_byte_input. Two links of two peers each
+ * carry the same IPv4 datagrams: link 0 from a fast sender to a per-byte
+ * receiver, link 1 the other way round. Both senders must put the same bytes
+ * on the wire, and both receivers must hand the datagram to UDP unchanged.
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lwip/init.h"
+#include "lwip/udp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+#include "netif/ppp/pppos.h"
+#include "netif/ppp/ppp_impl.h"
+
+#define WIRE_SIZE		8192
+#define DGRAM_MAX		1500		// the default PPP MTU
+#define DGRAM_HDR		(IP_HLEN + UDP_HLEN)
+#define BENCH_PORT		5000
+
+#define BENCH_FRAMES	20000
+
+/* pppos.c built without PPPOS_HDLC_FAST */
+ppp_pcb *pppos_byte_create(struct netif *pppif, pppos_output_cb_fn output_cb,
+		ppp_link_status_cb_fn link_status_cb, void *ctx_cb);
+void pppos_byte_input(ppp_pcb *ppp, u8_t *s, int l);
+/* its PCB pool, left out of ppp_init() */
+LWIP_MEMPOOL_PROTOTYPE(PPPOS_BYTE_PCB);
+
+struct peer
+{
+	struct netif netif;
+	ppp_pcb *pcb;
+	int fast;
+	u8_t wire[WIRE_SIZE];		// sent, not yet given to the other end
+	u32_t wire_len;
+};
+
+/* link l: peers[2 * l] sends, peers[2 * l + 1] receives */
+static struct peer peers[4];
+
+static const u8_t *rx_expect;
+static u16_t rx_expect_len;
+static int rx_count, rx_bad;
+
+u32_t sys_now(void)
+{
+	// frozen: no idle flag before a frame, on either sender
+	return 0;
+}
+
+u32_t sys_jiffies(void)
+{
+	return 0;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static u32_t peer_output(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx)
+{
+	struct peer *p = (struct peer *)ctx;
+	LWIP_UNUSED_ARG(pcb);
+
+	if (p->wire_len + len > WIRE_SIZE)
+		return 0;
+	memcpy(&p->wire[p->wire_len], data, len);
+	p->wire_len += len;
+	return len;
+}
+
+static void peer_status(ppp_pcb *pcb, int err_code, void *ctx)
+{
+	LWIP_UNUSED_ARG(pcb);
+	LWIP_UNUSED_ARG(err_code);
+	LWIP_UNUSED_ARG(ctx);
+}
+
+static void peer_input(struct peer *p, u8_t *s, int l)
+{
+	if (p->fast)
+		pppos_input(p->pcb, s, l);
+	else
+		pppos_byte_input(p->pcb, s, l);
+}
+
+/* Gives what from sent to its peer, in odd sized chunks at odd offsets so
+ * the word-at-a-time input sees every alignment */
+static void peer_pump(struct peer *from, struct peer *to, u32_t seed)
+{
+	static u8_t buf[WIRE_SIZE + 3];
+	u8_t *data = buf + (seed & 3);
+	u32_t len = from->wire_len, off = 0, chunk = seed % 61 + 1;
+
+	memcpy(data, from->wire, len);
+	from->wire_len = 0;
+	while (off < len)
+	{
+		u32_t n = LWIP_MIN(chunk, len - off);
+
+		peer_input(to, data + off, (int)n);
+		off += n;
+		chunk = (chunk * 7 + 3) % 61 + 1;
+	}
+}
+
+static void udp_received(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+	static u8_t data[DGRAM_MAX];
+	LWIP_UNUSED_ARG(arg);
+	LWIP_UNUSED_ARG(pcb);
+	LWIP_UNUSED_ARG(addr);
+	LWIP_UNUSED_ARG(port);
+
+	rx_count++;
+	if (rx_expect != NULL && (p->tot_len != rx_expect_len ||
+			pbuf_copy_partial(p, data, p->tot_len, 0) != rx_expect_len ||
+			memcmp(data, rx_expect, rx_expect_len)))
+		rx_bad++;
+	pbuf_free(p);
+}
+
+static int links_up(void)
+{
+	ip4_addr_t addr;
+	struct udp_pcb *rx;
+	int i, round;
+
+	lwip_init();
+	LWIP_MEMPOOL_INIT(PPPOS_BYTE_PCB);
+	for (i = 0; i < 4; i++)
+	{
+		struct peer *p = &peers[i];
+
+		p->fast = (i == 0 || i == 3);
+		p->pcb = p->fast ? pppos_create(&p->netif, peer_output, peer_status, p) :
+			pppos_byte_create(&p->netif, peer_output, peer_status, p);
+		if (p->pcb == NULL)
+			return -1;
+		// the same addresses on both links, so both carry the same bytes
+		IP4_ADDR(&addr, 10, 0, 0, 1 + (i & 1));
+		ppp_set_ipcp_ouraddr(p->pcb, &addr);
+		if (ppp_connect(p->pcb, 0) != ERR_OK)
+			return -1;
+	}
+	for (round = 0; round < 100; round++)
+	{
+		for (i = 0; i < 4; i++)
+			peer_pump(&peers[i], &peers[i ^ 1], (u32_t)(round + i));
+	}
+	for (i = 0; i < 4; i++)
+	{
+		if (peers[i].pcb->phase != PPP_PHASE_RUNNING || peers[i].wire_len)
+			return -1;
+	}
+
+	rx = udp_new();
+	if (rx == NULL || udp_bind(rx, IP_ADDR_ANY, BENCH_PORT) != ERR_OK)
+		return -1;
+	udp_recv(rx, udp_received, NULL);
+	return 0;
+}
+
+/* The ACCM and compression both ends of link l agreed on */
+static void link_config(int l, u32_t accm, int pcomp, int accomp)
+{
+	ppp_pcb *tx = peers[2 * l].pcb, *rx = peers[2 * l + 1].pcb;
+
+	tx->link_cb->send_config(tx, tx->link_ctx_cb, accm, pcomp, accomp);
+	rx->link_cb->recv_config(rx, rx->link_ctx_cb, accm, pcomp, accomp);
+}
+
+/* An IPv4 UDP datagram from peer 10.0.0.1 to 10.0.0.2, without UDP checksum */
+static u16_t make_datagram(u8_t *buf, const u8_t *data, u16_t len)
+{
+	struct ip_hdr *iph = (struct ip_hdr *)buf;
+	struct udp_hdr *udph = (struct udp_hdr *)(buf + IP_HLEN);
+
+	memset(buf, 0, DGRAM_HDR);
+	IPH_VHL_SET(iph, 4, IP_HLEN / 4);
+	IPH_LEN_SET(iph, lwip_htons(DGRAM_HDR + len));
+	IPH_ID_SET(iph, lwip_htons(len));
+	IPH_TTL_SET(iph, 64);
+	IPH_PROTO_SET(iph, IP_PROTO_UDP);
+	IP4_ADDR(&iph->src, 10, 0, 0, 1);
+	IP4_ADDR(&iph->dest, 10, 0, 0, 2);
+	IPH_CHKSUM_SET(iph, inet_chksum(iph, IP_HLEN));
+	udph->src = lwip_htons(BENCH_PORT);
+	udph->dest = lwip_htons(BENCH_PORT);
+	udph->len = lwip_htons(UDP_HLEN + len);
+	memcpy(buf + DGRAM_HDR, data, len);
+	return (u16_t)(DGRAM_HDR + len);
+}
+
+/* text: printable ASCII, binary: any byte, special: mostly bytes to escape */
+static void make_payload(u8_t *data, u16_t len, int kind)
+{
+	static const u8_t special[] = { PPP_FLAG, PPP_ESCAPE, 0x00, 0x11, 0x13, 0x1f };
+	u16_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		if (kind == 0)
+			data[i] = (u8_t)(0x20 + rand() % 95);
+		else if (kind == 1 || rand() % 4 == 0)
+			data[i] = (u8_t)rand();
+		else
+			data[i] = special[rand() % sizeof(special)];
+	}
+}
+
+/* The datagram in up to 4 pbufs, at any alignment */
+static struct pbuf *make_chain(u8_t *buf, u16_t len)
+{
+	struct pbuf *head = NULL, *p;
+	u16_t off = 0, n;
+	int pieces = 1 + rand() % 4;
+
+	while (pieces--)
+	{
+		n = pieces ? (u16_t)(rand() % (len - off + 1)) : (u16_t)(len - off);
+		p = pbuf_alloc(PBUF_RAW, n, PBUF_REF);
+		if (p == NULL)
+			break;
+		p->payload = buf + off;
+		off += n;
+		if (head == NULL)
+			head = p;
+		else
+			pbuf_cat(head, p);
+	}
+	return head;
+}
+
+static int check(int count)
+{
+	static u8_t payload[DGRAM_MAX], dgram[DGRAM_MAX], copy[DGRAM_MAX + 3];
+	u32_t accm;
+	u16_t len, dlen;
+	int k, l, pcomp, accomp, kind;
+
+	for (k = 0; k < count; k++)
+	{
+		switch (rand() % 4)
+		{
+		case 0: accm = 0; break;
+		case 1: accm = 0xffffffff; break;
+		default: accm = (u32_t)rand() ^ ((u32_t)rand() << 16); break;
+		}
+		pcomp = rand() & 1;
+		accomp = rand() & 1;
+		kind = rand() % 3;
+		len = (u16_t)(rand() % (DGRAM_MAX - DGRAM_HDR + 1));
+		make_payload(payload, len, kind);
+		dlen = make_datagram(dgram, payload, len);
+
+		for (l = 0; l < 2; l++)
+		{
+			struct pbuf *p;
+			u8_t *src = copy + rand() % 4;
+
+			link_config(l, accm, pcomp, accomp);
+			memcpy(src, dgram, dlen);
+			p = make_chain(src, dlen);
+			if (p == NULL || peers[2 * l].pcb->link_cb->netif_output(peers[2 * l].pcb,
+					peers[2 * l].pcb->link_ctx_cb, p, PPP_IP) != ERR_OK)
+			{
+				printf("round %d: link %d could not send\n", k, l);
+				return -1;
+			}
+			pbuf_free(p);
+		}
+		if (peers[0].wire_len != peers[2].wire_len || memcmp(peers[0].wire, peers[2].wire, peers[0].wire_len))
+		{
+			printf("round %d: %u bytes, ACCM %08lx, pcomp %d, accomp %d: the fast sender wrote %lu bytes, per byte %lu\n",
+					k, len, (unsigned long)accm, pcomp, accomp,
+					(unsigned long)peers[0].wire_len, (unsigned long)peers[2].wire_len);
+			return -1;
+		}
+
+		rx_expect = payload;
+		rx_expect_len = len;
+		rx_count = rx_bad = 0;
+		peer_pump(&peers[0], &peers[1], (u32_t)rand());
+		peer_pump(&peers[2], &peers[3], (u32_t)rand());
+		if (rx_count != 2 || rx_bad)
+		{
+			printf("round %d: %u bytes, ACCM %08lx, pcomp %d, accomp %d: %d datagrams received, %d changed\n",
+					k, len, (unsigned long)accm, pcomp, accomp, rx_count, rx_bad);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Time per 1500 byte frame written by tx, and read by rx up to UDP */
+static void bench_frame(const char *name, struct peer *tx, struct peer *rx, struct pbuf *p, int rx_shift)
+{
+	static u8_t frame[WIRE_SIZE + 3];
+	u8_t *in = frame + rx_shift;
+	u32_t len;
+	double t0, out_ns, in_ns;
+	int i;
+
+	t0 = bench_now();
+	for (i = 0; i < BENCH_FRAMES; i++)
+	{
+		tx->wire_len = 0;
+		tx->pcb->link_cb->netif_output(tx->pcb, tx->pcb->link_ctx_cb, p, PPP_IP);
+	}
+	out_ns = (bench_now() - t0) / BENCH_FRAMES;
+
+	len = tx->wire_len;
+	memcpy(in, tx->wire, len);
+	tx->wire_len = 0;
+	rx_count = 0;
+	t0 = bench_now();
+	for (i = 0; i < BENCH_FRAMES; i++)
+		peer_input(rx, in, (int)len);
+	in_ns = (bench_now() - t0) / BENCH_FRAMES;
+
+	printf("  %-9s %5lu bytes  output %8.0f ns %7.1f MB/s   input %8.0f ns %7.1f MB/s%s\n",
+			name, (unsigned long)len, out_ns, len * 1e3 / out_ns, in_ns, len * 1e3 / in_ns,
+			rx_count == BENCH_FRAMES ? "" : "  (frames lost)");
+}
+
+static void bench(void)
+{
+	static const struct
+	{
+		const char *name;
+		int kind;
+		u32_t accm;
+	} cases[] = {
+		{ "text", 0, 0 },
+		{ "binary", 1, 0 },
+		{ "text", 0, 0xffffffff },
+		{ "binary", 1, 0xffffffff },
+	};
+	static u8_t payload[DGRAM_MAX], dgram[DGRAM_MAX + 3];
+	struct pbuf *p;
+	u16_t dlen;
+	unsigned c;
+
+	rx_expect = NULL;
+	for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		make_payload(payload, DGRAM_MAX - DGRAM_HDR, cases[c].kind);
+		dlen = make_datagram(dgram, payload, DGRAM_MAX - DGRAM_HDR);
+		p = pbuf_alloc(PBUF_RAW, dlen, PBUF_REF);
+		if (p == NULL)
+			return;
+		p->payload = dgram;
+		link_config(0, cases[c].accm, 1, 1);
+		link_config(1, cases[c].accm, 1, 1);
+
+		printf("%s payload, ACCM %08lx, frames of a %u byte datagram:\n",
+				cases[c].name, (unsigned long)cases[c].accm, dlen);
+		bench_frame("per byte", &peers[2], &peers[1], p, 0);
+		bench_frame("fast", &peers[0], &peers[3], p, 0);
+		bench_frame("fast +1", &peers[0], &peers[3], p, 1);
+		pbuf_free(p);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int count = 20000;
+
+	if (argc > 1 && strcmp(argv[1], "-t"))
+	{
+		printf("usage: pppos_hdlc_bench [-t [COUNT]]\n");
+		return 1;
+	}
+	srand(1);
+	if (links_up() < 0)
+	{
+		printf("PPP links did not come up\n");
+		return 1;
+	}
+
+	if (argc < 2)
+	{
+		bench();
+		return 0;
+	}
+	if (argc > 2)
+		count = (int)strtoul(argv[2], NULL, 0);
+	if (check(count) < 0)
+		return 1;
+	printf("datagrams %d, same frames from the fast and the per-byte sender, received unchanged by both\n", count);
+	printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,24 @@
+/* lwIP options of the PPPoS HDLC benchmark, see ../readme.txt.
+ * PPPOS_HDLC_FAST is left to the makefile: pppos.c is built both ways. */
+#ifndef PPPOS_HDLC_BENCH_LWIPOPTS_H
+#define PPPOS_HDLC_BENCH_LWIPOPTS_H
+
+#define NO_SYS				1
+#define SYS_LIGHTWEIGHT_PROT		0
+#define MEM_ALIGNMENT			8		/* host pointers */
+#define LWIP_NETCONN			0
+#define LWIP_SOCKET			0
+#define LWIP_TCP			0
+#define LWIP_ARP			0
+#define LWIP_ETHERNET			0
+
+#define MEM_SIZE			16000
+#define PBUF_POOL_SIZE			64
+
+/* two links of two peers, one side with the per-byte HDLC code */
+#define PPP_SUPPORT			1
+#define PPPOS_SUPPORT			1
+#define MEMP_NUM_PPP_PCB		4
+#define VJ_SUPPORT			0
+
+#endif
@@ -0,0 +1,516 @@
+/******************************************************************************
+ *
+ * Host side check of the reactor of the QCloud IoT SDK, see readme.txt.
+ *
+ * The reactor runs against a simulated ms clock, sockets and clients. A model
+ * keeps the due time of every client and timer: each must be called exactly
+ * when due, at most once in a run, never with the reactor lock held, and a
+ * client that exits or is removed must be detached once and never called
+ * again.
+ *
+ ******************************************************************************/
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mqtt_client.h"
+#include "qcloud_iot_export_reactor.h"
+
+#define SIM_FD(i)			(100 + (i))
+#define SIM_WAIT_MS			REACTOR_MAX_WAIT_MS
+#define SIM_MAX_DUE_MS		60000		// REACTOR_MAX_DUE_MS
+#define SIM_POLL_MS			200			// REACTOR_POLL_MS
+
+typedef struct {
+	int attached;
+	int gone;			// exited or removed, to be detached
+	int detached;
+	int exit_code;		// expected in the detached callback
+	int slot;			// its index in the reactor, the first free one when added
+	int fd;				// -1 for a client without a socket to wait on
+	int conn;
+	size_t pending;		// bytes decrypted already
+	int ready;			// to be yielded for its socket in this run
+	int fired;			// yielded as due in this run
+	uint32_t due;
+	uint32_t next;
+} SimClient;
+
+typedef struct {
+	int active;
+	int fired;
+	uint32_t due;
+	uint32_t period;
+} SimTimer;
+
+static Qcloud_IoT_Client sim_mqtt[REACTOR_MAX_CLIENTS];
+static SimClient sim_client[REACTOR_MAX_CLIENTS];
+static SimTimer sim_timer[REACTOR_MAX_TIMERS];
+static int sim_slot[REACTOR_MAX_CLIENTS];	// client in each slot of the reactor, -1 for none
+static void *sim_reactor;
+static uint32_t sim_now, sim_link_up_count;
+static int sim_locked, sim_round, sim_failed;
+static int sim_closed;			// the next wait fails, a socket closed
+
+static void sim_fail(const char *what, int id)
+{
+	if (!sim_failed)
+		printf("round %d, id %d, now %u: %s\n", sim_round, id, (unsigned)sim_now, what);
+	sim_failed = 1;
+}
+
+/* what qcloud_iot_reactor.c takes from the platform and the rest of the SDK */
+void *HAL_Malloc(uint32_t size)
+{
+	return malloc(size);
+}
+
+void HAL_Free(void *ptr)
+{
+	free(ptr);
+}
+
+void *HAL_MutexCreate(void)
+{
+	static int lock;
+
+	return &lock;
+}
+
+void HAL_MutexDestroy(void *mutex)
+{
+	(void)mutex;
+}
+
+void HAL_MutexLock(void *mutex)
+{
+	(void)mutex;
+	if (sim_locked)
+		sim_fail("reactor lock taken twice", -1);
+	sim_locked = 1;
+}
+
+void HAL_MutexUnlock(void *mutex)
+{
+	(void)mutex;
+	if (!sim_locked)
+		sim_fail("reactor lock released but not held", -1);
+	sim_locked = 0;
+}
+
+uint32_t HAL_GetTimeMs(void)
+{
+	return sim_now;
+}
+
+void HAL_SleepMs(uint32_t ms)
+{
+	sim_now += ms;
+}
+
+int HAL_ThreadCreate(ThreadParams *params)
+{
+	(void)params;
+	return -1;
+}
+
+bool HAL_Network_Link_Up(uint32_t *up_count)
+{
+	if (up_count != NULL)
+		*up_count = sim_link_up_count;
+	return true;
+}
+
+void IOT_Log_Gen(const char *file, const char *func, const int line, const int level, const char *fmt, ...)
+{
+	(void)file; (void)func; (void)line; (void)level; (void)fmt;
+}
+
+static int sim_id(Qcloud_IoT_Client *mqtt)
+{
+	int i = (int)(mqtt - sim_mqtt);
+
+	if (i < 0 || i >= REACTOR_MAX_CLIENTS)
+	{
+		sim_fail("unknown MQTT client", i);
+		exit(1);
+	}
+	return i;
+}
+
+uint8_t get_client_conn_state(Qcloud_IoT_Client *pClient)
+{
+	return (uint8_t)sim_client[sim_id(pClient)].conn;
+}
+
+int network_get_socket(Network *pNetwork, size_t *pending)
+{
+	SimClient *s = &sim_client[sim_id((Qcloud_IoT_Client *)((char *)pNetwork - offsetof(Qcloud_IoT_Client, network_stack)))];
+
+	*pending = s->pending;
+	return s->fd;
+}
+
+uint32_t qcloud_iot_mqtt_next_event_ms(Qcloud_IoT_Client *pClient)
+{
+	return sim_client[sim_id(pClient)].next;
+}
+
+/* due times of what is attached, compared as distances as the clock wraps */
+static uint32_t model_wait(uint32_t timeout_ms)
+{
+	uint32_t wait = timeout_ms, left;
+	int i;
+
+	for (i = 0; i < REACTOR_MAX_CLIENTS; i++)
+	{
+		if (!sim_client[i].attached || sim_client[i].gone)
+			continue;
+		if (sim_client[i].pending)
+			return 0;
+		left = ((int32_t)(sim_client[i].due - sim_now) > 0) ? sim_client[i].due - sim_now : 0;
+		wait = (left < wait) ? left : wait;
+	}
+	for (i = 0; i < REACTOR_MAX_TIMERS; i++)
+	{
+		if (!sim_timer[i].active)
+			continue;
+		left = ((int32_t)(sim_timer[i].due - sim_now) > 0) ? sim_timer[i].due - sim_now : 0;
+		wait = (left < wait) ? left : wait;
+	}
+	return wait;
+}
+
+static uint32_t sim_expected_wait;
+
+int HAL_Socket_Wait_Readable(const int *sockets, int count, uint32_t timeout_ms, uint32_t *readable)
+{
+	int i;
+
+	if (sim_locked)
+		sim_fail("waiting with the reactor lock held", -1);
+	if (count != REACTOR_MAX_CLIENTS)
+		sim_fail("socket count", count);
+	if (timeout_ms != sim_expected_wait)
+		sim_fail("wait is not the time to the next due one", (int)timeout_ms);
+
+	*readable = 0;
+	for (i = 0; i < count; i++)
+	{
+		SimClient *s = (sim_slot[i] >= 0) ? &sim_client[sim_slot[i]] : NULL;
+		int fd = (s != NULL && !s->gone) ? s->fd : -1;
+
+		if (sockets[i] != fd)
+			sim_fail("socket not of the client in its slot", i);
+		if (s != NULL && s->pending)
+			s->ready = 1;
+	}
+
+	if (sim_closed)
+	{
+		sim_closed = 0;
+		for (i = 0; i < count; i++)
+			if (sockets[i] >= 0)
+				sim_client[sim_slot[i]].ready = 1;
+		return -1;
+	}
+
+	// something comes in before the time is up, or nothing
+	if (timeout_ms > 0 && (rand() % 4) == 0)
+	{
+		sim_now += rand() % timeout_ms;
+		for (i = 0; i < count; i++)
+		{
+			if (sockets[i] >= 0 && (rand() % 3) == 0)
+			{
+				*readable |= 1u << i;
+				sim_client[sim_slot[i]].ready = 1;
+			}
+		}
+		return (*readable != 0) ? 1 : 0;
+	}
+	sim_now += timeout_ms;
+	return 0;
+}
+
+static int client_yield(void *handle, uint32_t timeout_ms)
+{
+	SimClient *s = (SimClient *)handle;
+	int i = (int)(s - sim_client);
+
+	(void)timeout_ms;
+	if (sim_locked)
+		sim_fail("client yielded with the reactor lock held", i);
+	if (!s->attached || s->gone)
+		sim_fail("client yielded after it was removed", i);
+	if (s->ready)
+	{
+		s->ready = 0;
+	}
+	else
+	{
+		if (s->due != sim_now)
+			sim_fail("client yielded when not due", i);
+		if (s->fired)
+			sim_fail("client yielded twice as due in a run", i);
+		s->fired = 1;
+	}
+	s->pending = 0;
+
+	switch (rand() % 64)
+	{
+	case 0:
+		s->gone = 1;
+		s->exit_code = QCLOUD_ERR_MQTT_RECONNECT_TIMEOUT;
+		return QCLOUD_ERR_MQTT_RECONNECT_TIMEOUT;
+	case 1:
+		s->gone = 1;
+		s->exit_code = QCLOUD_RET_SUCCESS;
+		if (IOT_Reactor_Remove(sim_reactor, s) != QCLOUD_RET_SUCCESS)
+			sim_fail("client not removed from its yield", i);
+		if (s->detached)
+			sim_fail("client detached while the run yields it", i);
+		return QCLOUD_RET_SUCCESS;
+	}
+
+	s->conn = (rand() % 8) != 0;
+	s->next = (rand() % 5 == 0) ? 0 : (uint32_t)(rand() % 70000);
+	s->due = sim_now + ((s->next < SIM_MAX_DUE_MS) ? s->next : SIM_MAX_DUE_MS);
+	if (s->conn && s->fd < 0 && s->next > SIM_POLL_MS)
+		s->due = sim_now + SIM_POLL_MS;
+	return (rand() % 2) ? QCLOUD_RET_SUCCESS : QCLOUD_ERR_MQTT_ATTEMPTING_RECONNECT;
+}
+
+static void client_detached(void *handle, int exit_code)
+{
+	SimClient *s = (SimClient *)handle;
+	int i = (int)(s - sim_client);
+
+	if (!sim_locked)
+		sim_fail("client detached without the reactor lock", i);
+	if (!s->attached || !s->gone || s->detached)
+		sim_fail("client detached but not removed, or twice", i);
+	if (exit_code != s->exit_code)
+		sim_fail("wrong exit code", i);
+	s->detached = 1;
+	sim_slot[s->slot] = -1;
+}
+
+static uint32_t client_next_event_ms(void *handle)
+{
+	return ((SimClient *)handle)->next;
+}
+
+static const ReactorClientOps sim_ops_mqtt = {client_yield, NULL, client_detached};
+static const ReactorClientOps sim_ops_own = {client_yield, client_next_event_ms, client_detached};
+
+static void timer_fire(void *context)
+{
+	SimTimer *t = (SimTimer *)context;
+	int i = (int)(t - sim_timer);
+
+	if (sim_locked)
+		sim_fail("timer called with the reactor lock held", i);
+	if (!t->active)
+		sim_fail("timer called after it was removed", i);
+	if (t->due != sim_now)
+		sim_fail("timer called when not due", i);
+	if (t->fired)
+		sim_fail("timer called twice in a run", i);
+	t->fired = 1;
+	if (t->period)
+		t->due = sim_now + t->period;
+	else
+		t->active = 0;
+}
+
+static void add_client(int i)
+{
+	SimClient *s = &sim_client[i];
+	int rc;
+
+	memset(s, 0, sizeof(SimClient));
+	for (s->slot = 0; sim_slot[s->slot] >= 0; s->slot++)
+		;
+	sim_slot[s->slot] = i;
+	s->fd = (rand() % 4) ? SIM_FD(i) : -1;
+	s->conn = 1;
+	rc = IOT_Reactor_Add(sim_reactor, s, &sim_mqtt[i], (rand() % 2) ? &sim_ops_mqtt : &sim_ops_own);
+	if (rc != QCLOUD_RET_SUCCESS)
+		sim_fail("client not added", i);
+	s->attached = 1;
+	s->due = sim_now;
+	if (IOT_Reactor_Add(sim_reactor, s, &sim_mqtt[i], &sim_ops_mqtt) != QCLOUD_ERR_INVAL)
+		sim_fail("client added twice", i);
+}
+
+static void add_timer(void)
+{
+	uint32_t delay = (uint32_t)(rand() % (SIM_MAX_DUE_MS + 1));
+	uint32_t period = (rand() % 3) ? (uint32_t)(rand() % (SIM_MAX_DUE_MS + 1)) : 0;
+	int i, id;
+
+	for (i = 0; i < REACTOR_MAX_TIMERS && sim_timer[i].active; i++)
+		;
+	id = IOT_Reactor_Add_Timer(sim_reactor, delay, period, timer_fire, &sim_timer[i < REACTOR_MAX_TIMERS ? i : 0]);
+	if (i == REACTOR_MAX_TIMERS)
+	{
+		if (id >= 0)
+			sim_fail("timer added to a full reactor", id);
+		return;
+	}
+	if (id != i)
+		sim_fail("timer not in the first free slot", id);
+	sim_timer[i].active = 1;
+	sim_timer[i].due = sim_now + delay;
+	sim_timer[i].period = period;
+}
+
+/* between two runs, what the application does from its own task */
+static void sim_step(void)
+{
+	int i = rand() % REACTOR_MAX_CLIENTS, r = rand() % 32;
+	SimClient *s = &sim_client[i];
+
+	if (r < 2)
+	{
+		if (!s->attached)
+			add_client(i);
+	}
+	else if (r == 2 && s->attached)
+	{
+		s->gone = 1;
+		s->exit_code = QCLOUD_RET_SUCCESS;
+		if (IOT_Reactor_Remove(sim_reactor, s) != QCLOUD_RET_SUCCESS || !s->detached)
+			sim_fail("client not detached at once out of a run", i);
+		memset(s, 0, sizeof(SimClient));
+	}
+	else if (r == 3)
+	{
+		add_timer();
+	}
+	else if (r == 4)
+	{
+		i = rand() % REACTOR_MAX_TIMERS;
+		if (IOT_Reactor_Remove_Timer(sim_reactor, i) != QCLOUD_RET_SUCCESS)
+			sim_fail("timer not removed", i);
+		sim_timer[i].active = 0;
+	}
+	else if (r == 5)
+	{
+		// the link came up again, every client is due
+		sim_link_up_count++;
+		for (i = 0; i < REACTOR_MAX_CLIENTS; i++)
+			if (sim_client[i].attached && !sim_client[i].gone)
+				sim_client[i].due = sim_now;
+	}
+	else if (r == 6)
+	{
+		sim_closed = 1;
+	}
+	else if (r == 7 && s->attached && !s->gone)
+	{
+		s->pending = 1 + rand() % 100;
+	}
+}
+
+static int sim_run(void)
+{
+	uint32_t timeout = (rand() % 8) ? SIM_WAIT_MS : (uint32_t)(rand() % SIM_WAIT_MS);
+	int i;
+
+	for (i = 0; i < REACTOR_MAX_CLIENTS; i++)
+		sim_client[i].fired = sim_client[i].ready = 0;
+	for (i = 0; i < REACTOR_MAX_TIMERS; i++)
+		sim_timer[i].fired = 0;
+	sim_expected_wait = model_wait(timeout);
+
+	if (IOT_Reactor_Run(sim_reactor, timeout) != QCLOUD_RET_SUCCESS)
+		sim_fail("run failed", -1);
+	if (sim_locked)
+		sim_fail("run returned with the reactor lock held", -1);
+
+	// nothing due is left behind, what left is detached
+	for (i = 0; i < REACTOR_MAX_CLIENTS; i++)
+	{
+		SimClient *s = &sim_client[i];
+
+		if (!s->attached)
+			continue;
+		if (s->gone)
+		{
+			if (!s->detached)
+				sim_fail("client removed but not detached after the run", i);
+			memset(s, 0, sizeof(SimClient));
+			continue;
+		}
+		if (s->ready)
+			sim_fail("readable client not yielded", i);
+		if ((int32_t)(s->due - sim_now) <= 0 && !s->fired)
+			sim_fail("due client not yielded", i);
+	}
+	for (i = 0; i < REACTOR_MAX_TIMERS; i++)
+		if (sim_timer[i].active && (int32_t)(sim_timer[i].due - sim_now) <= 0 && !sim_timer[i].fired)
+			sim_fail("due timer not called", i);
+
+	return sim_failed ? -1 : 0;
+}
+
+static int sim_check(uint32_t start, int count)
+{
+	int i;
+
+	memset(sim_client, 0, sizeof(sim_client));
+	memset(sim_timer, 0, sizeof(sim_timer));
+	memset(sim_slot, 0xff, sizeof(sim_slot));
+	sim_now = start;
+	if ((sim_reactor = IOT_Reactor_Construct()) == NULL)
+	{
+		sim_fail("reactor not created", -1);
+		return -1;
+	}
+	for (i = 0; i < REACTOR_MAX_CLIENTS; i += 2)
+		add_client(i);
+	if (IOT_Reactor_Add_Timer(sim_reactor, SIM_MAX_DUE_MS + 1, 0, timer_fire, &sim_timer[0]) >= 0)
+		sim_fail("timer longer than the ms clock allows added", 0);
+
+	for (sim_round = 0; sim_round < count && !sim_failed; sim_round++)
+	{
+		for (i = rand() % 3; i > 0; i--)
+			sim_step();
+		if (sim_run() < 0)
+			break;
+	}
+
+	for (i = 0; i < REACTOR_MAX_CLIENTS; i++)
+	{
+		if (sim_client[i].attached)
+		{
+			sim_client[i].gone = 1;
+			sim_client[i].exit_code = QCLOUD_RET_SUCCESS;
+		}
+	}
+	if (IOT_Reactor_Destroy(sim_reactor) != QCLOUD_RET_SUCCESS)
+		sim_fail("reactor not destroyed", -1);
+	for (i = 0; i < REACTOR_MAX_CLIENTS; i++)
+		if (sim_client[i].attached && !sim_client[i].detached)
+			sim_fail("client not detached by destroy", i);
+
+	return sim_failed ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	int count = 200000;
+
+	if (argc > 1)
+		count = (int)strtoul(argv[1], NULL, 0);
+	srand(1);
+
+	// from 0, then across the wrap of the ms clock
+	if (sim_check(0, count) < 0 || sim_check(0xffffffffu - 3600000u, count) < 0)
+		return 1;
+	printf("runs %d twice, clients and timers called when due and once, detached once, also across the ms clock wrap\n", count);
+	printf("PASS\n");
+	return 0;
+}
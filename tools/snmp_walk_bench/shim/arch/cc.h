@@ -0,0 +1,11 @@
+/* Host port of lwIP for the SNMP walk benchmark, see ../../readme.txt */
+#ifndef SNMP_WALK_BENCH_CC_H
+#define SNMP_WALK_BENCH_CC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LWIP_PLATFORM_DIAG(x)	do { printf x; } while (0)
+#define LWIP_PLATFORM_ASSERT(x)	do { printf("assert: %s, %s:%d\n", x, __FILE__, __LINE__); abort(); } while (0)
+
+#endif
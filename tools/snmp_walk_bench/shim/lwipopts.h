@@ -0,0 +1,10 @@
+/* lwIP options of the SNMP walk benchmark, see ../readme.txt: only the types
+ * of lwIP are used, no stack is built. */
+#ifndef SNMP_WALK_BENCH_LWIPOPTS_H
+#define SNMP_WALK_BENCH_LWIPOPTS_H
+
+#define NO_SYS				1
+#define SYS_LIGHTWEIGHT_PROT		0
+#define LWIP_SNMP			0
+
+#endif
@@ -0,0 +1,111 @@
+/******************************************************************************
+ *
+ * Host side benchmark of the get-next cursor of the Ameba SNMP agent, see
+ * readme.txt.
+ *
+ * A walk of a few columns of a table of random rows, each GetNext answered
+ * by snmp_ameba_cursor_next(), and by a scan of every row for the smallest
+ * greater index, the way lwIP answers it in its MIB2 tables. Only times are
+ * printed: the walk order is checked by the lwIP unit tests (test/unit/snmp).
+ *
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "snmp_ameba.h"
+
+#define KEY_LEN			5		// as ipNetToMediaTable: ifIndex, IP address
+#define MAX_ROWS		4096
+#define WALK_COLUMNS	4
+
+static u32_t keys[MAX_ROWS * KEY_LEN];
+static u16_t row_count;
+static struct snmp_ameba_cursor_table table;
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static s8_t ref_cmp(const u32_t *a, u8_t a_len, const u32_t *b, u8_t b_len)
+{
+	u8_t i;
+
+	for (i = 0; (i < a_len) && (i < b_len); i++) {
+		if (a[i] != b[i])
+			return (a[i] < b[i]) ? -1 : 1;
+	}
+	if (a_len == b_len)
+		return 0;
+	return (a_len < b_len) ? -1 : 1;
+}
+
+static s32_t ref_next(const u32_t *oid, u8_t oid_len)
+{
+	s32_t best = -1;
+	u16_t i;
+
+	for (i = 0; i < row_count; i++) {
+		if ((ref_cmp(&keys[i * KEY_LEN], KEY_LEN, oid, oid_len) > 0) &&
+			((best < 0) || (ref_cmp(&keys[i * KEY_LEN], KEY_LEN, &keys[best * KEY_LEN], KEY_LEN) < 0)))
+			best = i;
+	}
+	return best;
+}
+
+/* rows random keys, inserted in random order */
+static void fill_table(u16_t rows)
+{
+	u32_t key[KEY_LEN];
+	u8_t i;
+
+	row_count = 0;
+	while (row_count < rows) {
+		key[0] = 1 + (u32_t)(rand() % 3);
+		for (i = 1; i < KEY_LEN; i++)
+			key[i] = (u32_t)(rand() % 256);
+		if (snmp_ameba_cursor_insert(keys, KEY_LEN, row_count, key) >= 0)
+			row_count++;
+	}
+	snmp_ameba_cursor_reset(&table, keys, KEY_LEN, row_count);
+}
+
+/* ns per GetNext of a walk of WALK_COLUMNS columns */
+static double bench_walk(int linear)
+{
+	u32_t oid[KEY_LEN];
+	u8_t len;
+	u16_t col;
+	u32_t steps = 0;
+	s32_t row;
+	double t0;
+
+	t0 = bench_now();
+	for (col = 0; col < WALK_COLUMNS; col++) {
+		len = 0;
+		while ((row = linear ? ref_next(oid, len) : snmp_ameba_cursor_next(&table, oid, len)) >= 0) {
+			memcpy(oid, &keys[row * KEY_LEN], sizeof(oid));
+			len = KEY_LEN;
+			steps++;
+		}
+	}
+	return (bench_now() - t0) / steps;
+}
+
+int main(void)
+{
+	static const u16_t sizes[] = {16, 256, 1024, MAX_ROWS};
+	unsigned int i;
+
+	srand(1);
+	printf("%6s %12s %12s   (ns per GetNext, walk of %d columns)\n", "rows", "cursor", "every row", WALK_COLUMNS);
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		fill_table(sizes[i]);
+		printf("%6u %12.1f %12.1f\n", row_count, bench_walk(0), bench_walk(1));
+	}
+	return 0;
+}